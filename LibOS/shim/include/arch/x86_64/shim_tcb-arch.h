@@ -40,6 +40,15 @@ static inline void shim_regs_set_syscallnr(struct shim_regs* sr, uint64_t sc_num
     sr->orig_rax = sc_num;
 }
 
+static inline void shim_regs_get_syscall_args(struct shim_regs* sr, uint64_t args[6]) {
+    args[0] = sr->rdi;
+    args[1] = sr->rsi;
+    args[2] = sr->rdx;
+    args[3] = sr->r10;
+    args[4] = sr->r8;
+    args[5] = sr->r9;
+}
+
 #define SHIM_TCB_GET(member)                                            \
     ({                                                                  \
         shim_tcb_t* tcb;                                                \
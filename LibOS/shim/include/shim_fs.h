@@ -42,6 +42,14 @@ struct shim_fs_ops {
     /* write: the content from the file opened as handle */
     ssize_t (*write)(struct shim_handle* hdl, const void* buf, size_t count);
 
+    /* pread, pwrite, preadv, pwritev: read/write the content at the given offset; the file
+     * position is neither used nor updated, so these must not take the handle lock around the PAL
+     * call; preadv/pwritev are optional if pread/pwrite are provided */
+    ssize_t (*pread)(struct shim_handle* hdl, void* buf, size_t count, off_t pos);
+    ssize_t (*pwrite)(struct shim_handle* hdl, const void* buf, size_t count, off_t pos);
+    ssize_t (*preadv)(struct shim_handle* hdl, const struct iovec* vec, int vlen, off_t pos);
+    ssize_t (*pwritev)(struct shim_handle* hdl, const struct iovec* vec, int vlen, off_t pos);
+
     /* mmap: mmap handle to address */
     int (*mmap)(struct shim_handle* hdl, void** addr, size_t size, int prot, int flags,
                 off_t offset);
@@ -59,6 +67,13 @@ struct shim_fs_ops {
     /* Returns 0 on success, -errno on error */
     int (*truncate)(struct shim_handle* hdl, off_t len);
 
+    /* fallocate, fadvise, sync_range: reserve storage for, advise on the access pattern of, or
+     * write out a range of the file; `mode`, `advice` and `flags` are the Linux FALLOC_FL_*,
+     * POSIX_FADV_* and SYNC_FILE_RANGE_* values. Return 0 on success, -errno on error */
+    int (*fallocate)(struct shim_handle* hdl, int mode, off_t offset, off_t len);
+    int (*fadvise)(struct shim_handle* hdl, off_t offset, off_t len, int advice);
+    int (*sync_range)(struct shim_handle* hdl, off_t offset, off_t nbytes, unsigned int flags);
+
     /* hstat: get status of the file */
     int (*hstat)(struct shim_handle* hdl, struct stat* buf);
 
@@ -119,6 +134,7 @@ struct shim_fs_ops {
 
 DEFINE_LIST(shim_dentry);
 DEFINE_LISTP(shim_dentry);
+struct shim_file_locks;
 struct shim_dentry {
     int state; /* flags for managing state */
 
@@ -145,6 +161,10 @@ struct shim_dentry {
     mode_t type;
     mode_t mode;
 
+    /* advisory locks on the file held in this process, created on the first lock; see
+     * fs/shim_fs_lock.c */
+    struct shim_file_locks* locks;
+
     struct shim_lock lock;
     REFTYPE ref_count;
 };
@@ -516,6 +536,17 @@ extern struct shim_mount fifo_builtin_fs;
 extern struct shim_mount socket_builtin_fs;
 extern struct shim_mount epoll_builtin_fs;
 extern struct shim_mount eventfd_builtin_fs;
+extern struct shim_mount timerfd_builtin_fs;
+extern struct shim_mount signalfd_builtin_fs;
+extern struct shim_mount mqueue_builtin_fs;
+extern struct shim_mount shm_builtin_fs;
+
+/* host eventfds are used only if the manifest sets `sys.insecure__allow_eventfd = 1` */
+bool eventfd_allowed(void);
+
+/* Makes the PAL handle of a POSIX message queue report its readiness (see shim_mqueue.c); must be
+ * called before the handle is polled. */
+int mqueue_watch(struct shim_handle* hdl);
 
 /* pseudo file systems (separate treatment since they don't have associated dentries) */
 #define DIR_RX_MODE  0555
@@ -528,6 +559,9 @@ extern struct shim_d_ops dev_d_ops;
 extern struct shim_fs_ops proc_fs_ops;
 extern struct shim_d_ops proc_d_ops;
 
+extern struct shim_fs_ops sys_fs_ops;
+extern struct shim_d_ops sys_d_ops;
+
 struct pseudo_name_ops {
     int (*match_name)(const char* name);
     int (*list_name)(const char* name, struct shim_dirent** buf, int count);
@@ -580,7 +614,40 @@ int str_dput(struct shim_dentry* dent);
 int str_close(struct shim_handle* hdl);
 ssize_t str_read(struct shim_handle* hdl, void* buf, size_t count);
 ssize_t str_write(struct shim_handle* hdl, const void* buf, size_t count);
+ssize_t str_pread(struct shim_handle* hdl, void* buf, size_t count, off_t pos);
+ssize_t str_pwrite(struct shim_handle* hdl, const void* buf, size_t count, off_t pos);
 off_t str_seek(struct shim_handle* hdl, off_t offset, int whence);
 int str_flush(struct shim_handle* hdl);
 
+/* emulation of shared file mappings (fs/shim_fs_mmap.c) */
+int init_shared_mmaps(void);
+int emulate_shared_mmap(struct shim_handle* hdl, void* addr, size_t size, off_t offset);
+int sync_shared_mmaps(void* addr, size_t length, bool remove);
+int sync_all_shared_mmaps(bool remove);
+
+/* advisory file locks (fs/shim_fs_lock.c) */
+enum file_lock_kind {
+    FILE_LOCK_POSIX, /* fcntl(F_SETLK) record locks, owned by the process */
+    FILE_LOCK_OFD,   /* fcntl(F_OFD_SETLK) record locks, owned by the open file description */
+    FILE_LOCK_FLOCK, /* flock() locks of the whole file, owned by the open file description */
+};
+
+/* A lock range is [`start`, `end`); FILE_LOCK_EOF as `end` extends it to the end of the file. */
+#define FILE_LOCK_EOF UINT64_MAX
+
+int init_file_locks(void);
+/* `type` is F_RDLCK, F_WRLCK or F_UNLCK; returns -EAGAIN on a conflict unless `wait` is set. */
+int file_lock_set(struct shim_handle* hdl, int kind, int type, uint64_t start, uint64_t end,
+                  bool wait);
+/* Finds a lock conflicting with the given one; `*type` is set to F_UNLCK if there is none and
+ * `*pid` to the holder's pid, or -1 if it is not known. */
+int file_lock_get(struct shim_handle* hdl, int kind, int* type, uint64_t* start, uint64_t* end,
+                  int* pid);
+/* Drops the POSIX locks of the file of `hdl` (any close() does) or, if `posix` is false, the locks
+ * owned by `hdl` itself (on its last close). */
+void file_locks_release(struct shim_handle* hdl, bool posix);
+/* Hands all locks over to the host before the first child process is created. */
+void file_locks_delegate(void);
+void file_locks_free(struct shim_dentry* dent);
+
 #endif /* _SHIM_FS_H_ */
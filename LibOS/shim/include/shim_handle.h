@@ -21,6 +21,7 @@
 #include <pal.h>
 #include <shim_defs.h>
 #include <shim_sysv.h>
+#include <shim_timer.h>
 #include <shim_types.h>
 #include <stdalign.h>
 
@@ -37,7 +38,10 @@ enum shim_handle_type {
     TYPE_FUTEX,
     TYPE_STR,
     TYPE_EPOLL,
-    TYPE_EVENTFD
+    TYPE_EVENTFD,
+    TYPE_TIMERFD,
+    TYPE_SIGNALFD,
+    TYPE_MQUEUE
 };
 
 struct shim_handle;
@@ -212,14 +216,22 @@ struct shim_dir_handle {
     struct shim_dentry** ptr;
 };
 
+struct shm_segment_hdr;
+
+DEFINE_LIST(shim_shm_handle);
 struct shim_shm_handle {
-    /* XXX: need to implement */
-    void* __reserved;
+    unsigned long shmkey;        /* key from the user, IPC_PRIVATE after IPC_RMID */
+    IDTYPE shmid;
+    size_t size;                 /* size requested at creation */
+    struct shm_segment_hdr* hdr; /* segment header, mapped on first use in each process */
+    unsigned int nattach;        /* attachments in this process */
+    LIST_TYPE(shim_shm_handle) list;
 };
 
 struct msg_type;
 struct msg_item;
 struct msg_client;
+struct sysv_shared_obj;
 
 #define MAX_SYSV_CLIENTS 32
 
@@ -243,6 +255,7 @@ struct shim_msg_handle {
     int maxtypes;
     struct msg_type* types;
     struct sysv_score scores[MAX_SYSV_CLIENTS];
+    struct sysv_shared_obj* shared; /* shared segment, if the local-first fast path is used */
     LIST_TYPE(shim_msg_handle) list;
     LIST_TYPE(shim_msg_handle) key_hlist;
     LIST_TYPE(shim_msg_handle) qid_hlist;
@@ -265,6 +278,7 @@ struct shim_sem_handle {
     int nreqs;
     struct sysv_score scores[MAX_SYSV_CLIENTS];
     LISTP_TYPE(sem_ops) migrated;
+    struct sysv_shared_obj* shared; /* shared segment, if the local-first fast path is used */
     LIST_TYPE(shim_sem_handle) list;
     LIST_TYPE(shim_sem_handle) key_hlist;
     LIST_TYPE(shim_sem_handle) sid_hlist;
@@ -299,6 +313,30 @@ struct shim_epoll_handle {
     LISTP_TYPE(shim_epoll_item) fds;
 };
 
+struct shim_timerfd_handle {
+    struct shim_timer timer;
+    uint64_t interval;
+    uint64_t expirations;  /* since the last read(); the PAL handle is readable iff non-zero */
+    bool armed;
+    int clockid;
+};
+
+DEFINE_LIST(shim_signalfd_handle);
+struct shim_signalfd_handle {
+    __sigset_t mask;
+    bool ready;  /* the PAL handle was made readable and not drained since; accessed atomically */
+    LIST_TYPE(shim_signalfd_handle) list;  /* on the list of signalfds of this process */
+};
+
+struct sysv_shared_obj;
+struct shim_mqueue_watcher;
+
+struct shim_mqueue_handle {
+    struct sysv_shared_obj* obj;          /* mapping of the queue segment */
+    PAL_HANDLE migrated;                  /* stream of the segment, only during checkpointing */
+    struct shim_mqueue_watcher* watcher;  /* reports readiness on the PAL handle once polled */
+};
+
 struct shim_mount;
 struct shim_qstr;
 struct shim_dentry;
@@ -308,10 +346,12 @@ struct shim_dentry;
 struct shim_handle {
     enum shim_handle_type type;
 
-    REFTYPE ref_count;
-
     char fs_type[8];
     struct shim_mount* fs;
+
+    /* Not at the start of the structure: get_fd_handle() may read the count of a handle which was
+     * just freed, and the memory manager links freed handles through their first bytes. */
+    REFTYPE ref_count;
     struct shim_qstr path;
     struct shim_dentry* dentry;
 
@@ -334,6 +374,9 @@ struct shim_handle {
         struct shim_sem_handle sem;
         struct shim_str_handle str;
         struct shim_epoll_handle epoll;
+        struct shim_timerfd_handle timerfd;
+        struct shim_signalfd_handle signalfd;
+        struct shim_mqueue_handle mqueue;
     } info;
 
     struct shim_dir_handle dir_info;
@@ -358,6 +401,18 @@ struct shim_fd_handle {
     struct shim_handle* handle;
 };
 
+/* Arrays of file descriptors replaced by a bigger one; see `struct shim_handle_map` */
+struct shim_fd_map_retired {
+    struct shim_fd_map_retired* next;
+    struct shim_fd_handle** map;
+};
+
+/*
+ * All modifications of the map happen under `lock`. Lookups (get_fd_handle()) do not take the
+ * lock: `map` and the `handle` fields of its entries are published with release stores, entries
+ * are never freed while the map exists, and arrays replaced when the map grows are kept on the
+ * `retired` list until the map is destroyed.
+ */
 struct shim_handle_map {
     /* the top of created file descriptors */
     FDTYPE fd_size;
@@ -369,6 +424,7 @@ struct shim_handle_map {
 
     /* An array of file descriptor belong to this mapping */
     struct shim_fd_handle** map;
+    struct shim_fd_map_retired* retired;
 };
 
 /* allocating file descriptors */
@@ -411,4 +467,14 @@ off_t get_file_size(struct shim_handle* file);
 int do_handle_read(struct shim_handle* hdl, void* buf, int count);
 int do_handle_write(struct shim_handle* hdl, const void* buf, int count);
 
+/* Positional I/O and fsync on an already looked-up handle (shared by the pread/pwrite family of
+ * system calls and by the AIO workers); user buffers must be checked by the caller. */
+ssize_t do_handle_pread(struct shim_handle* hdl, void* buf, size_t count, off_t pos);
+ssize_t do_handle_pwrite(struct shim_handle* hdl, const void* buf, size_t count, off_t pos);
+ssize_t do_handle_preadv(struct shim_handle* hdl, const struct iovec* vec, unsigned long vlen,
+                         off_t pos);
+ssize_t do_handle_pwritev(struct shim_handle* hdl, const struct iovec* vec, unsigned long vlen,
+                          off_t pos);
+int do_handle_fsync(struct shim_handle* hdl);
+
 #endif /* _SHIM_HANDLE_H_ */
@@ -169,14 +169,58 @@ static inline int64_t get_cur_preempt (void) {
     return atomic_read(&tcb->context.preempt);
 }
 
+/* syscall statistics (see bookkeep/shim_syscall_stats.c), enabled by `sys.syscall_stats` */
+extern bool g_syscall_stats_enabled;
+extern unsigned int g_syscall_stats_sample;
+
+void record_syscall_stats(int sysno, const char* name, long ret, unsigned long start_time,
+                          unsigned long end_time);
+
+/* syscall and PAL call tracing (see bookkeep/shim_trace.c), enabled by `sys.trace.file` */
+extern bool g_trace_enabled;
+
+void record_syscall_trace(int sysno, const char* name, long ret, unsigned long start_time,
+                          unsigned long end_time);
+
+/* Returns the start time of the current syscall if it has to be timed, 0 otherwise. Querying time
+ * is expensive (an OCALL on SGX), so syscall statistics time only every `g_syscall_stats_sample`th
+ * syscall of each thread; tracing needs the duration of every syscall. */
+static inline unsigned long syscall_start_time(void) {
+    if (g_trace_enabled)
+        return DkSystemTimeQuery();
+
+    if (g_syscall_stats_enabled) {
+        shim_tcb_t* tcb = shim_get_tcb();
+        if (++tcb->syscall_stats_tick >= g_syscall_stats_sample) {
+            tcb->syscall_stats_tick = 0;
+            return DkSystemTimeQuery();
+        }
+    }
+
+    return 0;
+}
+
 #define BEGIN_SHIM(name, args ...)                          \
     SHIM_ARG_TYPE __shim_##name(args) {                     \
         SHIM_ARG_TYPE ret = 0;                              \
         int64_t preempt = get_cur_preempt();                \
         __UNUSED(preempt);                                  \
+        unsigned long syscall_start = syscall_start_time(); \
         /* check_stack_hook(); */
 
 #define END_SHIM(name)                                      \
+        if (g_syscall_stats_enabled || syscall_start) {     \
+            unsigned long syscall_end =                     \
+                syscall_start ? DkSystemTimeQuery() : 0;    \
+            if (g_syscall_stats_enabled)                    \
+                record_syscall_stats(__NR_##name, #name,    \
+                                     ret, syscall_start,    \
+                                     syscall_end);          \
+            if (g_trace_enabled && syscall_start)           \
+                record_syscall_trace(__NR_##name, #name,    \
+                                     ret, syscall_start,    \
+                                     syscall_end);          \
+        }                                                   \
         handle_signals();                                   \
         assert(preempt == get_cur_preempt());               \
         return ret;                                         \
@@ -656,6 +700,20 @@ static inline int __ref_inc (REFTYPE * ref)
 
 #define REF_INC(ref)  __ref_inc(&(ref))
 
+/* Takes a reference only if the object is still alive, i.e. the count did not drop to zero. */
+static inline bool __ref_inc_not_zero (REFTYPE * ref)
+{
+    register int _c;
+    do {
+        _c = atomic_read(ref);
+        if (!_c)
+            return false;
+    } while (!atomic_cmpxchg(ref, _c, _c + 1));
+    return true;
+}
+
+#define REF_INC_NOT_ZERO(ref)  __ref_inc_not_zero(&(ref))
+
 static inline int __ref_dec (REFTYPE * ref)
 {
     register int _c;
@@ -716,6 +774,17 @@ int init_internal_map (void);
 int init_loader (void);
 int init_manifest (PAL_HANDLE manifest_handle);
 int init_rlimit(void);
+int init_syscall_stats(void);
+void print_syscall_stats(void);
+int get_syscall_stats_report(char** str, size_t* len);
+int init_trace(void);
+void flush_trace(void);
+
+/* boot-phase profiler (see bookkeep/shim_boot_profile.c), reported if `loader.boot_profile` */
+extern uint64_t g_elf_relocations;
+void record_boot_phase(const char* name);
+void print_boot_profile(void);
+int get_boot_profile_report(char** str, size_t* len);
 
 bool test_user_memory (void * addr, size_t size, bool write);
 bool test_user_string (const char * addr);
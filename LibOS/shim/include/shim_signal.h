@@ -99,6 +99,15 @@ struct shim_signal {
 
 void get_pending_signals(struct shim_thread* thread, __sigset_t* set);
 
+/* Dequeues the lowest pending signal in `mask` from the queue of `thread` or, if there is none,
+ * of the process, and stores its siginfo in `info` (if not NULL). Returns the signal number, or 0
+ * if no signal in `mask` is pending. */
+int pop_pending_signal(struct shim_thread* thread, const __sigset_t* mask, siginfo_t* info);
+
+/* Called whenever a signal is queued (also from host signal context) to make the signalfds
+ * watching `sig` readable; see sys/shim_signalfd.c. */
+void signalfd_notify(int sig);
+
 struct shim_thread;
 
 int init_signal (void);
@@ -119,4 +128,9 @@ int do_kill_thread (IDTYPE sender, IDTYPE tgid, IDTYPE tid, int sig,
 int do_kill_proc (IDTYPE sender, IDTYPE tgid, int sig, bool use_ipc);
 int do_kill_pgroup (IDTYPE sender, IDTYPE pgid, int sig, bool use_ipc);
 
+/* Same as do_kill_proc() and do_kill_thread(), but deliver the given `info` (e.g. an SI_TIMER
+ * signal carrying si_value) and never go through IPC: the target must be in this process. */
+int do_kill_proc_info(IDTYPE tgid, siginfo_t* info);
+int do_kill_thread_info(IDTYPE tgid, IDTYPE tid, siginfo_t* info);
+
 #endif /* _SHIM_SIGNAL_H_ */
@@ -200,6 +200,77 @@ int recover_sem_ownership(struct shim_sem_handle* sem, struct sem_backup* backup
 int submit_sysv_sem(struct shim_sem_handle* sem, struct sembuf* sops, int nsops,
                     unsigned long timeout, struct sysv_client* client);
 
+/* Local-first fast path: object state in a shared-memory segment (see shim_sysv_shared.c) */
+struct sysv_shared_semadj;
+
+struct sysv_shared_obj {
+    PAL_HANDLE pal_handle;
+    void* addr;
+    size_t size;
+    struct sysv_shared_semadj* semadj; /* SEM_UNDO adjustments of this process (semaphores) */
+    bool released;                     /* this process no longer counts in `nattach` */
+};
+
+/* Header of every shared segment. `lock` is a futex-based lock (0 - unlocked, 1 - locked, 2 -
+ * locked with waiters), `seq` is bumped on every state change and is what blocked callers sleep
+ * on. `nattach` counts the processes which have a SysV object attached; the last one to detach
+ * removes the segment. */
+struct sysv_shared_hdr {
+    uint32_t lock;
+    uint32_t seq;
+    uint32_t nwaiters;
+    uint32_t deleted;
+    uint32_t nattach;
+};
+
+int init_sysv_shared(void);
+bool sysv_shared_enabled(void);
+
+/* Name of the `shm:` stream backing SysV object `id` of `type` in this Graphene instance */
+#define SYSV_SHARED_URI_SIZE 64
+void sysv_shared_obj_uri(char* uri, size_t size, const char* type, IDTYPE id);
+/* Name of the `shm:` stream `name` in this Graphene instance (e.g. a POSIX message queue) */
+void sysv_shared_uri(char* uri, size_t size, const char* name);
+
+/* Maps the segment of `uri`, creating it with `create_size` bytes (zeroed) if non-zero */
+int sysv_shared_open(const char* uri, size_t create_size, struct sysv_shared_obj** objp);
+/* Maps the segment of an already open stream (e.g. inherited on fork) */
+int sysv_shared_map(PAL_HANDLE pal_hdl, struct sysv_shared_obj** objp);
+void sysv_shared_detach(struct sysv_shared_obj* obj);
+
+void sysv_shared_lock(struct sysv_shared_hdr* hdr);
+void sysv_shared_unlock(struct sysv_shared_hdr* hdr);
+void sysv_shared_changed(struct sysv_shared_hdr* hdr);
+void sysv_shared_unlock_notify(struct sysv_shared_hdr* hdr);
+int sysv_shared_wait(struct sysv_shared_hdr* hdr, uint64_t deadline_us);
+
+/* Detaches this process from a SysV object: applies its SEM_UNDO adjustments and removes the
+ * segment if no other process has it attached. Unmaps the segment if `unmap` (not done on process
+ * exit, when other threads may still use it). */
+void sysv_shared_release(struct sysv_shared_obj* obj, bool unmap);
+
+int sysv_shared_sem_create(IDTYPE semid, int nsems, struct sysv_shared_obj** objp);
+int sysv_shared_sem_attach(IDTYPE semid, struct sysv_shared_obj** objp);
+int sysv_shared_sem_remove(struct sysv_shared_obj* obj);
+int sysv_shared_semop(struct sysv_shared_obj* obj, struct sembuf* sops, unsigned int nsops,
+                      unsigned long timeout_ns);
+int sysv_shared_semctl(struct sysv_shared_obj* obj, int semnum, int cmd, unsigned long arg);
+
+int sysv_shared_msgq_create(IDTYPE msqid, struct sysv_shared_obj** objp);
+int sysv_shared_msgq_attach(IDTYPE msqid, struct sysv_shared_obj** objp);
+int sysv_shared_msgq_remove(struct sysv_shared_obj* obj);
+int sysv_shared_msgsnd(struct sysv_shared_obj* obj, const struct __kernel_msgbuf* msgbuf,
+                       size_t size, int flags);
+int sysv_shared_msgrcv(struct sysv_shared_obj* obj, long type, struct __kernel_msgbuf* msgbuf,
+                       size_t size, int flags);
+
+/* Releases the shared segments of all SysV semaphores and message queues on process exit */
+void release_all_sem_shared(void);
+void release_all_msg_shared(void);
+
+/* SysV shared memory segments (see shim_shmget.c) */
+void detach_all_shm(void);
+
 #ifdef USE_SHARED_SEMAPHORE
 int send_sem_host_ids(struct shim_sem_handle* sem, struct shim_ipc_port* port, IDTYPE dest,
                       unsigned long seq);
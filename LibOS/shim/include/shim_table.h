@@ -319,6 +319,7 @@ long __shim_syncfs(long);
 long __shim_sendmmsg(long, long, long, long);
 long __shim_setns(long, long);
 long __shim_getcpu(long, long, long);
+long __shim_copy_file_range(long, long, long, long, long, long);
 
 /* libos call entries */
 long __shim_msgpersist(long, long);
@@ -357,8 +358,12 @@ int shim_do_select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* errorfds
                    struct __kernel_timeval* timeout);
 int shim_do_sched_yield(void);
 void* shim_do_mremap(void* addr, size_t old_len, size_t new_len, int flags, void* new_addr);
+int shim_do_madvise(void* start, size_t len, int behavior);
 int shim_do_msync(void* start, size_t len, int flags);
 int shim_do_mincore(void* start, size_t len, unsigned char* vec);
+int shim_do_shmget(key_t key, size_t size, int shmflg);
+void* shim_do_shmat(int shmid, const void* shmaddr, int shmflg);
+int shim_do_shmctl(int shmid, int cmd, struct shmid_ds* buf);
 int shim_do_dup(unsigned int fd);
 int shim_do_dup2(unsigned int oldfd, unsigned int newfd);
 int shim_do_pause(void);
@@ -398,13 +403,20 @@ int shim_do_uname(struct old_utsname* buf);
 int shim_do_semget(key_t key, int nsems, int semflg);
 int shim_do_semop(int semid, struct sembuf* sops, unsigned int nsops);
 int shim_do_semctl(int semid, int semnum, int cmd, unsigned long arg);
+int shim_do_shmdt(const void* shmaddr);
 int shim_do_msgget(key_t key, int msgflg);
 int shim_do_msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg);
 int shim_do_msgrcv(int msqid, void* msgp, size_t msgsz, long msgtyp, int msgflg);
 int shim_do_msgctl(int msqid, int cmd, struct msqid_ds* buf);
 int shim_do_fcntl(int fd, int cmd, unsigned long arg);
+int shim_do_flock(int fd, int cmd);
 int shim_do_fsync(int fd);
 int shim_do_fdatasync(int fd);
+int shim_do_syncfs(int fd);
+int shim_do_sync_file_range(int fd, loff_t offset, loff_t nbytes, int flags);
+int shim_do_fallocate(int fd, int mode, loff_t offset, loff_t len);
+int shim_do_fadvise64(int fd, loff_t offset, size_t len, int advice);
+int shim_do_readahead(int fd, loff_t offset, size_t count);
 int shim_do_truncate(const char* path, loff_t length);
 int shim_do_ftruncate(int fd, loff_t length);
 size_t shim_do_getdents(int fd, struct linux_dirent* buf, size_t count);
@@ -451,6 +463,8 @@ int shim_do_sched_get_priority_max(int policy);
 int shim_do_sched_get_priority_min(int policy);
 int shim_do_sched_rr_get_interval(pid_t pid, struct timespec* interval);
 int shim_do_sigsuspend(const __sigset_t* mask);
+int shim_do_sigtimedwait(const __sigset_t* uthese, siginfo_t* uinfo, const struct timespec* uts,
+                         size_t sigsetsize);
 void* shim_do_arch_prctl(int code, void* addr);
 int shim_do_setrlimit(int resource, struct __kernel_rlimit* rlim);
 int shim_do_chroot(const char* filename);
@@ -460,6 +474,12 @@ time_t shim_do_time(time_t* tloc);
 int shim_do_futex(int* uaddr, int op, int val, void* utime, int* uaddr2, int val3);
 int shim_do_sched_setaffinity(pid_t pid, size_t len, __kernel_cpu_set_t* user_mask_ptr);
 int shim_do_sched_getaffinity(pid_t pid, size_t len, __kernel_cpu_set_t* user_mask_ptr);
+int shim_do_io_setup(unsigned int nr_events, aio_context_t* ctxp);
+int shim_do_io_destroy(aio_context_t ctx_id);
+int shim_do_io_getevents(aio_context_t ctx_id, long min_nr, long nr, struct io_event* events,
+                         struct __kernel_timespec* timeout);
+int shim_do_io_submit(aio_context_t ctx_id, long nr, struct iocb** iocbpp);
+int shim_do_io_cancel(aio_context_t ctx_id, struct iocb* iocb, struct io_event* result);
 int shim_do_set_tid_address(int* tidptr);
 int shim_do_semtimedop(int semid, struct sembuf* sops, unsigned int nsops,
                        const struct timespec* timeout);
@@ -468,6 +488,14 @@ size_t shim_do_getdents64(int fd, struct linux_dirent64* buf, size_t count);
 int shim_do_epoll_wait(int epfd, struct __kernel_epoll_event* events, int maxevents,
                        int timeout_ms);
 int shim_do_epoll_ctl(int epfd, int op, int fd, struct __kernel_epoll_event* event);
+int shim_do_timer_create(clockid_t which_clock, struct sigevent* timer_event_spec,
+                         timer_t* created_timer_id);
+int shim_do_timer_settime(timer_t timer_id, int flags,
+                          const struct __kernel_itimerspec* new_setting,
+                          struct __kernel_itimerspec* old_setting);
+int shim_do_timer_gettime(timer_t timer_id, struct __kernel_itimerspec* setting);
+int shim_do_timer_getoverrun(timer_t timer_id);
+int shim_do_timer_delete(timer_t timer_id);
 int shim_do_clock_gettime(clockid_t which_clock, struct timespec* tp);
 int shim_do_clock_getres(clockid_t which_clock, struct timespec* tp);
 int shim_do_clock_nanosleep(clockid_t clock_id, int flags, const struct __kernel_timespec* rqtp,
@@ -476,6 +504,20 @@ noreturn int shim_do_exit_group(int error_code);
 int shim_do_tgkill(int tgid, int pid, int sig);
 int shim_do_mbind(void* start, unsigned long len, int mode, unsigned long* nmask,
                   unsigned long maxnode, int flags);
+int shim_do_set_mempolicy(int mode, unsigned long* nmask, unsigned long maxnode);
+int shim_do_get_mempolicy(int* policy, unsigned long* nmask, unsigned long maxnode,
+                          unsigned long addr, unsigned long flags);
+int shim_do_mq_open(const char* name, int oflag, mode_t mode, struct __kernel_mq_attr* attr);
+int shim_do_mq_unlink(const char* name);
+int shim_do_mq_timedsend(__kernel_mqd_t mqdes, const char* msg_ptr, size_t msg_len,
+                         unsigned int msg_prio, const struct timespec* abs_timeout);
+int shim_do_mq_timedreceive(__kernel_mqd_t mqdes, char* msg_ptr, size_t msg_len,
+                            unsigned int* msg_prio, const struct timespec* abs_timeout);
+int shim_do_mq_notify(__kernel_mqd_t mqdes, const struct sigevent* notification);
+int shim_do_mq_getsetattr(__kernel_mqd_t mqdes, const struct __kernel_mq_attr* mqstat,
+                          struct __kernel_mq_attr* omqstat);
+int shim_do_migrate_pages(pid_t pid, unsigned long maxnode, const unsigned long* old_nodes,
+                          const unsigned long* new_nodes);
 int shim_do_openat(int dfd, const char* filename, int flags, int mode);
 int shim_do_mkdirat(int dfd, const char* pathname, int mode);
 int shim_do_newfstatat(int dirfd, const char* pathname, struct stat* statbuf, int flags);
@@ -490,12 +532,26 @@ int shim_do_ppoll(struct pollfd* fds, int nfds, struct timespec* tsp, const __si
                   size_t sigsetsize);
 int shim_do_set_robust_list(struct robust_list_head* head, size_t len);
 int shim_do_get_robust_list(pid_t pid, struct robust_list_head** head, size_t* len);
+ssize_t shim_do_splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len,
+                       int flags);
+int shim_do_move_pages(pid_t pid, unsigned long nr_pages, void** pages, const int* nodes,
+                       int* status, int flags);
 int shim_do_epoll_pwait(int epfd, struct __kernel_epoll_event* events, int maxevents,
                         int timeout_ms, const __sigset_t* sigmask, size_t sigsetsize);
+int shim_do_signalfd(int ufd, __sigset_t* user_mask, size_t sizemask);
+int shim_do_timerfd_create(int clockid, int flags);
+int shim_do_timerfd_settime(int ufd, int flags, const struct __kernel_itimerspec* utmr,
+                            struct __kernel_itimerspec* otmr);
+int shim_do_timerfd_gettime(int ufd, struct __kernel_itimerspec* otmr);
 int shim_do_accept4(int sockfd, struct sockaddr* addr, int* addrlen, int flags);
+int shim_do_signalfd4(int ufd, __sigset_t* user_mask, size_t sizemask, int flags);
 int shim_do_dup3(unsigned int oldfd, unsigned int newfd, int flags);
 int shim_do_epoll_create1(int flags);
 int shim_do_pipe2(int* fildes, int flags);
+ssize_t shim_do_preadv(int fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
+                       unsigned long pos_h);
+ssize_t shim_do_pwritev(int fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
+                        unsigned long pos_h);
 int shim_do_mknod(const char *pathname, mode_t mode, dev_t dev);
 int shim_do_mknodat(int dirfd, const char *pathname, mode_t mode, dev_t dev);
 ssize_t shim_do_recvmmsg(int sockfd, struct mmsghdr* msg, unsigned int vlen, int flags,
@@ -506,6 +562,8 @@ ssize_t shim_do_sendmmsg(int sockfd, struct mmsghdr* msg, unsigned int vlen, int
 int shim_do_eventfd2(unsigned int count, int flags);
 int shim_do_eventfd(unsigned int count);
 int shim_do_getcpu(unsigned* cpu, unsigned* node, struct getcpu_cache* unused);
+ssize_t shim_do_copy_file_range(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out,
+                                size_t len, unsigned int flags);
 
 /* libos call implementation */
 int shim_do_msgpersist(int msqid, int cmd);
@@ -723,10 +781,10 @@ int shim_sched_getaffinity(pid_t pid, size_t len, __kernel_cpu_set_t* user_mask_
 #if defined(__i386__) || defined(__x86_64__)
 int shim_set_thread_area(struct user_desc* u_info);
 #endif
-int shim_io_setup(unsigned nr_reqs, aio_context_t* ctx);
-int shim_io_destroy(aio_context_t ctx);
+int shim_io_setup(unsigned int nr_events, aio_context_t* ctxp);
+int shim_io_destroy(aio_context_t ctx_id);
 int shim_io_getevents(aio_context_t ctx_id, long min_nr, long nr, struct io_event* events,
-                      struct timespec* timeout);
+                      struct __kernel_timespec* timeout);
 int shim_io_submit(aio_context_t ctx_id, long nr, struct iocb** iocbpp);
 int shim_io_cancel(aio_context_t ctx_id, struct iocb* iocb, struct io_event* result);
 #if defined(__i386__) || defined(__x86_64__)
@@ -799,7 +857,8 @@ int shim_ppoll(struct pollfd* fds, int nfds, struct timespec* tsp, const __sigse
 int shim_unshare(int unshare_flags);
 int shim_set_robust_list(struct robust_list_head* head, size_t len);
 int shim_get_robust_list(pid_t pid, struct robust_list_head** head, size_t* len);
-int shim_splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len, int flags);
+ssize_t shim_splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len,
+                    int flags);
 int shim_tee(int fdin, int fdout, size_t len, unsigned int flags);
 int shim_sync_file_range(int fd, loff_t offset, loff_t nbytes, int flags);
 int shim_vmsplice(int fd, const struct iovec* iov, unsigned long nr_segs, int flags);
@@ -822,10 +881,10 @@ int shim_epoll_create1(int flags);
 int shim_dup3(unsigned int oldfd, unsigned int newfd, int flags);
 int shim_pipe2(int* fildes, int flags);
 int shim_inotify_init1(int flags);
-int shim_preadv(unsigned long fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
-                unsigned long pos_h);
-int shim_pwritev(unsigned long fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
-                 unsigned long pos_h);
+ssize_t shim_preadv(int fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
+                    unsigned long pos_h);
+ssize_t shim_pwritev(int fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
+                     unsigned long pos_h);
 int shim_rt_tgsigqueueinfo(pid_t tgid, pid_t pid, int sig, siginfo_t* uinfo);
 int shim_perf_event_open(struct perf_event_attr* attr_uptr, pid_t pid, int cpu, int group_fd,
                          int flags);
@@ -833,8 +892,11 @@ ssize_t shim_recvmmsg(int sockfd, struct mmsghdr* msg, unsigned int vlen, int fl
                       struct __kernel_timespec* timeout);
 int shim_prlimit64(pid_t pid, int resource, const struct __kernel_rlimit64* new_rlim,
                    struct __kernel_rlimit64* old_rlim);
+int shim_syncfs(int fd);
 ssize_t shim_sendmmsg(int sockfd, struct mmsghdr* msg, unsigned int vlen, int flags);
 int shim_getcpu(unsigned* cpu, unsigned* node, struct getcpu_cache* unused);
+ssize_t shim_copy_file_range(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len,
+                             unsigned int flags);
 
 /* libos call wrappers */
 int shim_msgpersist(int msqid, int cmd);
@@ -45,6 +45,7 @@ struct shim_tcb {
     int                 pal_errno;
     struct debug_buf*   debug_buf;
     void*               vma_cache;
+    unsigned int        syscall_stats_tick; /* syscalls since the last timed one */
 
     /* This record is for testing the memory of user inputs.
      * If a segfault occurs with the range [start, end],
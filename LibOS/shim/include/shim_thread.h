@@ -88,11 +88,16 @@ struct shim_thread {
      * `process_pending_signals_cnt`. */
     uint64_t pending_signals;
     bool signal_handled;
+    /* signals this thread waits for in rt_sigtimedwait() (empty otherwise); protected by `lock` */
+    __sigset_t signal_waited;
     stack_t signal_altstack;
 
     /* futex robust list */
     struct robust_list_head* robust_list;
 
+    /* default NUMA memory policy of the thread (set_mempolicy()), inherited by its children */
+    struct shim_mempolicy mempolicy;
+
     PAL_HANDLE scheduler_event;
 
     struct wake_queue_node wake_queue;
@@ -118,6 +123,12 @@ struct shim_thread {
     shim_tcb_t * shim_tcb;
     void * frameptr;
 
+    /* per-thread syscall statistics, allocated on first use (if enabled) */
+    struct shim_syscall_stats* syscall_stats;
+
+    /* per-thread ring buffer of trace records, allocated on first use (if enabled) */
+    struct shim_trace_buf* trace_buf;
+
     REFTYPE ref_count;
     struct shim_lock lock;
 };
@@ -135,6 +146,9 @@ void put_signal_handles(struct shim_signal_handles* handles);
 void get_thread (struct shim_thread * thread);
 void put_thread (struct shim_thread * thread);
 
+void release_syscall_stats(struct shim_thread* thread);
+void release_trace_buf(struct shim_thread* thread);
+
 void update_fs_base (unsigned long fs_base);
 
 void debug_setprefix (shim_tcb_t * tcb);
@@ -0,0 +1,105 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_timer.h
+ *
+ * Definitions of LibOS timers. All timers of a process live in one hierarchical timer wheel
+ * (see bookkeep/shim_timer.c) and expire in the async helper thread, which sleeps until the
+ * earliest expiration and then runs the callbacks of all expired timers as one batch. Arming and
+ * cancelling a timer are O(1). Timers are embedded in the objects which own them (e.g. a timerfd
+ * handle or a POSIX timer); the owner must cancel and sync the timer before freeing it.
+ */
+
+#ifndef _SHIM_TIMER_H_
+#define _SHIM_TIMER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "list.h"
+#include "shim_types.h"
+
+struct shim_timer;
+
+/* Called in the async helper thread, without any timer locks held. `now` is the time at which
+ * the batch of expired timers was collected. The callback may re-arm its own timer (e.g. for
+ * interval timers), but must not sync it. */
+typedef void (*shim_timer_func_t)(struct shim_timer* timer, uint64_t now);
+
+DEFINE_LIST(shim_timer);
+struct shim_timer {
+    uint64_t expire;              /* absolute time in microseconds, as returned by
+                                     DkSystemTimeQuery() */
+    shim_timer_func_t func;
+    void* arg;
+    LIST_TYPE(shim_timer) list;   /* protected by the timer wheel lock */
+    uint32_t slot;                /* wheel slot of the timer, or one of TIMER_SLOT_* */
+};
+
+#define TIMER_SLOT_IDLE    UINT32_MAX        /* timer is not armed */
+#define TIMER_SLOT_EXPIRED (UINT32_MAX - 1)  /* timer expired, its callback is pending */
+
+int init_timers(void);
+
+void init_timer(struct shim_timer* timer, shim_timer_func_t func, void* arg);
+
+/* Arm `timer` to expire at absolute time `expire` (re-arming a pending timer moves it). An expire
+ * time in the past makes the timer fire as soon as possible. Returns 0 or a negated errno if the
+ * async helper thread could not be started. */
+int arm_timer(struct shim_timer* timer, uint64_t expire);
+
+/* Disarm `timer`. Returns true if the timer was pending, false if it was idle or its callback is
+ * already running. */
+bool cancel_timer(struct shim_timer* timer);
+
+/* Wait until the callback of `timer` (if running) returns. Together with cancel_timer() this
+ * guarantees that the timer is not used anymore and can be freed. */
+void sync_timer(struct shim_timer* timer);
+
+static inline bool timer_pending(struct shim_timer* timer) {
+    return __atomic_load_n(&timer->slot, __ATOMIC_RELAXED) != TIMER_SLOT_IDLE;
+}
+
+/* For an interval timer which expired at `expire` and is processed at `now`: returns the number
+ * of expirations (at least one) until `now` and stores the next expiration time in `*next`. */
+static inline uint64_t timer_expirations(uint64_t expire, uint64_t interval, uint64_t now,
+                                         uint64_t* next) {
+    uint64_t cnt = 1;
+    if (now >= expire + interval)
+        cnt += (now - expire) / interval;
+    *next = expire + cnt * interval;
+    return cnt;
+}
+
+static inline uint64_t timer_deadline(uint64_t now, uint64_t delta) {
+    return delta > UINT64_MAX - now ? UINT64_MAX : now + delta;
+}
+
+static inline bool timer_timespec_valid(const struct __kernel_timespec* ts) {
+    return ts->tv_sec >= 0 && ts->tv_nsec >= 0 && ts->tv_nsec < 1000000000L;
+}
+
+/* Rounds up, so that a timer never expires earlier than requested. */
+static inline uint64_t timer_timespec_to_us(const struct __kernel_timespec* ts) {
+    if ((uint64_t)ts->tv_sec >= UINT64_MAX / 1000000 - 1)
+        return UINT64_MAX;
+    return (uint64_t)ts->tv_sec * 1000000 + ((uint64_t)ts->tv_nsec + 999) / 1000;
+}
+
+static inline void timer_us_to_timespec(uint64_t us, struct __kernel_timespec* ts) {
+    ts->tv_sec  = us / 1000000;
+    ts->tv_nsec = (us % 1000000) * 1000;
+}
+
+/* Used by the async helper thread: returns the time at which the helper must wake up next
+ * (UINT64_MAX if there are no pending timers) and records it as the current wakeup time. */
+uint64_t timers_next_wakeup(uint64_t now);
+
+/* Used by the async helper thread: advances the wheel to `now` and runs callbacks of all timers
+ * that expired until then. */
+void run_expired_timers(uint64_t now);
+
+/* Used by the async helper thread when it exits: the next armed timer will restart it. */
+void timers_helper_exited(void);
+
+#endif /* _SHIM_TIMER_H_ */
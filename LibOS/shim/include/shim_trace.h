@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_trace.h
+ *
+ * Binary format of trace files written when `sys.trace.file` is set in the manifest (see
+ * bookkeep/shim_trace.c). This header is also used by Tools/trace_decoder.c, so it must not
+ * depend on any other Graphene header.
+ *
+ * A trace file starts with `struct shim_trace_header`, followed by fixed-size records. Records of
+ * different threads are interleaved in chunks (each thread has its own ring buffer which is flushed
+ * as a whole), so a decoder must sort them by `start_time` if it needs a global order. Names of
+ * syscalls and PAL calls are not stored in every record; instead, a TRACE_RECORD_NAME record
+ * defines the name of an ID once per process. The name record is written to the buffer of the
+ * thread which used the ID first, so it may appear in the file after records of other threads
+ * using the same ID: a decoder must collect names from the whole file before resolving IDs. If the
+ * name record is dropped, it is written again on the next use of the ID.
+ */
+
+#ifndef _SHIM_TRACE_H_
+#define _SHIM_TRACE_H_
+
+#include <stdint.h>
+
+#define SHIM_TRACE_MAGIC   "GRTRACE1"
+#define SHIM_TRACE_VERSION 1
+
+struct shim_trace_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t vmid;
+    uint32_t reserved;
+};
+
+enum {
+    /* `id` is a name ID of `kind`; `args` contain the NUL-terminated name */
+    TRACE_RECORD_NAME    = 0,
+    /* `id` is the syscall number; `args` contain the raw syscall arguments (if known) */
+    TRACE_RECORD_SYSCALL = 1,
+    /* `id` is the name ID of the PAL call */
+    TRACE_RECORD_PAL     = 2,
+    /* `ret` is the number of records of `tid` dropped because its buffer was full */
+    TRACE_RECORD_DROPPED = 3,
+};
+
+struct shim_trace_record {
+    uint64_t start_time;  /* in microseconds */
+    uint32_t duration;    /* in microseconds */
+    uint16_t type;        /* one of TRACE_RECORD_* */
+    uint16_t id;
+    uint32_t tid;
+    uint16_t kind;        /* for TRACE_RECORD_NAME: type of records which use this name */
+    uint16_t reserved;
+    int64_t  ret;
+    uint64_t args[6];
+};
+
+#endif /* _SHIM_TRACE_H_ */
@@ -283,6 +283,9 @@ struct iovec {
     size_t iov_len;     /* Length of data.  */
 };
 
+/* linux/uio.h */
+#define UIO_MAXIOV 1024
+
 /* bits/sched.h */
 /* Type for array elements in 'cpu_set_t'.  */
 typedef unsigned long int __kernel_cpu_mask;
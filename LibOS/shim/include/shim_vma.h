@@ -22,6 +22,16 @@
 
 #define VMA_COMMENT_LEN 16
 
+/* NUMA nodes are kept in 64-bit masks; nodes above that are not supported */
+#define MAX_NUMA_NODES 64
+
+/* NUMA memory policy (see mbind(2)): an MPOL_* mode, possibly with MPOL_F_* mode flags, and the
+ * mask of nodes it applies to. */
+struct shim_mempolicy {
+    int mode;
+    uint64_t nodes;
+};
+
 struct shim_vma_info {
     void* addr;
     size_t length;
@@ -29,6 +39,7 @@ struct shim_vma_info {
     int flags; // MAP_* and VMA_*
     struct shim_handle* file;
     off_t file_offset;
+    struct shim_mempolicy mempolicy;
     char comment[VMA_COMMENT_LEN];
 };
 
@@ -48,9 +59,20 @@ struct shim_vma_info {
 /* vma is backed by a file and has been protected as writable, so it has to be checkpointed during
  * migration */
 #define VMA_TAINTED 0x40000000
+/* vma is not inherited by the child on fork (set by madvise(MADV_DONTFORK)) */
+#define VMA_DONTFORK 0x01000000
 
 int init_vma(void);
 
+/* Memory bookkept with MAP_HUGETLB is aligned to the huge page size (HUGEPAGE_SIZE, or 1GB with
+ * MAP_HUGE_1GB) and allocated with the PAL_ALLOC_HUGEPAGE hint. */
+#define HUGEPAGE_SIZE (2UL * 1024 * 1024)
+
+/* Set by `sys.hugepages`: the LibOS heap, brk and anonymous mappings of at least HUGEPAGE_SIZE
+ * are then bookkept with MAP_HUGETLB. */
+extern bool g_hugepages_enabled;
+int init_hugepages(void);
+
 /*
  * Bookkeeping a removal of mapped memory. On success returns a temporary VMA pointer in
  * `tmp_vma_ptr`, which must be subsequently freed by calling `bkeep_remove_tmp_vma` - but this
@@ -72,6 +94,26 @@ void bkeep_remove_tmp_vma(void* vma);
 /* Bookkeeping a change to memory protections. */
 int bkeep_mprotect(void* addr, size_t length, int prot, bool is_internal);
 
+/* Bookkeeping a change to VMA_* flags of user memory (e.g. VMA_DONTFORK), `set_flags` are added
+ * and `clear_flags` removed. The whole range must be mapped. */
+int bkeep_vma_flags(void* addr, size_t length, int set_flags, int clear_flags);
+
+/* Bookkeeping a change to the NUMA memory policy of user memory (set by mbind()). New VMAs start
+ * with MPOL_DEFAULT. The whole range must be mapped. */
+int bkeep_vma_mempolicy(void* addr, size_t length, const struct shim_mempolicy* mempolicy);
+
+/* Hands `mempolicy` to the PAL for [`addr`, `addr` + `length`), or for the calling thread if `addr`
+ * is NULL; `move` also moves the pages already allocated. PALs which cannot control memory
+ * placement are silently ignored. */
+int apply_mempolicy(void* addr, size_t length, const struct shim_mempolicy* mempolicy, bool move);
+
+/* Calls `callback` for batches of pages in [`addr`, `addr` + `length`) together with the NUMA nodes
+ * they are placed on (PAL_IDX_POISON for pages not backed by memory yet). Returns -ENOSYS if the
+ * PAL cannot tell where memory is placed. */
+int query_page_nodes(void* addr, size_t length,
+                     int (*callback)(void** pages, PAL_IDX* nodes, size_t count, void* arg),
+                     void* arg);
+
 /*
  * Bookkeeping an allocation of memory at a fixed address. `flags` must contain either MAP_FIXED or
  * MAP_FIXED_NOREPLACE - the former forces bookkeeping and removes any overlapping VMAs, the latter
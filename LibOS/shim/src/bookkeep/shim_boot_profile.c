@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_boot_profile.c
+ *
+ * This file contains the boot-phase profiler. The PAL records the end of each of its start-up
+ * phases in the PAL control block (see PAL_BOOT_PROFILE), and shim_init() records the end of each
+ * of its initializers here (see RUN_INIT). Every phase also remembers a few counters: streams
+ * opened, bytes of trusted files hashed, pages allocated and ELF relocations processed. Phases are
+ * always recorded (it costs one time query per phase); the report is printed before the
+ * application starts if `loader.boot_profile = 1` and can be read from /proc/graphene/boot_profile.
+ */
+
+#include <shim_internal.h>
+#include <shim_ipc.h>
+#include <shim_utils.h>
+
+#include <pal.h>
+
+#define BOOT_PROFILE_MAX_PHASES 48
+
+struct boot_phase {
+    const char* name;
+    uint64_t end_time;  /* in microseconds */
+    PAL_BOOT_COUNTERS counters;
+    uint64_t relocations;
+};
+
+uint64_t g_elf_relocations = 0;
+
+/* only the first thread records phases, during shim_init() */
+static struct boot_phase g_boot_phases[BOOT_PROFILE_MAX_PHASES];
+static size_t g_boot_phases_num = 0;
+
+static const char* g_pal_phase_names[PAL_BOOT_PHASE_NUM] = {
+    [PAL_BOOT_PHASE_HOST]      = "PAL host setup",
+    [PAL_BOOT_PHASE_MANIFEST]  = "PAL manifest",
+    [PAL_BOOT_PHASE_ARGV_ENV]  = "PAL argv and environment",
+    [PAL_BOOT_PHASE_PRELOAD]   = "PAL preloaded libraries",
+    [PAL_BOOT_PHASE_EXEC]      = "PAL executable",
+    [PAL_BOOT_PHASE_HOST_INFO] = "PAL host information",
+};
+
+void record_boot_phase(const char* name) {
+    if (g_boot_phases_num == BOOT_PROFILE_MAX_PHASES)
+        return;
+
+    struct boot_phase* phase = &g_boot_phases[g_boot_phases_num++];
+    phase->name        = name;
+    phase->end_time    = DkSystemTimeQuery();
+    phase->counters    = PAL_CB(boot_profile.counters);
+    phase->relocations = g_elf_relocations;
+}
+
+#define PRINT_PROFILE(fmt, ...)                                                 \
+    do {                                                                        \
+        int _ret = snprintf(str + len, size - len, fmt, ##__VA_ARGS__);         \
+        if (_ret < 0 || (size_t)_ret >= size - len) {                           \
+            free(str);                                                          \
+            return -ENOMEM;                                                     \
+        }                                                                       \
+        len += _ret;                                                            \
+    } while (0)
+
+#define PRINT_PHASE(name, end_time, counters, relocations)                                       \
+    do {                                                                                         \
+        PRINT_PROFILE("%-28s %10lu %10lu %8lu %12lu %8lu %11lu\n", name,                         \
+                      (end_time) - start_time, (end_time) - prev_time,                           \
+                      (counters).files_opened - prev.files_opened,                               \
+                      (counters).bytes_hashed - prev.bytes_hashed,                               \
+                      (counters).pages_allocated - prev.pages_allocated,                         \
+                      (relocations) - prev_relocations);                                         \
+        prev_time        = (end_time);                                                           \
+        prev             = (counters);                                                           \
+        prev_relocations = (relocations);                                                        \
+    } while (0)
+
+/* Prints one line per start-up phase: the time since the process start at which the phase ended,
+ * the duration of the phase and the counters accumulated during the phase. */
+int get_boot_profile_report(char** out_str, size_t* out_len) {
+    size_t size = (PAL_BOOT_PHASE_NUM + BOOT_PROFILE_MAX_PHASES + 2) * 128;
+    size_t len = 0;
+
+    char* str = malloc(size);
+    if (!str)
+        return -ENOMEM;
+
+    const PAL_BOOT_PROFILE* profile = &PAL_CB(boot_profile);
+    uint64_t start_time = profile->start_time;
+    uint64_t prev_time = start_time;
+    PAL_BOOT_COUNTERS prev = { 0 };
+    uint64_t prev_relocations = 0;
+
+    PRINT_PROFILE("%-28s %10s %10s %8s %12s %8s %11s\n", "phase", "end (us)", "time (us)",
+                  "files", "hashed (B)", "pages", "relocations");
+
+    for (size_t i = 0; i < PAL_BOOT_PHASE_NUM; i++)
+        PRINT_PHASE(g_pal_phase_names[i], profile->phase_end[i], profile->phase_counters[i], 0UL);
+
+    for (size_t i = 0; i < g_boot_phases_num; i++) {
+        struct boot_phase* phase = &g_boot_phases[i];
+        PRINT_PHASE(phase->name, phase->end_time, phase->counters, phase->relocations);
+    }
+
+    PRINT_PROFILE("%-28s %10lu\n", "total", prev_time - start_time);
+
+    *out_str = str;
+    *out_len = len;
+    return 0;
+}
+
+#undef PRINT_PHASE
+#undef PRINT_PROFILE
+
+void print_boot_profile(void) {
+    char cfgbuf[CONFIG_MAX];
+
+    if (!root_config ||
+            get_config(root_config, "loader.boot_profile", cfgbuf, sizeof(cfgbuf)) <= 0 ||
+            cfgbuf[0] != '1' || cfgbuf[1])
+        return;
+
+    char* str;
+    size_t len;
+    if (get_boot_profile_report(&str, &len) < 0)
+        return;
+
+    MASTER_LOCK();
+    PAL_HANDLE hdl = __open_shim_stdio();
+    if (hdl) {
+        handle_printf(hdl, "boot profile of process %u:\n", cur_process.vmid & 0xFFFF);
+        DkStreamWrite(hdl, 0, len, str, NULL);
+    }
+    MASTER_UNLOCK();
+    free(str);
+}
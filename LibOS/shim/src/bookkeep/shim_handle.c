@@ -13,6 +13,7 @@
 #include <shim_fs.h>
 #include <shim_handle.h>
 #include <shim_internal.h>
+#include <shim_sysv.h>
 #include <shim_thread.h>
 
 static struct shim_lock handle_mgr_lock;
@@ -26,6 +27,10 @@ static struct shim_lock handle_mgr_lock;
 #define OBJ_TYPE struct shim_handle
 #include <memmgr.h>
 
+/* get_fd_handle() relies on freed handles keeping a zero reference count */
+static_assert(offsetof(struct shim_handle, ref_count) >= sizeof(((MEM_OBJ)NULL)->__list),
+              "ref_count of a freed handle is overwritten by the memory manager");
+
 static MEM_MGR handle_mgr = NULL;
 
 #define INIT_HANDLE_MAP_SIZE 32
@@ -213,10 +218,38 @@ struct shim_handle* get_fd_handle(FDTYPE fd, int* fd_flags, struct shim_handle_m
         map = get_cur_handle_map(NULL);
 
     struct shim_handle* hdl = NULL;
-    lock(&map->lock);
-    if ((hdl = __get_fd_handle(fd, fd_flags, map)))
-        get_handle(hdl);
-    unlock(&map->lock);
+
+    if (fd_flags) {
+        /* the flags must match the returned handle, so this case takes the lock */
+        lock(&map->lock);
+        if ((hdl = __get_fd_handle(fd, fd_flags, map)))
+            get_handle(hdl);
+        unlock(&map->lock);
+        return hdl;
+    }
+
+    /*
+     * Lock-free lookup. `fd_size` is published after the array, so the array we read is at least
+     * that big (an older array is still valid memory, see `struct shim_handle_map`). The handle may
+     * be detached and freed concurrently: handle memory is never returned by the memory manager and
+     * a freed handle has a zero reference count, so we take a reference only to a live handle and
+     * then check that the descriptor still refers to it.
+     */
+    if (fd >= __atomic_load_n(&map->fd_size, __ATOMIC_ACQUIRE))
+        return NULL;
+
+    struct shim_fd_handle** fds = __atomic_load_n(&map->map, __ATOMIC_ACQUIRE);
+    struct shim_fd_handle* fd_handle = __atomic_load_n(&fds[fd], __ATOMIC_ACQUIRE);
+    if (!fd_handle)
+        return NULL;
+
+    while ((hdl = __atomic_load_n(&fd_handle->handle, __ATOMIC_ACQUIRE))) {
+        if (REF_INC_NOT_ZERO(hdl->ref_count)) {
+            if (__atomic_load_n(&fd_handle->handle, __ATOMIC_ACQUIRE) == hdl)
+                break;
+            put_handle(hdl);
+        }
+    }
     return hdl;
 }
 
@@ -233,7 +266,7 @@ struct shim_handle* __detach_fd_handle(struct shim_fd_handle* fd, int* flags,
             *flags = fd->flags;
 
         fd->vfd    = FD_NULL;
-        fd->handle = NULL;
+        __atomic_store_n(&fd->handle, NULL, __ATOMIC_RELEASE);
         fd->flags  = 0;
 
         if (vfd == map->fd_top)
@@ -287,13 +320,15 @@ static int __set_new_fd_handle(struct shim_fd_handle** fdhdl, FDTYPE fd, struct
         new_handle = malloc(sizeof(struct shim_fd_handle));
         if (!new_handle)
             return -ENOMEM;
-        *fdhdl = new_handle;
+        new_handle->handle = NULL;
+        __atomic_store_n(fdhdl, new_handle, __ATOMIC_RELEASE);
     }
 
     new_handle->vfd   = fd;
     new_handle->flags = fd_flags;
     get_handle(hdl);
-    new_handle->handle = hdl;
+    /* lock-free readers (get_fd_handle()) see the handle only after the rest is set up */
+    __atomic_store_n(&new_handle->handle, hdl, __ATOMIC_RELEASE);
     return 0;
 }
 
@@ -388,17 +423,6 @@ int set_new_fd_handle_by_fd(FDTYPE fd, struct shim_handle* hdl, int fd_flags,
     if (handle_map->fd_top == FD_NULL || fd > handle_map->fd_top)
         handle_map->fd_top = fd;
 
-    struct shim_fd_handle* new_handle = handle_map->map[fd];
-
-    if (!new_handle) {
-        new_handle = malloc(sizeof(struct shim_fd_handle));
-        if (!new_handle) {
-            ret = -ENOMEM;
-            goto out;
-        }
-        handle_map->map[fd] = new_handle;
-    }
-
     ret = __set_new_fd_handle(&handle_map->map[fd], fd, hdl, fd_flags);
     if (ret < 0) {
         if (fd == handle_map->fd_top)
@@ -474,6 +498,8 @@ void put_handle(struct shim_handle* hdl) {
                 }
             }
         } else {
+            file_locks_release(hdl, /*posix=*/false);
+
             if (hdl->fs && hdl->fs->fs_ops && hdl->fs->fs_ops->close)
                 hdl->fs->fs_ops->close(hdl);
 
@@ -481,6 +507,11 @@ void put_handle(struct shim_handle* hdl) {
                 free(hdl->info.sock.peek_buffer);
                 hdl->info.sock.peek_buffer = NULL;
             }
+
+            if (hdl->type == TYPE_SEM && hdl->info.sem.shared)
+                sysv_shared_release(hdl->info.sem.shared, /*unmap=*/true);
+            if (hdl->type == TYPE_MSG && hdl->info.msg.shared)
+                sysv_shared_release(hdl->info.msg.shared, /*unmap=*/true);
         }
 
         delete_from_epoll_handles(hdl);
@@ -560,10 +591,21 @@ static int __enlarge_handle_map(struct shim_handle_map* map, size_t size) {
     if (!new_map)
         return -ENOMEM;
 
+    /* lock-free readers may still be using the old array, free it only with the map */
+    struct shim_fd_map_retired* retired = malloc(sizeof(*retired));
+    if (!retired) {
+        free(new_map);
+        return -ENOMEM;
+    }
+
     memcpy(new_map, map->map, map->fd_size * sizeof(new_map[0]));
-    free(map->map);
-    map->map     = new_map;
-    map->fd_size = size;
+    retired->map  = map->map;
+    retired->next = map->retired;
+    map->retired  = retired;
+
+    /* the array must be published before the size, see get_fd_handle() */
+    __atomic_store_n(&map->map, new_map, __ATOMIC_RELEASE);
+    __atomic_store_n(&map->fd_size, size, __ATOMIC_RELEASE);
     return 0;
 }
 
@@ -645,6 +687,12 @@ void put_handle_map(struct shim_handle_map* map) {
         }
 
     done:
+        while (map->retired) {
+            struct shim_fd_map_retired* retired = map->retired;
+            map->retired = retired->next;
+            free(retired->map);
+            free(retired);
+        }
         destroy_lock(&map->lock);
         free(map->map);
         free(map);
@@ -743,6 +791,13 @@ BEGIN_CP_FUNC(handle) {
         if (hdl->type == TYPE_EPOLL)
             DO_CP(epoll_item, &hdl->info.epoll.fds, &new_hdl->info.epoll.fds);
 
+        if (hdl->type == TYPE_MQUEUE && hdl->info.mqueue.obj) {
+            /* the child maps the queue segment from the same stream, see shim_mqueue.c */
+            struct shim_palhdl_entry* entry;
+            DO_CP(palhdl, hdl->info.mqueue.obj->pal_handle, &entry);
+            entry->phandle = &new_hdl->info.mqueue.migrated;
+        }
+
         if (hdl->type == TYPE_SOCK) {
             /* no support for multiple processes sharing options/peek buffer of the socket */
             new_hdl->info.sock.pending_options = NULL;
@@ -843,6 +898,7 @@ BEGIN_CP_FUNC(handle_map) {
 
         new_handle_map->fd_size = fd_size;
         new_handle_map->map     = fd_size ? ptr_array : NULL;
+        new_handle_map->retired = NULL;
 
         REF_SET(new_handle_map->ref_count, 0);
         clear_lock(&new_handle_map->lock);
@@ -153,6 +153,7 @@ static bool append_thread_signal(struct shim_thread* thread, struct shim_signal*
     bool ret = queue_append_signal(&thread->signal_queue, signal);
     if (ret) {
         (void)__atomic_add_fetch(&thread->pending_signals, 1, __ATOMIC_RELEASE);
+        signalfd_notify(signal->info.si_signo);
     }
     return ret;
 }
@@ -161,6 +162,7 @@ static bool append_process_signal(struct shim_signal* signal) {
     bool ret = queue_append_signal(&process_signal_queue, signal);
     if (ret) {
         (void)__atomic_add_fetch(&process_pending_signals_cnt, 1, __ATOMIC_RELEASE);
+        signalfd_notify(signal->info.si_signo);
     }
     return ret;
 }
@@ -211,6 +213,32 @@ static struct shim_signal* process_pop_signal(int sig) {
     return signal;
 }
 
+int pop_pending_signal(struct shim_thread* thread, const __sigset_t* mask, siginfo_t* info) {
+    if (__atomic_load_n(&thread->pending_signals, __ATOMIC_ACQUIRE) == 0
+            && __atomic_load_n(&process_pending_signals_cnt, __ATOMIC_ACQUIRE) == 0) {
+        return 0;
+    }
+
+    for (int sig = 1; sig <= NUM_SIGS; sig++) {
+        if (!__sigismember(mask, sig)) {
+            continue;
+        }
+
+        struct shim_signal* signal = thread_pop_signal(thread, sig);
+        if (!signal) {
+            signal = process_pop_signal(sig);
+        }
+        if (signal) {
+            if (info) {
+                memcpy(info, &signal->info, sizeof(*info));
+            }
+            free(signal);
+            return sig;
+        }
+    }
+    return 0;
+}
+
 static void __handle_one_signal(shim_tcb_t* tcb, struct shim_signal* signal);
 
 static void __store_info (siginfo_t * info, struct shim_signal * signal)
@@ -269,6 +297,9 @@ void deliver_signal (siginfo_t * info, PAL_CONTEXT * context)
                 debug("Signal %d queue of thread %u is full, dropping the incoming signal\n",
                       sig, tcb->tid);
                 free(signal);
+            } else if (__sigismember(&cur_thread->signal_waited, sig)) {
+                /* we may have interrupted the wait of rt_sigtimedwait() */
+                thread_wakeup(cur_thread);
             }
         }
     } else {
@@ -0,0 +1,280 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_syscall_stats.c
+ *
+ * This file contains bookkeeping of per-syscall counters and latency histograms. Statistics are
+ * recorded by BEGIN_SHIM/END_SHIM into per-thread tables (without any locking) and aggregated
+ * only when they are read, i.e. in /proc/graphene/syscall_stats and in the report printed at
+ * process exit. Tables of exited threads are merged into a process-wide table.
+ *
+ * Every syscall is counted, but only every `sys.syscall_stats_sample`th syscall of a thread is
+ * timed (see syscall_start_time()); total time is extrapolated from the timed syscalls.
+ */
+
+#include <shim_internal.h>
+#include <shim_ipc.h>
+#include <shim_thread.h>
+#include <shim_unistd_defs.h>
+#include <shim_utils.h>
+
+#include <pal.h>
+
+/* bucket 0 counts syscalls which took less than 1us, bucket N counts syscalls which took
+ * [2^(N-1), 2^N) us, the last bucket also counts everything longer */
+#define SYSCALL_STATS_BUCKETS 24
+
+/* time every 16th syscall by default */
+#define SYSCALL_STATS_SAMPLE_DEFAULT 16
+
+struct syscall_stat {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t timed; /* number of syscalls included in `time` and `hist` */
+    uint64_t time;  /* in microseconds */
+    uint32_t hist[SYSCALL_STATS_BUCKETS];
+};
+
+struct shim_syscall_stats {
+    struct syscall_stat stat[LIBOS_SYSCALL_BOUND];
+};
+
+bool g_syscall_stats_enabled = false;
+unsigned int g_syscall_stats_sample = SYSCALL_STATS_SAMPLE_DEFAULT;
+static bool g_syscall_stats_report = false;
+
+/* syscall names are filled in by record_syscall_stats() */
+static const char* g_syscall_names[LIBOS_SYSCALL_BOUND];
+
+/* statistics of exited threads */
+static struct shim_syscall_stats* g_exited_stats = NULL;
+static struct shim_lock g_syscall_stats_lock;
+
+int init_syscall_stats(void) {
+    char cfgbuf[CONFIG_MAX];
+
+    if (!root_config)
+        return 0;
+
+    if (get_config(root_config, "sys.syscall_stats_report", cfgbuf, sizeof(cfgbuf)) > 0 &&
+            cfgbuf[0] == '1' && !cfgbuf[1])
+        g_syscall_stats_report = true;
+
+    if (!g_syscall_stats_report &&
+            (get_config(root_config, "sys.syscall_stats", cfgbuf, sizeof(cfgbuf)) <= 0 ||
+             cfgbuf[0] != '1' || cfgbuf[1]))
+        return 0;
+
+    if (get_config(root_config, "sys.syscall_stats_sample", cfgbuf, sizeof(cfgbuf)) > 0) {
+        int sample = atoi(cfgbuf);
+        if (sample <= 0) {
+            debug("sys.syscall_stats_sample must be a positive number\n");
+            return -EINVAL;
+        }
+        g_syscall_stats_sample = sample;
+    }
+
+    g_exited_stats = calloc(1, sizeof(*g_exited_stats));
+    if (!g_exited_stats)
+        return -ENOMEM;
+
+    if (!create_lock(&g_syscall_stats_lock)) {
+        free(g_exited_stats);
+        g_exited_stats = NULL;
+        return -ENOMEM;
+    }
+
+    g_syscall_stats_enabled = true;
+    return 0;
+}
+
+void record_syscall_stats(int sysno, const char* name, long ret, unsigned long start_time,
+                          unsigned long end_time) {
+    if (sysno < 0 || sysno >= LIBOS_SYSCALL_BOUND)
+        return;
+
+    struct shim_thread* cur_thread = get_cur_thread();
+    if (!cur_thread)
+        return;
+
+    struct shim_syscall_stats* stats = cur_thread->syscall_stats;
+    if (!stats) {
+        stats = calloc(1, sizeof(*stats));
+        if (!stats)
+            return;
+        /* other threads may read the statistics concurrently, see collect_thread_stats() */
+        __atomic_store_n(&cur_thread->syscall_stats, stats, __ATOMIC_RELEASE);
+    }
+
+    if (!g_syscall_names[sysno])
+        g_syscall_names[sysno] = name;
+
+    struct syscall_stat* stat = &stats->stat[sysno];
+    stat->count++;
+    if ((unsigned long)ret >= (unsigned long)-4095L)
+        stat->errors++;
+
+    /* this syscall was not sampled for timing */
+    if (!start_time)
+        return;
+
+    unsigned long time = end_time > start_time ? end_time - start_time : 0;
+    size_t bucket = time ? 64 - __builtin_clzl(time) : 0;
+    if (bucket >= SYSCALL_STATS_BUCKETS)
+        bucket = SYSCALL_STATS_BUCKETS - 1;
+
+    stat->timed++;
+    stat->time += time;
+    stat->hist[bucket]++;
+}
+
+/* total time spent in a syscall, extrapolated from the timed calls */
+static uint64_t syscall_stat_total_time(const struct syscall_stat* stat) {
+    if (!stat->timed)
+        return 0;
+    return stat->time * stat->count / stat->timed;
+}
+
+static void add_syscall_stats(struct shim_syscall_stats* to, struct shim_syscall_stats* from) {
+    for (size_t i = 0; i < LIBOS_SYSCALL_BOUND; i++) {
+        struct syscall_stat* dst = &to->stat[i];
+        struct syscall_stat* src = &from->stat[i];
+        if (!src->count)
+            continue;
+
+        dst->count  += src->count;
+        dst->errors += src->errors;
+        dst->timed  += src->timed;
+        dst->time   += src->time;
+        for (size_t j = 0; j < SYSCALL_STATS_BUCKETS; j++)
+            dst->hist[j] += src->hist[j];
+    }
+}
+
+void release_syscall_stats(struct shim_thread* thread) {
+    struct shim_syscall_stats* stats = thread->syscall_stats;
+    if (!stats)
+        return;
+
+    lock(&g_syscall_stats_lock);
+    add_syscall_stats(g_exited_stats, stats);
+    unlock(&g_syscall_stats_lock);
+
+    thread->syscall_stats = NULL;
+    free(stats);
+}
+
+static int collect_thread_stats(struct shim_thread* thread, void* arg) {
+    struct shim_syscall_stats* stats = __atomic_load_n(&thread->syscall_stats, __ATOMIC_ACQUIRE);
+    if (!stats)
+        return 0;
+
+    add_syscall_stats(arg, stats);
+    return 1;
+}
+
+#define PRINT_STATS(fmt, ...)                                                   \
+    do {                                                                        \
+        int _ret = snprintf(str + len, size - len, fmt, ##__VA_ARGS__);         \
+        if (_ret < 0 || (size_t)_ret >= size - len) {                           \
+            ret = -ENOMEM;                                                      \
+            goto out;                                                           \
+        }                                                                       \
+        len += _ret;                                                            \
+    } while (0)
+
+/* Prints the aggregated statistics of all threads of the current process, sorted by the total
+ * time spent in a syscall. */
+int get_syscall_stats_report(char** out_str, size_t* out_len) {
+    /* one line per syscall, one header line */
+    size_t size = (LIBOS_SYSCALL_BOUND + 1) * (90 + SYSCALL_STATS_BUCKETS * 20);
+    size_t len = 0;
+    int ret = 0;
+    struct shim_syscall_stats* stats = NULL;
+
+    char* str = malloc(size);
+    if (!str)
+        return -ENOMEM;
+
+    PRINT_STATS("%-20s %10s %10s %10s %14s %10s  %s\n", "syscall", "calls", "errors", "timed",
+                "total (us)", "avg (us)", "latency histogram (timed calls per bucket)");
+
+    if (!g_syscall_stats_enabled)
+        goto out;
+
+    stats = calloc(1, sizeof(*stats));
+    if (!stats) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    lock(&g_syscall_stats_lock);
+    add_syscall_stats(stats, g_exited_stats);
+    unlock(&g_syscall_stats_lock);
+    walk_thread_list(&collect_thread_stats, stats, /*one_shot=*/false);
+
+    /* selection sort is good enough for a few hundred entries which are printed rarely */
+    bool printed[LIBOS_SYSCALL_BOUND] = { false };
+    while (true) {
+        int max = -1;
+        for (int i = 0; i < LIBOS_SYSCALL_BOUND; i++) {
+            if (!printed[i] && stats->stat[i].count &&
+                    (max < 0 || syscall_stat_total_time(&stats->stat[i]) >
+                                syscall_stat_total_time(&stats->stat[max])))
+                max = i;
+        }
+        if (max < 0)
+            break;
+
+        printed[max] = true;
+        struct syscall_stat* stat = &stats->stat[max];
+        const char* name = g_syscall_names[max] ? : "unknown";
+
+        PRINT_STATS("%-20s %10lu %10lu %10lu %14lu %10lu ", name, stat->count, stat->errors,
+                    stat->timed, syscall_stat_total_time(stat),
+                    stat->timed ? stat->time / stat->timed : 0);
+
+        for (size_t j = 0; j < SYSCALL_STATS_BUCKETS; j++) {
+            if (!stat->hist[j])
+                continue;
+            if (j == SYSCALL_STATS_BUCKETS - 1) {
+                PRINT_STATS(" >=%luus:%u", 1UL << (j - 1), stat->hist[j]);
+            } else {
+                PRINT_STATS(" <%luus:%u", 1UL << j, stat->hist[j]);
+            }
+        }
+        PRINT_STATS("\n");
+    }
+
+out:
+    free(stats);
+    if (ret < 0) {
+        free(str);
+        return ret;
+    }
+
+    *out_str = str;
+    *out_len = len;
+    return 0;
+}
+
+#undef PRINT_STATS
+
+void print_syscall_stats(void) {
+    if (!g_syscall_stats_enabled || !g_syscall_stats_report)
+        return;
+
+    char* str;
+    size_t len;
+    if (get_syscall_stats_report(&str, &len) < 0)
+        return;
+
+    MASTER_LOCK();
+    PAL_HANDLE hdl = __open_shim_stdio();
+    if (hdl) {
+        handle_printf(hdl, "syscall statistics of process %u:\n", cur_process.vmid & 0xFFFF);
+        DkStreamWrite(hdl, 0, len, str, NULL);
+    }
+    MASTER_UNLOCK();
+    free(str);
+}
@@ -20,7 +20,9 @@
 #include <cpu.h>
 #include <list.h>
 #include <pal.h>
+#include <spinlock.h>
 
+#include <linux/mempolicy.h>
 #include <linux/signal.h>
 
 static IDTYPE tid_alloc_idx __attribute_migratable = 0;
@@ -133,12 +135,7 @@ static IDTYPE get_internal_pid (void)
     return idx;
 }
 
-static struct shim_thread * alloc_new_thread (void)
-{
-    struct shim_thread * thread = calloc(1, sizeof(struct shim_thread));
-    if (!thread)
-        return NULL;
-
+static void init_thread_object(struct shim_thread* thread) {
     REF_SET(thread->ref_count, 1);
     INIT_LISTP(&thread->children);
     INIT_LIST_HEAD(thread, siblings);
@@ -146,9 +143,86 @@ static struct shim_thread * alloc_new_thread (void)
     INIT_LIST_HEAD(thread, list);
     /* default value as sigalt stack isn't specified yet */
     thread->signal_altstack.ss_flags = SS_DISABLE;
+}
+
+static struct shim_thread * alloc_new_thread (void)
+{
+    struct shim_thread * thread = calloc(1, sizeof(struct shim_thread));
+    if (!thread)
+        return NULL;
+
+    init_thread_object(thread);
+    return thread;
+}
+
+/* Freed thread objects (of internal threads, too) are cached together with their lock and PAL
+ * events, which are expensive to create, and reused by get_new_thread(). */
+#define THREAD_CACHE_SIZE 32
+
+static struct shim_thread* thread_cache[THREAD_CACHE_SIZE];
+static size_t thread_cache_num = 0;
+static spinlock_t thread_cache_lock = INIT_SPINLOCK_UNLOCKED;
+
+static struct shim_thread* alloc_cached_thread(void) {
+    struct shim_thread* thread = NULL;
+
+    spinlock_lock(&thread_cache_lock);
+    if (thread_cache_num)
+        thread = thread_cache[--thread_cache_num];
+    spinlock_unlock(&thread_cache_lock);
+
+    if (!thread)
+        return alloc_new_thread();
+
+    struct shim_lock thread_lock = thread->lock;
+    PAL_HANDLE scheduler_event   = thread->scheduler_event;
+    PAL_HANDLE exit_event        = thread->exit_event;
+    PAL_HANDLE child_exit_event  = thread->child_exit_event;
+
+    memset(thread, 0, sizeof(*thread));
+    init_thread_object(thread);
+
+    /* bring the events to the same state as freshly created ones */
+    DkEventSet(scheduler_event);
+    DkEventClear(exit_event);
+    DkEventClear(child_exit_event);
+
+    thread->lock             = thread_lock;
+    thread->scheduler_event  = scheduler_event;
+    thread->exit_event       = exit_event;
+    thread->child_exit_event = child_exit_event;
     return thread;
 }
 
+/* Frees the thread object itself; all references held by the thread must be already released. */
+static void free_thread_object(struct shim_thread* thread) {
+    if (lock_created(&thread->lock) && thread->scheduler_event && thread->exit_event &&
+            thread->child_exit_event) {
+        spinlock_lock(&thread_cache_lock);
+        if (thread_cache_num < THREAD_CACHE_SIZE) {
+            thread_cache[thread_cache_num++] = thread;
+            thread = NULL;
+        }
+        spinlock_unlock(&thread_cache_lock);
+
+        if (!thread)
+            return;
+    }
+
+    if (thread->scheduler_event)
+        DkObjectClose(thread->scheduler_event);
+    if (thread->exit_event)
+        DkObjectClose(thread->exit_event);
+    if (thread->child_exit_event)
+        DkObjectClose(thread->child_exit_event);
+
+    if (lock_created(&thread->lock)) {
+        destroy_lock(&thread->lock);
+    }
+
+    free(thread);
+}
+
 static struct shim_signal_handles* alloc_default_signal_handles(void) {
         struct shim_signal_handles* handles = malloc(sizeof(*handles));
         if (!handles) {
@@ -177,7 +251,7 @@ struct shim_thread * get_new_thread (IDTYPE new_tid)
         }
     }
 
-    struct shim_thread * thread = alloc_new_thread();
+    struct shim_thread * thread = alloc_cached_thread();
     if (!thread) {
         release_pid(new_tid);
         return NULL;
@@ -203,6 +277,7 @@ struct shim_thread * get_new_thread (IDTYPE new_tid)
         thread->cwd         = cur_thread->cwd;
         thread->root        = cur_thread->root;
         thread->umask       = cur_thread->umask;
+        thread->mempolicy   = cur_thread->mempolicy;
         thread->exec        = cur_thread->exec;
         get_handle(cur_thread->exec);
 
@@ -240,14 +315,17 @@ struct shim_thread * get_new_thread (IDTYPE new_tid)
         }
     }
 
-    if (!create_lock(&thread->lock)) {
+    if (!lock_created(&thread->lock) && !create_lock(&thread->lock)) {
         goto out_error;
     }
 
     thread->vmid = cur_process.vmid;
-    thread->scheduler_event = DkNotificationEventCreate(PAL_TRUE);
-    thread->exit_event = DkNotificationEventCreate(PAL_FALSE);
-    thread->child_exit_event = DkNotificationEventCreate(PAL_FALSE);
+    if (!thread->scheduler_event)
+        thread->scheduler_event = DkNotificationEventCreate(PAL_TRUE);
+    if (!thread->exit_event)
+        thread->exit_event = DkNotificationEventCreate(PAL_FALSE);
+    if (!thread->child_exit_event)
+        thread->child_exit_event = DkNotificationEventCreate(PAL_FALSE);
     return thread;
 
 out_error:
@@ -267,7 +345,7 @@ out_error:
         put_handle(thread->exec);
     }
     release_pid(new_tid);
-    free(thread);
+    free_thread_object(thread);
     return NULL;
 }
 
@@ -324,13 +402,6 @@ void put_thread(struct shim_thread* thread) {
             thread->pal_handle != PAL_CB(first_thread))
             DkObjectClose(thread->pal_handle);
 
-        if (thread->scheduler_event)
-            DkObjectClose(thread->scheduler_event);
-        if (thread->exit_event)
-            DkObjectClose(thread->exit_event);
-        if (thread->child_exit_event)
-            DkObjectClose(thread->child_exit_event);
-
         if (thread->handle_map) {
             put_handle_map(thread->handle_map);
         }
@@ -351,11 +422,12 @@ void put_thread(struct shim_thread* thread) {
         if (!is_internal(thread))
             release_pid(thread->tid);
 
-        if (lock_created(&thread->lock)) {
-            destroy_lock(&thread->lock);
-        }
+        if (thread->syscall_stats)
+            release_syscall_stats(thread);
+        if (thread->trace_buf)
+            release_trace_buf(thread);
 
-        free(thread);
+        free_thread_object(thread);
     }
 }
 
@@ -596,6 +668,8 @@ BEGIN_CP_FUNC(thread)
         new_thread->cwd    = NULL;
         memset(&new_thread->signal_queue, 0, sizeof(new_thread->signal_queue));
         new_thread->robust_list = NULL;
+        new_thread->syscall_stats = NULL;
+        new_thread->trace_buf = NULL;
         REF_SET(new_thread->ref_count, 0);
 
         DO_CP_MEMBER(signal_handles, thread, new_thread, signal_handles);
@@ -773,6 +847,10 @@ BEGIN_RS_FUNC(running_thread)
 
         thread->in_vm = thread->is_alive = true;
         thread->pal_handle = PAL_CB(first_thread);
+
+        /* the host process of the child starts with the default policy */
+        if (thread->mempolicy.mode != MPOL_DEFAULT)
+            apply_mempolicy(/*addr=*/NULL, /*length=*/0, &thread->mempolicy, /*move=*/false);
     }
 
     DEBUG_RS("tid=%d", thread->tid);
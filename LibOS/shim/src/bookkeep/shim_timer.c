@@ -0,0 +1,213 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_timer.c
+ *
+ * This file contains the hierarchical timer wheel which backs all LibOS timers (alarm(),
+ * setitimer(), POSIX timers, timerfd and internal periodic events).
+ *
+ * Time is measured in microseconds. The wheel has WHEEL_LEVELS levels of WHEEL_SLOTS slots each;
+ * a slot on level L covers 64^L microseconds, so 11 levels cover the whole 64-bit time range and
+ * no overflow list is needed. A timer is stored on the level of the most significant 6-bit digit
+ * in which its expiration time differs from `base` (the time up to which the wheel has been
+ * advanced), in the slot given by the value of that digit. Consequently, all timers on a lower
+ * level expire before all timers on a higher level, and the earliest timer is in the lowest
+ * occupied slot of the lowest occupied level. Advancing the wheel pops this slot and either
+ * expires its timers or re-inserts them on lower levels (each timer moves down at most
+ * WHEEL_LEVELS times during its lifetime). Arming and cancelling are O(1): a list insertion or
+ * removal plus a bit flip in the per-level occupancy bitmap.
+ */
+
+#include "shim_internal.h"
+#include "shim_timer.h"
+#include "shim_utils.h"
+
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS     (1U << WHEEL_SLOT_BITS)
+#define WHEEL_LEVELS    11
+
+DEFINE_LISTP(shim_timer);
+
+static struct {
+    struct shim_lock lock;
+    uint64_t base;                  /* all timers in the wheel expire after `base` */
+    uint64_t wakeup;                /* when the async helper looks at the wheel next */
+    uint64_t occupied[WHEEL_LEVELS];
+    LISTP_TYPE(shim_timer) slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    LISTP_TYPE(shim_timer) expired; /* expired timers whose callbacks did not run yet */
+    struct shim_timer* running;     /* timer whose callback is running right now */
+} g_wheel;
+
+int init_timers(void) {
+    if (!create_lock(&g_wheel.lock))
+        return -ENOMEM;
+
+    uint64_t now = DkSystemTimeQuery();
+    if ((int64_t)now < 0)
+        return (int64_t)now;
+
+    g_wheel.base   = now;
+    g_wheel.wakeup = UINT64_MAX;
+    return 0;
+}
+
+void init_timer(struct shim_timer* timer, shim_timer_func_t func, void* arg) {
+    timer->expire = 0;
+    timer->func   = func;
+    timer->arg    = arg;
+    timer->slot   = TIMER_SLOT_IDLE;
+    INIT_LIST_HEAD(timer, list);
+}
+
+static void wheel_insert(struct shim_timer* timer) {
+    assert(locked(&g_wheel.lock));
+
+    if (timer->expire <= g_wheel.base) {
+        LISTP_ADD_TAIL(timer, &g_wheel.expired, list);
+        __atomic_store_n(&timer->slot, TIMER_SLOT_EXPIRED, __ATOMIC_RELAXED);
+        return;
+    }
+
+    unsigned int level = (63 - __builtin_clzl(timer->expire ^ g_wheel.base)) / WHEEL_SLOT_BITS;
+    unsigned int slot  = (timer->expire >> (level * WHEEL_SLOT_BITS)) & (WHEEL_SLOTS - 1);
+
+    LISTP_ADD_TAIL(timer, &g_wheel.slots[level][slot], list);
+    g_wheel.occupied[level] |= 1UL << slot;
+    __atomic_store_n(&timer->slot, level * WHEEL_SLOTS + slot, __ATOMIC_RELAXED);
+}
+
+static void wheel_remove(struct shim_timer* timer) {
+    assert(locked(&g_wheel.lock));
+
+    if (timer->slot == TIMER_SLOT_EXPIRED) {
+        LISTP_DEL_INIT(timer, &g_wheel.expired, list);
+    } else {
+        unsigned int level = timer->slot / WHEEL_SLOTS;
+        unsigned int slot  = timer->slot % WHEEL_SLOTS;
+        LISTP_DEL_INIT(timer, &g_wheel.slots[level][slot], list);
+        if (LISTP_EMPTY(&g_wheel.slots[level][slot]))
+            g_wheel.occupied[level] &= ~(1UL << slot);
+    }
+    __atomic_store_n(&timer->slot, TIMER_SLOT_IDLE, __ATOMIC_RELAXED);
+}
+
+/* Returns a lower bound of the earliest expiration time in the wheel (exact if the timer is on
+ * level 0) and the slot containing it, or UINT64_MAX if the wheel is empty. */
+static uint64_t wheel_earliest(unsigned int* out_level, unsigned int* out_slot) {
+    assert(locked(&g_wheel.lock));
+
+    for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+        if (!g_wheel.occupied[level])
+            continue;
+
+        unsigned int slot  = __builtin_ctzl(g_wheel.occupied[level]);
+        unsigned int shift = level * WHEEL_SLOT_BITS;
+        unsigned int upper = shift + WHEEL_SLOT_BITS;
+        uint64_t prefix = upper >= 64 ? 0 : (g_wheel.base >> upper) << upper;
+
+        *out_level = level;
+        *out_slot  = slot;
+        return prefix | ((uint64_t)slot << shift);
+    }
+    return UINT64_MAX;
+}
+
+/* Moves all timers which expire until `now` to the expired list. */
+static void wheel_advance(uint64_t now) {
+    assert(locked(&g_wheel.lock));
+
+    while (true) {
+        unsigned int level = 0;
+        unsigned int slot  = 0;
+        uint64_t earliest = wheel_earliest(&level, &slot);
+        if (earliest > now) {
+            if (now > g_wheel.base)
+                g_wheel.base = now;
+            break;
+        }
+
+        g_wheel.base = earliest;
+
+        LISTP_TYPE(shim_timer) cascade = g_wheel.slots[level][slot];
+        INIT_LISTP(&g_wheel.slots[level][slot]);
+        g_wheel.occupied[level] &= ~(1UL << slot);
+
+        struct shim_timer* timer;
+        struct shim_timer* tmp;
+        LISTP_FOR_EACH_ENTRY_SAFE(timer, tmp, &cascade, list) {
+            LISTP_DEL_INIT(timer, &cascade, list);
+            wheel_insert(timer);
+        }
+    }
+}
+
+int arm_timer(struct shim_timer* timer, uint64_t expire) {
+    lock(&g_wheel.lock);
+    if (timer->slot != TIMER_SLOT_IDLE)
+        wheel_remove(timer);
+    timer->expire = expire;
+    wheel_insert(timer);
+    /* the helper sleeps until `wakeup` and must only be woken up if this timer is earlier; it
+     * re-reads the wheel after waking up, so later timers armed meanwhile need not wake it again */
+    bool wake = expire < g_wheel.wakeup;
+    if (wake)
+        g_wheel.wakeup = expire;
+    unlock(&g_wheel.lock);
+
+    return wake ? wake_async_helper() : 0;
+}
+
+bool cancel_timer(struct shim_timer* timer) {
+    if (!timer_pending(timer))
+        return false;
+
+    lock(&g_wheel.lock);
+    bool pending = timer->slot != TIMER_SLOT_IDLE;
+    if (pending)
+        wheel_remove(timer);
+    unlock(&g_wheel.lock);
+    return pending;
+}
+
+void sync_timer(struct shim_timer* timer) {
+    while (__atomic_load_n(&g_wheel.running, __ATOMIC_ACQUIRE) == timer)
+        DkThreadYieldExecution();
+}
+
+uint64_t timers_next_wakeup(uint64_t now) {
+    lock(&g_wheel.lock);
+    uint64_t wakeup;
+    if (!LISTP_EMPTY(&g_wheel.expired)) {
+        wakeup = now;
+    } else {
+        unsigned int level, slot;
+        wakeup = wheel_earliest(&level, &slot);
+    }
+    g_wheel.wakeup = wakeup;
+    unlock(&g_wheel.lock);
+    return wakeup;
+}
+
+void run_expired_timers(uint64_t now) {
+    lock(&g_wheel.lock);
+    wheel_advance(now);
+
+    while (!LISTP_EMPTY(&g_wheel.expired)) {
+        struct shim_timer* timer = LISTP_FIRST_ENTRY(&g_wheel.expired, struct shim_timer, list);
+        wheel_remove(timer);
+        __atomic_store_n(&g_wheel.running, timer, __ATOMIC_RELAXED);
+        unlock(&g_wheel.lock);
+
+        timer->func(timer, now);
+
+        lock(&g_wheel.lock);
+        __atomic_store_n(&g_wheel.running, NULL, __ATOMIC_RELEASE);
+    }
+    unlock(&g_wheel.lock);
+}
+
+void timers_helper_exited(void) {
+    lock(&g_wheel.lock);
+    g_wheel.wakeup = UINT64_MAX;
+    unlock(&g_wheel.lock);
+}
@@ -0,0 +1,303 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_trace.c
+ *
+ * This file contains the binary tracer of syscalls and PAL calls. Every application thread writes
+ * fixed-size records (see shim_trace.h) into its own ring buffer, without taking any locks; the
+ * async helper thread periodically flushes all buffers to the host file `sys.trace.file` (with
+ * the process ID appended). If a buffer is full, new records of that thread are dropped and only
+ * counted. Use Tools/trace_decoder to convert the file into text or Chrome trace JSON.
+ */
+
+#include <shim_internal.h>
+#include <shim_ipc.h>
+#include <shim_tcb.h>
+#include <shim_thread.h>
+#include <shim_trace.h>
+#include <shim_unistd_defs.h>
+#include <shim_utils.h>
+
+#include <pal.h>
+
+#define TRACE_FLUSH_INTERVAL  100000  /* in microseconds */
+#define TRACE_DEFAULT_RECORDS 4096
+#define TRACE_MAX_PAL_NAMES   256
+
+struct shim_trace_buf {
+    struct shim_trace_buf* next;  /* protected by g_trace_lock */
+    IDTYPE tid;
+    bool dead;                    /* owner thread was freed; protected by g_trace_lock */
+    uint64_t head;                /* written only by the owner thread */
+    uint64_t tail;                /* written only by flush_trace() */
+    uint64_t dropped;
+    struct shim_trace_record records[];
+};
+
+bool g_trace_enabled = false;
+static size_t g_trace_records = TRACE_DEFAULT_RECORDS;
+
+static struct shim_lock g_trace_lock;
+static struct shim_trace_buf* g_trace_bufs = NULL;
+static PAL_HANDLE g_trace_handle = NULL;
+static uint64_t g_trace_offset = 0;
+
+/* names are written into the trace only once per process */
+static bool g_syscall_name_traced[LIBOS_SYSCALL_BOUND];
+static const char* g_pal_call_names[TRACE_MAX_PAL_NAMES];
+static bool g_pal_name_traced[TRACE_MAX_PAL_NAMES];
+
+/* returns false if the record was dropped because the buffer is full */
+static bool trace_write(struct shim_trace_buf* buf, const struct shim_trace_record* record) {
+    uint64_t head = buf->head;
+    if (head - __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE) >= g_trace_records) {
+        __atomic_add_fetch(&buf->dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    buf->records[head % g_trace_records] = *record;
+    __atomic_store_n(&buf->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Writes the name record of `id` unless it was already written by some thread (as recorded in
+ * `*traced`). If the record is dropped, `*traced` is reset so that the next use of `id` retries. */
+static void trace_write_name(struct shim_trace_buf* buf, bool* traced, uint16_t kind, uint16_t id,
+                             const char* name) {
+    if (__atomic_exchange_n(traced, true, __ATOMIC_RELAXED))
+        return;
+
+    struct shim_trace_record record = {
+        .type = TRACE_RECORD_NAME,
+        .id   = id,
+        .tid  = buf->tid,
+        .kind = kind,
+    };
+
+    size_t len = strlen(name);
+    if (len >= sizeof(record.args))
+        len = sizeof(record.args) - 1;
+    memcpy(record.args, name, len);
+
+    if (!trace_write(buf, &record))
+        __atomic_store_n(traced, false, __ATOMIC_RELAXED);
+}
+
+/* Returns the trace buffer of the current thread, or NULL if the current thread is not traced.
+ * The buffer is allocated only if `alloc` is true: allocation itself may invoke PAL calls, so this
+ * must not happen on the path of the PAL call tracer. */
+static struct shim_trace_buf* get_trace_buf(bool alloc) {
+    struct shim_thread* cur_thread = get_cur_thread();
+    if (!cur_thread || is_internal(cur_thread))
+        return NULL;
+
+    struct shim_trace_buf* buf = cur_thread->trace_buf;
+    if (buf || !alloc)
+        return buf;
+
+    buf = malloc(sizeof(*buf) + g_trace_records * sizeof(struct shim_trace_record));
+    if (!buf)
+        return NULL;
+
+    buf->tid     = cur_thread->tid;
+    buf->dead    = false;
+    buf->head    = 0;
+    buf->tail    = 0;
+    buf->dropped = 0;
+
+    lock(&g_trace_lock);
+    buf->next = g_trace_bufs;
+    g_trace_bufs = buf;
+    unlock(&g_trace_lock);
+
+    cur_thread->trace_buf = buf;
+    return buf;
+}
+
+void record_syscall_trace(int sysno, const char* name, long ret, unsigned long start_time,
+                          unsigned long end_time) {
+    if (sysno < 0 || sysno >= LIBOS_SYSCALL_BOUND)
+        return;
+
+    struct shim_trace_buf* buf = get_trace_buf(/*alloc=*/true);
+    if (!buf)
+        return;
+
+    trace_write_name(buf, &g_syscall_name_traced[sysno], TRACE_RECORD_SYSCALL, sysno, name);
+
+    struct shim_trace_record record = {
+        .start_time = start_time,
+        .duration   = end_time > start_time ? end_time - start_time : 0,
+        .type       = TRACE_RECORD_SYSCALL,
+        .id         = sysno,
+        .tid        = buf->tid,
+        .ret        = ret,
+    };
+
+    /* arguments are known only if the syscall came through syscalldb */
+    struct shim_regs* regs = shim_get_tcb()->context.regs;
+    if (regs && shim_regs_get_syscallnr(regs) == (uint64_t)sysno)
+        shim_regs_get_syscall_args(regs, record.args);
+
+    trace_write(buf, &record);
+}
+
+static int get_pal_call_id(struct shim_trace_buf* buf, const char* name) {
+    size_t start = ((uintptr_t)name >> 3) % TRACE_MAX_PAL_NAMES;
+
+    for (size_t i = 0; i < TRACE_MAX_PAL_NAMES; i++) {
+        size_t idx = (start + i) % TRACE_MAX_PAL_NAMES;
+        const char* slot = __atomic_load_n(&g_pal_call_names[idx], __ATOMIC_ACQUIRE);
+        if (!slot) {
+            if (__atomic_compare_exchange_n(&g_pal_call_names[idx], &slot, name, /*weak=*/false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+                slot = name;
+            /* otherwise somebody else took the slot, `slot` now contains its name */
+        }
+        if (slot == name) {
+            trace_write_name(buf, &g_pal_name_traced[idx], TRACE_RECORD_PAL, idx, name);
+            return idx;
+        }
+    }
+
+    return -1;
+}
+
+static void trace_pal_call(PAL_STR name, PAL_NUM start_time, PAL_NUM end_time) {
+    struct shim_trace_buf* buf = get_trace_buf(/*alloc=*/false);
+    if (!buf)
+        return;
+
+    int id = get_pal_call_id(buf, name);
+    if (id < 0)
+        return;
+
+    struct shim_trace_record record = {
+        .start_time = start_time,
+        .duration   = end_time > start_time ? end_time - start_time : 0,
+        .type       = TRACE_RECORD_PAL,
+        .id         = id,
+        .tid        = buf->tid,
+    };
+    trace_write(buf, &record);
+}
+
+static void trace_file_write(const void* data, size_t size) {
+    PAL_NUM ret = DkStreamWrite(g_trace_handle, g_trace_offset, size, (void*)data, NULL);
+    if (ret == PAL_STREAM_ERROR)
+        return;
+    g_trace_offset += ret;
+}
+
+void flush_trace(void) {
+    if (!g_trace_enabled)
+        return;
+
+    lock(&g_trace_lock);
+    struct shim_trace_buf** prev = &g_trace_bufs;
+    while (*prev) {
+        struct shim_trace_buf* buf = *prev;
+        uint64_t tail = buf->tail;
+        uint64_t head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head) {
+            size_t start = tail % g_trace_records;
+            size_t count = MIN(head - tail, g_trace_records - start);
+            trace_file_write(&buf->records[start], count * sizeof(struct shim_trace_record));
+            tail += count;
+        }
+        __atomic_store_n(&buf->tail, tail, __ATOMIC_RELEASE);
+
+        uint64_t dropped = __atomic_exchange_n(&buf->dropped, 0, __ATOMIC_RELAXED);
+        if (dropped) {
+            struct shim_trace_record record = {
+                .start_time = DkSystemTimeQuery(),
+                .type       = TRACE_RECORD_DROPPED,
+                .tid        = buf->tid,
+                .ret        = dropped,
+            };
+            trace_file_write(&record, sizeof(record));
+        }
+
+        if (buf->dead) {
+            *prev = buf->next;
+            free(buf);
+        } else {
+            prev = &buf->next;
+        }
+    }
+    unlock(&g_trace_lock);
+}
+
+void release_trace_buf(struct shim_thread* thread) {
+    struct shim_trace_buf* buf = thread->trace_buf;
+    if (!buf)
+        return;
+
+    /* remaining records are flushed (and the buffer is freed) by the next flush_trace() */
+    lock(&g_trace_lock);
+    buf->dead = true;
+    unlock(&g_trace_lock);
+    thread->trace_buf = NULL;
+}
+
+static void trace_flush_callback(IDTYPE caller, void* arg) {
+    __UNUSED(caller);
+    __UNUSED(arg);
+
+    flush_trace();
+    install_async_event(NULL, TRACE_FLUSH_INTERVAL, &trace_flush_callback, NULL);
+}
+
+int init_trace(void) {
+    char cfgbuf[CONFIG_MAX];
+    int ret;
+
+    if (!root_config ||
+            get_config(root_config, "sys.trace.file", cfgbuf, sizeof(cfgbuf)) <= 0)
+        return 0;
+
+    char uri[CONFIG_MAX];
+    ret = snprintf(uri, sizeof(uri), "%s.%u", cfgbuf, cur_process.vmid);
+    if (ret < 0 || (size_t)ret >= sizeof(uri))
+        return -ENAMETOOLONG;
+
+    if (get_config(root_config, "sys.trace.buffer_size", cfgbuf, sizeof(cfgbuf)) > 0) {
+        uint64_t records = parse_int(cfgbuf);
+        if (!records) {
+            SYS_PRINTF("Invalid sys.trace.buffer_size in manifest\n");
+            return -EINVAL;
+        }
+        g_trace_records = records;
+    }
+
+    g_trace_handle = DkStreamOpen(uri, PAL_ACCESS_RDWR, PAL_SHARE_OWNER_R | PAL_SHARE_OWNER_W,
+                                  PAL_CREATE_TRY, 0);
+    if (!g_trace_handle) {
+        SYS_PRINTF("Cannot open trace file %s\n", uri);
+        return -PAL_ERRNO;
+    }
+    DkStreamSetLength(g_trace_handle, 0);
+
+    if (!create_lock(&g_trace_lock)) {
+        DkObjectClose(g_trace_handle);
+        g_trace_handle = NULL;
+        return -ENOMEM;
+    }
+
+    struct shim_trace_header header = {
+        .magic       = SHIM_TRACE_MAGIC,
+        .version     = SHIM_TRACE_VERSION,
+        .record_size = sizeof(struct shim_trace_record),
+        .vmid        = cur_process.vmid,
+    };
+    trace_file_write(&header, sizeof(header));
+
+    int64_t ev = install_async_event(NULL, TRACE_FLUSH_INTERVAL, &trace_flush_callback, NULL);
+    if (ev < 0)
+        return ev;
+
+    g_trace_enabled = true;
+    DkSetCallTracer(&trace_pal_call);
+    return 0;
+}
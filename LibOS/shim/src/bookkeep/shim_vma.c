@@ -4,6 +4,7 @@
  */
 
 #include <linux/fcntl.h>
+#include <linux/mempolicy.h>
 #include <linux/mman.h>
 #include <stdalign.h>
 #include <stdbool.h>
@@ -30,7 +31,7 @@
 static int filter_saved_flags(int flags) {
     return flags & (MAP_SHARED | MAP_SHARED_VALIDATE | MAP_PRIVATE | MAP_ANONYMOUS | MAP_FILE
                     | MAP_GROWSDOWN | MAP_HUGETLB | MAP_HUGE_2MB | MAP_HUGE_1GB | MAP_STACK
-                    | VMA_UNMAPPED | VMA_INTERNAL | VMA_TAINTED);
+                    | VMA_UNMAPPED | VMA_INTERNAL | VMA_TAINTED | VMA_DONTFORK);
 }
 
 /* TODO: split flags into internal (Graphene) and Linux; also to consider: completely remove Linux
@@ -42,6 +43,7 @@ struct shim_vma {
     int flags;
     struct shim_handle* file;
     off_t offset; // offset inside `file`, where `begin` starts
+    struct shim_mempolicy mempolicy;
     union {
         /* If this `vma` is used, it is included in `vma_tree` using this node. */
         struct avl_tree_node tree_node;
@@ -68,6 +70,7 @@ static void copy_vma(struct shim_vma* old_vma, struct shim_vma* new_vma) {
         get_handle(new_vma->file);
     }
     new_vma->offset = old_vma->offset;
+    new_vma->mempolicy = old_vma->mempolicy;
     copy_comment(new_vma, old_vma->comment);
 }
 
@@ -472,6 +475,15 @@ static int _bkeep_initial_vma(struct shim_vma* new_vma) {
     }
 }
 
+bool g_hugepages_enabled = false;
+
+int init_hugepages(void) {
+    char cfg[CONFIG_MAX];
+    if (root_config && get_config(root_config, "sys.hugepages", cfg, sizeof(cfg)) > 0)
+        g_hugepages_enabled = cfg[0] == '1';
+    return 0;
+}
+
 #define ASLR_BITS 12
 /* This variable is written to only once, during initialization, so it does not need to
  * be atomic. */
@@ -643,6 +655,7 @@ static void _add_unmapped_vma(uintptr_t begin, uintptr_t end, struct shim_vma* v
     vma->flags = VMA_INTERNAL | VMA_UNMAPPED;
     vma->file = NULL;
     vma->offset = 0;
+    vma->mempolicy = (struct shim_mempolicy){ .mode = MPOL_DEFAULT };
     copy_comment(vma, "");
 
     avl_tree_insert(&vma_tree, &vma->tree_node);
@@ -727,6 +740,7 @@ int bkeep_mmap_fixed(void* addr, size_t length, int prot, int flags,
         get_handle(new_vma->file);
     }
     new_vma->offset = file ? offset : 0;
+    new_vma->mempolicy = (struct shim_mempolicy){ .mode = MPOL_DEFAULT };
     copy_comment(new_vma, comment ?: "");
 
     struct shim_vma* vmas_to_free = NULL;
@@ -758,15 +772,37 @@ int bkeep_mmap_fixed(void* addr, size_t length, int prot, int flags,
     return ret;
 }
 
-static void vma_update_prot(struct shim_vma* vma, int prot) {
-    vma->prot = prot;
-    if (vma->file && (prot & PROT_WRITE)) {
-        vma->flags |= VMA_TAINTED;
+/* Applies a change to `vma`: new protections (unless `prot` is -1), VMA flags to set and clear and
+ * a new memory policy (unless `mempolicy` is NULL). */
+struct vma_change {
+    int prot;
+    int set_flags;
+    int clear_flags;
+    const struct shim_mempolicy* mempolicy;
+};
+
+static void vma_update(struct shim_vma* vma, const struct vma_change* change) {
+    if (change->prot != -1) {
+        vma->prot = change->prot;
+        if (vma->file && (change->prot & PROT_WRITE)) {
+            vma->flags |= VMA_TAINTED;
+        }
     }
+    vma->flags = (vma->flags | change->set_flags) & ~change->clear_flags;
+    if (change->mempolicy) {
+        vma->mempolicy = *change->mempolicy;
+    }
+}
+
+/* Restores the part of `vma` split into `new_vma` to the state from before the change. */
+static void vma_restore(struct shim_vma* new_vma, struct shim_vma* vma) {
+    new_vma->prot = vma->prot;
+    new_vma->flags = vma->flags;
+    new_vma->mempolicy = vma->mempolicy;
 }
 
-static int _vma_bkeep_change(uintptr_t begin, uintptr_t end, int prot, bool is_internal,
-                             struct shim_vma** new_vma_ptr1,
+static int _vma_bkeep_change(uintptr_t begin, uintptr_t end, const struct vma_change* change,
+                             bool is_internal, struct shim_vma** new_vma_ptr1,
                              struct shim_vma** new_vma_ptr2) {
     assert(spinlock_is_locked(&vma_tree_lock));
     assert(IS_ALLOC_ALIGNED_PTR(begin) && IS_ALLOC_ALIGNED_PTR(end));
@@ -789,8 +825,8 @@ static int _vma_bkeep_change(uintptr_t begin, uintptr_t end, int prot, bool is_i
 
     while (1) {
         is_ok &= !!(vma->flags & VMA_INTERNAL) == is_internal;
-        if (vma->file && (vma->flags & MAP_SHARED)) {
-            is_ok &= is_file_prot_matching(vma->file, prot);
+        if (change->prot != -1 && vma->file && (vma->flags & MAP_SHARED)) {
+            is_ok &= is_file_prot_matching(vma->file, change->prot);
         }
 
         if (end <= vma->end) {
@@ -822,7 +858,7 @@ static int _vma_bkeep_change(uintptr_t begin, uintptr_t end, int prot, bool is_i
         *new_vma_ptr1 = NULL;
 
         split_vma(vma, new_vma1, begin);
-        vma_update_prot(new_vma1, prot);
+        vma_update(new_vma1, change);
 
         struct shim_vma* next = _get_next_vma(vma);
 
@@ -833,7 +869,7 @@ static int _vma_bkeep_change(uintptr_t begin, uintptr_t end, int prot, bool is_i
             *new_vma_ptr2 = NULL;
 
             split_vma(new_vma1, new_vma2, end);
-            vma_update_prot(new_vma2, vma->prot);
+            vma_restore(new_vma2, vma);
 
             avl_tree_insert(&vma_tree, &new_vma2->tree_node);
             return 0;
@@ -845,7 +881,7 @@ static int _vma_bkeep_change(uintptr_t begin, uintptr_t end, int prot, bool is_i
     }
 
     while (vma->end <= end) {
-        vma_update_prot(vma, prot);
+        vma_update(vma, change);
 
 #ifdef DEBUG
         struct shim_vma* prev = vma;
@@ -866,14 +902,15 @@ static int _vma_bkeep_change(uintptr_t begin, uintptr_t end, int prot, bool is_i
     *new_vma_ptr2 = NULL;
 
     split_vma(vma, new_vma2, end);
-    vma_update_prot(vma, prot);
+    vma_update(vma, change);
 
     avl_tree_insert(&vma_tree, &new_vma2->tree_node);
 
     return 0;
 }
 
-int bkeep_mprotect(void* addr, size_t length, int prot, bool is_internal) {
+static int bkeep_change(void* addr, size_t length, const struct vma_change* change,
+                        bool is_internal) {
     if (!length || !IS_ALLOC_ALIGNED(length) || !IS_ALLOC_ALIGNED_PTR(addr)) {
         return -EINVAL;
     }
@@ -889,7 +926,7 @@ int bkeep_mprotect(void* addr, size_t length, int prot, bool is_internal) {
     }
 
     spinlock_lock_signal_off(&vma_tree_lock);
-    int ret = _vma_bkeep_change((uintptr_t)addr, (uintptr_t)addr + length, prot, is_internal,
+    int ret = _vma_bkeep_change((uintptr_t)addr, (uintptr_t)addr + length, change, is_internal,
                                 &vma1, &vma2);
     spinlock_unlock_signal_on(&vma_tree_lock);
 
@@ -903,6 +940,37 @@ int bkeep_mprotect(void* addr, size_t length, int prot, bool is_internal) {
     return ret;
 }
 
+int bkeep_mprotect(void* addr, size_t length, int prot, bool is_internal) {
+    struct vma_change change = { .prot = prot };
+    return bkeep_change(addr, length, &change, is_internal);
+}
+
+int bkeep_vma_flags(void* addr, size_t length, int set_flags, int clear_flags) {
+    struct vma_change change = {
+        .prot        = -1,
+        .set_flags   = set_flags,
+        .clear_flags = clear_flags,
+    };
+    return bkeep_change(addr, length, &change, /*is_internal=*/false);
+}
+
+int bkeep_vma_mempolicy(void* addr, size_t length, const struct shim_mempolicy* mempolicy) {
+    struct vma_change change = {
+        .prot      = -1,
+        .mempolicy = mempolicy,
+    };
+    return bkeep_change(addr, length, &change, /*is_internal=*/false);
+}
+
+/* Huge pages are only used by the host if the virtual range is aligned to their size. */
+static size_t vma_alignment(int flags) {
+    if (!(flags & MAP_HUGETLB))
+        return ALLOC_ALIGNMENT;
+    if ((flags & (MAP_HUGE_MASK << MAP_HUGE_SHIFT)) == MAP_HUGE_1GB)
+        return 1UL << 30;
+    return HUGEPAGE_SIZE;
+}
+
 /* TODO consider:
  * maybe it's worth to keep another tree, complementary to `vma_tree`, that would hold free areas.
  * It would give O(logn) unmapped lookup, which now is O(n) in the worst case, but it would also
@@ -925,6 +993,7 @@ int bkeep_mmap_any_in_range(void* _bottom_addr, void* _top_addr, size_t length,
 
     uintptr_t top_addr = (uintptr_t)_top_addr;
     uintptr_t bottom_addr = (uintptr_t)_bottom_addr;
+    size_t align = vma_alignment(flags);
     int ret = 0;
     uintptr_t ret_val = 0;
 
@@ -949,6 +1018,7 @@ int bkeep_mmap_any_in_range(void* _bottom_addr, void* _top_addr, size_t length,
         get_handle(new_vma->file);
     }
     new_vma->offset = file ? offset : 0;
+    new_vma->mempolicy = (struct shim_mempolicy){ .mode = MPOL_DEFAULT };
     copy_comment(new_vma, comment ?: "");
 
     spinlock_lock_signal_off(&vma_tree_lock);
@@ -966,7 +1036,8 @@ int bkeep_mmap_any_in_range(void* _bottom_addr, void* _top_addr, size_t length,
 
     while (vma && bottom_addr <= vma->end) {
         assert(vma->end <= max_addr);
-        if (max_addr - vma->end >= length) {
+        if (max_addr - vma->end >= length &&
+                ALIGN_DOWN(max_addr - length, align) >= vma->end) {
             goto out_found;
         }
 
@@ -974,14 +1045,15 @@ int bkeep_mmap_any_in_range(void* _bottom_addr, void* _top_addr, size_t length,
         vma = _get_prev_vma(vma);
     }
 
-    if (!(bottom_addr <= max_addr && max_addr - bottom_addr >= length)) {
+    if (!(bottom_addr <= max_addr && max_addr - bottom_addr >= length &&
+            ALIGN_DOWN(max_addr - length, align) >= bottom_addr)) {
         ret = -ENOMEM;
         goto out;
     }
 
 out_found:
-    new_vma->end = max_addr;
-    new_vma->begin = new_vma->end - length;
+    new_vma->begin = ALIGN_DOWN(max_addr - length, align);
+    new_vma->end = new_vma->begin + length;
 
     avl_tree_insert(&vma_tree, &new_vma->tree_node);
 
@@ -1023,6 +1095,7 @@ static void dump_vma(struct shim_vma_info* vma_info, struct shim_vma* vma) {
     vma_info->prot = vma->prot;
     vma_info->flags = vma->flags;
     vma_info->file_offset = vma->offset;
+    vma_info->mempolicy = vma->mempolicy;
     vma_info->file = vma->file;
     if (vma_info->file) {
         get_handle(vma_info->file);
@@ -1151,8 +1224,15 @@ BEGIN_CP_FUNC(vma)
 
         void * need_mapped = vma->addr;
 
+        /* Shared file mappings are mapped again from the file in the child, so the emulated ones
+         * must be written back first. */
+        bool shared_file = vma->file && (vma->flags & MAP_SHARED);
+        if (shared_file && !(vma->flags & VMA_UNMAPPED))
+            sync_shared_mmaps(vma->addr, vma->length, /*remove=*/false);
+
         /* Check whether we need to checkpoint memory this vma bookkeeps. */
-        if ((vma->flags & VMA_TAINTED || !vma->file) && !(vma->flags & VMA_UNMAPPED)) {
+        if ((vma->flags & VMA_TAINTED || !vma->file) && !shared_file &&
+                !(vma->flags & VMA_UNMAPPED)) {
             void* send_addr  = vma->addr;
             size_t send_size = vma->length;
             if (vma->file) {
@@ -1245,7 +1325,7 @@ BEGIN_RS_FUNC(vma)
 
         if (need_mapped < vma->addr + vma->length) {
             if (DkVirtualMemoryAlloc(need_mapped, vma->addr + vma->length - need_mapped,
-                                     /*alloc_type=*/0,
+                                     (vma->flags & MAP_HUGETLB) ? PAL_ALLOC_HUGEPAGE : 0,
                                      LINUX_PROT_TO_PAL(vma->prot, /*map_flags=*/0))) {
                 need_mapped += vma->length;
             }
@@ -1256,6 +1336,15 @@ BEGIN_RS_FUNC(vma)
                        vma->addr + vma->length);
     }
 
+    if (vma->mempolicy.mode != MPOL_DEFAULT) {
+        ret = bkeep_vma_mempolicy(vma->addr, vma->length, &vma->mempolicy);
+        if (ret < 0)
+            return ret;
+        /* the contents were already received, so the pages have to be moved to the policy nodes */
+        if (!(vma->flags & VMA_UNMAPPED))
+            apply_mempolicy(vma->addr, vma->length, &vma->mempolicy, /*move=*/true);
+    }
+
     if (vma->file)
         get_handle(vma->file);
 
@@ -1283,8 +1372,12 @@ BEGIN_CP_FUNC(all_vmas)
         return ret;
     }
 
-    for (struct shim_vma_info* vma = &vmas[count - 1] ; vma >= vmas ; vma--)
+    for (struct shim_vma_info* vma = &vmas[count - 1] ; vma >= vmas ; vma--) {
+        /* madvise(MADV_DONTFORK) regions do not exist in the child */
+        if (vma->flags & VMA_DONTFORK)
+            continue;
         DO_CP(vma, vma, NULL);
+    }
 
     free_vma_info_array(vmas, count);
 }
@@ -52,6 +52,7 @@ elf_dynamic_do_rel(struct link_map* l, ElfW(Addr) reladdr, size_t relsize) {
     size_t nrelsize = relsize / sizeof(ElfW(Rel));
 
     r = r + (nrelative < nrelsize ? nrelative : nrelsize);
+    g_elf_relocations += end - r;
     for (; r < end; ++r) {
         ElfW(Sym)* sym = &symtab[ELFW(R_SYM)(r->r_info)];
         void* reloc    = (void*)l->l_addr + r->r_offset;
@@ -22,7 +22,10 @@
 #include <asm/mman.h>
 #include <asm/unistd.h>
 #include <errno.h>
+#include <linux/falloc.h>
+#include <linux/fadvise.h>
 #include <linux/fcntl.h>
+#include <linux/fs.h>
 #include <linux/stat.h>
 
 #define URI_MAX_SIZE    STR_SIZE
@@ -697,6 +700,174 @@ out:
     return ret;
 }
 
+/* Positional reads and writes go straight to the PAL at the given offset: the file marker is not
+ * involved, so (unlike chroot_read/chroot_write) the handle lock is not held across the host call
+ * and concurrent preads on the same handle run in parallel. The lock is taken only to publish a
+ * new file size after a pwrite extended the file. */
+static int chroot_check_pio(struct shim_handle* hdl, int acc_mode, size_t count, off_t pos) {
+    int ret;
+    if (NEED_RECREATE(hdl) && (ret = chroot_recreate(hdl)) < 0)
+        return ret;
+
+    if (!(hdl->acc_mode & acc_mode))
+        return -EBADF;
+
+    if (hdl->info.file.type != FILE_REGULAR)
+        return -ESPIPE;
+
+    off_t dummy_off_t;
+    if (__builtin_add_overflow(pos, count, &dummy_off_t))
+        return -EFBIG;
+
+    return 0;
+}
+
+static ssize_t __chroot_pread(struct shim_handle* hdl, void* buf, size_t count, off_t pos) {
+    PAL_NUM pal_ret = DkStreamRead(hdl->pal_handle, pos, count, buf, NULL, 0);
+    if (pal_ret == PAL_STREAM_ERROR)
+        return PAL_NATIVE_ERRNO == PAL_ERROR_ENDOFSTREAM ? 0 : -PAL_ERRNO;
+    return pal_ret;
+}
+
+static ssize_t __chroot_pwrite(struct shim_handle* hdl, const void* buf, size_t count,
+                               off_t pos) {
+    PAL_NUM pal_ret = DkStreamWrite(hdl->pal_handle, pos, count, (void*)buf, NULL);
+    if (pal_ret == PAL_STREAM_ERROR)
+        return PAL_NATIVE_ERRNO == PAL_ERROR_ENDOFSTREAM ? 0 : -PAL_ERRNO;
+    return pal_ret;
+}
+
+static void chroot_extend_size(struct shim_handle* hdl, off_t end) {
+    struct shim_file_handle* file = &hdl->info.file;
+
+    if (__atomic_load_n(&file->size, __ATOMIC_RELAXED) >= end)
+        return;
+
+    lock(&hdl->lock);
+    if (file->size < end) {
+        file->size = end;
+        chroot_update_size(hdl, file, FILE_HANDLE_DATA(hdl));
+    }
+    unlock(&hdl->lock);
+}
+
+static ssize_t chroot_pread(struct shim_handle* hdl, void* buf, size_t count, off_t pos) {
+    if (count == 0)
+        return 0;
+
+    int ret = chroot_check_pio(hdl, MAY_READ, count, pos);
+    if (ret < 0)
+        return ret;
+
+    return __chroot_pread(hdl, buf, count, pos);
+}
+
+static ssize_t chroot_pwrite(struct shim_handle* hdl, const void* buf, size_t count, off_t pos) {
+    if (count == 0)
+        return 0;
+
+    int ret = chroot_check_pio(hdl, MAY_WRITE, count, pos);
+    if (ret < 0)
+        return ret;
+
+    ssize_t bytes = __chroot_pwrite(hdl, buf, count, pos);
+    if (bytes > 0)
+        chroot_extend_size(hdl, pos + bytes);
+    return bytes;
+}
+
+static size_t iov_total_len(const struct iovec* vec, int vlen) {
+    size_t total = 0;
+    for (int i = 0; i < vlen; i++)
+        total += vec[i].iov_len;
+    return total;
+}
+
+#define CHROOT_PREADV_BATCH 16
+
+static ssize_t chroot_preadv(struct shim_handle* hdl, const struct iovec* vec, int vlen,
+                             off_t pos) {
+    size_t total = iov_total_len(vec, vlen);
+    if (total == 0)
+        return 0;
+
+    int ret = chroot_check_pio(hdl, MAY_READ, total, pos);
+    if (ret < 0)
+        return ret;
+
+    if (vlen == 1)
+        return __chroot_pread(hdl, vec[0].iov_base, vec[0].iov_len, pos);
+
+    /* read all vectors in one PAL call (which the host may perform with a single io_uring
+     * submission); vectors past a short read may receive data too, but it is not reported */
+    PAL_IO_REQUEST reqs[CHROOT_PREADV_BATCH];
+    ssize_t bytes = 0;
+    size_t expected = 0;
+    int i = 0;
+    while (i < vlen) {
+        size_t nreqs = 0;
+        for (; i < vlen && nreqs < CHROOT_PREADV_BATCH; i++) {
+            if (!vec[i].iov_len)
+                continue;
+
+            reqs[nreqs++] = (PAL_IO_REQUEST){
+                .handle = hdl->pal_handle,
+                .op     = PAL_IO_READ,
+                .offset = pos + expected,
+                .count  = vec[i].iov_len,
+                .buffer = vec[i].iov_base,
+            };
+            expected += vec[i].iov_len;
+        }
+
+        if (nreqs && !DkStreamsBatchIo(reqs, nreqs))
+            return bytes ?: -PAL_ERRNO;
+
+        for (size_t j = 0; j < nreqs; j++) {
+            if (reqs[j].result == PAL_STREAM_ERROR)
+                return bytes ?: -convert_pal_errno(reqs[j].error);
+
+            bytes += reqs[j].result;
+            if (reqs[j].result < reqs[j].count)
+                return bytes;
+        }
+    }
+
+    return bytes;
+}
+
+static ssize_t chroot_pwritev(struct shim_handle* hdl, const struct iovec* vec, int vlen,
+                              off_t pos) {
+    size_t total = iov_total_len(vec, vlen);
+    if (total == 0)
+        return 0;
+
+    int ret = chroot_check_pio(hdl, MAY_WRITE, total, pos);
+    if (ret < 0)
+        return ret;
+
+    ssize_t bytes = 0;
+    for (int i = 0; i < vlen; i++) {
+        if (!vec[i].iov_len)
+            continue;
+
+        ssize_t b_vec = __chroot_pwrite(hdl, vec[i].iov_base, vec[i].iov_len, pos + bytes);
+        if (b_vec < 0) {
+            if (!bytes)
+                return b_vec;
+            break;
+        }
+
+        bytes += b_vec;
+        if ((size_t)b_vec < vec[i].iov_len)
+            break;
+    }
+
+    if (bytes > 0)
+        chroot_extend_size(hdl, pos + bytes);
+    return bytes;
+}
+
 static int chroot_mmap (struct shim_handle * hdl, void ** addr, size_t size,
                         int prot, int flags, off_t offset)
 {
@@ -713,12 +884,37 @@ static int chroot_mmap (struct shim_handle * hdl, void ** addr, size_t size,
 #endif
         return -EINVAL;
 
+    /* a read-only shared mapping of a file opened for writing may be made writable by mprotect()
+     * later; map it writable, so that it is emulated if the PAL cannot map files shared, and drop
+     * the write permission afterwards */
+    bool may_write = (flags & MAP_SHARED) && !(prot & PROT_WRITE) && (hdl->acc_mode & MAY_WRITE);
+    if (may_write)
+        pal_prot |= PAL_PROT_WRITE;
+
     void * alloc_addr =
         (void *) DkStreamMap(hdl->pal_handle, *addr, pal_prot, offset, size);
 
+    if (!alloc_addr && PAL_NATIVE_ERRNO == PAL_ERROR_NOTIMPLEMENTED &&
+            (flags & MAP_SHARED) && (pal_prot & PAL_PROT_WRITE)) {
+        /* the PAL cannot map the file shared; map a private copy and write it back on msync */
+        alloc_addr = (void *) DkStreamMap(hdl->pal_handle, *addr, pal_prot | PAL_PROT_WRITECOPY,
+                                          offset, size);
+        if (alloc_addr && (ret = emulate_shared_mmap(hdl, alloc_addr, size, offset)) < 0) {
+            DkStreamUnmap(alloc_addr, size);
+            return ret;
+        }
+    }
+
     if (!alloc_addr)
         return -PAL_ERRNO;
 
+    if (may_write && !DkVirtualMemoryProtect(alloc_addr, size, LINUX_PROT_TO_PAL(prot, flags))) {
+        ret = -PAL_ERRNO;
+        sync_shared_mmaps(alloc_addr, size, /*remove=*/true);
+        DkStreamUnmap(alloc_addr, size);
+        return ret;
+    }
+
     *addr = alloc_addr;
     return 0;
 }
@@ -805,6 +1001,104 @@ out:
     return ret;
 }
 
+static int chroot_check_range_op(struct shim_handle* hdl) {
+    int ret;
+    if (NEED_RECREATE(hdl) && (ret = chroot_recreate(hdl)) < 0)
+        return ret;
+
+    if (hdl->info.file.type != FILE_REGULAR)
+        return -ESPIPE;
+
+    return 0;
+}
+
+static int chroot_fallocate(struct shim_handle* hdl, int mode, off_t offset, off_t len) {
+    int ret = chroot_check_range_op(hdl);
+    if (ret < 0)
+        return ret == -ESPIPE ? -ENODEV : ret;
+
+    PAL_FLG pal_mode = 0;
+    if (mode & FALLOC_FL_KEEP_SIZE)
+        pal_mode |= PAL_FALLOC_KEEP_SIZE;
+    if (mode & FALLOC_FL_PUNCH_HOLE)
+        pal_mode |= PAL_FALLOC_PUNCH_HOLE;
+    if (mode & FALLOC_FL_ZERO_RANGE)
+        pal_mode |= PAL_FALLOC_ZERO_RANGE;
+
+    off_t end = offset + len;
+
+    if (!DkStreamAllocate(hdl->pal_handle, offset, len, pal_mode)) {
+        if (PAL_NATIVE_ERRNO == PAL_ERROR_NOMEM)
+            return -ENOSPC;
+        if (PAL_NATIVE_ERRNO != PAL_ERROR_NOTSUPPORT)
+            return -PAL_ERRNO;
+
+        /* The PAL cannot reserve storage. Punching holes and zeroing change the file contents, so
+         * they cannot be skipped; a plain reservation degrades to a no-op that only extends the
+         * file, i.e. later writes may still fail with ENOSPC. */
+        if (pal_mode & (PAL_FALLOC_PUNCH_HOLE | PAL_FALLOC_ZERO_RANGE))
+            return -EOPNOTSUPP;
+        if (pal_mode & PAL_FALLOC_KEEP_SIZE)
+            return 0;
+
+        /* the host file may have grown in another process, so never shrink it here */
+        PAL_STREAM_ATTR attr;
+        if (!DkStreamAttributesQueryByHandle(hdl->pal_handle, &attr))
+            return -PAL_ERRNO;
+
+        if (attr.pending_size < (PAL_NUM)end) {
+            PAL_NUM rv = DkStreamSetLength(hdl->pal_handle, end);
+            if (rv)
+                return -((int)rv);
+        }
+    }
+
+    if (!(pal_mode & PAL_FALLOC_KEEP_SIZE))
+        chroot_extend_size(hdl, end);
+
+    return 0;
+}
+
+static const int g_pal_fadvise[] = {
+    [POSIX_FADV_NORMAL]     = PAL_FADVISE_NORMAL,
+    [POSIX_FADV_RANDOM]     = PAL_FADVISE_RANDOM,
+    [POSIX_FADV_SEQUENTIAL] = PAL_FADVISE_SEQUENTIAL,
+    [POSIX_FADV_WILLNEED]   = PAL_FADVISE_WILLNEED,
+    [POSIX_FADV_DONTNEED]   = PAL_FADVISE_DONTNEED,
+    [POSIX_FADV_NOREUSE]    = PAL_FADVISE_NOREUSE,
+};
+
+static int chroot_fadvise(struct shim_handle* hdl, off_t offset, off_t len, int advice) {
+    int ret = chroot_check_range_op(hdl);
+    if (ret < 0)
+        return ret;
+
+    if (!DkStreamAdvise(hdl->pal_handle, offset, len, g_pal_fadvise[advice]))
+        return -PAL_ERRNO;
+
+    return 0;
+}
+
+static int chroot_sync_range(struct shim_handle* hdl, off_t offset, off_t nbytes,
+                             unsigned int flags) {
+    int ret = chroot_check_range_op(hdl);
+    if (ret < 0)
+        return ret;
+
+    PAL_FLG pal_flags = 0;
+    if (flags & SYNC_FILE_RANGE_WAIT_BEFORE)
+        pal_flags |= PAL_FLUSH_RANGE_WAIT_BEFORE;
+    if (flags & SYNC_FILE_RANGE_WRITE)
+        pal_flags |= PAL_FLUSH_RANGE_WRITE;
+    if (flags & SYNC_FILE_RANGE_WAIT_AFTER)
+        pal_flags |= PAL_FLUSH_RANGE_WAIT_AFTER;
+
+    if (!DkStreamFlushRange(hdl->pal_handle, offset, nbytes, pal_flags))
+        return -PAL_ERRNO;
+
+    return 0;
+}
+
 static int chroot_dput (struct shim_dentry * dent)
 {
     struct shim_file_data * data = FILE_DENTRY_DATA(dent);
@@ -1131,10 +1425,17 @@ struct shim_fs_ops chroot_fs_ops = {
         .close       = &chroot_close,
         .read        = &chroot_read,
         .write       = &chroot_write,
+        .pread       = &chroot_pread,
+        .pwrite      = &chroot_pwrite,
+        .preadv      = &chroot_preadv,
+        .pwritev     = &chroot_pwritev,
         .mmap        = &chroot_mmap,
         .seek        = &chroot_seek,
         .hstat       = &chroot_hstat,
         .truncate    = &chroot_truncate,
+        .fallocate   = &chroot_fallocate,
+        .fadvise     = &chroot_fadvise,
+        .sync_range  = &chroot_sync_range,
         .checkout    = &chroot_checkout,
         .checkpoint  = &chroot_checkpoint,
         .migrate     = &chroot_migrate,
@@ -21,8 +21,11 @@ extern const struct pseudo_fs_ops fs_meminfo;
 
 extern const struct pseudo_fs_ops fs_cpuinfo;
 
+extern const struct pseudo_fs_ops fs_graphene;
+extern const struct pseudo_dir dir_graphene;
+
 static const struct pseudo_dir proc_root_dir = {
-    .size = 5,
+    .size = 6,
     .ent  = {
               { .name   = "self",
                 .fs_ops = &fs_thread,
@@ -39,6 +42,9 @@ static const struct pseudo_dir proc_root_dir = {
               { .name   = "cpuinfo",
                 .fs_ops = &fs_cpuinfo,
                 .type   = LINUX_DT_REG },
+              { .name   = "graphene",
+                .fs_ops = &fs_graphene,
+                .dir    = &dir_graphene },
             }
 };
 
@@ -88,6 +94,8 @@ struct shim_fs_ops proc_fs_ops = {
     .close   = &str_close,
     .read    = &str_read,
     .write   = &str_write,
+    .pread   = &str_pread,
+    .pwrite  = &str_pwrite,
     .seek    = &str_seek,
     .flush   = &str_flush,
     .hstat   = &proc_hstat,
@@ -0,0 +1,92 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*!
+ * \file
+ *
+ * This file contains the implementation of `/proc/graphene` which exposes Graphene-specific
+ * runtime information: `/proc/graphene/syscall_stats` and `/proc/graphene/boot_profile`.
+ */
+
+#include "shim_fs.h"
+#include "shim_internal.h"
+
+static int proc_graphene_mode(const char* name, mode_t* mode) {
+    __UNUSED(name);
+    *mode = FILE_R_MODE | S_IFREG;
+    return 0;
+}
+
+static int proc_graphene_stat(const char* name, struct stat* buf) {
+    __UNUSED(name);
+    memset(buf, 0, sizeof(struct stat));
+    buf->st_dev  = 1;    /* dummy ID of device containing file */
+    buf->st_ino  = 1;    /* dummy inode number */
+    buf->st_mode = FILE_R_MODE | S_IFREG;
+    return 0;
+}
+
+static int proc_graphene_report_open(struct shim_handle* hdl, int flags,
+                                     int (*get_report)(char** str, size_t* len)) {
+    if (flags & (O_WRONLY | O_RDWR))
+        return -EACCES;
+
+    char* str;
+    size_t len;
+    int ret = get_report(&str, &len);
+    if (ret < 0)
+        return ret;
+
+    struct shim_str_data* data = calloc(1, sizeof(struct shim_str_data));
+    if (!data) {
+        free(str);
+        return -ENOMEM;
+    }
+
+    data->str          = str;
+    data->len          = len;
+    hdl->type          = TYPE_STR;
+    hdl->flags         = flags & ~O_RDONLY;
+    hdl->acc_mode      = MAY_READ;
+    hdl->info.str.data = data;
+    return 0;
+}
+
+static int proc_syscall_stats_open(struct shim_handle* hdl, const char* name, int flags) {
+    __UNUSED(name);
+    return proc_graphene_report_open(hdl, flags, &get_syscall_stats_report);
+}
+
+static int proc_boot_profile_open(struct shim_handle* hdl, const char* name, int flags) {
+    __UNUSED(name);
+    return proc_graphene_report_open(hdl, flags, &get_boot_profile_report);
+}
+
+static const struct pseudo_fs_ops fs_syscall_stats = {
+    .mode = &proc_graphene_mode,
+    .stat = &proc_graphene_stat,
+    .open = &proc_syscall_stats_open,
+};
+
+static const struct pseudo_fs_ops fs_boot_profile = {
+    .mode = &proc_graphene_mode,
+    .stat = &proc_graphene_stat,
+    .open = &proc_boot_profile_open,
+};
+
+const struct pseudo_dir dir_graphene = {
+    .size = 2,
+    .ent  = {
+              { .name   = "syscall_stats",
+                .fs_ops = &fs_syscall_stats,
+                .type   = LINUX_DT_REG },
+              { .name   = "boot_profile",
+                .fs_ops = &fs_boot_profile,
+                .type   = LINUX_DT_REG },
+            }
+};
+
+const struct pseudo_fs_ops fs_graphene = {
+    .open = &pseudo_dir_open,
+    .mode = &pseudo_dir_mode,
+    .stat = &pseudo_dir_stat,
+};
@@ -142,18 +142,35 @@ static int proc_cpuinfo_open(struct shim_handle* hdl, const char* name, int flag
         len += ret;                                                     \
     } while (0)
 
-    for (size_t n = 0; n < pal_control.cpu_info.cpu_num; n++) {
+    const PAL_CPU_INFO* ci = &pal_control.cpu_info;
+    for (size_t n = 0; n < ci->cpu_num; n++) {
+        /* count logical CPUs and distinct cores sharing the package of this CPU */
+        size_t siblings = 0, cores = 0;
+        for (size_t i = 0; i < ci->cpu_num; i++) {
+            if (ci->cpu_package_id[i] != ci->cpu_package_id[n])
+                continue;
+            siblings++;
+            size_t j = 0;
+            while (j < i && (ci->cpu_package_id[j] != ci->cpu_package_id[n] ||
+                             ci->cpu_core_id[j] != ci->cpu_core_id[i]))
+                j++;
+            if (j == i)
+                cores++;
+        }
+
         /* Below strings must match exactly the strings retrieved from /proc/cpuinfo
          * (see Linux's arch/x86/kernel/cpu/proc.c) */
-        ADD_INFO("processor\t: %lu\n", n);
-        ADD_INFO("vendor_id\t: %s\n", pal_control.cpu_info.cpu_vendor);
-        ADD_INFO("cpu family\t: %lu\n", pal_control.cpu_info.cpu_family);
-        ADD_INFO("model\t\t: %lu\n", pal_control.cpu_info.cpu_model);
-        ADD_INFO("model name\t: %s\n", pal_control.cpu_info.cpu_brand);
-        ADD_INFO("stepping\t: %lu\n", pal_control.cpu_info.cpu_stepping);
-        ADD_INFO("core id\t\t: %lu\n", n);
-        ADD_INFO("cpu cores\t: %lu\n", pal_control.cpu_info.cpu_num);
-        double bogomips = pal_control.cpu_info.cpu_bogomips;
+        ADD_INFO("processor\t: %u\n", ci->cpu_id[n]);
+        ADD_INFO("vendor_id\t: %s\n", ci->cpu_vendor);
+        ADD_INFO("cpu family\t: %lu\n", ci->cpu_family);
+        ADD_INFO("model\t\t: %lu\n", ci->cpu_model);
+        ADD_INFO("model name\t: %s\n", ci->cpu_brand);
+        ADD_INFO("stepping\t: %lu\n", ci->cpu_stepping);
+        ADD_INFO("physical id\t: %u\n", ci->cpu_package_id[n]);
+        ADD_INFO("siblings\t: %lu\n", siblings);
+        ADD_INFO("core id\t\t: %u\n", ci->cpu_core_id[n]);
+        ADD_INFO("cpu cores\t: %lu\n", cores);
+        double bogomips = ci->cpu_bogomips;
         // Apparently graphene snprintf cannot into floats.
         ADD_INFO("bogomips\t: %lu.%02lu\n",
                  (unsigned long)bogomips,
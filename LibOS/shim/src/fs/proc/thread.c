@@ -5,6 +5,7 @@
 #include <asm/unistd.h>
 #include <errno.h>
 #include <linux/fcntl.h>
+#include <linux/mempolicy.h>
 #include <linux/stat.h>
 
 #include <pal.h>
@@ -575,15 +576,145 @@ err:
     return ret;
 }
 
+static int count_page_nodes(void** pages, PAL_IDX* nodes, size_t count, void* arg) {
+    __UNUSED(pages);
+    size_t* node_pages = arg;
+    for (size_t i = 0; i < count; i++) {
+        if (nodes[i] < MAX_NUMA_NODES)
+            node_pages[nodes[i]]++;
+    }
+    return 0;
+}
+
+/* Formats `policy` like Linux does in numa_maps, e.g. "bind:0-1" or "interleave=static:0,2". */
+static void format_mempolicy(char* buf, size_t size, const struct shim_mempolicy* policy) {
+    static const char* const names[] = {
+        [MPOL_DEFAULT]    = "default",
+        [MPOL_PREFERRED]  = "prefer",
+        [MPOL_BIND]       = "bind",
+        [MPOL_INTERLEAVE] = "interleave",
+        [MPOL_LOCAL]      = "local",
+    };
+    int mode = policy->mode & ~(MPOL_F_STATIC_NODES | MPOL_F_RELATIVE_NODES);
+    size_t off = snprintf(buf, size, "%s%s", names[mode],
+                          (policy->mode & MPOL_F_STATIC_NODES) ? "=static" :
+                          (policy->mode & MPOL_F_RELATIVE_NODES) ? "=relative" : "");
+
+    char sep = ':';
+    for (unsigned int node = 0; node < MAX_NUMA_NODES && off < size; node++) {
+        if (!(policy->nodes & (1UL << node)))
+            continue;
+        unsigned int last = node;
+        while (last + 1 < MAX_NUMA_NODES && (policy->nodes & (1UL << (last + 1))))
+            last++;
+        if (last == node)
+            off += snprintf(buf + off, size - off, "%c%u", sep, node);
+        else
+            off += snprintf(buf + off, size - off, "%c%u-%u", sep, node, last);
+        sep  = ',';
+        node = last;
+    }
+}
+
+static int proc_thread_numa_maps_open(struct shim_handle* hdl, const char* name, int flags) {
+    if (flags & (O_WRONLY | O_RDWR))
+        return -EACCES;
+
+    IDTYPE pid;
+    int ret = parse_thread_name(name, &pid, NULL, NULL, NULL);
+    if (ret < 0)
+        return ret;
+
+    struct shim_thread* thread = lookup_thread(pid);
+    if (!thread)
+        return -ENOENT;
+    put_thread(thread);
+
+    size_t count;
+    struct shim_vma_info* vmas = NULL;
+    ret = dump_all_vmas(&vmas, &count, /*include_unmapped=*/false);
+    if (ret < 0)
+        return ret;
+
+    size_t buffer_size = DEFAULT_VMA_BUFFER_SIZE, offset = 0;
+    char* buffer = malloc(buffer_size);
+    if (!buffer) {
+        ret = -ENOMEM;
+        goto err;
+    }
+
+    for (struct shim_vma_info* vma = vmas; vma < vmas + count; vma++) {
+        /* pages of each node; unknown if the PAL cannot tell where memory is placed */
+        size_t node_pages[MAX_NUMA_NODES] = { 0 };
+        bool placed = query_page_nodes(vma->addr, vma->length, count_page_nodes, node_pages) == 0;
+        size_t total = 0;
+        for (size_t node = 0; node < MAX_NUMA_NODES; node++) {
+            total += node_pages[node];
+        }
+
+        char policy[256];
+        format_mempolicy(policy, sizeof(policy), &vma->mempolicy);
+
+        size_t old_offset = offset;
+    retry_emit_vma:
+        EMIT("%lx %s", (uintptr_t)vma->addr, policy);
+        if (vma->file && !qstrempty(&vma->file->path))
+            EMIT(" file=%s", qstrgetstr(&vma->file->path));
+        if (placed && total)
+            EMIT(vma->file ? " mapped=%lu" : " anon=%lu", total);
+        for (size_t node = 0; placed && node < MAX_NUMA_NODES; node++) {
+            if (node_pages[node])
+                EMIT(" N%lu=%lu", node, node_pages[node]);
+        }
+        EMIT(" kernelpagesize_kB=%lu\n", ALLOC_ALIGNMENT / 1024);
+
+        if (offset >= buffer_size) {
+            char* new_buffer = malloc(buffer_size * 2);
+            if (!new_buffer) {
+                ret = -ENOMEM;
+                goto err;
+            }
+
+            offset = old_offset;
+            memcpy(new_buffer, buffer, old_offset);
+            free(buffer);
+            buffer = new_buffer;
+            buffer_size *= 2;
+            goto retry_emit_vma;
+        }
+    }
+
+    struct shim_str_data* data = calloc(1, sizeof(struct shim_str_data));
+    if (!data) {
+        ret = -ENOMEM;
+        goto err;
+    }
+
+    data->str          = buffer;
+    data->len          = offset;
+    hdl->type          = TYPE_STR;
+    hdl->flags         = flags & ~O_RDONLY;
+    hdl->acc_mode      = MAY_READ;
+    hdl->info.str.data = data;
+    ret                = 0;
+
+err:
+    if (ret < 0) {
+        free(buffer);
+    }
+    free_vma_info_array(vmas, count);
+    return ret;
+}
+
 static int proc_thread_maps_mode(const char* name, mode_t* mode) {
-    // Only used by one file
+    // Used by "maps" and "numa_maps"
     __UNUSED(name);
     *mode = 0400;
     return 0;
 }
 
 static int proc_thread_maps_stat(const char* name, struct stat* buf) {
-    // Only used by one file
+    // Used by "maps" and "numa_maps"
     __UNUSED(name);
     memset(buf, 0, sizeof(struct stat));
 
@@ -602,6 +733,12 @@ static const struct pseudo_fs_ops fs_thread_maps = {
     .stat = &proc_thread_maps_stat,
 };
 
+static const struct pseudo_fs_ops fs_thread_numa_maps = {
+    .open = &proc_thread_numa_maps_open,
+    .mode = &proc_thread_maps_mode,
+    .stat = &proc_thread_maps_stat,
+};
+
 static int proc_thread_dir_open(struct shim_handle* hdl, const char* name, int flags) {
     __UNUSED(hdl);
     __UNUSED(name);
@@ -728,7 +865,7 @@ const struct pseudo_fs_ops fs_thread = {
 };
 
 const struct pseudo_dir dir_thread = {
-    .size = 5,
+    .size = 6,
     .ent  = {
               { .name   = "cwd",
                 .fs_ops = &fs_thread_link,
@@ -745,5 +882,8 @@ const struct pseudo_dir dir_thread = {
               { .name   = "maps",
                 .fs_ops = &fs_thread_maps,
                 .type   = LINUX_DT_REG },
+              { .name   = "numa_maps",
+                .fs_ops = &fs_thread_numa_maps,
+                .type   = LINUX_DT_REG },
         }
 };
@@ -101,6 +101,7 @@ void get_dentry(struct shim_dentry* dent) {
 }
 
 static void free_dentry(struct shim_dentry* dent) {
+    file_locks_free(dent);
     destroy_lock(&dent->lock);
     free_mem_obj_to_mgr(dentry_mgr, dent);
 }
@@ -343,6 +344,8 @@ BEGIN_CP_FUNC(dentry) {
         INIT_LIST_HEAD(new_dent, siblings);
         clear_lock(&new_dent->lock);
         REF_SET(new_dent->ref_count, 0);
+        /* locks are not inherited by child processes */
+        new_dent->locks = NULL;
 
         if (new_dent->fs == &fifo_builtin_fs) {
             /* FIFO pipe, do not try to checkpoint its fs */
@@ -40,6 +40,11 @@ struct shim_fs mountable_fs[] = {
         .fs_ops = &dev_fs_ops,
         .d_ops  = &dev_d_ops,
     },
+    {
+        .name   = "sys",
+        .fs_ops = &sys_fs_ops,
+        .d_ops  = &sys_d_ops,
+    },
 };
 
 struct shim_mount* builtin_fs[] = {
@@ -49,6 +54,10 @@ struct shim_mount* builtin_fs[] = {
     &socket_builtin_fs,
     &epoll_builtin_fs,
     &eventfd_builtin_fs,
+    &timerfd_builtin_fs,
+    &signalfd_builtin_fs,
+    &mqueue_builtin_fs,
+    &shm_builtin_fs,
 };
 
 static struct shim_lock mount_mgr_lock;
@@ -77,7 +86,12 @@ int init_fs(void) {
         destroy_mem_mgr(mount_mgr);
         return -ENOMEM;
     }
-    return 0;
+
+    int ret = init_shared_mmaps();
+    if (ret < 0)
+        return ret;
+
+    return init_file_locks();
 }
 
 static struct shim_mount* alloc_mount(void) {
@@ -118,6 +132,13 @@ static int __mount_sys(struct shim_dentry* root) {
         return ret;
     }
 
+    debug("mounting as sys filesystem: /sys\n");
+
+    if ((ret = mount_fs("sys", NULL, "/sys", root, NULL, 0)) < 0) {
+        debug("mounting sys filesystem failed (%d)\n", ret);
+        return ret;
+    }
+
     debug("mounting as dev filesystem: /dev\n");
 
     struct shim_dentry* dev_dent = NULL;
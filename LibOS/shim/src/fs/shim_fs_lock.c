@@ -0,0 +1,611 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_fs_lock.c
+ *
+ * Advisory file locks: POSIX record locks (fcntl(F_SETLK) and friends, owned by the process), open
+ * file description locks (fcntl(F_OFD_SETLK) and friends, owned by the handle) and flock() locks
+ * (on the whole file, owned by the handle).
+ *
+ * The locks held in this process are kept with the dentry of the file: record locks in a tree
+ * ordered by their start, flock() locks in a list. While this process is the only one of the
+ * Graphene instance, this bookkeeping is all there is: conflicts are found in memory and blocked
+ * callers sleep until a lock of the file is released or downgraded, without any PAL call.
+ *
+ * Before the first child process is created (and in every child), the locks are delegated to the
+ * host with DkStreamLock(). Locks of a handle are placed on its own PAL handle; POSIX locks are
+ * placed on a PAL handle of the file opened for this purpose, so that the host sees all POSIX
+ * locks of the process as held by one owner. The host then finds the conflicts, also with other
+ * processes, and blocked callers wait in the host. Files which the PAL cannot lock (e.g. on
+ * Linux-SGX) keep the in-memory locks only, which do not exclude other processes.
+ *
+ * As on Linux, closing any file descriptor of a file releases the POSIX locks of the process on
+ * it, and the other locks are released by the last close of their handle. Child processes do not
+ * share handles with their parent in Graphene, so they do not inherit its flock() and OFD locks.
+ * F_GETLK reports -1 as the pid of locks held by other processes.
+ */
+
+#include <asm/fcntl.h>
+
+#include "avl_tree.h"
+#include "pal.h"
+#include "pal_error.h"
+#include "shim_checkpoint.h"
+#include "shim_fs.h"
+#include "shim_handle.h"
+#include "shim_internal.h"
+#include "shim_thread.h"
+
+DEFINE_LIST(file_lock);
+struct file_lock {
+    struct avl_tree_node node; /* in `ranges` (POSIX and OFD locks) */
+    LIST_TYPE(file_lock) list; /* in `flocks` (flock() locks) */
+    int type;                  /* F_RDLCK or F_WRLCK */
+    uint64_t start;
+    uint64_t end;
+    struct shim_handle* owner; /* NULL for POSIX locks */
+};
+DEFINE_LISTP(file_lock);
+
+DEFINE_LIST(file_lock_waiter);
+struct file_lock_waiter {
+    struct shim_thread* thread;
+    LIST_TYPE(file_lock_waiter) list;
+};
+DEFINE_LISTP(file_lock_waiter);
+
+DEFINE_LIST(shim_file_locks);
+struct shim_file_locks {
+    struct shim_lock lock;
+    struct shim_dentry* dent;
+    struct shim_qstr uri;
+    struct avl_tree ranges;
+    LISTP_TYPE(file_lock) flocks;
+    LISTP_TYPE(file_lock_waiter) waiters;
+    PAL_HANDLE host;                 /* holds the POSIX locks of this process on the host */
+    bool local;                      /* the locks could not be handed over to the host */
+    LIST_TYPE(shim_file_locks) list; /* in `g_file_locks` */
+};
+DEFINE_LISTP(shim_file_locks);
+
+static struct shim_lock g_file_locks_lock;
+static LISTP_TYPE(shim_file_locks) g_file_locks;
+
+/* Set once this process may share files with other processes; inherited by the children. */
+static bool g_file_locks_delegated __attribute_migratable = false;
+
+int init_file_locks(void) {
+    if (!create_lock(&g_file_locks_lock))
+        return -ENOMEM;
+    INIT_LISTP(&g_file_locks);
+    return 0;
+}
+
+static struct file_lock* node_to_lock(struct avl_tree_node* node) {
+    return node ? container_of(node, struct file_lock, node) : NULL;
+}
+
+static bool cmp_lock(struct avl_tree_node* a, struct avl_tree_node* b) {
+    return node_to_lock(a)->start <= node_to_lock(b)->start;
+}
+
+static struct shim_file_locks* get_file_locks(struct shim_handle* hdl, bool create) {
+    struct shim_dentry* dent = hdl->dentry;
+    struct shim_file_locks* locks = __atomic_load_n(&dent->locks, __ATOMIC_ACQUIRE);
+    if (locks || !create)
+        return locks;
+
+    locks = calloc(1, sizeof(*locks));
+    if (!locks)
+        return NULL;
+    if (!create_lock(&locks->lock)) {
+        free(locks);
+        return NULL;
+    }
+    locks->dent       = dent;
+    locks->ranges.cmp = &cmp_lock;
+    INIT_LISTP(&locks->flocks);
+    INIT_LISTP(&locks->waiters);
+    INIT_LIST_HEAD(locks, list);
+    qstrcopy(&locks->uri, &hdl->uri);
+
+    struct shim_file_locks* old;
+    lock(&g_file_locks_lock);
+    lock(&dent->lock);
+    old = dent->locks;
+    if (!old) {
+        __atomic_store_n(&dent->locks, locks, __ATOMIC_RELEASE);
+        LISTP_ADD_TAIL(locks, &g_file_locks, list);
+    }
+    unlock(&dent->lock);
+    unlock(&g_file_locks_lock);
+
+    if (old) {
+        /* another thread was faster */
+        qstrfree(&locks->uri);
+        destroy_lock(&locks->lock);
+        free(locks);
+        return old;
+    }
+    return locks;
+}
+
+static bool delegated(struct shim_file_locks* locks) {
+    return __atomic_load_n(&g_file_locks_delegated, __ATOMIC_ACQUIRE) && !locks->local;
+}
+
+/* Returns the PAL handle on which the locks of `owner` are placed on the host, or NULL if there is
+ * none. The handle for POSIX locks is opened on first use and kept until the dentry is freed, as
+ * waiters may block on it without holding `locks->lock`. */
+static PAL_HANDLE get_host_handle(struct shim_file_locks* locks, struct shim_handle* owner) {
+    if (owner)
+        return owner->pal_handle;
+
+    if (!locks->host) {
+        /* shared locks need a readable and exclusive ones a writable host file */
+        static const PAL_FLG access[] = {PAL_ACCESS_RDWR, PAL_ACCESS_RDONLY, PAL_ACCESS_WRONLY};
+        for (size_t i = 0; i < ARRAY_SIZE(access) && !locks->host; i++)
+            locks->host = DkStreamOpen(qstrgetstr(&locks->uri), access[i], 0, 0, 0);
+        if (!locks->host)
+            debug("cannot open %s to lock it on the host\n", qstrgetstr(&locks->uri));
+    }
+    return locks->host;
+}
+
+/* Places a lock of `owner` on the host; returns -ENOSYS if the file cannot be locked there. */
+static int host_lock(struct shim_file_locks* locks, int kind, struct shim_handle* owner, int type,
+                     uint64_t start, uint64_t end, bool wait) {
+    assert(locked(&locks->lock) || wait);
+
+    if (!owner && !locks->host && type == F_UNLCK)
+        return 0;
+
+    PAL_HANDLE pal_handle = get_host_handle(locks, owner);
+    if (!pal_handle)
+        return -ENOSYS;
+
+    PAL_FLG flags = wait ? PAL_LOCK_WAIT : 0;
+    PAL_NUM length = end == FILE_LOCK_EOF ? 0 : end - start;
+    if (kind == FILE_LOCK_FLOCK) {
+        flags |= PAL_LOCK_WHOLE;
+        start  = 0;
+        length = 0;
+    }
+
+    PAL_FLG pal_type = type == F_UNLCK ? PAL_LOCK_UNLOCK :
+                       type == F_RDLCK ? PAL_LOCK_SHARED : PAL_LOCK_EXCLUSIVE;
+    if (!DkStreamLock(pal_handle, pal_type, start, length, flags)) {
+        switch (PAL_NATIVE_ERRNO) {
+            case PAL_ERROR_NOTIMPLEMENTED:
+                return -ENOSYS;
+            case PAL_ERROR_TRYAGAIN:
+                return -EAGAIN;
+            case PAL_ERROR_DENIED:
+                return -EBADF;
+            case PAL_ERROR_NOMEM:
+                return -ENOLCK;
+            default:
+                return -PAL_ERRNO;
+        }
+    }
+    return 0;
+}
+
+static bool conflict(int type1, int type2) {
+    return type1 == F_WRLCK || type2 == F_WRLCK;
+}
+
+/* Returns a lock of another owner which conflicts with a `type` lock of `owner` on [start, end). */
+static struct file_lock* find_conflict(struct shim_file_locks* locks, int kind,
+                                       struct shim_handle* owner, int type, uint64_t start,
+                                       uint64_t end) {
+    struct file_lock* l;
+
+    if (kind == FILE_LOCK_FLOCK) {
+        LISTP_FOR_EACH_ENTRY(l, &locks->flocks, list) {
+            if (l->owner != owner && conflict(type, l->type))
+                return l;
+        }
+        return NULL;
+    }
+
+    for (l = node_to_lock(avl_tree_first(&locks->ranges)); l && l->start < end;
+         l = node_to_lock(avl_tree_next(&l->node))) {
+        if (l->owner != owner && start < l->end && conflict(type, l->type))
+            return l;
+    }
+    return NULL;
+}
+
+static void wake_waiters(struct shim_file_locks* locks) {
+    struct file_lock_waiter* waiter;
+    LISTP_FOR_EACH_ENTRY(waiter, &locks->waiters, list) {
+        thread_wakeup(waiter->thread);
+    }
+}
+
+static struct file_lock* take_spare(struct file_lock** spare) {
+    struct file_lock* l = spare[0] ? spare[0] : spare[1];
+    assert(l);
+    if (l == spare[0])
+        spare[0] = NULL;
+    else
+        spare[1] = NULL;
+    return l;
+}
+
+/* Sets [start, end) to `type` for `owner`, which replaces, splits or merges with the locks `owner`
+ * already has there. Needs at most two new locks, taken from `spare`. */
+static void set_range(struct shim_file_locks* locks, struct shim_handle* owner, int type,
+                      uint64_t start, uint64_t end, struct file_lock** spare) {
+    uint64_t new_start = start;
+    uint64_t new_end   = end;
+
+    struct file_lock* next;
+    for (struct file_lock* l = node_to_lock(avl_tree_first(&locks->ranges)); l && l->start <= end;
+         l = next) {
+        next = node_to_lock(avl_tree_next(&l->node));
+        if (l->owner != owner || l->end < start)
+            continue;
+
+        if (l->type == type) {
+            /* overlapping or adjacent lock of the same type: merge it into the new one */
+            new_start = MIN(new_start, l->start);
+            new_end   = MAX(new_end, l->end);
+            avl_tree_delete(&locks->ranges, &l->node);
+            free(l);
+            continue;
+        }
+
+        if (l->end == start || l->start == end)
+            continue;
+
+        if (l->start < start && end < l->end) {
+            /* the range is in the middle of `l`: keep both ends of it */
+            struct file_lock* tail = take_spare(spare);
+            *tail = (struct file_lock){
+                .type  = l->type,
+                .start = end,
+                .end   = l->end,
+                .owner = owner,
+            };
+            l->end = start;
+            avl_tree_insert(&locks->ranges, &tail->node);
+        } else if (l->start < start) {
+            l->end = start;
+        } else if (end < l->end) {
+            avl_tree_delete(&locks->ranges, &l->node);
+            l->start = end;
+            avl_tree_insert(&locks->ranges, &l->node);
+        } else {
+            avl_tree_delete(&locks->ranges, &l->node);
+            free(l);
+        }
+    }
+
+    if (type == F_UNLCK)
+        return;
+
+    struct file_lock* l = take_spare(spare);
+    *l = (struct file_lock){
+        .type  = type,
+        .start = new_start,
+        .end   = new_end,
+        .owner = owner,
+    };
+    avl_tree_insert(&locks->ranges, &l->node);
+}
+
+static void set_flock(struct shim_file_locks* locks, struct shim_handle* owner, int type,
+                      struct file_lock** spare) {
+    struct file_lock* l;
+    LISTP_FOR_EACH_ENTRY(l, &locks->flocks, list) {
+        if (l->owner != owner)
+            continue;
+        if (type == F_UNLCK) {
+            LISTP_DEL(l, &locks->flocks, list);
+            free(l);
+        } else {
+            l->type = type;
+        }
+        return;
+    }
+
+    if (type == F_UNLCK)
+        return;
+
+    l = take_spare(spare);
+    *l = (struct file_lock){
+        .type  = type,
+        .start = 0,
+        .end   = FILE_LOCK_EOF,
+        .owner = owner,
+    };
+    INIT_LIST_HEAD(l, list);
+    LISTP_ADD_TAIL(l, &locks->flocks, list);
+}
+
+int file_lock_set(struct shim_handle* hdl, int kind, int type, uint64_t start, uint64_t end,
+                  bool wait) {
+    if (!hdl->dentry)
+        return -EINVAL;
+
+    struct shim_handle* owner = kind == FILE_LOCK_POSIX ? NULL : hdl;
+    struct shim_file_locks* locks = get_file_locks(hdl, /*create=*/type != F_UNLCK);
+    if (!locks)
+        return type == F_UNLCK ? 0 : -ENOLCK;
+
+    struct file_lock* spare[2] = {malloc(sizeof(struct file_lock)),
+                                  malloc(sizeof(struct file_lock))};
+    if (!spare[0] || !spare[1]) {
+        free(spare[0]);
+        free(spare[1]);
+        return -ENOLCK;
+    }
+
+    struct shim_thread* cur = get_cur_thread();
+    struct file_lock_waiter waiter = {.thread = cur};
+    bool waiting = false;
+    int ret;
+
+    __atomic_store_n(&cur->signal_handled, false, __ATOMIC_RELEASE);
+
+    lock(&locks->lock);
+    while (true) {
+        if (delegated(locks)) {
+            ret = host_lock(locks, kind, owner, type, start, end, /*wait=*/false);
+            if (ret == -EAGAIN && wait) {
+                /* Wait in the host without blocking the other threads, then place the lock again
+                 * under `locks->lock`, so that the host and the bookkeeping cannot diverge. */
+                unlock(&locks->lock);
+                ret = host_lock(locks, kind, owner, type, start, end, /*wait=*/true);
+                lock(&locks->lock);
+                if (!ret || ret == -EAGAIN)
+                    continue;
+            }
+            if (ret == -ENOSYS) {
+                locks->local = true;
+                continue;
+            }
+            if (ret < 0)
+                break;
+        } else if (type != F_UNLCK && find_conflict(locks, kind, owner, type, start, end)) {
+            if (!wait) {
+                ret = -EAGAIN;
+                break;
+            }
+            if (__atomic_load_n(&cur->signal_handled, __ATOMIC_ACQUIRE)) {
+                ret = -EINTR;
+                break;
+            }
+            if (!waiting) {
+                INIT_LIST_HEAD(&waiter, list);
+                LISTP_ADD_TAIL(&waiter, &locks->waiters, list);
+                waiting = true;
+            }
+            thread_setwait(NULL, NULL);
+            unlock(&locks->lock);
+            ret = thread_sleep(NO_TIMEOUT);
+            lock(&locks->lock);
+            if (ret < 0 && ret != -EAGAIN && ret != -EINTR)
+                break;
+            continue;
+        }
+
+        if (kind == FILE_LOCK_FLOCK)
+            set_flock(locks, owner, type, spare);
+        else
+            set_range(locks, owner, type, start, end, spare);
+
+        /* unlocking or downgrading may let the waiters in */
+        if (type != F_WRLCK)
+            wake_waiters(locks);
+        ret = 0;
+        break;
+    }
+    if (waiting)
+        LISTP_DEL(&waiter, &locks->waiters, list);
+    unlock(&locks->lock);
+
+    free(spare[0]);
+    free(spare[1]);
+    return ret;
+}
+
+int file_lock_get(struct shim_handle* hdl, int kind, int* type, uint64_t* start, uint64_t* end,
+                  int* pid) {
+    assert(kind != FILE_LOCK_FLOCK);
+
+    if (!hdl->dentry)
+        return -EINVAL;
+
+    struct shim_handle* owner = kind == FILE_LOCK_POSIX ? NULL : hdl;
+    struct shim_file_locks* locks =
+        get_file_locks(hdl, /*create=*/__atomic_load_n(&g_file_locks_delegated, __ATOMIC_ACQUIRE));
+    if (!locks) {
+        if (__atomic_load_n(&g_file_locks_delegated, __ATOMIC_ACQUIRE))
+            return -ENOLCK;
+        *type = F_UNLCK;
+        return 0;
+    }
+
+    int ret = 0;
+    lock(&locks->lock);
+
+    /* the locks of this process are all known here, so the host is only asked about others */
+    struct file_lock* l = find_conflict(locks, kind, owner, *type, *start, *end);
+    if (l) {
+        *type  = l->type;
+        *start = l->start;
+        *end   = l->end;
+        *pid   = l->owner ? -1 : (int)get_cur_thread()->tgid;
+        goto out;
+    }
+
+    PAL_HANDLE pal_handle = NULL;
+    if (delegated(locks)) {
+        /* the POSIX locks of this process are placed on `locks->host`, so they are not reported */
+        pal_handle = get_host_handle(locks, owner);
+        if (!pal_handle)
+            locks->local = true;
+    }
+
+    if (pal_handle) {
+        PAL_FLG pal_type = *type == F_RDLCK ? PAL_LOCK_SHARED : PAL_LOCK_EXCLUSIVE;
+        PAL_NUM offset = *start;
+        PAL_NUM length = *end == FILE_LOCK_EOF ? 0 : *end - *start;
+        if (!DkStreamLockQuery(pal_handle, &pal_type, &offset, &length)) {
+            if (PAL_NATIVE_ERRNO != PAL_ERROR_NOTIMPLEMENTED) {
+                ret = -PAL_ERRNO;
+                goto out;
+            }
+            locks->local = true;
+            pal_type = PAL_LOCK_UNLOCK;
+        }
+        if (pal_type != PAL_LOCK_UNLOCK) {
+            *type  = pal_type == PAL_LOCK_SHARED ? F_RDLCK : F_WRLCK;
+            *start = offset;
+            *end   = length ? offset + length : FILE_LOCK_EOF;
+            *pid   = -1;
+            goto out;
+        }
+    }
+
+    *type = F_UNLCK;
+out:
+    unlock(&locks->lock);
+    return ret;
+}
+
+void file_locks_release(struct shim_handle* hdl, bool posix) {
+    if (!hdl->dentry)
+        return;
+
+    struct shim_file_locks* locks = get_file_locks(hdl, /*create=*/false);
+    if (!locks)
+        return;
+
+    struct shim_handle* owner = posix ? NULL : hdl;
+    bool released = false;
+
+    lock(&locks->lock);
+    struct file_lock* next;
+    for (struct file_lock* l = node_to_lock(avl_tree_first(&locks->ranges)); l; l = next) {
+        next = node_to_lock(avl_tree_next(&l->node));
+        if (l->owner == owner) {
+            avl_tree_delete(&locks->ranges, &l->node);
+            free(l);
+            released = true;
+        }
+    }
+
+    if (!posix) {
+        /* the host releases them when the PAL handle is closed */
+        struct file_lock* tmp;
+        struct file_lock* l;
+        LISTP_FOR_EACH_ENTRY_SAFE(l, tmp, &locks->flocks, list) {
+            if (l->owner == hdl) {
+                LISTP_DEL(l, &locks->flocks, list);
+                free(l);
+                released = true;
+            }
+        }
+    } else if (locks->host) {
+        host_lock(locks, FILE_LOCK_POSIX, /*owner=*/NULL, F_UNLCK, 0, FILE_LOCK_EOF,
+                  /*wait=*/false);
+    }
+
+    if (released)
+        wake_waiters(locks);
+    unlock(&locks->lock);
+}
+
+/* Releases all locks of this process on the file on the host, ignoring errors. */
+static void host_unlock_all(struct shim_file_locks* locks) {
+    host_lock(locks, FILE_LOCK_POSIX, /*owner=*/NULL, F_UNLCK, 0, FILE_LOCK_EOF, /*wait=*/false);
+
+    for (struct file_lock* l = node_to_lock(avl_tree_first(&locks->ranges)); l;
+         l = node_to_lock(avl_tree_next(&l->node))) {
+        if (l->owner)
+            host_lock(locks, FILE_LOCK_OFD, l->owner, F_UNLCK, 0, FILE_LOCK_EOF, /*wait=*/false);
+    }
+
+    struct file_lock* l;
+    LISTP_FOR_EACH_ENTRY(l, &locks->flocks, list) {
+        host_lock(locks, FILE_LOCK_FLOCK, l->owner, F_UNLCK, 0, FILE_LOCK_EOF, /*wait=*/false);
+    }
+}
+
+void file_locks_delegate(void) {
+    lock(&g_file_locks_lock);
+    if (g_file_locks_delegated) {
+        unlock(&g_file_locks_lock);
+        return;
+    }
+    __atomic_store_n(&g_file_locks_delegated, true, __ATOMIC_RELEASE);
+
+    struct shim_file_locks* locks;
+    LISTP_FOR_EACH_ENTRY(locks, &g_file_locks, list) {
+        lock(&locks->lock);
+
+        int ret = 0;
+        for (struct file_lock* l = node_to_lock(avl_tree_first(&locks->ranges)); l && !ret;
+             l = node_to_lock(avl_tree_next(&l->node)))
+            ret = host_lock(locks, l->owner ? FILE_LOCK_OFD : FILE_LOCK_POSIX, l->owner, l->type,
+                            l->start, l->end, /*wait=*/false);
+
+        struct file_lock* l;
+        LISTP_FOR_EACH_ENTRY(l, &locks->flocks, list) {
+            if (ret)
+                break;
+            ret = host_lock(locks, FILE_LOCK_FLOCK, l->owner, l->type, 0, FILE_LOCK_EOF,
+                            /*wait=*/false);
+        }
+
+        if (ret < 0) {
+            /* keep the locks of this file in this process, so they are at least consistent here;
+             * the ones already placed on the host are released again */
+            if (ret != -ENOSYS)
+                debug("cannot hand the locks of %s over to the host (%d), keeping them local\n",
+                      qstrgetstr(&locks->uri), ret);
+            host_unlock_all(locks);
+            locks->local = true;
+        }
+
+        /* waiters have to wait in the host from now on */
+        wake_waiters(locks);
+        unlock(&locks->lock);
+    }
+
+    unlock(&g_file_locks_lock);
+}
+
+void file_locks_free(struct shim_dentry* dent) {
+    struct shim_file_locks* locks = dent->locks;
+    if (!locks)
+        return;
+
+    lock(&g_file_locks_lock);
+    LISTP_DEL(locks, &g_file_locks, list);
+    unlock(&g_file_locks_lock);
+
+    struct avl_tree_node* node;
+    while ((node = avl_tree_first(&locks->ranges))) {
+        avl_tree_delete(&locks->ranges, node);
+        free(node_to_lock(node));
+    }
+
+    struct file_lock* tmp;
+    struct file_lock* l;
+    LISTP_FOR_EACH_ENTRY_SAFE(l, tmp, &locks->flocks, list) {
+        LISTP_DEL(l, &locks->flocks, list);
+        free(l);
+    }
+
+    if (locks->host)
+        DkObjectClose(locks->host);
+    qstrfree(&locks->uri);
+    destroy_lock(&locks->lock);
+    free(locks);
+    dent->locks = NULL;
+}
@@ -0,0 +1,198 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_fs_mmap.c
+ *
+ * Emulation of shared writable file mappings for PALs which cannot map files shared (DkStreamMap()
+ * fails with PAL_ERROR_NOTIMPLEMENTED; e.g. on SGX the file contents are copied into the enclave).
+ * Such mappings are created as private copies and remembered here together with a shadow copy of
+ * their contents as of the last write-back. On msync(), munmap(), fork, execve and process exit,
+ * the pages which differ from the shadow copy (i.e. the dirty pages) are written back to the file.
+ * The comparison is exact. The PALs which need this emulation cannot write-protect memory (SGX),
+ * so dirty pages cannot be tracked by write faults instead. Shared mappings which are read-only
+ * but may be made writable by mprotect() are emulated as well (see chroot_mmap()). As on Linux,
+ * writes by other processes are not visible in the mapping until it is mapped again.
+ */
+
+#include <shim_fs.h>
+#include <shim_handle.h>
+#include <shim_internal.h>
+
+#include <pal.h>
+#include <pal_error.h>
+
+struct shared_mmap {
+    struct shared_mmap* next;
+    uintptr_t begin;
+    uintptr_t end;
+    struct shim_handle* hdl;
+    off_t offset;           /* file offset of `begin` */
+    void* shadow;           /* contents as of the last write-back, allocated for the mapping as it
+                             * was created (the mapping may have been trimmed since) */
+    uintptr_t shadow_begin; /* address whose contents are at the start of `shadow` */
+};
+
+static struct shim_lock g_shared_mmaps_lock;
+static struct shared_mmap* g_shared_mmaps = NULL;
+
+int init_shared_mmaps(void) {
+    if (!create_lock(&g_shared_mmaps_lock))
+        return -ENOMEM;
+    return 0;
+}
+
+static void* shadow_page(struct shared_mmap* map, uintptr_t page) {
+    return map->shadow + (page - map->shadow_begin);
+}
+
+static bool page_dirty(struct shared_mmap* map, uintptr_t page) {
+    return memcmp((void*)page, shadow_page(map, page), g_pal_alloc_align) != 0;
+}
+
+int emulate_shared_mmap(struct shim_handle* hdl, void* addr, size_t size, off_t offset) {
+    assert(IS_ALLOC_ALIGNED_PTR(addr) && IS_ALLOC_ALIGNED(size));
+
+    struct shared_mmap* map = malloc(sizeof(*map));
+    if (!map)
+        return -ENOMEM;
+
+    map->shadow = malloc(size);
+    if (!map->shadow) {
+        free(map);
+        return -ENOMEM;
+    }
+
+    map->begin        = (uintptr_t)addr;
+    map->end          = (uintptr_t)addr + size;
+    map->offset       = offset;
+    map->shadow_begin = map->begin;
+    memcpy(map->shadow, addr, size);
+
+    get_handle(hdl);
+    map->hdl = hdl;
+
+    lock(&g_shared_mmaps_lock);
+    map->next = g_shared_mmaps;
+    g_shared_mmaps = map;
+    unlock(&g_shared_mmaps_lock);
+    return 0;
+}
+
+/* Writes back the dirty pages of `map` in [`begin`, `end`); consecutive dirty pages are written
+ * with a single call. Pages past the end of the file are not written (they cannot be accessed on
+ * Linux either). The pages are first copied to the shadow and written from there, so that writes
+ * by other threads which race with the write-back are detected by the next write-back. As on
+ * Linux, pages whose write-back failed are not retried. */
+static int write_back(struct shared_mmap* map, uintptr_t begin, uintptr_t end) {
+    off_t file_size = get_file_size(map->hdl);
+    if (file_size < 0)
+        return file_size;
+
+    uintptr_t file_end = map->begin + (file_size > map->offset ? file_size - map->offset : 0);
+    end = MIN(end, ALLOC_ALIGN_UP(file_end));
+
+    uintptr_t page = begin;
+    while (page < end) {
+        if (!page_dirty(map, page)) {
+            page += g_pal_alloc_align;
+            continue;
+        }
+
+        uintptr_t run = page;
+        do {
+            page += g_pal_alloc_align;
+        } while (page < end && page_dirty(map, page));
+
+        size_t size = MIN(page, file_end) - run;
+        off_t offset = map->offset + (run - map->begin);
+        memcpy(shadow_page(map, run), (void*)run, page - run);
+        PAL_NUM ret = DkStreamWrite(map->hdl->pal_handle, offset, size, shadow_page(map, run),
+                                    NULL);
+        if (ret == PAL_STREAM_ERROR)
+            return -PAL_ERRNO;
+        if (ret != size)
+            return -EIO;
+    }
+
+    return 0;
+}
+
+/* Forgets [`begin`, `end`) of `map`, which is at `*prev` in the list. Returns false if nothing is
+ * left of `map` and it was freed, true otherwise. */
+static bool forget_range(struct shared_mmap** prev, struct shared_mmap* map, uintptr_t begin,
+                         uintptr_t end) {
+    if (begin <= map->begin && map->end <= end) {
+        *prev = map->next;
+        put_handle(map->hdl);
+        free(map->shadow);
+        free(map);
+        return false;
+    }
+
+    if (map->begin < begin && end < map->end) {
+        /* a hole in the middle: the part after the hole becomes a new mapping */
+        struct shared_mmap* tail = malloc(sizeof(*tail));
+        void* shadow = malloc(map->end - end);
+        if (!tail || !shadow) {
+            /* just keep the whole mapping; the hole is not accessible anymore, so it is compared
+             * with the shadow (and possibly written back) only unnecessarily */
+            free(tail);
+            free(shadow);
+            return true;
+        }
+
+        memcpy(shadow, shadow_page(map, end), map->end - end);
+        tail->begin        = end;
+        tail->end          = map->end;
+        tail->offset       = map->offset + (end - map->begin);
+        tail->shadow       = shadow;
+        tail->shadow_begin = end;
+        get_handle(map->hdl);
+        tail->hdl         = map->hdl;
+        tail->next        = map->next;
+        map->next         = tail;
+        map->end          = begin;
+        return true;
+    }
+
+    if (begin <= map->begin) {
+        /* the shadow of the removed head stays allocated until the whole mapping is freed */
+        map->offset += end - map->begin;
+        map->begin = end;
+    } else {
+        map->end = begin;
+    }
+    return true;
+}
+
+static int sync_range(uintptr_t begin, uintptr_t end, bool remove) {
+    int ret = 0;
+
+    lock(&g_shared_mmaps_lock);
+    struct shared_mmap** prev = &g_shared_mmaps;
+    while (*prev) {
+        struct shared_mmap* map = *prev;
+        if (map->end <= begin || end <= map->begin) {
+            prev = &map->next;
+            continue;
+        }
+
+        int err = write_back(map, MAX(begin, map->begin), MIN(end, map->end));
+        if (err < 0 && !ret)
+            ret = err;
+
+        if (!remove || forget_range(prev, map, begin, end))
+            prev = &map->next;
+    }
+    unlock(&g_shared_mmaps_lock);
+
+    return ret;
+}
+
+int sync_shared_mmaps(void* addr, size_t length, bool remove) {
+    return sync_range((uintptr_t)addr, (uintptr_t)addr + length, remove);
+}
+
+int sync_all_shared_mmaps(bool remove) {
+    return sync_range(0, UINTPTR_MAX, remove);
+}
@@ -47,7 +47,8 @@ static int pseudo_findent(const char* path, const struct pseudo_ent* root_ent,
         const struct pseudo_dir* dir = ent->dir;
 
         for (ent = dir->ent; ent < dir->ent + dir->size; ent++) {
-            if (ent->name && !memcmp(ent->name, token, token_len)) {
+            if (ent->name && strlen(ent->name) == token_len &&
+                    !memcmp(ent->name, token, token_len)) {
                 /* directory entry has a hardcoded name that matches current token: found ent */
                 break;
             }
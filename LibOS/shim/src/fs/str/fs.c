@@ -18,6 +18,9 @@
 #include <shim_fs.h>
 #include <shim_internal.h>
 
+/* str files are kept in LibOS memory, writes which would make them larger fail with EFBIG */
+#define STR_MAX_SIZE (1UL << 32)
+
 int str_open(struct shim_handle* hdl, struct shim_dentry* dent, int flags) {
     struct shim_str_data* data = dent->data;
 
@@ -115,6 +118,35 @@ out:
     return ret;
 }
 
+/* grows the buffer of `data` so that it can hold at least `size` bytes */
+static int str_reserve(struct shim_str_data* data, size_t size) {
+    if (data->str && size <= data->buf_size)
+        return 0;
+    if (size > STR_MAX_SIZE)
+        return -EFBIG;
+
+    size_t newlen = size;
+    if (data->str) {
+        /* saturates at STR_MAX_SIZE, which is at least `size` */
+        newlen = MAX(data->buf_size, 1UL);
+        while (newlen < size)
+            newlen = newlen > STR_MAX_SIZE / 2 ? STR_MAX_SIZE : newlen * 2;
+    }
+
+    char* newbuf = malloc(newlen);
+    if (!newbuf)
+        return -ENOMEM;
+
+    if (data->str) {
+        memcpy(newbuf, data->str, data->len);
+        free(data->str);
+    }
+
+    data->str      = newbuf;
+    data->buf_size = newlen;
+    return 0;
+}
+
 ssize_t str_write(struct shim_handle* hdl, const void* buf, size_t count) {
     if (!(hdl->acc_mode & MAY_WRITE))
         return -EACCES;
@@ -126,32 +158,13 @@ ssize_t str_write(struct shim_handle* hdl, const void* buf, size_t count) {
 
     struct shim_str_data* data = strhdl->data;
 
-    if (!data->str || strhdl->ptr + count > data->str + data->buf_size) {
-        int newlen = 0;
-
-        if (data->str) {
-            newlen = data->buf_size * 2;
-
-            while (strhdl->ptr + count > data->str + newlen) {
-                newlen *= 2;
-            }
-        } else {
-            newlen = count;
-        }
-
-        char* newbuf = malloc(newlen);
-        if (!newbuf)
-            return -ENOMEM;
-
-        if (data->str) {
-            memcpy(newbuf, data->str, data->len);
-            free(data->str);
-        }
-
-        strhdl->ptr    = newbuf + (strhdl->ptr - data->str);
-        data->str      = newbuf;
-        data->buf_size = newlen;
-    }
+    size_t offset = data->str && strhdl->ptr ? strhdl->ptr - data->str : 0;
+    if (offset > STR_MAX_SIZE || count > STR_MAX_SIZE - offset)
+        return -EFBIG;
+    int ret = str_reserve(data, offset + count);
+    if (ret < 0)
+        return ret;
+    strhdl->ptr = data->str + offset;
 
     memcpy(strhdl->ptr, buf, count);
 
@@ -163,6 +176,67 @@ ssize_t str_write(struct shim_handle* hdl, const void* buf, size_t count) {
     return count;
 }
 
+ssize_t str_pread(struct shim_handle* hdl, void* buf, size_t count, off_t pos) {
+    if (!(hdl->acc_mode & MAY_READ))
+        return -EACCES;
+
+    struct shim_str_data* data = hdl->info.str.data;
+
+    assert(hdl->dentry);
+    assert(data);
+
+    if (!data->str) {
+        debug("str_data has no str\n");
+        return -EACCES;
+    }
+
+    if (pos >= data->len)
+        return 0;
+
+    if (count > (size_t)(data->len - pos))
+        count = data->len - pos;
+
+    memcpy(buf, data->str + pos, count);
+    return count;
+}
+
+ssize_t str_pwrite(struct shim_handle* hdl, const void* buf, size_t count, off_t pos) {
+    if (!(hdl->acc_mode & MAY_WRITE))
+        return -EACCES;
+
+    struct shim_str_handle* strhdl = &hdl->info.str;
+
+    assert(hdl->dentry);
+    assert(strhdl->data);
+
+    struct shim_str_data* data = strhdl->data;
+
+    off_t end;
+    if (pos < 0)
+        return -EINVAL;
+    if (__builtin_add_overflow(pos, count, &end) || (uint64_t)end > STR_MAX_SIZE)
+        return -EFBIG;
+
+    size_t offset = data->str && strhdl->ptr ? strhdl->ptr - data->str : 0;
+    int ret = str_reserve(data, end);
+    if (ret < 0)
+        return ret;
+    if (strhdl->ptr)
+        strhdl->ptr = data->str + offset;
+
+    /* writing past the end leaves a hole, which reads back as zeroes */
+    if (pos > data->len)
+        memset(data->str + data->len, 0, pos - data->len);
+
+    memcpy(data->str + pos, buf, count);
+
+    data->dirty = true;
+    if (end > data->len)
+        data->len = end;
+
+    return count;
+}
+
 off_t str_seek(struct shim_handle* hdl, off_t offset, int whence) {
     struct shim_str_handle* strhdl = &hdl->info.str;
 
@@ -222,11 +296,13 @@ int str_flush(struct shim_handle* hdl) {
 }
 
 struct shim_fs_ops str_fs_ops = {
-    .close = &str_close,
-    .read  = &str_read,
-    .write = &str_write,
-    .seek  = &str_seek,
-    .flush = &str_flush,
+    .close  = &str_close,
+    .read   = &str_read,
+    .write  = &str_write,
+    .pread  = &str_pread,
+    .pwrite = &str_pwrite,
+    .seek   = &str_seek,
+    .flush  = &str_flush,
 };
 
 struct shim_d_ops str_d_ops = {
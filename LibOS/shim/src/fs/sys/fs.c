@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*!
+ * \file
+ *
+ * This file contains the implementation of `/sys` pseudo-filesystem. Only the CPU and NUMA
+ * topology under `/sys/devices/system` is emulated (see topology.c).
+ */
+
+#include "shim_fs.h"
+
+extern const struct pseudo_fs_ops fs_sys_dir;
+extern const struct pseudo_dir dir_sys_cpu;
+extern const struct pseudo_dir dir_sys_node;
+
+static const struct pseudo_dir sys_system_dir = {
+    .size = 2,
+    .ent  = {
+              { .name   = "cpu",
+                .fs_ops = &fs_sys_dir,
+                .dir    = &dir_sys_cpu },
+              { .name   = "node",
+                .fs_ops = &fs_sys_dir,
+                .dir    = &dir_sys_node },
+            }
+};
+
+static const struct pseudo_dir sys_devices_dir = {
+    .size = 1,
+    .ent  = {
+              { .name   = "system",
+                .fs_ops = &fs_sys_dir,
+                .dir    = &sys_system_dir },
+            }
+};
+
+static const struct pseudo_dir sys_root_dir = {
+    .size = 1,
+    .ent  = {
+              { .name   = "devices",
+                .fs_ops = &fs_sys_dir,
+                .dir    = &sys_devices_dir },
+            }
+};
+
+static const struct pseudo_ent sys_root_ent = {
+    .name   = "",
+    .fs_ops = &fs_sys_dir,
+    .dir    = &sys_root_dir,
+};
+
+static int sys_mode(struct shim_dentry* dent, mode_t* mode) {
+    return pseudo_mode(dent, mode, &sys_root_ent);
+}
+
+static int sys_lookup(struct shim_dentry* dent) {
+    return pseudo_lookup(dent, &sys_root_ent);
+}
+
+static int sys_open(struct shim_handle* hdl, struct shim_dentry* dent, int flags) {
+    return pseudo_open(hdl, dent, flags, &sys_root_ent);
+}
+
+static int sys_readdir(struct shim_dentry* dent, struct shim_dirent** dirent) {
+    return pseudo_readdir(dent, dirent, &sys_root_ent);
+}
+
+static int sys_stat(struct shim_dentry* dent, struct stat* buf) {
+    return pseudo_stat(dent, buf, &sys_root_ent);
+}
+
+static int sys_hstat(struct shim_handle* hdl, struct stat* buf) {
+    return pseudo_hstat(hdl, buf, &sys_root_ent);
+}
+
+struct shim_fs_ops sys_fs_ops = {
+    .mount   = &pseudo_mount,
+    .unmount = &pseudo_unmount,
+    .close   = &str_close,
+    .read    = &str_read,
+    .write   = &str_write,
+    .pread   = &str_pread,
+    .pwrite  = &str_pwrite,
+    .seek    = &str_seek,
+    .flush   = &str_flush,
+    .hstat   = &sys_hstat,
+};
+
+struct shim_d_ops sys_d_ops = {
+    .open    = &sys_open,
+    .stat    = &sys_stat,
+    .mode    = &sys_mode,
+    .lookup  = &sys_lookup,
+    .readdir = &sys_readdir,
+};
@@ -0,0 +1,447 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*!
+ * \file
+ *
+ * This file contains the implementation of `/sys/devices/system/cpu` and
+ * `/sys/devices/system/node`, built from the CPU topology reported by the PAL. CPUs are named by
+ * their host IDs, which may be sparse (e.g. when some host CPUs are offline).
+ */
+
+#include "shim_fs.h"
+
+#define SYS_CPU_PREFIX  "devices/system/cpu/cpu"
+#define SYS_NODE_PREFIX "devices/system/node/node"
+
+static int sys_file_mode(const char* name, mode_t* mode) {
+    __UNUSED(name);
+    *mode = FILE_R_MODE | S_IFREG;
+    return 0;
+}
+
+static int sys_file_stat(const char* name, struct stat* buf) {
+    __UNUSED(name);
+    memset(buf, 0, sizeof(struct stat));
+    buf->st_dev  = 1;    /* dummy ID of device containing file */
+    buf->st_ino  = 1;    /* dummy inode number */
+    buf->st_mode = FILE_R_MODE | S_IFREG;
+    return 0;
+}
+
+/* Parses a decimal ID at the start of `str`, which must be followed by '/' or the end of string. */
+static int parse_id(const char* str, PAL_IDX* id) {
+    const char* p = str;
+    PAL_IDX val = 0;
+
+    for (; *p && *p != '/'; p++) {
+        if (*p < '0' || *p > '9')
+            return -ENOENT;
+        val = val * 10 + *p - '0';
+    }
+
+    if (p == str)
+        return -ENOENT;
+
+    *id = val;
+    return 0;
+}
+
+/* Returns the index in `cpu_info.cpu_id` of the CPU named in `name`
+ * ("devices/system/cpu/cpuN/..."), or a negative error code if there is no such CPU. */
+static int find_cpu(const char* name) {
+    if (*name == '/')
+        name++;
+    if (!strstartswith_static(name, SYS_CPU_PREFIX))
+        return -ENOENT;
+
+    PAL_IDX id;
+    int ret = parse_id(name + static_strlen(SYS_CPU_PREFIX), &id);
+    if (ret < 0)
+        return ret;
+
+    const PAL_CPU_INFO* ci = &PAL_CB(cpu_info);
+    for (size_t i = 0; i < ci->cpu_num; i++)
+        if (ci->cpu_id[i] == id)
+            return i;
+    return -ENOENT;
+}
+
+static bool node_exists(PAL_IDX node) {
+    const PAL_CPU_INFO* ci = &PAL_CB(cpu_info);
+    if (node == 0)
+        return true;
+    for (size_t i = 0; i < ci->cpu_num; i++)
+        if (ci->cpu_numa_node[i] == node)
+            return true;
+    return false;
+}
+
+/* Parses the node named in `name` ("devices/system/node/nodeN/..."). */
+static int find_node(const char* name, PAL_IDX* node) {
+    if (*name == '/')
+        name++;
+    if (!strstartswith_static(name, SYS_NODE_PREFIX))
+        return -ENOENT;
+
+    int ret = parse_id(name + static_strlen(SYS_NODE_PREFIX), node);
+    if (ret < 0)
+        return ret;
+
+    return node_exists(*node) ? 0 : -ENOENT;
+}
+
+/*
+ * Prints the IDs of CPUs for which `filter(i, arg)` holds in the sysfs list format
+ * (e.g. "0-3,8,10-11"). `cpu_info.cpu_id` is sorted, so consecutive IDs form ranges.
+ */
+static int print_cpu_list(char** str, size_t* len, bool (*filter)(size_t i, PAL_IDX arg),
+                          PAL_IDX arg) {
+    const PAL_CPU_INFO* ci = &PAL_CB(cpu_info);
+    /* each range takes at most two 10-digit IDs plus separators */
+    size_t max = ci->cpu_num * 22 + 2;
+    char* buf = malloc(max);
+    if (!buf)
+        return -ENOMEM;
+
+    size_t off = 0;
+    size_t i = 0;
+    while (i < ci->cpu_num) {
+        if (!filter(i, arg)) {
+            i++;
+            continue;
+        }
+
+        size_t j = i;
+        while (j + 1 < ci->cpu_num && filter(j + 1, arg) && ci->cpu_id[j + 1] == ci->cpu_id[j] + 1)
+            j++;
+
+        if (off)
+            buf[off++] = ',';
+        if (j == i)
+            off += snprintf(buf + off, max - off, "%u", ci->cpu_id[i]);
+        else
+            off += snprintf(buf + off, max - off, "%u-%u", ci->cpu_id[i], ci->cpu_id[j]);
+        i = j + 1;
+    }
+    buf[off++] = '\n';
+    buf[off] = '\0';
+
+    *str = buf;
+    *len = off;
+    return 0;
+}
+
+static int sys_str_open(struct shim_handle* hdl, int flags, char* str, size_t len) {
+    struct shim_str_data* data = calloc(1, sizeof(struct shim_str_data));
+    if (!data) {
+        free(str);
+        return -ENOMEM;
+    }
+
+    data->str          = str;
+    data->len          = len;
+    hdl->type          = TYPE_STR;
+    hdl->flags         = flags & ~O_RDONLY;
+    hdl->acc_mode      = MAY_READ;
+    hdl->info.str.data = data;
+    return 0;
+}
+
+static int sys_id_open(struct shim_handle* hdl, int flags, PAL_IDX id) {
+    if (flags & (O_WRONLY | O_RDWR))
+        return -EACCES;
+
+    char* str = malloc(16);
+    if (!str)
+        return -ENOMEM;
+
+    size_t len = snprintf(str, 16, "%u\n", id);
+    return sys_str_open(hdl, flags, str, len);
+}
+
+static int sys_cpu_list_open(struct shim_handle* hdl, int flags,
+                             bool (*filter)(size_t i, PAL_IDX arg), PAL_IDX arg) {
+    if (flags & (O_WRONLY | O_RDWR))
+        return -EACCES;
+
+    char* str;
+    size_t len;
+    int ret = print_cpu_list(&str, &len, filter, arg);
+    if (ret < 0)
+        return ret;
+
+    return sys_str_open(hdl, flags, str, len);
+}
+
+static bool filter_all(size_t i, PAL_IDX arg) {
+    __UNUSED(i);
+    __UNUSED(arg);
+    return true;
+}
+
+static bool filter_node(size_t i, PAL_IDX node) {
+    return PAL_CB(cpu_info.cpu_numa_node)[i] == node;
+}
+
+static bool filter_package(size_t i, PAL_IDX cpu) {
+    const PAL_CPU_INFO* ci = &PAL_CB(cpu_info);
+    return ci->cpu_package_id[i] == ci->cpu_package_id[cpu];
+}
+
+static bool filter_core(size_t i, PAL_IDX cpu) {
+    const PAL_CPU_INFO* ci = &PAL_CB(cpu_info);
+    return ci->cpu_package_id[i] == ci->cpu_package_id[cpu] &&
+           ci->cpu_core_id[i] == ci->cpu_core_id[cpu];
+}
+
+static int sys_cpu_online_open(struct shim_handle* hdl, const char* name, int flags) {
+    __UNUSED(name);
+    return sys_cpu_list_open(hdl, flags, &filter_all, 0);
+}
+
+static int sys_core_id_open(struct shim_handle* hdl, const char* name, int flags) {
+    int cpu = find_cpu(name);
+    if (cpu < 0)
+        return cpu;
+    return sys_id_open(hdl, flags, PAL_CB(cpu_info.cpu_core_id)[cpu]);
+}
+
+static int sys_package_id_open(struct shim_handle* hdl, const char* name, int flags) {
+    int cpu = find_cpu(name);
+    if (cpu < 0)
+        return cpu;
+    return sys_id_open(hdl, flags, PAL_CB(cpu_info.cpu_package_id)[cpu]);
+}
+
+static int sys_core_siblings_open(struct shim_handle* hdl, const char* name, int flags) {
+    int cpu = find_cpu(name);
+    if (cpu < 0)
+        return cpu;
+    return sys_cpu_list_open(hdl, flags, &filter_package, cpu);
+}
+
+static int sys_thread_siblings_open(struct shim_handle* hdl, const char* name, int flags) {
+    int cpu = find_cpu(name);
+    if (cpu < 0)
+        return cpu;
+    return sys_cpu_list_open(hdl, flags, &filter_core, cpu);
+}
+
+static int sys_node_online_open(struct shim_handle* hdl, const char* name, int flags) {
+    __UNUSED(name);
+    if (flags & (O_WRONLY | O_RDWR))
+        return -EACCES;
+
+    size_t max = PAL_CB(cpu_info.cpu_numa_nodes) * 11 + 2;
+    char* str = malloc(max);
+    if (!str)
+        return -ENOMEM;
+
+    size_t len = 0;
+    for (PAL_IDX node = 0; node < PAL_CB(cpu_info.cpu_numa_nodes); node++)
+        if (node_exists(node))
+            len += snprintf(str + len, max - len, len ? ",%u" : "%u", node);
+    str[len++] = '\n';
+    str[len] = '\0';
+
+    return sys_str_open(hdl, flags, str, len);
+}
+
+static int sys_node_cpulist_open(struct shim_handle* hdl, const char* name, int flags) {
+    PAL_IDX node;
+    int ret = find_node(name, &node);
+    if (ret < 0)
+        return ret;
+    return sys_cpu_list_open(hdl, flags, &filter_node, node);
+}
+
+static int sys_match_cpu(const char* name) {
+    if (!strstartswith_static(name, "cpu"))
+        return 0;
+
+    PAL_IDX id;
+    if (parse_id(name + static_strlen("cpu"), &id) < 0)
+        return 0;
+
+    const PAL_CPU_INFO* ci = &PAL_CB(cpu_info);
+    for (size_t i = 0; i < ci->cpu_num; i++)
+        if (ci->cpu_id[i] == id)
+            return 1;
+    return 0;
+}
+
+static int sys_match_node(const char* name) {
+    if (!strstartswith_static(name, "node"))
+        return 0;
+
+    PAL_IDX node;
+    if (parse_id(name + static_strlen("node"), &node) < 0)
+        return 0;
+
+    return node_exists(node) ? 1 : 0;
+}
+
+/* Appends directory entries "<prefix><id>" to `*buf` for every ID for which `filter` holds. */
+static int sys_list_ids(struct shim_dirent** buf, int count, const char* prefix, size_t ids,
+                        PAL_IDX (*get_id)(size_t i), bool (*filter)(PAL_IDX id)) {
+    struct shim_dirent* dirent = *buf;
+    void* buf_end = (void*)*buf + count;
+
+    for (size_t i = 0; i < ids; i++) {
+        PAL_IDX id = get_id(i);
+        if (filter && !filter(id))
+            continue;
+
+        char name[32];
+        int name_len = snprintf(name, sizeof(name), "%s%u", prefix, id);
+        if ((void*)(dirent + 1) + name_len + 1 > buf_end)
+            return -ENOMEM;
+
+        dirent->next = (void*)(dirent + 1) + name_len + 1;
+        dirent->ino  = 1;
+        dirent->type = LINUX_DT_DIR;
+        memcpy(dirent->name, name, name_len + 1);
+        dirent = dirent->next;
+    }
+
+    *buf = dirent;
+    return 0;
+}
+
+static PAL_IDX get_cpu_id(size_t i) {
+    return PAL_CB(cpu_info.cpu_id)[i];
+}
+
+static PAL_IDX get_node_id(size_t i) {
+    return i;
+}
+
+static int sys_list_cpu(const char* name, struct shim_dirent** buf, int count) {
+    __UNUSED(name);
+    return sys_list_ids(buf, count, "cpu", PAL_CB(cpu_info.cpu_num), &get_cpu_id,
+                        /*filter=*/NULL);
+}
+
+static int sys_list_node(const char* name, struct shim_dirent** buf, int count) {
+    __UNUSED(name);
+    return sys_list_ids(buf, count, "node", PAL_CB(cpu_info.cpu_numa_nodes), &get_node_id,
+                        &node_exists);
+}
+
+const struct pseudo_fs_ops fs_sys_dir = {
+    .open = &pseudo_dir_open,
+    .mode = &pseudo_dir_mode,
+    .stat = &pseudo_dir_stat,
+};
+
+static const struct pseudo_fs_ops fs_cpu_online = {
+    .mode = &sys_file_mode,
+    .stat = &sys_file_stat,
+    .open = &sys_cpu_online_open,
+};
+
+static const struct pseudo_fs_ops fs_core_id = {
+    .mode = &sys_file_mode,
+    .stat = &sys_file_stat,
+    .open = &sys_core_id_open,
+};
+
+static const struct pseudo_fs_ops fs_package_id = {
+    .mode = &sys_file_mode,
+    .stat = &sys_file_stat,
+    .open = &sys_package_id_open,
+};
+
+static const struct pseudo_fs_ops fs_core_siblings = {
+    .mode = &sys_file_mode,
+    .stat = &sys_file_stat,
+    .open = &sys_core_siblings_open,
+};
+
+static const struct pseudo_fs_ops fs_thread_siblings = {
+    .mode = &sys_file_mode,
+    .stat = &sys_file_stat,
+    .open = &sys_thread_siblings_open,
+};
+
+static const struct pseudo_fs_ops fs_node_online = {
+    .mode = &sys_file_mode,
+    .stat = &sys_file_stat,
+    .open = &sys_node_online_open,
+};
+
+static const struct pseudo_fs_ops fs_node_cpulist = {
+    .mode = &sys_file_mode,
+    .stat = &sys_file_stat,
+    .open = &sys_node_cpulist_open,
+};
+
+static const struct pseudo_name_ops nm_cpu = {
+    .match_name = &sys_match_cpu,
+    .list_name  = &sys_list_cpu,
+};
+
+static const struct pseudo_name_ops nm_node = {
+    .match_name = &sys_match_node,
+    .list_name  = &sys_list_node,
+};
+
+static const struct pseudo_dir dir_topology = {
+    .size = 4,
+    .ent  = {
+              { .name   = "core_id",
+                .fs_ops = &fs_core_id,
+                .type   = LINUX_DT_REG },
+              { .name   = "core_siblings_list",
+                .fs_ops = &fs_core_siblings,
+                .type   = LINUX_DT_REG },
+              { .name   = "physical_package_id",
+                .fs_ops = &fs_package_id,
+                .type   = LINUX_DT_REG },
+              { .name   = "thread_siblings_list",
+                .fs_ops = &fs_thread_siblings,
+                .type   = LINUX_DT_REG },
+            }
+};
+
+static const struct pseudo_dir dir_cpu_each = {
+    .size = 1,
+    .ent  = {
+              { .name   = "topology",
+                .fs_ops = &fs_sys_dir,
+                .dir    = &dir_topology },
+            }
+};
+
+static const struct pseudo_dir dir_node_each = {
+    .size = 1,
+    .ent  = {
+              { .name   = "cpulist",
+                .fs_ops = &fs_node_cpulist,
+                .type   = LINUX_DT_REG },
+            }
+};
+
+const struct pseudo_dir dir_sys_cpu = {
+    .size = 2,
+    .ent  = {
+              { .name   = "online",
+                .fs_ops = &fs_cpu_online,
+                .type   = LINUX_DT_REG },
+              { .name_ops = &nm_cpu,
+                .fs_ops   = &fs_sys_dir,
+                .dir      = &dir_cpu_each },
+            }
+};
+
+const struct pseudo_dir dir_sys_node = {
+    .size = 2,
+    .ent  = {
+              { .name   = "online",
+                .fs_ops = &fs_node_online,
+                .type   = LINUX_DT_REG },
+              { .name_ops = &nm_node,
+                .fs_ops   = &fs_sys_dir,
+                .dir      = &dir_node_each },
+            }
+};
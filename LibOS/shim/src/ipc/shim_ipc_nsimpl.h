@@ -1539,8 +1539,17 @@ int CONCAT2(NS, add_key)(NS_KEY* key, IDTYPE id) {
     lock(&range_map_lock);
 
     LISTP_FOR_EACH_ENTRY(k, head, hlist) {
-        if (!KEY_COMP(&k->key, key))
+        if (!KEY_COMP(&k->key, key)) {
+            if (k->id == id)
+                goto out;
+            /* Keys are never removed, so a key re-used after IPC_RMID still maps to the removed
+             * object; the most recently announced object is the live one. */
+            debug("replace key/id pair (%lu, %u) with (%lu, %u)\n", KEY_HASH(key), k->id,
+                  KEY_HASH(key), id);
+            k->id = id;
+            ret   = 0;
             goto out;
+        }
     }
 
     k = malloc(sizeof(struct key));
@@ -1597,7 +1606,8 @@ int NS_SEND(findkey)(NS_KEY* key) {
         goto out;
 
     if (dest == cur_process.vmid) {
-        ret = -ENOENT;
+        /* the leader's own key map is authoritative */
+        ret = CONCAT2(NS, get_key)(key, false);
         goto out;
     }
 
@@ -38,7 +38,10 @@
 #include "shim_ipc_nsimpl.h"
 
 int init_ns_sysv(void) {
-    return init_namespace();
+    int ret = init_namespace();
+    if (ret < 0)
+        return ret;
+    return init_sysv_shared();
 }
 
 int ipc_sysv_delres_send(struct shim_ipc_port* port, IDTYPE dest, IDTYPE resid,
@@ -11,6 +11,7 @@
 #include <pal.h>
 #include <shim_internal.h>
 #include <shim_thread.h>
+#include <shim_timer.h>
 #include <shim_utils.h>
 
 #define IDLE_SLEEP_TIME 1000
@@ -22,8 +23,8 @@ struct async_event {
     LIST_TYPE(async_event) list;
     void (*callback)(IDTYPE caller, void* arg);
     void* arg;
-    PAL_HANDLE object;     /* handle (async IO) to wait on */
-    uint64_t expire_time;  /* alarm/timer to wait on */
+    PAL_HANDLE object;        /* handle (async IO) to wait on */
+    struct shim_timer timer;  /* one-shot timer to wait on */
 };
 DEFINE_LISTP(async_event);
 static LISTP_TYPE(async_event) async_list;
@@ -38,20 +39,26 @@ static AEVENTTYPE install_new_event;
 
 static int create_async_helper(void);
 
-/* Threads register async events like alarm(), setitimer(), ioctl(FIOASYNC)
- * using this function. These events are enqueued in async_list and delivered
- * to Async Helper thread by triggering install_new_event. When event is
- * triggered in Async Helper thread, the corresponding event's callback with
- * arguments `arg` is called. This callback typically sends a signal to the
- * thread which registered the event (saved in `event->caller`).
+static void async_timer_expired(struct shim_timer* timer, uint64_t now) {
+    struct async_event* event = timer->arg;
+    debug("Async timer event triggered at %lu (expired at %lu)\n", now, timer->expire);
+    event->callback(event->caller, event->arg);
+    free(event);
+}
+
+/* Threads register async events like ioctl(FIOASYNC) or periodic internal work using this
+ * function. IO and cleanup events are enqueued in async_list and delivered to Async Helper thread
+ * by triggering install_new_event; timer events are armed on the timer wheel (see
+ * bookkeep/shim_timer.c), which also expires in Async Helper thread. When event is triggered, the
+ * corresponding event's callback with arguments `arg` is called. This callback typically sends a
+ * signal to the thread which registered the event (saved in `event->caller`).
  *
- * We distinguish between alarm/timer events and async IO events:
- *   - alarm/timer events set object = NULL and time = seconds
- *     (time = 0 cancels all pending alarms/timers).
+ * We distinguish between timer events and async IO events:
+ *   - timer events set object = NULL and time = usecs; each one is an independent one-shot
+ *     timer (alarm() and setitimer() keep their own timers, see sys/shim_alarm.c).
  *   - async IO events set object = handle and time = 0.
  *
- * Function returns remaining usecs for alarm/timer events (same as alarm())
- * or 0 for async IO events. On error, it returns a negated error code.
+ * Function returns 0 on success. On error, it returns a negated error code.
  */
 int64_t install_async_event(PAL_HANDLE object, uint64_t time,
                             void (*callback)(IDTYPE caller, void* arg), void* arg) {
@@ -63,8 +70,6 @@ int64_t install_async_event(PAL_HANDLE object, uint64_t time,
         return (int64_t)now;
     }
 
-    uint64_t max_prev_expire_time = now;
-
     struct async_event* event = malloc(sizeof(struct async_event));
     if (!event) {
         return -ENOMEM;
@@ -74,35 +79,21 @@ int64_t install_async_event(PAL_HANDLE object, uint64_t time,
     event->arg                = arg;
     event->caller             = get_cur_tid();
     event->object             = object;
-    event->expire_time        = time ? now + time : 0;
-
-    lock(&async_helper_lock);
-
-    if (callback != &cleanup_thread && !object) {
-        /* This is alarm() or setitimer() emulation, treat both according to
-         * alarm() syscall semantics: cancel any pending alarm/timer. */
-        struct async_event* tmp;
-        struct async_event* n;
-        LISTP_FOR_EACH_ENTRY_SAFE(tmp, n, &async_list, list) {
-            if (tmp->expire_time) {
-                /* this is a pending alarm/timer, cancel it and save its expiration time */
-                if (max_prev_expire_time < tmp->expire_time)
-                    max_prev_expire_time = tmp->expire_time;
-
-                LISTP_DEL(tmp, &async_list, list);
-                free(tmp);
-            }
-        }
 
-        if (!time) {
-            /* This is alarm(0), we cancelled all pending alarms/timers
-             * and user doesn't want to set a new alarm: we are done. */
+    if (time) {
+        init_timer(&event->timer, &async_timer_expired, event);
+        int ret = arm_timer(&event->timer, now + time);
+        if (ret < 0) {
+            cancel_timer(&event->timer);
             free(event);
-            unlock(&async_helper_lock);
-            return max_prev_expire_time - now;
+            return ret;
         }
+        debug("Installed async timer event at %lu\n", now);
+        return 0;
     }
 
+    lock(&async_helper_lock);
+
     INIT_LIST_HEAD(event, list);
     LISTP_ADD_TAIL(event, &async_list, list);
 
@@ -118,7 +109,23 @@ int64_t install_async_event(PAL_HANDLE object, uint64_t time,
 
     debug("Installed async event at %lu\n", now);
     set_event(&install_new_event, 1);
-    return max_prev_expire_time - now;
+    return 0;
+}
+
+/* Makes sure Async Helper thread is running and re-evaluates the timer wheel. */
+int wake_async_helper(void) {
+    lock(&async_helper_lock);
+    if (async_helper_state == HELPER_NOTALIVE) {
+        int ret = create_async_helper();
+        if (ret < 0) {
+            unlock(&async_helper_lock);
+            return ret;
+        }
+    }
+    unlock(&async_helper_lock);
+
+    set_event(&install_new_event, 1);
+    return 0;
 }
 
 int init_async(void) {
@@ -200,14 +207,13 @@ static void shim_async_helper(void* arg) {
             break;
         }
 
-        uint64_t next_expire_time = 0;
-        size_t pals_cnt            = 0;
+        size_t pals_cnt = 0;
 
         struct async_event* tmp;
         struct async_event* n;
         bool other_event = false;
         LISTP_FOR_EACH_ENTRY_SAFE(tmp, n, &async_list, list) {
-            /* repopulate `pals` with IO events and find the next expiring alarm/timer */
+            /* repopulate `pals` with IO events */
             if (tmp->object) {
                 if (pals_cnt == pals_max_cnt) {
                     /* grow `pals` to accommodate more objects */
@@ -241,20 +247,18 @@ static void shim_async_helper(void* arg) {
                 pal_events[pals_cnt + 1] = PAL_WAIT_READ;
                 ret_events[pals_cnt + 1] = 0;
                 pals_cnt++;
-            } else if (tmp->expire_time && tmp->expire_time > now) {
-                if (!next_expire_time || next_expire_time > tmp->expire_time) {
-                    /* use time of the next expiring alarm/timer */
-                    next_expire_time = tmp->expire_time;
-                }
             } else {
-                /* cleanup events do not have an object nor a timeout */
+                /* cleanup events do not have an object */
                 other_event = true;
             }
         }
 
+        /* the timer wheel has its own lock, which nests inside async_helper_lock */
+        uint64_t next_wakeup = timers_next_wakeup(now);
+
         uint64_t sleep_time;
-        if (next_expire_time) {
-            sleep_time  = next_expire_time - now;
+        if (next_wakeup != UINT64_MAX) {
+            sleep_time  = next_wakeup > now ? next_wakeup - now : 0;
             idle_cycles = 0;
         } else if (pals_cnt || other_event) {
             sleep_time = NO_TIMEOUT;
@@ -274,7 +278,7 @@ static void shim_async_helper(void* arg) {
         }
         unlock(&async_helper_lock);
 
-        /* wait on async IO events + install_new_event + next expiring alarm/timer */
+        /* wait on async IO events + install_new_event + next expiring timer */
         PAL_BOL polled = DkStreamsWaitEvents(pals_cnt + 1, pals, pal_events, ret_events, sleep_time);
 
         now = DkSystemTimeQuery();
@@ -309,16 +313,12 @@ static void shim_async_helper(void* arg) {
             }
         }
 
-        /* check if exit-child or alarm/timer events were triggered */
+        /* check if exit-child events were triggered */
         LISTP_FOR_EACH_ENTRY_SAFE(tmp, n, &async_list, list) {
             if (tmp->callback == &cleanup_thread) {
                 debug("Thread exited, cleaning up\n");
                 LISTP_DEL(tmp, &async_list, list);
                 LISTP_ADD_TAIL(tmp, &triggered, list);
-            } else if (tmp->expire_time && tmp->expire_time <= now) {
-                debug("Alarm/timer triggered at %lu (expired at %lu)\n", now, tmp->expire_time);
-                LISTP_DEL(tmp, &async_list, list);
-                LISTP_ADD_TAIL(tmp, &triggered, list);
             }
         }
 
@@ -330,13 +330,18 @@ static void shim_async_helper(void* arg) {
                 LISTP_DEL(tmp, &triggered, list);
                 tmp->callback(tmp->caller, tmp->arg);
                 if (!tmp->object) {
-                    /* this is a one-off exit-child or alarm/timer event */
+                    /* this is a one-off exit-child event */
                     free(tmp);
                 }
             }
         }
+
+        /* expire timers in one batch, outside of async_helper_lock */
+        run_expired_timers(now);
     }
 
+    timers_helper_exited();
+
     __disable_preempt(self->shim_tcb);
     put_thread(self);
     debug("Async helper thread terminated\n");
@@ -13,6 +13,7 @@
 #include <shim_table.h>
 #include <shim_tcb.h>
 #include <shim_thread.h>
+#include <shim_timer.h>
 #include <shim_handle.h>
 #include <shim_vma.h>
 #include <shim_checkpoint.h>
@@ -497,12 +498,15 @@ static int init_newproc (struct newproc_header * hdr)
             SYS_PRINTF("shim_init() in " #func " (%d)\n", _err);        \
             shim_clean_and_exit(_err);                                  \
         }                                                               \
+        record_boot_phase(#func);                                       \
     } while (0)
 
 extern PAL_HANDLE thread_start_event;
 
 noreturn void* shim_init(int argc, void* args)
 {
+    record_boot_phase("enter LibOS");
+
     debug_handle = PAL_CB(debug_stream);
     cur_process.vmid = (IDTYPE) PAL_CB(process_id);
 
@@ -566,12 +570,16 @@ noreturn void* shim_init(int argc, void* args)
     if (PAL_CB(manifest_handle))
         RUN_INIT(init_manifest, PAL_CB(manifest_handle));
 
+    RUN_INIT(init_syscall_stats);
+    RUN_INIT(init_hugepages);
     RUN_INIT(init_mount_root);
     RUN_INIT(init_ipc);
     RUN_INIT(init_thread);
     RUN_INIT(init_mount);
     RUN_INIT(init_important_handles);
+    RUN_INIT(init_timers);
     RUN_INIT(init_async);
+    RUN_INIT(init_trace);
     RUN_INIT(init_stack, argv, envp, &argcp, &argp, &auxp);
     RUN_INIT(init_loader);
     RUN_INIT(init_ipc_helper);
@@ -599,6 +607,7 @@ noreturn void* shim_init(int argc, void* args)
     }
 
     debug("shim process initialized\n");
+    print_boot_profile();
 
     if (thread_start_event)
         DkEventSet(thread_start_event);
@@ -897,6 +906,12 @@ noreturn void shim_clean_and_exit(int exit_code) {
 
     cur_process.exit_code = exit_code;
     store_all_msg_persist();
+    release_all_sem_shared();
+    release_all_msg_shared();
+    print_syscall_stats();
+    flush_trace();
+    sync_all_shared_mmaps(/*remove=*/false);
+    detach_all_shm();
     del_all_ipc_ports();
 
     if (shim_stdio && shim_stdio != (PAL_HANDLE) -1)
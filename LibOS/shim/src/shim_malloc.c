@@ -42,14 +42,21 @@ void* __system_malloc(size_t size) {
     void* addr;
     void* ret_addr;
 
-    int ret = bkeep_mmap_any(alloc_size, PROT_READ | PROT_WRITE,
-                             MAP_PRIVATE | MAP_ANONYMOUS | VMA_INTERNAL, NULL, 0, "slab", &addr);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS | VMA_INTERNAL;
+    int alloc_type = 0;
+    if (g_hugepages_enabled && alloc_size >= HUGEPAGE_SIZE) {
+        flags |= MAP_HUGETLB;
+        alloc_type = PAL_ALLOC_HUGEPAGE;
+    }
+
+    int ret = bkeep_mmap_any(alloc_size, PROT_READ | PROT_WRITE, flags, NULL, 0, "slab", &addr);
     if (ret < 0) {
         return NULL;
     }
 
     do {
-        ret_addr = DkVirtualMemoryAlloc(addr, alloc_size, 0, PAL_PROT_WRITE | PAL_PROT_READ);
+        ret_addr = DkVirtualMemoryAlloc(addr, alloc_size, alloc_type,
+                                        PAL_PROT_WRITE | PAL_PROT_READ);
 
         if (!ret_addr) {
             /* If the allocation is interrupted by signal, try to handle the
@@ -188,22 +188,28 @@ DEFINE_SHIM_SYSCALL(select, 5, shim_do_select, int, int, nfds, fd_set*, readfds,
 /* sched_yield: sys/shim_sched.c */
 DEFINE_SHIM_SYSCALL(sched_yield, 0, shim_do_sched_yield, int)
 
-SHIM_SYSCALL_RETURN_ENOSYS(mremap, 5, void*, void*, addr, size_t, old_len, size_t, new_len, int,
-                           flags, void*, new_addr)
+/* mremap: sys/shim_mmap.c */
+DEFINE_SHIM_SYSCALL(mremap, 5, shim_do_mremap, void*, void*, addr, size_t, old_len, size_t,
+                    new_len, int, flags, void*, new_addr)
 
-SHIM_SYSCALL_RETURN_ENOSYS(msync, 3, int, void*, start, size_t, len, int, flags)
+/* msync: sys/shim_mmap.c */
+DEFINE_SHIM_SYSCALL(msync, 3, shim_do_msync, int, void*, start, size_t, len, int, flags)
 
 /* mincore: sys/shim_mmap.c */
 DEFINE_SHIM_SYSCALL(mincore, 3, shim_do_mincore, int, void*, start, size_t, len, unsigned char*,
                     vec)
 
-SHIM_SYSCALL_RETURN_ENOSYS(madvise, 3, int, void*, start, size_t, len, int, behavior)
+/* madvise: sys/shim_mmap.c */
+DEFINE_SHIM_SYSCALL(madvise, 3, shim_do_madvise, int, void*, start, size_t, len, int, behavior)
 
-SHIM_SYSCALL_RETURN_ENOSYS(shmget, 3, int, key_t, key, size_t, size, int, shmflg)
+/* shmget: sys/shim_shmget.c */
+DEFINE_SHIM_SYSCALL(shmget, 3, shim_do_shmget, int, key_t, key, size_t, size, int, shmflg)
 
-SHIM_SYSCALL_RETURN_ENOSYS(shmat, 3, void*, int, shmid, const void*, shmaddr, int, shmflg)
+/* shmat: sys/shim_shmget.c */
+DEFINE_SHIM_SYSCALL(shmat, 3, shim_do_shmat, void*, int, shmid, const void*, shmaddr, int, shmflg)
 
-SHIM_SYSCALL_RETURN_ENOSYS(shmctl, 3, int, int, shmid, int, cmd, struct shmid_ds*, buf)
+/* shmctl: sys/shim_shmget.c */
+DEFINE_SHIM_SYSCALL(shmctl, 3, shim_do_shmctl, int, int, shmid, int, cmd, struct shmid_ds*, buf)
 
 /* dup: sys/shim_dup.c */
 DEFINE_SHIM_SYSCALL(dup, 1, shim_do_dup, int, unsigned int, fd)
@@ -327,7 +333,8 @@ DEFINE_SHIM_SYSCALL(semop, 3, shim_do_semop, int, int, semid, struct sembuf*, so
 DEFINE_SHIM_SYSCALL(semctl, 4, shim_do_semctl, int, int, semid, int, semnum, int, cmd,
                     unsigned long, arg)
 
-SHIM_SYSCALL_RETURN_ENOSYS(shmdt, 1, int, const void*, shmaddr)
+/* shmdt: sys/shim_shmget.c */
+DEFINE_SHIM_SYSCALL(shmdt, 1, shim_do_shmdt, int, const void*, shmaddr)
 
 /* msgget: sys/shim_msgget.c */
 DEFINE_SHIM_SYSCALL(msgget, 2, shim_do_msgget, int, key_t, key, int, msgflg)
@@ -346,7 +353,8 @@ DEFINE_SHIM_SYSCALL(msgctl, 3, shim_do_msgctl, int, int, msqid, int, cmd, struct
 /* fcntl: sys/shim_fcntl.c */
 DEFINE_SHIM_SYSCALL(fcntl, 3, shim_do_fcntl, int, int, fd, int, cmd, unsigned long, arg)
 
-SHIM_SYSCALL_RETURN_ENOSYS(flock, 2, int, int, fd, int, cmd)
+/* flock: sys/shim_fcntl.c */
+DEFINE_SHIM_SYSCALL(flock, 2, shim_do_flock, int, int, fd, int, cmd)
 
 /* fsync: sys/shim_open.c */
 DEFINE_SHIM_SYSCALL(fsync, 1, shim_do_fsync, int, int, fd)
@@ -492,8 +500,9 @@ SHIM_SYSCALL_RETURN_ENOSYS(capset, 2, int, cap_user_header_t, header, const cap_
 
 DEFINE_SHIM_SYSCALL(rt_sigpending, 2, shim_do_sigpending, int, __sigset_t*, set, size_t, sigsetsize)
 
-SHIM_SYSCALL_RETURN_ENOSYS(rt_sigtimedwait, 4, int, const __sigset_t*, uthese, siginfo_t*, uinfo,
-                           const struct timespec*, uts, size_t, sigsetsize)
+/* rt_sigtimedwait: sys/shim_sigaction.c */
+DEFINE_SHIM_SYSCALL(rt_sigtimedwait, 4, shim_do_sigtimedwait, int, const __sigset_t*, uthese,
+                    siginfo_t*, uinfo, const struct timespec*, uts, size_t, sigsetsize)
 
 SHIM_SYSCALL_RETURN_ENOSYS(rt_sigqueueinfo, 3, int, int, pid, int, sig, siginfo_t*, uinfo)
 
@@ -662,7 +671,8 @@ SHIM_SYSCALL_RETURN_ENOSYS(nfsservctl, 3, int, int, cmd, struct nfsctl_arg*, arg
 /* gettid: sys/shim_getpid.c */
 DEFINE_SHIM_SYSCALL(gettid, 0, shim_do_gettid, pid_t)
 
-SHIM_SYSCALL_RETURN_ENOSYS(readahead, 3, int, int, fd, loff_t, offset, size_t, count)
+/* readahead: sys/shim_open.c */
+DEFINE_SHIM_SYSCALL(readahead, 3, shim_do_readahead, int, int, fd, loff_t, offset, size_t, count)
 
 SHIM_SYSCALL_RETURN_ENOSYS(setxattr, 5, int, const char*, path, const char*, name, const void*,
                            value, size_t, size, int, flags)
@@ -714,18 +724,25 @@ SHIM_SYSCALL_RETURN_ENOSYS(set_thread_area, 1, int, struct user_desc*, u_info)
 
 /* no glibc wrapper */
 
-SHIM_SYSCALL_RETURN_ENOSYS(io_setup, 2, int, unsigned, nr_reqs, aio_context_t*, ctx)
+/* io_setup: sys/shim_aio.c */
+DEFINE_SHIM_SYSCALL(io_setup, 2, shim_do_io_setup, int, unsigned int, nr_events, aio_context_t*,
+                    ctxp)
 
-SHIM_SYSCALL_RETURN_ENOSYS(io_destroy, 1, int, aio_context_t, ctx)
+/* io_destroy: sys/shim_aio.c */
+DEFINE_SHIM_SYSCALL(io_destroy, 1, shim_do_io_destroy, int, aio_context_t, ctx_id)
 
-SHIM_SYSCALL_RETURN_ENOSYS(io_getevents, 5, int, aio_context_t, ctx_id, long, min_nr, long, nr,
-                           struct io_event*, events, struct timespec*, timeout)
+/* io_getevents: sys/shim_aio.c */
+DEFINE_SHIM_SYSCALL(io_getevents, 5, shim_do_io_getevents, int, aio_context_t, ctx_id, long,
+                    min_nr, long, nr, struct io_event*, events, struct __kernel_timespec*,
+                    timeout)
 
-SHIM_SYSCALL_RETURN_ENOSYS(io_submit, 3, int, aio_context_t, ctx_id, long, nr, struct iocb**,
-                           iocbpp)
+/* io_submit: sys/shim_aio.c */
+DEFINE_SHIM_SYSCALL(io_submit, 3, shim_do_io_submit, int, aio_context_t, ctx_id, long, nr,
+                    struct iocb**, iocbpp)
 
-SHIM_SYSCALL_RETURN_ENOSYS(io_cancel, 3, int, aio_context_t, ctx_id, struct iocb*, iocb,
-                           struct io_event*, result)
+/* io_cancel: sys/shim_aio.c */
+DEFINE_SHIM_SYSCALL(io_cancel, 3, shim_do_io_cancel, int, aio_context_t, ctx_id, struct iocb*,
+                    iocb, struct io_event*, result)
 
 #if defined(__i386__) || defined(__x86_64__)
 SHIM_SYSCALL_RETURN_ENOSYS(get_thread_area, 1, int, struct user_desc*, u_info)
@@ -759,21 +776,28 @@ SHIM_SYSCALL_RETURN_ENOSYS(restart_syscall, 0, int)
 DEFINE_SHIM_SYSCALL(semtimedop, 4, shim_do_semtimedop, int, int, semid, struct sembuf*, sops,
                     unsigned int, nsops, const struct timespec*, timeout)
 
-SHIM_SYSCALL_RETURN_ENOSYS(fadvise64, 4, int, int, fd, loff_t, offset, size_t, len, int, advice)
+/* fadvise64: sys/shim_open.c */
+DEFINE_SHIM_SYSCALL(fadvise64, 4, shim_do_fadvise64, int, int, fd, loff_t, offset, size_t, len, int,
+                    advice)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timer_create, 3, int, clockid_t, which_clock, struct sigevent*,
-                           timer_event_spec, timer_t*, created_timer_id)
+/* timer_create: sys/shim_alarm.c */
+DEFINE_SHIM_SYSCALL(timer_create, 3, shim_do_timer_create, int, clockid_t, which_clock,
+                    struct sigevent*, timer_event_spec, timer_t*, created_timer_id)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timer_settime, 4, int, timer_t, timer_id, int, flags,
-                           const struct __kernel_itimerspec*, new_setting,
-                           struct __kernel_itimerspec*, old_setting)
+/* timer_settime: sys/shim_alarm.c */
+DEFINE_SHIM_SYSCALL(timer_settime, 4, shim_do_timer_settime, int, timer_t, timer_id, int, flags,
+                    const struct __kernel_itimerspec*, new_setting,
+                    struct __kernel_itimerspec*, old_setting)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timer_gettime, 2, int, timer_t, timer_id, struct __kernel_itimerspec*,
-                           setting)
+/* timer_gettime: sys/shim_alarm.c */
+DEFINE_SHIM_SYSCALL(timer_gettime, 2, shim_do_timer_gettime, int, timer_t, timer_id,
+                    struct __kernel_itimerspec*, setting)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timer_getoverrun, 1, int, timer_t, timer_id)
+/* timer_getoverrun: sys/shim_alarm.c */
+DEFINE_SHIM_SYSCALL(timer_getoverrun, 1, shim_do_timer_getoverrun, int, timer_t, timer_id)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timer_delete, 1, int, timer_t, timer_id)
+/* timer_delete: sys/shim_alarm.c */
+DEFINE_SHIM_SYSCALL(timer_delete, 1, shim_do_timer_delete, int, timer_t, timer_id)
 
 SHIM_SYSCALL_RETURN_ENOSYS(clock_settime, 2, int, clockid_t, which_clock, const struct timespec*,
                            tp)
@@ -806,33 +830,42 @@ SHIM_SYSCALL_RETURN_ENOSYS(utimes, 2, int, char*, filename, struct timeval*, uti
    TODO: vserver syscall is not implemented (kernel always returns -ENOSYS),
    how should we handle this?*/
 
+/* mbind: sys/shim_mempolicy.c */
 DEFINE_SHIM_SYSCALL(mbind, 6, shim_do_mbind, int, void*, start, unsigned long, len, int, mode,
                     unsigned long*, nmask, unsigned long, maxnode, int, flags)
 
-SHIM_SYSCALL_RETURN_ENOSYS(set_mempolicy, 3, int, int, mode, unsigned long*, nmask, unsigned long,
-                           maxnode)
+/* set_mempolicy: sys/shim_mempolicy.c */
+DEFINE_SHIM_SYSCALL(set_mempolicy, 3, shim_do_set_mempolicy, int, int, mode, unsigned long*, nmask,
+                    unsigned long, maxnode)
 
-SHIM_SYSCALL_RETURN_ENOSYS(get_mempolicy, 5, int, int*, policy, unsigned long*, nmask, unsigned long,
-                           maxnode, unsigned long, addr, unsigned long, flags)
+/* get_mempolicy: sys/shim_mempolicy.c */
+DEFINE_SHIM_SYSCALL(get_mempolicy, 5, shim_do_get_mempolicy, int, int*, policy, unsigned long*,
+                    nmask, unsigned long, maxnode, unsigned long, addr, unsigned long, flags)
 
-SHIM_SYSCALL_RETURN_ENOSYS(mq_open, 4, int, const char*, name, int, oflag, mode_t, mode,
-                           struct __kernel_mq_attr*, attr)
+/* mq_open: sys/shim_mqueue.c */
+DEFINE_SHIM_SYSCALL(mq_open, 4, shim_do_mq_open, int, const char*, name, int, oflag, mode_t, mode,
+                    struct __kernel_mq_attr*, attr)
 
-SHIM_SYSCALL_RETURN_ENOSYS(mq_unlink, 1, int, const char*, name)
+/* mq_unlink: sys/shim_mqueue.c */
+DEFINE_SHIM_SYSCALL(mq_unlink, 1, shim_do_mq_unlink, int, const char*, name)
 
-SHIM_SYSCALL_RETURN_ENOSYS(mq_timedsend, 5, int, __kernel_mqd_t, mqdes, const char*, msg_ptr,
-                           size_t, msg_len, unsigned int, msg_prio, const struct timespec*,
-                           abs_timeout)
+/* mq_timedsend: sys/shim_mqueue.c */
+DEFINE_SHIM_SYSCALL(mq_timedsend, 5, shim_do_mq_timedsend, int, __kernel_mqd_t, mqdes,
+                    const char*, msg_ptr, size_t, msg_len, unsigned int, msg_prio,
+                    const struct timespec*, abs_timeout)
 
-SHIM_SYSCALL_RETURN_ENOSYS(mq_timedreceive, 5, int, __kernel_mqd_t, mqdes, char*, msg_ptr, size_t,
-                           msg_len, unsigned int*, msg_prio, const struct timespec*, abs_timeout)
+/* mq_timedreceive: sys/shim_mqueue.c */
+DEFINE_SHIM_SYSCALL(mq_timedreceive, 5, shim_do_mq_timedreceive, int, __kernel_mqd_t, mqdes,
+                    char*, msg_ptr, size_t, msg_len, unsigned int*, msg_prio,
+                    const struct timespec*, abs_timeout)
 
-SHIM_SYSCALL_RETURN_ENOSYS(mq_notify, 2, int, __kernel_mqd_t, mqdes, const struct sigevent*,
-                           notification)
+/* mq_notify: sys/shim_mqueue.c */
+DEFINE_SHIM_SYSCALL(mq_notify, 2, shim_do_mq_notify, int, __kernel_mqd_t, mqdes,
+                    const struct sigevent*, notification)
 
-SHIM_SYSCALL_RETURN_ENOSYS(mq_getsetattr, 3, int, __kernel_mqd_t, mqdes,
-                           const struct __kernel_mq_attr*, mqstat, struct __kernel_mq_attr*,
-                           omqstat)
+/* mq_getsetattr: sys/shim_mqueue.c */
+DEFINE_SHIM_SYSCALL(mq_getsetattr, 3, shim_do_mq_getsetattr, int, __kernel_mqd_t, mqdes,
+                    const struct __kernel_mq_attr*, mqstat, struct __kernel_mq_attr*, omqstat)
 
 /*
 SHIM_SYSCALL_RETURN_ENOSYS(kexec_load, 4, int, unsigned long, entry, unsigned long, nr_segments,
@@ -868,8 +901,9 @@ SHIM_SYSCALL_RETURN_ENOSYS(inotify_add_watch, 3, int, int, fd, const char*, path
 
 SHIM_SYSCALL_RETURN_ENOSYS(inotify_rm_watch, 2, int, int, fd, unsigned int, wd)
 
-SHIM_SYSCALL_RETURN_ENOSYS(migrate_pages, 4, int, pid_t, pid, unsigned long, maxnode,
-                           const unsigned long*, from, const unsigned long*, to)
+/* migrate_pages: sys/shim_mempolicy.c */
+DEFINE_SHIM_SYSCALL(migrate_pages, 4, shim_do_migrate_pages, int, pid_t, pid, unsigned long,
+                    maxnode, const unsigned long*, from, const unsigned long*, to)
 
 /* openat: sys/shim_open.c */
 DEFINE_SHIM_SYSCALL(openat, 4, shim_do_openat, int, int, dfd, const char*, filename, int, flags,
@@ -933,19 +967,22 @@ DEFINE_SHIM_SYSCALL(set_robust_list, 2, shim_do_set_robust_list, int, struct rob
 DEFINE_SHIM_SYSCALL(get_robust_list, 3, shim_do_get_robust_list, int, pid_t, pid,
                     struct robust_list_head**, head, size_t*, len)
 
-SHIM_SYSCALL_RETURN_ENOSYS(splice, 6, int, int, fd_in, loff_t*, off_in, int, fd_out, loff_t*,
-                           off_out, size_t, len, int, flags)
+/* splice: sys/shim_fs.c */
+DEFINE_SHIM_SYSCALL(splice, 6, shim_do_splice, ssize_t, int, fd_in, loff_t*, off_in, int, fd_out,
+                    loff_t*, off_out, size_t, len, int, flags)
 
 SHIM_SYSCALL_RETURN_ENOSYS(tee, 4, int, int, fdin, int, fdout, size_t, len, unsigned int, flags)
 
-SHIM_SYSCALL_RETURN_ENOSYS(sync_file_range, 4, int, int, fd, loff_t, offset, loff_t, nbytes, int,
-                           flags)
+/* sync_file_range: sys/shim_open.c */
+DEFINE_SHIM_SYSCALL(sync_file_range, 4, shim_do_sync_file_range, int, int, fd, loff_t, offset,
+                    loff_t, nbytes, int, flags)
 
 SHIM_SYSCALL_RETURN_ENOSYS(vmsplice, 4, int, int, fd, const struct iovec*, iov, unsigned long,
                            nr_segs, int, flags)
 
-SHIM_SYSCALL_RETURN_ENOSYS(move_pages, 6, int, pid_t, pid, unsigned long, nr_pages, void**, pages,
-                           const int*, nodes, int*, status, int, flags)
+/* move_pages: sys/shim_mempolicy.c */
+DEFINE_SHIM_SYSCALL(move_pages, 6, shim_do_move_pages, int, pid_t, pid, unsigned long, nr_pages,
+                    void**, pages, const int*, nodes, int*, status, int, flags)
 
 SHIM_SYSCALL_RETURN_ENOSYS(utimensat, 4, int, int, dfd, const char*, filename, struct timespec*,
                            utimes, int, flags)
@@ -954,24 +991,32 @@ DEFINE_SHIM_SYSCALL(epoll_pwait, 6, shim_do_epoll_pwait, int, int, epfd,
                     struct __kernel_epoll_event*, events, int, maxevents, int, timeout_ms,
                     const __sigset_t*, sigmask, size_t, sigsetsize)
 
-SHIM_SYSCALL_RETURN_ENOSYS(signalfd, 3, int, int, ufd, __sigset_t*, user_mask, size_t, sizemask)
+/* signalfd: sys/shim_signalfd.c */
+DEFINE_SHIM_SYSCALL(signalfd, 3, shim_do_signalfd, int, int, ufd, __sigset_t*, user_mask, size_t,
+                    sizemask)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timerfd_create, 2, int, int, clockid, int, flags)
+/* timerfd_create: sys/shim_timerfd.c */
+DEFINE_SHIM_SYSCALL(timerfd_create, 2, shim_do_timerfd_create, int, int, clockid, int, flags)
 
-SHIM_SYSCALL_RETURN_ENOSYS(fallocate, 4, int, int, fd, int, mode, loff_t, offset, loff_t, len)
+/* fallocate: sys/shim_open.c */
+DEFINE_SHIM_SYSCALL(fallocate, 4, shim_do_fallocate, int, int, fd, int, mode, loff_t, offset,
+                    loff_t, len)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timerfd_settime, 4, int, int, ufd, int, flags,
-                           const struct __kernel_itimerspec*, utmr, struct __kernel_itimerspec*,
-                           otmr)
+/* timerfd_settime: sys/shim_timerfd.c */
+DEFINE_SHIM_SYSCALL(timerfd_settime, 4, shim_do_timerfd_settime, int, int, ufd, int, flags,
+                    const struct __kernel_itimerspec*, utmr, struct __kernel_itimerspec*, otmr)
 
-SHIM_SYSCALL_RETURN_ENOSYS(timerfd_gettime, 2, int, int, ufd, struct __kernel_itimerspec*, otmr)
+/* timerfd_gettime: sys/shim_timerfd.c */
+DEFINE_SHIM_SYSCALL(timerfd_gettime, 2, shim_do_timerfd_gettime, int, int, ufd,
+                    struct __kernel_itimerspec*, otmr)
 
 /* accept4: sys/shim_socket.c */
 DEFINE_SHIM_SYSCALL(accept4, 4, shim_do_accept4, int, int, sockfd, struct sockaddr*, addr,
                     int*, addrlen, int, flags)
 
-SHIM_SYSCALL_RETURN_ENOSYS(signalfd4, 4, int, int, ufd, __sigset_t*, user_mask, size_t, sizemask,
-                           int, flags)
+/* signalfd4: sys/shim_signalfd.c */
+DEFINE_SHIM_SYSCALL(signalfd4, 4, shim_do_signalfd4, int, int, ufd, __sigset_t*, user_mask, size_t,
+                    sizemask, int, flags)
 
 DEFINE_SHIM_SYSCALL(eventfd, 1, shim_do_eventfd, int, unsigned int, count)
 
@@ -989,11 +1034,13 @@ DEFINE_SHIM_SYSCALL(pipe2, 2, shim_do_pipe2, int, int*, fildes, int, flags)
 
 SHIM_SYSCALL_RETURN_ENOSYS(inotify_init1, 1, int, int, flags)
 
-SHIM_SYSCALL_RETURN_ENOSYS(preadv, 5, int, unsigned long, fd, const struct iovec*, vec,
-                           unsigned long, vlen, unsigned long, pos_l, unsigned long, pos_h)
+/* preadv: sys/shim_open.c */
+DEFINE_SHIM_SYSCALL(preadv, 5, shim_do_preadv, ssize_t, int, fd, const struct iovec*, vec,
+                    unsigned long, vlen, unsigned long, pos_l, unsigned long, pos_h)
 
-SHIM_SYSCALL_RETURN_ENOSYS(pwritev, 5, int, unsigned long, fd, const struct iovec*, vec,
-                           unsigned long, vlen, unsigned long, pos_l, unsigned long, pos_h)
+/* pwritev: sys/shim_open.c */
+DEFINE_SHIM_SYSCALL(pwritev, 5, shim_do_pwritev, ssize_t, int, fd, const struct iovec*, vec,
+                    unsigned long, vlen, unsigned long, pos_l, unsigned long, pos_h)
 
 SHIM_SYSCALL_RETURN_ENOSYS(rt_tgsigqueueinfo, 4, int, pid_t, tgid, pid_t, pid, int, sig, siginfo_t*,
                            uinfo)
@@ -1020,7 +1067,8 @@ SHIM_SYSCALL_RETURN_ENOSYS(open_by_handle_at, 3, int, int, mountdirfd, struct li
 
 SHIM_SYSCALL_RETURN_ENOSYS(clock_adjtime, 2, int, clockid_t, which_clock, struct timex*, tx)
 
-SHIM_SYSCALL_RETURN_ENOSYS(syncfs, 1, int, int, fd)
+/* syncfs: sys/shim_open.c */
+DEFINE_SHIM_SYSCALL(syncfs, 1, shim_do_syncfs, int, int, fd)
 
 DEFINE_SHIM_SYSCALL(sendmmsg, 4, shim_do_sendmmsg, ssize_t, int, fd, struct mmsghdr*, msg,
                     unsigned int, vlen, int, flags)
@@ -1030,6 +1078,10 @@ SHIM_SYSCALL_RETURN_ENOSYS(setns, 2, int, int, fd, int, nstype)
 DEFINE_SHIM_SYSCALL(getcpu, 3, shim_do_getcpu, int, unsigned*, cpu, unsigned*, node,
                     struct getcpu_cache*, cache)
 
+/* copy_file_range: sys/shim_fs.c */
+DEFINE_SHIM_SYSCALL(copy_file_range, 6, shim_do_copy_file_range, ssize_t, int, fd_in, loff_t*,
+                    off_in, int, fd_out, loff_t*, off_out, size_t, len, unsigned int, flags)
+
 /* libos calls */
 
 DEFINE_SHIM_SYSCALL(msgpersist, 2, shim_do_msgpersist, int, int, msqid, int, cmd)
@@ -0,0 +1,745 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_aio.c
+ *
+ * Implementation of system calls "io_setup", "io_destroy", "io_getevents", "io_submit" and
+ * "io_cancel" (Linux native AIO).
+ *
+ * Submitted requests are queued to a process-wide pool of internal worker threads, which perform
+ * them with the same positional I/O helpers as pread()/pwrite()/fsync() (and thus go through the
+ * file system of the handle, ending in DkStreamRead()/DkStreamWrite()). The pool is created on the
+ * first request and grows up to `sys.aio.workers` threads; a worker that finds more queued work
+ * wakes up another idle worker, so the number of requests performed concurrently follows the queue
+ * depth of the application.
+ *
+ * As in Linux, an AIO context ID is the address of a completion ring mapped into the process (the
+ * layout of `struct aio_ring` is part of the Linux ABI and used by libaio to check for completions
+ * without a system call). Workers append completions to the tail of the ring under the context
+ * lock and publish the tail with a release store; the consumer side (io_getevents() or the
+ * application itself) only moves the head. The number of requests in flight plus completions not
+ * consumed yet is limited by the `nr_events` of io_setup(), so the ring never overflows.
+ *
+ * AIO contexts are not inherited by child processes (as in Linux).
+ */
+
+#include <errno.h>
+#include <linux/aio_abi.h>
+
+#include <list.h>
+#include <pal.h>
+#include <pal_error.h>
+#include <shim_handle.h>
+#include <shim_internal.h>
+#include <shim_table.h>
+#include <shim_thread.h>
+#include <shim_timer.h>
+#include <shim_utils.h>
+#include <shim_vma.h>
+
+#define AIO_RING_MAGIC           0xa10a10a1
+#define AIO_RING_COMPAT_FEATURES 1
+#define AIO_MAX_NR               65536  /* default of /proc/sys/fs/aio-max-nr */
+#define AIO_DEFAULT_WORKERS      4
+#define AIO_MAX_WORKERS          64
+
+/* Linux ABI, see fs/aio.c */
+struct aio_ring {
+    unsigned int id;      /* kernel internal index number */
+    unsigned int nr;      /* number of io_events */
+    unsigned int head;    /* written by the consumer */
+    unsigned int tail;    /* written by the workers */
+    unsigned int magic;
+    unsigned int compat_features;
+    unsigned int incompat_features;
+    unsigned int header_length;
+    struct io_event io_events[];
+};
+
+DEFINE_LIST(shim_aio_ctx);
+struct shim_aio_ctx {
+    LIST_TYPE(shim_aio_ctx) list;  /* protected by g_aio_ctx_lock */
+    REFTYPE ref_count;
+    struct shim_lock lock;
+    struct aio_ring* ring;         /* also the ID of the context */
+    size_t ring_size;
+    unsigned int nr;               /* size of the ring (the application may overwrite `ring->nr`) */
+    unsigned int tail;             /* next slot of the ring to fill, protected by `lock` */
+    unsigned int max_reqs;         /* `nr_events` of io_setup() */
+    unsigned int active;           /* requests in flight, protected by `lock` */
+    unsigned int waiters;          /* threads waiting for `event`, protected by `lock` */
+    bool dead;                     /* io_destroy() was called, protected by `lock` */
+    PAL_HANDLE event;              /* synchronization event set on completion */
+};
+
+DEFINE_LIST(shim_aio_req);
+struct shim_aio_req {
+    LIST_TYPE(shim_aio_req) list;  /* protected by g_aio_pool.lock */
+    struct shim_aio_ctx* ctx;
+    struct shim_handle* hdl;
+    struct shim_handle* resfd;     /* eventfd to notify, if IOCB_FLAG_RESFD */
+    struct iocb* user_iocb;
+    uint64_t data;
+    uint16_t opcode;
+    void* buf;
+    size_t nbytes;
+    off_t offset;
+    struct iovec iov[];            /* copied iovec array of PREADV/PWRITEV */
+};
+
+DEFINE_LISTP(shim_aio_ctx);
+DEFINE_LISTP(shim_aio_req);
+
+static LISTP_TYPE(shim_aio_ctx) g_aio_ctx_list = LISTP_INIT;
+static struct shim_lock g_aio_ctx_lock;
+
+static struct {
+    struct shim_lock lock;
+    LISTP_TYPE(shim_aio_req) queue;
+    PAL_HANDLE event;              /* synchronization event which wakes up one idle worker */
+    unsigned int max_workers;
+    unsigned int workers;
+    unsigned int idle;
+} g_aio_pool;
+
+static int init_aio_pool(void) {
+    if (!create_lock_runtime(&g_aio_pool.lock))
+        return -ENOMEM;
+
+    lock(&g_aio_pool.lock);
+    int ret = 0;
+    if (g_aio_pool.event)
+        goto out;
+
+    g_aio_pool.event = DkSynchronizationEventCreate(PAL_FALSE);
+    if (!g_aio_pool.event) {
+        ret = -ENOMEM;
+        goto out;
+    }
+
+    INIT_LISTP(&g_aio_pool.queue);
+    g_aio_pool.max_workers = AIO_DEFAULT_WORKERS;
+
+    char cfg[8];
+    if (root_config && get_config(root_config, "sys.aio.workers", cfg, sizeof(cfg)) > 0) {
+        uint64_t workers = parse_int(cfg);
+        if (!workers || workers > AIO_MAX_WORKERS) {
+            SYS_PRINTF("Invalid sys.aio.workers in manifest (must be 1 to %d)\n", AIO_MAX_WORKERS);
+        } else {
+            g_aio_pool.max_workers = workers;
+        }
+    }
+out:
+    unlock(&g_aio_pool.lock);
+    return ret;
+}
+
+static void get_aio_ctx(struct shim_aio_ctx* ctx) {
+    REF_INC(ctx->ref_count);
+}
+
+static void put_aio_ctx(struct shim_aio_ctx* ctx) {
+    if (REF_DEC(ctx->ref_count))
+        return;
+
+    void* tmp_vma = NULL;
+    if (bkeep_munmap(ctx->ring, ctx->ring_size, /*is_internal=*/true, &tmp_vma) < 0)
+        BUG();
+    DkVirtualMemoryFree(ctx->ring, ctx->ring_size);
+    bkeep_remove_tmp_vma(tmp_vma);
+
+    DkObjectClose(ctx->event);
+    destroy_lock(&ctx->lock);
+    free(ctx);
+}
+
+static struct shim_aio_ctx* lookup_aio_ctx(aio_context_t ctx_id) {
+    if (!create_lock_runtime(&g_aio_ctx_lock))
+        return NULL;
+
+    struct shim_aio_ctx* ret = NULL;
+    struct shim_aio_ctx* ctx;
+
+    lock(&g_aio_ctx_lock);
+    LISTP_FOR_EACH_ENTRY(ctx, &g_aio_ctx_list, list) {
+        if ((aio_context_t)ctx->ring == ctx_id) {
+            get_aio_ctx(ctx);
+            ret = ctx;
+            break;
+        }
+    }
+    unlock(&g_aio_ctx_lock);
+    return ret;
+}
+
+/* Returns the number of completions not consumed yet. Called with ctx->lock held. */
+static unsigned int ring_count(struct shim_aio_ctx* ctx) {
+    assert(locked(&ctx->lock));
+    unsigned int head = __atomic_load_n(&ctx->ring->head, __ATOMIC_ACQUIRE) % ctx->nr;
+    return ctx->tail >= head ? ctx->tail - head : ctx->nr - head + ctx->tail;
+}
+
+static void free_aio_req(struct shim_aio_req* req) {
+    put_handle(req->hdl);
+    if (req->resfd)
+        put_handle(req->resfd);
+    put_aio_ctx(req->ctx);
+    free(req);
+}
+
+/* Posts the completion event of `req` to its ring and frees `req`. */
+static void complete_aio_req(struct shim_aio_req* req, int64_t res) {
+    struct shim_aio_ctx* ctx = req->ctx;
+    struct aio_ring* ring = ctx->ring;
+
+    lock(&ctx->lock);
+    ring->io_events[ctx->tail] = (struct io_event){
+        .data = req->data,
+        .obj  = (uint64_t)req->user_iocb,
+        .res  = res,
+    };
+    ctx->tail = (ctx->tail + 1) % ctx->nr;
+    __atomic_store_n(&ring->tail, ctx->tail, __ATOMIC_RELEASE);
+    ctx->active--;
+    bool wake = ctx->waiters > 0;
+    unlock(&ctx->lock);
+
+    if (wake)
+        DkEventSet(ctx->event);
+
+    if (req->resfd) {
+        uint64_t one = 1;
+        int ret = do_handle_write(req->resfd, &one, sizeof(one));
+        if (ret < 0)
+            debug("aio: cannot notify eventfd (%d)\n", ret);
+    }
+
+    free_aio_req(req);
+}
+
+/* Returns true if the buffers of `req` are not valid user memory (anymore). */
+static bool aio_req_buffers_invalid(struct shim_aio_req* req) {
+    switch (req->opcode) {
+        case IOCB_CMD_PREAD:
+        case IOCB_CMD_PWRITE:
+            return req->nbytes &&
+                   test_user_memory(req->buf, req->nbytes, req->opcode == IOCB_CMD_PREAD);
+        case IOCB_CMD_PREADV:
+        case IOCB_CMD_PWRITEV:
+            for (size_t i = 0; i < req->nbytes; i++)
+                if (req->iov[i].iov_len &&
+                        test_user_memory(req->iov[i].iov_base, req->iov[i].iov_len,
+                                         req->opcode == IOCB_CMD_PREADV))
+                    return true;
+            return false;
+        default:
+            return false;
+    }
+}
+
+static int64_t perform_aio_req(struct shim_aio_req* req) {
+    /* the application may have unmapped the buffers since io_submit(); report that in the
+     * completion instead of faulting in the worker */
+    if (aio_req_buffers_invalid(req))
+        return -EFAULT;
+
+    switch (req->opcode) {
+        case IOCB_CMD_PREAD:
+            return do_handle_pread(req->hdl, req->buf, req->nbytes, req->offset);
+        case IOCB_CMD_PWRITE:
+            return do_handle_pwrite(req->hdl, req->buf, req->nbytes, req->offset);
+        case IOCB_CMD_PREADV:
+            return do_handle_preadv(req->hdl, req->iov, req->nbytes, req->offset);
+        case IOCB_CMD_PWRITEV:
+            return do_handle_pwritev(req->hdl, req->iov, req->nbytes, req->offset);
+        case IOCB_CMD_FSYNC:
+        case IOCB_CMD_FDSYNC:
+            return do_handle_fsync(req->hdl);
+        case IOCB_CMD_NOOP:
+            return 0;
+        default:
+            return -EINVAL;
+    }
+}
+
+static void aio_worker(void* arg) {
+    struct shim_thread* self = (struct shim_thread*)arg;
+
+    shim_tcb_init();
+    set_cur_thread(self);
+    update_fs_base(0);
+    debug_setbuf(shim_get_tcb(), true);
+    debug("AIO worker thread started\n");
+
+    lock(&g_aio_pool.lock);
+    while (true) {
+        if (LISTP_EMPTY(&g_aio_pool.queue)) {
+            g_aio_pool.idle++;
+            unlock(&g_aio_pool.lock);
+            DkSynchronizationObjectWait(g_aio_pool.event, NO_TIMEOUT);
+            lock(&g_aio_pool.lock);
+            g_aio_pool.idle--;
+            continue;
+        }
+
+        struct shim_aio_req* req = LISTP_FIRST_ENTRY(&g_aio_pool.queue, struct shim_aio_req, list);
+        LISTP_DEL_INIT(req, &g_aio_pool.queue, list);
+        /* one wakeup may stand for several submitted requests, pass it on */
+        bool wake = !LISTP_EMPTY(&g_aio_pool.queue) && g_aio_pool.idle;
+        unlock(&g_aio_pool.lock);
+
+        if (wake)
+            DkEventSet(g_aio_pool.event);
+
+        complete_aio_req(req, perform_aio_req(req));
+
+        lock(&g_aio_pool.lock);
+    }
+}
+
+/* Called with g_aio_pool.lock held. */
+static int start_aio_worker(void) {
+    assert(locked(&g_aio_pool.lock));
+
+    struct shim_thread* thread = get_new_internal_thread();
+    if (!thread)
+        return -ENOMEM;
+
+    PAL_HANDLE handle = thread_create(aio_worker, thread);
+    if (!handle) {
+        put_thread(thread);
+        return -PAL_ERRNO;
+    }
+
+    thread->pal_handle = handle;
+    g_aio_pool.workers++;
+    return 0;
+}
+
+static int queue_aio_req(struct shim_aio_req* req) {
+    lock(&g_aio_pool.lock);
+    if (!g_aio_pool.idle && g_aio_pool.workers < g_aio_pool.max_workers) {
+        int ret = start_aio_worker();
+        if (ret < 0 && !g_aio_pool.workers) {
+            unlock(&g_aio_pool.lock);
+            return ret;
+        }
+    }
+    LISTP_ADD_TAIL(req, &g_aio_pool.queue, list);
+    bool wake = g_aio_pool.idle > 0;
+    unlock(&g_aio_pool.lock);
+
+    if (wake)
+        DkEventSet(g_aio_pool.event);
+    return 0;
+}
+
+int shim_do_io_setup(unsigned int nr_events, aio_context_t* ctxp) {
+    if (!ctxp || test_user_memory(ctxp, sizeof(*ctxp), true))
+        return -EFAULT;
+
+    if (*ctxp || !nr_events)
+        return -EINVAL;
+
+    if (nr_events > AIO_MAX_NR)
+        return -EAGAIN;
+
+    int ret = init_aio_pool();
+    if (ret < 0)
+        return ret;
+
+    if (!create_lock_runtime(&g_aio_ctx_lock))
+        return -ENOMEM;
+
+    struct shim_aio_ctx* ctx = calloc(1, sizeof(*ctx));
+    if (!ctx)
+        return -ENOMEM;
+
+    if (!create_lock(&ctx->lock)) {
+        ret = -ENOMEM;
+        goto out_free;
+    }
+
+    ctx->event = DkSynchronizationEventCreate(PAL_FALSE);
+    if (!ctx->event) {
+        ret = -ENOMEM;
+        goto out_lock;
+    }
+
+    /* one slot always stays empty to tell a full ring from an empty one */
+    size_t size = ALLOC_ALIGN_UP(sizeof(struct aio_ring) +
+                                 ((size_t)nr_events + 1) * sizeof(struct io_event));
+
+    void* addr = NULL;
+    ret = bkeep_mmap_any(size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | VMA_INTERNAL, NULL, 0, "aio", &addr);
+    if (ret < 0)
+        goto out_event;
+
+    if (DkVirtualMemoryAlloc(addr, size, 0, PAL_PROT_READ | PAL_PROT_WRITE) != addr) {
+        ret = -PAL_ERRNO;
+        void* tmp_vma = NULL;
+        if (bkeep_munmap(addr, size, /*is_internal=*/true, &tmp_vma) < 0)
+            BUG();
+        bkeep_remove_tmp_vma(tmp_vma);
+        goto out_event;
+    }
+
+    struct aio_ring* ring = addr;
+    ring->nr              = (size - sizeof(*ring)) / sizeof(struct io_event);
+    ring->magic           = AIO_RING_MAGIC;
+    ring->compat_features = AIO_RING_COMPAT_FEATURES;
+    ring->header_length   = sizeof(*ring);
+
+    ctx->ring      = ring;
+    ctx->ring_size = size;
+    ctx->nr        = ring->nr;
+    ctx->max_reqs  = nr_events;
+    INIT_LIST_HEAD(ctx, list);
+    REF_SET(ctx->ref_count, 1);  /* reference of g_aio_ctx_list */
+
+    lock(&g_aio_ctx_lock);
+    LISTP_ADD_TAIL(ctx, &g_aio_ctx_list, list);
+    unlock(&g_aio_ctx_lock);
+
+    *ctxp = (aio_context_t)ring;
+    return 0;
+
+out_event:
+    DkObjectClose(ctx->event);
+out_lock:
+    destroy_lock(&ctx->lock);
+out_free:
+    free(ctx);
+    return ret;
+}
+
+int shim_do_io_destroy(aio_context_t ctx_id) {
+    struct shim_aio_ctx* ctx = lookup_aio_ctx(ctx_id);
+    if (!ctx)
+        return -EINVAL;
+
+    lock(&ctx->lock);
+    bool dead = ctx->dead;
+    ctx->dead = true;
+    unlock(&ctx->lock);
+
+    if (dead) {
+        /* lost the race with another io_destroy() */
+        put_aio_ctx(ctx);
+        return -EINVAL;
+    }
+
+    lock(&g_aio_ctx_lock);
+    LISTP_DEL_INIT(ctx, &g_aio_ctx_list, list);
+    unlock(&g_aio_ctx_lock);
+
+    /* drop the requests which did not start yet; their completions are never read */
+    LISTP_TYPE(shim_aio_req) dropped = LISTP_INIT;
+    struct shim_aio_req* req;
+    struct shim_aio_req* tmp;
+    lock(&g_aio_pool.lock);
+    LISTP_FOR_EACH_ENTRY_SAFE(req, tmp, &g_aio_pool.queue, list) {
+        if (req->ctx == ctx) {
+            LISTP_DEL_INIT(req, &g_aio_pool.queue, list);
+            LISTP_ADD_TAIL(req, &dropped, list);
+        }
+    }
+    unlock(&g_aio_pool.lock);
+
+    LISTP_FOR_EACH_ENTRY_SAFE(req, tmp, &dropped, list) {
+        LISTP_DEL_INIT(req, &dropped, list);
+        lock(&ctx->lock);
+        ctx->active--;
+        unlock(&ctx->lock);
+        free_aio_req(req);
+    }
+
+    /* as in Linux, wait for the requests which are being performed */
+    lock(&ctx->lock);
+    ctx->waiters++;
+    while (ctx->active) {
+        unlock(&ctx->lock);
+        DkSynchronizationObjectWait(ctx->event, NO_TIMEOUT);
+        lock(&ctx->lock);
+    }
+    ctx->waiters--;
+    bool wake = ctx->waiters > 0;
+    unlock(&ctx->lock);
+
+    /* let concurrent io_getevents() notice that the context is gone */
+    if (wake)
+        DkEventSet(ctx->event);
+
+    put_aio_ctx(ctx);  /* reference of this function */
+    put_aio_ctx(ctx);  /* reference of g_aio_ctx_list */
+    return 0;
+}
+
+static int submit_iocb(struct shim_aio_ctx* ctx, struct iocb* user_iocb) {
+    if (test_user_memory(user_iocb, sizeof(*user_iocb), false))
+        return -EFAULT;
+
+    struct iocb iocb = *user_iocb;
+    if (iocb.aio_reserved2)
+        return -EINVAL;
+    if (iocb.aio_rw_flags)
+        return -EOPNOTSUPP;
+
+    size_t iov_size = 0;
+    switch (iocb.aio_lio_opcode) {
+        case IOCB_CMD_PWRITE:
+        case IOCB_CMD_PREAD:
+            if ((ssize_t)iocb.aio_nbytes < 0)
+                return -EINVAL;
+            break;
+        case IOCB_CMD_PWRITEV:
+        case IOCB_CMD_PREADV:
+            if (iocb.aio_nbytes > UIO_MAXIOV)
+                return -EINVAL;
+            iov_size = iocb.aio_nbytes * sizeof(struct iovec);
+            if (test_user_memory((void*)iocb.aio_buf, iov_size, false))
+                return -EFAULT;
+            break;
+        case IOCB_CMD_FSYNC:
+        case IOCB_CMD_FDSYNC:
+        case IOCB_CMD_NOOP:
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    if (iocb.aio_offset < 0 && iocb.aio_lio_opcode != IOCB_CMD_FSYNC &&
+            iocb.aio_lio_opcode != IOCB_CMD_FDSYNC && iocb.aio_lio_opcode != IOCB_CMD_NOOP)
+        return -EINVAL;
+
+    struct shim_aio_req* req = calloc(1, sizeof(*req) + iov_size);
+    if (!req)
+        return -ENOMEM;
+
+    int ret;
+    req->hdl = get_fd_handle(iocb.aio_fildes, NULL, NULL);
+    if (!req->hdl) {
+        ret = -EBADF;
+        goto out_free;
+    }
+
+    if (iocb.aio_flags & IOCB_FLAG_RESFD) {
+        req->resfd = get_fd_handle(iocb.aio_resfd, NULL, NULL);
+        if (!req->resfd) {
+            ret = -EBADF;
+            goto out_hdl;
+        }
+        if (req->resfd->type != TYPE_EVENTFD) {
+            ret = -EINVAL;
+            goto out_resfd;
+        }
+    }
+
+    req->user_iocb = user_iocb;
+    req->data      = iocb.aio_data;
+    req->opcode    = iocb.aio_lio_opcode;
+    req->buf       = (void*)iocb.aio_buf;
+    req->nbytes    = iocb.aio_nbytes;
+    req->offset    = iocb.aio_offset;
+    INIT_LIST_HEAD(req, list);
+
+    if (iov_size) {
+        /* copy the iovec array, as Linux does */
+        memcpy(req->iov, (void*)iocb.aio_buf, iov_size);
+        size_t total = 0;
+        for (size_t i = 0; i < req->nbytes; i++) {
+            if (__builtin_add_overflow(total, req->iov[i].iov_len, &total) ||
+                    (ssize_t)total < 0) {
+                ret = -EINVAL;
+                goto out_resfd;
+            }
+        }
+    }
+
+    /* the buffers are checked again by the worker, right before the request is performed */
+    if (aio_req_buffers_invalid(req)) {
+        ret = -EFAULT;
+        goto out_resfd;
+    }
+
+    lock(&ctx->lock);
+    if (ctx->dead) {
+        ret = -EINVAL;
+    } else if (ctx->active + ring_count(ctx) >= ctx->max_reqs) {
+        ret = -EAGAIN;
+    } else {
+        ctx->active++;
+        ret = 0;
+    }
+    unlock(&ctx->lock);
+    if (ret < 0)
+        goto out_resfd;
+
+    get_aio_ctx(ctx);
+    req->ctx = ctx;
+
+    ret = queue_aio_req(req);
+    if (ret < 0) {
+        lock(&ctx->lock);
+        ctx->active--;
+        unlock(&ctx->lock);
+        free_aio_req(req);
+    }
+    return ret;
+
+out_resfd:
+    if (req->resfd)
+        put_handle(req->resfd);
+out_hdl:
+    put_handle(req->hdl);
+out_free:
+    free(req);
+    return ret;
+}
+
+int shim_do_io_submit(aio_context_t ctx_id, long nr, struct iocb** iocbpp) {
+    if (nr < 0)
+        return -EINVAL;
+
+    struct shim_aio_ctx* ctx = lookup_aio_ctx(ctx_id);
+    if (!ctx)
+        return -EINVAL;
+
+    if (nr > ctx->max_reqs)
+        nr = ctx->max_reqs;
+
+    long submitted = 0;
+    int ret = 0;
+    if (nr && test_user_memory(iocbpp, sizeof(*iocbpp) * nr, false)) {
+        ret = -EFAULT;
+        goto out;
+    }
+
+    for (; submitted < nr; submitted++) {
+        ret = submit_iocb(ctx, iocbpp[submitted]);
+        if (ret < 0)
+            break;
+    }
+
+out:
+    put_aio_ctx(ctx);
+    return submitted ?: ret;
+}
+
+/* Returns the number of events copied to `events` (at most `nr`). */
+static long harvest_aio_events(struct shim_aio_ctx* ctx, struct io_event* events, long nr) {
+    assert(locked(&ctx->lock));
+
+    struct aio_ring* ring = ctx->ring;
+    unsigned int head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED) % ctx->nr;
+
+    long copied = 0;
+    while (head != ctx->tail && copied < nr) {
+        events[copied++] = ring->io_events[head];
+        head = (head + 1) % ctx->nr;
+    }
+    __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    return copied;
+}
+
+int shim_do_io_getevents(aio_context_t ctx_id, long min_nr, long nr, struct io_event* events,
+                         struct __kernel_timespec* timeout) {
+    if (min_nr < 0 || nr < 0 || min_nr > nr)
+        return -EINVAL;
+
+    if (nr && (!events || test_user_memory(events, sizeof(*events) * nr, true)))
+        return -EFAULT;
+
+    uint64_t deadline = NO_TIMEOUT;
+    if (timeout) {
+        if (test_user_memory(timeout, sizeof(*timeout), false))
+            return -EFAULT;
+        if (!timer_timespec_valid(timeout))
+            return -EINVAL;
+
+        uint64_t now = DkSystemTimeQuery();
+        if ((int64_t)now < 0)
+            return -PAL_ERRNO;
+        deadline = timer_deadline(now, timer_timespec_to_us(timeout));
+    }
+
+    struct shim_aio_ctx* ctx = lookup_aio_ctx(ctx_id);
+    if (!ctx)
+        return -EINVAL;
+
+    long copied = 0;
+    int ret = 0;
+
+    lock(&ctx->lock);
+    while (true) {
+        copied += harvest_aio_events(ctx, events + copied, nr - copied);
+        if (copied >= min_nr || copied == nr || ctx->dead)
+            break;
+
+        uint64_t wait_us = NO_TIMEOUT;
+        if (deadline != NO_TIMEOUT) {
+            uint64_t now = DkSystemTimeQuery();
+            if ((int64_t)now < 0) {
+                ret = -PAL_ERRNO;
+                break;
+            }
+            if (now >= deadline)
+                break;
+            wait_us = deadline - now;
+        }
+
+        ctx->waiters++;
+        unlock(&ctx->lock);
+        bool ok = DkSynchronizationObjectWait(ctx->event, wait_us);
+        int err = ok ? 0 : PAL_NATIVE_ERRNO;
+        lock(&ctx->lock);
+        ctx->waiters--;
+
+        if (err == PAL_ERROR_INTERRUPTED) {
+            copied += harvest_aio_events(ctx, events + copied, nr - copied);
+            ret = -EINTR;
+            break;
+        }
+    }
+
+    /* one completion may have woken up only one of several waiters, pass it on */
+    bool wake = ctx->waiters > 0 && ring_count(ctx) > 0;
+    unlock(&ctx->lock);
+
+    if (wake)
+        DkEventSet(ctx->event);
+
+    put_aio_ctx(ctx);
+    return copied ?: ret;
+}
+
+int shim_do_io_cancel(aio_context_t ctx_id, struct iocb* iocb, struct io_event* result) {
+    __UNUSED(result);
+
+    struct shim_aio_ctx* ctx = lookup_aio_ctx(ctx_id);
+    if (!ctx)
+        return -EINVAL;
+
+    struct shim_aio_req* found = NULL;
+    struct shim_aio_req* req;
+    lock(&g_aio_pool.lock);
+    LISTP_FOR_EACH_ENTRY(req, &g_aio_pool.queue, list) {
+        if (req->ctx == ctx && req->user_iocb == iocb) {
+            LISTP_DEL_INIT(req, &g_aio_pool.queue, list);
+            found = req;
+            break;
+        }
+    }
+    unlock(&g_aio_pool.lock);
+
+    put_aio_ctx(ctx);
+
+    /* Only requests which did not start yet can be cancelled. As in Linux 4.19 and later, the
+     * completion (with -ECANCELED) is posted to the ring and `result` is not used. */
+    if (!found)
+        return -EINVAL;
+
+    complete_aio_req(found, -ECANCELED);
+    return -EINPROGRESS;
+}
@@ -4,65 +4,167 @@
 /*
  * shim_alarm.c
  *
- * Implementation of system call "alarm", "setitmer" and "getitimer".
+ * Implementation of system calls "alarm", "setitimer", "getitimer", "timer_create",
+ * "timer_settime", "timer_gettime", "timer_getoverrun" and "timer_delete". All timers are armed
+ * on the timer wheel (see bookkeep/shim_timer.c). Graphene does not account CPU time, so
+ * ITIMER_VIRTUAL and ITIMER_PROF count wall-clock time, and all clocks of POSIX timers are the
+ * same clock.
  */
 
+#include <limits.h>
 #include <stdint.h>
 
 #include "shim_internal.h"
 #include "shim_signal.h"
 #include "shim_table.h"
 #include "shim_thread.h"
+#include "shim_timer.h"
 #include "shim_utils.h"
 
-static void signal_alarm(IDTYPE caller, void* arg) {
-    (void)do_kill_proc(caller, (IDTYPE)(uintptr_t)arg, SIGALRM, /*use_ipc=*/false);
+#ifndef ITIMER_REAL
+#define ITIMER_REAL 0
+#endif
+#ifndef ITIMER_VIRTUAL
+#define ITIMER_VIRTUAL 1
+#endif
+#ifndef ITIMER_PROF
+#define ITIMER_PROF 2
+#endif
+#define ITIMERS_CNT 3
+
+#ifndef TIMER_ABSTIME
+#define TIMER_ABSTIME 1
+#endif
+
+#define POSIX_TIMERS_INIT_SIZE 8
+
+/* All state below is protected by MASTER_LOCK. */
+static struct itimer {
+    struct shim_timer timer;
+    uint64_t interval;
+    bool armed;
+    IDTYPE tgid;
+} itimers[ITIMERS_CNT];
+
+static const int itimer_signals[ITIMERS_CNT] = {
+    [ITIMER_REAL]    = SIGALRM,
+    [ITIMER_VIRTUAL] = SIGVTALRM,
+    [ITIMER_PROF]    = SIGPROF,
+};
+
+struct posix_timer {
+    struct shim_timer timer;
+    uint64_t interval;
+    bool armed;
+    timer_t id;
+    int notify;
+    int signo;
+    sigval_t value;
+    IDTYPE tgid;
+    IDTYPE tid;      /* for SIGEV_THREAD_ID */
+    int overrun;     /* expirations missed before the last one */
+};
+
+static struct posix_timer** posix_timers;
+static size_t posix_timers_size;
+
+/* Remaining time of a timer, as reported by getitimer() and timer_gettime(). A timer which expired
+ * but was not processed yet reports the smallest non-zero time, because zero means disarmed. */
+static uint64_t timer_remaining(struct shim_timer* timer, bool armed, uint64_t now) {
+    if (!armed || !timer_pending(timer))
+        return 0;
+    return timer->expire > now ? timer->expire - now : 1;
 }
 
-int shim_do_alarm(unsigned int seconds) {
-    uint64_t usecs = 1000000ULL * seconds;
+static void itimer_expired(struct shim_timer* timer, uint64_t now) {
+    struct itimer* itimer = timer->arg;
 
-    int64_t ret = install_async_event(NULL, usecs, &signal_alarm,
-                                      (void*)(uintptr_t)get_cur_thread()->tgid);
-    if (ret < 0)
-        return ret;
+    MASTER_LOCK();
+    if (!itimer->armed || timer_pending(timer)) {
+        /* disarmed or re-armed after this expiration was collected */
+        MASTER_UNLOCK();
+        return;
+    }
 
-    uint64_t usecs_left = (uint64_t)ret;
-    int secs            = usecs_left / 1000000ULL;
-    if (usecs_left % 1000000ULL)
-        secs++;
-    return secs;
+    if (itimer->interval) {
+        uint64_t next;
+        timer_expirations(timer->expire, itimer->interval, now, &next);
+        (void)arm_timer(timer, next);
+    } else {
+        itimer->armed = false;
+    }
+
+    IDTYPE tgid = itimer->tgid;
+    MASTER_UNLOCK();
+
+    siginfo_t info = {
+        .si_signo = itimer_signals[itimer - itimers],
+        .si_code  = SI_KERNEL,
+    };
+    (void)do_kill_proc_info(tgid, &info);
 }
 
-static struct {
-    unsigned long timeout;
-    unsigned long reset;
-} real_itimer;
+static int set_itimer(int which, uint64_t value, uint64_t interval, uint64_t* old_value,
+                      uint64_t* old_interval) {
+    uint64_t now = DkSystemTimeQuery();
+    if ((int64_t)now < 0)
+        return -PAL_ERRNO;
 
-static void signal_itimer(IDTYPE target, void* arg) {
-    // XXX: Can we simplify this code or streamline with the other callback?
-    __UNUSED(target);
+    struct itimer* itimer = &itimers[which];
+    int ret = 0;
 
     MASTER_LOCK();
 
-    if (real_itimer.timeout != (unsigned long)arg) {
-        MASTER_UNLOCK();
-        return;
+    if (!itimer->timer.func)
+        init_timer(&itimer->timer, &itimer_expired, itimer);
+
+    if (old_value)
+        *old_value = timer_remaining(&itimer->timer, itimer->armed, now);
+    if (old_interval)
+        *old_interval = itimer->interval;
+
+    cancel_timer(&itimer->timer);
+    itimer->interval = interval;
+    itimer->armed    = !!value;
+    itimer->tgid     = get_cur_thread()->tgid;
+
+    if (value) {
+        ret = arm_timer(&itimer->timer, timer_deadline(now, value));
+        if (ret < 0) {
+            cancel_timer(&itimer->timer);
+            itimer->armed = false;
+        }
     }
 
-    real_itimer.timeout += real_itimer.reset;
-    real_itimer.reset = 0;
     MASTER_UNLOCK();
+    return ret;
 }
 
-#ifndef ITIMER_REAL
-#define ITIMER_REAL 0
-#endif
+int shim_do_alarm(unsigned int seconds) {
+    uint64_t usecs_left;
+    int ret = set_itimer(ITIMER_REAL, 1000000ULL * seconds, /*interval=*/0, &usecs_left, NULL);
+    if (ret < 0)
+        return ret;
+
+    int secs = usecs_left / 1000000ULL;
+    if (usecs_left % 1000000ULL)
+        secs++;
+    return secs;
+}
+
+static bool timeval_valid(const struct __kernel_timeval* tv) {
+    return tv->tv_sec >= 0 && tv->tv_usec >= 0 && tv->tv_usec < 1000000;
+}
+
+static void us_to_timeval(uint64_t us, struct __kernel_timeval* tv) {
+    tv->tv_sec  = us / 1000000;
+    tv->tv_usec = us % 1000000;
+}
 
 int shim_do_setitimer(int which, struct __kernel_itimerval* value,
                       struct __kernel_itimerval* ovalue) {
-    if (which != ITIMER_REAL)
-        return -ENOSYS;
+    if (which < 0 || which >= ITIMERS_CNT)
+        return -EINVAL;
 
     if (!value)
         return -EFAULT;
@@ -71,60 +173,301 @@ int shim_do_setitimer(int which, struct __kernel_itimerval* value,
     if (ovalue && test_user_memory(ovalue, sizeof(*ovalue), true))
         return -EFAULT;
 
-    unsigned long setup_time = DkSystemTimeQuery();
+    if (!timeval_valid(&value->it_value) || !timeval_valid(&value->it_interval))
+        return -EINVAL;
 
-    unsigned long next_value = value->it_value.tv_sec * 1000000 + value->it_value.tv_usec;
-    unsigned long next_reset = value->it_interval.tv_sec * 1000000 + value->it_interval.tv_usec;
+    uint64_t next_value = value->it_value.tv_sec * 1000000UL + value->it_value.tv_usec;
+    uint64_t next_reset = value->it_interval.tv_sec * 1000000UL + value->it_interval.tv_usec;
+
+    uint64_t current_timeout;
+    uint64_t current_reset;
+    int ret = set_itimer(which, next_value, next_reset, &current_timeout, &current_reset);
+    if (ret < 0)
+        return ret;
+
+    if (ovalue) {
+        us_to_timeval(current_reset, &ovalue->it_interval);
+        us_to_timeval(current_timeout, &ovalue->it_value);
+    }
+
+    return 0;
+}
+
+int shim_do_getitimer(int which, struct __kernel_itimerval* value) {
+    if (which < 0 || which >= ITIMERS_CNT)
+        return -EINVAL;
+
+    if (!value)
+        return -EFAULT;
+    if (test_user_memory(value, sizeof(*value), true))
+        return -EFAULT;
+
+    uint64_t now = DkSystemTimeQuery();
+    if ((int64_t)now < 0)
+        return -PAL_ERRNO;
 
     MASTER_LOCK();
+    uint64_t current_timeout = timer_remaining(&itimers[which].timer, itimers[which].armed, now);
+    uint64_t current_reset   = itimers[which].interval;
+    MASTER_UNLOCK();
 
-    unsigned long current_timeout =
-        real_itimer.timeout > setup_time ? real_itimer.timeout - setup_time : 0;
-    unsigned long current_reset = real_itimer.reset;
+    us_to_timeval(current_reset, &value->it_interval);
+    us_to_timeval(current_timeout, &value->it_value);
+    return 0;
+}
 
-    int64_t ret =
-        install_async_event(NULL, next_value, &signal_itimer, (void*)(setup_time + next_value));
+static void posix_timer_expired(struct shim_timer* timer, uint64_t now) {
+    struct posix_timer* ptimer = timer->arg;
 
-    if (ret < 0) {
+    MASTER_LOCK();
+    if (!ptimer->armed || timer_pending(timer)) {
+        /* disarmed, deleted or re-armed after this expiration was collected */
         MASTER_UNLOCK();
-        return ret;
+        return;
+    }
+
+    uint64_t cnt = 1;
+    if (ptimer->interval) {
+        uint64_t next;
+        cnt = timer_expirations(timer->expire, ptimer->interval, now, &next);
+        (void)arm_timer(timer, next);
+    } else {
+        ptimer->armed = false;
     }
+    ptimer->overrun = cnt - 1 > INT_MAX ? INT_MAX : (int)(cnt - 1);
 
-    real_itimer.timeout = setup_time + next_value;
-    real_itimer.reset   = next_reset;
+    siginfo_t info = {
+        .si_signo = ptimer->signo,
+        .si_code  = SI_TIMER,
+    };
+    info.si_tid     = ptimer->id;
+    info.si_overrun = ptimer->overrun;
+    info.si_value   = ptimer->value;
 
+    int notify  = ptimer->notify;
+    IDTYPE tgid = ptimer->tgid;
+    IDTYPE tid  = ptimer->tid;
     MASTER_UNLOCK();
 
-    if (ovalue) {
-        ovalue->it_interval.tv_sec  = current_reset / 1000000;
-        ovalue->it_interval.tv_usec = current_reset % 1000000;
-        ovalue->it_value.tv_sec     = current_timeout / 1000000;
-        ovalue->it_value.tv_usec    = current_timeout % 1000000;
+    if (notify == SIGEV_THREAD_ID) {
+        (void)do_kill_thread_info(tgid, tid, &info);
+    } else if (notify == SIGEV_SIGNAL) {
+        (void)do_kill_proc_info(tgid, &info);
     }
+}
 
-    return 0;
+/* Must be called with MASTER_LOCK held. */
+static struct posix_timer* lookup_posix_timer(timer_t id) {
+    if (id < 0 || (size_t)id >= posix_timers_size)
+        return NULL;
+    return posix_timers[id];
 }
 
-int shim_do_getitimer(int which, struct __kernel_itimerval* value) {
-    if (which != ITIMER_REAL)
-        return -ENOSYS;
+static bool clock_supported(clockid_t which_clock) {
+    switch (which_clock) {
+        case CLOCK_REALTIME:
+        case CLOCK_MONOTONIC:
+        case CLOCK_BOOTTIME:
+            return true;
+        default:
+            return false;
+    }
+}
 
-    if (!value)
+int shim_do_timer_create(clockid_t which_clock, struct sigevent* timer_event_spec,
+                         timer_t* created_timer_id) {
+    if (!clock_supported(which_clock))
+        return -EINVAL;
+
+    if (!created_timer_id || test_user_memory(created_timer_id, sizeof(*created_timer_id), true))
         return -EFAULT;
-    if (test_user_memory(value, sizeof(*value), true))
+    if (timer_event_spec && test_user_memory(timer_event_spec, sizeof(*timer_event_spec), false))
         return -EFAULT;
 
-    unsigned long setup_time = DkSystemTimeQuery();
+    struct shim_thread* cur = get_cur_thread();
+
+    struct posix_timer* ptimer = calloc(1, sizeof(*ptimer));
+    if (!ptimer)
+        return -ENOMEM;
+
+    init_timer(&ptimer->timer, &posix_timer_expired, ptimer);
+    ptimer->tgid = cur->tgid;
+
+    if (timer_event_spec) {
+        ptimer->notify = timer_event_spec->sigev_notify;
+        ptimer->signo  = timer_event_spec->sigev_signo;
+        ptimer->value  = timer_event_spec->sigev_value;
+
+        int ret = 0;
+        switch (ptimer->notify) {
+            case SIGEV_NONE:
+                break;
+            case SIGEV_SIGNAL:
+                if (ptimer->signo <= 0 || ptimer->signo > NUM_SIGS)
+                    ret = -EINVAL;
+                break;
+            case SIGEV_THREAD_ID: {
+                if (ptimer->signo <= 0 || ptimer->signo > NUM_SIGS) {
+                    ret = -EINVAL;
+                    break;
+                }
+                ptimer->tid = timer_event_spec->sigev_notify_thread_id;
+                struct shim_thread* thread = lookup_thread(ptimer->tid);
+                if (!thread || thread->tgid != cur->tgid)
+                    ret = -EINVAL;
+                if (thread)
+                    put_thread(thread);
+                break;
+            }
+            default:
+                /* SIGEV_THREAD is implemented by libc on top of SIGEV_THREAD_ID */
+                ret = -EINVAL;
+                break;
+        }
+        if (ret < 0) {
+            free(ptimer);
+            return ret;
+        }
+    } else {
+        ptimer->notify = SIGEV_SIGNAL;
+        ptimer->signo  = SIGALRM;
+    }
 
     MASTER_LOCK();
-    unsigned long current_timeout =
-        real_itimer.timeout > setup_time ? real_itimer.timeout - setup_time : 0;
-    unsigned long current_reset = real_itimer.reset;
+
+    size_t id = 0;
+    while (id < posix_timers_size && posix_timers[id])
+        id++;
+
+    if (id == posix_timers_size) {
+        size_t new_size = posix_timers_size ? posix_timers_size * 2 : POSIX_TIMERS_INIT_SIZE;
+        if (new_size > INT_MAX) {
+            MASTER_UNLOCK();
+            free(ptimer);
+            return -EAGAIN;
+        }
+
+        struct posix_timer** new_timers = calloc(new_size, sizeof(*new_timers));
+        if (!new_timers) {
+            MASTER_UNLOCK();
+            free(ptimer);
+            return -ENOMEM;
+        }
+        if (posix_timers_size)
+            memcpy(new_timers, posix_timers, posix_timers_size * sizeof(*new_timers));
+        free(posix_timers);
+        posix_timers      = new_timers;
+        posix_timers_size = new_size;
+    }
+
+    ptimer->id = (timer_t)id;
+    if (!timer_event_spec)
+        ptimer->value.sival_int = ptimer->id;
+    posix_timers[id] = ptimer;
+
+    MASTER_UNLOCK();
+
+    *created_timer_id = ptimer->id;
+    return 0;
+}
+
+int shim_do_timer_settime(timer_t timer_id, int flags,
+                          const struct __kernel_itimerspec* new_setting,
+                          struct __kernel_itimerspec* old_setting) {
+    if (!new_setting || test_user_memory((void*)new_setting, sizeof(*new_setting), false))
+        return -EFAULT;
+    if (old_setting && test_user_memory(old_setting, sizeof(*old_setting), true))
+        return -EFAULT;
+
+    struct __kernel_itimerspec setting = *new_setting;
+    if (!timer_timespec_valid(&setting.it_value) || !timer_timespec_valid(&setting.it_interval))
+        return -EINVAL;
+
+    uint64_t now = DkSystemTimeQuery();
+    if ((int64_t)now < 0)
+        return -PAL_ERRNO;
+
+    uint64_t value    = timer_timespec_to_us(&setting.it_value);
+    uint64_t interval = timer_timespec_to_us(&setting.it_interval);
+    int ret = 0;
+
+    MASTER_LOCK();
+
+    struct posix_timer* ptimer = lookup_posix_timer(timer_id);
+    if (!ptimer) {
+        MASTER_UNLOCK();
+        return -EINVAL;
+    }
+
+    if (old_setting) {
+        uint64_t remaining = timer_remaining(&ptimer->timer, ptimer->armed, now);
+        timer_us_to_timespec(remaining, &old_setting->it_value);
+        timer_us_to_timespec(ptimer->interval, &old_setting->it_interval);
+    }
+
+    cancel_timer(&ptimer->timer);
+    ptimer->interval = interval;
+    ptimer->armed    = !!value;
+    ptimer->overrun  = 0;
+
+    if (value) {
+        uint64_t expire = (flags & TIMER_ABSTIME) ? value : timer_deadline(now, value);
+        ret = arm_timer(&ptimer->timer, expire);
+        if (ret < 0) {
+            cancel_timer(&ptimer->timer);
+            ptimer->armed = false;
+        }
+    }
+
+    MASTER_UNLOCK();
+    return ret;
+}
+
+int shim_do_timer_gettime(timer_t timer_id, struct __kernel_itimerspec* setting) {
+    if (!setting || test_user_memory(setting, sizeof(*setting), true))
+        return -EFAULT;
+
+    uint64_t now = DkSystemTimeQuery();
+    if ((int64_t)now < 0)
+        return -PAL_ERRNO;
+
+    MASTER_LOCK();
+    struct posix_timer* ptimer = lookup_posix_timer(timer_id);
+    if (!ptimer) {
+        MASTER_UNLOCK();
+        return -EINVAL;
+    }
+    uint64_t value    = timer_remaining(&ptimer->timer, ptimer->armed, now);
+    uint64_t interval = ptimer->interval;
+    MASTER_UNLOCK();
+
+    timer_us_to_timespec(value, &setting->it_value);
+    timer_us_to_timespec(interval, &setting->it_interval);
+    return 0;
+}
+
+int shim_do_timer_getoverrun(timer_t timer_id) {
+    MASTER_LOCK();
+    struct posix_timer* ptimer = lookup_posix_timer(timer_id);
+    int ret = ptimer ? ptimer->overrun : -EINVAL;
+    MASTER_UNLOCK();
+    return ret;
+}
+
+int shim_do_timer_delete(timer_t timer_id) {
+    MASTER_LOCK();
+    struct posix_timer* ptimer = lookup_posix_timer(timer_id);
+    if (!ptimer) {
+        MASTER_UNLOCK();
+        return -EINVAL;
+    }
+    posix_timers[timer_id] = NULL;
+    cancel_timer(&ptimer->timer);
+    ptimer->armed = false;
     MASTER_UNLOCK();
 
-    value->it_interval.tv_sec  = current_reset / 1000000;
-    value->it_interval.tv_usec = current_reset % 1000000;
-    value->it_value.tv_sec     = current_timeout / 1000000;
-    value->it_value.tv_usec    = current_timeout % 1000000;
+    /* the callback may be running right now; it takes MASTER_LOCK, so wait outside of it */
+    sync_timer(&ptimer->timer);
+    free(ptimer);
     return 0;
 }
@@ -76,9 +76,16 @@ int init_brk_region(void* brk_start, size_t data_segment_size) {
         }
 
         brk_start = (char*)brk_start + offset;
+        if (g_hugepages_enabled) {
+            /* huge pages can back only the parts of the heap aligned to their size */
+            brk_start = ALIGN_UP_PTR(brk_start, HUGEPAGE_SIZE);
+            if ((uintptr_t)brk_start > (uintptr_t)PAL_CB(user_address.end) - brk_max_size)
+                brk_start = NULL;
+        }
 
-        ret = bkeep_mmap_fixed(brk_start, brk_max_size, PROT_NONE,
-                               MAP_FIXED_NOREPLACE | VMA_UNMAPPED, NULL, 0, "heap");
+        ret = brk_start ? bkeep_mmap_fixed(brk_start, brk_max_size, PROT_NONE,
+                                           MAP_FIXED_NOREPLACE | VMA_UNMAPPED, NULL, 0, "heap")
+                        : 0;
         if (ret == -EEXIST) {
             /* Let's try mapping brk anywhere. */
             brk_start = NULL;
@@ -94,8 +101,9 @@ int init_brk_region(void* brk_start, size_t data_segment_size) {
 
     if (!brk_start) {
         int ret;
-        ret = bkeep_mmap_any_aslr(brk_max_size, PROT_NONE, VMA_UNMAPPED, NULL, 0, "heap",
-                                  &brk_start);
+        ret = bkeep_mmap_any_aslr(brk_max_size, PROT_NONE,
+                                  VMA_UNMAPPED | (g_hugepages_enabled ? MAP_HUGETLB : 0), NULL, 0,
+                                  "heap", &brk_start);
         if (ret < 0) {
             return ret;
         }
@@ -175,12 +183,14 @@ void* shim_do_brk(void* _brk) {
     assert(size);
 
     if (bkeep_mmap_fixed(brk_current, size, PROT_READ | PROT_WRITE,
-                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED |
+                         (g_hugepages_enabled ? MAP_HUGETLB : 0),
                          NULL, 0, "heap") < 0) {
         goto out;
     }
 
-    if (!DkVirtualMemoryAlloc(brk_current, size, 0, PAL_PROT_READ | PAL_PROT_WRITE)) {
+    if (!DkVirtualMemoryAlloc(brk_current, size, g_hugepages_enabled ? PAL_ALLOC_HUGEPAGE : 0,
+                              PAL_PROT_READ | PAL_PROT_WRITE)) {
         if (bkeep_mmap_fixed(brk_current, brk_region.brk_end - brk_current, PROT_NONE,
                              MAP_FIXED | VMA_UNMAPPED, NULL, 0, "heap") < 0) {
             BUG();
@@ -23,6 +23,7 @@
 #include <errno.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <linux/mempolicy.h>
 #include <linux/sched.h>
 
 void __attribute__((weak)) syscall_wrapper_after_syscalldb(void)
@@ -100,6 +101,10 @@ static int clone_implementation_wrapper(struct shim_clone_args * arg)
     debug_setbuf(tcb, true);
     debug("set fs_base to 0x%lx\n", tcb->context.fs_base);
 
+    /* the host thread starts with the default policy, not the one inherited from the parent */
+    if (my_thread->mempolicy.mode != MPOL_DEFAULT)
+        apply_mempolicy(/*addr=*/NULL, /*length=*/0, &my_thread->mempolicy, /*move=*/false);
+
     struct shim_regs regs = *arg->parent->shim_tcb->context.regs;
     if (my_thread->set_child_tid) {
         *(my_thread->set_child_tid) = my_thread->tid;
@@ -41,8 +41,10 @@ int shim_do_dup2(unsigned int oldfd, unsigned int newfd) {
 
     struct shim_handle* new_hdl = detach_fd_handle(newfd, NULL, handle_map);
 
-    if (new_hdl)
+    if (new_hdl) {
+        file_locks_release(new_hdl, /*posix=*/true);
         put_handle(new_hdl);
+    }
 
     // dup2() always zeroes fd flags
     int vfd = set_new_fd_handle_by_fd(newfd, hdl, /*fd_flags=*/0, handle_map);
@@ -61,8 +63,10 @@ int shim_do_dup3(unsigned int oldfd, unsigned int newfd, int flags) {
 
     struct shim_handle* new_hdl = detach_fd_handle(newfd, NULL, handle_map);
 
-    if (new_hdl)
+    if (new_hdl) {
+        file_locks_release(new_hdl, /*posix=*/true);
         put_handle(new_hdl);
+    }
 
     int fd_flags = (flags & O_CLOEXEC) ? FD_CLOEXEC : 0;
     int vfd = set_new_fd_handle_by_fd(newfd, hdl, fd_flags, handle_map);
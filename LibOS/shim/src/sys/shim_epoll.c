@@ -182,11 +182,20 @@ int shim_do_epoll_ctl(int epfd, int op, int fd, struct __kernel_epoll_event* eve
                 goto out;
             }
             /* note that pipe and socket may not have pal_handle yet (e.g. before bind()) */
-            if (hdl->type != TYPE_PIPE && hdl->type != TYPE_SOCK && hdl->type != TYPE_EVENTFD) {
+            if (hdl->type != TYPE_PIPE && hdl->type != TYPE_SOCK && hdl->type != TYPE_EVENTFD &&
+                    hdl->type != TYPE_TIMERFD && hdl->type != TYPE_SIGNALFD &&
+                    hdl->type != TYPE_MQUEUE) {
                 ret = -EPERM;
                 put_handle(hdl);
                 goto out;
             }
+            if (hdl->type == TYPE_MQUEUE) {
+                ret = mqueue_watch(hdl);
+                if (ret < 0) {
+                    put_handle(hdl);
+                    goto out;
+                }
+            }
             if (epoll->pal_cnt == MAX_EPOLL_HANDLES) {
                 ret = -ENOSPC;
                 put_handle(hdl);
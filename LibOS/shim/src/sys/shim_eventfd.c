@@ -20,19 +20,21 @@
 #include <shim_table.h>
 #include <shim_utils.h>
 
-static int create_eventfd(PAL_HANDLE* efd, unsigned count, int flags) {
+bool eventfd_allowed(void) {
     if (!root_config) {
         /* eventfd must be explicitly allowed in manifest; error out if no manifest found */
-        return -ENOSYS;
+        return false;
     }
 
     char eventfd_cfg[2];
     ssize_t len =
         get_config(root_config, "sys.insecure__allow_eventfd", eventfd_cfg, sizeof(eventfd_cfg));
-    if (len != 1 || eventfd_cfg[0] != '1') {
-        /* eventfd is not explicitly allowed in manifest */
+    return len == 1 && eventfd_cfg[0] == '1';
+}
+
+static int create_eventfd(PAL_HANDLE* efd, unsigned count, int flags) {
+    if (!eventfd_allowed())
         return -ENOSYS;
-    }
 
     PAL_HANDLE hdl = NULL;
     int pal_flags  = 0;
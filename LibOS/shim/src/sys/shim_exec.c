@@ -85,6 +85,10 @@ noreturn static void __shim_do_execve_rtld(struct execve_rtld_arg* __arg) {
 
     reset_brk();
 
+    /* the new program does not see any of the current mappings, write back the shared ones */
+    sync_all_shared_mmaps(/*remove=*/true);
+    detach_all_shm();
+
     size_t count;
     struct shim_vma_info* vmas;
     ret = dump_all_vmas(&vmas, &count, /*include_unmapped=*/true);
@@ -96,6 +100,9 @@ noreturn static void __shim_do_execve_rtld(struct execve_rtld_arg* __arg) {
         /* Don't free the current stack */
         if (vma->addr == cur_thread->stack || vma->addr == cur_thread->stack_red)
             continue;
+        /* SysV objects and POSIX message queues stay attached across execve */
+        if ((vma->flags & VMA_INTERNAL) && !strcmp(vma->comment, "sysv"))
+            continue;
 
         void* tmp_vma = NULL;
         if (bkeep_munmap(vma->addr, vma->length, !!(vma->flags & VMA_INTERNAL), &tmp_vma) < 0) {
@@ -452,6 +459,8 @@ reopen:
     debug(
         "Temporary process %u is exiting after emulating execve (by forking new process to replace"
         " this one); will wait for forked process to exit...\n", cur_process.vmid & 0xFFFF);
+    /* the new program does not inherit the attachments of this process */
+    detach_all_shm();
     MASTER_LOCK();
     DkProcessExit(PAL_WAIT_FOR_CHILDREN_EXIT);
 
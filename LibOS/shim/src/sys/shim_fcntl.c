@@ -4,7 +4,7 @@
 /*
  * shim_fcntl.c
  *
- * Implementation of system call "fcntl".
+ * Implementation of system calls "fcntl" and "flock".
  */
 
 #include <errno.h>
@@ -18,6 +18,110 @@
 #include <shim_thread.h>
 #include <shim_utils.h>
 
+/* Converts the range of `fl` to [`*start`, `*end`), as Linux does in flock_to_posix_lock(). */
+static int flock_to_range(struct shim_handle* hdl, struct flock* fl, uint64_t* start,
+                          uint64_t* end) {
+    off_t origin;
+    switch (fl->l_whence) {
+        case SEEK_SET:
+            origin = 0;
+            break;
+        case SEEK_CUR:
+            lock(&hdl->lock);
+            origin = hdl->type == TYPE_FILE ? hdl->info.file.marker : 0;
+            unlock(&hdl->lock);
+            break;
+        case SEEK_END:
+            origin = get_file_size(hdl);
+            if (origin < 0)
+                return origin;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    off_t lock_start;
+    if (__builtin_add_overflow(origin, fl->l_start, &lock_start))
+        return -EOVERFLOW;
+
+    off_t lock_end;
+    if (fl->l_len > 0) {
+        if (__builtin_add_overflow(lock_start, fl->l_len - 1, &lock_end))
+            return -EOVERFLOW;
+        lock_end++;
+    } else if (fl->l_len < 0) {
+        lock_end = lock_start;
+        lock_start += fl->l_len;
+    } else {
+        lock_end = -1;
+    }
+
+    if (lock_start < 0)
+        return -EINVAL;
+
+    *start = lock_start;
+    *end   = lock_end < 0 ? FILE_LOCK_EOF : (uint64_t)lock_end;
+    return 0;
+}
+
+static int fcntl_setlk(struct shim_handle* hdl, int kind, struct flock* fl, bool wait) {
+    if (test_user_memory(fl, sizeof(*fl), /*write=*/false))
+        return -EFAULT;
+
+    if (kind == FILE_LOCK_OFD && fl->l_pid)
+        return -EINVAL;
+
+    switch (fl->l_type) {
+        case F_RDLCK:
+            if (!(hdl->acc_mode & MAY_READ))
+                return -EBADF;
+            break;
+        case F_WRLCK:
+            if (!(hdl->acc_mode & MAY_WRITE))
+                return -EBADF;
+            break;
+        case F_UNLCK:
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    uint64_t start, end;
+    int ret = flock_to_range(hdl, fl, &start, &end);
+    if (ret < 0)
+        return ret;
+
+    return file_lock_set(hdl, kind, fl->l_type, start, end, wait);
+}
+
+static int fcntl_getlk(struct shim_handle* hdl, int kind, struct flock* fl) {
+    if (test_user_memory(fl, sizeof(*fl), /*write=*/true))
+        return -EFAULT;
+
+    if ((kind == FILE_LOCK_OFD && fl->l_pid) || (fl->l_type != F_RDLCK && fl->l_type != F_WRLCK))
+        return -EINVAL;
+
+    uint64_t start, end;
+    int ret = flock_to_range(hdl, fl, &start, &end);
+    if (ret < 0)
+        return ret;
+
+    int type = fl->l_type;
+    int pid  = 0;
+    ret = file_lock_get(hdl, kind, &type, &start, &end, &pid);
+    if (ret < 0)
+        return ret;
+
+    fl->l_type = type;
+    if (type != F_UNLCK) {
+        fl->l_whence = SEEK_SET;
+        fl->l_start  = start;
+        fl->l_len    = end == FILE_LOCK_EOF ? 0 : end - start;
+        fl->l_pid    = pid;
+    }
+    return 0;
+}
+
 int shim_do_fcntl(int fd, int cmd, unsigned long arg) {
     struct shim_handle_map* handle_map = get_cur_handle_map(NULL);
     int flags;
@@ -143,7 +247,7 @@ int shim_do_fcntl(int fd, int cmd, unsigned long arg) {
          *   EACCES or EAGAIN.
          */
         case F_SETLK:
-            ret = -ENOSYS;
+            ret = fcntl_setlk(hdl, FILE_LOCK_POSIX, (struct flock*)arg, /*wait=*/false);
             break;
 
         /* F_SETLKW (struct flock *)
@@ -154,7 +258,7 @@ int shim_do_fcntl(int fd, int cmd, unsigned long arg) {
          *   set to EINTR; see signal(7)).
          */
         case F_SETLKW:
-            ret = -ENOSYS;
+            ret = fcntl_setlk(hdl, FILE_LOCK_POSIX, (struct flock*)arg, /*wait=*/true);
             break;
 
         /* F_GETLK (struct flock *)
@@ -168,7 +272,26 @@ int shim_do_fcntl(int fd, int cmd, unsigned long arg) {
          *   the PID of the process holding that lock.
          */
         case F_GETLK:
-            ret = -ENOSYS;
+            ret = fcntl_getlk(hdl, FILE_LOCK_POSIX, (struct flock*)arg);
+            break;
+
+        /* Open file description locks (non-POSIX)
+         *   F_OFD_SETLK, F_OFD_SETLKW and F_OFD_GETLK work like F_SETLK, F_SETLKW and F_GETLK, but
+         *   the locks are associated with the open file description on which they are acquired,
+         *   not with the process. They conflict with locks of other open file descriptions, also
+         *   in the same process, and are only released when the last file descriptor of the open
+         *   file description is closed. l_pid must be 0.
+         */
+        case F_OFD_SETLK:
+            ret = fcntl_setlk(hdl, FILE_LOCK_OFD, (struct flock*)arg, /*wait=*/false);
+            break;
+
+        case F_OFD_SETLKW:
+            ret = fcntl_setlk(hdl, FILE_LOCK_OFD, (struct flock*)arg, /*wait=*/true);
+            break;
+
+        case F_OFD_GETLK:
+            ret = fcntl_getlk(hdl, FILE_LOCK_OFD, (struct flock*)arg);
             break;
 
         /* F_SETOWN (int)
@@ -188,3 +311,29 @@ int shim_do_fcntl(int fd, int cmd, unsigned long arg) {
     put_handle(hdl);
     return ret;
 }
+
+int shim_do_flock(int fd, int cmd) {
+    int type;
+    switch (cmd & ~LOCK_NB) {
+        case LOCK_SH:
+            type = F_RDLCK;
+            break;
+        case LOCK_EX:
+            type = F_WRLCK;
+            break;
+        case LOCK_UN:
+            type = F_UNLCK;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    int ret = file_lock_set(hdl, FILE_LOCK_FLOCK, type, 0, FILE_LOCK_EOF,
+                            /*wait=*/!(cmd & LOCK_NB));
+    put_handle(hdl);
+    return ret;
+}
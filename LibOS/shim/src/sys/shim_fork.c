@@ -17,6 +17,7 @@
 #include "pal.h"
 #include "pal_error.h"
 #include "shim_checkpoint.h"
+#include "shim_fs.h"
 #include "shim_internal.h"
 #include "shim_ipc.h"
 #include "shim_table.h"
@@ -40,6 +41,10 @@ END_MIGRATION_DEF(fork)
 int migrate_fork(struct shim_cp_store* store, struct shim_thread* thread,
                  struct shim_process* process, va_list ap) {
     __UNUSED(ap);
+
+    /* the child may lock the same files, so the host has to know about our locks */
+    file_locks_delegate();
+
     int ret = START_MIGRATE(store, fork, thread, process);
 
     thread->in_vm = false;
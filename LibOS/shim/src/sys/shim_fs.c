@@ -5,8 +5,8 @@
  * shim_fs.c
  *
  * Implementation of system call "unlink", "unlinkat", "mkdir", "mkdirat",
- * "rmdir", "umask", "chmod", "fchmod", "fchmodat", "rename", "renameat" and
- * "sendfile".
+ * "rmdir", "umask", "chmod", "fchmod", "fchmodat", "rename", "renameat",
+ * "sendfile", "splice" and "copy_file_range".
  */
 
 #define __KERNEL__
@@ -326,6 +326,98 @@ int shim_do_fchown(int fd, uid_t uid, gid_t gid) {
 #define MAP_SIZE (g_pal_alloc_align * 4)
 #define BUF_SIZE 2048
 
+static int g_host_copy = -1;
+
+static bool host_copy_enabled(void) {
+    if (g_host_copy < 0) {
+        char cfg[2];
+        g_host_copy = !root_config ||
+                      get_config(root_config, "fs.host_copy", cfg, sizeof(cfg)) != 1 ||
+                      cfg[0] != '0';
+    }
+    return g_host_copy;
+}
+
+/* Returns true if the data of `hdl` is exactly the data of its PAL stream (at the file offset for
+ * regular files), so the host can copy it directly. */
+static bool is_host_stream(struct shim_handle* hdl) {
+    if (!hdl->pal_handle)
+        return false;
+
+    switch (hdl->type) {
+        case TYPE_FILE:
+            return hdl->info.file.type == FILE_REGULAR && FILE_HANDLE_DATA(hdl);
+        case TYPE_PIPE:
+            return true;
+        case TYPE_SOCK:
+            return hdl->info.sock.sock_state == SOCK_CONNECTED;
+        default:
+            return false;
+    }
+}
+
+/* Copies data by the host (e.g. host sendfile()) without passing it through LibOS memory. Returns
+ * -ENOSYS if the host cannot copy between these handles, so that the caller falls back to a copy
+ * through LibOS. */
+static ssize_t handle_copy_host(struct shim_handle* hdli, off_t* offseti, struct shim_handle* hdlo,
+                                off_t* offseto, size_t count) {
+    struct shim_fs_ops* fsi = hdli->fs->fs_ops;
+    struct shim_fs_ops* fso = hdlo->fs->fs_ops;
+
+    if (!host_copy_enabled() || !is_host_stream(hdli) || !is_host_stream(hdlo))
+        return -ENOSYS;
+
+    if (!(hdli->acc_mode & MAY_READ) || !(hdlo->acc_mode & MAY_WRITE) || (hdlo->flags & O_APPEND))
+        return -ENOSYS;
+
+    off_t offi = 0;
+    off_t offo = 0;
+
+    if (hdli->type == TYPE_FILE) {
+        if (!fsi->seek)
+            return -ENOSYS;
+        offi = offseti ? *offseti : fsi->seek(hdli, 0, SEEK_CUR);
+        if (offi < 0)
+            return offi;
+    }
+
+    if (hdlo->type == TYPE_FILE) {
+        if (!fso->seek || !fso->poll || !fso->truncate)
+            return -ENOSYS;
+        offo = offseto ? *offseto : fso->seek(hdlo, 0, SEEK_CUR);
+        if (offo < 0)
+            return offo;
+    }
+
+    PAL_NUM ret = DkStreamCopy(hdlo->pal_handle, offo, hdli->pal_handle, offi, count);
+    if (ret == PAL_STREAM_ERROR) {
+        if (PAL_NATIVE_ERRNO == PAL_ERROR_NOTSUPPORT || PAL_NATIVE_ERRNO == PAL_ERROR_NOTIMPLEMENTED)
+            return -ENOSYS;
+        return -PAL_ERRNO;
+    }
+
+    if (hdli->type == TYPE_FILE) {
+        if (offseti)
+            *offseti = offi + ret;
+        else
+            fsi->seek(hdli, offi + ret, SEEK_SET);
+    }
+
+    if (hdlo->type == TYPE_FILE) {
+        /* the host extended the file behind LibOS, update the cached file size */
+        off_t size = fso->poll(hdlo, FS_POLL_SZ);
+        if (size >= 0 && size < (off_t)(offo + ret))
+            fso->truncate(hdlo, offo + ret);
+
+        if (offseto)
+            *offseto = offo + ret;
+        else
+            fso->seek(hdlo, offo + ret, SEEK_SET);
+    }
+
+    return ret;
+}
+
 static ssize_t handle_copy(struct shim_handle* hdli, off_t* offseti, struct shim_handle* hdlo,
                            off_t* offseto, ssize_t count) {
     struct shim_mount* fsi = hdli->fs;
@@ -337,6 +429,12 @@ static ssize_t handle_copy(struct shim_handle* hdli, off_t* offseti, struct shim
     if (!fsi || !fsi->fs_ops || !fso || !fso->fs_ops)
         return -EACCES;
 
+    if (count > 0) {
+        ssize_t ret = handle_copy_host(hdli, offseti, hdlo, offseto, count);
+        if (ret != -ENOSYS)
+            return ret;
+    }
+
     bool do_mapi  = fsi->fs_ops->mmap != NULL;
     bool do_mapo  = fso->fs_ops->mmap != NULL;
     bool do_marki = false;
@@ -652,35 +750,129 @@ out:
     return ret;
 }
 
+/* Copies data between two handles; explicit offsets are used and updated instead of the file
+ * offsets of the corresponding handles, which are left unchanged. */
+static ssize_t copy_between_handles(struct shim_handle* hdli, off_t* offseti,
+                                    struct shim_handle* hdlo, off_t* offseto, size_t count) {
+    off_t old_offseti = 0;
+    off_t old_offseto = 0;
+
+    if (offseti) {
+        if (!hdli->fs || !hdli->fs->fs_ops || !hdli->fs->fs_ops->seek)
+            return -EACCES;
+
+        old_offseti = hdli->fs->fs_ops->seek(hdli, 0, SEEK_CUR);
+        if (old_offseti < 0)
+            return old_offseti;
+    }
+
+    if (offseto) {
+        if (!hdlo->fs || !hdlo->fs->fs_ops || !hdlo->fs->fs_ops->seek)
+            return -EACCES;
+
+        old_offseto = hdlo->fs->fs_ops->seek(hdlo, 0, SEEK_CUR);
+        if (old_offseto < 0)
+            return old_offseto;
+    }
+
+    ssize_t ret = handle_copy(hdli, offseti, hdlo, offseto, count);
+
+    if (ret >= 0 && offseti)
+        hdli->fs->fs_ops->seek(hdli, old_offseti, SEEK_SET);
+    if (ret >= 0 && offseto)
+        hdlo->fs->fs_ops->seek(hdlo, old_offseto, SEEK_SET);
+
+    return ret;
+}
+
 ssize_t shim_do_sendfile(int ofd, int ifd, off_t* offset, size_t count) {
+    if (offset && test_user_memory(offset, sizeof(*offset), /*write=*/true))
+        return -EFAULT;
+
     struct shim_handle* hdli = get_fd_handle(ifd, NULL, NULL);
     struct shim_handle* hdlo = get_fd_handle(ofd, NULL, NULL);
+    ssize_t ret = -EBADF;
 
     if (!hdli || !hdlo)
-        return -EBADF;
+        goto out;
 
-    off_t old_offset = 0;
-    int ret = -EACCES;
+    ret = copy_between_handles(hdli, offset, hdlo, NULL, count);
 
-    if (offset) {
-        if (!hdli->fs || !hdli->fs->fs_ops || !hdli->fs->fs_ops->seek)
-            goto out;
+out:
+    if (hdli)
+        put_handle(hdli);
+    if (hdlo)
+        put_handle(hdlo);
+    return ret;
+}
 
-        old_offset = hdli->fs->fs_ops->seek(hdli, 0, SEEK_CUR);
-        if (old_offset < 0) {
-            ret = old_offset;
-            goto out;
-        }
-    }
+ssize_t shim_do_splice(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out, size_t len,
+                       int flags) {
+    __UNUSED(flags); /* SPLICE_F_* flags are only hints */
+
+    if (off_in && test_user_memory(off_in, sizeof(*off_in), /*write=*/true))
+        return -EFAULT;
+    if (off_out && test_user_memory(off_out, sizeof(*off_out), /*write=*/true))
+        return -EFAULT;
+
+    struct shim_handle* hdli = get_fd_handle(fd_in, NULL, NULL);
+    struct shim_handle* hdlo = get_fd_handle(fd_out, NULL, NULL);
+    ssize_t ret = -EBADF;
+
+    if (!hdli || !hdlo)
+        goto out;
 
-    ret = handle_copy(hdli, offset, hdlo, NULL, count);
+    /* like on Linux, one of the ends must be a pipe and pipes cannot have offsets */
+    ret = -EINVAL;
+    if (hdli->type != TYPE_PIPE && hdlo->type != TYPE_PIPE)
+        goto out;
+
+    ret = -ESPIPE;
+    if ((off_in && hdli->type == TYPE_PIPE) || (off_out && hdlo->type == TYPE_PIPE))
+        goto out;
+
+    ret = copy_between_handles(hdli, (off_t*)off_in, hdlo, (off_t*)off_out, len);
+
+out:
+    if (hdli)
+        put_handle(hdli);
+    if (hdlo)
+        put_handle(hdlo);
+    return ret;
+}
+
+ssize_t shim_do_copy_file_range(int fd_in, loff_t* off_in, int fd_out, loff_t* off_out,
+                                size_t len, unsigned int flags) {
+    if (flags)
+        return -EINVAL;
+
+    if (off_in && test_user_memory(off_in, sizeof(*off_in), /*write=*/true))
+        return -EFAULT;
+    if (off_out && test_user_memory(off_out, sizeof(*off_out), /*write=*/true))
+        return -EFAULT;
+
+    struct shim_handle* hdli = get_fd_handle(fd_in, NULL, NULL);
+    struct shim_handle* hdlo = get_fd_handle(fd_out, NULL, NULL);
+    ssize_t ret = -EBADF;
+
+    if (!hdli || !hdlo)
+        goto out;
+
+    ret = -EINVAL;
+    if (hdli->type != TYPE_FILE || hdlo->type != TYPE_FILE)
+        goto out;
+
+    ret = -EBADF;
+    if (!(hdli->acc_mode & MAY_READ) || !(hdlo->acc_mode & MAY_WRITE) || (hdlo->flags & O_APPEND))
+        goto out;
 
-    if (ret >= 0 && offset)
-        hdli->fs->fs_ops->seek(hdli, old_offset, SEEK_SET);
+    ret = copy_between_handles(hdli, (off_t*)off_in, hdlo, (off_t*)off_out, len);
 
 out:
-    put_handle(hdli);
-    put_handle(hdlo);
+    if (hdli)
+        put_handle(hdli);
+    if (hdlo)
+        put_handle(hdlo);
     return ret;
 }
 
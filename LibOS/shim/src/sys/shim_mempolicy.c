@@ -0,0 +1,440 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_mempolicy.c
+ *
+ * Implementation of system calls "mbind", "set_mempolicy", "get_mempolicy", "migrate_pages" and
+ * "move_pages".
+ *
+ * The NUMA memory policy of a memory range is recorded in its VMAs (so it is reported back by
+ * get_mempolicy() and /proc/self/numa_maps, and survives fork) and handed to the PAL, which places
+ * the pages (the Linux PAL with host mbind()). The default policy of a thread is kept in the thread
+ * and set on its host thread. PALs which cannot control memory placement (e.g. Linux-SGX) only get
+ * the policy recorded; querying where pages are placed then fails with ENOSYS, like on a host
+ * kernel without NUMA support.
+ *
+ * Only the pages of the current process can be moved, and only up to MAX_NUMA_NODES nodes are
+ * supported. MPOL_MF_STRICT is accepted but existing pages are not verified.
+ */
+
+#include <errno.h>
+#include <linux/mempolicy.h>
+
+#include "pal.h"
+#include "pal_error.h"
+#include "shim_internal.h"
+#include "shim_table.h"
+#include "shim_thread.h"
+#include "shim_vma.h"
+
+#define MPOL_SUPPORTED_MODE_FLAGS (MPOL_F_STATIC_NODES | MPOL_F_RELATIVE_NODES)
+
+/* Pages are queried and moved through the PAL in batches of this many. */
+#define PAGES_BATCH 64
+
+static uint64_t online_nodes(void) {
+    size_t nodes = MIN(PAL_CB(cpu_info.cpu_numa_nodes), (size_t)MAX_NUMA_NODES);
+    return nodes == 64 ? ~0UL : (1UL << nodes) - 1;
+}
+
+/* Reads a node mask of `maxnode` - 1 bits from the user (as Linux does). */
+static int read_nodemask(const unsigned long* nmask, unsigned long maxnode, uint64_t* nodes) {
+    *nodes = 0;
+    if (!nmask || maxnode <= 1)
+        return 0;
+
+    maxnode--;
+    if (maxnode > PAGE_SIZE * 8)
+        return -EINVAL;
+
+    size_t bits   = sizeof(*nmask) * 8;
+    size_t nlongs = (maxnode + bits - 1) / bits;
+    if (test_user_memory((void*)nmask, nlongs * sizeof(*nmask), /*write=*/false))
+        return -EFAULT;
+
+    for (size_t i = 0; i < nlongs; i++) {
+        unsigned long mask = nmask[i];
+        if (i == nlongs - 1 && maxnode % bits)
+            mask &= (1UL << (maxnode % bits)) - 1;
+        if (i == 0)
+            *nodes = mask;
+        else if (mask)
+            return -EINVAL;
+    }
+    return 0;
+}
+
+/* Validates `mode` and `nodes` given by the user and fills `policy` (see mpol_new() in Linux). */
+static int make_mempolicy(int mode, uint64_t nodes, struct shim_mempolicy* policy) {
+    int mode_flags = mode & MPOL_SUPPORTED_MODE_FLAGS;
+    mode &= ~MPOL_SUPPORTED_MODE_FLAGS;
+    if (mode_flags == MPOL_SUPPORTED_MODE_FLAGS)
+        return -EINVAL;
+
+    switch (mode) {
+        case MPOL_DEFAULT:
+            if (nodes)
+                return -EINVAL;
+            mode_flags = 0;
+            break;
+        case MPOL_PREFERRED:
+            if (!nodes) {
+                /* preferring no node means allocating locally */
+                if (mode_flags)
+                    return -EINVAL;
+                mode = MPOL_LOCAL;
+            }
+            break;
+        case MPOL_LOCAL:
+            if (nodes || mode_flags)
+                return -EINVAL;
+            break;
+        case MPOL_BIND:
+        case MPOL_INTERLEAVE:
+            if (!nodes)
+                return -EINVAL;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    if (nodes) {
+        nodes &= online_nodes();
+        if (!nodes)
+            return -EINVAL;
+        if (mode == MPOL_PREFERRED)
+            nodes &= -nodes;
+    }
+
+    policy->mode  = mode | mode_flags;
+    policy->nodes = nodes;
+    return 0;
+}
+
+int apply_mempolicy(void* addr, size_t length, const struct shim_mempolicy* mempolicy, bool move) {
+    static const int pal_modes[] = {
+        [MPOL_DEFAULT]    = PAL_MPOL_DEFAULT,
+        [MPOL_PREFERRED]  = PAL_MPOL_PREFERRED,
+        [MPOL_BIND]       = PAL_MPOL_BIND,
+        [MPOL_INTERLEAVE] = PAL_MPOL_INTERLEAVE,
+        [MPOL_LOCAL]      = PAL_MPOL_LOCAL,
+    };
+    int mode = mempolicy->mode & ~MPOL_SUPPORTED_MODE_FLAGS;
+    assert(mode >= 0 && (size_t)mode < ARRAY_SIZE(pal_modes));
+
+    if (!DkVirtualMemoryPolicy(addr, length, pal_modes[mode], mempolicy->nodes,
+                               move ? PAL_MPOL_MOVE : 0) &&
+            PAL_NATIVE_ERRNO != PAL_ERROR_NOTIMPLEMENTED)
+        return -PAL_ERRNO;
+    return 0;
+}
+
+int query_page_nodes(void* addr, size_t length,
+                     int (*callback)(void** pages, PAL_IDX* nodes, size_t count, void* arg),
+                     void* arg) {
+    void* pages[PAGES_BATCH];
+    PAL_IDX nodes[PAGES_BATCH];
+
+    char* end = (char*)addr + length;
+    for (char* page = addr; page < end;) {
+        size_t count = 0;
+        for (; page < end && count < PAGES_BATCH; page += ALLOC_ALIGNMENT) {
+            pages[count++] = page;
+        }
+
+        if (!DkVirtualMemoryNodes(count, pages, /*nodes=*/NULL, nodes))
+            return PAL_NATIVE_ERRNO == PAL_ERROR_NOTIMPLEMENTED ? -ENOSYS : -PAL_ERRNO;
+
+        int ret = callback(pages, nodes, count, arg);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
+int shim_do_mbind(void* start, unsigned long len, int mode, unsigned long* nmask,
+                  unsigned long maxnode, int flags) {
+    if (!IS_ALLOC_ALIGNED_PTR(start))
+        return -EINVAL;
+
+    if (flags & ~(MPOL_MF_STRICT | MPOL_MF_MOVE | MPOL_MF_MOVE_ALL))
+        return -EINVAL;
+
+    uint64_t nodes;
+    int ret = read_nodemask(nmask, maxnode, &nodes);
+    if (ret < 0)
+        return ret;
+
+    struct shim_mempolicy policy;
+    ret = make_mempolicy(mode, nodes, &policy);
+    if (ret < 0)
+        return ret;
+
+    len = ALLOC_ALIGN_UP(len);
+    if ((uintptr_t)start + len < (uintptr_t)start)
+        return -EINVAL;
+    if (!len)
+        return 0;
+
+    if (!is_in_adjacent_user_vmas(start, len))
+        return -EFAULT;
+
+    ret = apply_mempolicy(start, len, &policy, flags & (MPOL_MF_MOVE | MPOL_MF_MOVE_ALL));
+    if (ret < 0)
+        return ret;
+
+    return bkeep_vma_mempolicy(start, len, &policy);
+}
+
+int shim_do_set_mempolicy(int mode, unsigned long* nmask, unsigned long maxnode) {
+    uint64_t nodes;
+    int ret = read_nodemask(nmask, maxnode, &nodes);
+    if (ret < 0)
+        return ret;
+
+    struct shim_mempolicy policy;
+    ret = make_mempolicy(mode, nodes, &policy);
+    if (ret < 0)
+        return ret;
+
+    ret = apply_mempolicy(/*addr=*/NULL, /*length=*/0, &policy, /*move=*/false);
+    if (ret < 0)
+        return ret;
+
+    get_cur_thread()->mempolicy = policy;
+    return 0;
+}
+
+/* Returns the node of the page at `addr`; pages not touched yet are reported on the local node,
+ * where they would be placed by default. */
+static int get_page_node(void* addr, PAL_IDX* node) {
+    void* page = ALLOC_ALIGN_DOWN_PTR(addr);
+    if (!DkVirtualMemoryNodes(1, &page, /*nodes=*/NULL, node)) {
+        if (PAL_NATIVE_ERRNO != PAL_ERROR_NOTIMPLEMENTED)
+            return -PAL_ERRNO;
+        *node = PAL_IDX_POISON;
+    }
+
+    if (*node == PAL_IDX_POISON) {
+        *node = 0;
+        DkThreadGetCurrentCpu(/*cpu=*/NULL, node);
+    }
+    return 0;
+}
+
+int shim_do_get_mempolicy(int* policy, unsigned long* nmask, unsigned long maxnode,
+                          unsigned long addr, unsigned long flags) {
+    if (flags & ~(MPOL_F_NODE | MPOL_F_ADDR | MPOL_F_MEMS_ALLOWED))
+        return -EINVAL;
+
+    if (nmask && maxnode < PAL_CB(cpu_info.cpu_numa_nodes))
+        return -EINVAL;
+
+    size_t nlongs = nmask ? (maxnode + sizeof(*nmask) * 8 - 1) / (sizeof(*nmask) * 8) : 0;
+    if (nmask && test_user_memory(nmask, nlongs * sizeof(*nmask), /*write=*/true))
+        return -EFAULT;
+
+    if (policy && test_user_memory(policy, sizeof(*policy), /*write=*/true))
+        return -EFAULT;
+
+    struct shim_mempolicy mempolicy;
+    int mode;
+    if (flags & MPOL_F_MEMS_ALLOWED) {
+        if (flags & (MPOL_F_NODE | MPOL_F_ADDR))
+            return -EINVAL;
+        mempolicy.nodes = online_nodes();
+        mode = 0;
+    } else if (flags & MPOL_F_ADDR) {
+        struct shim_vma_info vma_info;
+        if (lookup_vma((void*)addr, &vma_info) < 0)
+            return -EFAULT;
+        if (vma_info.file)
+            put_handle(vma_info.file);
+        if (vma_info.flags & VMA_UNMAPPED)
+            return -EFAULT;
+
+        mempolicy = vma_info.mempolicy;
+        mode = mempolicy.mode;
+        if (flags & MPOL_F_NODE) {
+            PAL_IDX node;
+            int ret = get_page_node((void*)addr, &node);
+            if (ret < 0)
+                return ret;
+            mode = node;
+        }
+    } else {
+        if (addr)
+            return -EINVAL;
+
+        mempolicy = get_cur_thread()->mempolicy;
+        mode = mempolicy.mode;
+        if (flags & MPOL_F_NODE) {
+            /* the host keeps the interleaving position, report the first node of the policy */
+            if ((mempolicy.mode & ~MPOL_SUPPORTED_MODE_FLAGS) != MPOL_INTERLEAVE)
+                return -EINVAL;
+            mode = __builtin_ctzl(mempolicy.nodes);
+        }
+    }
+
+    if (policy)
+        *policy = mode;
+    if (nmask) {
+        memset(nmask, 0, nlongs * sizeof(*nmask));
+        nmask[0] = mempolicy.nodes;
+    }
+    return 0;
+}
+
+/* Only the pages of the current process can be placed: `pid` must be 0 or one of its threads. */
+static int check_own_pid(pid_t pid) {
+    if (pid < 0)
+        return -ESRCH;
+    if (!pid || (IDTYPE)pid == get_cur_thread()->tgid)
+        return 0;
+
+    struct shim_thread* thread = lookup_thread(pid);
+    if (!thread)
+        return -ESRCH;
+    put_thread(thread);
+    return 0;
+}
+
+int shim_do_move_pages(pid_t pid, unsigned long nr_pages, void** pages, const int* nodes,
+                       int* status, int flags) {
+    if (flags & ~(MPOL_MF_MOVE | MPOL_MF_MOVE_ALL))
+        return -EINVAL;
+
+    int ret = check_own_pid(pid);
+    if (ret < 0)
+        return ret;
+
+    if (!nr_pages)
+        return 0;
+    if (nr_pages > SIZE_MAX / sizeof(*pages))
+        return -EFAULT;
+
+    if (test_user_memory(pages, nr_pages * sizeof(*pages), /*write=*/false) ||
+            test_user_memory(status, nr_pages * sizeof(*status), /*write=*/true))
+        return -EFAULT;
+
+    if (nodes) {
+        if (test_user_memory((void*)nodes, nr_pages * sizeof(*nodes), /*write=*/false))
+            return -EFAULT;
+        for (unsigned long i = 0; i < nr_pages; i++) {
+            if (nodes[i] < 0 || nodes[i] >= MAX_NUMA_NODES ||
+                    !(online_nodes() & (1UL << nodes[i])))
+                return -ENODEV;
+        }
+    }
+
+    for (unsigned long i = 0; i < nr_pages; i += PAGES_BATCH) {
+        void* batch_pages[PAGES_BATCH];
+        PAL_IDX batch_nodes[PAGES_BATCH];
+        PAL_IDX batch_status[PAGES_BATCH];
+        unsigned long batch_idx[PAGES_BATCH];
+
+        size_t count = 0;
+        for (unsigned long j = i; j < MIN(nr_pages, i + PAGES_BATCH); j++) {
+            void* page = ALLOC_ALIGN_DOWN_PTR(pages[j]);
+            if (!is_in_adjacent_user_vmas(page, ALLOC_ALIGNMENT)) {
+                status[j] = -EFAULT;
+                continue;
+            }
+            batch_pages[count] = page;
+            batch_nodes[count] = nodes ? nodes[j] : 0;
+            batch_idx[count]   = j;
+            count++;
+        }
+
+        if (!DkVirtualMemoryNodes(count, batch_pages, nodes ? batch_nodes : NULL, batch_status))
+            return PAL_NATIVE_ERRNO == PAL_ERROR_NOTIMPLEMENTED ? -ENOSYS : -PAL_ERRNO;
+
+        for (size_t k = 0; k < count; k++) {
+            status[batch_idx[k]] = batch_status[k] == PAL_IDX_POISON ? -ENOENT
+                                                                     : (int)batch_status[k];
+        }
+    }
+    return 0;
+}
+
+/* Maps `node` from `from` to the node at the same position in `to` (like node_remap() in Linux). */
+static PAL_IDX remap_node(PAL_IDX node, uint64_t from, uint64_t to) {
+    int n = __builtin_popcountl(from & ((1UL << node) - 1)) % __builtin_popcountl(to);
+    while (n--) {
+        to &= to - 1;
+    }
+    return __builtin_ctzl(to);
+}
+
+struct migrate_args {
+    uint64_t from;
+    uint64_t to;
+    int not_moved;
+};
+
+static int migrate_batch(void** pages, PAL_IDX* nodes, size_t count, void* _args) {
+    struct migrate_args* args = _args;
+    void* move_pages[PAGES_BATCH];
+    PAL_IDX move_nodes[PAGES_BATCH];
+    PAL_IDX move_status[PAGES_BATCH];
+
+    size_t moves = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (nodes[i] >= MAX_NUMA_NODES || !(args->from & (1UL << nodes[i])))
+            continue;
+        PAL_IDX target = remap_node(nodes[i], args->from, args->to);
+        if (target == nodes[i])
+            continue;
+        move_pages[moves] = pages[i];
+        move_nodes[moves] = target;
+        moves++;
+    }
+
+    if (!moves)
+        return 0;
+    if (!DkVirtualMemoryNodes(moves, move_pages, move_nodes, move_status))
+        return -PAL_ERRNO;
+
+    for (size_t i = 0; i < moves; i++) {
+        if (move_status[i] != move_nodes[i])
+            args->not_moved++;
+    }
+    return 0;
+}
+
+int shim_do_migrate_pages(pid_t pid, unsigned long maxnode, const unsigned long* old_nodes,
+                           const unsigned long* new_nodes) {
+    int ret = check_own_pid(pid);
+    if (ret < 0)
+        return ret;
+
+    struct migrate_args args = { 0 };
+    ret = read_nodemask(old_nodes, maxnode, &args.from);
+    if (ret < 0)
+        return ret;
+    ret = read_nodemask(new_nodes, maxnode, &args.to);
+    if (ret < 0)
+        return ret;
+
+    args.from &= online_nodes();
+    args.to   &= online_nodes();
+    if (!args.to)
+        return -EINVAL;
+    if (!args.from || args.from == args.to)
+        return 0;
+
+    size_t count;
+    struct shim_vma_info* vmas;
+    ret = dump_all_vmas(&vmas, &count, /*include_unmapped=*/false);
+    if (ret < 0)
+        return ret;
+
+    for (size_t i = 0; i < count; i++) {
+        ret = query_page_nodes(vmas[i].addr, vmas[i].length, migrate_batch, &args);
+        if (ret < 0)
+            break;
+    }
+
+    free_vma_info_array(vmas, count);
+    return ret < 0 ? ret : args.not_moved;
+}
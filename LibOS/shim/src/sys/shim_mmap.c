@@ -6,10 +6,11 @@
 /*
  * shim_mmap.c
  *
- * Implementation of system calls "mmap", "munmap" and "mprotect".
+ * Implementation of system calls "mmap", "munmap", "mprotect", "mremap", "madvise" and "msync".
  */
 
 #include <errno.h>
+#include <linux/mempolicy.h>
 #include <stdatomic.h>
 #include <sys/mman.h>
 
@@ -131,6 +132,13 @@ void* shim_do_mmap(void* addr, size_t length, int prot, int flags, int fd, off_t
         flags &= ~MAP_32BIT;
 #endif
 
+    /* Anonymous MAP_HUGETLB mappings do not need a hugetlbfs pool: the PAL backs them with huge
+     * pages where the host can (see PAL_ALLOC_HUGEPAGE). With `sys.hugepages`, large anonymous
+     * mappings get the same treatment. */
+    if ((flags & MAP_ANONYMOUS) && g_hugepages_enabled && length >= HUGEPAGE_SIZE &&
+            !(flags & (MAP_FIXED | MAP_FIXED_NOREPLACE)))
+        flags |= MAP_HUGETLB;
+
     if (flags & (MAP_FIXED | MAP_FIXED_NOREPLACE)) {
         /* We know that `addr + length` does not overflow (`access_ok` above). */
         if (addr < PAL_CB(user_address.start)
@@ -138,6 +146,8 @@ void* shim_do_mmap(void* addr, size_t length, int prot, int flags, int fd, off_t
             ret = -EINVAL;
             goto out_handle;
         }
+        if (!(flags & MAP_FIXED_NOREPLACE))
+            sync_shared_mmaps(addr, length, /*remove=*/true);
         ret = bkeep_mmap_fixed(addr, length, prot, flags, hdl, offset, NULL);
         if (ret < 0) {
             goto out_handle;
@@ -164,7 +174,8 @@ void* shim_do_mmap(void* addr, size_t length, int prot, int flags, int fd, off_t
     /* From now on `addr` contains the actual address we want to map (and already bookkeeped). */
 
     if (!hdl) {
-        if (DkVirtualMemoryAlloc(addr, length, 0, LINUX_PROT_TO_PAL(prot, flags)) != addr) {
+        if (DkVirtualMemoryAlloc(addr, length, (flags & MAP_HUGETLB) ? PAL_ALLOC_HUGEPAGE : 0,
+                                 LINUX_PROT_TO_PAL(prot, flags)) != addr) {
             if (PAL_NATIVE_ERRNO == PAL_ERROR_DENIED) {
                 ret = -EPERM;
             } else {
@@ -201,6 +212,34 @@ out_handle:
     return addr;
 }
 
+/* Like Linux, refuses to make shared file mappings writable if the file is not open for writing. */
+static int check_shared_mprotect(void* addr, size_t length) {
+    uintptr_t cur = (uintptr_t)addr;
+    uintptr_t end = (uintptr_t)addr + length;
+
+    while (cur < end) {
+        struct shim_vma_info vma_info;
+        if (lookup_vma((void*)cur, &vma_info) < 0) {
+            /* unmapped range is reported by bkeep_mprotect() */
+            break;
+        }
+
+        int ret = 0;
+        if ((vma_info.flags & MAP_SHARED) && vma_info.file &&
+                !(vma_info.file->acc_mode & MAY_WRITE))
+            ret = -EACCES;
+
+        if (vma_info.file)
+            put_handle(vma_info.file);
+        if (ret < 0)
+            return ret;
+
+        cur = (uintptr_t)vma_info.addr + vma_info.length;
+    }
+
+    return 0;
+}
+
 int shim_do_mprotect(void* addr, size_t length, int prot) {
     /*
      * According to the manpage, addr has to be page-aligned, but not the
@@ -220,7 +259,14 @@ int shim_do_mprotect(void* addr, size_t length, int prot) {
         return -EINVAL;
     }
 
-    int ret = bkeep_mprotect(addr, length, prot, /*is_internal=*/false);
+    int ret;
+    if (prot & PROT_WRITE) {
+        ret = check_shared_mprotect(addr, length);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = bkeep_mprotect(addr, length, prot, /*is_internal=*/false);
     if (ret < 0) {
         return ret;
     }
@@ -251,6 +297,8 @@ int shim_do_munmap(void* addr, size_t length) {
         return ret;
     }
 
+    /* munmap() cannot fail because of the write-back, the same as on Linux */
+    sync_shared_mmaps(addr, length, /*remove=*/true);
     DkVirtualMemoryFree(addr, length);
 
     bkeep_remove_tmp_vma(tmp_vma);
@@ -258,6 +306,396 @@ int shim_do_munmap(void* addr, size_t length) {
     return 0;
 }
 
+/* Allocates memory for [`addr`, `addr` + `length`), which must be already bookkept as a part of the
+ * mapping described by `vma_info`; `offset` is the file offset corresponding to `addr`. */
+static int alloc_vma_range(void* addr, size_t length, struct shim_vma_info* vma_info,
+                           off_t offset) {
+    if (!vma_info->file) {
+        if (DkVirtualMemoryAlloc(addr, length,
+                                 (vma_info->flags & MAP_HUGETLB) ? PAL_ALLOC_HUGEPAGE : 0,
+                                 LINUX_PROT_TO_PAL(vma_info->prot, vma_info->flags)) != addr)
+            return -ENOMEM;
+        return 0;
+    }
+
+    struct shim_handle* hdl = vma_info->file;
+    void* ret_addr = addr;
+    int ret = hdl->fs->fs_ops->mmap(hdl, &ret_addr, length, vma_info->prot,
+                                    (vma_info->flags & (MAP_SHARED | MAP_PRIVATE)) | MAP_FIXED,
+                                    offset);
+    if (ret < 0)
+        return ret;
+
+    if (ret_addr != addr) {
+        debug("Requested address (%p) differs from allocated (%p)!\n", addr, ret_addr);
+        BUG();
+    }
+    return 0;
+}
+
+/* Linux keeps the memory policy set by mbind() in the VMA, so it follows the mapping when it is
+ * grown or moved. */
+static int mremap_bkeep_mempolicy(void* addr, size_t length, struct shim_vma_info* vma_info) {
+    if (vma_info->mempolicy.mode == MPOL_DEFAULT)
+        return 0;
+    return bkeep_vma_mempolicy(addr, length, &vma_info->mempolicy);
+}
+
+static void mremap_unbkeep(void* addr, size_t length) {
+    void* tmp_vma = NULL;
+    if (bkeep_munmap(addr, length, /*is_internal=*/false, &tmp_vma) < 0) {
+        debug("[mremap] Failed to remove bookkeeped memory at %p-%p!\n", addr,
+              (char*)addr + length);
+        BUG();
+    }
+    sync_shared_mmaps(addr, length, /*remove=*/true);
+    DkVirtualMemoryFree(addr, length);
+    bkeep_remove_tmp_vma(tmp_vma);
+}
+
+/* Grows the mapping at `addr` in place, if the memory right after it is free. */
+static int mremap_grow(void* addr, size_t old_len, size_t new_len, struct shim_vma_info* vma_info,
+                       off_t offset) {
+    char* ext = (char*)addr + old_len;
+    size_t ext_len = new_len - old_len;
+
+    if (!access_ok(addr, new_len) ||
+            (uintptr_t)PAL_CB(user_address.end) < (uintptr_t)addr + new_len)
+        return -ENOMEM;
+
+    int ret = bkeep_mmap_fixed(ext, ext_len, vma_info->prot, vma_info->flags | MAP_FIXED_NOREPLACE,
+                               vma_info->file, offset + old_len, vma_info->comment);
+    if (ret < 0)
+        return ret;
+
+    ret = mremap_bkeep_mempolicy(ext, ext_len, vma_info);
+    if (ret < 0)
+        goto out_unbkeep;
+
+    ret = alloc_vma_range(ext, ext_len, vma_info, offset + old_len);
+    if (ret < 0)
+        goto out_unbkeep;
+
+    if (vma_info->mempolicy.mode != MPOL_DEFAULT) {
+        ret = apply_mempolicy(ext, ext_len, &vma_info->mempolicy, /*move=*/false);
+        if (ret < 0)
+            goto out_unbkeep;
+    }
+    return 0;
+
+out_unbkeep:
+    mremap_unbkeep(ext, ext_len);
+    return ret;
+}
+
+/* Fallback for PALs which cannot move memory (e.g. SGX, where enclave pages are bound to their
+ * addresses): shared file mappings are mapped again from the file, everything else is copied. */
+static int mremap_copy(void* addr, void* new_addr, size_t length, struct shim_vma_info* vma_info,
+                       off_t offset) {
+    if (vma_info->file && (vma_info->flags & MAP_SHARED))
+        return alloc_vma_range(new_addr, length, vma_info, offset);
+
+    if (DkVirtualMemoryAlloc(new_addr, length,
+                             (vma_info->flags & MAP_HUGETLB) ? PAL_ALLOC_HUGEPAGE : 0,
+                             PAL_PROT_READ | PAL_PROT_WRITE) != new_addr)
+        return -ENOMEM;
+
+    /* the old range is freed right after this, so its permissions do not matter anymore */
+    if (!(vma_info->prot & PROT_READ) && !DkVirtualMemoryProtect(addr, length, PAL_PROT_READ))
+        return -PAL_ERRNO;
+
+    memcpy(new_addr, addr, length);
+
+    if (!DkVirtualMemoryProtect(new_addr, length,
+                                LINUX_PROT_TO_PAL(vma_info->prot, vma_info->flags)))
+        return -PAL_ERRNO;
+    return 0;
+}
+
+/* Moves the mapping at `addr` to `new_addr` (or anywhere, if `new_addr` is NULL), resizing it to
+ * `new_len`. Pages are moved by the PAL without copying, if it supports that. */
+static long mremap_move(void* addr, size_t old_len, size_t new_len, void* new_addr,
+                        struct shim_vma_info* vma_info, off_t offset) {
+    int ret;
+
+    if (new_len < old_len) {
+        ret = shim_do_munmap((char*)addr + new_len, old_len - new_len);
+        if (ret < 0)
+            return ret;
+        old_len = new_len;
+    }
+
+    if (new_addr) {
+        sync_shared_mmaps(new_addr, new_len, /*remove=*/true);
+        ret = bkeep_mmap_fixed(new_addr, new_len, vma_info->prot, vma_info->flags | MAP_FIXED,
+                               vma_info->file, offset, vma_info->comment);
+    } else {
+        ret = bkeep_mmap_any_aslr(new_len, vma_info->prot, vma_info->flags, vma_info->file,
+                                  offset, vma_info->comment, &new_addr);
+        if (ret < 0)
+            ret = -ENOMEM;
+    }
+    if (ret < 0)
+        return ret;
+
+    ret = mremap_bkeep_mempolicy(new_addr, new_len, vma_info);
+    if (ret < 0)
+        goto out_unbkeep;
+
+    /* allocate the grown part first, so that a failure leaves the old mapping intact */
+    if (new_len > old_len) {
+        ret = alloc_vma_range((char*)new_addr + old_len, new_len - old_len, vma_info,
+                              offset + old_len);
+        if (ret < 0)
+            goto out_unbkeep;
+    }
+
+    /* write back (and forget) emulated shared mappings, the new range is mapped from the file */
+    if (vma_info->file && (vma_info->flags & MAP_SHARED))
+        sync_shared_mmaps(addr, old_len, /*remove=*/true);
+
+    bool copied = false;
+    if (!DkVirtualMemoryMove(addr, new_addr, old_len)) {
+        if (PAL_NATIVE_ERRNO != PAL_ERROR_NOTIMPLEMENTED) {
+            ret = -PAL_ERRNO;
+            goto out_unbkeep;
+        }
+        ret = mremap_copy(addr, new_addr, old_len, vma_info, offset);
+        if (ret < 0)
+            goto out_unbkeep;
+        copied = true;
+    }
+
+    /* moved pages stay where they are, copied ones are placed according to the policy; the
+     * contents are already moved, so a failure here is not worth undoing the whole mremap */
+    if (vma_info->mempolicy.mode != MPOL_DEFAULT)
+        apply_mempolicy(new_addr, new_len, &vma_info->mempolicy, /*move=*/copied);
+
+    /* the old range is already unmapped by the PAL (unless the contents were copied) */
+    mremap_unbkeep(addr, old_len);
+    return (long)new_addr;
+
+out_unbkeep:
+    mremap_unbkeep(new_addr, new_len);
+    return ret;
+}
+
+void* shim_do_mremap(void* addr, size_t old_len, size_t new_len, int flags, void* new_addr) {
+    if (!IS_ALLOC_ALIGNED_PTR(addr) || (flags & ~(MREMAP_MAYMOVE | MREMAP_FIXED)))
+        return (void*)-EINVAL;
+
+    if ((flags & MREMAP_FIXED) && !(flags & MREMAP_MAYMOVE))
+        return (void*)-EINVAL;
+
+    old_len = ALLOC_ALIGN_UP(old_len);
+    new_len = ALLOC_ALIGN_UP(new_len);
+
+    /* `old_len == 0` duplicates a shared mapping on Linux, which is not supported */
+    if (!old_len || !new_len || !access_ok(addr, old_len))
+        return (void*)-EINVAL;
+
+    if (flags & MREMAP_FIXED) {
+        if (!IS_ALLOC_ALIGNED_PTR(new_addr) || !access_ok(new_addr, new_len))
+            return (void*)-EINVAL;
+        if ((char*)new_addr < (char*)addr + old_len && (char*)addr < (char*)new_addr + new_len)
+            return (void*)-EINVAL;
+        if (new_addr < PAL_CB(user_address.start)
+                || (uintptr_t)PAL_CB(user_address.end) < (uintptr_t)new_addr + new_len)
+            return (void*)-EINVAL;
+    }
+
+    struct shim_vma_info vma_info;
+    if (lookup_vma(addr, &vma_info) < 0)
+        return (void*)-EFAULT;
+
+    long ret;
+
+    /* as on Linux, the whole old range must belong to a single mapping */
+    if ((vma_info.flags & (VMA_INTERNAL | VMA_UNMAPPED)) ||
+            (char*)addr + old_len > (char*)vma_info.addr + vma_info.length) {
+        ret = -EFAULT;
+        goto out;
+    }
+
+    off_t offset = vma_info.file ? vma_info.file_offset + ((char*)addr - (char*)vma_info.addr) : 0;
+
+    if (!(flags & MREMAP_FIXED)) {
+        if (new_len <= old_len) {
+            ret = new_len < old_len ? shim_do_munmap((char*)addr + new_len, old_len - new_len) : 0;
+            if (ret == 0)
+                ret = (long)addr;
+            goto out;
+        }
+
+        if (mremap_grow(addr, old_len, new_len, &vma_info, offset) == 0) {
+            ret = (long)addr;
+            goto out;
+        }
+
+        if (!(flags & MREMAP_MAYMOVE)) {
+            ret = -ENOMEM;
+            goto out;
+        }
+        new_addr = NULL;
+    }
+
+    ret = mremap_move(addr, old_len, new_len, new_addr, &vma_info, offset);
+
+out:
+    if (vma_info.file)
+        put_handle(vma_info.file);
+    return (void*)ret;
+}
+
+/* Discards the contents of [`addr`, `addr` + `length`) for MADV_DONTNEED and MADV_FREE (`lazy`).
+ * Private anonymous memory is released (or zeroed) by the PAL; private file mappings are mapped
+ * again, so that the next access sees the file contents; shared mappings keep their contents. */
+static int madvise_discard(void* addr, size_t length, bool lazy) {
+    char* cur = addr;
+    char* end = (char*)addr + length;
+
+    while (cur < end) {
+        struct shim_vma_info vma_info;
+        if (lookup_vma(cur, &vma_info) < 0)
+            return -ENOMEM;
+
+        char* vma_end = MIN(end, (char*)vma_info.addr + vma_info.length);
+        size_t len = vma_end - cur;
+        int ret = 0;
+
+        if (lazy && (vma_info.file || (vma_info.flags & MAP_SHARED))) {
+            /* as on Linux, MADV_FREE applies only to private anonymous memory */
+            ret = -EINVAL;
+        } else if (vma_info.flags & MAP_SHARED) {
+            /* nothing to discard */
+        } else if (!vma_info.file) {
+            if (!DkVirtualMemoryAdvise(cur, len, lazy ? PAL_MADVISE_FREE : PAL_MADVISE_DONTNEED))
+                ret = -PAL_ERRNO;
+        } else {
+            /* the range stays bookkept, so nobody can map anything here in the meantime */
+            DkVirtualMemoryFree(cur, len);
+            ret = alloc_vma_range(cur, len, &vma_info,
+                                  vma_info.file_offset + (cur - (char*)vma_info.addr));
+        }
+
+        if (vma_info.file)
+            put_handle(vma_info.file);
+        if (ret < 0)
+            return ret;
+        cur = vma_end;
+    }
+
+    return 0;
+}
+
+int shim_do_madvise(void* start, size_t len, int behavior) {
+    if (!IS_ALLOC_ALIGNED_PTR(start))
+        return -EINVAL;
+
+    if (!len)
+        return 0;
+
+    len = ALLOC_ALIGN_UP(len);
+    if (!len || !access_ok(start, len))
+        return -EINVAL;
+
+    int advice;
+    switch (behavior) {
+        case MADV_NORMAL:
+            advice = PAL_MADVISE_NORMAL;
+            break;
+        case MADV_RANDOM:
+            advice = PAL_MADVISE_RANDOM;
+            break;
+        case MADV_SEQUENTIAL:
+            advice = PAL_MADVISE_SEQUENTIAL;
+            break;
+        case MADV_WILLNEED:
+            advice = PAL_MADVISE_WILLNEED;
+            break;
+        case MADV_HUGEPAGE:
+            advice = PAL_MADVISE_HUGEPAGE;
+            break;
+        case MADV_NOHUGEPAGE:
+            advice = PAL_MADVISE_NOHUGEPAGE;
+            break;
+        case MADV_DONTNEED:
+        case MADV_FREE:
+        case MADV_DONTFORK:
+        case MADV_DOFORK:
+        case MADV_DONTDUMP:
+        case MADV_DODUMP:
+        case MADV_MERGEABLE:
+        case MADV_UNMERGEABLE:
+            advice = -1;
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    if (!is_in_adjacent_user_vmas(start, len))
+        return -ENOMEM;
+
+    switch (behavior) {
+        case MADV_DONTNEED:
+        case MADV_FREE:
+            return madvise_discard(start, len, behavior == MADV_FREE);
+        case MADV_DONTFORK:
+            return bkeep_vma_flags(start, len, VMA_DONTFORK, 0);
+        case MADV_DOFORK:
+            return bkeep_vma_flags(start, len, 0, VMA_DONTFORK);
+    }
+
+    /* the rest are hints: the PAL may ignore them and so do we if it fails */
+    if (advice >= 0)
+        DkVirtualMemoryAdvise(start, len, advice);
+    return 0;
+}
+
+int shim_do_msync(void* addr, size_t length, int flags) {
+    if (!IS_ALLOC_ALIGNED_PTR(addr) || (flags & ~(MS_ASYNC | MS_SYNC | MS_INVALIDATE)))
+        return -EINVAL;
+
+    if ((flags & MS_ASYNC) && (flags & MS_SYNC))
+        return -EINVAL;
+
+    length = ALLOC_ALIGN_UP(length);
+    if (!length)
+        return 0;
+
+    if (!access_ok(addr, length) || !is_in_adjacent_user_vmas(addr, length))
+        return -ENOMEM;
+
+    /* shared mappings emulated by LibOS are written back even for MS_ASYNC, there is nobody to
+     * write them back later */
+    int ret = sync_shared_mmaps(addr, length, /*remove=*/false);
+    if (ret < 0)
+        return ret;
+
+    if (!(flags & MS_SYNC))
+        return 0;
+
+    char* cur = addr;
+    char* end = (char*)addr + length;
+    while (cur < end) {
+        struct shim_vma_info vma_info;
+        if (lookup_vma(cur, &vma_info) < 0)
+            return -ENOMEM;
+
+        if (vma_info.file) {
+            if ((vma_info.flags & MAP_SHARED) && vma_info.file->pal_handle &&
+                    !DkStreamFlush(vma_info.file->pal_handle))
+                ret = -PAL_ERRNO;
+            put_handle(vma_info.file);
+            if (ret < 0)
+                return ret;
+        }
+        cur = (char*)vma_info.addr + vma_info.length;
+    }
+
+    return 0;
+}
+
 /* This emulation of mincore() always tells that pages are _NOT_ in RAM
  * pessimistically due to lack of a good way to know it.
  * Possibly it may cause performance(or other) issue due to this lying.
@@ -291,16 +729,3 @@ int shim_do_mincore(void* addr, size_t len, unsigned char* vec) {
 
     return 0;
 }
-
-
-int shim_do_mbind(void* start, unsigned long len, int mode, unsigned long* nmask,
-                  unsigned long maxnode, int flags) {
-    /* dummy implementation, always return success */
-    __UNUSED(start);
-    __UNUSED(len);
-    __UNUSED(mode);
-    __UNUSED(nmask);
-    __UNUSED(maxnode);
-    __UNUSED(flags);
-    return 0;
-}
@@ -0,0 +1,752 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_mqueue.c
+ *
+ * Implementation of system calls "mq_open", "mq_unlink", "mq_timedsend", "mq_timedreceive",
+ * "mq_notify" and "mq_getsetattr".
+ *
+ * A POSIX message queue lives in a named shared-memory segment (PAL `shm:` stream, see
+ * shim_sysv_shared.c) mapped by every process of this Graphene instance which opened the queue, so
+ * sending and receiving never goes through IPC: a message is copied into a fixed-size slot under
+ * the lock stored in the segment, and blocked senders and receivers sleep on the sequence counter
+ * of the segment. The slots of queued messages are kept sorted by priority, so receiving is O(1)
+ * and sending is a binary search plus a move of the slot numbers of lower-priority messages.
+ *
+ * The PAL handle of a queue descriptor is an internal eventfd which is readable while the queue is
+ * not empty. It is maintained by a watcher thread, started when the descriptor is first polled
+ * (poll/select/epoll), which sleeps on a counter bumped whenever the queue becomes empty or
+ * non-empty in any process. A queue descriptor is always reported as writable.
+ *
+ * mq_notify() supports SIGEV_NONE and SIGEV_SIGNAL; a signal sent to another process does not
+ * carry si_value. Without `shm:` streams (e.g. on Linux-SGX), mq_open() fails with ENOSYS.
+ */
+
+#include <errno.h>
+#include <linux/fcntl.h>
+#include <linux/limits.h>
+
+#include "pal.h"
+#include "pal_error.h"
+#include "shim_fs.h"
+#include "shim_handle.h"
+#include "shim_internal.h"
+#include "shim_signal.h"
+#include "shim_sysv.h"
+#include "shim_table.h"
+#include "shim_thread.h"
+#include "shim_timer.h"
+#include "shim_utils.h"
+
+#define MQ_DFLT_MAXMSG  10
+#define MQ_DFLT_MSGSIZE 8192
+#define MQ_MAXMSG_MAX   65536
+#define MQ_MSGSIZE_MAX  (16 * 1024 * 1024)
+#define MQ_PRIO_MAX     32768
+
+#define MQUEUE_URI_SIZE (SYSV_SHARED_URI_SIZE + NAME_MAX)
+
+/* the creator of a queue may not have sized or initialized the segment yet when it is opened */
+#define MQUEUE_OPEN_RETRIES 1000
+#define MQUEUE_INIT_WAIT_US 1000
+
+struct mqueue_msg {
+    uint32_t prio;
+    uint32_t size;
+    char data[];
+};
+
+struct mqueue_seg {
+    struct sysv_shared_hdr hdr;
+    uint32_t initialized;  /* set by the creator once the fields below are valid */
+    uint32_t watch_seq;    /* bumped when the queue becomes empty or non-empty */
+    uint32_t nwatchers;
+    uint32_t nreceivers;   /* blocked receivers, a notification is only sent if there are none */
+    uint32_t maxmsg;
+    uint32_t msgsize;
+    uint32_t curmsgs;
+    IDTYPE notify_pid;     /* 0 if no process is registered for notification */
+    int notify_signo;      /* 0 for SIGEV_NONE */
+    sigval_t notify_value;
+    uint64_t notify_owner; /* handle of the registration in process `notify_pid` */
+    /* Permutation of the `maxmsg` slot numbers: the first `curmsgs` are the queued messages in
+     * ascending priority order, the oldest message of a priority last, the rest are free. */
+    uint32_t slots[];
+};
+
+struct shim_mqueue_watcher {
+    struct shim_thread* thread;
+    struct sysv_shared_obj* obj;
+    PAL_HANDLE event;
+    bool ready;  /* `event` is readable; protected by the segment lock */
+    /* set by mqueue_close() with the segment locked, the watcher then unmaps the segment and
+     * closes the eventfd */
+    bool stop;
+};
+
+struct mqueue_notification {
+    IDTYPE pid;
+    int signo;
+    sigval_t value;
+};
+
+static size_t mqueue_msgs_offset(uint32_t maxmsg) {
+    return ALIGN_UP(sizeof(struct mqueue_seg) + maxmsg * sizeof(uint32_t), sizeof(uint64_t));
+}
+
+static size_t mqueue_slot_size(uint32_t msgsize) {
+    return ALIGN_UP(sizeof(struct mqueue_msg) + msgsize, sizeof(uint64_t));
+}
+
+static size_t mqueue_seg_size(uint32_t maxmsg, uint32_t msgsize) {
+    return mqueue_msgs_offset(maxmsg) + (size_t)maxmsg * mqueue_slot_size(msgsize);
+}
+
+static struct mqueue_msg* mqueue_msg(struct mqueue_seg* seg, uint32_t slot) {
+    return (struct mqueue_msg*)((char*)seg + mqueue_msgs_offset(seg->maxmsg) +
+                                slot * mqueue_slot_size(seg->msgsize));
+}
+
+static int mqueue_uri(const char* name, char* uri, size_t size) {
+    if (!name || test_user_string(name))
+        return -EFAULT;
+
+    size_t len = strlen(name);
+    if (!len)
+        return -ENOENT;
+    if (len > NAME_MAX)
+        return -ENAMETOOLONG;
+    /* glibc strips the leading slash, the name itself is a single path component */
+    if (strchr(name, '/') || !strcmp(name, ".") || !strcmp(name, ".."))
+        return -EACCES;
+
+    char shm_name[NAME_MAX + 4];
+    snprintf(shm_name, sizeof(shm_name), "mq-%s", name);
+    sysv_shared_uri(uri, size, shm_name);
+    return 0;
+}
+
+static int mqueue_create(const char* uri, uint32_t maxmsg, uint32_t msgsize,
+                         struct sysv_shared_obj** objp) {
+    int ret = sysv_shared_open(uri, mqueue_seg_size(maxmsg, msgsize), objp);
+    if (ret < 0)
+        return ret;
+
+    struct mqueue_seg* seg = (*objp)->addr;
+    seg->maxmsg  = maxmsg;
+    seg->msgsize = msgsize;
+    for (uint32_t i = 0; i < maxmsg; i++)
+        seg->slots[i] = i;
+
+    __atomic_store_n(&seg->initialized, 1, __ATOMIC_RELEASE);
+    DkWakeByAddress(&seg->initialized, (PAL_NUM)-1);
+    return 0;
+}
+
+static int mqueue_attach(const char* uri, struct sysv_shared_obj** objp) {
+    int ret;
+    for (int retries = 0; retries < MQUEUE_OPEN_RETRIES; retries++) {
+        ret = sysv_shared_open(uri, /*create_size=*/0, objp);
+        if (ret != -EIDRM)
+            break;
+        DkThreadYieldExecution();
+    }
+    if (ret < 0)
+        return ret;
+
+    /* a creator which died before initializing the segment never wakes us up */
+    struct mqueue_seg* seg = (*objp)->addr;
+    for (int retries = 0; !__atomic_load_n(&seg->initialized, __ATOMIC_ACQUIRE); retries++) {
+        if (retries == MQUEUE_OPEN_RETRIES) {
+            sysv_shared_detach(*objp);
+            return -EIDRM;
+        }
+        DkWaitOnAddress(&seg->initialized, 0, MQUEUE_INIT_WAIT_US);
+    }
+
+    if ((*objp)->size < mqueue_seg_size(seg->maxmsg, seg->msgsize)) {
+        sysv_shared_detach(*objp);
+        return -EIDRM;
+    }
+    return 0;
+}
+
+static int mqueue_check_attr(long maxmsg, long msgsize) {
+    if (maxmsg <= 0 || maxmsg > MQ_MAXMSG_MAX || msgsize <= 0 || msgsize > MQ_MSGSIZE_MAX)
+        return -EINVAL;
+    if ((uint64_t)maxmsg * msgsize > get_rlimit_cur(RLIMIT_MSGQUEUE))
+        return -EMFILE;
+    return 0;
+}
+
+static int mqueue_open(const char* uri, int oflag, long maxmsg, long msgsize,
+                       struct sysv_shared_obj** objp) {
+    while (true) {
+        int ret;
+        if (oflag & O_CREAT) {
+            /* like on Linux, the attributes only matter if the queue does not exist yet */
+            int attr_ret = mqueue_check_attr(maxmsg, msgsize);
+            if (attr_ret < 0) {
+                ret = mqueue_attach(uri, objp);
+                if (ret == -ENOENT)
+                    return attr_ret;
+                if (!ret && (oflag & O_EXCL)) {
+                    sysv_shared_detach(*objp);
+                    return -EEXIST;
+                }
+                return ret;
+            }
+
+            ret = mqueue_create(uri, maxmsg, msgsize, objp);
+            if (ret != -EEXIST || (oflag & O_EXCL))
+                return ret;
+        }
+
+        ret = mqueue_attach(uri, objp);
+        /* the queue was unlinked since our attempt to create it */
+        if (ret == -ENOENT && (oflag & O_CREAT))
+            continue;
+        return ret;
+    }
+}
+
+static struct shim_handle* get_mqueue_handle(__kernel_mqd_t mqdes) {
+    struct shim_handle* hdl = get_fd_handle(mqdes, NULL, NULL);
+    if (hdl && hdl->type != TYPE_MQUEUE) {
+        put_handle(hdl);
+        return NULL;
+    }
+    return hdl;
+}
+
+/* Converts the absolute CLOCK_REALTIME timeout of mq_timedsend/mq_timedreceive to a deadline for
+ * sysv_shared_wait(), 0 if there is no timeout. */
+static int mqueue_deadline(const struct timespec* abs_timeout, uint64_t* deadline) {
+    *deadline = 0;
+    if (!abs_timeout)
+        return 0;
+    if (test_user_memory((void*)abs_timeout, sizeof(*abs_timeout), false))
+        return -EFAULT;
+
+    struct __kernel_timespec ts = {.tv_sec = abs_timeout->tv_sec, .tv_nsec = abs_timeout->tv_nsec};
+    if (!timer_timespec_valid(&ts))
+        return -EINVAL;
+
+    /* a timeout at the epoch has expired anyway */
+    *deadline = timer_timespec_to_us(&ts) ?: 1;
+    return 0;
+}
+
+static void mqueue_notify(const struct mqueue_notification* notif) {
+    if (!notif->signo)
+        return;
+
+    struct shim_thread* cur = get_cur_thread();
+    if (notif->pid != cur->tgid) {
+        (void)do_kill_proc(cur->tgid, notif->pid, notif->signo, /*use_ipc=*/true);
+        return;
+    }
+
+    siginfo_t info = {
+        .si_signo = notif->signo,
+        .si_code  = SI_MESGQ,
+    };
+    info.si_pid   = cur->tgid;
+    info.si_uid   = cur->uid;
+    info.si_value = notif->value;
+    (void)do_kill_proc_info(cur->tgid, &info);
+}
+
+int shim_do_mq_timedsend(__kernel_mqd_t mqdes, const char* msg_ptr, size_t msg_len,
+                         unsigned int msg_prio, const struct timespec* abs_timeout) {
+    if (msg_prio >= MQ_PRIO_MAX)
+        return -EINVAL;
+
+    uint64_t deadline;
+    int ret = mqueue_deadline(abs_timeout, &deadline);
+    if (ret < 0)
+        return ret;
+
+    struct shim_handle* hdl = get_mqueue_handle(mqdes);
+    if (!hdl)
+        return -EBADF;
+    if (!(hdl->acc_mode & MAY_WRITE)) {
+        ret = -EBADF;
+        goto out;
+    }
+
+    struct mqueue_seg* seg = hdl->info.mqueue.obj->addr;
+    if (msg_len > seg->msgsize) {
+        ret = -EMSGSIZE;
+        goto out;
+    }
+    if (msg_len && test_user_memory((void*)msg_ptr, msg_len, false)) {
+        ret = -EFAULT;
+        goto out;
+    }
+
+    lock(&hdl->lock);
+    bool nonblock = hdl->flags & O_NONBLOCK;
+    unlock(&hdl->lock);
+
+    struct mqueue_notification notif = {0};
+    bool wake_watchers = false;
+
+    sysv_shared_lock(&seg->hdr);
+    while (seg->curmsgs == seg->maxmsg) {
+        if (nonblock) {
+            sysv_shared_unlock(&seg->hdr);
+            ret = -EAGAIN;
+            goto out;
+        }
+        ret = sysv_shared_wait(&seg->hdr, deadline);
+        if (ret < 0) {
+            sysv_shared_unlock(&seg->hdr);
+            ret = ret == -EAGAIN ? -ETIMEDOUT : ret;
+            goto out;
+        }
+    }
+
+    uint32_t slot = seg->slots[seg->curmsgs];
+    struct mqueue_msg* msg = mqueue_msg(seg, slot);
+    msg->prio = msg_prio;
+    msg->size = msg_len;
+    memcpy(msg->data, msg_ptr, msg_len);
+
+    /* the new message goes before all queued messages of the same or higher priority */
+    uint32_t lo = 0;
+    uint32_t hi = seg->curmsgs;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (mqueue_msg(seg, seg->slots[mid])->prio < msg_prio)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    memmove(&seg->slots[lo + 1], &seg->slots[lo], (seg->curmsgs - lo) * sizeof(seg->slots[0]));
+    seg->slots[lo] = slot;
+
+    if (seg->curmsgs++ == 0) {
+        seg->watch_seq++;
+        wake_watchers = seg->nwatchers > 0;
+
+        /* the registration is removed by the notification */
+        if (seg->notify_pid && !seg->nreceivers) {
+            notif.pid   = seg->notify_pid;
+            notif.signo = seg->notify_signo;
+            notif.value = seg->notify_value;
+            seg->notify_pid = 0;
+        }
+    }
+
+    sysv_shared_changed(&seg->hdr);
+    sysv_shared_unlock_notify(&seg->hdr);
+    if (wake_watchers)
+        DkWakeByAddress(&seg->watch_seq, (PAL_NUM)-1);
+
+    if (notif.pid)
+        mqueue_notify(&notif);
+    ret = 0;
+out:
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_mq_timedreceive(__kernel_mqd_t mqdes, char* msg_ptr, size_t msg_len,
+                            unsigned int* msg_prio, const struct timespec* abs_timeout) {
+    uint64_t deadline;
+    int ret = mqueue_deadline(abs_timeout, &deadline);
+    if (ret < 0)
+        return ret;
+
+    struct shim_handle* hdl = get_mqueue_handle(mqdes);
+    if (!hdl)
+        return -EBADF;
+    if (!(hdl->acc_mode & MAY_READ)) {
+        ret = -EBADF;
+        goto out;
+    }
+
+    struct mqueue_seg* seg = hdl->info.mqueue.obj->addr;
+    if (msg_len < seg->msgsize) {
+        ret = -EMSGSIZE;
+        goto out;
+    }
+    if (test_user_memory(msg_ptr, msg_len, true) ||
+            (msg_prio && test_user_memory(msg_prio, sizeof(*msg_prio), true))) {
+        ret = -EFAULT;
+        goto out;
+    }
+
+    lock(&hdl->lock);
+    bool nonblock = hdl->flags & O_NONBLOCK;
+    unlock(&hdl->lock);
+
+    sysv_shared_lock(&seg->hdr);
+    while (!seg->curmsgs) {
+        if (nonblock) {
+            sysv_shared_unlock(&seg->hdr);
+            ret = -EAGAIN;
+            goto out;
+        }
+        seg->nreceivers++;
+        ret = sysv_shared_wait(&seg->hdr, deadline);
+        seg->nreceivers--;
+        if (ret < 0) {
+            sysv_shared_unlock(&seg->hdr);
+            ret = ret == -EAGAIN ? -ETIMEDOUT : ret;
+            goto out;
+        }
+    }
+
+    /* the slot stays where it is, as the first free one */
+    struct mqueue_msg* msg = mqueue_msg(seg, seg->slots[--seg->curmsgs]);
+    memcpy(msg_ptr, msg->data, msg->size);
+    if (msg_prio)
+        *msg_prio = msg->prio;
+    ret = msg->size;
+
+    bool wake_watchers = false;
+    if (!seg->curmsgs) {
+        seg->watch_seq++;
+        wake_watchers = seg->nwatchers > 0;
+    }
+
+    sysv_shared_changed(&seg->hdr);
+    sysv_shared_unlock_notify(&seg->hdr);
+    if (wake_watchers)
+        DkWakeByAddress(&seg->watch_seq, (PAL_NUM)-1);
+out:
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_mq_notify(__kernel_mqd_t mqdes, const struct sigevent* notification) {
+    int signo = 0;
+    if (notification) {
+        if (test_user_memory((void*)notification, sizeof(*notification), false))
+            return -EFAULT;
+
+        switch (notification->sigev_notify) {
+            case SIGEV_NONE:
+                break;
+            case SIGEV_SIGNAL:
+                signo = notification->sigev_signo;
+                if (signo <= 0 || signo > NUM_SIGS)
+                    return -EINVAL;
+                break;
+            default:
+                /* SIGEV_THREAD needs a netlink socket for libc to receive the notification */
+                return -EINVAL;
+        }
+    }
+
+    struct shim_handle* hdl = get_mqueue_handle(mqdes);
+    if (!hdl)
+        return -EBADF;
+
+    struct mqueue_seg* seg = hdl->info.mqueue.obj->addr;
+    IDTYPE tgid = get_cur_thread()->tgid;
+    int ret = 0;
+
+    sysv_shared_lock(&seg->hdr);
+    if (!notification) {
+        if (seg->notify_pid == tgid)
+            seg->notify_pid = 0;
+    } else if (seg->notify_pid) {
+        ret = -EBUSY;
+    } else {
+        seg->notify_pid   = tgid;
+        seg->notify_signo = signo;
+        seg->notify_value = notification->sigev_value;
+        seg->notify_owner = (uint64_t)hdl;
+    }
+    sysv_shared_unlock(&seg->hdr);
+
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_mq_getsetattr(__kernel_mqd_t mqdes, const struct __kernel_mq_attr* mqstat,
+                          struct __kernel_mq_attr* omqstat) {
+    if (mqstat && test_user_memory((void*)mqstat, sizeof(*mqstat), false))
+        return -EFAULT;
+    if (omqstat && test_user_memory(omqstat, sizeof(*omqstat), true))
+        return -EFAULT;
+
+    /* `mqstat` and `omqstat` may be the same buffer */
+    long new_flags = mqstat ? mqstat->mq_flags : 0;
+    if (new_flags & ~O_NONBLOCK)
+        return -EINVAL;
+
+    struct shim_handle* hdl = get_mqueue_handle(mqdes);
+    if (!hdl)
+        return -EBADF;
+
+    lock(&hdl->lock);
+    long old_flags = hdl->flags & O_NONBLOCK;
+    if (mqstat)
+        hdl->flags = (hdl->flags & ~O_NONBLOCK) | new_flags;
+    unlock(&hdl->lock);
+
+    if (omqstat) {
+        struct mqueue_seg* seg = hdl->info.mqueue.obj->addr;
+        memset(omqstat, 0, sizeof(*omqstat));
+        omqstat->mq_flags   = old_flags;
+        omqstat->mq_maxmsg  = seg->maxmsg;
+        omqstat->mq_msgsize = seg->msgsize;
+        omqstat->mq_curmsgs = __atomic_load_n(&seg->curmsgs, __ATOMIC_RELAXED);
+    }
+
+    put_handle(hdl);
+    return 0;
+}
+
+/* Makes the eventfd of `watcher` readable iff the queue is not empty. Must be called with the
+ * segment locked. */
+static void mqueue_update_event(struct shim_mqueue_watcher* watcher, struct mqueue_seg* seg) {
+    bool nonempty = seg->curmsgs > 0;
+    if (nonempty == watcher->ready)
+        return;
+    watcher->ready = nonempty;
+
+    uint64_t cnt = 1;
+    /* the eventfd is non-blocking, a read only drains it */
+    if (nonempty)
+        DkStreamWrite(watcher->event, 0, sizeof(cnt), &cnt, NULL);
+    else
+        DkStreamRead(watcher->event, 0, sizeof(cnt), &cnt, NULL, 0);
+}
+
+static void mqueue_watcher(void* arg) {
+    struct shim_mqueue_watcher* watcher = arg;
+    struct shim_thread* self = watcher->thread;
+
+    shim_tcb_init();
+    set_cur_thread(self);
+    update_fs_base(0);
+    debug_setbuf(shim_get_tcb(), true);
+
+    struct mqueue_seg* seg = watcher->obj->addr;
+
+    sysv_shared_lock(&seg->hdr);
+    while (!watcher->stop) {
+        mqueue_update_event(watcher, seg);
+        uint32_t seq = seg->watch_seq;
+        seg->nwatchers++;
+        sysv_shared_unlock(&seg->hdr);
+
+        DkWaitOnAddress(&seg->watch_seq, seq, NO_TIMEOUT);
+
+        sysv_shared_lock(&seg->hdr);
+        seg->nwatchers--;
+    }
+    sysv_shared_unlock(&seg->hdr);
+
+    sysv_shared_detach(watcher->obj);
+    DkObjectClose(watcher->event);
+    free(watcher);
+
+    __disable_preempt(self->shim_tcb);
+    put_thread(self);
+    DkThreadExit(/*clear_child_tid=*/NULL);
+}
+
+/* Must be called with `hdl->lock` held. */
+static int mqueue_start_watcher(struct shim_handle* hdl) {
+    assert(locked(&hdl->lock));
+
+    struct shim_mqueue_watcher* watcher = malloc(sizeof(*watcher));
+    if (!watcher)
+        return -ENOMEM;
+    watcher->obj   = hdl->info.mqueue.obj;
+    watcher->event = hdl->pal_handle;
+    watcher->ready = false;
+    watcher->stop  = false;
+
+    watcher->thread = get_new_internal_thread();
+    if (!watcher->thread) {
+        free(watcher);
+        return -ENOMEM;
+    }
+
+    PAL_HANDLE handle = thread_create(mqueue_watcher, watcher);
+    if (!handle) {
+        put_thread(watcher->thread);
+        free(watcher);
+        return -PAL_ERRNO;
+    }
+
+    watcher->thread->pal_handle = handle;
+    __atomic_store_n(&hdl->info.mqueue.watcher, watcher, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int mqueue_watch(struct shim_handle* hdl) {
+    struct shim_mqueue_handle* mq = &hdl->info.mqueue;
+    struct shim_mqueue_watcher* watcher = __atomic_load_n(&mq->watcher, __ATOMIC_ACQUIRE);
+
+    if (!watcher) {
+        lock(&hdl->lock);
+        int ret = mq->watcher ? 0 : mqueue_start_watcher(hdl);
+        watcher = mq->watcher;
+        unlock(&hdl->lock);
+        if (ret < 0)
+            return ret;
+    }
+
+    /* the caller may poll right away, do not wait for the watcher to catch up */
+    struct mqueue_seg* seg = mq->obj->addr;
+    sysv_shared_lock(&seg->hdr);
+    mqueue_update_event(watcher, seg);
+    sysv_shared_unlock(&seg->hdr);
+    return 0;
+}
+
+static off_t mqueue_poll(struct shim_handle* hdl, int poll_type) {
+    struct mqueue_seg* seg = hdl->info.mqueue.obj->addr;
+    uint32_t curmsgs = __atomic_load_n(&seg->curmsgs, __ATOMIC_RELAXED);
+
+    if (poll_type == FS_POLL_SZ)
+        return 0;
+
+    off_t ret = 0;
+    if ((poll_type & FS_POLL_RD) && curmsgs > 0)
+        ret |= FS_POLL_RD;
+    if ((poll_type & FS_POLL_WR) && curmsgs < seg->maxmsg)
+        ret |= FS_POLL_WR;
+    return ret;
+}
+
+static int mqueue_close(struct shim_handle* hdl) {
+    struct shim_mqueue_handle* mq = &hdl->info.mqueue;
+    if (!mq->obj)
+        return 0;
+
+    struct mqueue_seg* seg = mq->obj->addr;
+    struct shim_thread* cur = get_cur_thread();
+
+    sysv_shared_lock(&seg->hdr);
+    if (cur && seg->notify_pid == cur->tgid && seg->notify_owner == (uint64_t)hdl)
+        seg->notify_pid = 0;
+    if (mq->watcher) {
+        /* the segment stays locked until the watcher is woken up, so it cannot unmap it yet */
+        mq->watcher->stop = true;
+        seg->watch_seq++;
+        DkWakeByAddress(&seg->watch_seq, (PAL_NUM)-1);
+    }
+    sysv_shared_unlock(&seg->hdr);
+
+    if (mq->watcher) {
+        /* the watcher owns the segment mapping and the eventfd from now on */
+        hdl->pal_handle = NULL;
+    } else {
+        sysv_shared_detach(mq->obj);
+    }
+    mq->obj     = NULL;
+    mq->watcher = NULL;
+    return 0;
+}
+
+static int mqueue_checkout(struct shim_handle* hdl) {
+    /* the stream of the segment is migrated in the handle checkpoint, the child maps it again and
+     * gets its own eventfd (and watcher, once polled) */
+    hdl->pal_handle = NULL;
+    hdl->info.mqueue.obj     = NULL;
+    hdl->info.mqueue.watcher = NULL;
+    return 0;
+}
+
+static int mqueue_checkin(struct shim_handle* hdl) {
+    struct shim_mqueue_handle* mq = &hdl->info.mqueue;
+    if (!mq->migrated)
+        return -EINVAL;
+
+    int ret = sysv_shared_map(mq->migrated, &mq->obj);
+    if (ret < 0)
+        return ret;
+    mq->migrated = NULL;
+
+    hdl->pal_handle = DkStreamOpen(URI_PREFIX_EVENTFD, 0, 0, 0, PAL_OPTION_NONBLOCK);
+    if (!hdl->pal_handle) {
+        debug("mqueue: eventfd open failure\n");
+        return -PAL_ERRNO;
+    }
+    return 0;
+}
+
+struct shim_fs_ops mqueue_fs_ops = {
+    .poll     = &mqueue_poll,
+    .close    = &mqueue_close,
+    .checkout = &mqueue_checkout,
+    .checkin  = &mqueue_checkin,
+};
+
+struct shim_mount mqueue_builtin_fs = {
+    .type   = "mqueue",
+    .fs_ops = &mqueue_fs_ops,
+};
+
+int shim_do_mq_open(const char* name, int oflag, mode_t mode, struct __kernel_mq_attr* attr) {
+    /* all processes of this Graphene instance run as the same user */
+    __UNUSED(mode);
+
+    char uri[MQUEUE_URI_SIZE];
+    int ret = mqueue_uri(name, uri, sizeof(uri));
+    if (ret < 0)
+        return ret;
+
+    if ((oflag & O_ACCMODE) == O_ACCMODE)
+        return -EINVAL;
+
+    long maxmsg  = MQ_DFLT_MAXMSG;
+    long msgsize = MQ_DFLT_MSGSIZE;
+    if ((oflag & O_CREAT) && attr) {
+        if (test_user_memory(attr, sizeof(*attr), false))
+            return -EFAULT;
+        maxmsg  = attr->mq_maxmsg;
+        msgsize = attr->mq_msgsize;
+    }
+
+    struct shim_handle* hdl = get_new_handle();
+    if (!hdl)
+        return -ENOMEM;
+
+    hdl->type = TYPE_MQUEUE;
+    set_handle_fs(hdl, &mqueue_builtin_fs);
+    hdl->flags    = oflag & (O_ACCMODE | O_NONBLOCK);
+    hdl->acc_mode = ACC_MODE(oflag & O_ACCMODE);
+
+    int pal_flags = PAL_OPTION_NONBLOCK | (oflag & O_CLOEXEC ? PAL_OPTION_CLOEXEC : 0);
+    hdl->pal_handle = DkStreamOpen(URI_PREFIX_EVENTFD, 0, 0, 0, pal_flags);
+    if (!hdl->pal_handle) {
+        debug("mqueue: eventfd open failure\n");
+        ret = -PAL_ERRNO;
+        goto out;
+    }
+
+    ret = mqueue_open(uri, oflag, maxmsg, msgsize, &hdl->info.mqueue.obj);
+    if (ret < 0)
+        goto out;
+
+    ret = set_new_fd_handle(hdl, oflag & O_CLOEXEC ? FD_CLOEXEC : 0, NULL);
+out:
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_mq_unlink(const char* name) {
+    char uri[MQUEUE_URI_SIZE];
+    int ret = mqueue_uri(name, uri, sizeof(uri));
+    if (ret < 0)
+        return ret;
+
+    /* processes which have the queue open keep using it, new ones fail to open it */
+    PAL_HANDLE pal_hdl = DkStreamOpen(uri, PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!pal_hdl)
+        return -PAL_ERRNO;
+
+    DkStreamDelete(pal_hdl, 0);
+    DkObjectClose(pal_hdl);
+    return 0;
+}
@@ -277,14 +277,38 @@ int shim_do_msgget(key_t key, int msgflg) {
                 ipc_sysv_lease_send(NULL);
         } while (!msgid);
 
+        /* The shared segment must be ready before other processes can learn the msgid. */
+        struct sysv_shared_obj* shared = NULL;
+        if (sysv_shared_enabled()) {
+            ret = sysv_shared_msgq_create(msgid, &shared);
+            if (ret < 0 && ret != -ENOSYS) {
+                release_sysv(msgid);
+                return ret;
+            }
+        }
+
         if (key != IPC_PRIVATE) {
             if ((ret = ipc_sysv_tellkey_send(NULL, 0, &k, msgid, 0)) < 0) {
+                if (shared) {
+                    sysv_shared_msgq_remove(shared);
+                    sysv_shared_detach(shared);
+                }
                 release_sysv(msgid);
                 return ret;
             }
         }
 
         add_msg_handle(key, msgid, true);
+
+        if (shared) {
+            struct shim_msg_handle* msgq = get_msg_handle_by_id(msgid);
+            if (msgq) {
+                msgq->shared = shared;
+                put_msg_handle(msgq);
+            } else {
+                sysv_shared_release(shared, /*unmap=*/true);
+            }
+        }
     } else {
         /* query the manager with the key to find the
            corresponding sysvkey */
@@ -293,7 +317,8 @@ int shim_do_msgget(key_t key, int msgflg) {
 
         msgid = ret;
 
-        if ((ret = ipc_sysv_query_send(msgid)) < 0)
+        /* With the local-first fast path, the owner is never contacted. */
+        if (!sysv_shared_enabled() && (ret = ipc_sysv_query_send(msgid)) < 0)
             return ret;
 
         add_msg_handle(key, msgid, false);
@@ -306,6 +331,36 @@ static int connect_msg_handle(int msqid, struct shim_msg_handle** msgqp) {
     struct shim_msg_handle* msgq = get_msg_handle_by_id(msqid);
     int ret;
 
+    if (sysv_shared_enabled() && !(msgq && msgq->shared)) {
+        /* Local-first: attaching to the shared segment needs no round-trip to the owner. */
+        struct sysv_shared_obj* shared = NULL;
+        ret = sysv_shared_msgq_attach(msqid, &shared);
+        if (ret >= 0) {
+            if (!msgq) {
+                lock(&msgq_list_lock);
+                ret = __add_msg_handle(IPC_PRIVATE, msqid, false, &msgq);
+                unlock(&msgq_list_lock);
+                if (ret < 0)
+                    return ret;
+            }
+            struct shim_handle* hdl = MSG_TO_HANDLE(msgq);
+            lock(&hdl->lock);
+            if (!msgq->shared) {
+                msgq->shared = shared;
+                shared = NULL;
+            }
+            unlock(&hdl->lock);
+            if (shared) {
+                /* another thread attached concurrently */
+                sysv_shared_release(shared, /*unmap=*/true);
+            }
+        } else if (ret != -ENOSYS) {
+            if (msgq)
+                put_msg_handle(msgq);
+            return ret == -ENOENT ? (msgq ? -EIDRM : -EINVAL) : ret;
+        }
+    }
+
     if (!msgq) {
         if ((ret = ipc_sysv_query_send(msqid)) < 0)
             return ret;
@@ -345,9 +400,6 @@ out:
 }
 
 int shim_do_msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg) {
-    // Issue #755 - https://github.com/oscarlab/graphene/issues/755
-    __UNUSED(msgflg);
-
     int ret;
 
     if (msgsz > MSGMAX)
@@ -370,6 +422,16 @@ int shim_do_msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg) {
     if ((ret = connect_msg_handle(msqid, &msgq)) < 0)
         return ret;
 
+    if (msgq->shared) {
+        ret = sysv_shared_msgsnd(msgq->shared, msgbuf, msgsz, msgflg);
+        /* removed by another process: drop the handle, which detaches the segment */
+        if (ret == -EIDRM)
+            del_msg_handle(msgq);
+        put_msg_handle(msgq);
+        return ret;
+    }
+
+    // Issue #755 - https://github.com/oscarlab/graphene/issues/755
     // FIXME: This call crashes Graphene, causing NULL dereference in add_sysv_msg. Everything in
     // this file seems to be broken, so probably better to just rewrite it?
     ret = add_sysv_msg(msgq, msgbuf->mtype, msgsz, msgbuf->mtext, NULL);
@@ -378,9 +440,6 @@ int shim_do_msgsnd(int msqid, const void* msgp, size_t msgsz, int msgflg) {
 }
 
 int shim_do_msgrcv(int msqid, void* msgp, size_t msgsz, long msgtype, int msgflg) {
-    // Issue #755 - https://github.com/oscarlab/graphene/issues/755
-    __UNUSED(msgflg);
-
     int ret;
 
     if (msgsz > MSGMAX)
@@ -398,6 +457,15 @@ int shim_do_msgrcv(int msqid, void* msgp, size_t msgsz, long msgtype, int msgflg
     if ((ret = connect_msg_handle(msqid, &msgq)) < 0)
         return ret;
 
+    if (msgq->shared) {
+        ret = sysv_shared_msgrcv(msgq->shared, msgtype, msgbuf, msgsz, msgflg);
+        if (ret == -EIDRM)
+            del_msg_handle(msgq);
+        put_msg_handle(msgq);
+        return ret;
+    }
+
+    // Issue #755 - https://github.com/oscarlab/graphene/issues/755
     ret = get_sysv_msg(msgq, msgtype, msgsz, msgbuf->mtext, msgflg, NULL);
     put_msg_handle(msgq);
     return ret;
@@ -419,6 +487,15 @@ int shim_do_msgctl(int msqid, int cmd, struct msqid_ds* buf) {
 
     switch (cmd) {
         case IPC_RMID:
+            if (msgq->shared) {
+                ret = sysv_shared_msgq_remove(msgq->shared);
+                if (ret < 0) {
+                    if (ret == -EIDRM)
+                        del_msg_handle(msgq);
+                    break;
+                }
+            }
+
             if (!msgq->owned) {
                 ret = ipc_sysv_delres_send(NULL, 0, msgq->msqid, SYSV_MSGQ);
                 if (ret < 0)
@@ -895,6 +972,19 @@ int store_all_msg_persist(void) {
     return 0;
 }
 
+void release_all_msg_shared(void) {
+    if (!create_lock_runtime(&msgq_list_lock))
+        return;
+
+    struct shim_msg_handle* msgq;
+    lock(&msgq_list_lock);
+    LISTP_FOR_EACH_ENTRY(msgq, &msgq_list, list) {
+        if (msgq->shared)
+            sysv_shared_release(msgq->shared, /*unmap=*/false);
+    }
+    unlock(&msgq_list_lock);
+}
+
 int shim_do_msgpersist(int msqid, int cmd) {
     struct shim_msg_handle* msgq;
     struct shim_handle* hdl;
@@ -5,8 +5,9 @@
  * shim_open.c
  *
  * Implementation of system call "read", "write", "open", "creat", "openat",
- * "close", "lseek", "pread64", "pwrite64", "getdents", "getdents64",
- * "fsync", "truncate" and "ftruncate".
+ * "close", "lseek", "pread64", "pwrite64", "preadv", "pwritev", "getdents",
+ * "getdents64", "fsync", "syncfs", "sync_file_range", "fallocate", "fadvise64",
+ * "readahead", "truncate" and "ftruncate".
  */
 
 #include <shim_internal.h>
@@ -23,7 +24,10 @@
 #include <dirent.h>
 
 #include <linux/stat.h>
+#include <linux/falloc.h>
+#include <linux/fadvise.h>
 #include <linux/fcntl.h>
+#include <linux/fs.h>
 
 int do_handle_read (struct shim_handle * hdl, void * buf, int count)
 {
@@ -173,6 +177,8 @@ int shim_do_close (int fd)
     if (!handle)
         return -EBADF;
 
+    /* as on Linux, closing any descriptor of a file drops the POSIX locks of the process on it */
+    file_locks_release(handle, /*posix=*/true);
     put_handle(handle);
     return 0;
 }
@@ -208,104 +214,228 @@ out:
     return ret;
 }
 
-ssize_t shim_do_pread64 (int fd, char * buf, size_t count, loff_t pos)
-{
-    if (!buf || test_user_memory(buf, count, true))
-        return -EFAULT;
+static int check_pio_handle(struct shim_handle* hdl, bool write) {
+    struct shim_mount* fs = hdl->fs;
+    if (!fs || !fs->fs_ops)
+        return -EACCES;
 
-    if (pos < 0)
-        return -EINVAL;
+    struct shim_fs_ops* fs_ops = fs->fs_ops;
+    bool has_pio = write ? !!fs_ops->pwrite : !!fs_ops->pread;
+    if (!has_pio && !fs_ops->seek)
+        return -ESPIPE;
 
-    struct shim_handle * hdl = get_fd_handle(fd, NULL, NULL);
-    if (!hdl)
-        return -EBADF;
+    if (!has_pio && !(write ? !!fs_ops->write : !!fs_ops->read))
+        return -EACCES;
 
-    struct shim_mount * fs = hdl->fs;
-    ssize_t ret = -EACCES;
+    if (hdl->type == TYPE_DIR)
+        return -EACCES;
 
-    if (!fs || !fs->fs_ops)
-        goto out;
+    return 0;
+}
 
-    if (!fs->fs_ops->seek) {
-        ret = -ESPIPE;
-        goto out;
-    }
+/* Filesystems without positional I/O get pread/pwrite emulated by moving the file position back
+ * and forth; this is not atomic with respect to other users of the same handle. */
+static ssize_t do_pread(struct shim_handle* hdl, void* buf, size_t count, off_t pos) {
+    struct shim_fs_ops* fs_ops = hdl->fs->fs_ops;
 
-    if (!fs->fs_ops->read)
-        goto out;
+    if (fs_ops->pread)
+        return fs_ops->pread(hdl, buf, count, pos);
 
-    if (hdl->type == TYPE_DIR)
-        goto out;
+    off_t offset = fs_ops->seek(hdl, 0, SEEK_CUR);
+    if (offset < 0)
+        return offset;
 
-    int offset = fs->fs_ops->seek(hdl, 0, SEEK_CUR);
-    if (offset < 0) {
-        ret = offset;
-        goto out;
-    }
+    ssize_t ret = fs_ops->seek(hdl, pos, SEEK_SET);
+    if (ret < 0)
+        return ret;
+
+    ssize_t bytes = fs_ops->read(hdl, buf, count);
 
-    ret = fs->fs_ops->seek(hdl, pos, SEEK_SET);
+    ret = fs_ops->seek(hdl, offset, SEEK_SET);
     if (ret < 0)
-        goto out;
+        return ret;
+
+    return bytes;
+}
+
+static ssize_t do_pwrite(struct shim_handle* hdl, const void* buf, size_t count, off_t pos) {
+    struct shim_fs_ops* fs_ops = hdl->fs->fs_ops;
 
-    int bytes = fs->fs_ops->read(hdl, buf, count);
+    if (fs_ops->pwrite)
+        return fs_ops->pwrite(hdl, buf, count, pos);
 
-    ret = fs->fs_ops->seek(hdl, offset, SEEK_SET);
+    off_t offset = fs_ops->seek(hdl, 0, SEEK_CUR);
+    if (offset < 0)
+        return offset;
+
+    ssize_t ret = fs_ops->seek(hdl, pos, SEEK_SET);
     if (ret < 0)
-        goto out;
+        return ret;
 
-    ret = bytes;
-out:
+    ssize_t bytes = fs_ops->write(hdl, buf, count);
+
+    ret = fs_ops->seek(hdl, offset, SEEK_SET);
+    if (ret < 0)
+        return ret;
+
+    return bytes;
+}
+
+ssize_t do_handle_pread(struct shim_handle* hdl, void* buf, size_t count, off_t pos) {
+    ssize_t ret = check_pio_handle(hdl, /*write=*/false);
+    if (ret < 0)
+        return ret;
+
+    return do_pread(hdl, buf, count, pos);
+}
+
+ssize_t do_handle_pwrite(struct shim_handle* hdl, const void* buf, size_t count, off_t pos) {
+    ssize_t ret = check_pio_handle(hdl, /*write=*/true);
+    if (ret < 0)
+        return ret;
+
+    return do_pwrite(hdl, buf, count, pos);
+}
+
+ssize_t shim_do_pread64(int fd, char* buf, size_t count, loff_t pos) {
+    if (!buf || test_user_memory(buf, count, true))
+        return -EFAULT;
+
+    if (pos < 0)
+        return -EINVAL;
+
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    ssize_t ret = do_handle_pread(hdl, buf, count, pos);
     put_handle(hdl);
     return ret;
 }
 
-ssize_t shim_do_pwrite64 (int fd, char * buf, size_t count, loff_t pos)
-{
+ssize_t shim_do_pwrite64(int fd, char* buf, size_t count, loff_t pos) {
     if (!buf || test_user_memory(buf, count, false))
         return -EFAULT;
 
     if (pos < 0)
         return -EINVAL;
 
-    struct shim_handle * hdl = get_fd_handle(fd, NULL, NULL);
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
     if (!hdl)
         return -EBADF;
 
-    struct shim_mount * fs = hdl->fs;
-    ssize_t ret = -EACCES;
+    ssize_t ret = do_handle_pwrite(hdl, buf, count, pos);
+    put_handle(hdl);
+    return ret;
+}
 
-    if (!fs || !fs->fs_ops)
-        goto out;
+static int check_iovec(const struct iovec* vec, unsigned long vlen, bool write) {
+    if (vlen > UIO_MAXIOV)
+        return -EINVAL;
 
-    if (!fs->fs_ops->seek) {
-        ret = -ESPIPE;
-        goto out;
+    if (!vec || test_user_memory((void*)vec, sizeof(*vec) * vlen, false))
+        return -EFAULT;
+
+    size_t total = 0;
+    for (unsigned long i = 0; i < vlen; i++) {
+        if (__builtin_add_overflow(total, vec[i].iov_len, &total) || (ssize_t)total < 0)
+            return -EINVAL;
+        if (vec[i].iov_len && test_user_memory(vec[i].iov_base, vec[i].iov_len, !write))
+            return -EFAULT;
     }
 
-    if (!fs->fs_ops->write)
-        goto out;
+    return 0;
+}
 
-    if (hdl->type == TYPE_DIR)
-        goto out;
+ssize_t do_handle_preadv(struct shim_handle* hdl, const struct iovec* vec, unsigned long vlen,
+                         off_t pos) {
+    ssize_t ret = check_pio_handle(hdl, /*write=*/false);
+    if (ret < 0)
+        return ret;
 
-    int offset = fs->fs_ops->seek(hdl, 0, SEEK_CUR);
-    if (offset < 0) {
-        ret = offset;
-        goto out;
+    if (hdl->fs->fs_ops->preadv)
+        return hdl->fs->fs_ops->preadv(hdl, vec, vlen, pos);
+
+    ssize_t bytes = 0;
+    for (unsigned long i = 0; i < vlen; i++) {
+        if (!vec[i].iov_len)
+            continue;
+
+        ssize_t b_vec = do_pread(hdl, vec[i].iov_base, vec[i].iov_len, pos + bytes);
+        if (b_vec < 0)
+            return bytes ?: b_vec;
+
+        bytes += b_vec;
+        if ((size_t)b_vec < vec[i].iov_len)
+            break;
     }
 
-    ret = fs->fs_ops->seek(hdl, pos, SEEK_SET);
+    return bytes;
+}
+
+/* on x86-64 the whole offset is passed in `pos_l`, `pos_h` is ignored (as in Linux) */
+ssize_t shim_do_preadv(int fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
+                       unsigned long pos_h) {
+    __UNUSED(pos_h);
+    off_t pos = (off_t)pos_l;
+    if (pos < 0)
+        return -EINVAL;
+
+    ssize_t ret = check_iovec(vec, vlen, /*write=*/false);
     if (ret < 0)
-        goto out;
+        return ret;
 
-    int bytes = fs->fs_ops->write(hdl, buf, count);
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
 
-    ret = fs->fs_ops->seek(hdl, offset, SEEK_SET);
+    ret = do_handle_preadv(hdl, vec, vlen, pos);
+    put_handle(hdl);
+    return ret;
+}
+
+ssize_t do_handle_pwritev(struct shim_handle* hdl, const struct iovec* vec, unsigned long vlen,
+                          off_t pos) {
+    ssize_t ret = check_pio_handle(hdl, /*write=*/true);
     if (ret < 0)
-        goto out;
+        return ret;
 
-    ret = bytes;
-out:
+    if (hdl->fs->fs_ops->pwritev)
+        return hdl->fs->fs_ops->pwritev(hdl, vec, vlen, pos);
+
+    ssize_t bytes = 0;
+    for (unsigned long i = 0; i < vlen; i++) {
+        if (!vec[i].iov_len)
+            continue;
+
+        ssize_t b_vec = do_pwrite(hdl, vec[i].iov_base, vec[i].iov_len, pos + bytes);
+        if (b_vec < 0)
+            return bytes ?: b_vec;
+
+        bytes += b_vec;
+        if ((size_t)b_vec < vec[i].iov_len)
+            break;
+    }
+
+    return bytes;
+}
+
+ssize_t shim_do_pwritev(int fd, const struct iovec* vec, unsigned long vlen, unsigned long pos_l,
+                        unsigned long pos_h) {
+    __UNUSED(pos_h);
+    off_t pos = (off_t)pos_l;
+    if (pos < 0)
+        return -EINVAL;
+
+    ssize_t ret = check_iovec(vec, vlen, /*write=*/true);
+    if (ret < 0)
+        return ret;
+
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    ret = do_handle_pwritev(hdl, vec, vlen, pos);
     put_handle(hdl);
     return ret;
 }
@@ -536,28 +666,28 @@ out:
     return ret;
 }
 
-int shim_do_fsync (int fd)
-{
-    struct shim_handle * hdl = get_fd_handle(fd, NULL, NULL);
-    if (!hdl)
-        return -EBADF;
-
-    int ret = -EACCES;
-    struct shim_mount * fs = hdl->fs;
+int do_handle_fsync(struct shim_handle* hdl) {
+    struct shim_mount* fs = hdl->fs;
 
     if (!fs || !fs->fs_ops)
-        goto out;
+        return -EACCES;
 
     if (hdl->type == TYPE_DIR)
-        goto out;
+        return -EACCES;
 
-    if (!fs->fs_ops->flush) {
-        ret = -EROFS;
-        goto out;
-    }
+    if (!fs->fs_ops->flush)
+        return -EROFS;
 
-    ret = fs->fs_ops->flush(hdl);
-out:
+    return fs->fs_ops->flush(hdl);
+}
+
+int shim_do_fsync (int fd)
+{
+    struct shim_handle * hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    int ret = do_handle_fsync(hdl);
     put_handle(hdl);
     return ret;
 }
@@ -570,6 +700,154 @@ int shim_do_fdatasync (int fd)
     return shim_do_fsync(fd);
 }
 
+/* The LibOS does not cache file data itself, so syncing the file system of `fd` means writing back
+ * the emulated shared file mappings and flushing every file of the same mount that this process
+ * has open. Files which only other processes have open are synced by their own fsync/exit. */
+int shim_do_syncfs(int fd) {
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    struct shim_mount* fs = hdl->fs;
+    put_handle(hdl);
+
+    int ret = sync_all_shared_mmaps(/*remove=*/false);
+    if (ret < 0)
+        return ret;
+
+    if (!fs)
+        return 0;
+
+    struct shim_handle_map* map = get_cur_handle_map(NULL);
+    lock(&map->lock);
+
+    for (int i = 0; map->fd_top != FD_NULL && i <= map->fd_top; i++) {
+        if (!HANDLE_ALLOCATED(map->map[i]))
+            continue;
+
+        struct shim_handle* file = map->map[i]->handle;
+        if (file && file->fs == fs && file->type != TYPE_DIR)
+            flush_handle(file);
+    }
+
+    unlock(&map->lock);
+    return 0;
+}
+
+int shim_do_sync_file_range(int fd, loff_t offset, loff_t nbytes, int flags) {
+    if (flags & ~(SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                  SYNC_FILE_RANGE_WAIT_AFTER))
+        return -EINVAL;
+
+    loff_t end;
+    if (offset < 0 || nbytes < 0 || __builtin_add_overflow(offset, nbytes, &end))
+        return -EINVAL;
+
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    struct shim_mount* fs = hdl->fs;
+    int ret = 0;
+
+    if (hdl->type == TYPE_PIPE || hdl->type == TYPE_SOCK) {
+        ret = -ESPIPE;
+    } else if (hdl->type == TYPE_DIR || !fs || !fs->fs_ops) {
+        ret = 0;
+    } else if (fs->fs_ops->sync_range) {
+        ret = fs->fs_ops->sync_range(hdl, offset, nbytes, flags);
+    } else if (flags && fs->fs_ops->flush) {
+        /* no ranged write-out for this file system, a full fsync is the closest we can do */
+        ret = fs->fs_ops->flush(hdl);
+    }
+
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_fallocate(int fd, int mode, loff_t offset, loff_t len) {
+    if (offset < 0 || len <= 0)
+        return -EINVAL;
+
+    if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE | FALLOC_FL_ZERO_RANGE))
+        return -EOPNOTSUPP;
+
+    /* holes can only be punched within the current length, and not combined with zeroing */
+    if ((mode & FALLOC_FL_PUNCH_HOLE) && mode != (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE))
+        return -EOPNOTSUPP;
+
+    loff_t end;
+    if (__builtin_add_overflow(offset, len, &end))
+        return -EFBIG;
+
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    struct shim_mount* fs = hdl->fs;
+    int ret;
+
+    if (!(hdl->acc_mode & MAY_WRITE)) {
+        ret = -EBADF;
+    } else if (hdl->type == TYPE_PIPE) {
+        ret = -ESPIPE;
+    } else if (hdl->type == TYPE_DIR) {
+        ret = -EISDIR;
+    } else if (!fs || !fs->fs_ops || !fs->fs_ops->fallocate) {
+        ret = -ENODEV;
+    } else {
+        ret = fs->fs_ops->fallocate(hdl, mode, offset, len);
+    }
+
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_fadvise64(int fd, loff_t offset, size_t len, int advice) {
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    struct shim_mount* fs = hdl->fs;
+    int ret = 0;
+
+    if (hdl->type == TYPE_PIPE || hdl->type == TYPE_SOCK) {
+        ret = -ESPIPE;
+    } else if (advice < POSIX_FADV_NORMAL || advice > POSIX_FADV_NOREUSE || offset < 0 ||
+               (loff_t)len < 0) {
+        ret = -EINVAL;
+    } else if (fs && fs->fs_ops && fs->fs_ops->fadvise) {
+        ret = fs->fs_ops->fadvise(hdl, offset, len, advice);
+    }
+    /* otherwise the file has no host cache the advice could apply to, so it is ignored */
+
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_readahead(int fd, loff_t offset, size_t count) {
+    struct shim_handle* hdl = get_fd_handle(fd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+
+    struct shim_mount* fs = hdl->fs;
+    int ret;
+
+    if (!(hdl->acc_mode & MAY_READ)) {
+        ret = -EBADF;
+    } else if (hdl->type != TYPE_FILE || !fs || !fs->fs_ops || !fs->fs_ops->fadvise ||
+               offset < 0) {
+        ret = -EINVAL;
+    } else {
+        ret = fs->fs_ops->fadvise(hdl, offset, count, POSIX_FADV_WILLNEED);
+        if (ret == -ESPIPE)
+            ret = -EINVAL;
+    }
+
+    put_handle(hdl);
+    return ret;
+}
+
 
 int shim_do_truncate (const char * path, loff_t length)
 {
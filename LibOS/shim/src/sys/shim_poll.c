@@ -135,6 +135,12 @@ static int _shim_do_poll(struct pollfd* fds, nfds_t nfds, int timeout_ms) {
             continue;
         }
 
+        if (hdl->type == TYPE_MQUEUE && mqueue_watch(hdl) < 0) {
+            fds[i].revents = POLLERR;
+            nrevents++;
+            continue;
+        }
+
         get_handle(hdl);
         fds_mapping[i].hdl = hdl;
         fds_mapping[i].idx = pal_cnt;
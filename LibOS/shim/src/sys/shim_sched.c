@@ -17,6 +17,7 @@
 #include <pal.h>
 #include <shim_internal.h>
 #include <shim_table.h>
+#include <shim_thread.h>
 
 int shim_do_sched_yield(void) {
     DkThreadYieldExecution();
@@ -137,6 +138,12 @@ int shim_do_sched_rr_get_interval(pid_t pid, struct timespec* interval) {
     return 0;
 }
 
+/* CPU bitmasks are indexed by host CPU IDs, which may be sparse: size them by the highest ID */
+static int get_cpu_mask_bits(void) {
+    const PAL_CPU_INFO* ci = &PAL_CB(cpu_info);
+    return ci->cpu_id[ci->cpu_num - 1] + 1;
+}
+
 static int check_affinity_params(int ncpus, size_t len, __kernel_cpu_set_t* user_mask_ptr) {
     /* Check that user_mask_ptr is valid; if not, should return -EFAULT */
     if (test_user_memory(user_mask_ptr, len, true))
@@ -155,53 +162,102 @@ static int check_affinity_params(int ncpus, size_t len, __kernel_cpu_set_t* user
     return bitmask_size_in_bytes;
 }
 
-/* dummy implementation: ignore user-supplied mask and return success */
+/* Returns the PAL handle of thread `pid` in `*pal_thread` (NULL for the current thread). */
+static int get_pal_thread(pid_t pid, PAL_HANDLE* pal_thread) {
+    if (pid < 0)
+        return -ESRCH;
+
+    *pal_thread = NULL;
+    if (!pid || (IDTYPE)pid == get_cur_thread()->tid)
+        return 0;
+
+    /* only threads of the current process can be looked up */
+    struct shim_thread* thread = lookup_thread(pid);
+    if (!thread)
+        return -ESRCH;
+
+    *pal_thread = thread->pal_handle;
+    put_thread(thread);
+    return *pal_thread ? 0 : -ESRCH;
+}
+
 int shim_do_sched_setaffinity(pid_t pid, size_t len, __kernel_cpu_set_t* user_mask_ptr) {
-    __UNUSED(pid);
-    int ncpus = PAL_CB(cpu_info.cpu_num);
+    int ncpus = get_cpu_mask_bits();
 
     int bitmask_size_in_bytes = check_affinity_params(ncpus, len, user_mask_ptr);
     if (bitmask_size_in_bytes < 0)
         return bitmask_size_in_bytes;
 
+    /* the thread must be allowed to run on at least one CPU */
+    bool empty = true;
+    for (size_t i = 0; i < len; i++) {
+        if (((uint8_t*)user_mask_ptr)[i]) {
+            empty = false;
+            break;
+        }
+    }
+    if (empty)
+        return -EINVAL;
+
+    PAL_HANDLE pal_thread;
+    int ret = get_pal_thread(pid, &pal_thread);
+    if (ret < 0)
+        return ret;
+
+    /* PALs which cannot pin threads silently ignore the mask (as Graphene always did) */
+    if (!DkThreadSetCpuAffinity(pal_thread, len, user_mask_ptr) &&
+            PAL_NATIVE_ERRNO != PAL_ERROR_NOTIMPLEMENTED)
+        return -PAL_ERRNO;
+
     return 0;
 }
 
-/* dummy implementation: always return all-ones (as many as there are host CPUs)  */
 int shim_do_sched_getaffinity(pid_t pid, size_t len, __kernel_cpu_set_t* user_mask_ptr) {
-    __UNUSED(pid);
-    int ncpus = PAL_CB(cpu_info.cpu_num);
+    int ncpus = get_cpu_mask_bits();
 
     int bitmask_size_in_bytes = check_affinity_params(ncpus, len, user_mask_ptr);
     if (bitmask_size_in_bytes < 0)
         return bitmask_size_in_bytes;
 
-    memset(user_mask_ptr, 0, len);
-    for (int i = 0; i < ncpus; i++) {
-        ((uint8_t*)user_mask_ptr)[i / 8] |= 1 << (i % 8);
+    PAL_HANDLE pal_thread;
+    int ret = get_pal_thread(pid, &pal_thread);
+    if (ret < 0)
+        return ret;
+
+    if (!DkThreadGetCpuAffinity(pal_thread, len, user_mask_ptr)) {
+        if (PAL_NATIVE_ERRNO != PAL_ERROR_NOTIMPLEMENTED)
+            return -PAL_ERRNO;
+
+        /* PAL cannot query affinity: report all online host CPUs */
+        memset(user_mask_ptr, 0, len);
+        for (size_t i = 0; i < PAL_CB(cpu_info.cpu_num); i++) {
+            PAL_IDX cpu = PAL_CB(cpu_info.cpu_id)[i];
+            ((uint8_t*)user_mask_ptr)[cpu / 8] |= 1 << (cpu % 8);
+        }
     }
     /* imitate the Linux kernel implementation
      * See SYSCALL_DEFINE3(sched_getaffinity) */
     return bitmask_size_in_bytes;
 }
 
-/* dummy implementation: always return cpu0  */
 int shim_do_getcpu(unsigned* cpu, unsigned* node, struct getcpu_cache* unused) {
     __UNUSED(unused);
 
-    if (cpu) {
-        if (test_user_memory(cpu, sizeof(*cpu), /*write=*/true)) {
-            return -EFAULT;
-        }
-        *cpu = 0;
-    }
+    if (cpu && test_user_memory(cpu, sizeof(*cpu), /*write=*/true))
+        return -EFAULT;
 
-    if (node) {
-        if (test_user_memory(node, sizeof(*node), /*write=*/true)) {
-            return -EFAULT;
-        }
-        *node = 0;
-    }
+    if (node && test_user_memory(node, sizeof(*node), /*write=*/true))
+        return -EFAULT;
+
+    PAL_IDX pal_cpu  = 0;
+    PAL_IDX pal_node = 0;
+    /* if PAL cannot tell the current CPU, fall back to cpu0/node0 */
+    DkThreadGetCurrentCpu(&pal_cpu, &pal_node);
+
+    if (cpu)
+        *cpu = pal_cpu;
+    if (node)
+        *node = pal_node;
 
     return 0;
 }
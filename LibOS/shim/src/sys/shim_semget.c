@@ -209,6 +209,19 @@ int del_sem_handle(struct shim_sem_handle* sem) {
     return ret;
 }
 
+void release_all_sem_shared(void) {
+    if (!create_lock_runtime(&sem_list_lock))
+        return;
+
+    struct shim_sem_handle* sem;
+    lock(&sem_list_lock);
+    LISTP_FOR_EACH_ENTRY(sem, &sem_list, list) {
+        if (sem->shared)
+            sysv_shared_release(sem->shared, /*unmap=*/false);
+    }
+    unlock(&sem_list_lock);
+}
+
 int shim_do_semget(key_t key, int nsems, int semflg) {
     IDTYPE semid = 0;
     int ret;
@@ -237,20 +250,45 @@ int shim_do_semget(key_t key, int nsems, int semflg) {
                 semid = ipc_sysv_lease_send(NULL);
         } while (!semid);
 
+        /* The shared segment must be ready before other processes can learn the semid. */
+        struct sysv_shared_obj* shared = NULL;
+        if (sysv_shared_enabled()) {
+            ret = sysv_shared_sem_create(semid, nsems, &shared);
+            if (ret < 0 && ret != -ENOSYS) {
+                release_sysv(semid);
+                return ret;
+            }
+        }
+
         if (key != IPC_PRIVATE) {
             if ((ret = ipc_sysv_tellkey_send(NULL, 0, &k, semid, 0)) < 0) {
+                if (shared) {
+                    sysv_shared_sem_remove(shared);
+                    sysv_shared_detach(shared);
+                }
                 release_sysv(semid);
                 return ret;
             }
         }
 
         add_sem_handle(key, semid, nsems, true);
+
+        if (shared) {
+            struct shim_sem_handle* sem = get_sem_handle_by_id(semid);
+            if (sem) {
+                sem->shared = shared;
+                put_sem_handle(sem);
+            } else {
+                sysv_shared_release(shared, /*unmap=*/true);
+            }
+        }
     } else {
         if ((ret = ipc_sysv_findkey_send(&k)) < 0)
             return ret;
 
         semid = ret;
-        if ((ret = ipc_sysv_query_send(semid)) < 0)
+        /* With the local-first fast path, the owner is never contacted. */
+        if (!sysv_shared_enabled() && (ret = ipc_sysv_query_send(semid)) < 0)
             return ret;
     }
 
@@ -261,6 +299,45 @@ static int connect_sem_handle(int semid, int nsems, struct shim_sem_handle** sem
     struct shim_sem_handle* sem = get_sem_handle_by_id(semid);
     int ret;
 
+    if (sysv_shared_enabled()) {
+        /* Local-first: attaching to the shared segment needs no round-trip to the owner. */
+        if (sem && sem->shared) {
+            *semp = sem;
+            return 0;
+        }
+
+        struct sysv_shared_obj* shared = NULL;
+        ret = sysv_shared_sem_attach(semid, &shared);
+        if (ret >= 0) {
+            if (!sem) {
+                lock(&sem_list_lock);
+                ret = __add_sem_handle(IPC_PRIVATE, semid, nsems, false, &sem);
+                unlock(&sem_list_lock);
+                if (ret < 0)
+                    return ret;
+            }
+            struct shim_handle* hdl = SEM_TO_HANDLE(sem);
+            lock(&hdl->lock);
+            if (!sem->shared) {
+                sem->shared = shared;
+                shared = NULL;
+            }
+            unlock(&hdl->lock);
+            if (shared) {
+                /* another thread attached concurrently */
+                sysv_shared_release(shared, /*unmap=*/true);
+            }
+            *semp = sem;
+            return 0;
+        }
+
+        if (ret != -ENOSYS) {
+            if (sem)
+                put_sem_handle(sem);
+            return ret == -ENOENT ? (sem ? -EIDRM : -EINVAL) : ret;
+        }
+    }
+
     if (!sem) {
         if ((ret = ipc_sysv_query_send(semid)) < 0)
             return ret;
@@ -339,7 +416,14 @@ static int __do_semop(int semid, struct sembuf* sops, unsigned int nsops, unsign
     if ((ret = connect_sem_handle(semid, nsems, &sem)) < 0)
         return ret;
 
-    ret = submit_sysv_sem(sem, sops, nsops, timeout, NULL);
+    if (sem->shared) {
+        ret = sysv_shared_semop(sem->shared, sops, nsops, timeout);
+        /* removed by another process: drop the handle, which detaches the segment */
+        if (ret == -EIDRM)
+            del_sem_handle(sem);
+    } else {
+        ret = submit_sysv_sem(sem, sops, nsops, timeout, NULL);
+    }
     put_sem_handle(sem);
     return ret;
 }
@@ -374,6 +458,15 @@ int shim_do_semctl(int semid, int semnum, int cmd, unsigned long arg) {
 
     switch (cmd) {
         case IPC_RMID: {
+            if (sem->shared) {
+                ret = sysv_shared_sem_remove(sem->shared);
+                if (ret < 0) {
+                    if (ret == -EIDRM)
+                        __del_sem_handle(sem);
+                    goto out;
+                }
+            }
+
             if (!sem->owned) {
                 ret = ipc_sysv_delres_send(NULL, 0, semid, SYSV_SEM);
                 if (ret < 0)
@@ -385,6 +478,13 @@ int shim_do_semctl(int semid, int semnum, int cmd, unsigned long arg) {
         }
     }
 
+    if (sem->shared) {
+        ret = sysv_shared_semctl(sem->shared, semnum, cmd, arg);
+        if (ret == -EIDRM)
+            __del_sem_handle(sem);
+        goto out;
+    }
+
     if (sem->owned) {
         if (sem->deleted) {
             ret = -EIDRM;
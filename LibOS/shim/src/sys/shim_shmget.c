@@ -0,0 +1,725 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_shmget.c
+ *
+ * Implementation of system calls "shmget", "shmat", "shmdt" and "shmctl".
+ *
+ * A segment is a named shared-memory object of the PAL (`shm:` stream), so all processes of this
+ * Graphene instance share the same host memory. Keys and IDs come from the SysV namespace, the same
+ * as for semaphores and message queues. The first allocation unit of the object holds the segment
+ * attributes reported by IPC_STAT (struct shm_segment_hdr) and the segment data follows it.
+ *
+ * An attachment is a MAP_SHARED VMA backed by the segment handle, so on fork the child maps the
+ * same object again instead of receiving a copy of the memory. IPC_RMID only marks the segment with
+ * SHM_DEST and makes its key private; as on Linux, the segment can still be used by its ID until
+ * the last attachment is detached, and that detach unlinks the object.
+ *
+ * Permissions are checked as on Linux (owner, group and other bits of the segment against the
+ * effective IDs of the caller, root may do anything). `nattch` is kept in the shared header and
+ * is decremented by every process at exit or exec; a process which dies without running the exit
+ * path of the LibOS (e.g. killed by the host) leaks its attachments.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <linux/shm.h>
+
+#include "pal.h"
+#include "pal_error.h"
+#include "shim_flags_conv.h"
+#include "shim_fs.h"
+#include "shim_handle.h"
+#include "shim_internal.h"
+#include "shim_ipc.h"
+#include "shim_sysv.h"
+#include "shim_table.h"
+#include "shim_thread.h"
+#include "shim_utils.h"
+#include "shim_vma.h"
+
+#ifndef SHM_DEST
+#define SHM_DEST 01000
+#endif
+#ifndef SHM_LOCKED
+#define SHM_LOCKED 02000
+#endif
+
+/* segment data starts after the header */
+#define SHM_DATA_OFFSET ALLOC_ALIGNMENT
+
+struct shm_segment_hdr {
+    uint64_t key;
+    uint64_t size;
+    uint32_t mode; /* permission bits plus SHM_DEST and SHM_LOCKED */
+    uint32_t uid, gid, cuid, cgid;
+    IDTYPE cpid;
+    IDTYPE lpid;
+    uint64_t nattch;
+    uint64_t atime, dtime, ctime;
+};
+
+#define SHM_TO_HANDLE(shmhdl) container_of((shmhdl), struct shim_handle, info.shm)
+
+DEFINE_LISTP(shim_shm_handle);
+static LISTP_TYPE(shim_shm_handle) shm_list;
+static struct shim_lock shm_list_lock;
+
+static uint64_t shm_time(void) {
+    return DkSystemTimeQuery() / 1000000;
+}
+
+static IDTYPE shm_pid(void) {
+    return get_cur_thread()->tgid;
+}
+
+/* Checks the permission bits of the segment, like ipcperms() in Linux; `flag` is a mode mask, e.g.
+ * 0444 for read access. */
+static int shm_check_perm(struct shm_segment_hdr* hdr, int flag) {
+    struct shim_thread* cur_thread = get_cur_thread();
+    if (!cur_thread->euid)
+        return 0;
+
+    int requested = (flag >> 6 | flag >> 3 | flag) & 7;
+    int granted   = hdr->mode;
+    if (cur_thread->euid == hdr->uid || cur_thread->euid == hdr->cuid)
+        granted >>= 6;
+    else if (cur_thread->egid == hdr->gid || cur_thread->egid == hdr->cgid)
+        granted >>= 3;
+    return requested & ~granted & 7 ? -EACCES : 0;
+}
+
+/* Only the owner, the creator and root may change or remove a segment. */
+static bool shm_is_owner(struct shm_segment_hdr* hdr) {
+    struct shim_thread* cur_thread = get_cur_thread();
+    return !cur_thread->euid || cur_thread->euid == hdr->uid || cur_thread->euid == hdr->cuid;
+}
+
+static bool shm_destroyed(struct shm_segment_hdr* hdr) {
+    return (__atomic_load_n(&hdr->mode, __ATOMIC_SEQ_CST) & SHM_DEST) &&
+           !__atomic_load_n(&hdr->nattch, __ATOMIC_SEQ_CST);
+}
+
+/* Drops `count` attachments; the last detach of a removed segment unlinks it. */
+static void shm_detach(struct shim_handle* hdl, uint64_t count) {
+    struct shm_segment_hdr* hdr = hdl->info.shm.hdr;
+    if (!__atomic_sub_fetch(&hdr->nattch, count, __ATOMIC_SEQ_CST) &&
+            (__atomic_load_n(&hdr->mode, __ATOMIC_SEQ_CST) & SHM_DEST))
+        DkStreamDelete(hdl->pal_handle, 0);
+}
+
+/* Maps the header of the segment into this process, if not mapped yet. */
+static int shm_map_hdr(struct shim_handle* hdl) {
+    struct shim_shm_handle* shm = &hdl->info.shm;
+    int ret = 0;
+
+    lock(&hdl->lock);
+    if (shm->hdr)
+        goto out;
+
+    void* addr;
+    ret = bkeep_mmap_any(SHM_DATA_OFFSET, PROT_READ | PROT_WRITE, MAP_SHARED | VMA_INTERNAL, NULL,
+                         0, "shm", &addr);
+    if (ret < 0)
+        goto out;
+
+    if (DkStreamMap(hdl->pal_handle, addr, PAL_PROT_READ | PAL_PROT_WRITE, 0, SHM_DATA_OFFSET)
+            != addr) {
+        ret = -PAL_ERRNO;
+        void* tmp_vma = NULL;
+        if (bkeep_munmap(addr, SHM_DATA_OFFSET, /*is_internal=*/true, &tmp_vma) < 0)
+            BUG();
+        bkeep_remove_tmp_vma(tmp_vma);
+        goto out;
+    }
+
+    shm->hdr = addr;
+out:
+    unlock(&hdl->lock);
+    return ret;
+}
+
+static int shm_mmap(struct shim_handle* hdl, void** addr, size_t size, int prot, int flags,
+                    off_t offset) {
+    void* alloc_addr = (void*)DkStreamMap(hdl->pal_handle, *addr, LINUX_PROT_TO_PAL(prot, flags),
+                                          offset, size);
+    if (!alloc_addr)
+        return -PAL_ERRNO;
+
+    *addr = alloc_addr;
+    return 0;
+}
+
+static int shm_close(struct shim_handle* hdl) {
+    struct shim_shm_handle* shm = &hdl->info.shm;
+    if (!shm->hdr)
+        return 0;
+
+    void* tmp_vma = NULL;
+    if (bkeep_munmap(shm->hdr, SHM_DATA_OFFSET, /*is_internal=*/true, &tmp_vma) < 0)
+        BUG();
+    DkStreamUnmap(shm->hdr, SHM_DATA_OFFSET);
+    bkeep_remove_tmp_vma(tmp_vma);
+    shm->hdr = NULL;
+    return 0;
+}
+
+/* `hdl` is the copy of the handle sent to the child, which inherits all attachments. */
+static int shm_checkout(struct shim_handle* hdl) {
+    struct shim_shm_handle* shm = &hdl->info.shm;
+    if (shm->hdr && shm->nattach)
+        __atomic_add_fetch(&shm->hdr->nattch, shm->nattach, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static int shm_checkin(struct shim_handle* hdl) {
+    struct shim_shm_handle* shm = &hdl->info.shm;
+
+    /* the header mapping is internal memory of the parent */
+    shm->hdr = NULL;
+
+    if (!create_lock_runtime(&shm_list_lock))
+        return -ENOMEM;
+
+    get_handle(hdl);
+    lock(&shm_list_lock);
+    INIT_LIST_HEAD(shm, list);
+    LISTP_ADD_TAIL(shm, &shm_list, list);
+    unlock(&shm_list_lock);
+    return 0;
+}
+
+struct shim_fs_ops shm_fs_ops = {
+    .mmap     = &shm_mmap,
+    .close    = &shm_close,
+    .checkout = &shm_checkout,
+    .checkin  = &shm_checkin,
+};
+
+struct shim_mount shm_builtin_fs = {
+    .type   = "shm",
+    .fs_ops = &shm_fs_ops,
+};
+
+static struct shim_handle* __get_shm_handle_by_key(unsigned long key) {
+    assert(locked(&shm_list_lock));
+
+    struct shim_shm_handle* shm;
+    LISTP_FOR_EACH_ENTRY(shm, &shm_list, list) {
+        if (shm->shmkey == key) {
+            get_handle(SHM_TO_HANDLE(shm));
+            return SHM_TO_HANDLE(shm);
+        }
+    }
+    return NULL;
+}
+
+static struct shim_handle* __get_shm_handle_by_id(IDTYPE shmid) {
+    assert(locked(&shm_list_lock));
+
+    struct shim_shm_handle* shm;
+    LISTP_FOR_EACH_ENTRY(shm, &shm_list, list) {
+        if (shm->shmid == shmid) {
+            get_handle(SHM_TO_HANDLE(shm));
+            return SHM_TO_HANDLE(shm);
+        }
+    }
+    return NULL;
+}
+
+/* Opens (or creates, if `create_size` is not zero) the segment `shmid` and adds it to shm_list. */
+static int open_shm_handle(unsigned long key, IDTYPE shmid, size_t create_size, int shmflg,
+                           struct shim_handle** hdlp) {
+    char uri[SYSV_SHARED_URI_SIZE];
+    sysv_shared_obj_uri(uri, sizeof(uri), "shm", shmid);
+
+    struct shim_handle* hdl = get_new_handle();
+    if (!hdl)
+        return -ENOMEM;
+
+    hdl->type = TYPE_SHM;
+    set_handle_fs(hdl, &shm_builtin_fs);
+    hdl->flags    = O_RDWR;
+    hdl->acc_mode = MAY_READ | MAY_WRITE;
+    qstrsetstr(&hdl->uri, uri, strlen(uri));
+
+    int ret;
+    hdl->pal_handle = DkStreamOpen(uri, PAL_ACCESS_RDWR, PAL_SHARE_OWNER_R | PAL_SHARE_OWNER_W,
+                                   create_size ? PAL_CREATE_ALWAYS : 0, 0);
+    if (!hdl->pal_handle) {
+        ret = -PAL_ERRNO;
+        goto out;
+    }
+
+    if (create_size) {
+        size_t len = SHM_DATA_OFFSET + ALLOC_ALIGN_UP(create_size);
+        PAL_NUM pal_ret = DkStreamSetLength(hdl->pal_handle, len);
+        if (pal_ret) {
+            ret = -convert_pal_errno(pal_ret);
+            goto out_delete;
+        }
+    }
+
+    if ((ret = shm_map_hdr(hdl)) < 0)
+        goto out_delete;
+
+    struct shim_shm_handle* shm = &hdl->info.shm;
+    struct shm_segment_hdr* hdr = shm->hdr;
+    if (create_size) {
+        struct shim_thread* cur_thread = get_cur_thread();
+        hdr->key   = key;
+        hdr->size  = create_size;
+        hdr->mode  = shmflg & 0777;
+        hdr->uid   = hdr->cuid = cur_thread->euid;
+        hdr->gid   = hdr->cgid = cur_thread->egid;
+        hdr->cpid  = shm_pid();
+        hdr->ctime = shm_time();
+    } else if (!hdr->size) {
+        /* the creator did not finish initializing the segment */
+        ret = -EIDRM;
+        goto out;
+    }
+
+    shm->shmkey = hdr->key;
+    shm->shmid  = shmid;
+    shm->size   = hdr->size;
+
+    lock(&shm_list_lock);
+    struct shim_handle* old = __get_shm_handle_by_id(shmid);
+    if (old) {
+        /* another thread opened it concurrently */
+        unlock(&shm_list_lock);
+        put_handle(hdl);
+        *hdlp = old;
+        return 0;
+    }
+    get_handle(hdl);
+    INIT_LIST_HEAD(shm, list);
+    LISTP_ADD_TAIL(shm, &shm_list, list);
+    unlock(&shm_list_lock);
+
+    *hdlp = hdl;
+    return 0;
+
+out_delete:
+    if (create_size)
+        DkStreamDelete(hdl->pal_handle, 0);
+out:
+    put_handle(hdl);
+    return ret;
+}
+
+static void shm_list_del(struct shim_handle* hdl) {
+    struct shim_shm_handle* shm = &hdl->info.shm;
+
+    lock(&shm_list_lock);
+    bool listed = !LIST_EMPTY(shm, list);
+    if (listed)
+        LISTP_DEL_INIT(shm, &shm_list, list);
+    unlock(&shm_list_lock);
+
+    if (listed)
+        put_handle(hdl);
+}
+
+static int get_shm_handle(IDTYPE shmid, struct shim_handle** hdlp) {
+    if (!create_lock_runtime(&shm_list_lock))
+        return -ENOMEM;
+
+    lock(&shm_list_lock);
+    struct shim_handle* hdl = __get_shm_handle_by_id(shmid);
+    unlock(&shm_list_lock);
+
+    if (hdl) {
+        int ret = shm_map_hdr(hdl);
+        if (ret < 0) {
+            put_handle(hdl);
+            return ret;
+        }
+        if (shm_destroyed(hdl->info.shm.hdr)) {
+            /* the last attachment was detached by another process */
+            shm_list_del(hdl);
+            put_handle(hdl);
+            return -EINVAL;
+        }
+        *hdlp = hdl;
+        return 0;
+    }
+
+    int ret = open_shm_handle(IPC_PRIVATE, shmid, 0, 0, hdlp);
+    return ret == -ENOENT ? -EINVAL : ret;
+}
+
+static int shm_remove(struct shim_handle* hdl) {
+    struct shim_shm_handle* shm = &hdl->info.shm;
+
+    /* the segment can still be used by its ID, but not found by its key */
+    lock(&shm_list_lock);
+    shm->shmkey = IPC_PRIVATE;
+    unlock(&shm_list_lock);
+
+    shm->hdr->key   = IPC_PRIVATE;
+    shm->hdr->ctime = shm_time();
+    __atomic_or_fetch(&shm->hdr->mode, SHM_DEST, __ATOMIC_SEQ_CST);
+
+    /* otherwise, the last shmdt() unlinks the segment */
+    if (!__atomic_load_n(&shm->hdr->nattch, __ATOMIC_SEQ_CST)) {
+        DkStreamDelete(hdl->pal_handle, 0);
+        shm_list_del(hdl);
+    }
+    return 0;
+}
+
+int shim_do_shmget(key_t key, size_t size, int shmflg) {
+    struct shim_handle* hdl = NULL;
+    int ret;
+
+    if (!create_lock_runtime(&shm_list_lock))
+        return -ENOMEM;
+
+    if (key != IPC_PRIVATE) {
+        lock(&shm_list_lock);
+        hdl = __get_shm_handle_by_key(key);
+        unlock(&shm_list_lock);
+
+        if (hdl && (shm_map_hdr(hdl) < 0 || (hdl->info.shm.hdr->mode & SHM_DEST))) {
+            /* removed by another process, the key may have been reused */
+            put_handle(hdl);
+            hdl = NULL;
+        }
+
+        if (!hdl) {
+            struct sysv_key k;
+            k.key  = key;
+            k.type = SYSV_SHM;
+
+            ret = ipc_sysv_findkey_send(&k);
+            if (ret >= 0) {
+                ret = open_shm_handle(key, ret, 0, 0, &hdl);
+                /* a removed segment, the key is free to be used again */
+                if (ret == -ENOENT || ret == -EIDRM) {
+                    hdl = NULL;
+                } else if (ret < 0) {
+                    return ret;
+                } else if (hdl->info.shm.hdr->mode & SHM_DEST) {
+                    put_handle(hdl);
+                    hdl = NULL;
+                }
+            } else if (ret != -ENOENT) {
+                return ret;
+            }
+        }
+
+        if (hdl) {
+            IDTYPE shmid = hdl->info.shm.shmid;
+            if ((shmflg & (IPC_CREAT | IPC_EXCL)) == (IPC_CREAT | IPC_EXCL)) {
+                ret = -EEXIST;
+            } else {
+                ret = shm_check_perm(hdl->info.shm.hdr, shmflg & 0777);
+                if (!ret)
+                    ret = size > hdl->info.shm.size ? -EINVAL : (int)shmid;
+            }
+            put_handle(hdl);
+            return ret;
+        }
+
+        if (!(shmflg & IPC_CREAT))
+            return -ENOENT;
+    }
+
+    if (size < SHMMIN || size > SHMMAX)
+        return -EINVAL;
+
+    IDTYPE shmid;
+    do {
+        shmid = allocate_sysv(0, 0);
+        if (!shmid)
+            shmid = ipc_sysv_lease_send(NULL);
+    } while (!shmid);
+
+    /* The segment must be ready before other processes can learn the shmid. */
+    ret = open_shm_handle(key, shmid, size, shmflg, &hdl);
+    if (ret < 0) {
+        release_sysv(shmid);
+        return ret;
+    }
+
+    if (key != IPC_PRIVATE) {
+        struct sysv_key k;
+        k.key  = key;
+        k.type = SYSV_SHM;
+
+        if ((ret = ipc_sysv_tellkey_send(NULL, 0, &k, shmid, 0)) < 0) {
+            shm_remove(hdl);
+            put_handle(hdl);
+            release_sysv(shmid);
+            return ret;
+        }
+    }
+
+    put_handle(hdl);
+    return shmid;
+}
+
+void* shim_do_shmat(int shmid, const void* shmaddr, int shmflg) {
+    struct shim_handle* hdl;
+    int ret = get_shm_handle(shmid, &hdl);
+    if (ret < 0)
+        return (void*)(long)ret;
+
+    struct shim_shm_handle* shm = &hdl->info.shm;
+    size_t size = ALLOC_ALIGN_UP(shm->size);
+    int prot = PROT_READ;
+    int acc  = 0444;
+    if (!(shmflg & SHM_RDONLY)) {
+        prot |= PROT_WRITE;
+        acc  |= 0222;
+    }
+    if (shmflg & SHM_EXEC) {
+        prot |= PROT_EXEC;
+        acc  |= 0111;
+    }
+
+    if ((ret = shm_check_perm(shm->hdr, acc)) < 0)
+        goto out;
+
+    void* addr = (void*)shmaddr;
+    if (addr) {
+        if (shmflg & SHM_RND) {
+            addr = ALLOC_ALIGN_DOWN_PTR(addr);
+        } else if (!IS_ALLOC_ALIGNED_PTR(addr)) {
+            ret = -EINVAL;
+            goto out;
+        }
+
+        if (!access_ok(addr, size) || addr < PAL_CB(user_address.start) ||
+                (uintptr_t)PAL_CB(user_address.end) < (uintptr_t)addr + size) {
+            ret = -EINVAL;
+            goto out;
+        }
+
+        if (shmflg & SHM_REMAP)
+            sync_shared_mmaps(addr, size, /*remove=*/true);
+        ret = bkeep_mmap_fixed(addr, size, prot,
+                               MAP_SHARED | (shmflg & SHM_REMAP ? MAP_FIXED : MAP_FIXED_NOREPLACE),
+                               hdl, SHM_DATA_OFFSET, NULL);
+        if (ret < 0) {
+            /* overlapping an existing mapping without SHM_REMAP */
+            ret = ret == -EEXIST ? -EINVAL : ret;
+            goto out;
+        }
+    } else {
+        if (shmflg & SHM_REMAP) {
+            ret = -EINVAL;
+            goto out;
+        }
+        ret = bkeep_mmap_any_aslr(size, prot, MAP_SHARED, hdl, SHM_DATA_OFFSET, NULL, &addr);
+        if (ret < 0) {
+            ret = -ENOMEM;
+            goto out;
+        }
+    }
+
+    ret = shm_mmap(hdl, &addr, size, prot, MAP_SHARED, SHM_DATA_OFFSET);
+    if (ret < 0) {
+        void* tmp_vma = NULL;
+        if (bkeep_munmap(addr, size, /*is_internal=*/false, &tmp_vma) < 0)
+            BUG();
+        bkeep_remove_tmp_vma(tmp_vma);
+        goto out;
+    }
+
+    lock(&hdl->lock);
+    shm->nattach++;
+    unlock(&hdl->lock);
+
+    __atomic_add_fetch(&shm->hdr->nattch, 1, __ATOMIC_SEQ_CST);
+    shm->hdr->lpid  = shm_pid();
+    shm->hdr->atime = shm_time();
+out:
+    put_handle(hdl);
+    return ret < 0 ? (void*)(long)ret : addr;
+}
+
+int shim_do_shmdt(const void* shmaddr) {
+    if (!IS_ALLOC_ALIGNED_PTR(shmaddr))
+        return -EINVAL;
+
+    struct shim_vma_info vma_info;
+    if (lookup_vma((void*)shmaddr, &vma_info) < 0)
+        return -EINVAL;
+
+    struct shim_handle* hdl = vma_info.file;
+    int ret = -EINVAL;
+    if (!hdl || hdl->type != TYPE_SHM || vma_info.addr != shmaddr ||
+            vma_info.file_offset != (off_t)SHM_DATA_OFFSET)
+        goto out;
+
+    struct shim_shm_handle* shm = &hdl->info.shm;
+    size_t size = ALLOC_ALIGN_UP(shm->size);
+
+    void* tmp_vma = NULL;
+    if ((ret = bkeep_munmap((void*)shmaddr, size, /*is_internal=*/false, &tmp_vma)) < 0)
+        goto out;
+    DkStreamUnmap((void*)shmaddr, size);
+    bkeep_remove_tmp_vma(tmp_vma);
+
+    lock(&hdl->lock);
+    bool counted = shm->nattach > 0;
+    if (counted)
+        shm->nattach--;
+    unlock(&hdl->lock);
+
+    if (shm_map_hdr(hdl) == 0) {
+        shm->hdr->lpid  = shm_pid();
+        shm->hdr->dtime = shm_time();
+        if (counted)
+            shm_detach(hdl, 1);
+    }
+    ret = 0;
+out:
+    if (hdl)
+        put_handle(hdl);
+    return ret;
+}
+
+static int shm_stat(struct shim_shm_handle* shm, struct shmid64_ds* buf) {
+    if (test_user_memory(buf, sizeof(*buf), /*write=*/true))
+        return -EFAULT;
+
+    struct shm_segment_hdr* hdr = shm->hdr;
+    memset(buf, 0, sizeof(*buf));
+    buf->shm_perm.key  = hdr->key;
+    buf->shm_perm.uid  = hdr->uid;
+    buf->shm_perm.gid  = hdr->gid;
+    buf->shm_perm.cuid = hdr->cuid;
+    buf->shm_perm.cgid = hdr->cgid;
+    buf->shm_perm.mode = hdr->mode;
+    buf->shm_segsz     = hdr->size;
+    buf->shm_atime     = hdr->atime;
+    buf->shm_dtime     = hdr->dtime;
+    buf->shm_ctime     = hdr->ctime;
+    buf->shm_cpid      = hdr->cpid;
+    buf->shm_lpid      = hdr->lpid;
+    buf->shm_nattch    = __atomic_load_n(&hdr->nattch, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int shim_do_shmctl(int shmid, int cmd, struct shmid_ds* buf) {
+    cmd &= ~IPC_64;
+
+    switch (cmd) {
+        case IPC_INFO: {
+            struct shminfo64* info = (struct shminfo64*)buf;
+            if (test_user_memory(info, sizeof(*info), /*write=*/true))
+                return -EFAULT;
+            memset(info, 0, sizeof(*info));
+            info->shmmax = SHMMAX;
+            info->shmmin = SHMMIN;
+            info->shmmni = SHMMNI;
+            info->shmseg = SHMSEG;
+            info->shmall = SHMALL;
+            return 0;
+        }
+
+        case SHM_INFO: {
+            struct shm_info* info = (struct shm_info*)buf;
+            if (test_user_memory(info, sizeof(*info), /*write=*/true))
+                return -EFAULT;
+            memset(info, 0, sizeof(*info));
+
+            if (!create_lock_runtime(&shm_list_lock))
+                return -ENOMEM;
+
+            /* only the segments known to this process */
+            struct shim_shm_handle* shm;
+            lock(&shm_list_lock);
+            LISTP_FOR_EACH_ENTRY(shm, &shm_list, list) {
+                info->used_ids++;
+                info->shm_tot += ALLOC_ALIGN_UP(shm->size) / ALLOC_ALIGNMENT;
+            }
+            unlock(&shm_list_lock);
+            return 0;
+        }
+    }
+
+    struct shim_handle* hdl;
+    int ret = get_shm_handle(shmid, &hdl);
+    if (ret < 0)
+        return ret;
+
+    struct shim_shm_handle* shm = &hdl->info.shm;
+    struct shm_segment_hdr* hdr = shm->hdr;
+
+    switch (cmd) {
+        case IPC_STAT:
+        case SHM_STAT:
+        case SHM_STAT_ANY:
+            if (cmd != SHM_STAT_ANY && (ret = shm_check_perm(hdr, 0444)) < 0)
+                break;
+            ret = shm_stat(shm, (struct shmid64_ds*)buf);
+            if (!ret && cmd != IPC_STAT)
+                ret = shmid;
+            break;
+
+        case IPC_SET: {
+            if (!shm_is_owner(hdr)) {
+                ret = -EPERM;
+                break;
+            }
+            struct shmid64_ds* ds = (struct shmid64_ds*)buf;
+            if (test_user_memory(ds, sizeof(*ds), /*write=*/false)) {
+                ret = -EFAULT;
+                break;
+            }
+            hdr->uid   = ds->shm_perm.uid;
+            hdr->gid   = ds->shm_perm.gid;
+            hdr->mode  = (hdr->mode & ~0777) | (ds->shm_perm.mode & 0777);
+            hdr->ctime = shm_time();
+            break;
+        }
+
+        case IPC_RMID:
+            ret = shm_is_owner(hdr) ? shm_remove(hdl) : -EPERM;
+            break;
+
+        case SHM_LOCK:
+            /* segments are never swapped out by Graphene itself */
+            if (!shm_is_owner(hdr))
+                ret = -EPERM;
+            else
+                __atomic_or_fetch(&hdr->mode, SHM_LOCKED, __ATOMIC_SEQ_CST);
+            break;
+
+        case SHM_UNLOCK:
+            if (!shm_is_owner(hdr))
+                ret = -EPERM;
+            else
+                __atomic_and_fetch(&hdr->mode, ~SHM_LOCKED, __ATOMIC_SEQ_CST);
+            break;
+
+        default:
+            ret = -EINVAL;
+            break;
+    }
+
+    put_handle(hdl);
+    return ret;
+}
+
+void detach_all_shm(void) {
+    if (!create_lock_runtime(&shm_list_lock))
+        return;
+
+    struct shim_shm_handle* shm;
+    lock(&shm_list_lock);
+    LISTP_FOR_EACH_ENTRY(shm, &shm_list, list) {
+        if (!shm->nattach)
+            continue;
+        /* attachments inherited from the parent are counted, but the header may be unmapped */
+        if (shm_map_hdr(SHM_TO_HANDLE(shm)) == 0)
+            shm_detach(SHM_TO_HANDLE(shm), shm->nattach);
+        shm->nattach = 0;
+    }
+    unlock(&shm_list_lock);
+}
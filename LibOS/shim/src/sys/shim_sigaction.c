@@ -5,7 +5,7 @@
  * shim_sigaction.c
  *
  * Implementation of system call "sigaction", "sigreturn", "sigprocmask",
- * "kill", "tkill" and "tgkill".
+ * "rt_sigtimedwait", "kill", "tkill" and "tgkill".
  */
 
 #include <errno.h>
@@ -21,6 +21,7 @@
 #include "shim_ipc.h"
 #include "shim_table.h"
 #include "shim_thread.h"
+#include "shim_timer.h"
 #include "shim_utils.h"
 
 int shim_do_sigaction(int signum, const struct __kernel_sigaction* act,
@@ -206,6 +207,90 @@ int shim_do_sigpending(__sigset_t* set, size_t sigsetsize) {
     return 0;
 }
 
+int shim_do_sigtimedwait(const __sigset_t* uthese, siginfo_t* uinfo, const struct timespec* uts,
+                         size_t sigsetsize) {
+    if (sigsetsize != sizeof(*uthese))
+        return -EINVAL;
+
+    if (!uthese || test_user_memory((void*)uthese, sizeof(*uthese), false))
+        return -EFAULT;
+    if (uinfo && test_user_memory(uinfo, sizeof(*uinfo), true))
+        return -EFAULT;
+    if (uts && test_user_memory((void*)uts, sizeof(*uts), false))
+        return -EFAULT;
+
+    uint64_t deadline = NO_TIMEOUT;
+    if (uts) {
+        struct __kernel_timespec timeout = {.tv_sec = uts->tv_sec, .tv_nsec = uts->tv_nsec};
+        if (!timer_timespec_valid(&timeout))
+            return -EINVAL;
+
+        uint64_t now = DkSystemTimeQuery();
+        if ((int64_t)now < 0)
+            return -PAL_ERRNO;
+        deadline = timer_deadline(now, timer_timespec_to_us(&timeout));
+    }
+
+    __sigset_t these = *uthese;
+    __sigdelset(&these, SIGKILL);
+    __sigdelset(&these, SIGSTOP);
+
+    struct shim_thread* cur = get_cur_thread();
+    siginfo_t info;
+
+    int ret = pop_pending_signal(cur, &these, &info);
+    if (ret)
+        goto out;
+
+    /* Signals in `these` are usually blocked, so the senders would not wake us up unless they
+     * know that we wait for them. Unblocked signals are handled as usual and interrupt the wait. */
+    __atomic_store_n(&cur->signal_handled, false, __ATOMIC_RELEASE);
+    lock(&cur->lock);
+    cur->signal_waited = these;
+    unlock(&cur->lock);
+
+    while (true) {
+        thread_setwait(NULL, NULL);
+
+        ret = pop_pending_signal(cur, &these, &info);
+        if (ret)
+            break;
+
+        if (__atomic_load_n(&cur->signal_handled, __ATOMIC_ACQUIRE)) {
+            ret = -EINTR;
+            break;
+        }
+
+        uint64_t timeout_us = NO_TIMEOUT;
+        if (deadline != NO_TIMEOUT) {
+            uint64_t now = DkSystemTimeQuery();
+            if ((int64_t)now < 0) {
+                ret = -PAL_ERRNO;
+                break;
+            }
+            if (now >= deadline) {
+                ret = -EAGAIN;
+                break;
+            }
+            timeout_us = deadline - now;
+        }
+
+        /* timeouts are checked above, interruptions by the signal handlers in the next round */
+        ret = thread_sleep(timeout_us);
+        if (ret < 0 && ret != -EAGAIN && ret != -EINTR)
+            break;
+    }
+
+    lock(&cur->lock);
+    __sigemptyset(&cur->signal_waited);
+    unlock(&cur->lock);
+
+out:
+    if (ret > 0 && uinfo)
+        memcpy(uinfo, &info, sizeof(info));
+    return ret;
+}
+
 enum signal_thread_arg_type {
     TGID = 1,
     PGID,
@@ -216,6 +301,7 @@ struct signal_thread_arg {
     IDTYPE sender;
     IDTYPE cmp_val;
     enum signal_thread_arg_type cmp_type;
+    siginfo_t* info;  /* optional; if NULL, built from `sig` and `sender` */
     bool sent;
 };
 
@@ -258,13 +344,14 @@ static int _signal_one_thread(struct shim_thread* thread, void* _arg) {
             .si_signo = arg->sig,
             .si_pid   = arg->sender,
         };
-        ret = append_signal(NULL, &info);
+        ret = append_signal(NULL, arg->info ?: &info);
         if (ret < 0) {
             goto out;
         }
         arg->sent = true;
     }
-    if (arg->sent && !__sigismember(&thread->signal_mask, arg->sig)) {
+    if (arg->sent && (!__sigismember(&thread->signal_mask, arg->sig)
+                      || __sigismember(&thread->signal_waited, arg->sig))) {
         if (thread == get_cur_thread()) {
             /* We are ending this walk anyway, lets reuse sent field to mark that current thread
              * needs to handle a signal. */
@@ -281,7 +368,7 @@ out:
     return ret;
 }
 
-int do_kill_proc(IDTYPE sender, IDTYPE tgid, int sig, bool use_ipc) {
+static int kill_proc(IDTYPE sender, IDTYPE tgid, int sig, siginfo_t* info, bool use_ipc) {
     /* This might be called by an internal thread (like IPC), so we cannot inspect `cur_thread` ids
      * to check whether `sig` is targetted at it, but need to do a full search. */
     struct signal_thread_arg arg = {
@@ -289,6 +376,7 @@ int do_kill_proc(IDTYPE sender, IDTYPE tgid, int sig, bool use_ipc) {
         .sender = sender,
         .cmp_val = tgid,
         .cmp_type = TGID,
+        .info = info,
         .sent = false,
     };
     int ret = walk_thread_list(_signal_one_thread, &arg, /*one_shot=*/true);
@@ -318,6 +406,14 @@ int do_kill_proc(IDTYPE sender, IDTYPE tgid, int sig, bool use_ipc) {
     return -ESRCH;
 }
 
+int do_kill_proc(IDTYPE sender, IDTYPE tgid, int sig, bool use_ipc) {
+    return kill_proc(sender, tgid, sig, /*info=*/NULL, use_ipc);
+}
+
+int do_kill_proc_info(IDTYPE tgid, siginfo_t* info) {
+    return kill_proc(info->si_pid, tgid, info->si_signo, info, /*use_ipc=*/false);
+}
+
 int do_kill_pgroup(IDTYPE sender, IDTYPE pgid, int sig, bool use_ipc) {
     struct shim_thread* cur = get_cur_thread();
     int ret = 0;
@@ -388,7 +484,8 @@ int shim_do_kill(pid_t pid, int sig) {
     }
 }
 
-int do_kill_thread(IDTYPE sender, IDTYPE tgid, IDTYPE tid, int sig, bool use_ipc) {
+static int kill_thread(IDTYPE sender, IDTYPE tgid, IDTYPE tid, int sig, siginfo_t* info,
+                       bool use_ipc) {
     if (sig < 0 || sig > NUM_SIGS)
         return -EINVAL;
 
@@ -407,11 +504,11 @@ int do_kill_thread(IDTYPE sender, IDTYPE tgid, IDTYPE tid, int sig, bool use_ipc
                     return 0;
                 }
 
-                siginfo_t info = {
+                siginfo_t default_info = {
                     .si_signo = sig,
                     .si_pid   = sender,
                 };
-                ret = append_signal(thread, &info);
+                ret = append_signal(thread, info ?: &default_info);
                 if (ret >= 0) {
                     thread_wakeup(thread);
                     DkThreadResume(thread->pal_handle);
@@ -433,6 +530,14 @@ int do_kill_thread(IDTYPE sender, IDTYPE tgid, IDTYPE tid, int sig, bool use_ipc
     return ipc_pid_kill_send(sender, tid, KILL_THREAD, sig);
 }
 
+int do_kill_thread(IDTYPE sender, IDTYPE tgid, IDTYPE tid, int sig, bool use_ipc) {
+    return kill_thread(sender, tgid, tid, sig, /*info=*/NULL, use_ipc);
+}
+
+int do_kill_thread_info(IDTYPE tgid, IDTYPE tid, siginfo_t* info) {
+    return kill_thread(info->si_pid, tgid, tid, info->si_signo, info, /*use_ipc=*/false);
+}
+
 int shim_do_tkill(pid_t tid, int sig) {
     if (tid <= 0)
         return -EINVAL;
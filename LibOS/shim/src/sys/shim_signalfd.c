@@ -0,0 +1,360 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_signalfd.c
+ *
+ * Implementation of system calls "signalfd" and "signalfd4".
+ *
+ * A signalfd does not keep any signals itself: read() dequeues the signals in its mask directly
+ * from the signal queues of the calling thread and of the process (see bookkeep/shim_signal.c).
+ * Readiness for poll() and epoll is reported by an internal PAL eventfd, which signalfd_notify()
+ * makes readable whenever a signal in the mask is queued. The signal may be queued for another
+ * thread or consumed by a signal handler before the signalfd is read, so the readiness may be
+ * spurious (read() then fails with EAGAIN), but it is never lost.
+ */
+
+#include <linux/signalfd.h>
+
+#include <pal.h>
+#include <pal_error.h>
+#include <shim_fs.h>
+#include <shim_handle.h>
+#include <shim_internal.h>
+#include <shim_signal.h>
+#include <shim_table.h>
+#include <shim_thread.h>
+#include <shim_utils.h>
+
+#define SIGNALFD_TO_HANDLE(sfd) container_of((sfd), struct shim_handle, info.signalfd)
+
+DEFINE_LISTP(shim_signalfd_handle);
+static LISTP_TYPE(shim_signalfd_handle) signalfd_list;
+static struct shim_lock signalfd_list_lock;
+/* number of signalfds on signalfd_list, lets signal delivery skip the list when there are none */
+static uint64_t signalfd_cnt = 0;
+/* a signal was queued while the current thread held signalfd_list_lock (see signalfd_notify()) */
+static bool signalfd_notify_missed = false;
+
+/* Makes the PAL eventfd readable, unless it already is. Does not take any lock. */
+static void signalfd_arm(struct shim_signalfd_handle* sfd) {
+    if (__atomic_exchange_n(&sfd->ready, true, __ATOMIC_ACQ_REL))
+        return;
+
+    uint64_t one = 1;
+    if (DkStreamWrite(SIGNALFD_TO_HANDLE(sfd)->pal_handle, 0, sizeof(one), &one, NULL)
+            == PAL_STREAM_ERROR)
+        debug("signalfd: cannot signal readiness (%ld)\n", PAL_ERRNO);
+}
+
+/* Drains the PAL eventfd. Must be followed by a check for pending signals, which re-arms it. */
+static void signalfd_disarm(struct shim_signalfd_handle* sfd) {
+    uint64_t cnt;
+    /* the PAL eventfd is non-blocking, an error means that it was not readable */
+    DkStreamRead(SIGNALFD_TO_HANDLE(sfd)->pal_handle, 0, sizeof(cnt), &cnt, NULL, 0);
+    __atomic_store_n(&sfd->ready, false, __ATOMIC_RELEASE);
+}
+
+static bool signalfd_pending(struct shim_thread* thread, const __sigset_t* mask) {
+    __sigset_t pending;
+    get_pending_signals(thread, &pending);
+    for (size_t i = 0; i < ARRAY_SIZE(pending.__val); i++)
+        if (pending.__val[i] & mask->__val[i])
+            return true;
+    return false;
+}
+
+/* must be called with signalfd_list_lock held; `sig` == 0 arms all signalfds */
+static void __signalfd_notify(int sig) {
+    struct shim_signalfd_handle* sfd;
+    LISTP_FOR_EACH_ENTRY(sfd, &signalfd_list, list) {
+        if (!sig || __sigismember(&sfd->mask, sig))
+            signalfd_arm(sfd);
+    }
+}
+
+static void signalfd_list_unlock(void) {
+    while (true) {
+        unlock(&signalfd_list_lock);
+        if (!__atomic_exchange_n(&signalfd_notify_missed, false, __ATOMIC_ACQ_REL))
+            break;
+        /* we do not know which signal it was */
+        lock(&signalfd_list_lock);
+        __signalfd_notify(0);
+    }
+}
+
+void signalfd_notify(int sig) {
+    if (!__atomic_load_n(&signalfd_cnt, __ATOMIC_ACQUIRE))
+        return;
+
+    /* Signals from the host are queued in signal context, which may have interrupted this thread
+     * while it was holding signalfd_list_lock. The holder then does the notification when it
+     * releases the lock. */
+    if (lock_enabled && locked(&signalfd_list_lock)) {
+        __atomic_store_n(&signalfd_notify_missed, true, __ATOMIC_RELEASE);
+        return;
+    }
+
+    lock(&signalfd_list_lock);
+    __signalfd_notify(sig);
+    signalfd_list_unlock();
+}
+
+static int signalfd_add(struct shim_handle* hdl) {
+    if (!create_lock_runtime(&signalfd_list_lock))
+        return -ENOMEM;
+
+    struct shim_signalfd_handle* sfd = &hdl->info.signalfd;
+    lock(&signalfd_list_lock);
+    LISTP_ADD_TAIL(sfd, &signalfd_list, list);
+    __atomic_add_fetch(&signalfd_cnt, 1, __ATOMIC_RELEASE);
+    signalfd_list_unlock();
+    return 0;
+}
+
+static void signalfd_fill(struct signalfd_siginfo* ssi, const siginfo_t* info) {
+    memset(ssi, 0, sizeof(*ssi));
+    ssi->ssi_signo = info->si_signo;
+    ssi->ssi_errno = info->si_errno;
+    ssi->ssi_code  = info->si_code;
+
+    switch (info->si_signo) {
+        case SIGCHLD:
+            ssi->ssi_pid    = info->si_pid;
+            ssi->ssi_uid    = info->si_uid;
+            ssi->ssi_status = info->si_status;
+            ssi->ssi_utime  = info->si_utime;
+            ssi->ssi_stime  = info->si_stime;
+            return;
+        case SIGILL:
+        case SIGFPE:
+        case SIGSEGV:
+        case SIGBUS:
+        case SIGTRAP:
+            if (info->si_code > 0) {
+                ssi->ssi_addr = (uint64_t)info->si_addr;
+                return;
+            }
+            break;
+        case SIGPOLL:
+            if (info->si_code > 0) {
+                ssi->ssi_band = info->si_band;
+                ssi->ssi_fd   = info->si_fd;
+                return;
+            }
+            break;
+    }
+
+    if (info->si_code == SI_TIMER) {
+        ssi->ssi_tid     = info->si_tid;
+        ssi->ssi_overrun = info->si_overrun;
+    } else {
+        ssi->ssi_pid = info->si_pid;
+        ssi->ssi_uid = info->si_uid;
+    }
+    ssi->ssi_int = info->si_int;
+    ssi->ssi_ptr = (uint64_t)info->si_ptr;
+}
+
+static ssize_t signalfd_read(struct shim_handle* hdl, void* buf, size_t count) {
+    if (count < sizeof(struct signalfd_siginfo))
+        return -EINVAL;
+
+    struct shim_signalfd_handle* sfd = &hdl->info.signalfd;
+    struct signalfd_siginfo* ssi = buf;
+    size_t max = count / sizeof(*ssi);
+    struct shim_thread* cur = get_cur_thread();
+
+    __atomic_store_n(&cur->signal_handled, false, __ATOMIC_RELEASE);
+
+    while (true) {
+        lock(&hdl->lock);
+        __sigset_t mask = sfd->mask;
+        bool nonblock = hdl->flags & O_NONBLOCK;
+        unlock(&hdl->lock);
+
+        signalfd_disarm(sfd);
+
+        size_t n = 0;
+        siginfo_t info;
+        while (n < max && pop_pending_signal(cur, &mask, &info))
+            signalfd_fill(&ssi[n++], &info);
+
+        /* signals which were left or queued meanwhile */
+        if (signalfd_pending(cur, &mask))
+            signalfd_arm(sfd);
+
+        if (n)
+            return n * sizeof(*ssi);
+        if (nonblock)
+            return -EAGAIN;
+        if (__atomic_load_n(&cur->signal_handled, __ATOMIC_ACQUIRE))
+            return -EINTR;
+
+        PAL_HANDLE pal_handle = hdl->pal_handle;
+        PAL_FLG events  = PAL_WAIT_READ;
+        PAL_FLG revents = 0;
+        if (!DkStreamsWaitEvents(1, &pal_handle, &events, &revents, NO_TIMEOUT) &&
+                PAL_NATIVE_ERRNO != PAL_ERROR_TRYAGAIN &&
+                PAL_NATIVE_ERRNO != PAL_ERROR_INTERRUPTED)
+            return -PAL_ERRNO;
+    }
+}
+
+static off_t signalfd_poll(struct shim_handle* hdl, int poll_type) {
+    lock(&hdl->lock);
+    __sigset_t mask = hdl->info.signalfd.mask;
+    unlock(&hdl->lock);
+
+    bool pending = signalfd_pending(get_cur_thread(), &mask);
+
+    if (poll_type == FS_POLL_SZ)
+        return pending ? sizeof(struct signalfd_siginfo) : 0;
+
+    return (poll_type & FS_POLL_RD) && pending ? FS_POLL_RD : 0;
+}
+
+static int signalfd_close(struct shim_handle* hdl) {
+    struct shim_signalfd_handle* sfd = &hdl->info.signalfd;
+
+    /* the handle is going away, nobody else adds it to the list */
+    if (LIST_EMPTY(sfd, list))
+        return 0;
+
+    lock(&signalfd_list_lock);
+    LISTP_DEL_INIT(sfd, &signalfd_list, list);
+    __atomic_sub_fetch(&signalfd_cnt, 1, __ATOMIC_RELEASE);
+    signalfd_list_unlock();
+    return 0;
+}
+
+static int signalfd_checkout(struct shim_handle* hdl) {
+    /* the child gets its own PAL eventfd, the signals of the parent are not its business */
+    hdl->pal_handle = NULL;
+    return 0;
+}
+
+static int signalfd_checkin(struct shim_handle* hdl) {
+    INIT_LIST_HEAD(&hdl->info.signalfd, list);
+    hdl->info.signalfd.ready = false;
+
+    /* after execve() the process may run with another manifest */
+    if (!eventfd_allowed())
+        return -ENOSYS;
+
+    hdl->pal_handle = DkStreamOpen(URI_PREFIX_EVENTFD, 0, 0, 0, PAL_OPTION_NONBLOCK);
+    if (!hdl->pal_handle) {
+        debug("signalfd: eventfd open failure\n");
+        return -PAL_ERRNO;
+    }
+
+    int ret = signalfd_add(hdl);
+    if (ret < 0)
+        return ret;
+
+    /* the inherited signals may be restored before or after the signalfd, so they may have been
+     * queued without notifying it */
+    signalfd_arm(&hdl->info.signalfd);
+    return 0;
+}
+
+struct shim_fs_ops signalfd_fs_ops = {
+    .read     = &signalfd_read,
+    .poll     = &signalfd_poll,
+    .close    = &signalfd_close,
+    .checkout = &signalfd_checkout,
+    .checkin  = &signalfd_checkin,
+};
+
+struct shim_mount signalfd_builtin_fs = {
+    .type   = "signalfd",
+    .fs_ops = &signalfd_fs_ops,
+};
+
+static int signalfd_copy_mask(__sigset_t* mask, const __sigset_t* user_mask, size_t sizemask) {
+    if (sizemask != sizeof(*mask))
+        return -EINVAL;
+    if (!user_mask || test_user_memory((void*)user_mask, sizemask, false))
+        return -EFAULT;
+
+    *mask = *user_mask;
+    /* SIGKILL and SIGSTOP are silently ignored, as on Linux */
+    __sigdelset(mask, SIGKILL);
+    __sigdelset(mask, SIGSTOP);
+    return 0;
+}
+
+static int signalfd_set_mask(int ufd, const __sigset_t* mask) {
+    struct shim_handle* hdl = get_fd_handle(ufd, NULL, NULL);
+    if (!hdl)
+        return -EBADF;
+    if (hdl->type != TYPE_SIGNALFD) {
+        put_handle(hdl);
+        return -EINVAL;
+    }
+
+    lock(&hdl->lock);
+    hdl->info.signalfd.mask = *mask;
+    unlock(&hdl->lock);
+
+    /* the new mask may contain signals which are already pending */
+    if (signalfd_pending(get_cur_thread(), mask))
+        signalfd_arm(&hdl->info.signalfd);
+
+    put_handle(hdl);
+    return ufd;
+}
+
+int shim_do_signalfd4(int ufd, __sigset_t* user_mask, size_t sizemask, int flags) {
+    if (flags & ~(SFD_CLOEXEC | SFD_NONBLOCK))
+        return -EINVAL;
+
+    __sigset_t mask;
+    int ret = signalfd_copy_mask(&mask, user_mask, sizemask);
+    if (ret < 0)
+        return ret;
+
+    if (ufd != -1)
+        return signalfd_set_mask(ufd, &mask);
+
+    /* the readiness of a signalfd is signalled through a host eventfd */
+    if (!eventfd_allowed())
+        return -ENOSYS;
+
+    struct shim_handle* hdl = get_new_handle();
+    if (!hdl)
+        return -ENOMEM;
+
+    hdl->type = TYPE_SIGNALFD;
+    hdl->info.signalfd.mask  = mask;
+    hdl->info.signalfd.ready = false;
+    INIT_LIST_HEAD(&hdl->info.signalfd, list);
+    set_handle_fs(hdl, &signalfd_builtin_fs);
+    hdl->flags    = O_RDONLY | (flags & SFD_NONBLOCK ? O_NONBLOCK : 0);
+    hdl->acc_mode = MAY_READ;
+
+    int pal_flags = PAL_OPTION_NONBLOCK | (flags & SFD_CLOEXEC ? PAL_OPTION_CLOEXEC : 0);
+    hdl->pal_handle = DkStreamOpen(URI_PREFIX_EVENTFD, 0, 0, 0, pal_flags);
+    if (!hdl->pal_handle) {
+        debug("signalfd: eventfd open failure\n");
+        ret = -PAL_ERRNO;
+        goto out;
+    }
+
+    ret = signalfd_add(hdl);
+    if (ret < 0)
+        goto out;
+
+    if (signalfd_pending(get_cur_thread(), &mask))
+        signalfd_arm(&hdl->info.signalfd);
+
+    ret = set_new_fd_handle(hdl, flags & SFD_CLOEXEC ? FD_CLOEXEC : 0, NULL);
+
+out:
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_signalfd(int ufd, __sigset_t* user_mask, size_t sizemask) {
+    return shim_do_signalfd4(ufd, user_mask, sizemask, 0);
+}
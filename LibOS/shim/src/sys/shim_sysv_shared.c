@@ -0,0 +1,728 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_sysv_shared.c
+ *
+ * Local-first fast path for System V semaphores and message queues. Instead of forwarding every
+ * semop/msgsnd/msgrcv to the process owning the object (via IPC), the object state lives in a
+ * named shared-memory segment (PAL `shm:` stream) that every process of this Graphene instance
+ * maps. Operations are done under a lock stored in the segment itself and blocked callers sleep
+ * on a sequence counter with DkWaitOnAddress, so no round-trip to another process is needed.
+ *
+ * The fast path is enabled with the "sys.sysv.local_first" manifest key and only if the PAL
+ * supports `shm:` streams; otherwise SysV objects keep using the IPC-based implementation. The
+ * create/attach functions return -ENOSYS in the latter case. A segment is unlinked on IPC_RMID or
+ * when the last process which has the object attached detaches from it (at the latest when it
+ * exits), so attaching returns -ENOENT for removed (or never created) objects. Segments of
+ * processes killed by the host are not removed.
+ *
+ * SEM_UNDO adjustments are kept per process and applied when the process detaches. As on Linux,
+ * SETVAL and SETALL discard the adjustments of all processes for the semaphores they set.
+ *
+ * The segment primitives (open/map, lock, wait) are also used by POSIX message queues, see
+ * shim_mqueue.c.
+ */
+
+#include <errno.h>
+
+#include "pal.h"
+#include "pal_error.h"
+#include "shim_checkpoint.h"
+#include "shim_handle.h"
+#include "shim_internal.h"
+#include "shim_sysv.h"
+#include "shim_thread.h"
+#include "shim_utils.h"
+#include "shim_vma.h"
+
+/* Identifies this Graphene instance, so that segments of unrelated instances running on the same
+ * host do not collide. Generated by the first process and inherited by all its descendants. */
+static uint64_t g_sysv_shared_token __attribute_migratable = 0;
+
+static bool g_sysv_shared_enabled = false;
+
+struct sysv_shared_sem_obj {
+    uint16_t val;
+    uint16_t ncnt;
+    uint16_t zcnt;
+    IDTYPE pid;
+    uint32_t gen; /* bumped by SETVAL/SETALL, which invalidate SEM_UNDO adjustments */
+};
+
+/* SEM_UNDO adjustment of this process for one semaphore, valid while `gen` matches the semaphore */
+struct sysv_shared_semadj {
+    int32_t adj;
+    uint32_t gen;
+};
+
+struct sysv_shared_sem_seg {
+    struct sysv_shared_hdr hdr;
+    uint32_t nsems;
+    struct sysv_shared_sem_obj sems[];
+};
+
+struct sysv_shared_msg {
+    long mtype;
+    uint32_t size;
+    char data[];
+};
+
+#define SHARED_MSG_SIZE(size) ALIGN_UP(sizeof(struct sysv_shared_msg) + (size), sizeof(long))
+
+struct sysv_shared_msg_seg {
+    struct sysv_shared_hdr hdr;
+    uint32_t nmsgs;
+    uint32_t used;
+    char data[MSGMNB];
+};
+
+int init_sysv_shared(void) {
+    /* SysV shared memory segments are named after the token as well, so it is always needed. */
+    if (!g_sysv_shared_token) {
+        int ret = DkRandomBitsRead(&g_sysv_shared_token, sizeof(g_sysv_shared_token));
+        if (ret < 0)
+            return -convert_pal_errno(-ret);
+    }
+
+    if (!root_config)
+        return 0;
+
+    char cfg[2];
+    ssize_t len = get_config(root_config, "sys.sysv.local_first", cfg, sizeof(cfg));
+    if (len != 1 || cfg[0] != '1')
+        return 0;
+
+    g_sysv_shared_enabled = true;
+    return 0;
+}
+
+bool sysv_shared_enabled(void) {
+    return g_sysv_shared_enabled;
+}
+
+void sysv_shared_lock(struct sysv_shared_hdr* hdr) {
+    uint32_t c = 0;
+    if (__atomic_compare_exchange_n(&hdr->lock, &c, 1, /*weak=*/false, __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED))
+        return;
+
+    if (c != 2)
+        c = __atomic_exchange_n(&hdr->lock, 2, __ATOMIC_ACQUIRE);
+    while (c != 0) {
+        DkWaitOnAddress(&hdr->lock, 2, NO_TIMEOUT);
+        c = __atomic_exchange_n(&hdr->lock, 2, __ATOMIC_ACQUIRE);
+    }
+}
+
+void sysv_shared_unlock(struct sysv_shared_hdr* hdr) {
+    if (__atomic_exchange_n(&hdr->lock, 0, __ATOMIC_RELEASE) == 2)
+        DkWakeByAddress(&hdr->lock, 1);
+}
+
+/* Must be called with the segment locked; the wake-up itself is done by
+ * sysv_shared_unlock_notify(). */
+void sysv_shared_changed(struct sysv_shared_hdr* hdr) {
+    __atomic_add_fetch(&hdr->seq, 1, __ATOMIC_RELEASE);
+}
+
+void sysv_shared_unlock_notify(struct sysv_shared_hdr* hdr) {
+    bool wake = __atomic_load_n(&hdr->nwaiters, __ATOMIC_ACQUIRE) > 0;
+    sysv_shared_unlock(hdr);
+    if (wake)
+        DkWakeByAddress(&hdr->seq, (PAL_NUM)-1);
+}
+
+/* Sleeps until the segment changes. Must be called with the segment locked; returns with the
+ * segment locked. `deadline_us` is an absolute time from DkSystemTimeQuery or 0 for no timeout. */
+int sysv_shared_wait(struct sysv_shared_hdr* hdr, uint64_t deadline_us) {
+    uint64_t timeout_us = NO_TIMEOUT;
+    if (deadline_us) {
+        uint64_t now = DkSystemTimeQuery();
+        if (now >= deadline_us)
+            return -EAGAIN;
+        timeout_us = deadline_us - now;
+    }
+
+    uint32_t seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+    __atomic_add_fetch(&hdr->nwaiters, 1, __ATOMIC_ACQ_REL);
+    sysv_shared_unlock(hdr);
+
+    int ret = 0;
+    if (!DkWaitOnAddress(&hdr->seq, seq, timeout_us))
+        ret = -PAL_ERRNO;
+
+    sysv_shared_lock(hdr);
+    __atomic_sub_fetch(&hdr->nwaiters, 1, __ATOMIC_ACQ_REL);
+    return ret;
+}
+
+void sysv_shared_uri(char* uri, size_t size, const char* name) {
+    snprintf(uri, size, URI_PREFIX_SHM "graphene-%016lx-%s", g_sysv_shared_token, name);
+}
+
+void sysv_shared_obj_uri(char* uri, size_t size, const char* type, IDTYPE id) {
+    snprintf(uri, size, URI_PREFIX_SHM "graphene-%016lx-%s-%u", g_sysv_shared_token, type, id);
+}
+
+static int shared_obj_map(PAL_HANDLE pal_hdl, size_t size, struct sysv_shared_obj** objp) {
+    struct sysv_shared_obj* obj = malloc(sizeof(*obj));
+    if (!obj)
+        return -ENOMEM;
+
+    size_t map_size = ALLOC_ALIGN_UP(size);
+    void* addr;
+    int ret = bkeep_mmap_any(map_size, PROT_READ | PROT_WRITE, MAP_SHARED | VMA_INTERNAL, NULL, 0,
+                             "sysv", &addr);
+    if (ret < 0) {
+        free(obj);
+        return ret;
+    }
+
+    if (DkStreamMap(pal_hdl, addr, PAL_PROT_READ | PAL_PROT_WRITE, 0, map_size) != addr) {
+        ret = -PAL_ERRNO;
+        void* tmp_vma = NULL;
+        if (bkeep_munmap(addr, map_size, /*is_internal=*/true, &tmp_vma) < 0)
+            BUG();
+        bkeep_remove_tmp_vma(tmp_vma);
+        free(obj);
+        return ret;
+    }
+
+    obj->pal_handle = pal_hdl;
+    obj->addr       = addr;
+    obj->size       = size;
+    obj->semadj     = NULL;
+    obj->released   = false;
+    *objp = obj;
+    return 0;
+}
+
+int sysv_shared_map(PAL_HANDLE pal_hdl, struct sysv_shared_obj** objp) {
+    PAL_STREAM_ATTR attr;
+    if (!DkStreamAttributesQueryByHandle(pal_hdl, &attr))
+        return -PAL_ERRNO;
+    if (attr.pending_size < sizeof(struct sysv_shared_hdr))
+        return -EIDRM;
+
+    return shared_obj_map(pal_hdl, attr.pending_size, objp);
+}
+
+int sysv_shared_open(const char* uri, size_t create_size, struct sysv_shared_obj** objp) {
+    PAL_HANDLE pal_hdl = DkStreamOpen(uri, PAL_ACCESS_RDWR, PAL_SHARE_OWNER_R | PAL_SHARE_OWNER_W,
+                                      create_size ? PAL_CREATE_ALWAYS : 0, 0);
+    if (!pal_hdl) {
+        if (PAL_NATIVE_ERRNO == PAL_ERROR_NOTIMPLEMENTED) {
+            /* This PAL cannot share memory between processes, fall back to IPC for good. */
+            g_sysv_shared_enabled = false;
+        }
+        return -PAL_ERRNO;
+    }
+
+    int ret;
+    if (create_size) {
+        PAL_NUM pal_ret = DkStreamSetLength(pal_hdl, create_size);
+        if (pal_ret) {
+            ret = -convert_pal_errno(pal_ret);
+            goto out;
+        }
+        ret = shared_obj_map(pal_hdl, create_size, objp);
+    } else {
+        ret = sysv_shared_map(pal_hdl, objp);
+    }
+
+out:
+    if (ret < 0) {
+        if (create_size)
+            DkStreamDelete(pal_hdl, 0);
+        DkObjectClose(pal_hdl);
+    }
+    return ret;
+}
+
+static int shared_obj_open(const char* type, IDTYPE id, size_t create_size,
+                           struct sysv_shared_obj** objp) {
+    char uri[SYSV_SHARED_URI_SIZE];
+    sysv_shared_obj_uri(uri, sizeof(uri), type, id);
+    int ret = sysv_shared_open(uri, create_size, objp);
+    if (ret < 0)
+        return ret;
+
+    /* the last process to detach may have removed the segment while we were mapping it */
+    struct sysv_shared_hdr* hdr = (*objp)->addr;
+    sysv_shared_lock(hdr);
+    bool deleted = hdr->deleted;
+    if (!deleted)
+        hdr->nattach++;
+    sysv_shared_unlock(hdr);
+
+    if (deleted) {
+        sysv_shared_detach(*objp);
+        return -ENOENT;
+    }
+    return 0;
+}
+
+void sysv_shared_detach(struct sysv_shared_obj* obj) {
+    size_t map_size = ALLOC_ALIGN_UP(obj->size);
+    void* tmp_vma = NULL;
+    if (bkeep_munmap(obj->addr, map_size, /*is_internal=*/true, &tmp_vma) < 0)
+        BUG();
+    DkStreamUnmap(obj->addr, map_size);
+    bkeep_remove_tmp_vma(tmp_vma);
+    DkObjectClose(obj->pal_handle);
+    free(obj->semadj);
+    free(obj);
+}
+
+/* Applies the SEM_UNDO adjustments of this process; the segment must be locked. */
+static bool apply_semadj(struct sysv_shared_obj* obj) {
+    struct sysv_shared_sem_seg* seg = obj->addr;
+    bool changed = false;
+
+    for (uint32_t i = 0; i < seg->nsems; i++) {
+        struct sysv_shared_semadj* semadj = &obj->semadj[i];
+        if (!semadj->adj || semadj->gen != seg->sems[i].gen)
+            continue;
+
+        /* like Linux, clamp the result instead of failing */
+        int val = seg->sems[i].val + semadj->adj;
+        seg->sems[i].val = MIN(MAX(val, 0), SEMVMX);
+        seg->sems[i].pid = get_cur_thread()->tgid;
+        semadj->adj = 0;
+        changed = true;
+    }
+    return changed;
+}
+
+void sysv_shared_release(struct sysv_shared_obj* obj, bool unmap) {
+    struct sysv_shared_hdr* hdr = obj->addr;
+
+    sysv_shared_lock(hdr);
+    bool remove = false;
+    bool changed = false;
+    if (!hdr->deleted && !obj->released) {
+        obj->released = true;
+        if (obj->semadj)
+            changed = apply_semadj(obj);
+        if (!--hdr->nattach) {
+            hdr->deleted = 1;
+            remove = true;
+        }
+    }
+    if (changed || remove) {
+        sysv_shared_changed(hdr);
+        sysv_shared_unlock_notify(hdr);
+    } else {
+        sysv_shared_unlock(hdr);
+    }
+
+    if (remove)
+        DkStreamDelete(obj->pal_handle, 0);
+    if (unmap)
+        sysv_shared_detach(obj);
+}
+
+static int shared_obj_remove(struct sysv_shared_obj* obj) {
+    struct sysv_shared_hdr* hdr = obj->addr;
+
+    sysv_shared_lock(hdr);
+    if (hdr->deleted) {
+        sysv_shared_unlock(hdr);
+        return -EIDRM;
+    }
+    hdr->deleted = 1;
+    sysv_shared_changed(hdr);
+    sysv_shared_unlock_notify(hdr);
+
+    /* Processes which already mapped the segment see `deleted`, new ones fail to open it. */
+    DkStreamDelete(obj->pal_handle, 0);
+    return 0;
+}
+
+static uint64_t get_deadline(unsigned long timeout_ns) {
+    if (timeout_ns == IPC_SEM_NOTIMEOUT)
+        return 0;
+    return DkSystemTimeQuery() + timeout_ns / 1000 + 1;
+}
+
+int sysv_shared_sem_create(IDTYPE semid, int nsems, struct sysv_shared_obj** objp) {
+    if (nsems < 0 || nsems > SEMMSL)
+        return -EINVAL;
+
+    size_t size = sizeof(struct sysv_shared_sem_seg) + nsems * sizeof(struct sysv_shared_sem_obj);
+    int ret = shared_obj_open("sem", semid, size, objp);
+    if (ret < 0)
+        return ret;
+
+    struct sysv_shared_sem_seg* seg = (*objp)->addr;
+    seg->nsems = nsems;
+    return 0;
+}
+
+int sysv_shared_sem_attach(IDTYPE semid, struct sysv_shared_obj** objp) {
+    return shared_obj_open("sem", semid, 0, objp);
+}
+
+int sysv_shared_sem_remove(struct sysv_shared_obj* obj) {
+    return shared_obj_remove(obj);
+}
+
+/* Tries to apply all `sops` atomically. Returns 0 on success, 1 if the caller must wait (in which
+ * case `*blocked` is the operation it waits for) or a negative error code. */
+static int try_semop(struct sysv_shared_obj* obj, struct sembuf* sops, unsigned int nsops,
+                     struct sembuf** blocked) {
+    struct sysv_shared_sem_seg* seg = obj->addr;
+    uint16_t vals[nsops];
+
+    for (unsigned int i = 0; i < nsops; i++) {
+        struct sembuf* op = &sops[i];
+        int val = seg->sems[op->sem_num].val;
+
+        /* Earlier operations in this call may have already modified the same semaphore. */
+        for (unsigned int j = 0; j < i; j++)
+            if (sops[j].sem_num == op->sem_num)
+                val = vals[j];
+
+        if (op->sem_op > 0) {
+            if (val + op->sem_op > SEMVMX)
+                return -ERANGE;
+            val += op->sem_op;
+        } else if (op->sem_op < 0) {
+            if (val < -op->sem_op) {
+                *blocked = op;
+                return 1;
+            }
+            val += op->sem_op;
+        } else if (val) {
+            *blocked = op;
+            return 1;
+        }
+        vals[i] = val;
+
+        if (op->sem_flg & SEM_UNDO) {
+            struct sysv_shared_semadj* semadj = &obj->semadj[op->sem_num];
+            int adj = semadj->gen == seg->sems[op->sem_num].gen ? semadj->adj : 0;
+            if (adj - op->sem_op < -SEMAEM - 1 || adj - op->sem_op > SEMAEM)
+                return -ERANGE;
+        }
+    }
+
+    IDTYPE pid = get_cur_thread()->tgid;
+    for (unsigned int i = 0; i < nsops; i++) {
+        struct sysv_shared_sem_obj* sobj = &seg->sems[sops[i].sem_num];
+        sobj->val = vals[i];
+        sobj->pid = pid;
+
+        if (sops[i].sem_flg & SEM_UNDO) {
+            struct sysv_shared_semadj* semadj = &obj->semadj[sops[i].sem_num];
+            if (semadj->gen != sobj->gen) {
+                semadj->gen = sobj->gen;
+                semadj->adj = 0;
+            }
+            semadj->adj -= sops[i].sem_op;
+        }
+    }
+    return 0;
+}
+
+int sysv_shared_semop(struct sysv_shared_obj* obj, struct sembuf* sops, unsigned int nsops,
+                      unsigned long timeout_ns) {
+    struct sysv_shared_sem_seg* seg = obj->addr;
+    uint64_t deadline = get_deadline(timeout_ns);
+    int ret;
+
+    bool undo = false;
+    for (unsigned int i = 0; i < nsops; i++) {
+        if (sops[i].sem_num >= seg->nsems)
+            return -EFBIG;
+        if (sops[i].sem_flg & SEM_UNDO)
+            undo = true;
+    }
+
+    struct sysv_shared_semadj* semadj = NULL;
+    if (undo && !__atomic_load_n(&obj->semadj, __ATOMIC_ACQUIRE)) {
+        semadj = calloc(seg->nsems, sizeof(*semadj));
+        if (!semadj)
+            return -ENOMEM;
+    }
+
+    struct shim_thread* cur = get_cur_thread();
+    __atomic_store_n(&cur->signal_handled, false, __ATOMIC_RELEASE);
+
+    sysv_shared_lock(&seg->hdr);
+    if (semadj && !obj->semadj) {
+        /* the adjustments are only accessed with the segment locked */
+        __atomic_store_n(&obj->semadj, semadj, __ATOMIC_RELEASE);
+        semadj = NULL;
+    }
+
+    while (true) {
+        if (seg->hdr.deleted) {
+            ret = -EIDRM;
+            break;
+        }
+
+        struct sembuf* blocked = NULL;
+        ret = try_semop(obj, sops, nsops, &blocked);
+        if (ret <= 0) {
+            if (!ret)
+                sysv_shared_changed(&seg->hdr);
+            break;
+        }
+
+        if (blocked->sem_flg & IPC_NOWAIT) {
+            ret = -EAGAIN;
+            break;
+        }
+
+        if (__atomic_load_n(&cur->signal_handled, __ATOMIC_ACQUIRE)) {
+            ret = -EINTR;
+            break;
+        }
+
+        struct sysv_shared_sem_obj* sobj = &seg->sems[blocked->sem_num];
+        uint16_t* cnt = blocked->sem_op ? &sobj->ncnt : &sobj->zcnt;
+        (*cnt)++;
+        ret = sysv_shared_wait(&seg->hdr, deadline);
+        (*cnt)--;
+        if (ret < 0)
+            break;
+    }
+
+    if (ret == 0)
+        sysv_shared_unlock_notify(&seg->hdr);
+    else
+        sysv_shared_unlock(&seg->hdr);
+    free(semadj);
+    return ret;
+}
+
+int sysv_shared_semctl(struct sysv_shared_obj* obj, int semnum, int cmd, unsigned long arg) {
+    struct sysv_shared_sem_seg* seg = obj->addr;
+    int ret = 0;
+
+    switch (cmd) {
+        case GETVAL:
+        case GETNCNT:
+        case GETPID:
+        case GETZCNT:
+        case SETVAL:
+            if (semnum < 0 || (uint32_t)semnum >= seg->nsems)
+                return -EINVAL;
+            break;
+    }
+
+    sysv_shared_lock(&seg->hdr);
+    if (seg->hdr.deleted) {
+        sysv_shared_unlock(&seg->hdr);
+        return -EIDRM;
+    }
+
+    bool changed = false;
+    switch (cmd) {
+        case GETALL:
+            for (uint32_t i = 0; i < seg->nsems; i++)
+                ((unsigned short*)arg)[i] = seg->sems[i].val;
+            break;
+
+        case GETNCNT:
+            ret = seg->sems[semnum].ncnt;
+            break;
+
+        case GETPID:
+            ret = seg->sems[semnum].pid;
+            break;
+
+        case GETVAL:
+            ret = seg->sems[semnum].val;
+            break;
+
+        case GETZCNT:
+            ret = seg->sems[semnum].zcnt;
+            break;
+
+        case SETALL:
+            for (uint32_t i = 0; i < seg->nsems; i++) {
+                if (((unsigned short*)arg)[i] > SEMVMX) {
+                    ret = -ERANGE;
+                    break;
+                }
+            }
+            if (ret < 0)
+                break;
+            for (uint32_t i = 0; i < seg->nsems; i++) {
+                seg->sems[i].val = ((unsigned short*)arg)[i];
+                seg->sems[i].gen++;
+            }
+            changed = true;
+            break;
+
+        case SETVAL:
+            if (arg > SEMVMX) {
+                ret = -ERANGE;
+                break;
+            }
+            seg->sems[semnum].val = arg;
+            seg->sems[semnum].pid = get_cur_thread()->tgid;
+            seg->sems[semnum].gen++;
+            changed = true;
+            break;
+
+        default:
+            ret = -EINVAL;
+            break;
+    }
+
+    if (changed) {
+        sysv_shared_changed(&seg->hdr);
+        sysv_shared_unlock_notify(&seg->hdr);
+    } else {
+        sysv_shared_unlock(&seg->hdr);
+    }
+    return ret;
+}
+
+int sysv_shared_msgq_create(IDTYPE msqid, struct sysv_shared_obj** objp) {
+    return shared_obj_open("msg", msqid, sizeof(struct sysv_shared_msg_seg), objp);
+}
+
+int sysv_shared_msgq_attach(IDTYPE msqid, struct sysv_shared_obj** objp) {
+    return shared_obj_open("msg", msqid, 0, objp);
+}
+
+int sysv_shared_msgq_remove(struct sysv_shared_obj* obj) {
+    return shared_obj_remove(obj);
+}
+
+int sysv_shared_msgsnd(struct sysv_shared_obj* obj, const struct __kernel_msgbuf* msgbuf,
+                       size_t size, int flags) {
+    struct sysv_shared_msg_seg* seg = obj->addr;
+    size_t msg_size = SHARED_MSG_SIZE(size);
+    int ret;
+
+    if (msg_size > sizeof(seg->data))
+        return -EINVAL;
+
+    struct shim_thread* cur = get_cur_thread();
+    __atomic_store_n(&cur->signal_handled, false, __ATOMIC_RELEASE);
+
+    sysv_shared_lock(&seg->hdr);
+    while (true) {
+        if (seg->hdr.deleted) {
+            ret = -EIDRM;
+            break;
+        }
+
+        if (seg->used + msg_size <= sizeof(seg->data)) {
+            struct sysv_shared_msg* msg = (struct sysv_shared_msg*)&seg->data[seg->used];
+            msg->mtype = msgbuf->mtype;
+            msg->size  = size;
+            memcpy(msg->data, msgbuf->mtext, size);
+            seg->used += msg_size;
+            seg->nmsgs++;
+            sysv_shared_changed(&seg->hdr);
+            ret = 0;
+            break;
+        }
+
+        if (flags & IPC_NOWAIT) {
+            ret = -EAGAIN;
+            break;
+        }
+
+        if (__atomic_load_n(&cur->signal_handled, __ATOMIC_ACQUIRE)) {
+            ret = -EINTR;
+            break;
+        }
+
+        ret = sysv_shared_wait(&seg->hdr, /*deadline_us=*/0);
+        if (ret < 0)
+            break;
+    }
+
+    if (ret == 0)
+        sysv_shared_unlock_notify(&seg->hdr);
+    else
+        sysv_shared_unlock(&seg->hdr);
+    return ret;
+}
+
+/* Finds the message to be received, following the msgrcv(2) rules for `type`. */
+static struct sysv_shared_msg* find_msg(struct sysv_shared_msg_seg* seg, long type, int flags) {
+    struct sysv_shared_msg* found = NULL;
+
+    for (uint32_t off = 0; off < seg->used; ) {
+        struct sysv_shared_msg* msg = (struct sysv_shared_msg*)&seg->data[off];
+        off += SHARED_MSG_SIZE(msg->size);
+
+        if (type == 0)
+            return msg;
+        if (type > 0) {
+            if ((msg->mtype == type) != !!(flags & MSG_EXCEPT))
+                return msg;
+            continue;
+        }
+        if (msg->mtype <= -type && (!found || msg->mtype < found->mtype))
+            found = msg;
+    }
+
+    return found;
+}
+
+int sysv_shared_msgrcv(struct sysv_shared_obj* obj, long type, struct __kernel_msgbuf* msgbuf,
+                       size_t size, int flags) {
+    struct sysv_shared_msg_seg* seg = obj->addr;
+    int ret;
+
+    struct shim_thread* cur = get_cur_thread();
+    __atomic_store_n(&cur->signal_handled, false, __ATOMIC_RELEASE);
+
+    sysv_shared_lock(&seg->hdr);
+    while (true) {
+        if (seg->hdr.deleted) {
+            ret = -EIDRM;
+            break;
+        }
+
+        struct sysv_shared_msg* msg = find_msg(seg, type, flags);
+        if (msg) {
+            if (msg->size > size && !(flags & MSG_NOERROR)) {
+                ret = -E2BIG;
+                break;
+            }
+
+            size_t copy_size = MIN(size, (size_t)msg->size);
+            msgbuf->mtype = msg->mtype;
+            memcpy(msgbuf->mtext, msg->data, copy_size);
+
+            size_t msg_size = SHARED_MSG_SIZE(msg->size);
+            char* next = (char*)msg + msg_size;
+            memmove(msg, next, &seg->data[seg->used] - next);
+            seg->used -= msg_size;
+            seg->nmsgs--;
+            sysv_shared_changed(&seg->hdr);
+            ret = copy_size;
+            break;
+        }
+
+        if (flags & IPC_NOWAIT) {
+            ret = -ENOMSG;
+            break;
+        }
+
+        if (__atomic_load_n(&cur->signal_handled, __ATOMIC_ACQUIRE)) {
+            ret = -EINTR;
+            break;
+        }
+
+        ret = sysv_shared_wait(&seg->hdr, /*deadline_us=*/0);
+        if (ret < 0)
+            break;
+    }
+
+    if (ret >= 0)
+        sysv_shared_unlock_notify(&seg->hdr);
+    else
+        sysv_shared_unlock(&seg->hdr);
+    return ret;
+}
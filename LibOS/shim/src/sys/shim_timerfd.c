@@ -0,0 +1,314 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * shim_timerfd.c
+ *
+ * Implementation of system calls "timerfd_create", "timerfd_settime" and "timerfd_gettime".
+ *
+ * A timerfd is a timer on the timer wheel (see bookkeep/shim_timer.c) plus an internal PAL eventfd
+ * which is used only to report readiness to poll() and epoll: the timer callback makes it readable
+ * when the expiration count becomes non-zero, and it is drained when the count is read or reset.
+ * Since the eventfd is a host eventfd, timerfds are available only if the manifest sets
+ * `sys.insecure__allow_eventfd = 1`. Timers are not shared between processes, so a child process
+ * gets a disarmed copy of the timerfd (which keeps the expirations not read yet) with its own
+ * eventfd.
+ */
+
+#include <asm/fcntl.h>
+
+#include <pal.h>
+#include <pal_error.h>
+#include <shim_fs.h>
+#include <shim_handle.h>
+#include <shim_internal.h>
+#include <shim_table.h>
+#include <shim_timer.h>
+#include <shim_utils.h>
+
+#ifndef TFD_TIMER_ABSTIME
+#define TFD_TIMER_ABSTIME (1 << 0)
+#endif
+#ifndef TFD_TIMER_CANCEL_ON_SET
+#define TFD_TIMER_CANCEL_ON_SET (1 << 1)
+#endif
+#ifndef TFD_CLOEXEC
+#define TFD_CLOEXEC O_CLOEXEC
+#endif
+#ifndef TFD_NONBLOCK
+#define TFD_NONBLOCK O_NONBLOCK
+#endif
+
+/* must be called with hdl->lock held */
+static void timerfd_drain(struct shim_handle* hdl) {
+    uint64_t cnt;
+    /* the PAL eventfd is non-blocking, an error means that it was not readable */
+    DkStreamRead(hdl->pal_handle, 0, sizeof(cnt), &cnt, NULL, 0);
+}
+
+static void timerfd_expired(struct shim_timer* timer, uint64_t now) {
+    struct shim_handle* hdl = timer->arg;
+    struct shim_timerfd_handle* tfd = &hdl->info.timerfd;
+
+    lock(&hdl->lock);
+    if (!tfd->armed || timer_pending(timer)) {
+        /* disarmed, closed or re-armed after this expiration was collected */
+        goto out;
+    }
+
+    uint64_t cnt = 1;
+    if (tfd->interval) {
+        uint64_t next;
+        cnt = timer_expirations(timer->expire, tfd->interval, now, &next);
+        (void)arm_timer(timer, next);
+    } else {
+        tfd->armed = false;
+    }
+
+    if (!tfd->expirations) {
+        uint64_t one = 1;
+        if (DkStreamWrite(hdl->pal_handle, 0, sizeof(one), &one, NULL) == PAL_STREAM_ERROR)
+            debug("timerfd: cannot signal expiration (%ld)\n", PAL_ERRNO);
+    }
+    tfd->expirations += cnt;
+
+out:
+    unlock(&hdl->lock);
+}
+
+static ssize_t timerfd_read(struct shim_handle* hdl, void* buf, size_t count) {
+    if (count < sizeof(uint64_t))
+        return -EINVAL;
+
+    struct shim_timerfd_handle* tfd = &hdl->info.timerfd;
+
+    while (true) {
+        lock(&hdl->lock);
+        uint64_t expirations = tfd->expirations;
+        if (expirations) {
+            tfd->expirations = 0;
+            timerfd_drain(hdl);
+            unlock(&hdl->lock);
+
+            memcpy(buf, &expirations, sizeof(expirations));
+            return sizeof(expirations);
+        }
+
+        bool nonblock = hdl->flags & O_NONBLOCK;
+        PAL_HANDLE pal_handle = hdl->pal_handle;
+        unlock(&hdl->lock);
+
+        if (nonblock)
+            return -EAGAIN;
+
+        PAL_FLG events  = PAL_WAIT_READ;
+        PAL_FLG revents = 0;
+        if (!DkStreamsWaitEvents(1, &pal_handle, &events, &revents, NO_TIMEOUT) &&
+                PAL_NATIVE_ERRNO != PAL_ERROR_TRYAGAIN)
+            return -PAL_ERRNO;
+    }
+}
+
+static off_t timerfd_poll(struct shim_handle* hdl, int poll_type) {
+    lock(&hdl->lock);
+    bool expired = hdl->info.timerfd.expirations != 0;
+    unlock(&hdl->lock);
+
+    if (poll_type == FS_POLL_SZ)
+        return expired ? sizeof(uint64_t) : 0;
+
+    return (poll_type & FS_POLL_RD) && expired ? FS_POLL_RD : 0;
+}
+
+static int timerfd_close(struct shim_handle* hdl) {
+    lock(&hdl->lock);
+    hdl->info.timerfd.armed = false;
+    cancel_timer(&hdl->info.timerfd.timer);
+    unlock(&hdl->lock);
+
+    /* the callback may be waiting for hdl->lock right now */
+    sync_timer(&hdl->info.timerfd.timer);
+    return 0;
+}
+
+static int timerfd_checkout(struct shim_handle* hdl) {
+    /* the child gets its own PAL eventfd, the parent's one is signaled by the parent's timer */
+    hdl->pal_handle = NULL;
+    return 0;
+}
+
+static int timerfd_checkin(struct shim_handle* hdl) {
+    /* the timer of the parent is not inherited */
+    init_timer(&hdl->info.timerfd.timer, &timerfd_expired, hdl);
+    hdl->info.timerfd.armed = false;
+
+    hdl->pal_handle = DkStreamOpen(URI_PREFIX_EVENTFD, 0, 0, 0, PAL_OPTION_NONBLOCK);
+    if (!hdl->pal_handle) {
+        debug("timerfd: eventfd open failure\n");
+        return -PAL_ERRNO;
+    }
+
+    if (hdl->info.timerfd.expirations) {
+        uint64_t one = 1;
+        if (DkStreamWrite(hdl->pal_handle, 0, sizeof(one), &one, NULL) == PAL_STREAM_ERROR)
+            return -PAL_ERRNO;
+    }
+    return 0;
+}
+
+struct shim_fs_ops timerfd_fs_ops = {
+    .read     = &timerfd_read,
+    .poll     = &timerfd_poll,
+    .close    = &timerfd_close,
+    .checkout = &timerfd_checkout,
+    .checkin  = &timerfd_checkin,
+};
+
+struct shim_mount timerfd_builtin_fs = {
+    .type   = "timerfd",
+    .fs_ops = &timerfd_fs_ops,
+};
+
+static bool timerfd_clock_supported(int clockid) {
+    return clockid == CLOCK_REALTIME || clockid == CLOCK_MONOTONIC || clockid == CLOCK_BOOTTIME;
+}
+
+int shim_do_timerfd_create(int clockid, int flags) {
+    if (!timerfd_clock_supported(clockid))
+        return -EINVAL;
+    if (flags & ~(TFD_CLOEXEC | TFD_NONBLOCK))
+        return -EINVAL;
+    if (!eventfd_allowed())
+        return -ENOSYS;
+
+    struct shim_handle* hdl = get_new_handle();
+    if (!hdl)
+        return -ENOMEM;
+
+    hdl->type = TYPE_TIMERFD;
+    init_timer(&hdl->info.timerfd.timer, &timerfd_expired, hdl);
+    hdl->info.timerfd.clockid = clockid;
+    set_handle_fs(hdl, &timerfd_builtin_fs);
+    hdl->flags    = O_RDONLY | (flags & TFD_NONBLOCK ? O_NONBLOCK : 0);
+    hdl->acc_mode = MAY_READ;
+
+    int ret;
+    int pal_flags = PAL_OPTION_NONBLOCK | (flags & TFD_CLOEXEC ? PAL_OPTION_CLOEXEC : 0);
+    hdl->pal_handle = DkStreamOpen(URI_PREFIX_EVENTFD, 0, 0, 0, pal_flags);
+    if (!hdl->pal_handle) {
+        debug("timerfd: eventfd open failure\n");
+        ret = -PAL_ERRNO;
+        goto out;
+    }
+
+    ret = set_new_fd_handle(hdl, flags & TFD_CLOEXEC ? FD_CLOEXEC : 0, NULL);
+
+out:
+    put_handle(hdl);
+    return ret;
+}
+
+static struct shim_handle* get_timerfd_handle(int ufd, int* err) {
+    struct shim_handle* hdl = get_fd_handle(ufd, NULL, NULL);
+    if (!hdl) {
+        *err = -EBADF;
+        return NULL;
+    }
+    if (hdl->type != TYPE_TIMERFD) {
+        put_handle(hdl);
+        *err = -EINVAL;
+        return NULL;
+    }
+    return hdl;
+}
+
+static void timerfd_get_locked(struct shim_handle* hdl, uint64_t now,
+                               struct __kernel_itimerspec* setting) {
+    struct shim_timerfd_handle* tfd = &hdl->info.timerfd;
+
+    uint64_t value = 0;
+    if (tfd->armed && timer_pending(&tfd->timer))
+        value = tfd->timer.expire > now ? tfd->timer.expire - now : 1;
+
+    timer_us_to_timespec(value, &setting->it_value);
+    timer_us_to_timespec(tfd->interval, &setting->it_interval);
+}
+
+int shim_do_timerfd_settime(int ufd, int flags, const struct __kernel_itimerspec* utmr,
+                            struct __kernel_itimerspec* otmr) {
+    if (flags & ~(TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET))
+        return -EINVAL;
+
+    if (!utmr || test_user_memory((void*)utmr, sizeof(*utmr), false))
+        return -EFAULT;
+    if (otmr && test_user_memory(otmr, sizeof(*otmr), true))
+        return -EFAULT;
+
+    struct __kernel_itimerspec setting = *utmr;
+    if (!timer_timespec_valid(&setting.it_value) || !timer_timespec_valid(&setting.it_interval))
+        return -EINVAL;
+
+    int ret = 0;
+    struct shim_handle* hdl = get_timerfd_handle(ufd, &ret);
+    if (!hdl)
+        return ret;
+
+    uint64_t now = DkSystemTimeQuery();
+    if ((int64_t)now < 0) {
+        ret = -PAL_ERRNO;
+        goto out;
+    }
+
+    uint64_t value = timer_timespec_to_us(&setting.it_value);
+    struct shim_timerfd_handle* tfd = &hdl->info.timerfd;
+
+    lock(&hdl->lock);
+
+    if (otmr)
+        timerfd_get_locked(hdl, now, otmr);
+
+    /* setting the timer resets the expirations which were not read yet */
+    cancel_timer(&tfd->timer);
+    if (tfd->expirations) {
+        tfd->expirations = 0;
+        timerfd_drain(hdl);
+    }
+
+    tfd->interval = timer_timespec_to_us(&setting.it_interval);
+    tfd->armed    = !!value;
+
+    if (value) {
+        uint64_t expire = (flags & TFD_TIMER_ABSTIME) ? value : timer_deadline(now, value);
+        ret = arm_timer(&tfd->timer, expire);
+        if (ret < 0) {
+            cancel_timer(&tfd->timer);
+            tfd->armed = false;
+        }
+    }
+
+    unlock(&hdl->lock);
+out:
+    put_handle(hdl);
+    return ret;
+}
+
+int shim_do_timerfd_gettime(int ufd, struct __kernel_itimerspec* otmr) {
+    if (!otmr || test_user_memory(otmr, sizeof(*otmr), true))
+        return -EFAULT;
+
+    int ret = 0;
+    struct shim_handle* hdl = get_timerfd_handle(ufd, &ret);
+    if (!hdl)
+        return ret;
+
+    uint64_t now = DkSystemTimeQuery();
+    if ((int64_t)now < 0) {
+        ret = -PAL_ERRNO;
+    } else {
+        lock(&hdl->lock);
+        timerfd_get_locked(hdl, now, otmr);
+        unlock(&hdl->lock);
+    }
+
+    put_handle(hdl);
+    return ret;
+}
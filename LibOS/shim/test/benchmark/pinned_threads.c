@@ -0,0 +1,116 @@
+/* Measures throughput of per-CPU data structures (the pattern used by jemalloc/tcmalloc arenas and
+ * shard-per-core servers) accessed by several threads. Every thread repeatedly looks up its current
+ * CPU via sched_getcpu() and updates the counter of that CPU. Unless threads are pinned to distinct
+ * CPUs (pass "pin" as the second argument), several threads may share a counter and bounce its
+ * cache line. */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define NTRIES      1000000
+#define MAX_THREADS 64
+#define CACHE_LINE  64
+
+struct percpu_counter {
+    _Atomic unsigned long value;
+    char pad[CACHE_LINE - sizeof(unsigned long)];
+} __attribute__((aligned(CACHE_LINE)));
+
+static struct percpu_counter counters[CPU_SETSIZE];
+static int ncpus;
+static int cpus[CPU_SETSIZE];
+static int pin;
+static int misplaced[MAX_THREADS];
+
+static void* worker(void* arg) {
+    int idx = (int)(long)arg;
+    int target = cpus[idx % ncpus];
+
+    if (pin) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(target, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            perror("sched_setaffinity");
+            exit(1);
+        }
+    }
+
+    for (int count = 0; count < NTRIES; count++) {
+        int cpu = sched_getcpu();
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            perror("sched_getcpu");
+            exit(1);
+        }
+        if (pin && cpu != target)
+            misplaced[idx]++;
+        atomic_fetch_add_explicit(&counters[cpu].value, 1, memory_order_relaxed);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    int nthreads = 4;
+    pthread_t threads[MAX_THREADS];
+
+    if (argc >= 2) {
+        nthreads = atoi(argv[1]);
+        if (nthreads <= 0 || nthreads > MAX_THREADS)
+            return 1;
+    }
+    if (argc >= 3)
+        pin = !strcmp(argv[2], "pin");
+
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        perror("sched_getaffinity");
+        return 1;
+    }
+    for (int i = 0; i < CPU_SETSIZE; i++)
+        if (CPU_ISSET(i, &set))
+            cpus[ncpus++] = i;
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    for (int i = 0; i < nthreads; i++) {
+        if (pthread_create(&threads[i], NULL, worker, (void*)(long)i)) {
+            printf("pthread_create failed\n");
+            return 1;
+        }
+    }
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(threads[i], NULL);
+
+    gettimeofday(&end, NULL);
+
+    unsigned long sum = 0;
+    int used_cpus = 0;
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+        sum += counters[i].value;
+        used_cpus += !!counters[i].value;
+    }
+    if (sum != (unsigned long)NTRIES * nthreads) {
+        printf("lost updates: %lu\n", sum);
+        return 1;
+    }
+
+    int total_misplaced = 0;
+    for (int i = 0; i < nthreads; i++)
+        total_misplaced += misplaced[i];
+
+    unsigned long long total = (end.tv_sec * 1000000ULL + end.tv_usec)
+                               - (start.tv_sec * 1000000ULL + start.tv_usec);
+    printf("%d %s threads on %d CPUs (%d CPUs used, %d misplaced updates): "
+           "throughput = %lf updates/second\n",
+           nthreads, pin ? "pinned" : "unpinned", ncpus, used_cpus, total_misplaced,
+           1.0 * sum * 1000000 / total);
+
+    return 0;
+}
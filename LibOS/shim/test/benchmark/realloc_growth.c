@@ -0,0 +1,44 @@
+/* Measures growing a buffer with realloc() step by step up to a given size (in MB, default 1024),
+ * touching every new page, as vectors and hash tables do. glibc serves large chunks with mmap()
+ * and grows them with mremap(), so this mostly measures the cost of mremap(). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define STEP (1024 * 1024)
+
+int main(int argc, char** argv) {
+    size_t max_size = 1024UL * STEP;
+
+    if (argc >= 2) {
+        max_size = strtoul(argv[1], NULL, 10) * STEP;
+        if (!max_size)
+            return 1;
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    char* buf = NULL;
+    for (size_t size = STEP; size <= max_size; size += STEP) {
+        char* new_buf = realloc(buf, size);
+        if (!new_buf) {
+            printf("realloc to %zu bytes failed\n", size);
+            free(buf);
+            return 1;
+        }
+        buf = new_buf;
+        memset(buf + size - STEP, 1, STEP);
+    }
+    free(buf);
+
+    gettimeofday(&end, NULL);
+
+    unsigned long long total = (end.tv_sec * 1000000ULL + end.tv_usec)
+                               - (start.tv_sec * 1000000ULL + start.tv_usec);
+    printf("grown to %zu MB in %zu steps: %llu microseconds\n", max_size / STEP, max_size / STEP,
+           total);
+    return 0;
+}
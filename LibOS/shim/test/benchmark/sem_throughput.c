@@ -0,0 +1,103 @@
+/* Measures throughput of SysV semaphore operations done concurrently by several processes. Every
+ * process repeatedly locks and unlocks a semaphore shared by all of them (a pattern common in
+ * databases), so each semop() is contended by all other processes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define NTRIES     10000
+#define TEST_TIMES 64
+
+int pids[TEST_TIMES];
+
+static int do_semop(int semid, unsigned short num, short op) {
+    struct sembuf buf = {.sem_num = num, .sem_op = op, .sem_flg = 0};
+    return semop(semid, &buf, 1);
+}
+
+int main(int argc, char** argv) {
+    int times = 4;
+
+    if (argc >= 2) {
+        times = atoi(argv[1]);
+        if (times <= 0 || times > TEST_TIMES)
+            return 1;
+    }
+
+    /* semaphore 0 is the lock, semaphore 1 is the start barrier */
+    int semid = semget(IPC_PRIVATE, 2, 0600 | IPC_CREAT);
+    if (semid < 0) {
+        perror("semget");
+        return 1;
+    }
+
+    if (do_semop(semid, 0, 1) < 0) {
+        perror("semop");
+        return 1;
+    }
+
+    for (int i = 0; i < times; i++) {
+        pids[i] = fork();
+
+        if (pids[i] < 0) {
+            perror("fork");
+            return 1;
+        }
+
+        if (pids[i] == 0) {
+            if (do_semop(semid, 1, -1) < 0) {
+                perror("semop");
+                exit(1);
+            }
+
+            for (int count = 0; count < NTRIES; count++) {
+                if (do_semop(semid, 0, -1) < 0 || do_semop(semid, 0, 1) < 0) {
+                    perror("semop");
+                    exit(1);
+                }
+            }
+            exit(0);
+        }
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    struct sembuf start_buf = {.sem_num = 1, .sem_op = times, .sem_flg = 0};
+    if (semop(semid, &start_buf, 1) < 0) {
+        perror("semop");
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 0; i < times; i++) {
+        int status;
+        if (waitpid(pids[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+            failed = 1;
+    }
+
+    gettimeofday(&end, NULL);
+
+    if (semctl(semid, 0, IPC_RMID) < 0) {
+        perror("semctl");
+        return 1;
+    }
+
+    if (failed) {
+        printf("some child processes failed\n");
+        return 1;
+    }
+
+    unsigned long long total = (end.tv_sec * 1000000ULL + end.tv_usec)
+                               - (start.tv_sec * 1000000ULL + start.tv_usec);
+    unsigned long long nops = 2ULL * NTRIES * times;
+    printf("%d processes do %llu semop: throughput = %lf ops/second, latency = %lf microseconds\n",
+           times, nops, 1.0 * nops * 1000000 / total, 1.0 * total / nops);
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+/* Measures latency of creating and joining a thread which exits immediately (a pattern common in
+ * thread-per-request servers). Several threads can be created at once before joining them. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#define NTRIES      10000
+#define MAX_THREADS 64
+
+static void* thread_func(void* arg) {
+    return arg;
+}
+
+int main(int argc, char** argv) {
+    int nthreads = 1;
+    pthread_t threads[MAX_THREADS];
+
+    if (argc >= 2) {
+        nthreads = atoi(argv[1]);
+        if (nthreads <= 0 || nthreads > MAX_THREADS)
+            return 1;
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    for (int count = 0; count < NTRIES; count++) {
+        for (int i = 0; i < nthreads; i++) {
+            if (pthread_create(&threads[i], NULL, thread_func, NULL)) {
+                printf("pthread_create failed\n");
+                return 1;
+            }
+        }
+
+        for (int i = 0; i < nthreads; i++) {
+            if (pthread_join(threads[i], NULL)) {
+                printf("pthread_join failed\n");
+                return 1;
+            }
+        }
+    }
+
+    gettimeofday(&end, NULL);
+
+    unsigned long long total = (end.tv_sec * 1000000ULL + end.tv_usec)
+                               - (start.tv_sec * 1000000ULL + start.tv_usec);
+    unsigned long long nthr = 1ULL * NTRIES * nthreads;
+    printf("%llu threads created and joined (%d at once): latency = %lf microseconds\n",
+           nthr, nthreads, 1.0 * total / nthr);
+
+    return 0;
+}
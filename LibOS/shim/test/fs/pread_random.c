@@ -0,0 +1,141 @@
+#include "common.h"
+
+#include <pthread.h>
+#include <sys/uio.h>
+
+#define BLOCK_SIZE   4096
+#define FILE_BLOCKS  4096
+#define MAX_THREADS  64
+
+/* every 8-byte word of the file contains its own offset, so any block can be verified */
+static void fill_block(uint64_t* block, off_t offset) {
+    for (size_t i = 0; i < BLOCK_SIZE / sizeof(uint64_t); i++)
+        block[i] = offset + i * sizeof(uint64_t);
+}
+
+static bool check_block(const uint64_t* block, off_t offset) {
+    for (size_t i = 0; i < BLOCK_SIZE / sizeof(uint64_t); i++)
+        if (block[i] != offset + i * sizeof(uint64_t))
+            return false;
+    return true;
+}
+
+struct reader_args {
+    const char* path;
+    int fd;
+    size_t reads;
+    unsigned int seed;
+};
+
+static void* reader(void* arg) {
+    struct reader_args* args = arg;
+    uint64_t block[BLOCK_SIZE / sizeof(uint64_t)];
+
+    for (size_t i = 0; i < args->reads; i++) {
+        off_t offset = (off_t)(rand_r(&args->seed) % FILE_BLOCKS) * BLOCK_SIZE;
+        ssize_t ret = pread(args->fd, block, BLOCK_SIZE, offset);
+        if (ret != BLOCK_SIZE)
+            fatal_error("pread(%s) at %ld returned %zd: %s\n", args->path, offset, ret,
+                        strerror(errno));
+        if (!check_block(block, offset))
+            fatal_error("pread(%s) at %ld returned wrong data\n", args->path, offset);
+    }
+    return NULL;
+}
+
+static void write_file(const char* path, int fd) {
+    uint64_t block1[BLOCK_SIZE / sizeof(uint64_t)];
+    uint64_t block2[BLOCK_SIZE / sizeof(uint64_t)];
+
+    /* write the file backwards, two blocks at a time, without ever moving the file position */
+    for (off_t blk = FILE_BLOCKS - 2; blk >= 0; blk -= 2) {
+        fill_block(block1, blk * BLOCK_SIZE);
+        fill_block(block2, (blk + 1) * BLOCK_SIZE);
+        struct iovec iov[2] = {
+            { .iov_base = block1, .iov_len = BLOCK_SIZE },
+            { .iov_base = block2, .iov_len = BLOCK_SIZE },
+        };
+        ssize_t ret = pwritev(fd, iov, 2, blk * BLOCK_SIZE);
+        if (ret != 2 * BLOCK_SIZE)
+            fatal_error("pwritev(%s) returned %zd: %s\n", path, ret, strerror(errno));
+    }
+    printf("pwritev(%s) OK\n", path);
+
+    fill_block(block1, 0);
+    if (pwrite(fd, block1, BLOCK_SIZE, 0) != BLOCK_SIZE)
+        fatal_error("pwrite(%s) failed: %s\n", path, strerror(errno));
+    printf("pwrite(%s) OK\n", path);
+
+    if (tell_fd(path, fd) != 0)
+        fatal_error("pwrite(%s) moved the file position\n", path);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size != (off_t)FILE_BLOCKS * BLOCK_SIZE)
+        fatal_error("File %s has a wrong size after pwrite\n", path);
+}
+
+static void check_file(const char* path, int fd) {
+    uint64_t block1[BLOCK_SIZE / sizeof(uint64_t)];
+    uint64_t block2[BLOCK_SIZE / sizeof(uint64_t)];
+
+    off_t offset = (off_t)(FILE_BLOCKS / 2) * BLOCK_SIZE;
+    struct iovec iov[2] = {
+        { .iov_base = block1, .iov_len = BLOCK_SIZE },
+        { .iov_base = block2, .iov_len = BLOCK_SIZE },
+    };
+    if (preadv(fd, iov, 2, offset) != 2 * BLOCK_SIZE || !check_block(block1, offset) ||
+            !check_block(block2, offset + BLOCK_SIZE))
+        fatal_error("preadv(%s) failed\n", path);
+    printf("preadv(%s) OK\n", path);
+
+    /* reads at the end of the file are short */
+    offset = (off_t)FILE_BLOCKS * BLOCK_SIZE - BLOCK_SIZE / 2;
+    if (pread(fd, block1, BLOCK_SIZE, offset) != BLOCK_SIZE / 2)
+        fatal_error("pread(%s) at the end of file is not short\n", path);
+    if (pread(fd, block1, BLOCK_SIZE, offset + BLOCK_SIZE) != 0)
+        fatal_error("pread(%s) past the end of file did not return 0\n", path);
+
+    if (tell_fd(path, fd) != 0)
+        fatal_error("pread(%s) moved the file position\n", path);
+    printf("pread(%s) OK\n", path);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4)
+        fatal_error("Usage: %s <file_path> <threads> <reads_per_thread>\n", argv[0]);
+
+    setup();
+
+    const char* path = argv[1];
+    size_t threads = strtoul(argv[2], NULL, 10);
+    size_t reads = strtoul(argv[3], NULL, 10);
+    if (threads == 0 || threads > MAX_THREADS)
+        fatal_error("Number of threads must be between 1 and %d\n", MAX_THREADS);
+
+    int fd = open_output_fd(path, /*rdwr=*/true);
+    write_file(path, fd);
+    check_file(path, fd);
+
+    pthread_t tids[MAX_THREADS];
+    struct reader_args args[MAX_THREADS];
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < threads; i++) {
+        args[i] = (struct reader_args){
+            .path = path, .fd = fd, .reads = reads, .seed = rand()
+        };
+        if (pthread_create(&tids[i], NULL, reader, &args[i]) != 0)
+            fatal_error("pthread_create failed\n");
+    }
+    for (size_t i = 0; i < threads; i++)
+        pthread_join(tids[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("random pread(%s) %zu threads OK: %.0f reads/s, %.1f MB/s\n", path, threads,
+           threads * reads / secs, threads * reads * (double)BLOCK_SIZE / secs / 1e6);
+
+    close_fd(path, fd);
+    return 0;
+}
@@ -94,6 +94,17 @@ class TC_00_FileSystem(RegressionTestCase):
         self.assertIn('compare(' + file_path + ') RW OK', stdout)
         self.assertIn('close(' + file_path + ') RW OK', stdout)
 
+    def test_111_pread_random(self):
+        file_path = os.path.join(self.OUTPUT_DIR, 'test_111') # new file to be created
+        stdout, stderr = self.run_binary(['pread_random', file_path, '8', '1000'])
+        self.assertNotIn('ERROR: ', stderr)
+        self.assertEqual(os.stat(file_path).st_size, 4096 * 4096)
+        self.assertIn('pwritev(' + file_path + ') OK', stdout)
+        self.assertIn('pwrite(' + file_path + ') OK', stdout)
+        self.assertIn('preadv(' + file_path + ') OK', stdout)
+        self.assertIn('pread(' + file_path + ') OK', stdout)
+        self.assertIn('random pread(' + file_path + ') 8 threads OK', stdout)
+
     def verify_seek_tell(self, stdout, stderr, input_path, output_path_1, output_path_2, size):
         self.assertNotIn('ERROR: ', stderr)
         self.assertIn('open(' + input_path + ') input OK', stdout)
@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Threads read() from their own descriptors while the main thread keeps growing the descriptor
+ * table and opening, duplicating and closing other descriptors. */
+
+#define THREADS      8
+#define READS        20000
+#define CHURN_FDS    200
+#define BUF_SIZE     4096
+
+struct reader {
+    pthread_t tid;
+    int fd;
+    int ret;
+};
+
+static void* reader_thread(void* arg) {
+    struct reader* r = arg;
+    char buf[BUF_SIZE];
+
+    for (size_t i = 0; i < READS; i++) {
+        memset(buf, 'x', sizeof(buf));
+        if (read(r->fd, buf, sizeof(buf)) != sizeof(buf)) {
+            perror("read");
+            r->ret = -1;
+            return NULL;
+        }
+        if (buf[0] || buf[sizeof(buf) - 1]) {
+            printf("read returned wrong data\n");
+            r->ret = -1;
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static int churn(void) {
+    int fds[CHURN_FDS];
+
+    for (size_t i = 0; i < CHURN_FDS; i++) {
+        fds[i] = open("/dev/null", O_RDONLY);
+        if (fds[i] < 0) {
+            perror("open");
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < CHURN_FDS; i += 2) {
+        if (dup2(fds[i], fds[i + 1]) != fds[i + 1]) {
+            perror("dup2");
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < CHURN_FDS; i++)
+        close(fds[i]);
+    return 0;
+}
+
+int main(void) {
+    struct reader readers[THREADS];
+
+    for (size_t i = 0; i < THREADS; i++) {
+        readers[i].fd = open("/dev/zero", O_RDONLY);
+        if (readers[i].fd < 0) {
+            perror("open /dev/zero");
+            return 1;
+        }
+        readers[i].ret = 0;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < THREADS; i++) {
+        if (pthread_create(&readers[i].tid, NULL, reader_thread, &readers[i]) != 0) {
+            printf("pthread_create failed\n");
+            return 1;
+        }
+    }
+
+    int ret = 0;
+    for (size_t i = 0; i < 20 && ret == 0; i++)
+        ret = churn();
+
+    for (size_t i = 0; i < THREADS; i++) {
+        pthread_join(readers[i].tid, NULL);
+        if (readers[i].ret < 0)
+            ret = -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (ret < 0)
+        return 1;
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d threads: %.0f reads/s\n", THREADS, THREADS * READS / secs);
+
+    for (size_t i = 0; i < THREADS; i++)
+        close(readers[i].fd);
+
+    puts("Test successful!");
+    return 0;
+}
@@ -0,0 +1,290 @@
+/* Test of flock() and of the fcntl() record locks (F_SETLK, F_SETLKW, F_GETLK and their OFD
+ * variants), within a process and across fork, and a benchmark of the latency of acquiring and
+ * releasing a lock, uncontended and contended by another thread or process. */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_FILE   "tmp/file_lock"
+#define BENCH_ITERS 100000
+#define PING_ITERS  10000
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("check failed at line %d: %s (errno %d)\n", __LINE__,   \
+                   #cond, errno);                                           \
+            exit(1);                                                        \
+        }                                                                   \
+    } while (0)
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int set_lock(int fd, int cmd, short type, off_t start, off_t len) {
+    struct flock fl = {
+        .l_type   = type,
+        .l_whence = SEEK_SET,
+        .l_start  = start,
+        .l_len    = len,
+    };
+    return fcntl(fd, cmd, &fl);
+}
+
+/* Returns the type of the lock F_GETLK/F_OFD_GETLK reports for a `type` lock on [start, +len). */
+static short get_lock(int fd, int cmd, short type, off_t start, off_t len, struct flock* fl) {
+    *fl = (struct flock){
+        .l_type   = type,
+        .l_whence = SEEK_SET,
+        .l_start  = start,
+        .l_len    = len,
+    };
+    CHECK(fcntl(fd, cmd, fl) == 0);
+    return fl->l_type;
+}
+
+static void test_flock(void) {
+    int fd1 = open(TEST_FILE, O_RDWR);
+    int fd2 = open(TEST_FILE, O_RDWR);
+    CHECK(fd1 >= 0 && fd2 >= 0);
+
+    CHECK(flock(fd1, LOCK_SH) == 0);
+    CHECK(flock(fd2, LOCK_SH | LOCK_NB) == 0);
+    CHECK(flock(fd2, LOCK_EX | LOCK_NB) == -1 && errno == EWOULDBLOCK);
+    CHECK(flock(fd1, LOCK_UN) == 0);
+    CHECK(flock(fd2, LOCK_EX | LOCK_NB) == 0);
+    CHECK(flock(fd1, LOCK_SH | LOCK_NB) == -1 && errno == EWOULDBLOCK);
+
+    /* a dup shares the lock, and only the last close of the description releases it */
+    int fd3 = dup(fd2);
+    CHECK(fd3 >= 0);
+    CHECK(close(fd2) == 0);
+    CHECK(flock(fd1, LOCK_EX | LOCK_NB) == -1 && errno == EWOULDBLOCK);
+    CHECK(close(fd3) == 0);
+    CHECK(flock(fd1, LOCK_EX | LOCK_NB) == 0);
+
+    CHECK(flock(fd1, LOCK_EX | LOCK_SH) == -1 && errno == EINVAL);
+    CHECK(flock(-1, LOCK_EX) == -1 && errno == EBADF);
+    CHECK(close(fd1) == 0);
+
+    printf("flock OK\n");
+}
+
+static void test_posix(void) {
+    int fd1 = open(TEST_FILE, O_RDWR);
+    int fd2 = open(TEST_FILE, O_RDWR);
+    int ofd = open(TEST_FILE, O_RDWR);
+    CHECK(fd1 >= 0 && fd2 >= 0 && ofd >= 0);
+    struct flock fl;
+
+    /* write lock [0, 100), then read lock [40, 60) in its middle splits it in three */
+    CHECK(set_lock(fd1, F_SETLK, F_WRLCK, 0, 100) == 0);
+    CHECK(set_lock(fd1, F_SETLK, F_RDLCK, 40, 20) == 0);
+    CHECK(get_lock(ofd, F_OFD_GETLK, F_RDLCK, 0, 0, &fl) == F_WRLCK);
+    CHECK(fl.l_start == 0 && fl.l_len == 40 && fl.l_pid == getpid());
+    CHECK(get_lock(ofd, F_OFD_GETLK, F_RDLCK, 40, 20, &fl) == F_UNLCK);
+    CHECK(get_lock(ofd, F_OFD_GETLK, F_WRLCK, 50, 0, &fl) == F_RDLCK);
+    CHECK(fl.l_start == 40 && fl.l_len == 20);
+    CHECK(get_lock(ofd, F_OFD_GETLK, F_RDLCK, 60, 1000, &fl) == F_WRLCK);
+    CHECK(fl.l_start == 60 && fl.l_len == 40);
+
+    /* the locks of the process do not conflict with each other, on any descriptor */
+    CHECK(get_lock(fd2, F_GETLK, F_WRLCK, 0, 0, &fl) == F_UNLCK);
+    CHECK(set_lock(fd2, F_SETLK, F_WRLCK, 40, 20) == 0);
+    CHECK(get_lock(ofd, F_OFD_GETLK, F_RDLCK, 0, 0, &fl) == F_WRLCK);
+    CHECK(fl.l_start == 0 && fl.l_len == 100);
+
+    /* but they do with OFD locks */
+    CHECK(set_lock(ofd, F_OFD_SETLK, F_RDLCK, 99, 1) == -1 && errno == EAGAIN);
+    CHECK(set_lock(ofd, F_OFD_SETLK, F_RDLCK, 100, 0) == 0);
+    CHECK(set_lock(fd1, F_SETLK, F_WRLCK, 100, 1) == -1 && errno == EAGAIN);
+    CHECK(get_lock(fd1, F_GETLK, F_WRLCK, 100, 10, &fl) == F_RDLCK);
+    CHECK(fl.l_start == 100 && fl.l_len == 0 && fl.l_pid == -1);
+
+    /* closing any descriptor of the file releases the locks of the process */
+    CHECK(close(fd2) == 0);
+    CHECK(get_lock(ofd, F_OFD_GETLK, F_WRLCK, 0, 100, &fl) == F_UNLCK);
+    CHECK(set_lock(ofd, F_OFD_SETLK, F_WRLCK, 0, 100) == 0);
+    CHECK(set_lock(ofd, F_OFD_SETLK, F_UNLCK, 0, 0) == 0);
+
+    /* negative lengths lock the bytes before l_start; SEEK_CUR is relative to the offset */
+    CHECK(lseek(fd1, 10, SEEK_SET) == 10);
+    fl = (struct flock){.l_type = F_WRLCK, .l_whence = SEEK_CUR, .l_start = 10, .l_len = -5};
+    CHECK(fcntl(fd1, F_SETLK, &fl) == 0);
+    CHECK(get_lock(ofd, F_OFD_GETLK, F_RDLCK, 0, 0, &fl) == F_WRLCK);
+    CHECK(fl.l_start == 15 && fl.l_len == 5);
+
+    /* invalid arguments */
+    CHECK(set_lock(fd1, F_SETLK, F_WRLCK, -1, 1) == -1 && errno == EINVAL);
+    fl = (struct flock){.l_type = F_RDLCK, .l_whence = SEEK_SET, .l_pid = 1};
+    CHECK(fcntl(ofd, F_OFD_SETLK, &fl) == -1 && errno == EINVAL);
+    fl = (struct flock){.l_type = F_UNLCK, .l_whence = SEEK_SET};
+    CHECK(fcntl(fd1, F_GETLK, &fl) == -1 && errno == EINVAL);
+    CHECK(close(fd1) == 0);
+
+    int rdonly = open(TEST_FILE, O_RDONLY);
+    CHECK(rdonly >= 0);
+    CHECK(set_lock(rdonly, F_SETLK, F_WRLCK, 0, 0) == -1 && errno == EBADF);
+    CHECK(close(rdonly) == 0);
+    CHECK(close(ofd) == 0);
+
+    printf("fcntl locks OK\n");
+}
+
+static void test_fork(void) {
+    int fd = open(TEST_FILE, O_RDWR);
+    CHECK(fd >= 0);
+    CHECK(set_lock(fd, F_SETLK, F_WRLCK, 0, 10) == 0);
+    CHECK(flock(fd, LOCK_EX) == 0);
+
+    int pipefd[2];
+    CHECK(pipe(pipefd) == 0);
+
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+        struct flock fl;
+        int cfd = open(TEST_FILE, O_RDWR);
+        CHECK(cfd >= 0);
+        CHECK(set_lock(cfd, F_SETLK, F_RDLCK, 5, 1) == -1 && errno == EAGAIN);
+        CHECK(get_lock(cfd, F_GETLK, F_RDLCK, 0, 0, &fl) == F_WRLCK);
+        CHECK(fl.l_start == 0 && fl.l_len == 10);
+        CHECK(set_lock(cfd, F_SETLK, F_WRLCK, 10, 0) == 0);
+        CHECK(flock(cfd, LOCK_SH | LOCK_NB) == -1 && errno == EWOULDBLOCK);
+
+        /* tell the parent to release the lock, then wait for it */
+        char c = 0;
+        CHECK(write(pipefd[1], &c, 1) == 1);
+        CHECK(set_lock(cfd, F_SETLKW, F_WRLCK, 0, 10) == 0);
+        exit(0);
+    }
+
+    char c;
+    CHECK(read(pipefd[0], &c, 1) == 1);
+    CHECK(set_lock(fd, F_SETLK, F_WRLCK, 10, 1) == -1 && errno == EAGAIN);
+    CHECK(set_lock(fd, F_SETLK, F_UNLCK, 0, 10) == 0);
+
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    /* the locks of the child went away with it */
+    CHECK(set_lock(fd, F_SETLK, F_WRLCK, 0, 0) == 0);
+    CHECK(close(fd) == 0);
+    close(pipefd[0]);
+    close(pipefd[1]);
+
+    printf("locks across fork OK\n");
+}
+
+struct pinger {
+    int fd;
+    int cmd;
+};
+
+static void* ping_thread(void* arg) {
+    struct pinger* p = arg;
+    for (int i = 0; i < PING_ITERS; i++) {
+        if (p->cmd)
+            CHECK(set_lock(p->fd, p->cmd, F_WRLCK, 0, 1) == 0 &&
+                  set_lock(p->fd, p->cmd, F_UNLCK, 0, 1) == 0);
+        else
+            CHECK(flock(p->fd, LOCK_EX) == 0 && flock(p->fd, LOCK_UN) == 0);
+    }
+    return NULL;
+}
+
+/* Returns the ns per lock and unlock of two threads, each with its own open file description,
+ * which take turns on the same lock (`cmd` is F_OFD_SETLKW, or 0 for flock()). */
+static double bench_threads(int cmd) {
+    struct pinger p[2];
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        p[i] = (struct pinger){.fd = open(TEST_FILE, O_RDWR), .cmd = cmd};
+        CHECK(p[i].fd >= 0);
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < 2; i++)
+        CHECK(pthread_create(&threads[i], NULL, ping_thread, &p[i]) == 0);
+    for (int i = 0; i < 2; i++)
+        CHECK(pthread_join(threads[i], NULL) == 0);
+    uint64_t elapsed = now_ns() - start;
+
+    for (int i = 0; i < 2; i++)
+        close(p[i].fd);
+    return (double)elapsed / (2 * PING_ITERS);
+}
+
+static double bench_uncontended(int fd, int cmd) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCH_ITERS; i++) {
+        if (cmd)
+            CHECK(set_lock(fd, cmd, F_WRLCK, 0, 1) == 0 && set_lock(fd, cmd, F_UNLCK, 0, 1) == 0);
+        else
+            CHECK(flock(fd, LOCK_EX) == 0 && flock(fd, LOCK_UN) == 0);
+    }
+    return (double)(now_ns() - start) / BENCH_ITERS;
+}
+
+static void bench(void) {
+    int fd = open(TEST_FILE, O_RDWR);
+    CHECK(fd >= 0);
+
+    double posix = bench_uncontended(fd, F_SETLK);
+    double ofd   = bench_uncontended(fd, F_OFD_SETLK);
+    double whole = bench_uncontended(fd, 0);
+    printf("uncontended lock+unlock: fcntl %.0f ns, OFD %.0f ns, flock %.0f ns\n", posix, ofd,
+           whole);
+
+    double ofd_threads   = bench_threads(F_OFD_SETLKW);
+    double flock_threads = bench_threads(0);
+    printf("contended by a thread: OFD %.0f ns, flock %.0f ns\n", ofd_threads, flock_threads);
+
+    /* after a fork, the locks are placed on the host */
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    uint64_t start = now_ns();
+    for (int i = 0; i < PING_ITERS; i++)
+        CHECK(set_lock(fd, F_SETLKW, F_WRLCK, 0, 1) == 0 &&
+              set_lock(fd, F_SETLK, F_UNLCK, 0, 1) == 0);
+    uint64_t elapsed = now_ns() - start;
+    if (pid == 0)
+        exit(0);
+
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    printf("contended by a process: fcntl %.0f ns\n", (double)elapsed / PING_ITERS);
+    close(fd);
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    int fd = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0);
+    CHECK(close(fd) == 0);
+
+    test_flock();
+    test_posix();
+    test_fork();
+    bench();
+
+    unlink(TEST_FILE);
+    printf("Test successful!\n");
+    return 0;
+}
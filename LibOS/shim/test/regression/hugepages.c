@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HUGEPAGE_SIZE (2UL * 1024 * 1024)
+#define BENCH_SIZE    (256UL * 1024 * 1024)
+#define BENCH_STEPS   (4UL * 1024 * 1024)
+
+static int check_aligned(const char* msg, void* addr) {
+    if ((uintptr_t)addr % HUGEPAGE_SIZE) {
+        printf("%s: %p is not aligned to the huge page size\n", msg, addr);
+        return -1;
+    }
+    return 0;
+}
+
+static int test_mappings(void) {
+    /* large anonymous mappings are backed by huge pages because of `sys.hugepages` */
+    size_t size = 8 * HUGEPAGE_SIZE + getpagesize();
+    char* a = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (a == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    if (check_aligned("large mapping", a) < 0)
+        return -1;
+    memset(a, 'a', size);
+
+    /* explicit MAP_HUGETLB works without a hugetlbfs pool on the host */
+    char* b = mmap(NULL, HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (b == MAP_FAILED) {
+        perror("mmap(MAP_HUGETLB)");
+        return -1;
+    }
+    if (check_aligned("MAP_HUGETLB mapping", b) < 0)
+        return -1;
+    memset(b, 'b', HUGEPAGE_SIZE);
+
+    /* the memory still behaves like ordinary memory */
+    if (munmap(a + getpagesize(), getpagesize()) < 0 ||
+            mprotect(a + 2 * getpagesize(), getpagesize(), PROT_READ) < 0) {
+        perror("munmap/mprotect of a part");
+        return -1;
+    }
+    if (a[0] != 'a' || a[2 * getpagesize()] != 'a' || b[HUGEPAGE_SIZE - 1] != 'b') {
+        printf("memory contents changed\n");
+        return -1;
+    }
+
+    munmap(a, size);
+    munmap(b, HUGEPAGE_SIZE);
+
+    /* so is the program break */
+    char* brk_start = sbrk(0);
+    if (sbrk(4 * HUGEPAGE_SIZE) == (void*)-1) {
+        perror("sbrk");
+        return -1;
+    }
+    memset(brk_start, 'c', 4 * HUGEPAGE_SIZE);
+    if (sbrk(-4 * (long)HUGEPAGE_SIZE) == (void*)-1) {
+        perror("sbrk (shrink)");
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/* pointer-chasing over random pages is bound by TLB misses */
+static uint64_t bench(char* mem) {
+    uint64_t x = 88172645463325252UL;
+    uint64_t sum = 0;
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < BENCH_STEPS; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        sum += mem[(x + sum) % BENCH_SIZE];
+    }
+    uint64_t elapsed = now_ns() - start;
+    return sum == (uint64_t)-1 ? 0 : elapsed / BENCH_STEPS;
+}
+
+static int test_bench(void) {
+    char* mem = mmap(NULL, BENCH_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                     0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    memset(mem, 1, BENCH_SIZE);
+    uint64_t huge = bench(mem);
+    munmap(mem, BENCH_SIZE);
+
+    mem = mmap(NULL, BENCH_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    madvise(mem, BENCH_SIZE, MADV_NOHUGEPAGE);
+    memset(mem, 1, BENCH_SIZE);
+    uint64_t small = bench(mem);
+    munmap(mem, BENCH_SIZE);
+
+    printf("random access: %lu ns with huge pages, %lu ns without\n", huge, small);
+    return 0;
+}
+
+int main(void) {
+    if (test_mappings() < 0 || test_bench() < 0)
+        return 1;
+
+    puts("Test successful!");
+    return 0;
+}
@@ -0,0 +1,180 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static size_t g_page_size;
+
+static int check_zero(const char* msg, const char* buf, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        if (buf[i]) {
+            printf("%s: memory is not zeroed at offset %zu\n", msg, i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int test_anonymous(void) {
+    char* a = mmap(NULL, 4 * g_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+    if (a == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    memset(a, 'a', 4 * g_page_size);
+    if (madvise(a + g_page_size, 2 * g_page_size, MADV_DONTNEED) < 0) {
+        perror("madvise(MADV_DONTNEED)");
+        return -1;
+    }
+    if (check_zero("MADV_DONTNEED", a + g_page_size, 2 * g_page_size) < 0)
+        return -1;
+    if (a[0] != 'a' || a[3 * g_page_size] != 'a') {
+        printf("MADV_DONTNEED discarded memory outside of the range\n");
+        return -1;
+    }
+
+    /* after MADV_FREE the contents are undefined until written again */
+    if (madvise(a, 4 * g_page_size, MADV_FREE) < 0) {
+        perror("madvise(MADV_FREE)");
+        return -1;
+    }
+    memset(a, 'b', 4 * g_page_size);
+    if (a[0] != 'b' || a[4 * g_page_size - 1] != 'b') {
+        printf("MADV_FREE: memory written after the advice was lost\n");
+        return -1;
+    }
+
+    int hints[] = { MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL, MADV_WILLNEED, MADV_HUGEPAGE,
+                    MADV_NOHUGEPAGE };
+    for (size_t i = 0; i < sizeof(hints) / sizeof(hints[0]); i++) {
+        if (madvise(a, 4 * g_page_size, hints[i]) < 0 && errno != EINVAL) {
+            printf("madvise(%d) failed: %m\n", hints[i]);
+            return -1;
+        }
+    }
+
+    if (madvise(a + 1, g_page_size, MADV_DONTNEED) == 0 || errno != EINVAL) {
+        printf("madvise on an unaligned address did not fail with EINVAL\n");
+        return -1;
+    }
+    if (madvise(a, g_page_size, 12345) == 0 || errno != EINVAL) {
+        printf("madvise with an invalid advice did not fail with EINVAL\n");
+        return -1;
+    }
+
+    if (munmap(a + 2 * g_page_size, g_page_size) < 0) {
+        perror("munmap");
+        return -1;
+    }
+    if (madvise(a, 4 * g_page_size, MADV_WILLNEED) == 0 || errno != ENOMEM) {
+        printf("madvise on a partially unmapped range did not fail with ENOMEM\n");
+        return -1;
+    }
+
+    munmap(a, 4 * g_page_size);
+    return 0;
+}
+
+static int test_file(void) {
+    const char* path = "tmp/madvise_test";
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+
+    char* page = malloc(g_page_size);
+    if (!page)
+        return -1;
+    memset(page, 'f', g_page_size);
+    if (write(fd, page, g_page_size) != (ssize_t)g_page_size) {
+        perror("write");
+        return -1;
+    }
+    free(page);
+
+    char* m = mmap(NULL, g_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) {
+        perror("mmap file");
+        return -1;
+    }
+
+    m[0] = 'x';
+    if (madvise(m, g_page_size, MADV_DONTNEED) < 0) {
+        perror("madvise(MADV_DONTNEED) on a file mapping");
+        return -1;
+    }
+    if (m[0] != 'f') {
+        printf("MADV_DONTNEED did not restore the file contents of a private mapping\n");
+        return -1;
+    }
+
+    if (madvise(m, g_page_size, MADV_FREE) == 0 || errno != EINVAL) {
+        printf("MADV_FREE on a file mapping did not fail with EINVAL\n");
+        return -1;
+    }
+
+    munmap(m, g_page_size);
+    close(fd);
+    unlink(path);
+    return 0;
+}
+
+static int test_dontfork(void) {
+    char* a = mmap(NULL, 2 * g_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+    if (a == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+
+    if (madvise(a, g_page_size, MADV_DONTFORK) < 0) {
+        perror("madvise(MADV_DONTFORK)");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) {
+        /* the first page must not exist in the child, the second one must */
+        if (mprotect(a, g_page_size, PROT_READ) == 0 || errno != ENOMEM)
+            exit(1);
+        if (mprotect(a + g_page_size, g_page_size, PROT_READ) < 0)
+            exit(2);
+        exit(0);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("MADV_DONTFORK was not honored in the child (status %d)\n", status);
+        return -1;
+    }
+
+    munmap(a, 2 * g_page_size);
+    return 0;
+}
+
+int main(void) {
+    g_page_size = getpagesize();
+
+    if (test_anonymous() < 0 || test_file() < 0 || test_dontfork() < 0)
+        return 1;
+
+    puts("Test successful!");
+    return 0;
+}
@@ -0,0 +1,394 @@
+/* Test of POSIX message queues, and a benchmark of the latency (ping-pong between two processes)
+ * and throughput (one-way stream) of message queues versus pipes. */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define QUEUE_NAME "/graphene_test_mqueue"
+#define PING_NAME  "/graphene_test_mqueue_ping"
+#define PONG_NAME  "/graphene_test_mqueue_pong"
+#define MSG_SIZE   64
+#define ROUNDS     10000
+#define MESSAGES   100000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int test_basic(void) {
+    mq_unlink(QUEUE_NAME);
+
+    struct mq_attr attr = {.mq_maxmsg = 4, .mq_msgsize = MSG_SIZE};
+    mqd_t mq = mq_open(QUEUE_NAME, O_RDWR | O_CREAT | O_EXCL | O_NONBLOCK, 0600, &attr);
+    if (mq == (mqd_t)-1) {
+        perror("mq_open");
+        return -1;
+    }
+    if (mq_open(QUEUE_NAME, O_RDWR | O_CREAT | O_EXCL, 0600, &attr) != (mqd_t)-1 ||
+            errno != EEXIST) {
+        printf("mq_open of an existing queue with O_EXCL did not fail with EEXIST\n");
+        return -1;
+    }
+
+    /* messages are received by descending priority, in FIFO order within a priority */
+    static const struct {
+        const char* text;
+        unsigned int prio;
+    } msgs[] = {{"low", 1}, {"high1", 5}, {"high2", 5}, {"mid", 3}};
+    static const int order[] = {1, 2, 3, 0};
+
+    for (size_t i = 0; i < 4; i++) {
+        if (mq_send(mq, msgs[i].text, strlen(msgs[i].text) + 1, msgs[i].prio) < 0) {
+            perror("mq_send");
+            return -1;
+        }
+    }
+    if (mq_send(mq, "full", 5, 0) == 0 || errno != EAGAIN) {
+        printf("mq_send to a full non-blocking queue did not fail with EAGAIN\n");
+        return -1;
+    }
+
+    struct mq_attr old_attr;
+    attr.mq_flags = 0;
+    if (mq_setattr(mq, &attr, &old_attr) < 0) {
+        perror("mq_setattr");
+        return -1;
+    }
+    if (old_attr.mq_flags != O_NONBLOCK || old_attr.mq_maxmsg != 4 ||
+            old_attr.mq_msgsize != MSG_SIZE || old_attr.mq_curmsgs != 4) {
+        printf("mq_getattr returned flags %ld, maxmsg %ld, msgsize %ld, curmsgs %ld\n",
+               old_attr.mq_flags, old_attr.mq_maxmsg, old_attr.mq_msgsize, old_attr.mq_curmsgs);
+        return -1;
+    }
+
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_nsec += 10000000;
+    if (timeout.tv_nsec >= 1000000000) {
+        timeout.tv_sec++;
+        timeout.tv_nsec -= 1000000000;
+    }
+    if (mq_timedsend(mq, "full", 5, 0, &timeout) == 0 || errno != ETIMEDOUT) {
+        printf("mq_timedsend to a full queue did not time out\n");
+        return -1;
+    }
+    if (mq_send(mq, "big", MSG_SIZE + 1, 0) == 0 || errno != EMSGSIZE) {
+        printf("mq_send of a too long message did not fail with EMSGSIZE\n");
+        return -1;
+    }
+
+    char buf[MSG_SIZE];
+    if (mq_receive(mq, buf, MSG_SIZE - 1, NULL) >= 0 || errno != EMSGSIZE) {
+        printf("mq_receive into a too short buffer did not fail with EMSGSIZE\n");
+        return -1;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        unsigned int prio;
+        ssize_t ret = mq_receive(mq, buf, sizeof(buf), &prio);
+        size_t exp = order[i];
+        if (ret != (ssize_t)strlen(msgs[exp].text) + 1 || strcmp(buf, msgs[exp].text) ||
+                prio != msgs[exp].prio) {
+            printf("mq_receive #%zu returned %zd (\"%s\", priority %u)\n", i, ret,
+                   ret > 0 ? buf : "", prio);
+            return -1;
+        }
+    }
+    if (mq_timedreceive(mq, buf, sizeof(buf), NULL, &timeout) >= 0 || errno != ETIMEDOUT) {
+        printf("mq_timedreceive from an empty queue did not time out\n");
+        return -1;
+    }
+
+    mqd_t mq_ro = mq_open(QUEUE_NAME, O_RDONLY);
+    if (mq_ro == (mqd_t)-1) {
+        perror("mq_open");
+        return -1;
+    }
+    if (mq_send(mq_ro, "ro", 3, 0) == 0 || errno != EBADF) {
+        printf("mq_send on a read-only descriptor did not fail with EBADF\n");
+        return -1;
+    }
+    mq_close(mq_ro);
+
+    /* the attributes only matter if the queue is created */
+    struct mq_attr bad_attr = {.mq_maxmsg = 0, .mq_msgsize = MSG_SIZE};
+    mqd_t mq_again = mq_open(QUEUE_NAME, O_RDWR | O_CREAT, 0600, &bad_attr);
+    if (mq_again == (mqd_t)-1) {
+        perror("mq_open of an existing queue with invalid attributes");
+        return -1;
+    }
+    struct mq_attr cur_attr;
+    if (mq_getattr(mq_again, &cur_attr) < 0 || cur_attr.mq_maxmsg != attr.mq_maxmsg) {
+        printf("mq_open of an existing queue changed its attributes\n");
+        return -1;
+    }
+    mq_close(mq_again);
+
+    if (mq_open("/a/b", O_RDONLY) != (mqd_t)-1 || errno != EACCES) {
+        printf("mq_open of a name with a slash did not fail with EACCES\n");
+        return -1;
+    }
+
+    mq_close(mq);
+    if (mq_unlink(QUEUE_NAME) < 0) {
+        perror("mq_unlink");
+        return -1;
+    }
+    if (mq_open(QUEUE_NAME, O_RDONLY) != (mqd_t)-1 || errno != ENOENT) {
+        printf("mq_open of an unlinked queue did not fail with ENOENT\n");
+        return -1;
+    }
+    if (mq_open(QUEUE_NAME, O_RDWR | O_CREAT, 0600, &bad_attr) != (mqd_t)-1 || errno != EINVAL) {
+        printf("mq_open creating a queue with invalid attributes did not fail with EINVAL\n");
+        return -1;
+    }
+    printf("mqueue send/receive OK\n");
+    return 0;
+}
+
+static int test_poll_and_notify(void) {
+    mq_unlink(QUEUE_NAME);
+
+    struct mq_attr attr = {.mq_maxmsg = 4, .mq_msgsize = MSG_SIZE};
+    mqd_t mq = mq_open(QUEUE_NAME, O_RDWR | O_CREAT | O_NONBLOCK, 0600, &attr);
+    if (mq == (mqd_t)-1) {
+        perror("mq_open");
+        return -1;
+    }
+
+    int efd = epoll_create1(0);
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = mq};
+    if (efd < 0 || epoll_ctl(efd, EPOLL_CTL_ADD, mq, &event) < 0) {
+        perror("epoll");
+        return -1;
+    }
+    if (epoll_wait(efd, &event, 1, 0) != 0) {
+        printf("empty queue is ready\n");
+        return -1;
+    }
+
+    if (mq_send(mq, "x", 2, 0) < 0) {
+        perror("mq_send");
+        return -1;
+    }
+    if (epoll_wait(efd, &event, 1, 5000) != 1 || event.data.fd != mq) {
+        printf("epoll_wait did not report the queue\n");
+        return -1;
+    }
+    struct pollfd pfd = {.fd = mq, .events = POLLIN};
+    if (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLIN)) {
+        printf("poll did not report the queue\n");
+        return -1;
+    }
+
+    char buf[MSG_SIZE];
+    if (mq_receive(mq, buf, sizeof(buf), NULL) != 2) {
+        perror("mq_receive");
+        return -1;
+    }
+    if (poll(&pfd, 1, 0) != 0) {
+        printf("poll reported an empty queue\n");
+        return -1;
+    }
+
+    /* a notification is sent when a message arrives in the empty queue */
+    struct sigevent sev = {
+        .sigev_notify = SIGEV_SIGNAL,
+        .sigev_signo  = SIGUSR1,
+        .sigev_value.sival_int = 42,
+    };
+    if (mq_notify(mq, &sev) < 0) {
+        perror("mq_notify");
+        return -1;
+    }
+    if (mq_notify(mq, &sev) == 0 || errno != EBUSY) {
+        printf("second mq_notify registration did not fail with EBUSY\n");
+        return -1;
+    }
+    if (mq_send(mq, "y", 2, 0) < 0) {
+        perror("mq_send");
+        return -1;
+    }
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    siginfo_t info;
+    if (sigtimedwait(&mask, &info, &(struct timespec){.tv_sec = 5}) != SIGUSR1 ||
+            info.si_code != SI_MESGQ || info.si_value.sival_int != 42) {
+        printf("mq_notify signal was not delivered\n");
+        return -1;
+    }
+
+    /* the registration was removed by the notification */
+    if (mq_notify(mq, &sev) < 0 || mq_notify(mq, NULL) < 0) {
+        perror("mq_notify");
+        return -1;
+    }
+
+    close(efd);
+    mq_close(mq);
+    mq_unlink(QUEUE_NAME);
+    printf("mqueue poll and notify OK\n");
+    return 0;
+}
+
+/* The child echoes ROUNDS messages and then receives MESSAGES messages. */
+static int run_child(int rfd, int wfd, mqd_t ping, mqd_t pong) {
+    char buf[MSG_SIZE];
+    for (int i = 0; i < ROUNDS; i++) {
+        if (ping != (mqd_t)-1) {
+            if (mq_receive(ping, buf, sizeof(buf), NULL) != MSG_SIZE ||
+                    mq_send(pong, buf, MSG_SIZE, 0) < 0)
+                return 1;
+        } else {
+            if (read(rfd, buf, MSG_SIZE) != MSG_SIZE || write(wfd, buf, MSG_SIZE) != MSG_SIZE)
+                return 1;
+        }
+    }
+    for (int i = 0; i < MESSAGES; i++) {
+        if (ping != (mqd_t)-1) {
+            if (mq_receive(ping, buf, sizeof(buf), NULL) != MSG_SIZE)
+                return 1;
+        } else {
+            if (read(rfd, buf, MSG_SIZE) != MSG_SIZE)
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns the round-trip latency in us and the throughput in messages per second. */
+static int bench(int use_mqueue, double* latency_us, double* msgs_per_sec) {
+    int to_child[2]  = {-1, -1};
+    int to_parent[2] = {-1, -1};
+    mqd_t ping = (mqd_t)-1;
+    mqd_t pong = (mqd_t)-1;
+
+    if (use_mqueue) {
+        /* the default limit of unprivileged users on Linux */
+        struct mq_attr attr = {.mq_maxmsg = 10, .mq_msgsize = MSG_SIZE};
+        mq_unlink(PING_NAME);
+        mq_unlink(PONG_NAME);
+        ping = mq_open(PING_NAME, O_RDWR | O_CREAT, 0600, &attr);
+        pong = mq_open(PONG_NAME, O_RDWR | O_CREAT, 0600, &attr);
+        if (ping == (mqd_t)-1 || pong == (mqd_t)-1) {
+            perror("mq_open");
+            return -1;
+        }
+    } else if (pipe(to_child) < 0 || pipe(to_parent) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (use_mqueue) {
+            /* the inherited descriptor and a newly opened one refer to the same queue */
+            mq_close(pong);
+            pong = mq_open(PONG_NAME, O_WRONLY);
+            if (pong == (mqd_t)-1)
+                exit(1);
+        }
+        exit(run_child(to_child[0], to_parent[1], ping, pong));
+    }
+
+    char buf[MSG_SIZE];
+    memset(buf, 'a', sizeof(buf));
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        if (use_mqueue) {
+            if (mq_send(ping, buf, MSG_SIZE, 0) < 0 ||
+                    mq_receive(pong, buf, sizeof(buf), NULL) != MSG_SIZE) {
+                perror("mq ping-pong");
+                return -1;
+            }
+        } else {
+            if (write(to_child[1], buf, MSG_SIZE) != MSG_SIZE ||
+                    read(to_parent[0], buf, MSG_SIZE) != MSG_SIZE) {
+                perror("pipe ping-pong");
+                return -1;
+            }
+        }
+    }
+    *latency_us = (double)(now_ns() - start) / ROUNDS / 1000;
+
+    start = now_ns();
+    for (int i = 0; i < MESSAGES; i++) {
+        if (use_mqueue) {
+            if (mq_send(ping, buf, MSG_SIZE, 0) < 0) {
+                perror("mq_send");
+                return -1;
+            }
+        } else {
+            if (write(to_child[1], buf, MSG_SIZE) != MSG_SIZE) {
+                perror("write");
+                return -1;
+            }
+        }
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+        printf("benchmark child failed\n");
+        return -1;
+    }
+    *msgs_per_sec = (double)MESSAGES * 1000000000 / (now_ns() - start);
+
+    if (use_mqueue) {
+        mq_close(ping);
+        mq_close(pong);
+        mq_unlink(PING_NAME);
+        mq_unlink(PONG_NAME);
+    } else {
+        close(to_child[0]);
+        close(to_child[1]);
+        close(to_parent[0]);
+        close(to_parent[1]);
+    }
+    return 0;
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
+        perror("sigprocmask");
+        return 1;
+    }
+
+    if (test_basic() < 0 || test_poll_and_notify() < 0)
+        return 1;
+
+    double mq_latency, mq_rate, pipe_latency, pipe_rate;
+    if (bench(/*use_mqueue=*/1, &mq_latency, &mq_rate) < 0 ||
+            bench(/*use_mqueue=*/0, &pipe_latency, &pipe_rate) < 0)
+        return 1;
+    printf("%d-byte messages between processes: round trip mqueue %.2f us, pipe %.2f us; "
+           "stream mqueue %.0f msg/s, pipe %.0f msg/s\n", MSG_SIZE, mq_latency, pipe_latency,
+           mq_rate, pipe_rate);
+
+    printf("Test successful!\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t g_page_size;
+
+static void fill(char* buf, size_t pages, char seed) {
+    for (size_t i = 0; i < pages; i++)
+        memset(buf + i * g_page_size, seed + i, g_page_size);
+}
+
+static void check(const char* msg, char* buf, size_t pages, char seed) {
+    for (size_t i = 0; i < pages; i++) {
+        for (size_t j = 0; j < g_page_size; j++) {
+            if (buf[i * g_page_size + j] != (char)(seed + i)) {
+                printf("%s: wrong contents of page %zu\n", msg, i);
+                exit(1);
+            }
+        }
+    }
+}
+
+int main(void) {
+    g_page_size = getpagesize();
+
+    char* a = mmap(NULL, 4 * g_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1, 0);
+    if (a == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    fill(a, 4, 'a');
+
+    /* shrink in place */
+    char* b = mremap(a, 4 * g_page_size, 2 * g_page_size, 0);
+    if (b != a) {
+        perror("mremap shrink");
+        return 1;
+    }
+    check("shrink", b, 2, 'a');
+
+    /* make growing in place impossible, then grow with moving */
+    char* guard = mmap(b + 2 * g_page_size, g_page_size, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (guard != b + 2 * g_page_size) {
+        perror("mmap guard");
+        return 1;
+    }
+
+    char* c = mremap(b, 2 * g_page_size, 64 * g_page_size, 0);
+    if (c != MAP_FAILED || errno != ENOMEM) {
+        printf("mremap without MREMAP_MAYMOVE did not fail with ENOMEM\n");
+        return 1;
+    }
+
+    c = mremap(b, 2 * g_page_size, 64 * g_page_size, MREMAP_MAYMOVE);
+    if (c == MAP_FAILED) {
+        perror("mremap grow");
+        return 1;
+    }
+    check("grow", c, 2, 'a');
+    for (size_t i = 2 * g_page_size; i < 64 * g_page_size; i++) {
+        if (c[i]) {
+            printf("grow: new memory is not zeroed\n");
+            return 1;
+        }
+    }
+    fill(c, 64, 'A');
+
+    /* move to a fixed address */
+    char* d = mmap(NULL, 64 * g_page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (d == MAP_FAILED) {
+        perror("mmap target");
+        return 1;
+    }
+    char* e = mremap(c, 64 * g_page_size, 64 * g_page_size, MREMAP_MAYMOVE | MREMAP_FIXED, d);
+    if (e != d) {
+        perror("mremap fixed");
+        return 1;
+    }
+    check("fixed", e, 64, 'A');
+
+    if (mremap(e, g_page_size, g_page_size, MREMAP_FIXED, d + g_page_size) != MAP_FAILED ||
+            errno != EINVAL) {
+        printf("mremap with MREMAP_FIXED but without MREMAP_MAYMOVE did not fail with EINVAL\n");
+        return 1;
+    }
+
+    if (munmap(e, 64 * g_page_size) < 0 || munmap(guard, g_page_size) < 0) {
+        perror("munmap");
+        return 1;
+    }
+
+    puts("Test successful!");
+    return 0;
+}
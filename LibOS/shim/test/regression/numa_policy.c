@@ -0,0 +1,387 @@
+/* Test of mbind, set_mempolicy, get_mempolicy, move_pages, migrate_pages and /proc/self/numa_maps,
+ * and a STREAM-style benchmark (triad, one thread per NUMA node) which compares the bandwidth with
+ * the arrays of each thread bound to its own node against the arrays bound to another node. On a
+ * host with a single NUMA node both placements are the same. */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_NODES   64
+#define PAGE        4096
+#define TEST_PAGES  16
+#define STREAM_LEN  (2 * 1024 * 1024) /* doubles per array, 16 MB */
+#define STREAM_REPS 10
+
+/* glibc has no wrappers for these (they come with libnuma) */
+static long mbind(void* addr, unsigned long len, int mode, const unsigned long* nodemask,
+                  unsigned long maxnode, unsigned int flags) {
+    return syscall(SYS_mbind, addr, len, mode, nodemask, maxnode, flags);
+}
+
+static long set_mempolicy(int mode, const unsigned long* nodemask, unsigned long maxnode) {
+    return syscall(SYS_set_mempolicy, mode, nodemask, maxnode);
+}
+
+static long get_mempolicy(int* mode, unsigned long* nodemask, unsigned long maxnode, void* addr,
+                          unsigned long flags) {
+    return syscall(SYS_get_mempolicy, mode, nodemask, maxnode, addr, flags);
+}
+
+static long move_pages(int pid, unsigned long count, void** pages, const int* nodes, int* status,
+                       int flags) {
+    return syscall(SYS_move_pages, pid, count, pages, nodes, status, flags);
+}
+
+static long migrate_pages(int pid, unsigned long maxnode, const unsigned long* old_nodes,
+                          const unsigned long* new_nodes) {
+    return syscall(SYS_migrate_pages, pid, maxnode, old_nodes, new_nodes);
+}
+
+static int g_num_nodes;
+static int g_last_node;
+/* false if the placement of pages cannot be queried (ENOSYS from move_pages) */
+static bool g_can_query;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Returns the number of pages of [addr, addr + len) which are not placed on `node`. */
+static int count_misplaced(char* addr, size_t len, int node) {
+    if (!g_can_query)
+        return 0;
+
+    int misplaced = 0;
+    for (size_t off = 0; off < len; off += PAGE * 64) {
+        void* pages[64];
+        int status[64];
+        int count = 0;
+        for (size_t o = off; o < len && count < 64; o += PAGE)
+            pages[count++] = addr + o;
+        if (move_pages(0, count, pages, NULL, status, 0) < 0) {
+            perror("move_pages");
+            return -1;
+        }
+        for (int i = 0; i < count; i++)
+            misplaced += status[i] != node;
+    }
+    return misplaced;
+}
+
+static int test_policies(void) {
+    unsigned long mask = 0;
+    int mode = -1;
+    if (get_mempolicy(&mode, &mask, MAX_NODES, NULL, MPOL_F_MEMS_ALLOWED) < 0 || !mask) {
+        perror("get_mempolicy(MPOL_F_MEMS_ALLOWED)");
+        return -1;
+    }
+    g_num_nodes = __builtin_popcountl(mask);
+    g_last_node = 63 - __builtin_clzl(mask);
+
+    /* the default policy of the thread */
+    unsigned long node0 = 1;
+    if (set_mempolicy(MPOL_BIND, &node0, MAX_NODES + 1) < 0) {
+        perror("set_mempolicy");
+        return -1;
+    }
+    if (get_mempolicy(&mode, &mask, MAX_NODES, NULL, 0) < 0 || mode != MPOL_BIND ||
+            mask != 1) {
+        printf("get_mempolicy returned mode %d mask 0x%lx\n", mode, mask);
+        return -1;
+    }
+    if (set_mempolicy(MPOL_PREFERRED, NULL, 0) < 0 ||
+            get_mempolicy(&mode, NULL, 0, NULL, 0) < 0 || mode != MPOL_LOCAL) {
+        printf("preferring no node did not set the local policy\n");
+        return -1;
+    }
+    if (set_mempolicy(MPOL_DEFAULT, NULL, 0) < 0) {
+        perror("set_mempolicy(MPOL_DEFAULT)");
+        return -1;
+    }
+
+    if (set_mempolicy(MPOL_DEFAULT, &node0, MAX_NODES + 1) == 0 || errno != EINVAL) {
+        printf("MPOL_DEFAULT with nodes did not fail with EINVAL\n");
+        return -1;
+    }
+    if (set_mempolicy(MPOL_BIND, NULL, 0) == 0 || errno != EINVAL) {
+        printf("MPOL_BIND without nodes did not fail with EINVAL\n");
+        return -1;
+    }
+    if (set_mempolicy(42, &node0, MAX_NODES + 1) == 0 || errno != EINVAL) {
+        printf("invalid mode did not fail with EINVAL\n");
+        return -1;
+    }
+    if (get_mempolicy(&mode, &mask, MAX_NODES, NULL, MPOL_F_NODE) == 0 || errno != EINVAL) {
+        printf("MPOL_F_NODE without interleaving did not fail with EINVAL\n");
+        return -1;
+    }
+
+    /* a policy of a memory range, on the last node */
+    size_t len = TEST_PAGES * PAGE;
+    char* mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    unsigned long last = 1UL << g_last_node;
+    if (mbind(mem + PAGE, len - 2 * PAGE, MPOL_BIND, &last, MAX_NODES + 1, 0) < 0) {
+        perror("mbind");
+        return -1;
+    }
+    memset(mem, 1, len);
+
+    if (get_mempolicy(&mode, &mask, MAX_NODES, mem + PAGE, MPOL_F_ADDR) < 0 ||
+            mode != MPOL_BIND || mask != last) {
+        printf("get_mempolicy(MPOL_F_ADDR) returned mode %d mask 0x%lx\n", mode, mask);
+        return -1;
+    }
+    if (get_mempolicy(&mode, &mask, MAX_NODES, mem, MPOL_F_ADDR) < 0 || mode != MPOL_DEFAULT) {
+        printf("mbind changed the policy outside of the range\n");
+        return -1;
+    }
+    if (get_mempolicy(&mode, NULL, 0, mem + PAGE, MPOL_F_ADDR | MPOL_F_NODE) < 0) {
+        perror("get_mempolicy(MPOL_F_NODE)");
+        return -1;
+    }
+
+    void* page = mem + PAGE;
+    int status;
+    g_can_query = move_pages(0, 1, &page, NULL, &status, 0) == 0;
+    if (!g_can_query && errno != ENOSYS) {
+        perror("move_pages");
+        return -1;
+    }
+    if (g_can_query && (mode != g_last_node || status != g_last_node)) {
+        printf("bound page is on node %d (move_pages: %d)\n", mode, status);
+        return -1;
+    }
+
+    if (mbind(mem + 1, PAGE, MPOL_BIND, &last, MAX_NODES + 1, 0) == 0 || errno != EINVAL) {
+        printf("mbind of an unaligned address did not fail with EINVAL\n");
+        return -1;
+    }
+    if (munmap(mem + len - PAGE, PAGE) < 0) {
+        perror("munmap");
+        return -1;
+    }
+    if (mbind(mem, len, MPOL_BIND, &last, MAX_NODES + 1, 0) == 0 || errno != EFAULT) {
+        printf("mbind of an unmapped range did not fail with EFAULT\n");
+        return -1;
+    }
+
+    /* /proc/self/numa_maps shows the policy of the range */
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%lx bind:%d ", (unsigned long)(mem + PAGE), g_last_node);
+    FILE* f = fopen("/proc/self/numa_maps", "r");
+    if (!f) {
+        perror("fopen(/proc/self/numa_maps)");
+        return -1;
+    }
+    char line[512];
+    bool found = false;
+    while (fgets(line, sizeof(line), f)) {
+        if (!strncmp(line, expected, strlen(expected)))
+            found = true;
+    }
+    fclose(f);
+    if (!found) {
+        printf("/proc/self/numa_maps has no line \"%s...\"\n", expected);
+        return -1;
+    }
+
+    /* the policy and the placement survive fork */
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (get_mempolicy(&mode, &mask, MAX_NODES, mem + PAGE, MPOL_F_ADDR) < 0 ||
+                mode != MPOL_BIND || mask != last)
+            exit(1);
+        if (count_misplaced(mem + PAGE, len - 2 * PAGE, g_last_node))
+            exit(2);
+        exit(0);
+    }
+    int wstatus;
+    if (waitpid(pid, &wstatus, 0) < 0 || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus)) {
+        printf("child lost the memory policy (status 0x%x)\n", wstatus);
+        return -1;
+    }
+
+    /* moving pages: all of them to node 0, then back with migrate_pages() */
+    if (g_can_query) {
+        int nodes[2] = {0, 0};
+        int statuses[2];
+        void* pages[2] = {mem + PAGE, mem + 2 * PAGE};
+        if (move_pages(0, 2, pages, nodes, statuses, MPOL_MF_MOVE) < 0 || statuses[0] ||
+                statuses[1]) {
+            printf("move_pages did not move the pages to node 0\n");
+            return -1;
+        }
+        unsigned long from = 1, to = last;
+        if (migrate_pages(0, MAX_NODES + 1, &from, &to) < 0) {
+            perror("migrate_pages");
+            return -1;
+        }
+        if (count_misplaced(mem + PAGE, 2 * PAGE, g_last_node)) {
+            printf("migrate_pages did not move the pages back\n");
+            return -1;
+        }
+    }
+
+    munmap(mem, len - PAGE);
+    printf("memory policies OK (%d NUMA node(s)%s)\n", g_num_nodes,
+           g_can_query ? "" : ", placement not queryable");
+    return 0;
+}
+
+struct stream_arg {
+    int cpu_node;
+    int mem_node;
+    double* a;
+    double* b;
+    double* c;
+    pthread_barrier_t* barrier;
+    int misplaced;
+};
+
+/* Pins the calling thread to the CPUs of `node` (found with getcpu()); on a single node host
+ * the thread is not pinned. */
+static void pin_to_node(int node) {
+    if (g_num_nodes == 1)
+        return;
+
+    cpu_set_t all, set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(all), &all) < 0)
+        return;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &all))
+            continue;
+        cpu_set_t one;
+        CPU_ZERO(&one);
+        CPU_SET(cpu, &one);
+        unsigned int cpu_node;
+        if (sched_setaffinity(0, sizeof(one), &one) == 0 &&
+                syscall(SYS_getcpu, NULL, &cpu_node, NULL) == 0 && (int)cpu_node == node)
+            CPU_SET(cpu, &set);
+    }
+    sched_setaffinity(0, sizeof(set), CPU_COUNT(&set) ? &set : &all);
+}
+
+static void* stream_thread(void* _arg) {
+    struct stream_arg* arg = _arg;
+    size_t len = STREAM_LEN * sizeof(double);
+    unsigned long mask = 1UL << arg->mem_node;
+
+    pin_to_node(arg->cpu_node);
+
+    double* arrays[3];
+    for (int i = 0; i < 3; i++) {
+        arrays[i] = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (arrays[i] == MAP_FAILED ||
+                mbind(arrays[i], len, MPOL_BIND, &mask, MAX_NODES + 1, 0) < 0) {
+            perror("mmap/mbind");
+            exit(1);
+        }
+    }
+    arg->a = arrays[0];
+    arg->b = arrays[1];
+    arg->c = arrays[2];
+
+    /* first touch by this thread */
+    for (size_t i = 0; i < STREAM_LEN; i++) {
+        arg->a[i] = 0.0;
+        arg->b[i] = 1.0;
+        arg->c[i] = 2.0;
+    }
+    arg->misplaced = count_misplaced((char*)arg->a, len, arg->mem_node);
+
+    pthread_barrier_wait(arg->barrier);
+    for (int rep = 0; rep < STREAM_REPS; rep++) {
+        for (size_t i = 0; i < STREAM_LEN; i++)
+            arg->a[i] = arg->b[i] + 3.0 * arg->c[i];
+    }
+    pthread_barrier_wait(arg->barrier);
+
+    for (int i = 0; i < 3; i++)
+        munmap(arrays[i], len);
+    return NULL;
+}
+
+/* Runs the triad on one thread per node (at most two, like a two-socket host) and returns GB/s;
+ * with `remote` the arrays of each thread are bound to the next node. */
+static double bench_triad(bool remote) {
+    int threads = g_num_nodes > 1 ? 2 : 1;
+    pthread_t tids[2];
+    struct stream_arg args[2];
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, threads + 1);
+
+    for (int i = 0; i < threads; i++) {
+        int node = i ? g_last_node : 0;
+        int other = i ? 0 : g_last_node;
+        args[i] = (struct stream_arg){
+            .cpu_node = node,
+            .mem_node = remote ? other : node,
+            .barrier  = &barrier,
+        };
+        if (pthread_create(&tids[i], NULL, stream_thread, &args[i])) {
+            printf("pthread_create failed\n");
+            return -1;
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+    uint64_t start = now_ns();
+    pthread_barrier_wait(&barrier);
+    uint64_t elapsed = now_ns() - start;
+
+    int misplaced = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        misplaced += args[i].misplaced;
+    }
+    pthread_barrier_destroy(&barrier);
+    if (misplaced) {
+        printf("%d pages of the stream arrays are not on their bound node\n", misplaced);
+        return -1;
+    }
+
+    /* triad reads two arrays and writes one */
+    double bytes = 3.0 * sizeof(double) * STREAM_LEN * STREAM_REPS * threads;
+    return bytes / elapsed;
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    if (test_policies() < 0)
+        return 1;
+
+    double local_gbps  = bench_triad(/*remote=*/false);
+    double remote_gbps = bench_triad(/*remote=*/true);
+    if (local_gbps < 0 || remote_gbps < 0)
+        return 1;
+    printf("stream triad on %d node(s): local %.2f GB/s, remote %.2f GB/s\n",
+           g_num_nodes > 1 ? 2 : 1, local_gbps, remote_gbps);
+
+    printf("Test successful!\n");
+    return 0;
+}
@@ -13,6 +13,7 @@ struct cpuinfo {
     int model;
     char model_name[64];
     int stepping;
+    int physical_id;
     int core_id;
     int cpu_cores;
 };
@@ -23,8 +24,9 @@ static void init_cpuinfo(struct cpuinfo* ci) {
     ci->cpu_family = -1;
     ci->model      = -1;
     memset(&ci->model_name, 0, sizeof(ci->model_name));
-    ci->stepping  = -1;
-    ci->core_id   = -1;
+    ci->stepping    = -1;
+    ci->physical_id = -1;
+    ci->core_id     = -1;
     ci->cpu_cores = -1;
 }
 
@@ -60,6 +62,8 @@ static int parse_line(char* line, struct cpuinfo* ci) {
         sscanf(v, "%d\n", &ci->model);
     } else if (!strcmp(k, "stepping")) {
         sscanf(v, "%d\n", &ci->stepping);
+    } else if (!strcmp(k, "physical id")) {
+        sscanf(v, "%d\n", &ci->physical_id);
     } else if (!strcmp(k, "core id")) {
         sscanf(v, "%d\n", &ci->core_id);
     } else if (!strcmp(k, "cpu cores")) {
@@ -76,6 +80,24 @@ fmt_err:
     return -1;
 };
 
+/* reads an integer from /sys/devices/system/cpu/cpu<cpu>/topology/<file> */
+static int read_topology(int cpu, const char* file) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, file);
+
+    FILE* fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    int val = -1;
+    if (fscanf(fp, "%d", &val) != 1)
+        val = -1;
+    fclose(fp);
+    return val;
+}
+
 static int check_cpuinfo(struct cpuinfo* ci) {
     if (ci->processor == -1) {
         fprintf(stderr, "Could not get cpu index\n");
@@ -90,6 +112,16 @@ static int check_cpuinfo(struct cpuinfo* ci) {
         return -1;
     }
 
+    /* /proc/cpuinfo must agree with the sysfs topology of the same CPU */
+    if (read_topology(ci->processor, "physical_package_id") != ci->physical_id) {
+        fprintf(stderr, "physical id of cpu %d does not match sysfs\n", ci->processor);
+        return -1;
+    }
+    if (read_topology(ci->processor, "core_id") != ci->core_id) {
+        fprintf(stderr, "core id of cpu %d does not match sysfs\n", ci->processor);
+        return -1;
+    }
+
     return 0;
 }
 
@@ -6,7 +6,8 @@
 #include <sys/time.h>
 
 /* This test checks that our dummy implementations work correctly. None of the
- * below syscalls are actually propagated to the host OS or change anything.
+ * below syscalls (except affinity and getcpu) are actually propagated to the host
+ * OS or change anything.
  * NOTE: This test works correctly only on Graphene (not on Linux). */
 
 int main(int argc, char** argv) {
@@ -29,6 +30,16 @@ int main(int argc, char** argv) {
 
     cpu_set_t my_set;
     CPU_ZERO(&my_set);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &my_set) != -1 || errno != EINVAL) {
+        perror("Error: setting empty affinity did not fail");
+        return 1;
+    }
+
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &my_set) == -1) {
+        perror("Error getting affinity");
+        return 1;
+    }
+
     if (sched_setaffinity(0, sizeof(cpu_set_t), &my_set) == -1) {
         perror("Error setting affinity");
         return 1;
@@ -50,11 +61,17 @@ int main(int argc, char** argv) {
         return 2;
     }
 
-    if (sched_getaffinity(0, sizeof(cpu_set_t), &my_set) == -1) {
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &my_set) == -1 || !CPU_COUNT(&my_set)) {
         perror("Error getting affinity");
         return 2;
     }
 
+    int cpu = sched_getcpu();
+    if (cpu < 0 || !CPU_ISSET(cpu, &my_set)) {
+        perror("Error getting current CPU");
+        return 2;
+    }
+
     if (sched_get_priority_max(SCHED_FIFO) != 99) {
         perror("Error getting max priority of SCHED_FIFO");
         return 2;
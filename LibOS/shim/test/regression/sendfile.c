@@ -0,0 +1,142 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define SRC_FILE  "tmp/__sendfile_src__"
+#define DST_FILE  "tmp/__sendfile_dst__"
+#define DATA_SIZE (100 * 1024 + 123)
+#define PIPE_SIZE 4096
+
+static char data[DATA_SIZE];
+static char buf[DATA_SIZE];
+
+static int check_file(const char* path, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size != size) {
+        fprintf(stderr, "%s has wrong size\n", path);
+        close(fd);
+        return -1;
+    }
+
+    size_t bytes = 0;
+    while (bytes < size) {
+        ssize_t ret = read(fd, buf + bytes, size - bytes);
+        if (ret <= 0) {
+            perror("read");
+            close(fd);
+            return -1;
+        }
+        bytes += ret;
+    }
+    close(fd);
+
+    if (memcmp(buf, data, size)) {
+        fprintf(stderr, "%s has wrong content\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = 'a' + i % 26;
+
+    int src = open(SRC_FILE, O_RDWR | O_CREAT | O_TRUNC, 0660);
+    int dst = open(DST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0660);
+    if (src < 0 || dst < 0) {
+        perror("open");
+        return 1;
+    }
+
+    if (write(src, data, sizeof(data)) != sizeof(data)) {
+        perror("write");
+        return 1;
+    }
+
+    /* copy_file_range() with explicit input offset: file offset of `src` must not change */
+    loff_t off_in = 0;
+    size_t copied = 0;
+    while (copied < sizeof(data)) {
+        ssize_t ret = syscall(SYS_copy_file_range, src, &off_in, dst, NULL,
+                              sizeof(data) - copied, 0);
+        if (ret <= 0) {
+            perror("copy_file_range");
+            return 1;
+        }
+        copied += ret;
+    }
+    if (off_in != sizeof(data) || lseek(src, 0, SEEK_CUR) != sizeof(data)) {
+        fprintf(stderr, "copy_file_range: wrong offsets\n");
+        return 1;
+    }
+    if (check_file(DST_FILE, sizeof(data)) < 0)
+        return 1;
+    puts("copy_file_range: OK");
+
+    /* sendfile() from a file to a pipe, then splice() from the pipe to a file */
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    if (ftruncate(dst, 0) < 0 || lseek(dst, 0, SEEK_SET) < 0) {
+        perror("ftruncate");
+        return 1;
+    }
+
+    off_t offset = 0;
+    loff_t off_out = 0;
+    while (offset < (off_t)sizeof(data)) {
+        size_t count = sizeof(data) - offset < PIPE_SIZE ? sizeof(data) - offset : PIPE_SIZE;
+        ssize_t sent = sendfile(fds[1], src, &offset, count);
+        if (sent <= 0) {
+            perror("sendfile");
+            return 1;
+        }
+
+        while (sent > 0) {
+            ssize_t ret = splice(fds[0], NULL, dst, &off_out, sent, 0);
+            if (ret <= 0) {
+                perror("splice");
+                return 1;
+            }
+            sent -= ret;
+        }
+    }
+    if (off_out != sizeof(data) || lseek(dst, 0, SEEK_CUR) != 0) {
+        fprintf(stderr, "splice: wrong offsets\n");
+        return 1;
+    }
+    if (check_file(DST_FILE, sizeof(data)) < 0)
+        return 1;
+    puts("sendfile and splice: OK");
+
+    /* splice() requires a pipe on one of the ends */
+    if (splice(src, NULL, dst, NULL, 1, 0) != -1 || errno != EINVAL) {
+        fprintf(stderr, "splice between files did not fail\n");
+        return 1;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+    close(src);
+    close(dst);
+    unlink(SRC_FILE);
+    unlink(DST_FILE);
+    puts("TEST OK");
+    return 0;
+}
@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* A small database-like workload: the file is an array of pages, each page holds its page number
+ * and a version, and updates go through a shared writable mapping of the whole file. */
+
+#define PAGES 64
+
+static const char* g_path = "tmp/shared_mmap_test";
+static size_t g_page_size;
+
+struct page_hdr {
+    uint64_t pgno;
+    uint64_t version;
+};
+
+static void update_page(char* map, size_t pgno, uint64_t version) {
+    struct page_hdr* hdr = (struct page_hdr*)(map + pgno * g_page_size);
+    hdr->pgno = pgno;
+    hdr->version = version;
+    memset(hdr + 1, (char)version, g_page_size - sizeof(*hdr));
+}
+
+static int check_file(int fd, size_t pgno, uint64_t version, const char* msg) {
+    char* buf = malloc(g_page_size);
+    if (!buf)
+        return -1;
+
+    int ret = -1;
+    if (pread(fd, buf, g_page_size, pgno * g_page_size) != (ssize_t)g_page_size) {
+        printf("%s: pread of page %zu failed\n", msg, pgno);
+        goto out;
+    }
+
+    struct page_hdr* hdr = (struct page_hdr*)buf;
+    if (hdr->pgno != pgno || hdr->version != version) {
+        printf("%s: page %zu has version %lu, expected %lu\n", msg, pgno, hdr->version, version);
+        goto out;
+    }
+    for (size_t i = sizeof(*hdr); i < g_page_size; i++) {
+        if (buf[i] != (char)version) {
+            printf("%s: page %zu is corrupted at offset %zu\n", msg, pgno, i);
+            goto out;
+        }
+    }
+    ret = 0;
+out:
+    free(buf);
+    return ret;
+}
+
+int main(void) {
+    g_page_size = getpagesize();
+
+    int fd = open(g_path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open");
+        return 1;
+    }
+    if (ftruncate(fd, PAGES * g_page_size) < 0) {
+        perror("ftruncate");
+        return 1;
+    }
+
+    char* map = mmap(NULL, PAGES * g_page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    /* "transaction" 1: write every page, then make it durable */
+    for (size_t i = 0; i < PAGES; i++)
+        update_page(map, i, 1);
+    if (msync(map, PAGES * g_page_size, MS_SYNC) < 0) {
+        perror("msync(MS_SYNC)");
+        return 1;
+    }
+    for (size_t i = 0; i < PAGES; i++)
+        if (check_file(fd, i, 1, "msync(MS_SYNC)") < 0)
+            return 1;
+
+    /* "transaction" 2: a few scattered pages, synced only partially */
+    update_page(map, 3, 2);
+    update_page(map, 4, 2);
+    update_page(map, 40, 2);
+    if (msync(map + 3 * g_page_size, 2 * g_page_size, MS_ASYNC) < 0) {
+        perror("msync(MS_ASYNC)");
+        return 1;
+    }
+    if (check_file(fd, 3, 2, "msync(MS_ASYNC)") < 0 || check_file(fd, 4, 2, "msync(MS_ASYNC)") < 0)
+        return 1;
+
+    /* the child sees (and may update) the same file pages */
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        struct page_hdr* hdr = (struct page_hdr*)(map + 40 * g_page_size);
+        if (hdr->version != 2)
+            exit(1);
+        update_page(map, 41, 3);
+        if (msync(map + 41 * g_page_size, g_page_size, MS_SYNC) < 0)
+            exit(2);
+        exit(0);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return 1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("child failed (status %d)\n", status);
+        return 1;
+    }
+    if (check_file(fd, 41, 3, "fork") < 0)
+        return 1;
+
+    /* munmap writes back the remaining changes */
+    update_page(map, PAGES - 1, 4);
+    if (munmap(map, PAGES * g_page_size) < 0) {
+        perror("munmap");
+        return 1;
+    }
+    if (check_file(fd, 40, 2, "munmap") < 0 || check_file(fd, PAGES - 1, 4, "munmap") < 0)
+        return 1;
+
+    if (msync(map, g_page_size, MS_SYNC) == 0 || errno != ENOMEM) {
+        printf("msync on an unmapped range did not fail with ENOMEM\n");
+        return 1;
+    }
+    if (msync(map + 1, g_page_size, MS_SYNC) == 0 || errno != EINVAL) {
+        printf("msync on an unaligned address did not fail with EINVAL\n");
+        return 1;
+    }
+
+    close(fd);
+    unlink(g_path);
+
+    puts("Test successful!");
+    return 0;
+}
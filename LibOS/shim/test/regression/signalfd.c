@@ -0,0 +1,334 @@
+/* Test of signalfd and rt_sigtimedwait, and a benchmark of the signal delivery latency of an
+ * event loop which waits for a signal on a signalfd versus the classic self-pipe pattern (a signal
+ * handler writing to a pipe watched by the loop). */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#define ROUNDS 10000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int test_read(void) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGRTMIN);
+
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (sfd < 0) {
+        perror("signalfd");
+        return -1;
+    }
+
+    struct signalfd_siginfo ssi[4];
+    if (read(sfd, ssi, sizeof(ssi)) >= 0 || errno != EAGAIN) {
+        printf("read of an empty signalfd did not fail with EAGAIN\n");
+        return -1;
+    }
+    if (read(sfd, ssi, sizeof(ssi[0]) - 1) >= 0 || errno != EINVAL) {
+        printf("read of a short buffer did not fail with EINVAL\n");
+        return -1;
+    }
+
+    if (raise(SIGUSR1) < 0) {
+        perror("raise");
+        return -1;
+    }
+    ssize_t ret = read(sfd, ssi, sizeof(ssi));
+    if (ret != sizeof(ssi[0]) || ssi[0].ssi_signo != SIGUSR1 ||
+            ssi[0].ssi_pid != (uint32_t)getpid()) {
+        printf("read returned %zd (signal %u from %u)\n", ret, ssi[0].ssi_signo, ssi[0].ssi_pid);
+        return -1;
+    }
+
+    /* real-time signals are queued, standard ones are not */
+    for (int i = 0; i < 3; i++) {
+        if (raise(SIGRTMIN) < 0 || raise(SIGUSR1) < 0) {
+            perror("raise");
+            return -1;
+        }
+    }
+    ret = read(sfd, ssi, sizeof(ssi));
+    if (ret != 4 * sizeof(ssi[0]) || ssi[0].ssi_signo != SIGUSR1) {
+        printf("read of queued signals returned %zd\n", ret);
+        return -1;
+    }
+    for (int i = 1; i < 4; i++) {
+        if (ssi[i].ssi_signo != (uint32_t)SIGRTMIN) {
+            printf("read of queued signals returned signal %u\n", ssi[i].ssi_signo);
+            return -1;
+        }
+    }
+
+    /* the signal from a POSIX timer carries its value */
+    struct sigevent sev = {
+        .sigev_notify = SIGEV_SIGNAL,
+        .sigev_signo  = SIGRTMIN,
+        .sigev_value.sival_int = 42,
+    };
+    timer_t timer;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &timer) < 0) {
+        perror("timer_create");
+        return -1;
+    }
+    struct itimerspec its = {.it_value.tv_nsec = 1000000};
+    if (timer_settime(timer, 0, &its, NULL) < 0) {
+        perror("timer_settime");
+        return -1;
+    }
+
+    /* a blocking read; the mask of an existing signalfd can be replaced */
+    int sfd2 = signalfd(-1, &mask, 0);
+    if (sfd2 < 0 || signalfd(sfd2, &mask, 0) != sfd2) {
+        perror("signalfd");
+        return -1;
+    }
+    ret = read(sfd2, ssi, sizeof(ssi));
+    if (ret != sizeof(ssi[0]) || ssi[0].ssi_signo != (uint32_t)SIGRTMIN ||
+            ssi[0].ssi_code != SI_TIMER || ssi[0].ssi_int != 42) {
+        printf("read of a timer signal returned %zd (signal %u, code %d, value %d)\n", ret,
+               ssi[0].ssi_signo, ssi[0].ssi_code, ssi[0].ssi_int);
+        return -1;
+    }
+    timer_delete(timer);
+
+    if (signalfd(sfd, &mask, 0x100) >= 0 || errno != EINVAL) {
+        printf("signalfd with invalid flags did not fail with EINVAL\n");
+        return -1;
+    }
+    if (signalfd(STDOUT_FILENO, &mask, 0) >= 0 || errno != EINVAL) {
+        printf("signalfd on a non-signalfd did not fail with EINVAL\n");
+        return -1;
+    }
+
+    close(sfd2);
+    close(sfd);
+    printf("signalfd read OK\n");
+    return 0;
+}
+
+static void* send_signal(void* arg) {
+    pthread_t* target = arg;
+    usleep(10000);
+    pthread_kill(*target, SIGUSR2);
+    return NULL;
+}
+
+static int test_epoll_and_sigtimedwait(void) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR2);
+
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK);
+    int efd = epoll_create1(0);
+    if (sfd < 0 || efd < 0) {
+        perror("signalfd/epoll_create1");
+        return -1;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.fd = sfd};
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &event) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    if (epoll_wait(efd, &event, 1, 0) != 0) {
+        printf("signalfd is ready without a pending signal\n");
+        return -1;
+    }
+
+    /* a signal sent by another thread wakes up the waiter */
+    pthread_t self = pthread_self();
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, send_signal, &self)) {
+        printf("pthread_create failed\n");
+        return -1;
+    }
+    if (epoll_wait(efd, &event, 1, 5000) != 1 || event.data.fd != sfd) {
+        printf("epoll_wait did not report the signalfd\n");
+        return -1;
+    }
+    pthread_join(thread, NULL);
+
+    /* rt_sigtimedwait() dequeues the same signal as the signalfd would */
+    siginfo_t info;
+    if (sigtimedwait(&mask, &info, &(struct timespec){0}) != SIGUSR2 ||
+            info.si_signo != SIGUSR2) {
+        printf("sigtimedwait did not return the pending signal\n");
+        return -1;
+    }
+    struct signalfd_siginfo ssi;
+    if (read(sfd, &ssi, sizeof(ssi)) >= 0 || errno != EAGAIN) {
+        printf("signal was dequeued twice\n");
+        return -1;
+    }
+    if (epoll_wait(efd, &event, 1, 0) != 0) {
+        printf("signalfd is still ready after the signal was read\n");
+        return -1;
+    }
+
+    if (sigtimedwait(&mask, &info, &(struct timespec){.tv_nsec = 10000000}) >= 0 ||
+            errno != EAGAIN) {
+        printf("sigtimedwait did not time out\n");
+        return -1;
+    }
+    if (pthread_create(&thread, NULL, send_signal, &self)) {
+        printf("pthread_create failed\n");
+        return -1;
+    }
+    if (sigwaitinfo(&mask, &info) != SIGUSR2) {
+        perror("sigwaitinfo");
+        return -1;
+    }
+    pthread_join(thread, NULL);
+
+    close(efd);
+    close(sfd);
+    printf("signalfd epoll and sigtimedwait OK\n");
+    return 0;
+}
+
+/* Latency benchmark: the pinger thread sends SIGUSR2 to the event loop (the main thread), which
+ * acknowledges every signal over `ack_pipe`. */
+static int self_pipe[2];
+static int ack_pipe[2];
+
+static void self_pipe_handler(int sig) {
+    char c = sig;
+    ssize_t ret = write(self_pipe[1], &c, 1);
+    (void)ret;
+}
+
+static void* pinger(void* arg) {
+    pthread_t* target = arg;
+    uint64_t* total_ns = malloc(sizeof(*total_ns));
+    *total_ns = 0;
+    for (int i = 0; i < ROUNDS; i++) {
+        uint64_t start = now_ns();
+        pthread_kill(*target, SIGUSR2);
+        char c;
+        if (read(ack_pipe[0], &c, 1) != 1)
+            exit(1);
+        *total_ns += now_ns() - start;
+    }
+    return total_ns;
+}
+
+static double bench_loop(bool use_signalfd) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR2);
+
+    int fd;
+    if (use_signalfd) {
+        fd = signalfd(-1, &mask, SFD_NONBLOCK);
+    } else {
+        if (sigprocmask(SIG_UNBLOCK, &mask, NULL) < 0 || pipe(self_pipe) < 0)
+            return -1;
+        struct sigaction sa = {.sa_handler = self_pipe_handler, .sa_flags = SA_RESTART};
+        if (sigaction(SIGUSR2, &sa, NULL) < 0)
+            return -1;
+        fd = self_pipe[0];
+    }
+    int efd = epoll_create1(0);
+    struct epoll_event event = {.events = EPOLLIN};
+    if (fd < 0 || efd < 0 || epoll_ctl(efd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        perror("bench setup");
+        return -1;
+    }
+
+    pthread_t self = pthread_self();
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, pinger, &self))
+        return -1;
+
+    for (int i = 0; i < ROUNDS; i++) {
+        int ret;
+        do {
+            ret = epoll_wait(efd, &event, 1, -1);
+        } while (ret < 0 && errno == EINTR);
+        if (ret != 1) {
+            perror("epoll_wait");
+            return -1;
+        }
+
+        if (use_signalfd) {
+            struct signalfd_siginfo ssi;
+            if (read(fd, &ssi, sizeof(ssi)) != sizeof(ssi)) {
+                perror("read");
+                return -1;
+            }
+        } else {
+            char c;
+            if (read(fd, &c, 1) != 1) {
+                perror("read");
+                return -1;
+            }
+        }
+        if (write(ack_pipe[1], "", 1) != 1) {
+            perror("write");
+            return -1;
+        }
+    }
+
+    uint64_t* total_ns;
+    pthread_join(thread, (void**)&total_ns);
+    double avg_us = (double)*total_ns / ROUNDS / 1000;
+    free(total_ns);
+
+    close(efd);
+    close(fd);
+    if (!use_signalfd) {
+        close(self_pipe[1]);
+        signal(SIGUSR2, SIG_DFL);
+        sigprocmask(SIG_BLOCK, &mask, NULL);
+    }
+    return avg_us;
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    /* signals read from a signalfd must be blocked, all threads inherit this mask */
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    sigaddset(&mask, SIGUSR2);
+    sigaddset(&mask, SIGRTMIN);
+    if (sigprocmask(SIG_BLOCK, &mask, NULL) < 0) {
+        perror("sigprocmask");
+        return 1;
+    }
+
+    if (test_read() < 0 || test_epoll_and_sigtimedwait() < 0)
+        return 1;
+
+    if (pipe(ack_pipe) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    double signalfd_us  = bench_loop(/*use_signalfd=*/true);
+    double self_pipe_us = bench_loop(/*use_signalfd=*/false);
+    if (signalfd_us < 0 || self_pipe_us < 0)
+        return 1;
+    printf("signal round trip over %d rounds: signalfd %.2f us, self-pipe %.2f us\n", ROUNDS,
+           signalfd_us, self_pipe_us);
+
+    printf("Test successful!\n");
+    return 0;
+}
@@ -0,0 +1,242 @@
+/* Test of fallocate, fadvise64, readahead, sync_file_range and syncfs, and a benchmark of a
+ * write-heavy log writer which makes each chunk durable either with fsync alone or by streaming
+ * it out with sync_file_range (start write-out of the new chunk, wait for the previous one). */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_FILE  "tmp/storage_hints"
+#define BENCH_FILE "tmp/storage_hints_bench"
+#define CHUNK_SIZE (1024 * 1024)
+#define NUM_CHUNKS 32
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static off_t file_size(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+        return -1;
+    return st.st_size;
+}
+
+static int test_fallocate(int fd) {
+    if (fallocate(fd, 0, 0, 3 * CHUNK_SIZE) < 0) {
+        perror("fallocate");
+        return -1;
+    }
+    if (file_size(fd) != 3 * CHUNK_SIZE) {
+        printf("fallocate did not extend the file\n");
+        return -1;
+    }
+
+    if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, 4 * CHUNK_SIZE) < 0) {
+        perror("fallocate(FALLOC_FL_KEEP_SIZE)");
+        return -1;
+    }
+    if (file_size(fd) != 3 * CHUNK_SIZE) {
+        printf("fallocate with FALLOC_FL_KEEP_SIZE changed the file size\n");
+        return -1;
+    }
+
+    /* allocation within the file must not shrink it or change its contents */
+    char buf[16];
+    memset(buf, 'x', sizeof(buf));
+    if (pwrite(fd, buf, sizeof(buf), CHUNK_SIZE) != sizeof(buf)) {
+        perror("pwrite");
+        return -1;
+    }
+    if (fallocate(fd, 0, 0, CHUNK_SIZE) < 0 || file_size(fd) != 3 * CHUNK_SIZE) {
+        printf("fallocate within the file changed its size\n");
+        return -1;
+    }
+    if (pread(fd, buf, sizeof(buf), CHUNK_SIZE) != sizeof(buf) || buf[0] != 'x') {
+        printf("fallocate within the file changed its contents\n");
+        return -1;
+    }
+
+    /* punching holes is optional (it depends on the host file system), but must zero the range */
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, CHUNK_SIZE, 4096) == 0) {
+        if (pread(fd, buf, sizeof(buf), CHUNK_SIZE) != sizeof(buf) || buf[0] != 0) {
+            printf("punched hole does not read back as zeroes\n");
+            return -1;
+        }
+    } else if (errno != EOPNOTSUPP) {
+        perror("fallocate(FALLOC_FL_PUNCH_HOLE)");
+        return -1;
+    }
+
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE, 0, 4096) == 0 || errno != EOPNOTSUPP) {
+        printf("fallocate(FALLOC_FL_PUNCH_HOLE) without FALLOC_FL_KEEP_SIZE did not fail with "
+               "EOPNOTSUPP\n");
+        return -1;
+    }
+    if (fallocate(fd, 0, 0, 0) == 0 || errno != EINVAL) {
+        printf("fallocate of an empty range did not fail with EINVAL\n");
+        return -1;
+    }
+
+    int ro_fd = open(TEST_FILE, O_RDONLY);
+    if (ro_fd < 0) {
+        perror("open");
+        return -1;
+    }
+    if (fallocate(ro_fd, 0, 0, 4096) == 0 || errno != EBADF) {
+        printf("fallocate on a read-only fd did not fail with EBADF\n");
+        return -1;
+    }
+    close(ro_fd);
+
+    printf("fallocate OK\n");
+    return 0;
+}
+
+static int test_hints(int fd) {
+    /* posix_fadvise() returns the error instead of setting errno */
+    int ret = posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    if (!ret)
+        ret = posix_fadvise(fd, 0, CHUNK_SIZE, POSIX_FADV_DONTNEED);
+    if (ret) {
+        printf("posix_fadvise failed: %s\n", strerror(ret));
+        return -1;
+    }
+    if (posix_fadvise(fd, 0, 0, 42) != EINVAL) {
+        printf("posix_fadvise with invalid advice did not fail with EINVAL\n");
+        return -1;
+    }
+
+    if (readahead(fd, 0, CHUNK_SIZE) < 0) {
+        perror("readahead");
+        return -1;
+    }
+
+    if (sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                  SYNC_FILE_RANGE_WAIT_AFTER) < 0) {
+        perror("sync_file_range");
+        return -1;
+    }
+    if (sync_file_range(fd, 0, 0, 8) == 0 || errno != EINVAL) {
+        printf("sync_file_range with invalid flags did not fail with EINVAL\n");
+        return -1;
+    }
+
+    if (syncfs(fd) < 0) {
+        perror("syncfs");
+        return -1;
+    }
+
+    int pipefds[2];
+    if (pipe(pipefds) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    if (posix_fadvise(pipefds[0], 0, 0, POSIX_FADV_NORMAL) != ESPIPE) {
+        printf("posix_fadvise on a pipe did not fail with ESPIPE\n");
+        return -1;
+    }
+    if (readahead(pipefds[0], 0, 4096) == 0 || errno != EINVAL) {
+        printf("readahead on a pipe did not fail with EINVAL\n");
+        return -1;
+    }
+    if (sync_file_range(pipefds[1], 0, 0, SYNC_FILE_RANGE_WRITE) == 0 || errno != ESPIPE) {
+        printf("sync_file_range on a pipe did not fail with ESPIPE\n");
+        return -1;
+    }
+    if (fallocate(pipefds[1], 0, 0, 4096) == 0 || errno != ESPIPE) {
+        printf("fallocate on a pipe did not fail with ESPIPE\n");
+        return -1;
+    }
+    close(pipefds[0]);
+    close(pipefds[1]);
+
+    printf("fadvise/readahead/sync_file_range/syncfs OK\n");
+    return 0;
+}
+
+/* Writes NUM_CHUNKS chunks to a preallocated file, making each chunk durable before the next one
+ * is written (fsync) or streaming chunks to the device with sync_file_range. Returns MB/s. */
+static double bench_writer(char* chunk, int use_sync_file_range) {
+    int fd = open(BENCH_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open");
+        return -1;
+    }
+    if (fallocate(fd, 0, 0, (off_t)CHUNK_SIZE * NUM_CHUNKS) < 0) {
+        perror("fallocate");
+        return -1;
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < NUM_CHUNKS; i++) {
+        off_t off = (off_t)i * CHUNK_SIZE;
+        memset(chunk, 'a' + i % 26, CHUNK_SIZE);
+        if (pwrite(fd, chunk, CHUNK_SIZE, off) != CHUNK_SIZE) {
+            perror("pwrite");
+            return -1;
+        }
+
+        int ret;
+        if (use_sync_file_range) {
+            ret = sync_file_range(fd, off, CHUNK_SIZE, SYNC_FILE_RANGE_WRITE);
+            if (!ret && i > 0)
+                ret = sync_file_range(fd, off - CHUNK_SIZE, CHUNK_SIZE,
+                                      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                      SYNC_FILE_RANGE_WAIT_AFTER);
+        } else {
+            ret = fsync(fd);
+        }
+        if (ret < 0) {
+            perror(use_sync_file_range ? "sync_file_range" : "fsync");
+            return -1;
+        }
+    }
+    if (fsync(fd) < 0) {
+        perror("fsync");
+        return -1;
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    close(fd);
+    unlink(BENCH_FILE);
+    return (double)CHUNK_SIZE * NUM_CHUNKS * 1000 / elapsed;
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    int fd = open(TEST_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        perror("open");
+        return 1;
+    }
+    if (test_fallocate(fd) < 0 || test_hints(fd) < 0)
+        return 1;
+    close(fd);
+    unlink(TEST_FILE);
+
+    char* chunk = malloc(CHUNK_SIZE);
+    if (!chunk)
+        return 1;
+
+    double fsync_mbps = bench_writer(chunk, /*use_sync_file_range=*/0);
+    double sfr_mbps   = bench_writer(chunk, /*use_sync_file_range=*/1);
+    if (fsync_mbps < 0 || sfr_mbps < 0)
+        return 1;
+    printf("write %d x %d KB: fsync %.1f MB/s, sync_file_range %.1f MB/s\n", NUM_CHUNKS,
+           CHUNK_SIZE / 1024, fsync_mbps, sfr_mbps);
+    free(chunk);
+
+    printf("Test successful!\n");
+    return 0;
+}
@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_KEY 0x5eed
+
+/* single-producer single-consumer ring of fixed-size records, as in a market-data fan-out */
+#define RING_SLOTS   1024
+#define RECORD_SIZE  64
+#define RECORDS      (1 << 20)
+
+struct record {
+    uint64_t seq;
+    char payload[RECORD_SIZE - sizeof(uint64_t)];
+};
+
+struct ring {
+    _Alignas(64) uint64_t head; /* written by the consumer */
+    _Alignas(64) uint64_t tail; /* written by the producer */
+    struct record slots[RING_SLOTS];
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int test_basic(void) {
+    size_t size = 3 * getpagesize() + 100;
+
+    int id = shmget(TEST_KEY, size, IPC_CREAT | IPC_EXCL | 0600);
+    if (id < 0) {
+        perror("shmget");
+        return -1;
+    }
+    if (shmget(TEST_KEY, size, 0600) != id) {
+        printf("shmget of an existing key returned a different ID\n");
+        return -1;
+    }
+    if (shmget(TEST_KEY, size, IPC_CREAT | IPC_EXCL | 0600) >= 0 || errno != EEXIST) {
+        printf("shmget with IPC_EXCL did not fail with EEXIST\n");
+        return -1;
+    }
+    if (shmget(TEST_KEY, 2 * size, 0600) >= 0 || errno != EINVAL) {
+        printf("shmget of a larger size did not fail with EINVAL\n");
+        return -1;
+    }
+
+    char* addr = shmat(id, NULL, 0);
+    if (addr == (void*)-1) {
+        perror("shmat");
+        return -1;
+    }
+    for (size_t i = 0; i < size; i++) {
+        if (addr[i]) {
+            printf("new segment is not zeroed\n");
+            return -1;
+        }
+    }
+    memset(addr, 'a', size);
+
+    /* a second attachment sees the same memory */
+    char* addr2 = shmat(id, NULL, SHM_RDONLY);
+    if (addr2 == (void*)-1) {
+        perror("shmat");
+        return -1;
+    }
+    if (addr2 == addr || addr2[size - 1] != 'a') {
+        printf("second attachment does not share memory\n");
+        return -1;
+    }
+
+    struct shmid_ds ds;
+    if (shmctl(id, IPC_STAT, &ds) < 0) {
+        perror("shmctl(IPC_STAT)");
+        return -1;
+    }
+    if (ds.shm_segsz != size || ds.shm_nattch != 2 || ds.shm_perm.__key != TEST_KEY ||
+            (ds.shm_perm.mode & 0777) != 0600 || ds.shm_cpid != getpid()) {
+        printf("IPC_STAT returned wrong attributes (size %zu, nattch %lu)\n", ds.shm_segsz,
+               ds.shm_nattch);
+        return -1;
+    }
+
+    if (shmdt(addr + getpagesize()) == 0 || errno != EINVAL) {
+        printf("shmdt in the middle of an attachment did not fail with EINVAL\n");
+        return -1;
+    }
+    if (shmdt(addr2) < 0) {
+        perror("shmdt");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        /* the attachment is inherited and shared, not copied */
+        if (addr[0] != 'a')
+            exit(1);
+        if (shmctl(id, IPC_STAT, &ds) < 0 || ds.shm_nattch != 2)
+            exit(2);
+        addr[0] = 'b';
+        if (shmdt(addr) < 0)
+            exit(3);
+        exit(0);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+        printf("child failed (status %d)\n", status);
+        return -1;
+    }
+    if (addr[0] != 'b') {
+        printf("write of the child is not visible in the parent\n");
+        return -1;
+    }
+    if (shmctl(id, IPC_STAT, &ds) < 0 || ds.shm_nattch != 1) {
+        printf("wrong number of attachments after the child detached\n");
+        return -1;
+    }
+
+    if (geteuid() == 0) {
+        /* another user has no access to a 0600 segment of root */
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return -1;
+        }
+        if (pid == 0) {
+            if (setgid(65534) < 0 || setuid(65534) < 0)
+                exit(1);
+            if (shmat(id, NULL, SHM_RDONLY) != (void*)-1 || errno != EACCES)
+                exit(2);
+            if (shmctl(id, IPC_STAT, &ds) == 0 || errno != EACCES)
+                exit(3);
+            if (shmctl(id, IPC_RMID, NULL) == 0 || errno != EPERM)
+                exit(4);
+            exit(0);
+        }
+        if (waitpid(pid, &status, 0) < 0) {
+            perror("waitpid");
+            return -1;
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            printf("permission checks failed (status %d)\n", status);
+            return -1;
+        }
+    }
+
+    if (shmctl(id, IPC_RMID, NULL) < 0) {
+        perror("shmctl(IPC_RMID)");
+        return -1;
+    }
+    /* the attachment survives IPC_RMID, the key does not */
+    addr[1] = 'c';
+    if (shmget(TEST_KEY, size, 0600) >= 0 || errno != ENOENT) {
+        printf("shmget of a removed segment did not fail with ENOENT\n");
+        return -1;
+    }
+
+    /* until the last detach, the segment can still be used by its ID */
+    if (shmctl(id, IPC_STAT, &ds) < 0 || !(ds.shm_perm.mode & SHM_DEST) ||
+            ds.shm_perm.__key != IPC_PRIVATE) {
+        printf("IPC_STAT of a removed segment failed\n");
+        return -1;
+    }
+    addr2 = shmat(id, NULL, SHM_RDONLY);
+    if (addr2 == (void*)-1 || addr2[1] != 'c') {
+        printf("shmat of a removed segment failed\n");
+        return -1;
+    }
+    if (shmdt(addr2) < 0 || shmdt(addr) < 0) {
+        perror("shmdt");
+        return -1;
+    }
+    if (shmctl(id, IPC_STAT, &ds) == 0 || errno != EINVAL) {
+        printf("segment was not destroyed by the last detach\n");
+        return -1;
+    }
+
+    printf("SysV shm OK\n");
+    return 0;
+}
+
+static void consume(struct ring* ring) {
+    uint64_t head = 0;
+    while (head < RECORDS) {
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            sched_yield();
+            continue;
+        }
+        for (; head < tail; head++) {
+            struct record* rec = &ring->slots[head % RING_SLOTS];
+            if (rec->seq != head || rec->payload[0] != (char)head)
+                exit(1);
+        }
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+    exit(0);
+}
+
+static int test_throughput(void) {
+    int id = shmget(IPC_PRIVATE, sizeof(struct ring), IPC_CREAT | 0600);
+    if (id < 0) {
+        perror("shmget");
+        return -1;
+    }
+    struct ring* ring = shmat(id, NULL, 0);
+    if (ring == (void*)-1) {
+        perror("shmat");
+        return -1;
+    }
+    /* the segment stays until both processes detach */
+    if (shmctl(id, IPC_RMID, NULL) < 0) {
+        perror("shmctl(IPC_RMID)");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0)
+        consume(ring);
+
+    uint64_t start = now_ns();
+    uint64_t tail = 0;
+    while (tail < RECORDS) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail - head == RING_SLOTS) {
+            sched_yield();
+            continue;
+        }
+        for (; tail < RECORDS && tail - head < RING_SLOTS; tail++) {
+            struct record* rec = &ring->slots[tail % RING_SLOTS];
+            rec->seq = tail;
+            memset(rec->payload, (char)tail, sizeof(rec->payload));
+        }
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return -1;
+    }
+    uint64_t elapsed = now_ns() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+        printf("consumer received corrupted records\n");
+        return -1;
+    }
+
+    printf("producer/consumer %d records of %d bytes: %.1f Mrec/s, %.1f MB/s\n", RECORDS,
+           RECORD_SIZE, (double)RECORDS * 1000 / elapsed,
+           (double)RECORDS * RECORD_SIZE * 1000 / elapsed);
+
+    if (shmdt(ring) < 0) {
+        perror("shmdt");
+        return -1;
+    }
+    return 0;
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    if (test_basic() < 0 || test_throughput() < 0)
+        return 1;
+
+    printf("Test successful!\n");
+    return 0;
+}
@@ -321,6 +321,12 @@ class TC_30_Syscall(RegressionTestCase):
         stdout, _ = self.run_binary(['file_size'])
         self.assertIn('test completed successfully', stdout)
 
+    def test_033_sendfile(self):
+        stdout, _ = self.run_binary(['sendfile'])
+        self.assertIn('copy_file_range: OK', stdout)
+        self.assertIn('sendfile and splice: OK', stdout)
+        self.assertIn('TEST OK', stdout)
+
     def test_040_futex_bitset(self):
         stdout, _ = self.run_binary(['futex_bitset'])
 
@@ -381,6 +387,44 @@ class TC_30_Syscall(RegressionTestCase):
 
         self.assertIn('Test successful!', stdout)
 
+    def test_054_mremap(self):
+        stdout, _ = self.run_binary(['mremap'])
+
+        self.assertIn('Test successful!', stdout)
+
+    def test_055_madvise(self):
+        stdout, _ = self.run_binary(['madvise'])
+
+        self.assertIn('Test successful!', stdout)
+
+    def test_056_shared_mmap_msync(self):
+        stdout, _ = self.run_binary(['shared_mmap_msync'])
+
+        self.assertIn('Test successful!', stdout)
+
+    def test_057_hugepages(self):
+        stdout, _ = self.run_binary(['hugepages'], timeout=60)
+
+        self.assertIn('random access: ', stdout)
+        self.assertIn('Test successful!', stdout)
+
+    @unittest.skipIf(HAS_SGX, 'SysV shared memory is not supported on SGX')
+    def test_058_sysv_shm(self):
+        stdout, _ = self.run_binary(['sysv_shm'], timeout=60)
+
+        self.assertIn('SysV shm OK', stdout)
+        self.assertIn('producer/consumer 1048576 records of 64 bytes: ', stdout)
+        self.assertIn('Test successful!', stdout)
+
+    @unittest.skipIf(HAS_SGX, 'POSIX message queues are not supported on SGX')
+    def test_059_mqueue(self):
+        stdout, _ = self.run_binary(['mqueue'], timeout=60)
+
+        self.assertIn('mqueue send/receive OK', stdout)
+        self.assertIn('mqueue poll and notify OK', stdout)
+        self.assertIn('64-byte messages between processes: round trip mqueue ', stdout)
+        self.assertIn('Test successful!', stdout)
+
     @unittest.skip('sigaltstack isn\'t correctly implemented')
     def test_060_sigaltstack(self):
         stdout, _ = self.run_binary(['sigaltstack'])
@@ -408,12 +452,54 @@ class TC_30_Syscall(RegressionTestCase):
         self.assertIn('eventfd_using_various_flags completed successfully', stdout)
         self.assertIn('eventfd_using_fork completed successfully', stdout)
 
+    def test_071_timers(self):
+        stdout, _ = self.run_binary(['timers'], timeout=60)
+
+        self.assertIn('POSIX timer OK', stdout)
+        self.assertIn('setitimer OK', stdout)
+        self.assertIn('timerfd OK', stdout)
+        self.assertIn('arm+cancel of 100000 timers: ', stdout)
+        self.assertIn('Test successful!', stdout)
+
+    def test_072_aio(self):
+        stdout, _ = self.run_binary(['aio'], timeout=60)
+
+        self.assertIn('AIO OK', stdout)
+        self.assertIn('randread bs=4k iodepth=64: ', stdout)
+        self.assertIn('Test successful!', stdout)
+
+    def test_073_storage_hints(self):
+        stdout, _ = self.run_binary(['storage_hints'], timeout=60)
+
+        self.assertIn('fallocate OK', stdout)
+        self.assertIn('fadvise/readahead/sync_file_range/syncfs OK', stdout)
+        self.assertIn('write 32 x 1024 KB: fsync ', stdout)
+        self.assertIn('Test successful!', stdout)
+
+    @unittest.skipIf(HAS_SGX, 'File locks are not shared between processes on SGX')
+    def test_074_file_lock(self):
+        stdout, _ = self.run_binary(['file_lock'], timeout=60)
+
+        self.assertIn('flock OK', stdout)
+        self.assertIn('fcntl locks OK', stdout)
+        self.assertIn('locks across fork OK', stdout)
+        self.assertIn('uncontended lock+unlock: fcntl ', stdout)
+        self.assertIn('contended by a process: fcntl ', stdout)
+        self.assertIn('Test successful!', stdout)
+
     def test_080_sched(self):
         stdout, _ = self.run_binary(['sched'])
 
         # Scheduling Syscalls Test
         self.assertIn('Test completed successfully', stdout)
 
+    def test_081_numa_policy(self):
+        stdout, _ = self.run_binary(['numa_policy'], timeout=60)
+
+        self.assertIn('memory policies OK', stdout)
+        self.assertIn('stream triad on ', stdout)
+        self.assertIn('Test successful!', stdout)
+
     def test_090_sighandler_reset(self):
         stdout, _ = self.run_binary(['sighandler_reset'])
         self.assertIn('Got signal 17', stdout)
@@ -440,6 +526,13 @@ class TC_30_Syscall(RegressionTestCase):
         stdout, _ = self.run_binary(['signal_multithread'])
         self.assertIn('TEST OK', stdout)
 
+    def test_094_signalfd(self):
+        stdout, _ = self.run_binary(['signalfd'], timeout=60)
+        self.assertIn('signalfd read OK', stdout)
+        self.assertIn('signalfd epoll and sigtimedwait OK', stdout)
+        self.assertIn('signal round trip over 10000 rounds: signalfd ', stdout)
+        self.assertIn('Test successful!', stdout)
+
 @unittest.skipUnless(HAS_SGX,
     'This test is only meaningful on SGX PAL because only SGX catches raw '
     'syscalls and redirects to Graphene\'s LibOS. If we will add seccomp to '
@@ -506,6 +599,10 @@ class TC_40_FileSystem(RegressionTestCase):
         stdout, _ = self.run_binary(['fdleak'], timeout=10)
         self.assertIn("Test succeeded.", stdout)
 
+    def test_031_fd_table_threads(self):
+        stdout, _ = self.run_binary(['fd_table_threads'], timeout=60)
+        self.assertIn('Test successful!', stdout)
+
     def test_040_str_close_leak(self):
         stdout, _ = self.run_binary(['str_close_leak'], timeout=60)
         self.assertIn("Success", stdout)
@@ -0,0 +1,276 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/time.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_TIMERS 1000
+#define BENCH_ROUNDS 100
+
+static volatile int g_timer_signals;
+static volatile int g_timer_bad_info;
+static volatile int g_alarm_signals;
+
+static void timer_handler(int sig, siginfo_t* info, void* ucontext) {
+    (void)ucontext;
+    if (sig != SIGUSR1 || info->si_code != SI_TIMER || info->si_value.sival_int != 42)
+        g_timer_bad_info = 1;
+    g_timer_signals++;
+}
+
+static void alarm_handler(int sig) {
+    (void)sig;
+    g_alarm_signals++;
+}
+
+static int test_posix_timer(void) {
+    struct sigaction sa = {
+        .sa_sigaction = timer_handler,
+        .sa_flags     = SA_SIGINFO,
+    };
+    if (sigaction(SIGUSR1, &sa, NULL) < 0) {
+        perror("sigaction");
+        return -1;
+    }
+
+    struct sigevent sev = {
+        .sigev_notify          = SIGEV_SIGNAL,
+        .sigev_signo           = SIGUSR1,
+        .sigev_value.sival_int = 42,
+    };
+    timer_t timer;
+    if (timer_create(CLOCK_MONOTONIC, &sev, &timer) < 0) {
+        perror("timer_create");
+        return -1;
+    }
+
+    struct itimerspec its = {
+        .it_value    = {.tv_nsec = 10 * 1000 * 1000},
+        .it_interval = {.tv_nsec = 10 * 1000 * 1000},
+    };
+    if (timer_settime(timer, 0, &its, NULL) < 0) {
+        perror("timer_settime");
+        return -1;
+    }
+
+    while (g_timer_signals < 3)
+        pause();
+
+    struct itimerspec cur;
+    if (timer_gettime(timer, &cur) < 0) {
+        perror("timer_gettime");
+        return -1;
+    }
+    if (cur.it_interval.tv_nsec != its.it_interval.tv_nsec) {
+        printf("timer_gettime returned a wrong interval\n");
+        return -1;
+    }
+
+    if (timer_delete(timer) < 0) {
+        perror("timer_delete");
+        return -1;
+    }
+
+    if (g_timer_bad_info) {
+        printf("POSIX timer delivered a wrong siginfo\n");
+        return -1;
+    }
+    printf("POSIX timer OK\n");
+    return 0;
+}
+
+static int test_itimer(void) {
+    if (signal(SIGALRM, alarm_handler) == SIG_ERR) {
+        perror("signal");
+        return -1;
+    }
+
+    struct itimerval itv = {
+        .it_value    = {.tv_usec = 5000},
+        .it_interval = {.tv_usec = 5000},
+    };
+    if (setitimer(ITIMER_REAL, &itv, NULL) < 0) {
+        perror("setitimer");
+        return -1;
+    }
+
+    while (g_alarm_signals < 3)
+        pause();
+
+    struct itimerval old;
+    memset(&itv, 0, sizeof(itv));
+    if (setitimer(ITIMER_REAL, &itv, &old) < 0) {
+        perror("setitimer");
+        return -1;
+    }
+    if (old.it_interval.tv_usec != 5000) {
+        printf("setitimer returned a wrong old interval\n");
+        return -1;
+    }
+
+    /* alarm() shares ITIMER_REAL: a pending alarm is reported and cancelled */
+    alarm(100);
+    if (alarm(0) != 100) {
+        printf("alarm did not report the pending alarm\n");
+        return -1;
+    }
+
+    printf("setitimer OK\n");
+    return 0;
+}
+
+static int test_timerfd(void) {
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    uint64_t expirations;
+    if (read(tfd, &expirations, sizeof(expirations)) != -1 || errno != EAGAIN) {
+        printf("read from a disarmed timerfd did not fail with EAGAIN\n");
+        return -1;
+    }
+
+    int efd = epoll_create1(0);
+    if (efd < 0) {
+        perror("epoll_create1");
+        return -1;
+    }
+
+    struct epoll_event ev = {.events = EPOLLIN, .data.fd = tfd};
+    if (epoll_ctl(efd, EPOLL_CTL_ADD, tfd, &ev) < 0) {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    struct itimerspec its = {
+        .it_value    = {.tv_nsec = 20 * 1000 * 1000},
+        .it_interval = {.tv_nsec = 20 * 1000 * 1000},
+    };
+    if (timerfd_settime(tfd, 0, &its, NULL) < 0) {
+        perror("timerfd_settime");
+        return -1;
+    }
+
+    uint64_t total = 0;
+    while (total < 3) {
+        struct epoll_event out;
+        int n = epoll_wait(efd, &out, 1, 5000);
+        if (n != 1 || out.data.fd != tfd) {
+            printf("epoll_wait on timerfd returned %d\n", n);
+            return -1;
+        }
+        if (read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations) || !expirations) {
+            printf("read from an expired timerfd failed\n");
+            return -1;
+        }
+        total += expirations;
+    }
+
+    struct itimerspec cur;
+    if (timerfd_gettime(tfd, &cur) < 0 || cur.it_interval.tv_nsec != its.it_interval.tv_nsec) {
+        printf("timerfd_gettime failed\n");
+        return -1;
+    }
+
+    /* a child gets the expirations not read yet, and an eventfd of its own for poll() */
+    struct itimerspec once = {.it_value = {.tv_nsec = 10 * 1000 * 1000}};
+    if (timerfd_settime(tfd, 0, &once, NULL) < 0) {
+        perror("timerfd_settime");
+        return -1;
+    }
+    struct pollfd pfd = {.fd = tfd, .events = POLLIN};
+    if (poll(&pfd, 1, 5000) != 1) {
+        printf("poll on timerfd did not report the expiration\n");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        if (poll(&pfd, 1, 5000) != 1 ||
+                read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations) ||
+                expirations != 1)
+            exit(1);
+        pfd.revents = 0;
+        exit(poll(&pfd, 1, 0) == 0 ? 0 : 2);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("timerfd in the child failed (status %d)\n", status);
+        return -1;
+    }
+
+    close(efd);
+    close(tfd);
+    printf("timerfd OK\n");
+    return 0;
+}
+
+static int bench_arm_cancel(void) {
+    static timer_t timers[BENCH_TIMERS];
+    struct sigevent sev = {.sigev_notify = SIGEV_NONE};
+
+    for (int i = 0; i < BENCH_TIMERS; i++) {
+        if (timer_create(CLOCK_MONOTONIC, &sev, &timers[i]) < 0) {
+            perror("timer_create");
+            return -1;
+        }
+    }
+
+    struct itimerspec arm    = {.it_value = {.tv_sec = 3600}};
+    struct itimerspec disarm = {0};
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (int i = 0; i < BENCH_TIMERS; i++) {
+            arm.it_value.tv_nsec = (i * 7919 + r) % 1000000000;
+            if (timer_settime(timers[i], 0, &arm, NULL) < 0) {
+                perror("timer_settime");
+                return -1;
+            }
+        }
+        for (int i = 0; i < BENCH_TIMERS; i++) {
+            if (timer_settime(timers[i], 0, &disarm, NULL) < 0) {
+                perror("timer_settime");
+                return -1;
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (int i = 0; i < BENCH_TIMERS; i++)
+        timer_delete(timers[i]);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("arm+cancel of %d timers: %.0f ns per pair\n", BENCH_TIMERS * BENCH_ROUNDS,
+           ns / (BENCH_TIMERS * BENCH_ROUNDS));
+    return 0;
+}
+
+int main(void) {
+    setbuf(stdout, NULL);
+
+    if (test_posix_timer() < 0 || test_itimer() < 0 || test_timerfd() < 0 ||
+            bench_arm_cancel() < 0)
+        return 1;
+
+    printf("Test successful!\n");
+    return 0;
+}
@@ -215,6 +215,10 @@ DEFINE_LISTP(config);
 struct config_store {
     LISTP_TYPE(config) root;
     LISTP_TYPE(config) entries;
+    struct config ** index;        /* open-addressing hash table of all entries, keyed by the
+                                      parent entry and the key token */
+    size_t           index_size;   /* number of slots, a power of two */
+    size_t           index_count;
     void *           raw_data;
     int              raw_size;
     void *           (*malloc) (size_t);
@@ -248,6 +252,7 @@ int set_config (struct config_store * cfg, const char * key, const char * val);
 #define URI_TYPE_DEV            "dev"
 #define URI_TYPE_EVENTFD        "eventfd"
 #define URI_TYPE_FILE           "file"
+#define URI_TYPE_SHM            "shm"
 
 #define URI_PREFIX_DIR          URI_TYPE_DIR        URI_PREFIX_SEPARATOR
 #define URI_PREFIX_TCP          URI_TYPE_TCP        URI_PREFIX_SEPARATOR
@@ -259,6 +264,7 @@ int set_config (struct config_store * cfg, const char * key, const char * val);
 #define URI_PREFIX_DEV          URI_TYPE_DEV        URI_PREFIX_SEPARATOR
 #define URI_PREFIX_EVENTFD      URI_TYPE_EVENTFD    URI_PREFIX_SEPARATOR
 #define URI_PREFIX_FILE         URI_TYPE_FILE       URI_PREFIX_SEPARATOR
+#define URI_PREFIX_SHM          URI_TYPE_SHM        URI_PREFIX_SEPARATOR
 
 #define URI_PREFIX_FILE_LEN     (static_strlen(URI_PREFIX_FILE))
 
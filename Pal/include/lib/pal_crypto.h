@@ -53,6 +53,30 @@ typedef struct {
     int stream_fd;
 } LIB_SSL_CONTEXT;
 
+#include "mbedtls/gcm.h"
+#define SECURE_CHANNEL_KEY_SIZE   16
+#define SECURE_CHANNEL_MAX_RECORD (64UL * 1024)
+#define SECURE_CHANNEL_NONCE_PREFIX_SIZE 4
+typedef struct {
+    mbedtls_gcm_context send_gcm;
+    mbedtls_gcm_context recv_gcm;
+    uint8_t send_key[SECURE_CHANNEL_KEY_SIZE];
+    uint8_t recv_key[SECURE_CHANNEL_KEY_SIZE];
+    uint8_t send_nonce_prefix[SECURE_CHANNEL_NONCE_PREFIX_SIZE];
+    uint8_t recv_nonce_prefix[SECURE_CHANNEL_NONCE_PREFIX_SIZE];
+    uint64_t send_seq;
+    uint64_t recv_seq;
+    uint8_t* send_buf;  /* the record being sent */
+    size_t send_buf_size;
+    uint8_t* recv_buf;  /* plaintext of a record which did not fit into the reader's buffer */
+    size_t recv_buf_size;
+    size_t recv_pos;    /* [recv_pos, recv_len) of recv_buf is not read yet */
+    size_t recv_len;
+    ssize_t (*pal_recv_cb)(int fd, void* buf, size_t len);
+    ssize_t (*pal_send_cb)(int fd, const void* buf, size_t len);
+    int stream_fd;
+} LIB_SECURE_CHANNEL;
+
 #endif /* CRYPTO_USE_MBEDTLS */
 
 #ifndef CRYPTO_PROVIDER_SPECIFIED
@@ -77,6 +101,11 @@ void lib_DhFinal(LIB_DH_CONTEXT *context);
 int lib_AESCMAC(const uint8_t *key, uint64_t key_len, const uint8_t *input,
                 uint64_t input_len, uint8_t *mac, uint64_t mac_len);
 
+/* Computes AES-CMAC of `count` independent inputs with the same key and stores the 16-byte MACs
+ * consecutively in `macs`. Faster than separate 'lib_AESCMAC' calls if the CPU supports AES-NI. */
+int lib_AESCMACBatch(const uint8_t* key, uint64_t key_len, const uint8_t* const* inputs,
+                     const uint64_t* input_lens, uint8_t* macs, size_t count);
+
 /* note: 'lib_AESCMAC' is the combination of 'lib_AESCMACInit',
  * 'lib_AESCMACUpdate', and 'lib_AESCMACFinish'. */
 int lib_AESCMACInit(LIB_AESCMAC_CONTEXT * context,
@@ -127,4 +156,17 @@ int lib_SSLHandshake(LIB_SSL_CONTEXT* ssl_ctx);
 int lib_SSLRead(LIB_SSL_CONTEXT* ssl_ctx, uint8_t* buf, size_t len);
 int lib_SSLWrite(LIB_SSL_CONTEXT* ssl_ctx, const uint8_t* buf, size_t len);
 int lib_SSLSave(LIB_SSL_CONTEXT* ssl_ctx, uint8_t* buf, size_t len, size_t* olen);
+
+/* Secure channel: AES-GCM records keyed from a pre-shared key, without TLS handshake and record
+ * processing. Both ends must use the same `psk` and different `is_server`. Otherwise used like the
+ * SSL/TLS functions above. */
+int lib_SecureChannelInit(LIB_SECURE_CHANNEL* ch, int stream_fd, bool is_server,
+                          const uint8_t* psk, size_t psk_size,
+                          ssize_t (*pal_recv_cb)(int fd, void* buf, size_t len),
+                          ssize_t (*pal_send_cb)(int fd, const void* buf, size_t len),
+                          const uint8_t* buf_load_ctx, size_t buf_size);
+int lib_SecureChannelFree(LIB_SECURE_CHANNEL* ch);
+int lib_SecureChannelRead(LIB_SECURE_CHANNEL* ch, uint8_t* buf, size_t len);
+int lib_SecureChannelWrite(LIB_SECURE_CHANNEL* ch, const uint8_t* buf, size_t len);
+int lib_SecureChannelSave(LIB_SECURE_CHANNEL* ch, uint8_t* buf, size_t len, size_t* olen);
 #endif
@@ -123,12 +123,42 @@ typedef struct PAL_CPU_INFO_ {
     PAL_NUM cpu_stepping;
     double  cpu_bogomips;
     PAL_STR cpu_flags;
+    PAL_IDX* cpu_id;         /*!< host ID of each CPU (IDs may be sparse), array of `cpu_num`
+                                  entries in ascending order */
+    PAL_IDX* cpu_core_id;    /*!< core ID of each CPU within its package, indexed like `cpu_id` */
+    PAL_IDX* cpu_package_id; /*!< physical package (socket) of each CPU, indexed like `cpu_id` */
+    PAL_NUM cpu_numa_nodes;  /*!< number of NUMA nodes (at least 1) */
+    PAL_IDX* cpu_numa_node;  /*!< NUMA node of each CPU, indexed like `cpu_id` */
 } PAL_CPU_INFO;
 
 typedef struct PAL_MEM_INFO_ {
     PAL_NUM mem_total;
 } PAL_MEM_INFO;
 
+/*! Start-up phases of the PAL, timed for the boot profiler (see `loader.boot_profile`) */
+enum PAL_BOOT_PHASE {
+    PAL_BOOT_PHASE_HOST = 0,  /*!< host-specific setup before pal_main() (e.g. enclave creation) */
+    PAL_BOOT_PHASE_MANIFEST,  /*!< opening and parsing of the manifest */
+    PAL_BOOT_PHASE_ARGV_ENV,  /*!< loading of arguments and environment variables */
+    PAL_BOOT_PHASE_PRELOAD,   /*!< loading of libraries from `loader.preload` */
+    PAL_BOOT_PHASE_EXEC,      /*!< loading of the executable */
+    PAL_BOOT_PHASE_HOST_INFO, /*!< querying of the address range, CPU and memory information */
+    PAL_BOOT_PHASE_NUM,
+};
+
+typedef struct PAL_BOOT_COUNTERS_ {
+    PAL_NUM files_opened;    /*!< number of streams opened */
+    PAL_NUM bytes_hashed;    /*!< number of bytes of trusted files hashed (SGX only) */
+    PAL_NUM pages_allocated; /*!< number of pages allocated by DkVirtualMemoryAlloc() */
+} PAL_BOOT_COUNTERS;
+
+typedef struct PAL_BOOT_PROFILE_ {
+    PAL_NUM start_time; /*!< time when the process was started (in microseconds) */
+    PAL_NUM phase_end[PAL_BOOT_PHASE_NUM]; /*!< end time of each PAL start-up phase */
+    PAL_BOOT_COUNTERS phase_counters[PAL_BOOT_PHASE_NUM]; /*!< counters at the end of each phase */
+    PAL_BOOT_COUNTERS counters; /*!< counters, updated during the whole lifetime of the process */
+} PAL_BOOT_PROFILE;
+
 /********** PAL APIs **********/
 typedef struct PAL_CONTROL_ {
     PAL_STR host_type;
@@ -169,6 +199,8 @@ typedef struct PAL_CONTROL_ {
 
     PAL_CPU_INFO cpu_info; /*!< CPU information (only required ones) */
     PAL_MEM_INFO mem_info; /*!< memory information (only required ones) */
+
+    PAL_BOOT_PROFILE boot_profile; /*!< timing of start-up phases and related counters */
 } PAL_CONTROL;
 
 #define pal_control (*pal_control_addr())
@@ -182,8 +214,9 @@ PAL_CONTROL * pal_control_addr (void);
 enum PAL_ALLOC {
     PAL_ALLOC_RESERVE  = 0x1, /*!< Only reserve the memory */
     PAL_ALLOC_INTERNAL = 0x2, /*!< Allocate for PAL (valid only if #IN_PAL) */
+    PAL_ALLOC_HUGEPAGE = 0x4, /*!< Hint to back the memory with huge pages where possible */
 
-    PAL_ALLOC_MASK     = 0x3,
+    PAL_ALLOC_MASK     = 0x7,
 };
 
 /*! Memory Protection Flags */
@@ -209,6 +242,10 @@ enum PAL_PROT {
  * \param size must be a positive number, aligned at the allocation alignment.
  * \param alloc_type can be a combination of any of the #PAL_ALLOC flags
  * \param prot can be a combination of the #PAL_PROT flags
+ *
+ * #PAL_ALLOC_HUGEPAGE is only a hint: the memory still behaves like ordinary memory (it can be
+ * freed or protected in parts), and huge pages are used only in the parts of the range that are
+ * aligned to the huge page size. PALs that cannot provide huge pages ignore it.
  */
 PAL_PTR
 DkVirtualMemoryAlloc(PAL_PTR addr, PAL_NUM size, PAL_FLG alloc_type, PAL_FLG prot);
@@ -237,6 +274,98 @@ DkVirtualMemoryFree(PAL_PTR addr, PAL_NUM size);
 PAL_BOL
 DkVirtualMemoryProtect(PAL_PTR addr, PAL_NUM size, PAL_FLG prot);
 
+/*!
+ * \brief Move a previously allocated memory mapping to another address without copying it.
+ *
+ * \param old_addr the current address of the mapping
+ * \param new_addr the address to move the mapping to
+ * \param size the size of the mapping
+ *
+ * All pages in [`old_addr`, `old_addr` + `size`) are moved to [`new_addr`, `new_addr` + `size`),
+ * keeping their contents and permissions; any mapping previously at the new range is replaced and
+ * the old range is left unallocated. The two ranges must not overlap. All of `old_addr`,
+ * `new_addr` and `size` must be non-zero and aligned at the allocation alignment.
+ *
+ * Not all PALs can do this (e.g. enclave pages cannot be moved); they fail with
+ * #PAL_ERROR_NOTIMPLEMENTED and the caller is expected to fall back to allocating the new range,
+ * copying the contents and freeing the old range.
+ */
+PAL_BOL
+DkVirtualMemoryMove(PAL_PTR old_addr, PAL_PTR new_addr, PAL_NUM size);
+
+/*! Memory usage advice */
+enum PAL_MADVISE {
+    PAL_MADVISE_NORMAL = 0,
+    PAL_MADVISE_RANDOM,
+    PAL_MADVISE_SEQUENTIAL,
+    PAL_MADVISE_WILLNEED,
+    PAL_MADVISE_DONTNEED,   /*!< contents are discarded, the memory reads back as zeroes */
+    PAL_MADVISE_FREE,       /*!< contents may be discarded until the memory is written again */
+    PAL_MADVISE_HUGEPAGE,
+    PAL_MADVISE_NOHUGEPAGE,
+};
+
+/*!
+ * \brief Advise the PAL how a previously allocated memory range is going to be used.
+ *
+ * \param addr the address
+ * \param size the size
+ * \param advice one of the #PAL_MADVISE values
+ *
+ * Both `addr` and `size` must be non-zero and aligned at the allocation alignment. Only
+ * #PAL_MADVISE_DONTNEED has to take effect: the memory must be released to the host if possible
+ * and zeroed otherwise. All other advice values are hints which a PAL is free to ignore.
+ */
+PAL_BOL
+DkVirtualMemoryAdvise(PAL_PTR addr, PAL_NUM size, PAL_FLG advice);
+
+/*! NUMA memory placement policies */
+enum PAL_MPOL {
+    PAL_MPOL_DEFAULT = 0,   /*!< no policy of its own: the policy of the thread applies */
+    PAL_MPOL_PREFERRED,     /*!< allocate on the node in the mask if it has free memory */
+    PAL_MPOL_BIND,          /*!< allocate only on the nodes in the mask */
+    PAL_MPOL_INTERLEAVE,    /*!< interleave pages over the nodes in the mask */
+    PAL_MPOL_LOCAL,         /*!< allocate on the node of the CPU which first touches the page */
+};
+
+/*! Flags of DkVirtualMemoryPolicy() */
+enum PAL_MPOL_FLAGS {
+    PAL_MPOL_MOVE = 0x1, /*!< also move already allocated pages so that they follow the policy */
+};
+
+/*!
+ * \brief Set the NUMA placement policy of a previously allocated memory range.
+ *
+ * \param addr the address, or NULL to set the default policy of the calling thread
+ * \param size the size; must be 0 if `addr` is NULL
+ * \param mode one of the #PAL_MPOL values
+ * \param nodemask bitmask of NUMA nodes (as numbered in `cpu_info.cpu_numa_node`); must be empty
+ *                 for #PAL_MPOL_DEFAULT and #PAL_MPOL_LOCAL
+ * \param flags can be a combination of the #PAL_MPOL_FLAGS
+ *
+ * Both `addr` and `size` must be aligned at the allocation alignment. The policy only decides
+ * where pages allocated afterwards are placed (and with #PAL_MPOL_MOVE where the existing ones
+ * are moved); it never changes the contents of the memory. PALs which cannot control memory
+ * placement fail with #PAL_ERROR_NOTIMPLEMENTED.
+ */
+PAL_BOL
+DkVirtualMemoryPolicy(PAL_PTR addr, PAL_NUM size, PAL_FLG mode, PAL_NUM nodemask, PAL_FLG flags);
+
+/*!
+ * \brief Query or change the NUMA nodes on which pages are placed.
+ *
+ * \param count the number of pages
+ * \param pages array of `count` page addresses, aligned at the allocation alignment
+ * \param nodes NULL to only query the pages, otherwise array of `count` nodes to move them to
+ * \param[out] status array of `count` entries which receive the node of each page after the call,
+ *                    or #PAL_IDX_POISON if the page is not backed by memory yet (or could not be
+ *                    moved)
+ *
+ * PALs which cannot tell where memory is placed fail with #PAL_ERROR_NOTIMPLEMENTED.
+ */
+PAL_BOL
+DkVirtualMemoryNodes(PAL_NUM count, PAL_PTR* pages, const PAL_IDX* nodes, PAL_IDX* status);
+
 
 /*
  * PROCESS CREATION
@@ -385,6 +514,20 @@ DkStreamRead(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM count, PAL_PTR buffer, P
 PAL_NUM
 DkStreamWrite(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM count, PAL_PTR buffer, PAL_STR dest);
 
+/*!
+ * \brief Copy data from one open stream to another without passing it through the caller.
+ *
+ * `src_offset` and `dst_offset` are used only if the corresponding handle is a file. The host copies
+ * the data directly (e.g., via `sendfile`, `splice` or `copy_file_range` on Linux).
+ *
+ * \return number of bytes copied (may be less than `count`), 0 at the end of `src`, or
+ *  PAL_STREAM_ERROR on failure. If the host cannot copy between these two streams, the error is
+ *  PAL_ERROR_NOTSUPPORT and the caller should fall back to DkStreamRead() and DkStreamWrite().
+ */
+PAL_NUM
+DkStreamCopy(PAL_HANDLE dst, PAL_NUM dst_offset, PAL_HANDLE src, PAL_NUM src_offset,
+             PAL_NUM count);
+
 enum PAL_DELETE {
     PAL_DELETE_RD = 1, /*!< shut down the read side only */
     PAL_DELETE_WR = 2, /*!< shut down the write side only */
@@ -431,6 +574,111 @@ DkStreamSetLength(PAL_HANDLE handle, PAL_NUM length);
 PAL_BOL
 DkStreamFlush(PAL_HANDLE handle);
 
+/*! Storage allocation modes of DkStreamAllocate() */
+enum PAL_FALLOC {
+    PAL_FALLOC_KEEP_SIZE  = 1, /*!< do not change the length of the file */
+    PAL_FALLOC_PUNCH_HOLE = 2, /*!< deallocate the range, it reads back as zeroes; requires
+                                    #PAL_FALLOC_KEEP_SIZE */
+    PAL_FALLOC_ZERO_RANGE = 4, /*!< zero the range and allocate storage for it */
+};
+
+/*!
+ * \brief Allocate (or deallocate) storage for a range of a file stream.
+ *
+ * \param mode a combination of #PAL_FALLOC flags; if 0, storage is allocated for the range and the
+ *  file is extended if the range ends after its current length
+ *
+ * A PAL that cannot reserve storage fails with #PAL_ERROR_NOTSUPPORT; the caller may then extend the
+ * file with DkStreamSetLength() instead. Running out of storage fails with #PAL_ERROR_NOMEM.
+ */
+PAL_BOL
+DkStreamAllocate(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM length, PAL_FLG mode);
+
+/*! File access pattern advice */
+enum PAL_FADVISE {
+    PAL_FADVISE_NORMAL = 0,
+    PAL_FADVISE_RANDOM,
+    PAL_FADVISE_SEQUENTIAL,
+    PAL_FADVISE_WILLNEED, /*!< start reading the range into the host cache */
+    PAL_FADVISE_DONTNEED, /*!< drop the (clean) cached pages of the range */
+    PAL_FADVISE_NOREUSE,
+};
+
+/*!
+ * \brief Advise the PAL how a range of a file stream is going to be accessed.
+ *
+ * \param length the length of the range; 0 means up to the end of the file
+ * \param advice one of the #PAL_FADVISE values
+ *
+ * All advice values are hints: a PAL that cannot pass them on to the host ignores them and
+ * succeeds.
+ */
+PAL_BOL
+DkStreamAdvise(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM length, PAL_FLG advice);
+
+/*! Flags of DkStreamFlushRange() */
+enum PAL_FLUSH_RANGE {
+    PAL_FLUSH_RANGE_WAIT_BEFORE = 1, /*!< wait for write-out of the range already in progress */
+    PAL_FLUSH_RANGE_WRITE       = 2, /*!< start write-out of the dirty data of the range */
+    PAL_FLUSH_RANGE_WAIT_AFTER  = 4, /*!< wait for the write-out to complete */
+};
+
+/*!
+ * \brief Write the dirty data of a range of a file stream to the device.
+ *
+ * \param length the length of the range; 0 means up to the end of the file
+ * \param flags a combination of #PAL_FLUSH_RANGE flags
+ *
+ * Unlike DkStreamFlush(), this neither waits for nor writes the file metadata, so the data is not
+ * guaranteed to survive a crash. A PAL that cannot flush a range flushes the whole stream as
+ * DkStreamFlush() does if any flag is given.
+ */
+PAL_BOL
+DkStreamFlushRange(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM length, PAL_FLG flags);
+
+/*! Types of advisory stream locks */
+enum PAL_LOCK {
+    PAL_LOCK_UNLOCK = 0,
+    PAL_LOCK_SHARED,
+    PAL_LOCK_EXCLUSIVE,
+};
+
+/*! Flags of DkStreamLock() */
+enum PAL_LOCK_FLAGS {
+    PAL_LOCK_WAIT  = 1, /*!< wait until conflicting locks are released */
+    PAL_LOCK_WHOLE = 2, /*!< lock the whole stream, like flock() does; such locks only conflict with
+                             other whole-stream locks */
+};
+
+/*!
+ * \brief Acquire, convert or release an advisory lock on a range of a file stream.
+ *
+ * \param type one of the #PAL_LOCK values
+ * \param length the length of the range; 0 means up to the end of the file, however long it grows
+ * \param flags a combination of #PAL_LOCK_FLAGS; with #PAL_LOCK_WHOLE, offset and length must be 0
+ *
+ * Locks are owned by the handle: locks of other handles on the same file, in this or another
+ * process, conflict with them, while locks of the same handle are merged, split or converted.
+ * Closing the handle releases its locks. If a conflicting lock is held, the call fails with
+ * #PAL_ERROR_TRYAGAIN unless #PAL_LOCK_WAIT is given; a wait interrupted by a signal fails with
+ * #PAL_ERROR_INTERRUPTED. A PAL that cannot lock host files fails with #PAL_ERROR_NOTIMPLEMENTED.
+ */
+PAL_BOL
+DkStreamLock(PAL_HANDLE handle, PAL_FLG type, PAL_NUM offset, PAL_NUM length, PAL_FLG flags);
+
+/*!
+ * \brief Find a lock of another handle that conflicts with a range lock.
+ *
+ * \param[in,out] type on input, the #PAL_LOCK type of the lock to test; on output,
+ *  #PAL_LOCK_UNLOCK if the lock could be placed, or the type of a conflicting lock
+ * \param[in,out] offset,length on input, the range to test; on output, the range of the
+ *  conflicting lock (if any); a length of 0 means up to the end of the file
+ *
+ * Whole-stream locks are not considered. Fails like DkStreamLock() if locking is not implemented.
+ */
+PAL_BOL
+DkStreamLockQuery(PAL_HANDLE handle, PAL_FLG* type, PAL_NUM* offset, PAL_NUM* length);
+
 /*!
  * \brief Send a PAL handle over another handle.
  *
@@ -549,6 +797,38 @@ noreturn void DkThreadExit(PAL_PTR clear_child_tid);
 PAL_BOL
 DkThreadResume(PAL_HANDLE thread);
 
+/*!
+ * \brief Set the CPU affinity of a thread.
+ *
+ * \param thread the thread handle; NULL means the current thread
+ * \param cpumask_size size in bytes of the CPU bitmask
+ * \param cpu_mask bitmask of CPUs the thread is allowed to run on, in the same format as the
+ *  Linux `cpu_set_t`
+ */
+PAL_BOL
+DkThreadSetCpuAffinity(PAL_HANDLE thread, PAL_NUM cpumask_size, PAL_PTR cpu_mask);
+
+/*!
+ * \brief Get the CPU affinity of a thread.
+ *
+ * \param thread the thread handle; NULL means the current thread
+ * \param cpumask_size size in bytes of the CPU bitmask
+ * \param cpu_mask buffer which receives the bitmask of CPUs the thread is allowed to run on
+ */
+PAL_BOL
+DkThreadGetCpuAffinity(PAL_HANDLE thread, PAL_NUM cpumask_size, PAL_PTR cpu_mask);
+
+/*!
+ * \brief Get the CPU and NUMA node on which the current thread is running.
+ *
+ * The result is only a hint: the thread may be migrated to another CPU right after this call.
+ *
+ * \param[out] cpu receives the host CPU ID (as in `cpu_info.cpu_id`); may be NULL
+ * \param[out] node receives the NUMA node index; may be NULL
+ */
+PAL_BOL
+DkThreadGetCurrentCpu(PAL_IDX* cpu, PAL_IDX* node);
+
 /*
  * Exception Handling
  */
@@ -687,6 +967,61 @@ enum PAL_WAIT {
 PAL_BOL DkStreamsWaitEvents(PAL_NUM count, PAL_HANDLE* handle_array, PAL_FLG* events,
                             PAL_FLG* ret_events, PAL_NUM timeout_us);
 
+enum PAL_IO_OP {
+    PAL_IO_READ  = 0, /*!< like DkStreamRead(), but returns 0 at the end of the stream */
+    PAL_IO_WRITE = 1, /*!< like DkStreamWrite() */
+    PAL_IO_FLUSH = 2, /*!< like DkStreamFlush(); `offset`, `count` and `buffer` are ignored */
+    PAL_IO_POLL  = 3, /*!< waits until one of the PAL_WAIT events in `count` happens and returns
+                           the events that happened */
+};
+
+/*! One operation of DkStreamsBatchIo() */
+typedef struct {
+    PAL_HANDLE handle;
+    PAL_NUM op;     /*!< one of PAL_IO_OP */
+    PAL_NUM offset; /*!< used only for files */
+    PAL_NUM count;
+    PAL_PTR buffer;
+    PAL_NUM result; /*!< [out] as returned by the corresponding PAL call, or PAL_STREAM_ERROR */
+    PAL_NUM error;  /*!< [out] PAL error code if `result` is PAL_STREAM_ERROR */
+} PAL_IO_REQUEST;
+
+/*!
+ * \brief Perform several stream operations at once.
+ *
+ * The operations are independent and may be performed concurrently and in any order (e.g., the
+ * Linux PAL submits them to io_uring in one system call if the manifest sets
+ * `loader.io_uring = 1`). Returns after all of them completed.
+ *
+ * \return true if all operations were performed (each may have failed separately, see `result`),
+ *  false if the arguments are invalid
+ */
+PAL_BOL DkStreamsBatchIo(PAL_IO_REQUEST* requests, PAL_NUM count);
+
+/*!
+ * \brief Wait until the 32-bit value at `addr` changes.
+ *
+ * The definition follows the WIN32 WaitOnAddress API. The wait is not limited to the calling
+ * process: `addr` may point into memory shared with other processes (e.g. mapped from a `shm:`
+ * stream), in which case DkWakeByAddress from any of these processes wakes the waiter.
+ *
+ * \param addr address of the value to wait on, must be 4-byte aligned
+ * \param expected the caller goes to sleep only if `*addr` still equals `expected`
+ * \param timeout_us is the maximum time that the API should wait (in microseconds), or #NO_TIMEOUT
+ *  to indicate it is to be blocked until woken up
+ * \return true if woken up or if `*addr` differed from `expected`, false otherwise (on timeout,
+ *  PAL_ERROR_TRYAGAIN is raised); spurious wake-ups are possible, callers must re-check the value
+ */
+PAL_BOL DkWaitOnAddress(PAL_PTR addr, PAL_IDX expected, PAL_NUM timeout_us);
+
+/*!
+ * \brief Wake up threads waiting on `addr` in DkWaitOnAddress.
+ *
+ * \param addr address the waiters passed to DkWaitOnAddress
+ * \param count maximum number of waiters to wake up
+ */
+void DkWakeByAddress(PAL_PTR addr, PAL_NUM count);
+
 /*!
  * \brief Close (deallocate) a PAL handle.
  */
@@ -703,6 +1038,21 @@ void DkObjectClose(PAL_HANDLE objectHandle);
 PAL_NUM
 DkSystemTimeQuery(void);
 
+typedef void (*PAL_CALL_TRACER) (PAL_STR name, PAL_NUM start_time, PAL_NUM end_time);
+
+/*!
+ * \brief Set the tracer of PAL calls.
+ *
+ * After this call, \p tracer is invoked at the end of most PAL calls with the name of the call and
+ * its start and end time (in microseconds, as returned by DkSystemTimeQuery()). The tracer is
+ * invoked in the context of the calling thread and must not call any PAL functions except
+ * DkSystemTimeQuery().
+ *
+ * \param tracer the tracer function, or NULL to disable tracing
+ */
+void
+DkSetCallTracer(PAL_CALL_TRACER tracer);
+
 /*!
  * \brief Cryptographically secure random.
  *
@@ -0,0 +1,302 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Hardware-accelerated primitives used by the mbedTLS adapter, selected at runtime:
+ *
+ * - SHA-256 block function (mbedTLS is built with MBEDTLS_SHA256_PROCESS_ALT and calls
+ *   mbedtls_internal_sha256_process() defined here), using the SHA extensions if available and a
+ *   portable implementation otherwise.
+ * - AES-128-CMAC of many independent messages with AES-NI. CMAC of one message is a chain of
+ *   dependent AES encryptions, so the AES unit is mostly idle; processing several messages at once
+ *   interleaves their chains.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "api.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls_adapter.h"
+#include "pal_error.h"
+
+#ifdef __x86_64__
+#include <immintrin.h>
+#endif
+
+static const uint32_t g_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_process_generic(uint32_t state[8], const uint8_t data[64]) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+        w[i] = (uint32_t)data[4 * i] << 24 | (uint32_t)data[4 * i + 1] << 16 |
+               (uint32_t)data[4 * i + 2] << 8 | (uint32_t)data[4 * i + 3];
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) + ((e & f) ^ (~e & g)) +
+                      g_sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+                      ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+#ifdef __x86_64__
+
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t words[4]) {
+    __asm__ volatile("cpuid"
+                     : "=a"(words[0]), "=b"(words[1]), "=c"(words[2]), "=d"(words[3])
+                     : "a"(leaf), "c"(subleaf));
+}
+
+#define CPU_FEATURE_AESNI  0x1
+#define CPU_FEATURE_SHA    0x2
+#define CPU_FEATURE_KNOWN  0x80000000
+
+static uint32_t cpu_features(void) {
+    /* racing threads compute the same value; on SGX, CPUID is emulated and costs an OCALL, so it
+     * is executed only once */
+    static uint32_t features = 0;
+
+    uint32_t ret = __atomic_load_n(&features, __ATOMIC_RELAXED);
+    if (ret)
+        return ret;
+
+    uint32_t words[4];
+    ret = CPU_FEATURE_KNOWN;
+    cpuid(0, 0, words);
+    uint32_t max_leaf = words[0];
+
+    cpuid(1, 0, words);
+    bool ssse3  = words[2] & (1U << 9);
+    bool sse4_1 = words[2] & (1U << 19);
+    if (words[2] & (1U << 25))
+        ret |= CPU_FEATURE_AESNI;
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, words);
+        if ((words[1] & (1U << 29)) && ssse3 && sse4_1)
+            ret |= CPU_FEATURE_SHA;
+    }
+
+    __atomic_store_n(&features, ret, __ATOMIC_RELAXED);
+    return ret;
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_process_shani(uint32_t state[8], const uint8_t data[64]) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    /* the SHA instructions keep the state as ABEF and CDGH */
+    __m128i tmp    = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    __m128i abef_save = state0;
+    __m128i cdgh_save = state1;
+
+    /* w[g % 4] holds message words 4g..4g+3 */
+    __m128i w[4];
+    for (int g = 0; g < 16; g++) {
+        if (g < 4) {
+            w[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * g)), bswap);
+        } else {
+            __m128i x = _mm_sha256msg1_epu32(w[g % 4], w[(g + 1) % 4]);
+            x = _mm_add_epi32(x, _mm_alignr_epi8(w[(g + 3) % 4], w[(g + 2) % 4], 4));
+            w[g % 4] = _mm_sha256msg2_epu32(x, w[(g + 3) % 4]);
+        }
+
+        __m128i k   = _mm_loadu_si128((const __m128i*)&g_sha256_k[4 * g]);
+        __m128i msg = _mm_add_epi32(w[g % 4], k);
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+    }
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#define CMAC_LANES 4
+
+static void erase_memory(void* buf, size_t size) {
+    volatile uint8_t* p = buf;
+    while (size--)
+        *p++ = 0;
+}
+
+__attribute__((target("aes")))
+static void aes128_expand_key(const uint8_t key[16], __m128i rk[11]) {
+#define EXPAND_ROUND(i, rcon)                                              \
+    do {                                                                   \
+        __m128i t = _mm_aeskeygenassist_si128(rk[(i) - 1], rcon);          \
+        __m128i k = rk[(i) - 1];                                           \
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));                        \
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));                        \
+        k = _mm_xor_si128(k, _mm_slli_si128(k, 4));                        \
+        rk[i] = _mm_xor_si128(k, _mm_shuffle_epi32(t, 0xFF));              \
+    } while (0)
+
+    rk[0] = _mm_loadu_si128((const __m128i*)key);
+    EXPAND_ROUND(1, 0x01);
+    EXPAND_ROUND(2, 0x02);
+    EXPAND_ROUND(3, 0x04);
+    EXPAND_ROUND(4, 0x08);
+    EXPAND_ROUND(5, 0x10);
+    EXPAND_ROUND(6, 0x20);
+    EXPAND_ROUND(7, 0x40);
+    EXPAND_ROUND(8, 0x80);
+    EXPAND_ROUND(9, 0x1B);
+    EXPAND_ROUND(10, 0x36);
+#undef EXPAND_ROUND
+}
+
+/* Encrypts all lanes round by round, so that the encryptions overlap in the pipeline. */
+__attribute__((target("aes")))
+static inline void aes128_encrypt_lanes(const __m128i rk[11], __m128i x[CMAC_LANES]) {
+    for (int l = 0; l < CMAC_LANES; l++)
+        x[l] = _mm_xor_si128(x[l], rk[0]);
+    for (int r = 1; r < 10; r++)
+        for (int l = 0; l < CMAC_LANES; l++)
+            x[l] = _mm_aesenc_si128(x[l], rk[r]);
+    for (int l = 0; l < CMAC_LANES; l++)
+        x[l] = _mm_aesenclast_si128(x[l], rk[10]);
+}
+
+/* Multiplication by x in GF(2^128), used to derive the CMAC subkeys (RFC 4493) */
+static void cmac_double(const uint8_t in[16], uint8_t out[16]) {
+    uint8_t carry = in[0] >> 7;
+    for (int i = 0; i < 15; i++)
+        out[i] = (uint8_t)(in[i] << 1 | in[i + 1] >> 7);
+    out[15] = (uint8_t)(in[15] << 1) ^ (carry ? 0x87 : 0);
+}
+
+__attribute__((target("aes")))
+static void aesni_cmac128_batch(const uint8_t key[16], const uint8_t* const* inputs,
+                                const uint64_t* input_lens, uint8_t* macs, size_t count) {
+    __m128i rk[11];
+    aes128_expand_key(key, rk);
+
+    __m128i x[CMAC_LANES];
+    for (int l = 0; l < CMAC_LANES; l++)
+        x[l] = _mm_setzero_si128();
+    aes128_encrypt_lanes(rk, x);
+    uint8_t k1[16], k2[16];
+    _mm_storeu_si128((__m128i*)k2, x[0]);
+    cmac_double(k2, k1);
+    cmac_double(k1, k2);
+
+    for (size_t i = 0; i < count; i += CMAC_LANES) {
+        size_t lanes = MIN(count - i, (size_t)CMAC_LANES);
+        uint64_t nblocks[CMAC_LANES];
+        uint8_t last[CMAC_LANES][16];
+        uint64_t max_blocks = 0;
+
+        for (size_t l = 0; l < lanes; l++) {
+            uint64_t len = input_lens[i + l];
+            uint64_t n = len ? (len + 15) / 16 : 1;
+            uint64_t rem = len - (n - 1) * 16;
+            const uint8_t* tail = inputs[i + l] + (n - 1) * 16;
+
+            /* the last block is XORed with K1 if it is complete, padded and XORed with K2 if not */
+            for (uint64_t j = 0; j < 16; j++) {
+                if (rem == 16)
+                    last[l][j] = tail[j] ^ k1[j];
+                else
+                    last[l][j] = (j < rem ? tail[j] : j == rem ? 0x80 : 0) ^ k2[j];
+            }
+
+            nblocks[l] = n;
+            max_blocks = MAX(max_blocks, n);
+            x[l] = _mm_setzero_si128();
+        }
+
+        for (uint64_t b = 0; b < max_blocks; b++) {
+            for (size_t l = 0; l < lanes; l++) {
+                if (b >= nblocks[l])
+                    continue;
+                const uint8_t* block = b == nblocks[l] - 1 ? last[l] : inputs[i + l] + b * 16;
+                x[l] = _mm_xor_si128(x[l], _mm_loadu_si128((const __m128i*)block));
+            }
+
+            aes128_encrypt_lanes(rk, x);
+
+            for (size_t l = 0; l < lanes; l++)
+                if (b == nblocks[l] - 1)
+                    _mm_storeu_si128((__m128i*)(macs + (i + l) * 16), x[l]);
+        }
+    }
+
+    /* do not leave key material on the stack */
+    erase_memory(rk, sizeof(rk));
+    erase_memory(k1, sizeof(k1));
+    erase_memory(k2, sizeof(k2));
+}
+
+#endif /* __x86_64__ */
+
+int mbedtls_internal_sha256_process(mbedtls_sha256_context* ctx, const unsigned char data[64]) {
+#ifdef __x86_64__
+    if (cpu_features() & CPU_FEATURE_SHA) {
+        sha256_process_shani(ctx->state, data);
+        return 0;
+    }
+#endif
+    sha256_process_generic(ctx->state, data);
+    return 0;
+}
+
+int accel_aes128_cmac_batch(const uint8_t* key, const uint8_t* const* inputs,
+                            const uint64_t* input_lens, uint8_t* macs, size_t count) {
+#ifdef __x86_64__
+    if (cpu_features() & CPU_FEATURE_AESNI) {
+        aesni_cmac128_batch(key, inputs, input_lens, macs, count);
+        return 0;
+    }
+#else
+    __UNUSED(key);
+    __UNUSED(inputs);
+    __UNUSED(input_lens);
+    __UNUSED(macs);
+    __UNUSED(count);
+#endif
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
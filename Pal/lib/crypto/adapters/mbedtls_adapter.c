@@ -17,6 +17,7 @@
 #include "mbedtls/cmac.h"
 #include "mbedtls/entropy_poll.h"
 #include "mbedtls/error.h"
+#include "mbedtls/gcm.h"
 #include "mbedtls/net_sockets.h"
 #include "mbedtls/rsa.h"
 #include "mbedtls/sha256.h"
@@ -41,6 +42,7 @@ int mbedtls_to_pal_error(int error)
 
         case MBEDTLS_ERR_CIPHER_BAD_INPUT_DATA:
         case MBEDTLS_ERR_DHM_BAD_INPUT_DATA:
+        case MBEDTLS_ERR_GCM_BAD_INPUT:
         case MBEDTLS_ERR_MD_BAD_INPUT_DATA:
         case MBEDTLS_ERR_MPI_BAD_INPUT_DATA:
         case MBEDTLS_ERR_RSA_BAD_INPUT_DATA:
@@ -63,6 +65,7 @@ int mbedtls_to_pal_error(int error)
             return -PAL_ERROR_CRYPTO_INVALID_PADDING;
 
         case MBEDTLS_ERR_CIPHER_AUTH_FAILED:
+        case MBEDTLS_ERR_GCM_AUTH_FAILED:
             return -PAL_ERROR_CRYPTO_AUTH_FAILED;
 
         case MBEDTLS_ERR_CIPHER_INVALID_CONTEXT:
@@ -182,6 +185,19 @@ int lib_AESCMAC(const uint8_t *key, uint64_t key_len, const uint8_t *input,
     return mbedtls_to_pal_error(ret);
 }
 
+int lib_AESCMACBatch(const uint8_t* key, uint64_t key_len, const uint8_t* const* inputs,
+                     const uint64_t* input_lens, uint8_t* macs, size_t count) {
+    if (key_len == 16 && accel_aes128_cmac_batch(key, inputs, input_lens, macs, count) == 0)
+        return 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int ret = lib_AESCMAC(key, key_len, inputs[i], input_lens[i], macs + i * 16, 16);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
 int lib_AESCMACInit(LIB_AESCMAC_CONTEXT * context,
                     const uint8_t *key, uint64_t key_len)
 {
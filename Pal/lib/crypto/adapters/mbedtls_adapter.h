@@ -1,6 +1,14 @@
 #ifndef MBEDTLS_ADAPTER_H
 #define MBEDTLS_ADAPTER_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 int mbedtls_to_pal_error(int error);
 
+/* AES-128-CMAC of `count` messages with hardware acceleration (mbedtls_accel.c); returns
+ * -PAL_ERROR_NOTIMPLEMENTED if the CPU does not support it */
+int accel_aes128_cmac_batch(const uint8_t* key, const uint8_t* const* inputs,
+                            const uint64_t* input_lens, uint8_t* macs, size_t count);
+
 #endif
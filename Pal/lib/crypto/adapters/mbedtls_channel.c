@@ -0,0 +1,420 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Lightweight secure channel over a byte stream, a cheaper alternative to TLS for streams whose
+ * both ends already share a session key.
+ *
+ * The data is sent in records of up to SECURE_CHANNEL_MAX_RECORD bytes:
+ *
+ *     | length (4 bytes, little-endian) | ciphertext (length bytes) | GCM tag (16 bytes) |
+ *
+ * Every record is encrypted with AES-128-GCM, with the length as additional authenticated data.
+ *
+ * The session key is the same for many streams (on SGX, for all streams of an application), so it
+ * is never used directly. At lib_SecureChannelInit() both ends send a fresh random salt and receive
+ * the salt of the peer. Each direction gets its own key and nonce prefix, derived from the session
+ * key and both salts with the NIST SP 800-108 counter mode KDF (AES-CMAC as the PRF). Thus every
+ * stream uses new keys, and records of one stream are rejected by any other stream. The nonce is
+ * the direction's prefix followed by its record sequence number, so replayed, reordered or dropped
+ * records fail authentication.
+ *
+ * Records that fit into the reader's buffer are received and decrypted in place in that buffer;
+ * only the rest of a record that did not fit is kept in the channel.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+
+#include "api.h"
+#include "assert.h"
+#include "mbedtls_adapter.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/platform_util.h"
+#include "pal.h"
+#include "pal_crypto.h"
+#include "pal_error.h"
+
+#define RECORD_HEADER_SIZE 4
+#define RECORD_TAG_SIZE    16
+#define RECORD_NONCE_SIZE  12
+#define SALT_SIZE          16
+
+static_assert(SECURE_CHANNEL_NONCE_PREFIX_SIZE + sizeof(uint64_t) == RECORD_NONCE_SIZE,
+              "nonce is the prefix and the sequence number");
+
+/* This is declared in pal_internal.h, but that can't be included here. */
+size_t _DkRandomBitsRead(void* buffer, size_t size);
+
+/* serialized by lib_SecureChannelSave(), followed by the unread plaintext */
+struct channel_state {
+    uint8_t send_key[SECURE_CHANNEL_KEY_SIZE];
+    uint8_t recv_key[SECURE_CHANNEL_KEY_SIZE];
+    uint8_t send_nonce_prefix[SECURE_CHANNEL_NONCE_PREFIX_SIZE];
+    uint8_t recv_nonce_prefix[SECURE_CHANNEL_NONCE_PREFIX_SIZE];
+    uint64_t send_seq;
+    uint64_t recv_seq;
+    uint64_t unread;
+};
+
+static int unix_to_pal_error(ssize_t ret) {
+    switch (ret) {
+        case -EAGAIN:
+        case -EINTR:
+            return -PAL_ERROR_TRYAGAIN;
+        case -EPIPE:
+        case -ECONNRESET:
+            return -PAL_ERROR_CONNFAILED_PIPE;
+        default:
+            return -PAL_ERROR_DENIED;
+    }
+}
+
+/* Receives exactly `len` bytes. At the start of a record (`may_stop`), end of stream returns 0 and
+ * a would-block error is returned to the caller; in the middle of a record, it waits for the rest
+ * of the record. Returns 1 on success. */
+static int recv_exact(LIB_SECURE_CHANNEL* ch, uint8_t* buf, size_t len, bool may_stop) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t ret = ch->pal_recv_cb(ch->stream_fd, buf + done, MIN(len - done, (size_t)INT_MAX));
+        if (ret == -EINTR || ret == -EAGAIN) {
+            if (may_stop && !done)
+                return -PAL_ERROR_TRYAGAIN;
+            continue;
+        }
+        if (ret < 0)
+            return unix_to_pal_error(ret);
+        if (ret == 0)
+            return may_stop && !done ? 0 : -PAL_ERROR_CONNFAILED_PIPE;
+        done += ret;
+    }
+    return 1;
+}
+
+/* Sends exactly `len` bytes. Like recv_exact(), a would-block error is only returned if nothing
+ * of the record was sent yet. */
+static int send_exact(LIB_SECURE_CHANNEL* ch, const uint8_t* buf, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        ssize_t ret = ch->pal_send_cb(ch->stream_fd, buf + done, MIN(len - done, (size_t)INT_MAX));
+        if (ret == -EINTR || ret == -EAGAIN) {
+            if (!done)
+                return -PAL_ERROR_TRYAGAIN;
+            continue;
+        }
+        if (ret < 0)
+            return unix_to_pal_error(ret);
+        if (ret == 0)
+            return -PAL_ERROR_CONNFAILED_PIPE;
+        done += ret;
+    }
+    return 0;
+}
+
+/* Derives `out_size` (at most 16) bytes for `label` from the session key and the salts of both
+ * ends (`context`). */
+static int derive(const uint8_t* psk, size_t psk_size, const char* label,
+                  const uint8_t context[2 * SALT_SIZE], uint8_t* out, size_t out_size) {
+    /* counter (1) || label || 0x00 || context || output length in bits (big-endian) */
+    uint8_t input[1 + 32 + 1 + 2 * SALT_SIZE + 2];
+    uint8_t block[16];
+    size_t label_len = strlen(label);
+    assert(label_len <= 32);
+    assert(out_size <= sizeof(block));
+
+    uint8_t* ptr = input;
+    *ptr++ = 1;
+    memcpy(ptr, label, label_len);
+    ptr += label_len;
+    *ptr++ = 0;
+    memcpy(ptr, context, 2 * SALT_SIZE);
+    ptr += 2 * SALT_SIZE;
+    *ptr++ = (out_size * 8) >> 8;
+    *ptr++ = (out_size * 8) & 0xff;
+
+    int ret = lib_AESCMAC(psk, psk_size, input, ptr - input, block, sizeof(block));
+    if (ret == 0)
+        memcpy(out, block, out_size);
+    mbedtls_platform_zeroize(block, sizeof(block));
+    return ret;
+}
+
+/* Exchanges salts with the peer and derives the keys and nonce prefixes of both directions. Both
+ * ends send first, so this does not depend on which end is initialized first. */
+static int handshake(LIB_SECURE_CHANNEL* ch, bool is_server, const uint8_t* psk, size_t psk_size) {
+    /* client salt || server salt */
+    uint8_t context[2 * SALT_SIZE];
+    uint8_t* own_salt  = is_server ? context + SALT_SIZE : context;
+    uint8_t* peer_salt = is_server ? context : context + SALT_SIZE;
+
+    int ret = (int)_DkRandomBitsRead(own_salt, SALT_SIZE);
+    if (ret < 0)
+        return ret;
+
+    do {
+        ret = send_exact(ch, own_salt, SALT_SIZE);
+    } while (ret == -PAL_ERROR_TRYAGAIN);
+    if (ret < 0)
+        return ret;
+
+    ret = recv_exact(ch, peer_salt, SALT_SIZE, /*may_stop=*/false);
+    if (ret < 0)
+        return ret;
+
+    const char* send_dir = is_server ? "server to client" : "client to server";
+    const char* recv_dir = is_server ? "client to server" : "server to client";
+    char label[32];
+    snprintf(label, sizeof(label), "%s key", send_dir);
+    ret = derive(psk, psk_size, label, context, ch->send_key, sizeof(ch->send_key));
+    if (ret < 0)
+        return ret;
+    snprintf(label, sizeof(label), "%s key", recv_dir);
+    ret = derive(psk, psk_size, label, context, ch->recv_key, sizeof(ch->recv_key));
+    if (ret < 0)
+        return ret;
+    snprintf(label, sizeof(label), "%s nonce", send_dir);
+    ret = derive(psk, psk_size, label, context, ch->send_nonce_prefix,
+                 sizeof(ch->send_nonce_prefix));
+    if (ret < 0)
+        return ret;
+    snprintf(label, sizeof(label), "%s nonce", recv_dir);
+    return derive(psk, psk_size, label, context, ch->recv_nonce_prefix,
+                  sizeof(ch->recv_nonce_prefix));
+}
+
+static int set_keys(LIB_SECURE_CHANNEL* ch) {
+    int ret = mbedtls_gcm_setkey(&ch->send_gcm, MBEDTLS_CIPHER_ID_AES, ch->send_key,
+                                 SECURE_CHANNEL_KEY_SIZE * 8);
+    if (ret != 0)
+        return mbedtls_to_pal_error(ret);
+
+    ret = mbedtls_gcm_setkey(&ch->recv_gcm, MBEDTLS_CIPHER_ID_AES, ch->recv_key,
+                             SECURE_CHANNEL_KEY_SIZE * 8);
+    return mbedtls_to_pal_error(ret);
+}
+
+static int load_state(LIB_SECURE_CHANNEL* ch, const uint8_t* buf, size_t buf_size) {
+    struct channel_state state;
+    if (buf_size < sizeof(state))
+        return -PAL_ERROR_INVAL;
+
+    memcpy(&state, buf, sizeof(state));
+    if (state.unread != buf_size - sizeof(state) || state.unread > SECURE_CHANNEL_MAX_RECORD) {
+        mbedtls_platform_zeroize(&state, sizeof(state));
+        return -PAL_ERROR_INVAL;
+    }
+
+    memcpy(ch->send_key, state.send_key, sizeof(ch->send_key));
+    memcpy(ch->recv_key, state.recv_key, sizeof(ch->recv_key));
+    memcpy(ch->send_nonce_prefix, state.send_nonce_prefix, sizeof(ch->send_nonce_prefix));
+    memcpy(ch->recv_nonce_prefix, state.recv_nonce_prefix, sizeof(ch->recv_nonce_prefix));
+    ch->send_seq = state.send_seq;
+    ch->recv_seq = state.recv_seq;
+
+    if (state.unread) {
+        ch->recv_buf = malloc(state.unread);
+        if (!ch->recv_buf)
+            return -PAL_ERROR_NOMEM;
+        ch->recv_buf_size = state.unread;
+        memcpy(ch->recv_buf, buf + sizeof(state), state.unread);
+        ch->recv_len = state.unread;
+    }
+
+    mbedtls_platform_zeroize(&state, sizeof(state));
+    return 0;
+}
+
+int lib_SecureChannelInit(LIB_SECURE_CHANNEL* ch, int stream_fd, bool is_server,
+                          const uint8_t* psk, size_t psk_size,
+                          ssize_t (*pal_recv_cb)(int fd, void* buf, size_t len),
+                          ssize_t (*pal_send_cb)(int fd, const void* buf, size_t len),
+                          const uint8_t* buf_load_ctx, size_t buf_size) {
+    int ret;
+
+    memset(ch, 0, sizeof(*ch));
+    mbedtls_gcm_init(&ch->send_gcm);
+    mbedtls_gcm_init(&ch->recv_gcm);
+
+    ch->pal_recv_cb = pal_recv_cb;
+    ch->pal_send_cb = pal_send_cb;
+    ch->stream_fd   = stream_fd;
+
+    if (buf_load_ctx && buf_size) {
+        /* channel was serialized, must be restored from the supplied buffer */
+        ret = load_state(ch, buf_load_ctx, buf_size);
+    } else {
+        ret = handshake(ch, is_server, psk, psk_size);
+    }
+    if (ret == 0)
+        ret = set_keys(ch);
+
+    if (ret != 0)
+        lib_SecureChannelFree(ch);
+    return ret;
+}
+
+int lib_SecureChannelFree(LIB_SECURE_CHANNEL* ch) {
+    mbedtls_gcm_free(&ch->send_gcm);
+    mbedtls_gcm_free(&ch->recv_gcm);
+    if (ch->recv_buf) {
+        mbedtls_platform_zeroize(ch->recv_buf, ch->recv_buf_size);
+        free(ch->recv_buf);
+    }
+    free(ch->send_buf);
+    mbedtls_platform_zeroize(ch, sizeof(*ch));
+    ch->stream_fd = -1;
+    return 0;
+}
+
+static void make_nonce(const uint8_t prefix[SECURE_CHANNEL_NONCE_PREFIX_SIZE], uint64_t seq,
+                       uint8_t nonce[RECORD_NONCE_SIZE]) {
+    memcpy(nonce, prefix, SECURE_CHANNEL_NONCE_PREFIX_SIZE);
+    memcpy(nonce + SECURE_CHANNEL_NONCE_PREFIX_SIZE, &seq, sizeof(seq));
+}
+
+/* Grows `*buf` to at least `size` bytes; the old contents are not kept. */
+static int reserve(uint8_t** buf, size_t* buf_size, size_t size) {
+    if (*buf_size >= size)
+        return 0;
+
+    uint8_t* new_buf = malloc(size);
+    if (!new_buf)
+        return -PAL_ERROR_NOMEM;
+    free(*buf);
+    *buf      = new_buf;
+    *buf_size = size;
+    return 0;
+}
+
+int lib_SecureChannelRead(LIB_SECURE_CHANNEL* ch, uint8_t* buf, size_t len) {
+    if (ch->stream_fd < 0)
+        return -PAL_ERROR_CONNFAILED_PIPE;
+    if (!len)
+        return 0;
+    len = MIN(len, (size_t)INT_MAX);
+
+    /* the rest of the last record comes first */
+    if (ch->recv_pos < ch->recv_len) {
+        size_t size = MIN(len, ch->recv_len - ch->recv_pos);
+        memcpy(buf, ch->recv_buf + ch->recv_pos, size);
+        ch->recv_pos += size;
+        return size;
+    }
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    int ret = recv_exact(ch, header, sizeof(header), /*may_stop=*/true);
+    if (ret <= 0)
+        return ret;
+
+    uint32_t size;
+    memcpy(&size, header, sizeof(size));
+    if (!size || size > SECURE_CHANNEL_MAX_RECORD) {
+        ret = -PAL_ERROR_DENIED;
+        goto broken;
+    }
+
+    /* decrypt in place, in the caller's buffer if the whole record fits */
+    uint8_t* data = buf;
+    if (size > len) {
+        ret = reserve(&ch->recv_buf, &ch->recv_buf_size, size);
+        if (ret < 0)
+            goto broken;
+        data = ch->recv_buf;
+    }
+
+    uint8_t tag[RECORD_TAG_SIZE];
+    ret = recv_exact(ch, data, size, /*may_stop=*/false);
+    if (ret == 1)
+        ret = recv_exact(ch, tag, sizeof(tag), /*may_stop=*/false);
+    if (ret < 0)
+        goto broken;
+
+    uint8_t nonce[RECORD_NONCE_SIZE];
+    make_nonce(ch->recv_nonce_prefix, ch->recv_seq, nonce);
+    ret = mbedtls_gcm_auth_decrypt(&ch->recv_gcm, size, nonce, sizeof(nonce), header,
+                                   sizeof(header), tag, sizeof(tag), data, data);
+    if (ret != 0) {
+        ret = mbedtls_to_pal_error(ret);
+        goto broken;
+    }
+    ch->recv_seq++;
+
+    if (data == buf)
+        return size;
+
+    memcpy(buf, data, len);
+    ch->recv_pos = len;
+    ch->recv_len = size;
+    return len;
+
+broken:
+    /* the stream is out of sync (or under attack), no further records can be trusted */
+    ch->stream_fd = -1;
+    return ret;
+}
+
+int lib_SecureChannelWrite(LIB_SECURE_CHANNEL* ch, const uint8_t* buf, size_t len) {
+    if (ch->stream_fd < 0)
+        return -PAL_ERROR_CONNFAILED_PIPE;
+    len = MIN(len, (size_t)INT_MAX);
+
+    size_t done = 0;
+    while (done < len) {
+        uint32_t size = MIN(len - done, SECURE_CHANNEL_MAX_RECORD);
+        size_t record_size = RECORD_HEADER_SIZE + size + RECORD_TAG_SIZE;
+        int ret = reserve(&ch->send_buf, &ch->send_buf_size, record_size);
+        if (ret < 0)
+            return done ? (int)done : ret;
+
+        uint8_t* header = ch->send_buf;
+        uint8_t* data   = header + RECORD_HEADER_SIZE;
+        uint8_t* tag    = data + size;
+        memcpy(header, &size, sizeof(size));
+
+        uint8_t nonce[RECORD_NONCE_SIZE];
+        make_nonce(ch->send_nonce_prefix, ch->send_seq, nonce);
+        ret = mbedtls_gcm_crypt_and_tag(&ch->send_gcm, MBEDTLS_GCM_ENCRYPT, size, nonce,
+                                        sizeof(nonce), header, RECORD_HEADER_SIZE, buf + done,
+                                        data, RECORD_TAG_SIZE, tag);
+        if (ret != 0)
+            return done ? (int)done : mbedtls_to_pal_error(ret);
+
+        ret = send_exact(ch, ch->send_buf, record_size);
+        if (ret == -PAL_ERROR_TRYAGAIN)
+            return done ? (int)done : ret;
+        if (ret < 0) {
+            /* a partially sent record cannot be completed later */
+            ch->stream_fd = -1;
+            return ret;
+        }
+
+        ch->send_seq++;
+        done += size;
+    }
+    return done;
+}
+
+int lib_SecureChannelSave(LIB_SECURE_CHANNEL* ch, uint8_t* buf, size_t len, size_t* olen) {
+    struct channel_state state;
+    size_t unread = ch->recv_len - ch->recv_pos;
+
+    *olen = sizeof(state) + unread;
+    if (len < *olen)
+        return -PAL_ERROR_NOMEM;
+    if (ch->stream_fd < 0)
+        return -PAL_ERROR_DENIED;
+
+    memcpy(state.send_key, ch->send_key, sizeof(state.send_key));
+    memcpy(state.recv_key, ch->recv_key, sizeof(state.recv_key));
+    memcpy(state.send_nonce_prefix, ch->send_nonce_prefix, sizeof(state.send_nonce_prefix));
+    memcpy(state.recv_nonce_prefix, ch->recv_nonce_prefix, sizeof(state.recv_nonce_prefix));
+    state.send_seq = ch->send_seq;
+    state.recv_seq = ch->recv_seq;
+    state.unread   = unread;
+
+    memcpy(buf, &state, sizeof(state));
+    if (unread)
+        memcpy(buf + sizeof(state), ch->recv_buf + ch->recv_pos, unread);
+    mbedtls_platform_zeroize(&state, sizeof(state));
+    return 0;
+}
@@ -5,7 +5,10 @@
  * config.c
  *
  * This file contains functions to read app config (manifest) file and create
- * a tree to lookup / access config values.
+ * a tree to lookup / access config values. Besides the tree, every entry is
+ * kept in a hash table keyed by its parent entry and its key token, so that
+ * resolving a dotted key costs one hash lookup per token instead of a walk over
+ * all siblings (manifests may contain tens of thousands of trusted files).
  */
 
 #include <api.h>
@@ -21,11 +24,93 @@ struct config {
                           of config value lengths plus one of all the
                           immediate children. */
     char* buf;
+    struct config* parent;
     LIST_TYPE(config) list;
     LISTP_TYPE(config) children;
     LIST_TYPE(config) siblings;
 };
 
+#define CONFIG_INDEX_INIT_SIZE 256
+
+/* FNV-1a hash of the key token, seeded with the parent entry */
+static size_t __hash_config(const struct config* parent, const char* key, size_t klen) {
+    uint64_t hash = 14695981039346656037ULL ^ (uintptr_t)parent;
+    for (size_t i = 0; i < klen; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash ^ (hash >> 32);
+}
+
+static struct config* __lookup_config(struct config_store* store, const struct config* parent,
+                                      const char* key, size_t klen) {
+    if (!store->index_size)
+        return NULL;
+
+    size_t mask = store->index_size - 1;
+    size_t i    = __hash_config(parent, key, klen) & mask;
+
+    /* the table is never full, so the probing always ends at an empty slot */
+    for (struct config* e; (e = store->index[i]); i = (i + 1) & mask)
+        if (e->parent == parent && e->klen == klen && !memcmp(e->key, key, klen))
+            return e;
+
+    return NULL;
+}
+
+static void __insert_index(struct config** index, size_t size, struct config* e) {
+    size_t mask = size - 1;
+    size_t i    = __hash_config(e->parent, e->key, e->klen) & mask;
+    while (index[i])
+        i = (i + 1) & mask;
+    index[i] = e;
+}
+
+static int __index_config(struct config_store* store, struct config* e) {
+    /* keep the load factor below 3/4 */
+    if ((store->index_count + 1) * 4 > store->index_size * 3) {
+        size_t size = store->index_size ? store->index_size * 2 : CONFIG_INDEX_INIT_SIZE;
+        struct config** index = store->malloc(size * sizeof(*index));
+        if (!index)
+            return -PAL_ERROR_NOMEM;
+        memset(index, 0, size * sizeof(*index));
+
+        for (size_t i = 0; i < store->index_size; i++)
+            if (store->index[i])
+                __insert_index(index, size, store->index[i]);
+
+        if (store->index)
+            store->free(store->index);
+        store->index      = index;
+        store->index_size = size;
+    }
+
+    __insert_index(store->index, store->index_size, e);
+    store->index_count++;
+    return 0;
+}
+
+static void __unindex_config(struct config_store* store, struct config* e) {
+    size_t mask = store->index_size - 1;
+    size_t i    = __hash_config(e->parent, e->key, e->klen) & mask;
+    while (store->index[i] != e)
+        i = (i + 1) & mask;
+
+    /* backward-shift deletion: move up every following entry of the probe chain whose home
+     * slot does not lie cyclically in (i, j], so that no tombstones are needed */
+    for (size_t j = (i + 1) & mask; store->index[j]; j = (j + 1) & mask) {
+        size_t k = __hash_config(store->index[j]->parent, store->index[j]->key,
+                                 store->index[j]->klen) & mask;
+        if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+            store->index[i] = store->index[j];
+            i = j;
+        }
+    }
+
+    store->index[i] = NULL;
+    store->index_count--;
+}
+
 static int __add_config(struct config_store* store, const char* key, size_t klen, const char* val,
                         size_t vlen, struct config** entry) {
     LISTP_TYPE(config)* list = &store->root;
@@ -42,20 +127,27 @@ static int __add_config(struct config_store* store, const char* key, size_t klen
             if (token[len] == '.')
                 break;
 
-        LISTP_FOR_EACH_ENTRY(e, list, siblings) {
-            if (e->klen == len && !memcmp(e->key, token, len))
-                goto next;
-        }
+        e = __lookup_config(store, parent, token, len);
+        if (e)
+            goto next;
 
         e = store->malloc(sizeof(struct config));
         if (!e)
             return -PAL_ERROR_NOMEM;
 
-        e->key  = token;
-        e->klen = len;
-        e->val  = NULL;
-        e->vlen = 0;
-        e->buf  = NULL;
+        e->key    = token;
+        e->klen   = len;
+        e->val    = NULL;
+        e->vlen   = 0;
+        e->buf    = NULL;
+        e->parent = parent;
+
+        int ret = __index_config(store, e);
+        if (ret < 0) {
+            store->free(e);
+            return ret;
+        }
+
         INIT_LIST_HEAD(e, list);
         LISTP_ADD_TAIL(e, &store->entries, list);
         INIT_LISTP(&e->children);
@@ -86,8 +178,7 @@ static int __add_config(struct config_store* store, const char* key, size_t klen
 }
 
 static struct config* __get_config(struct config_store* store, const char* key) {
-    LISTP_TYPE(config)* list = &store->root;
-    struct config* e         = NULL;
+    struct config* e = NULL;
 
     while (*key) {
         const char* token = key;
@@ -96,18 +187,13 @@ static struct config* __get_config(struct config_store* store, const char* key)
             if (token[len] == '.')
                 break;
 
-        LISTP_FOR_EACH_ENTRY(e, list, siblings) {
-            if (e->klen == len && !memcmp(e->key, token, len))
-                goto next;
-        }
-
-        return NULL;
+        e = __lookup_config(store, e, token, len);
+        if (!e)
+            return NULL;
 
-    next:
         if (token[len])
             len++;
         key += len;
-        list = &e->children;
     }
 
     return e;
@@ -161,20 +247,12 @@ ssize_t get_config_entries_size(struct config_store* store, const char* key) {
 
 static int __del_config(struct config_store* store, LISTP_TYPE(config)* root, struct config* p,
                         const char* key) {
-    struct config* e;
-    struct config* found = NULL;
     size_t len = 0;
     for (; key[len]; len++)
         if (key[len] == '.')
             break;
 
-    LISTP_FOR_EACH_ENTRY(e, root, siblings) {
-        if (e->klen == len && !memcmp(e->key, key, len)) {
-            found = e;
-            break;
-        }
-    }
-
+    struct config* found = __lookup_config(store, p, key, len);
     if (!found)
         return -PAL_ERROR_INVAL;
 
@@ -193,6 +271,7 @@ static int __del_config(struct config_store* store, LISTP_TYPE(config)* root, st
 
     if (p)
         p->vlen -= (found->klen + 1);
+    __unindex_config(store, found);
     LISTP_DEL(found, root, siblings);
     LISTP_DEL(found, &store->entries, list);
     if (found->buf)
@@ -241,6 +320,9 @@ int read_config(struct config_store* store, int (*filter)(const char* key, int k
                 const char** errstring) {
     INIT_LISTP(&store->root);
     INIT_LISTP(&store->entries);
+    store->index       = NULL;
+    store->index_size  = 0;
+    store->index_count = 0;
 
     char* ptr     = store->raw_data;
     char* ptr_end = store->raw_data + store->raw_size;
@@ -348,6 +430,9 @@ int read_config(struct config_store* store, int (*filter)(const char* key, int k
                 if (ret == -PAL_ERROR_INVAL)
                     GOTO_INVAL("key format invalid");
 
+                if (ret == -PAL_ERROR_NOMEM)
+                    GOTO_INVAL("out of memory");
+
                 GOTO_INVAL("unknown error");
             }
         }
@@ -371,21 +456,27 @@ inval:
 }
 
 int free_config(struct config_store* store) {
-    struct config* e;
-    struct config* n;
-    LISTP_FOR_EACH_ENTRY_SAFE(e, n, &store->entries, list) {
+    /* LISTP_FOR_EACH_ENTRY_SAFE would touch the last entry after freeing it */
+    while (!LISTP_EMPTY(&store->entries)) {
+        struct config* e = LISTP_FIRST_ENTRY(&store->entries, struct config, list);
+        LISTP_DEL(e, &store->entries, list);
         store->free(e->buf);
         store->free(e);
     }
+    if (store->index)
+        store->free(store->index);
 
     INIT_LISTP(&store->root);
     INIT_LISTP(&store->entries);
+    store->index       = NULL;
+    store->index_size  = 0;
+    store->index_count = 0;
     return 0;
 }
 
 static int __dup_config(const struct config_store* ss, const LISTP_TYPE(config) * sr,
-                        struct config_store* ts, LISTP_TYPE(config) * tr, void** data,
-                        size_t* size) {
+                        struct config_store* ts, struct config* tp, LISTP_TYPE(config) * tr,
+                        void** data, size_t* size) {
     struct config* e;
     struct config* new;
 
@@ -436,11 +527,21 @@ static int __dup_config(const struct config_store* ss, const LISTP_TYPE(config)
         if (!new)
             return -PAL_ERROR_NOMEM;
 
-        new->key  = key;
-        new->klen = e->klen;
-        new->val  = val;
-        new->vlen = e->vlen;
-        new->buf  = buf;
+        new->key    = key;
+        new->klen   = e->klen;
+        new->val    = val;
+        new->vlen   = e->vlen;
+        new->buf    = buf;
+        new->parent = tp;
+
+        int ret = __index_config(ts, new);
+        if (ret < 0) {
+            if (buf)
+                ts->free(buf);
+            ts->free(new);
+            return ret;
+        }
+
         INIT_LIST_HEAD(new, list);
         LISTP_ADD_TAIL(new, &ts->entries, list);
         INIT_LISTP(&new->children);
@@ -448,7 +549,7 @@ static int __dup_config(const struct config_store* ss, const LISTP_TYPE(config)
         LISTP_ADD_TAIL(new, tr, siblings);
 
         if (!LISTP_EMPTY(&e->children)) {
-            int ret = __dup_config(ss, &e->children, ts, &new->children, data, size);
+            ret = __dup_config(ss, &e->children, ts, new, &new->children, data, size);
             if (ret < 0)
                 return ret;
         }
@@ -460,6 +561,9 @@ static int __dup_config(const struct config_store* ss, const LISTP_TYPE(config)
 int copy_config(struct config_store* store, struct config_store* new_store) {
     INIT_LISTP(&new_store->root);
     INIT_LISTP(&new_store->entries);
+    new_store->index       = NULL;
+    new_store->index_size  = 0;
+    new_store->index_count = 0;
 
     struct config* e;
     size_t size = 0;
@@ -482,7 +586,7 @@ int copy_config(struct config_store* store, struct config_store* new_store) {
     new_store->raw_data = data;
     new_store->raw_size = size;
 
-    return __dup_config(store, &store->root, new_store, &new_store->root, &dataptr, &datasz);
+    return __dup_config(store, &store->root, new_store, NULL, &new_store->root, &dataptr, &datasz);
 }
 
 static int __write_config(void* f, int (*write)(void*, void*, int), struct config_store* store,
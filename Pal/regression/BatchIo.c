@@ -0,0 +1,194 @@
+#include "api.h"
+#include "pal.h"
+#include "pal_debug.h"
+
+/* more requests than the Linux PAL submits to io_uring at once */
+#define NUM_CHUNKS 100
+#define CHUNK_SIZE 128
+
+static char g_wbuf[NUM_CHUNKS][CHUNK_SIZE];
+static char g_rbuf[NUM_CHUNKS][CHUNK_SIZE];
+static PAL_IO_REQUEST g_reqs[NUM_CHUNKS + 1];
+
+/* File copy benchmark: COPY_SIZE bytes in COPY_CHUNK-byte chunks, either COPY_BATCH reads and then
+ * COPY_BATCH writes per DkStreamsBatchIo() call, or one DkStreamRead()/DkStreamWrite() per chunk
+ * (which is also what a batch does without io_uring) */
+#define COPY_SIZE  (16UL * 1024 * 1024)
+#define COPY_CHUNK (64UL * 1024)
+#define COPY_BATCH 32
+
+static PAL_IO_REQUEST g_copy_reqs[COPY_BATCH];
+
+static int copy_batched(PAL_HANDLE src, PAL_HANDLE dst, char* buf) {
+    for (size_t off = 0; off < COPY_SIZE; off += COPY_BATCH * COPY_CHUNK) {
+        for (size_t i = 0; i < COPY_BATCH; i++) {
+            g_copy_reqs[i] = (PAL_IO_REQUEST){
+                .handle = src,
+                .op     = PAL_IO_READ,
+                .offset = off + i * COPY_CHUNK,
+                .count  = COPY_CHUNK,
+                .buffer = buf + i * COPY_CHUNK,
+            };
+        }
+        if (!DkStreamsBatchIo(g_copy_reqs, COPY_BATCH))
+            return -1;
+
+        for (size_t i = 0; i < COPY_BATCH; i++) {
+            if (g_copy_reqs[i].result != COPY_CHUNK)
+                return -1;
+            g_copy_reqs[i].op = PAL_IO_WRITE;
+            g_copy_reqs[i].handle = dst;
+        }
+        if (!DkStreamsBatchIo(g_copy_reqs, COPY_BATCH))
+            return -1;
+        for (size_t i = 0; i < COPY_BATCH; i++)
+            if (g_copy_reqs[i].result != COPY_CHUNK)
+                return -1;
+    }
+    return 0;
+}
+
+static int copy_single(PAL_HANDLE src, PAL_HANDLE dst, char* buf) {
+    for (size_t off = 0; off < COPY_SIZE; off += COPY_CHUNK) {
+        if (DkStreamRead(src, off, COPY_CHUNK, buf, NULL, 0) != COPY_CHUNK ||
+                DkStreamWrite(dst, off, COPY_CHUNK, buf, NULL) != COPY_CHUNK)
+            return -1;
+    }
+    return 0;
+}
+
+static int bench_copy(void) {
+    char* buf = (char*)DkVirtualMemoryAlloc(NULL, COPY_BATCH * COPY_CHUNK, 0,
+                                            PAL_PROT_READ | PAL_PROT_WRITE);
+    PAL_HANDLE src = DkStreamOpen("file:batch_io_src.tmp", PAL_ACCESS_RDWR,
+                                  PAL_SHARE_OWNER_R | PAL_SHARE_OWNER_W, PAL_CREATE_TRY, 0);
+    PAL_HANDLE dst = DkStreamOpen("file:batch_io_dst.tmp", PAL_ACCESS_RDWR,
+                                  PAL_SHARE_OWNER_R | PAL_SHARE_OWNER_W, PAL_CREATE_TRY, 0);
+    if (!buf || !src || !dst)
+        return -1;
+
+    for (size_t off = 0; off < COPY_SIZE; off += COPY_CHUNK) {
+        memset(buf, 'a' + off / COPY_CHUNK % 26, COPY_CHUNK);
+        if (DkStreamWrite(src, off, COPY_CHUNK, buf, NULL) != COPY_CHUNK)
+            return -1;
+    }
+
+    for (int batched = 1; batched >= 0; batched--) {
+        uint64_t start = DkSystemTimeQuery();
+        if ((batched ? copy_batched : copy_single)(src, dst, buf) < 0) {
+            pal_printf("File copy failed\n");
+            return -1;
+        }
+        uint64_t usec = DkSystemTimeQuery() - start;
+        pal_printf("File copy (%s): %lu MB/s\n", batched ? "batched" : "one call per chunk",
+                   usec ? COPY_SIZE / usec : 0);
+    }
+
+    if (DkStreamRead(dst, COPY_SIZE - COPY_CHUNK, COPY_CHUNK, buf, NULL, 0) != COPY_CHUNK ||
+            buf[0] != 'a' + (COPY_SIZE / COPY_CHUNK - 1) % 26) {
+        pal_printf("File copy returned wrong data\n");
+        return -1;
+    }
+
+    DkObjectClose(src);
+    DkObjectClose(dst);
+    DkVirtualMemoryFree(buf, COPY_BATCH * COPY_CHUNK);
+    return 0;
+}
+
+int main(int argc, char** argv, char** envp) {
+    PAL_HANDLE file = DkStreamOpen("file:batch_io.tmp", PAL_ACCESS_RDWR,
+                                   PAL_SHARE_OWNER_R | PAL_SHARE_OWNER_W, PAL_CREATE_TRY, 0);
+    if (!file) {
+        pal_printf("DkStreamOpen failed\n");
+        return 1;
+    }
+
+    /* write the chunks in reverse order and flush the file in the same batch */
+    for (int i = 0; i < NUM_CHUNKS; i++) {
+        memset(g_wbuf[i], 'a' + i % 26, CHUNK_SIZE);
+        g_reqs[i] = (PAL_IO_REQUEST){
+            .handle = file,
+            .op     = PAL_IO_WRITE,
+            .offset = (NUM_CHUNKS - 1 - i) * CHUNK_SIZE,
+            .count  = CHUNK_SIZE,
+            .buffer = g_wbuf[i],
+        };
+    }
+    g_reqs[NUM_CHUNKS] = (PAL_IO_REQUEST){.handle = file, .op = PAL_IO_FLUSH};
+
+    if (!DkStreamsBatchIo(g_reqs, NUM_CHUNKS + 1)) {
+        pal_printf("DkStreamsBatchIo (write) failed\n");
+        return 1;
+    }
+    for (int i = 0; i <= NUM_CHUNKS; i++) {
+        if (g_reqs[i].result != (i < NUM_CHUNKS ? CHUNK_SIZE : 0) || g_reqs[i].error) {
+            pal_printf("Write request %d returned %ld (error %ld)\n", i, g_reqs[i].result,
+                       g_reqs[i].error);
+            return 1;
+        }
+    }
+    pal_printf("Batch Write OK\n");
+
+    /* read everything back; the last request starts at the end of the file */
+    for (int i = 0; i < NUM_CHUNKS; i++) {
+        g_reqs[i] = (PAL_IO_REQUEST){
+            .handle = file,
+            .op     = PAL_IO_READ,
+            .offset = i * CHUNK_SIZE,
+            .count  = CHUNK_SIZE,
+            .buffer = g_rbuf[i],
+        };
+    }
+    g_reqs[NUM_CHUNKS] = (PAL_IO_REQUEST){
+        .handle = file,
+        .op     = PAL_IO_READ,
+        .offset = NUM_CHUNKS * CHUNK_SIZE,
+        .count  = CHUNK_SIZE,
+        .buffer = g_rbuf[0],
+    };
+
+    if (!DkStreamsBatchIo(g_reqs, NUM_CHUNKS + 1)) {
+        pal_printf("DkStreamsBatchIo (read) failed\n");
+        return 1;
+    }
+    for (int i = 0; i < NUM_CHUNKS; i++) {
+        if (g_reqs[i].result != CHUNK_SIZE ||
+                memcmp(g_rbuf[i], g_wbuf[NUM_CHUNKS - 1 - i], CHUNK_SIZE)) {
+            pal_printf("Read request %d returned wrong data\n", i);
+            return 1;
+        }
+    }
+    if (g_reqs[NUM_CHUNKS].result != 0 || g_reqs[NUM_CHUNKS].error) {
+        pal_printf("Read at the end of file returned %ld\n", g_reqs[NUM_CHUNKS].result);
+        return 1;
+    }
+    pal_printf("Batch Read OK\n");
+
+    /* regular files are always ready */
+    g_reqs[0] = (PAL_IO_REQUEST){
+        .handle = file,
+        .op     = PAL_IO_POLL,
+        .count  = PAL_WAIT_READ,
+    };
+    if (!DkStreamsBatchIo(g_reqs, 1) || !(g_reqs[0].result & PAL_WAIT_READ)) {
+        pal_printf("Poll request returned %ld\n", g_reqs[0].result);
+        return 1;
+    }
+    pal_printf("Batch Poll OK\n");
+
+    /* invalid requests are rejected as a whole */
+    g_reqs[0].op = PAL_IO_POLL + 1;
+    if (DkStreamsBatchIo(g_reqs, 1)) {
+        pal_printf("Invalid request was accepted\n");
+        return 1;
+    }
+
+    DkObjectClose(file);
+
+    if (bench_copy() < 0)
+        return 1;
+
+    pal_printf("Success!\n");
+    return 0;
+}
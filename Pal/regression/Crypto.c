@@ -0,0 +1,175 @@
+#include "api.h"
+#include "pal.h"
+#include "pal_crypto.h"
+#include "pal_debug.h"
+
+#include <stdint.h>
+#include <stdnoreturn.h>
+
+noreturn void __abort(void) {
+    warn("ABORTED\n");
+    DkProcessExit(1);
+}
+
+/* Known-answer tests: FIPS 180-2 (SHA-256) and RFC 4493 (AES-CMAC) */
+
+static const char* g_sha256_msgs[] = {
+    "",
+    "abc",
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+};
+
+static const uint8_t g_sha256_digests[][SHA256_DIGEST_LEN] = {
+    {0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+     0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55},
+    {0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+     0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad},
+    {0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+     0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1},
+};
+
+static const uint8_t g_cmac_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static const uint8_t g_cmac_msg[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+
+static const uint64_t g_cmac_lens[] = {0, 16, 40, 64};
+
+static const uint8_t g_cmac_macs[][16] = {
+    {0xbb, 0x1d, 0x69, 0x29, 0xe9, 0x59, 0x37, 0x28, 0x7f, 0xa3, 0x7d, 0x12, 0x9b, 0x75, 0x67, 0x46},
+    {0x07, 0x0a, 0x16, 0xb4, 0x6b, 0x4d, 0x41, 0x44, 0xf7, 0x9b, 0xdd, 0x9d, 0xd0, 0x4a, 0x28, 0x7c},
+    {0xdf, 0xa6, 0x67, 0x47, 0xde, 0x9a, 0xe6, 0x30, 0x30, 0xca, 0x32, 0x61, 0x14, 0x97, 0xc8, 0x27},
+    {0x51, 0xf0, 0xbe, 0xbf, 0x7e, 0x3b, 0x9d, 0x92, 0xfc, 0x49, 0x74, 0x17, 0x79, 0x36, 0x3c, 0xfe},
+};
+
+#define CMAC_TESTS (sizeof(g_cmac_lens) / sizeof(g_cmac_lens[0]))
+
+static int test_sha256(void) {
+    for (size_t i = 0; i < sizeof(g_sha256_msgs) / sizeof(g_sha256_msgs[0]); i++) {
+        LIB_SHA256_CONTEXT sha;
+        uint8_t digest[SHA256_DIGEST_LEN];
+        if (lib_SHA256Init(&sha) < 0 ||
+                lib_SHA256Update(&sha, (const uint8_t*)g_sha256_msgs[i],
+                                 strlen(g_sha256_msgs[i])) < 0 ||
+                lib_SHA256Final(&sha, digest) < 0 ||
+                memcmp(digest, g_sha256_digests[i], sizeof(digest))) {
+            pal_printf("SHA-256 test %lu failed\n", i);
+            return -1;
+        }
+    }
+    pal_printf("SHA-256 KAT OK\n");
+    return 0;
+}
+
+static int test_cmac(void) {
+    uint8_t mac[16];
+    for (size_t i = 0; i < CMAC_TESTS; i++) {
+        if (lib_AESCMAC(g_cmac_key, sizeof(g_cmac_key), g_cmac_msg, g_cmac_lens[i], mac,
+                        sizeof(mac)) < 0 || memcmp(mac, g_cmac_macs[i], sizeof(mac))) {
+            pal_printf("AES-CMAC test %lu failed\n", i);
+            return -1;
+        }
+    }
+    pal_printf("AES-CMAC KAT OK\n");
+
+    /* more messages than the batch processes at once, with different lengths */
+    const uint8_t* inputs[3 * CMAC_TESTS];
+    uint64_t input_lens[3 * CMAC_TESTS];
+    uint8_t macs[3 * CMAC_TESTS][16];
+    for (size_t i = 0; i < 3 * CMAC_TESTS; i++) {
+        inputs[i]     = g_cmac_msg;
+        input_lens[i] = g_cmac_lens[(i * 3) % CMAC_TESTS];
+    }
+    if (lib_AESCMACBatch(g_cmac_key, sizeof(g_cmac_key), inputs, input_lens, &macs[0][0],
+                         3 * CMAC_TESTS) < 0) {
+        pal_printf("AES-CMAC batch failed\n");
+        return -1;
+    }
+    for (size_t i = 0; i < 3 * CMAC_TESTS; i++) {
+        if (memcmp(macs[i], g_cmac_macs[(i * 3) % CMAC_TESTS], sizeof(macs[i]))) {
+            pal_printf("AES-CMAC batch test %lu failed\n", i);
+            return -1;
+        }
+    }
+    pal_printf("AES-CMAC batch KAT OK\n");
+    return 0;
+}
+
+/* Throughput on the trusted-files workload: SHA-256 of the whole file and AES-CMAC of each
+ * 16KB chunk */
+
+#define BENCH_SIZE  (16UL * 1024 * 1024)
+#define BENCH_CHUNK (16UL * 1024)
+#define BENCH_BATCH 8
+
+static void print_speed(const char* name, uint64_t start) {
+    uint64_t usec = DkSystemTimeQuery() - start;
+    pal_printf("%s: %lu MB/s\n", name, usec ? BENCH_SIZE / usec : 0);
+}
+
+static int bench(void) {
+    uint8_t* buf = (uint8_t*)DkVirtualMemoryAlloc(NULL, BENCH_SIZE, 0,
+                                                  PAL_PROT_READ | PAL_PROT_WRITE);
+    if (!buf) {
+        pal_printf("DkVirtualMemoryAlloc failed\n");
+        return -1;
+    }
+    for (size_t i = 0; i < BENCH_SIZE; i++)
+        buf[i] = (uint8_t)(i * 31);
+
+    int ret = -1;
+    uint64_t start = DkSystemTimeQuery();
+    LIB_SHA256_CONTEXT sha;
+    uint8_t digest[SHA256_DIGEST_LEN];
+    if (lib_SHA256Init(&sha) < 0 || lib_SHA256Update(&sha, buf, BENCH_SIZE) < 0 ||
+            lib_SHA256Final(&sha, digest) < 0)
+        goto out;
+    print_speed("SHA-256", start);
+
+    uint8_t mac[16];
+    start = DkSystemTimeQuery();
+    for (size_t off = 0; off < BENCH_SIZE; off += BENCH_CHUNK)
+        if (lib_AESCMAC(g_cmac_key, sizeof(g_cmac_key), buf + off, BENCH_CHUNK, mac,
+                        sizeof(mac)) < 0)
+            goto out;
+    print_speed("AES-CMAC", start);
+
+    const uint8_t* inputs[BENCH_BATCH];
+    uint64_t input_lens[BENCH_BATCH];
+    uint8_t macs[BENCH_BATCH][16];
+    start = DkSystemTimeQuery();
+    for (size_t off = 0; off < BENCH_SIZE; off += BENCH_BATCH * BENCH_CHUNK) {
+        for (size_t i = 0; i < BENCH_BATCH; i++) {
+            inputs[i]     = buf + off + i * BENCH_CHUNK;
+            input_lens[i] = BENCH_CHUNK;
+        }
+        if (lib_AESCMACBatch(g_cmac_key, sizeof(g_cmac_key), inputs, input_lens, &macs[0][0],
+                             BENCH_BATCH) < 0)
+            goto out;
+    }
+    print_speed("AES-CMAC batch", start);
+
+    /* both loops end with the MAC of the last chunk */
+    if (memcmp(mac, macs[BENCH_BATCH - 1], sizeof(mac))) {
+        pal_printf("AES-CMAC batch result differs\n");
+        goto out;
+    }
+    ret = 0;
+out:
+    DkVirtualMemoryFree(buf, BENCH_SIZE);
+    return ret;
+}
+
+int main(void) {
+    if (test_sha256() < 0 || test_cmac() < 0 || bench() < 0)
+        return 1;
+
+    pal_printf("Success!\n");
+    return 0;
+}
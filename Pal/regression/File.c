@@ -154,6 +154,29 @@ int main(int argc, char** argv, char** envp) {
         /* test file truncate */
         DkStreamSetLength(file4, pal_control.alloc_align);
 
+        /* test storage hints; the host may not be able to reserve storage, but the length must
+         * stay the same either way */
+        DkStreamAllocate(file4, 0, pal_control.alloc_align * 2, PAL_FALLOC_KEEP_SIZE);
+        if (DkStreamAdvise(file4, 0, 0, PAL_FADVISE_SEQUENTIAL) &&
+                DkStreamFlushRange(file4, 0, 0, PAL_FLUSH_RANGE_WRITE | PAL_FLUSH_RANGE_WAIT_AFTER))
+            pal_printf("File Storage Hints OK\n");
+
+        /* test advisory locks: range locks of another handle conflict */
+        PAL_HANDLE file8 = DkStreamOpen("file:file_nonexist.tmp", PAL_ACCESS_RDWR, 0, 0, 0);
+        if (file8) {
+            PAL_FLG type = PAL_LOCK_SHARED;
+            PAL_NUM offset = 0, length = 0;
+            if (DkStreamLock(file4, PAL_LOCK_EXCLUSIVE, 0, 100, 0) &&
+                    !DkStreamLock(file8, PAL_LOCK_SHARED, 50, 0, 0) &&
+                    DkStreamLockQuery(file8, &type, &offset, &length) &&
+                    type == PAL_LOCK_EXCLUSIVE && offset == 0 && length == 100 &&
+                    DkStreamLock(file4, PAL_LOCK_UNLOCK, 0, 0, 0) &&
+                    DkStreamLock(file8, PAL_LOCK_SHARED, 50, 0, 0) &&
+                    DkStreamLock(file4, PAL_LOCK_EXCLUSIVE, 0, 0, PAL_LOCK_WHOLE))
+                pal_printf("File Lock OK\n");
+            DkObjectClose(file8);
+        }
+
     fail_writing:
         DkObjectClose(file4);
     }
@@ -1,6 +1,7 @@
 #include "api.h"
 #include "pal.h"
 #include "pal_debug.h"
+#include "pal_error.h"
 
 #define UNIT (pal_control.alloc_align)
 
@@ -21,9 +22,17 @@ static void handler(PAL_PTR event, PAL_NUM arg, PAL_CONTEXT* context) {
     DkExceptionReturn(event);
 }
 
+static volatile PAL_NUM last_error = 0;
+
+static void failure_handler(PAL_PTR event, PAL_NUM arg, PAL_CONTEXT* context) {
+    last_error = arg;
+    DkExceptionReturn(event);
+}
+
 int main(int argc, char** argv, char** envp) {
     volatile int c;
     DkSetExceptionHandler(handler, PAL_EVENT_MEMFAULT);
+    DkSetExceptionHandler(failure_handler, PAL_EVENT_FAILURE);
 
     void* mem1 = (void*)DkVirtualMemoryAlloc(NULL, UNIT * 4, 0, PAL_PROT_READ | PAL_PROT_WRITE);
 
@@ -54,6 +63,40 @@ int main(int argc, char** argv, char** envp) {
             pal_printf("Memory Deallocation OK\n");
     }
 
+    void* mem5 = (void*)DkVirtualMemoryAlloc(NULL, UNIT * 2, 0, PAL_PROT_READ | PAL_PROT_WRITE);
+    void* mem6 = (void*)DkVirtualMemoryAlloc(NULL, UNIT * 2, 0, PAL_PROT_READ | PAL_PROT_WRITE);
+
+    if (mem5 && mem6) {
+        *(volatile int*)mem5          = 1;
+        *(volatile int*)(mem5 + UNIT) = 2;
+        if (DkVirtualMemoryMove(mem5, mem6, UNIT * 2) && *(volatile int*)mem6 == 1 &&
+                *(volatile int*)(mem6 + UNIT) == 2)
+            pal_printf("Memory Move OK\n");
+    }
+
+    void* mem7 = (void*)DkVirtualMemoryAlloc(NULL, UNIT, 0, PAL_PROT_READ | PAL_PROT_WRITE);
+
+    if (mem7) {
+        *(volatile int*)mem7 = 1;
+        if (DkVirtualMemoryAdvise(mem7, UNIT, PAL_MADVISE_DONTNEED) && *(volatile int*)mem7 == 0)
+            pal_printf("Memory Advise OK\n");
+    }
+
+    void* mem8 = (void*)DkVirtualMemoryAlloc(NULL, UNIT, 0, PAL_PROT_READ | PAL_PROT_WRITE);
+
+    if (mem8) {
+        last_error = 0;
+        if (DkVirtualMemoryPolicy(mem8, UNIT, PAL_MPOL_BIND, /*nodemask=*/1, /*flags=*/0)) {
+            *(volatile int*)mem8 = 1;
+            PAL_IDX node = PAL_IDX_POISON;
+            if (DkVirtualMemoryNodes(1, &mem8, NULL, &node) && node == 0)
+                pal_printf("Memory Policy OK\n");
+        } else if (last_error == PAL_ERROR_NOTIMPLEMENTED) {
+            /* e.g. mbind() is forbidden by a seccomp filter of the container */
+            pal_printf("Memory Policy not supported\n");
+        }
+    }
+
     void* mem3 = (void*)pal_control.user_address.start;
     void* mem4 = (void*)pal_control.user_address.end - UNIT;
 
@@ -0,0 +1,381 @@
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdnoreturn.h>
+
+#include "api.h"
+#include "pal.h"
+#include "pal_crypto.h"
+#include "pal_debug.h"
+#include "pal_error.h"
+
+noreturn void __abort(void) {
+    warn("ABORTED\n");
+    DkProcessExit(1);
+}
+
+/* "fds" for the channel callbacks: the two ends of a PAL pipe, and the two ends of an in-memory
+ * stream (for tampering with the records) */
+#define PIPE_SRV_FD 0
+#define PIPE_CLI_FD 1
+#define MEM_SRV_FD  2
+#define MEM_CLI_FD  3
+
+#define MEM_SIZE (4 * 1024 * 1024)
+
+static PAL_HANDLE g_pipe[2];
+static uint8_t* g_mem;
+
+/* one queue per direction of the in-memory stream: [0] is server to client, [1] the other way */
+struct mem_queue {
+    uint8_t* buf;
+    size_t rpos;
+    atomic_size_t wpos;
+};
+static struct mem_queue g_queue[2];
+
+static void reset_queues(void) {
+    for (size_t i = 0; i < 2; i++)
+        g_queue[i].rpos = g_queue[i].wpos = 0;
+}
+
+static const uint8_t g_psk[32] = "0123456789abcdef0123456789abcdef";
+
+static ssize_t recv_cb(int fd, void* buf, size_t len) {
+    if (fd == MEM_SRV_FD || fd == MEM_CLI_FD) {
+        struct mem_queue* queue = &g_queue[fd == MEM_SRV_FD ? 1 : 0];
+        len = MIN(len, queue->wpos - queue->rpos);
+        if (!len)
+            return -EAGAIN;
+        memcpy(buf, queue->buf + queue->rpos, len);
+        queue->rpos += len;
+        return len;
+    }
+    PAL_NUM ret = DkStreamRead(g_pipe[fd], 0, len, buf, NULL, 0);
+    return ret == PAL_STREAM_ERROR ? -EPIPE : (ssize_t)ret;
+}
+
+static ssize_t send_cb(int fd, const void* buf, size_t len) {
+    if (fd == MEM_SRV_FD || fd == MEM_CLI_FD) {
+        struct mem_queue* queue = &g_queue[fd == MEM_SRV_FD ? 0 : 1];
+        if (len > MEM_SIZE - queue->wpos)
+            return -ENOSPC;
+        memcpy(queue->buf + queue->wpos, buf, len);
+        queue->wpos += len;
+        return len;
+    }
+    PAL_NUM ret = DkStreamWrite(g_pipe[fd], 0, len, (void*)buf, NULL);
+    return ret == PAL_STREAM_ERROR ? -EPIPE : (ssize_t)ret;
+}
+
+static void fill(uint8_t* buf, size_t len, size_t seed) {
+    for (size_t i = 0; i < len; i++)
+        buf[i] = (uint8_t)(i * 7 + seed);
+}
+
+static bool check(const uint8_t* buf, size_t len, size_t seed) {
+    for (size_t i = 0; i < len; i++)
+        if (buf[i] != (uint8_t)(i * 7 + seed))
+            return false;
+    return true;
+}
+
+/* Both ends exchange salts in lib_SecureChannelInit(), so the server end is initialized in
+ * another thread */
+static LIB_SECURE_CHANNEL* g_init_srv;
+static int g_init_srv_fd;
+static atomic_int g_init_ret;
+
+static void init_server(void* arg) {
+    __UNUSED(arg);
+    int ret = lib_SecureChannelInit(g_init_srv, g_init_srv_fd, /*is_server=*/true, g_psk,
+                                    sizeof(g_psk), recv_cb, send_cb, NULL, 0);
+    g_init_ret = ret == 0 ? 1 : ret;
+    DkThreadExit(/*clear_child_tid=*/NULL);
+    /* UNREACHABLE */
+}
+
+static int init_pair(LIB_SECURE_CHANNEL* srv, LIB_SECURE_CHANNEL* cli, int srv_fd, int cli_fd) {
+    g_init_srv    = srv;
+    g_init_srv_fd = srv_fd;
+    g_init_ret    = 0;
+    if (!DkThreadCreate(init_server, NULL))
+        return -1;
+
+    int ret = lib_SecureChannelInit(cli, cli_fd, /*is_server=*/false, g_psk, sizeof(g_psk),
+                                    recv_cb, send_cb, NULL, 0);
+    while (!g_init_ret)
+        DkThreadYieldExecution();
+    if (ret < 0 || g_init_ret < 0) {
+        pal_printf("Secure channel init failed: %d, %d\n", ret, (int)g_init_ret);
+        return -1;
+    }
+    return 0;
+}
+
+/* Reads exactly `len` bytes with reads of at most `chunk` bytes */
+static int read_all(LIB_SECURE_CHANNEL* ch, uint8_t* buf, size_t len, size_t chunk) {
+    size_t done = 0;
+    while (done < len) {
+        int ret = lib_SecureChannelRead(ch, buf + done, MIN(len - done, chunk));
+        if (ret <= 0)
+            return ret < 0 ? ret : -PAL_ERROR_CONNFAILED_PIPE;
+        done += ret;
+    }
+    return 0;
+}
+
+static int test_loopback(void) {
+    static const size_t sizes[] = {1, 100, SECURE_CHANNEL_MAX_RECORD, SECURE_CHANNEL_MAX_RECORD + 1,
+                                   1024 * 1024};
+    static const size_t chunks[] = {SIZE_MAX, 1000, 17};
+    LIB_SECURE_CHANNEL srv, cli;
+    uint8_t* buf = g_mem;
+
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        if (init_pair(&srv, &cli, MEM_SRV_FD, MEM_CLI_FD) < 0)
+            return -1;
+        for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+            reset_queues();
+            fill(buf, sizes[i], i);
+            if (lib_SecureChannelWrite(&srv, buf, sizes[i]) != (int)sizes[i])
+                return -1;
+            memset(buf, 0, sizes[i]);
+            if (read_all(&cli, buf, sizes[i], chunks[c]) < 0 || !check(buf, sizes[i], i)) {
+                pal_printf("Loopback of %lu bytes in %lu-byte reads failed\n", sizes[i],
+                           chunks[c]);
+                return -1;
+            }
+        }
+        lib_SecureChannelFree(&srv);
+        lib_SecureChannelFree(&cli);
+    }
+    pal_printf("Secure channel loopback OK\n");
+    return 0;
+}
+
+static int test_tampering(void) {
+    LIB_SECURE_CHANNEL srv, cli;
+    uint8_t buf[256];
+    uint8_t record[sizeof(buf) + 32];
+    size_t record_size;
+
+    /* a modified record */
+    if (init_pair(&srv, &cli, MEM_SRV_FD, MEM_CLI_FD) < 0)
+        return -1;
+    reset_queues();
+    fill(buf, sizeof(buf), 0);
+    if (lib_SecureChannelWrite(&srv, buf, sizeof(buf)) != sizeof(buf))
+        return -1;
+    g_queue[0].buf[10] ^= 1;
+    if (lib_SecureChannelRead(&cli, buf, sizeof(buf)) != -PAL_ERROR_CRYPTO_AUTH_FAILED) {
+        pal_printf("Modified record was accepted\n");
+        return -1;
+    }
+    /* the channel stays unusable afterwards */
+    if (lib_SecureChannelRead(&cli, buf, sizeof(buf)) >= 0)
+        return -1;
+    lib_SecureChannelFree(&srv);
+    lib_SecureChannelFree(&cli);
+
+    /* a replayed record */
+    if (init_pair(&srv, &cli, MEM_SRV_FD, MEM_CLI_FD) < 0)
+        return -1;
+    reset_queues();
+    if (lib_SecureChannelWrite(&srv, buf, sizeof(buf)) != sizeof(buf))
+        return -1;
+    record_size = g_queue[0].wpos;
+    memcpy(record, g_queue[0].buf, record_size);
+    memcpy(g_queue[0].buf + g_queue[0].wpos, record, record_size);
+    g_queue[0].wpos += record_size;
+    if (lib_SecureChannelRead(&cli, buf, sizeof(buf)) != sizeof(buf) ||
+            lib_SecureChannelRead(&cli, buf, sizeof(buf)) != -PAL_ERROR_CRYPTO_AUTH_FAILED) {
+        pal_printf("Replayed record was accepted\n");
+        return -1;
+    }
+    lib_SecureChannelFree(&srv);
+    lib_SecureChannelFree(&cli);
+
+    /* a record sent back to its sender (each direction has its own key) */
+    if (init_pair(&srv, &cli, MEM_SRV_FD, MEM_CLI_FD) < 0)
+        return -1;
+    reset_queues();
+    if (lib_SecureChannelWrite(&srv, buf, sizeof(buf)) != sizeof(buf))
+        return -1;
+    record_size = g_queue[0].wpos;
+    memcpy(record, g_queue[0].buf, record_size);
+    memcpy(g_queue[1].buf, record, record_size);
+    g_queue[1].wpos = record_size;
+    if (lib_SecureChannelRead(&srv, buf, sizeof(buf)) != -PAL_ERROR_CRYPTO_AUTH_FAILED) {
+        pal_printf("Reflected record was accepted\n");
+        return -1;
+    }
+    lib_SecureChannelFree(&srv);
+    lib_SecureChannelFree(&cli);
+
+    /* a record of an earlier stream with the same session key (each stream has its own keys) */
+    if (init_pair(&srv, &cli, MEM_SRV_FD, MEM_CLI_FD) < 0)
+        return -1;
+    reset_queues();
+    memcpy(g_queue[0].buf, record, record_size);
+    g_queue[0].wpos = record_size;
+    if (lib_SecureChannelRead(&cli, buf, sizeof(buf)) != -PAL_ERROR_CRYPTO_AUTH_FAILED) {
+        pal_printf("Record of another stream was accepted\n");
+        return -1;
+    }
+    lib_SecureChannelFree(&srv);
+    lib_SecureChannelFree(&cli);
+
+    pal_printf("Secure channel tampering OK\n");
+    return 0;
+}
+
+static int test_save(void) {
+    LIB_SECURE_CHANNEL srv, cli;
+    uint8_t buf[1000];
+    uint8_t state[2048];
+    size_t state_size;
+
+    if (init_pair(&srv, &cli, MEM_SRV_FD, MEM_CLI_FD) < 0)
+        return -1;
+    reset_queues();
+    fill(buf, sizeof(buf), 1);
+    if (lib_SecureChannelWrite(&srv, buf, sizeof(buf)) != sizeof(buf) ||
+            lib_SecureChannelWrite(&srv, buf, sizeof(buf)) != sizeof(buf))
+        return -1;
+
+    /* half of the first record is read before the reader is moved elsewhere */
+    if (lib_SecureChannelRead(&cli, buf, sizeof(buf) / 2) != sizeof(buf) / 2 ||
+            lib_SecureChannelSave(&cli, state, sizeof(state), &state_size) < 0)
+        return -1;
+    lib_SecureChannelFree(&cli);
+    if (lib_SecureChannelInit(&cli, MEM_CLI_FD, /*is_server=*/false, g_psk, sizeof(g_psk), recv_cb,
+                              send_cb, state, state_size) < 0)
+        return -1;
+
+    if (read_all(&cli, buf + sizeof(buf) / 2, sizeof(buf) / 2, sizeof(buf)) < 0 ||
+            !check(buf, sizeof(buf), 1) || read_all(&cli, buf, sizeof(buf), sizeof(buf)) < 0 ||
+            !check(buf, sizeof(buf), 1)) {
+        pal_printf("Restored secure channel failed\n");
+        return -1;
+    }
+    lib_SecureChannelFree(&srv);
+    lib_SecureChannelFree(&cli);
+
+    pal_printf("Secure channel save/restore OK\n");
+    return 0;
+}
+
+/* Throughput over the pipe: a thread sends BENCH_SIZE bytes in BENCH_WRITE-byte writes */
+
+#define BENCH_SIZE  (64UL * 1024 * 1024)
+#define BENCH_WRITE (256UL * 1024)
+
+static LIB_SECURE_CHANNEL g_bench_srv, g_bench_cli;
+static LIB_SSL_CONTEXT g_bench_ssl_srv, g_bench_ssl_cli;
+static uint8_t* g_bench_buf;
+static atomic_int g_bench_ret;
+
+static void bench_writer(void* use_tls) {
+    int ret = 0;
+    if (use_tls)
+        ret = lib_SSLHandshake(&g_bench_ssl_srv);
+
+    for (size_t done = 0; ret == 0 && done < BENCH_SIZE; ) {
+        size_t size = MIN(BENCH_SIZE - done, BENCH_WRITE);
+        int bytes = use_tls ? lib_SSLWrite(&g_bench_ssl_srv, g_bench_buf, size)
+                            : lib_SecureChannelWrite(&g_bench_srv, g_bench_buf, size);
+        if (bytes < 0)
+            ret = bytes;
+        else
+            done += bytes;
+    }
+
+    g_bench_ret = ret == 0 ? 1 : ret;
+    DkThreadExit(/*clear_child_tid=*/NULL);
+    /* UNREACHABLE */
+}
+
+static int bench(bool use_tls) {
+    uint8_t* buf = g_mem;
+
+    if (use_tls) {
+        if (lib_SSLInit(&g_bench_ssl_srv, PIPE_SRV_FD, /*is_server=*/true, g_psk, sizeof(g_psk),
+                        recv_cb, send_cb, NULL, 0) < 0 ||
+                lib_SSLInit(&g_bench_ssl_cli, PIPE_CLI_FD, /*is_server=*/false, g_psk,
+                            sizeof(g_psk), recv_cb, send_cb, NULL, 0) < 0)
+            return -1;
+    } else {
+        if (init_pair(&g_bench_srv, &g_bench_cli, PIPE_SRV_FD, PIPE_CLI_FD) < 0)
+            return -1;
+    }
+
+    uint64_t start = DkSystemTimeQuery();
+    g_bench_ret = 0;
+    if (!DkThreadCreate(bench_writer, use_tls ? (void*)1 : NULL))
+        return -1;
+
+    int ret = use_tls ? lib_SSLHandshake(&g_bench_ssl_cli) : 0;
+    for (size_t done = 0; ret == 0 && done < BENCH_SIZE; ) {
+        size_t size = MIN(BENCH_SIZE - done, BENCH_WRITE);
+        int bytes = use_tls ? lib_SSLRead(&g_bench_ssl_cli, buf, size)
+                            : lib_SecureChannelRead(&g_bench_cli, buf, size);
+        if (bytes <= 0)
+            ret = bytes < 0 ? bytes : -PAL_ERROR_CONNFAILED_PIPE;
+        else
+            done += bytes;
+    }
+
+    while (!g_bench_ret)
+        DkThreadYieldExecution();
+    if (ret < 0 || g_bench_ret < 0) {
+        pal_printf("Benchmark failed: %d, %d\n", ret, (int)g_bench_ret);
+        return -1;
+    }
+
+    uint64_t usec = DkSystemTimeQuery() - start;
+    pal_printf("%s: %lu MB/s\n", use_tls ? "TLS" : "Secure channel",
+               usec ? BENCH_SIZE / usec : 0);
+
+    if (use_tls) {
+        lib_SSLFree(&g_bench_ssl_srv);
+        lib_SSLFree(&g_bench_ssl_cli);
+    } else {
+        lib_SecureChannelFree(&g_bench_srv);
+        lib_SecureChannelFree(&g_bench_cli);
+    }
+    return 0;
+}
+
+int main(void) {
+    g_mem = (uint8_t*)DkVirtualMemoryAlloc(NULL, MEM_SIZE, 0, PAL_PROT_READ | PAL_PROT_WRITE);
+    for (size_t i = 0; i < 2; i++) {
+        g_queue[i].buf = (uint8_t*)DkVirtualMemoryAlloc(NULL, MEM_SIZE, 0,
+                                                        PAL_PROT_READ | PAL_PROT_WRITE);
+        if (!g_queue[i].buf)
+            return 1;
+    }
+    g_bench_buf = (uint8_t*)DkVirtualMemoryAlloc(NULL, BENCH_WRITE, 0,
+                                                 PAL_PROT_READ | PAL_PROT_WRITE);
+    if (!g_mem || !g_bench_buf)
+        return 1;
+    fill(g_bench_buf, BENCH_WRITE, 0);
+
+    if (test_loopback() < 0 || test_tampering() < 0 || test_save() < 0)
+        return 1;
+
+    PAL_HANDLE srv = DkStreamOpen("pipe.srv:secure_channel", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!srv)
+        return 1;
+    g_pipe[PIPE_CLI_FD] = DkStreamOpen("pipe:secure_channel", PAL_ACCESS_RDWR, 0, 0, 0);
+    if (!g_pipe[PIPE_CLI_FD])
+        return 1;
+    g_pipe[PIPE_SRV_FD] = DkStreamWaitForClient(srv);
+    if (!g_pipe[PIPE_SRV_FD])
+        return 1;
+
+    if (bench(/*use_tls=*/false) < 0 || bench(/*use_tls=*/true) < 0)
+        return 1;
+
+    pal_printf("Success!\n");
+    return 0;
+}
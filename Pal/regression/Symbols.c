@@ -14,6 +14,10 @@ int main(int argc, char** argv, char** envp) {
     PRINT_SYMBOL(DkVirtualMemoryAlloc);
     PRINT_SYMBOL(DkVirtualMemoryFree);
     PRINT_SYMBOL(DkVirtualMemoryProtect);
+    PRINT_SYMBOL(DkVirtualMemoryMove);
+    PRINT_SYMBOL(DkVirtualMemoryAdvise);
+    PRINT_SYMBOL(DkVirtualMemoryPolicy);
+    PRINT_SYMBOL(DkVirtualMemoryNodes);
 
     PRINT_SYMBOL(DkProcessCreate);
     PRINT_SYMBOL(DkProcessExit);
@@ -22,11 +26,17 @@ int main(int argc, char** argv, char** envp) {
     PRINT_SYMBOL(DkStreamWaitForClient);
     PRINT_SYMBOL(DkStreamRead);
     PRINT_SYMBOL(DkStreamWrite);
+    PRINT_SYMBOL(DkStreamCopy);
     PRINT_SYMBOL(DkStreamDelete);
     PRINT_SYMBOL(DkStreamMap);
     PRINT_SYMBOL(DkStreamUnmap);
     PRINT_SYMBOL(DkStreamSetLength);
     PRINT_SYMBOL(DkStreamFlush);
+    PRINT_SYMBOL(DkStreamAllocate);
+    PRINT_SYMBOL(DkStreamAdvise);
+    PRINT_SYMBOL(DkStreamFlushRange);
+    PRINT_SYMBOL(DkStreamLock);
+    PRINT_SYMBOL(DkStreamLockQuery);
     PRINT_SYMBOL(DkSendHandle);
     PRINT_SYMBOL(DkReceiveHandle);
     PRINT_SYMBOL(DkStreamAttributesQuery);
@@ -35,12 +45,18 @@ int main(int argc, char** argv, char** envp) {
     PRINT_SYMBOL(DkStreamGetName);
     PRINT_SYMBOL(DkStreamChangeName);
     PRINT_SYMBOL(DkStreamsWaitEvents);
+    PRINT_SYMBOL(DkStreamsBatchIo);
+    PRINT_SYMBOL(DkWaitOnAddress);
+    PRINT_SYMBOL(DkWakeByAddress);
 
     PRINT_SYMBOL(DkThreadCreate);
     PRINT_SYMBOL(DkThreadDelayExecution);
     PRINT_SYMBOL(DkThreadYieldExecution);
     PRINT_SYMBOL(DkThreadExit);
     PRINT_SYMBOL(DkThreadResume);
+    PRINT_SYMBOL(DkThreadSetCpuAffinity);
+    PRINT_SYMBOL(DkThreadGetCpuAffinity);
+    PRINT_SYMBOL(DkThreadGetCurrentCpu);
 
     PRINT_SYMBOL(DkSetExceptionHandler);
     PRINT_SYMBOL(DkExceptionReturn);
@@ -56,6 +72,7 @@ int main(int argc, char** argv, char** envp) {
     PRINT_SYMBOL(DkObjectClose);
 
     PRINT_SYMBOL(DkSystemTimeQuery);
+    PRINT_SYMBOL(DkSetCallTracer);
     PRINT_SYMBOL(DkRandomBitsRead);
     PRINT_SYMBOL(DkInstructionCacheFlush);
     PRINT_SYMBOL(DkSegmentRegister);
@@ -45,6 +45,20 @@ class TC_00_Basic(RegressionTestCase):
     def test_002_avl_tree(self):
         _, _ = self.run_binary(['avl_tree_test'])
 
+    def test_003_crypto(self):
+        _, stderr = self.run_binary(['Crypto'])
+        self.assertIn('SHA-256 KAT OK', stderr)
+        self.assertIn('AES-CMAC KAT OK', stderr)
+        self.assertIn('AES-CMAC batch KAT OK', stderr)
+        self.assertIn('Success!', stderr)
+
+    def test_004_secure_channel(self):
+        _, stderr = self.run_binary(['SecureChannel'], timeout=60)
+        self.assertIn('Secure channel loopback OK', stderr)
+        self.assertIn('Secure channel tampering OK', stderr)
+        self.assertIn('Secure channel save/restore OK', stderr)
+        self.assertIn('Success!', stderr)
+
 
 @unittest.skipIf(HAS_SGX, "Not yet tested on SGX")
 class TC_00_BasicSet2(RegressionTestCase):
@@ -263,17 +277,27 @@ class TC_02_Symbols(RegressionTestCase):
         'DkVirtualMemoryAlloc',
         'DkVirtualMemoryFree',
         'DkVirtualMemoryProtect',
+        'DkVirtualMemoryMove',
+        'DkVirtualMemoryAdvise',
+        'DkVirtualMemoryPolicy',
+        'DkVirtualMemoryNodes',
         'DkProcessCreate',
         'DkProcessExit',
         'DkStreamOpen',
         'DkStreamWaitForClient',
         'DkStreamRead',
         'DkStreamWrite',
+        'DkStreamCopy',
         'DkStreamDelete',
         'DkStreamMap',
         'DkStreamUnmap',
         'DkStreamSetLength',
         'DkStreamFlush',
+        'DkStreamAllocate',
+        'DkStreamAdvise',
+        'DkStreamFlushRange',
+        'DkStreamLock',
+        'DkStreamLockQuery',
         'DkSendHandle',
         'DkReceiveHandle',
         'DkStreamAttributesQuery',
@@ -286,6 +310,9 @@ class TC_02_Symbols(RegressionTestCase):
         'DkThreadYieldExecution',
         'DkThreadExit',
         'DkThreadResume',
+        'DkThreadSetCpuAffinity',
+        'DkThreadGetCpuAffinity',
+        'DkThreadGetCurrentCpu',
         'DkSetExceptionHandler',
         'DkExceptionReturn',
         'DkMutexCreate',
@@ -296,8 +323,12 @@ class TC_02_Symbols(RegressionTestCase):
         'DkEventClear',
         'DkSynchronizationObjectWait',
         'DkStreamsWaitEvents',
+        'DkStreamsBatchIo',
+        'DkWaitOnAddress',
+        'DkWakeByAddress',
         'DkObjectClose',
         'DkSystemTimeQuery',
+        'DkSetCallTracer',
         'DkRandomBitsRead',
         'DkInstructionCacheFlush',
         'DkSegmentRegister',
@@ -414,13 +445,33 @@ class TC_20_SingleProcess(RegressionTestCase):
             stderr)
 
         # Set File Length
+        self.assertIn('File Storage Hints OK', stderr)
         self.assertEqual(
             pathlib.Path('file_nonexist.tmp').stat().st_size,
             mmap.ALLOCATIONGRANULARITY)
 
+        # File Locking (Linux-SGX does not lock host files)
+        if not HAS_SGX:
+            self.assertIn('File Lock OK', stderr)
+
         # File Deletion
         self.assertFalse(pathlib.Path('file_delete.tmp').exists())
 
+    def test_102_batch_io(self):
+        for name in ('batch_io.tmp', 'batch_io_src.tmp', 'batch_io_dst.tmp'):
+            try:
+                pathlib.Path(name).unlink()
+            except FileNotFoundError:
+                pass
+
+        _, stderr = self.run_binary(['BatchIo'], timeout=60)
+        self.assertIn('Batch Write OK', stderr)
+        self.assertIn('Batch Read OK', stderr)
+        self.assertIn('Batch Poll OK', stderr)
+        self.assertIn('File copy (batched)', stderr)
+        self.assertIn('File copy (one call per chunk)', stderr)
+        self.assertIn('Success!', stderr)
+
     @unittest.skipUnless(HAS_SGX, 'this test requires SGX')
     def test_101_nonexist_file(self):
         # Explicitly remove the file file_nonexist_disallowed.tmp before
@@ -509,6 +560,9 @@ class TC_20_SingleProcess(RegressionTestCase):
         # Get Memory Available Quota
         self.assertIn('Get Memory Available Quota OK', stderr)
 
+        # Memory Advise (DONTNEED zeroes the memory)
+        self.assertIn('Memory Advise OK', stderr)
+
     @expectedFailureIf(HAS_SGX)
     def test_301_memory_nosgx(self):
         _, stderr = self.run_binary(['Memory'])
@@ -524,6 +578,14 @@ class TC_20_SingleProcess(RegressionTestCase):
         # Memory Deallocation
         self.assertIn('Memory Deallocation OK', stderr)
 
+        # Memory Move (not supported for enclave memory)
+        self.assertIn('Memory Move OK', stderr)
+
+        # Memory Policy (the placement of enclave memory cannot be controlled;
+        # mbind() fails with EPERM under some seccomp filters, e.g. in Docker)
+        if 'Memory Policy not supported' not in stderr:
+            self.assertIn('Memory Policy OK', stderr)
+
     def test_400_pipe(self):
         _, stderr = self.run_binary(['Pipe'])
 
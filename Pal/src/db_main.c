@@ -195,6 +195,12 @@ static int loader_filter (const char * key, int len)
             key[4] == 'e' && key[5] == 'r' && key[6] == '.') ? 0 : 1;
 }
 
+static void boot_phase_end(enum PAL_BOOT_PHASE phase) {
+    PAL_BOOT_PROFILE* profile = &__pal_control.boot_profile;
+    profile->phase_end[phase]      = _DkSystemTimeQuery();
+    profile->phase_counters[phase] = profile->counters;
+}
+
 /* 'pal_main' must be called by the host-specific bootloader */
 noreturn void pal_main(
         PAL_NUM    instance_id,      /* current instance id */
@@ -206,6 +212,12 @@ noreturn void pal_main(
         PAL_STR*   arguments,        /* application arguments */
         PAL_STR*   environments      /* environment variables */) {
     char cfgbuf[CONFIG_MAX];
+
+    /* the host may have set an earlier start time (e.g. before creating the enclave) */
+    if (!__pal_control.boot_profile.start_time)
+        __pal_control.boot_profile.start_time = pal_state.start_time;
+    boot_phase_end(PAL_BOOT_PHASE_HOST);
+
     pal_state.instance_id = instance_id;
     pal_state.alloc_align = _DkGetAllocationAlignment();
     assert(IS_POWER_OF_2(pal_state.alloc_align));
@@ -287,6 +299,7 @@ noreturn void pal_main(
 
         pal_state.root_config = root_config;
     }
+    boot_phase_end(PAL_BOOT_PHASE_MANIFEST);
 
     /* if there is no executable, try to find one in the manifest */
     if (!exec_handle && pal_state.root_config) {
@@ -438,9 +451,11 @@ noreturn void pal_main(
     }
 
     read_environments(&environments);
+    boot_phase_end(PAL_BOOT_PHASE_ARGV_ENV);
 
     if (pal_state.root_config)
         load_libraries();
+    boot_phase_end(PAL_BOOT_PHASE_PRELOAD);
 
     if (exec_handle) {
         if (exec_loaded_addr) {
@@ -452,6 +467,7 @@ noreturn void pal_main(
         if (ret < 0)
             INIT_FAIL(-ret, pal_strerror(ret));
     }
+    boot_phase_end(PAL_BOOT_PHASE_EXEC);
 
     set_debug_type();
 
@@ -474,6 +490,7 @@ noreturn void pal_main(
         goto out_fail;
     }
     __pal_control.mem_info.mem_total = _DkMemoryQuota();
+    boot_phase_end(PAL_BOOT_PHASE_HOST_INFO);
 
     /* Now we will start the execution */
     start_execution(arguments, environments);
@@ -33,6 +33,9 @@ PAL_PTR DkVirtualMemoryAlloc(PAL_PTR addr, PAL_NUM size, PAL_FLG alloc_type, PAL
     if (ret < 0) {
         _DkRaiseFailure(-ret);
         map_addr = NULL;
+    } else {
+        __atomic_add_fetch(&__pal_control.boot_profile.counters.pages_allocated,
+                           size / pal_state.alloc_align, __ATOMIC_RELAXED);
     }
 
     LEAVE_PAL_CALL_RETURN((PAL_PTR)map_addr);
@@ -93,3 +96,148 @@ DkVirtualMemoryProtect(PAL_PTR addr, PAL_NUM size, PAL_FLG prot) {
 
     LEAVE_PAL_CALL_RETURN(PAL_TRUE);
 }
+
+PAL_BOL
+DkVirtualMemoryMove(PAL_PTR old_addr, PAL_PTR new_addr, PAL_NUM size) {
+    ENTER_PAL_CALL(DkVirtualMemoryMove);
+
+    if (!old_addr || !new_addr || !size) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    if (!IS_ALLOC_ALIGNED_PTR(old_addr) || !IS_ALLOC_ALIGNED_PTR(new_addr) ||
+            !IS_ALLOC_ALIGNED(size)) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    if (old_addr < new_addr + size && new_addr < old_addr + size) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    if (_DkCheckMemoryMappable((void*)old_addr, size) ||
+            _DkCheckMemoryMappable((void*)new_addr, size)) {
+        _DkRaiseFailure(PAL_ERROR_DENIED);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkVirtualMemoryMove((void*)old_addr, (void*)new_addr, size);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+PAL_BOL
+DkVirtualMemoryAdvise(PAL_PTR addr, PAL_NUM size, PAL_FLG advice) {
+    ENTER_PAL_CALL(DkVirtualMemoryAdvise);
+
+    if (!addr || !size || advice > PAL_MADVISE_NOHUGEPAGE) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    if (!IS_ALLOC_ALIGNED_PTR(addr) || !IS_ALLOC_ALIGNED(size)) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    if (_DkCheckMemoryMappable((void*)addr, size)) {
+        _DkRaiseFailure(PAL_ERROR_DENIED);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkVirtualMemoryAdvise((void*)addr, size, advice);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+PAL_BOL
+DkVirtualMemoryPolicy(PAL_PTR addr, PAL_NUM size, PAL_FLG mode, PAL_NUM nodemask, PAL_FLG flags) {
+    ENTER_PAL_CALL(DkVirtualMemoryPolicy);
+
+    if (mode > PAL_MPOL_LOCAL || (flags & ~PAL_MPOL_MOVE)) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    /* an empty mask with PAL_MPOL_PREFERRED means the local node */
+    bool needs_nodes = mode == PAL_MPOL_BIND || mode == PAL_MPOL_INTERLEAVE;
+    bool takes_nodes = needs_nodes || mode == PAL_MPOL_PREFERRED;
+    if ((needs_nodes && !nodemask) || (!takes_nodes && nodemask)) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    if (!addr) {
+        /* the default policy of the calling thread */
+        if (size || flags) {
+            _DkRaiseFailure(PAL_ERROR_INVAL);
+            LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+        }
+    } else {
+        if (!size || !IS_ALLOC_ALIGNED_PTR(addr) || !IS_ALLOC_ALIGNED(size)) {
+            _DkRaiseFailure(PAL_ERROR_INVAL);
+            LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+        }
+
+        if (_DkCheckMemoryMappable((void*)addr, size)) {
+            _DkRaiseFailure(PAL_ERROR_DENIED);
+            LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+        }
+    }
+
+    int ret = _DkVirtualMemoryPolicy((void*)addr, size, mode, nodemask, flags);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+PAL_BOL
+DkVirtualMemoryNodes(PAL_NUM count, PAL_PTR* pages, const PAL_IDX* nodes, PAL_IDX* status) {
+    ENTER_PAL_CALL(DkVirtualMemoryNodes);
+
+    if (!count) {
+        LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+    }
+
+    if (!pages || !status) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    for (PAL_NUM i = 0; i < count; i++) {
+        if (!pages[i] || !IS_ALLOC_ALIGNED_PTR(pages[i])) {
+            _DkRaiseFailure(PAL_ERROR_INVAL);
+            LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+        }
+
+        if (nodes && _DkCheckMemoryMappable(pages[i], pal_state.alloc_align)) {
+            _DkRaiseFailure(PAL_ERROR_DENIED);
+            LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+        }
+    }
+
+    int ret = _DkVirtualMemoryNodes(count, (void**)pages, nodes, status);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
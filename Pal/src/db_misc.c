@@ -13,8 +13,20 @@
 #include "pal_error.h"
 #include "pal_internal.h"
 
+PAL_CALL_TRACER g_pal_call_tracer = NULL;
+
+void trace_pal_call(const char* name, unsigned long start_time) {
+    PAL_CALL_TRACER tracer = __atomic_load_n(&g_pal_call_tracer, __ATOMIC_ACQUIRE);
+    if (tracer)
+        tracer(name, start_time, _DkSystemTimeQuery());
+}
+
+void DkSetCallTracer(PAL_CALL_TRACER tracer) {
+    __atomic_store_n(&g_pal_call_tracer, tracer, __ATOMIC_RELEASE);
+}
+
+/* not traced because it is used by the tracers themselves */
 PAL_NUM DkSystemTimeQuery(void) {
-    ENTER_PAL_CALL(DkSystemTimeQuery);
     unsigned long time = _DkSystemTimeQuery();
     return time;
 }
@@ -100,3 +100,38 @@ PAL_BOL DkStreamsWaitEvents(PAL_NUM count, PAL_HANDLE* handle_array, PAL_FLG* ev
 
     LEAVE_PAL_CALL_RETURN(PAL_TRUE);
 }
+
+/* Wait until the value at `addr` is woken up or differs from `expected`. Returns PAL_FALSE and
+ * raises failure on timeout or error. */
+PAL_BOL DkWaitOnAddress(PAL_PTR addr, PAL_IDX expected, PAL_NUM timeout_us) {
+    ENTER_PAL_CALL(DkWaitOnAddress);
+
+    if (!addr || !IS_ALIGNED_PTR(addr, sizeof(uint32_t))) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkWaitOnAddress((uint32_t*)addr, expected, timeout_us);
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* Wake up at most `count` threads waiting on `addr` in DkWaitOnAddress. */
+void DkWakeByAddress(PAL_PTR addr, PAL_NUM count) {
+    ENTER_PAL_CALL(DkWakeByAddress);
+
+    if (!addr || !IS_ALIGNED_PTR(addr, sizeof(uint32_t))) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL();
+    }
+
+    int ret = _DkWakeByAddress((uint32_t*)addr, count);
+    if (ret < 0)
+        _DkRaiseFailure(-ret);
+
+    LEAVE_PAL_CALL();
+}
@@ -31,6 +31,7 @@ extern struct handle_ops proc_ops;
 extern struct handle_ops mutex_ops;
 extern struct handle_ops event_ops;
 extern struct handle_ops eventfd_ops;
+extern struct handle_ops shm_ops;
 
 const struct handle_ops* pal_handle_ops[PAL_HANDLE_TYPE_BOUND] = {
     [pal_type_file]    = &file_ops,
@@ -73,6 +74,7 @@ static int parse_stream_uri(const char** uri, char** prefix, struct handle_ops**
             static_assert(static_strlen(URI_PREFIX_TCP) == 4, "URI_PREFIX_TCP has unexpected length");
             static_assert(static_strlen(URI_PREFIX_UDP) == 4, "URI_PREFIX_UDP has unexpected length");
             static_assert(static_strlen(URI_PREFIX_DEV) == 4, "URI_PREFIX_DEV has unexpected length");
+            static_assert(static_strlen(URI_PREFIX_SHM) == 4, "URI_PREFIX_SHM has unexpected length");
 
             if (strstartswith_static(u, URI_PREFIX_DIR))
                 hops = &dir_ops;
@@ -82,6 +84,8 @@ static int parse_stream_uri(const char** uri, char** prefix, struct handle_ops**
                 hops = &udp_ops;
             else if (strstartswith_static(u, URI_PREFIX_DEV))
                 hops = &dev_ops;
+            else if (strstartswith_static(u, URI_PREFIX_SHM))
+                hops = &shm_ops;
             break;
 
         case 5: ;
@@ -156,6 +160,9 @@ int _DkStreamOpen(PAL_HANDLE* handle, const char* uri, int access, int share, in
     assert(ops && ops->open);
     ret = ops->open(handle, type, uri, access, share, create, options);
     free(type);
+    if (ret >= 0)
+        __atomic_add_fetch(&__pal_control.boot_profile.counters.files_opened, 1,
+                           __ATOMIC_RELAXED);
     return ret;
 }
 
@@ -347,6 +354,29 @@ DkStreamWrite(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM count, PAL_PTR buffer,
     LEAVE_PAL_CALL_RETURN(ret);
 }
 
+/* PAL call DkStreamCopy: Copy data between streams at absolute offsets. Return
+   number of bytes copied if succeeded,
+   or PAL_STREAM_ERROR for failure. Error code is notified. */
+PAL_NUM
+DkStreamCopy(PAL_HANDLE dst, PAL_NUM dst_offset, PAL_HANDLE src, PAL_NUM src_offset,
+             PAL_NUM count) {
+    ENTER_PAL_CALL(DkStreamCopy);
+
+    if (!dst || !src || UNKNOWN_HANDLE(dst) || UNKNOWN_HANDLE(src)) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_STREAM_ERROR);
+    }
+
+    int64_t ret = _DkStreamCopy(dst, dst_offset, src, src_offset, count);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        ret = PAL_STREAM_ERROR;
+    }
+
+    LEAVE_PAL_CALL_RETURN(ret);
+}
+
 /* _DkStreamAttributesQuery of internal use. The function query attribute
    of streams by their URI */
 int _DkStreamAttributesQuery(const char* uri, PAL_STREAM_ATTR* attr) {
@@ -650,6 +680,282 @@ PAL_BOL DkStreamFlush(PAL_HANDLE handle) {
     LEAVE_PAL_CALL_RETURN(PAL_TRUE);
 }
 
+/* _DkStreamAllocate for internal use. Streams which cannot reserve storage
+   fail with PAL_ERROR_NOTSUPPORT. */
+int _DkStreamAllocate(PAL_HANDLE handle, uint64_t offset, uint64_t length, int mode) {
+    if (UNKNOWN_HANDLE(handle))
+        return -PAL_ERROR_BADHANDLE;
+
+    const struct handle_ops* ops = HANDLE_OPS(handle);
+
+    if (!ops)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (!ops->allocate)
+        return -PAL_ERROR_NOTSUPPORT;
+
+    return ops->allocate(handle, offset, length, mode);
+}
+
+/* PAL call DkStreamAllocate: Allocate storage for a range of a stream. Return
+   TRUE if succeeded or FALSE if failed. Error code is notified. */
+PAL_BOL DkStreamAllocate(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM length, PAL_FLG mode) {
+    ENTER_PAL_CALL(DkStreamAllocate);
+
+    if (!handle || !length ||
+            mode & ~(PAL_FALLOC_KEEP_SIZE | PAL_FALLOC_PUNCH_HOLE | PAL_FALLOC_ZERO_RANGE) ||
+            ((mode & PAL_FALLOC_PUNCH_HOLE) &&
+             (mode & (PAL_FALLOC_KEEP_SIZE | PAL_FALLOC_ZERO_RANGE)) != PAL_FALLOC_KEEP_SIZE)) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkStreamAllocate(handle, offset, length, mode);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* _DkStreamAdvise for internal use. Advice is only a hint, so streams which
+   cannot pass it on ignore it. */
+int _DkStreamAdvise(PAL_HANDLE handle, uint64_t offset, uint64_t length, int advice) {
+    if (UNKNOWN_HANDLE(handle))
+        return -PAL_ERROR_BADHANDLE;
+
+    const struct handle_ops* ops = HANDLE_OPS(handle);
+
+    if (!ops)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (!ops->advise)
+        return 0;
+
+    return ops->advise(handle, offset, length, advice);
+}
+
+/* PAL call DkStreamAdvise: Advise on the access pattern of a range of a
+   stream. Return TRUE if succeeded or FALSE if failed. Error code is
+   notified. */
+PAL_BOL DkStreamAdvise(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM length, PAL_FLG advice) {
+    ENTER_PAL_CALL(DkStreamAdvise);
+
+    if (!handle || advice > PAL_FADVISE_NOREUSE) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkStreamAdvise(handle, offset, length, advice);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* _DkStreamFlushRange for internal use. Streams which cannot flush a range
+   flush the whole stream instead. */
+int _DkStreamFlushRange(PAL_HANDLE handle, uint64_t offset, uint64_t length, int flags) {
+    if (UNKNOWN_HANDLE(handle))
+        return -PAL_ERROR_BADHANDLE;
+
+    const struct handle_ops* ops = HANDLE_OPS(handle);
+
+    if (!ops)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (ops->flushrange)
+        return ops->flushrange(handle, offset, length, flags);
+
+    if (!flags)
+        return 0;
+
+    if (!ops->flush)
+        return -PAL_ERROR_NOTSUPPORT;
+
+    return ops->flush(handle);
+}
+
+/* PAL call DkStreamFlushRange: Write the dirty data of a range of a stream
+   to the device. Return TRUE if succeeded or FALSE if failed. Error code is
+   notified. */
+PAL_BOL DkStreamFlushRange(PAL_HANDLE handle, PAL_NUM offset, PAL_NUM length, PAL_FLG flags) {
+    ENTER_PAL_CALL(DkStreamFlushRange);
+
+    if (!handle || flags & ~(PAL_FLUSH_RANGE_WAIT_BEFORE | PAL_FLUSH_RANGE_WRITE |
+                             PAL_FLUSH_RANGE_WAIT_AFTER)) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkStreamFlushRange(handle, offset, length, flags);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* _DkStreamLock for internal use. Streams which cannot be locked fail with
+   PAL_ERROR_NOTIMPLEMENTED. */
+int _DkStreamLock(PAL_HANDLE handle, int type, uint64_t offset, uint64_t length, int flags) {
+    if (UNKNOWN_HANDLE(handle))
+        return -PAL_ERROR_BADHANDLE;
+
+    const struct handle_ops* ops = HANDLE_OPS(handle);
+
+    if (!ops)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (!ops->lock)
+        return -PAL_ERROR_NOTIMPLEMENTED;
+
+    return ops->lock(handle, type, offset, length, flags);
+}
+
+/* PAL call DkStreamLock: Acquire, convert or release an advisory lock on a
+   range of a stream. Return TRUE if succeeded or FALSE if failed. Error code
+   is notified. */
+PAL_BOL DkStreamLock(PAL_HANDLE handle, PAL_FLG type, PAL_NUM offset, PAL_NUM length,
+                     PAL_FLG flags) {
+    ENTER_PAL_CALL(DkStreamLock);
+
+    if (!handle || type > PAL_LOCK_EXCLUSIVE || flags & ~(PAL_LOCK_WAIT | PAL_LOCK_WHOLE) ||
+            ((flags & PAL_LOCK_WHOLE) && (offset || length)) ||
+            offset > INT64_MAX || length > INT64_MAX - offset) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkStreamLock(handle, type, offset, length, flags);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* _DkStreamLockQuery for internal use. */
+int _DkStreamLockQuery(PAL_HANDLE handle, int* type, uint64_t* offset, uint64_t* length) {
+    if (UNKNOWN_HANDLE(handle))
+        return -PAL_ERROR_BADHANDLE;
+
+    const struct handle_ops* ops = HANDLE_OPS(handle);
+
+    if (!ops)
+        return -PAL_ERROR_BADHANDLE;
+
+    if (!ops->lockquery)
+        return -PAL_ERROR_NOTIMPLEMENTED;
+
+    return ops->lockquery(handle, type, offset, length);
+}
+
+/* PAL call DkStreamLockQuery: Find a lock which conflicts with a range lock.
+   Return TRUE if succeeded or FALSE if failed. Error code is notified. */
+PAL_BOL DkStreamLockQuery(PAL_HANDLE handle, PAL_FLG* type, PAL_NUM* offset, PAL_NUM* length) {
+    ENTER_PAL_CALL(DkStreamLockQuery);
+
+    if (!handle || !type || !offset || !length || *type == PAL_LOCK_UNLOCK ||
+            *type > PAL_LOCK_EXCLUSIVE || *offset > INT64_MAX || *length > INT64_MAX - *offset) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int lock_type = *type;
+    int ret = _DkStreamLockQuery(handle, &lock_type, offset, length);
+
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    *type = lock_type;
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* Performs one request of DkStreamsBatchIo() with the ordinary stream operations. */
+static void batch_io_one(PAL_IO_REQUEST* req) {
+    int64_t ret;
+
+    switch (req->op) {
+        case PAL_IO_READ:
+            ret = _DkStreamRead(req->handle, req->offset, req->count, (void*)req->buffer, NULL, 0);
+            if (ret == -PAL_ERROR_ENDOFSTREAM)
+                ret = 0;
+            break;
+        case PAL_IO_WRITE:
+            ret = _DkStreamWrite(req->handle, req->offset, req->count, (void*)req->buffer, NULL, 0);
+            break;
+        case PAL_IO_FLUSH:
+            ret = _DkStreamFlush(req->handle);
+            break;
+        case PAL_IO_POLL: {
+            PAL_FLG events = req->count;
+            PAL_FLG ret_events = 0;
+            ret = _DkStreamsWaitEvents(1, &req->handle, &events, &ret_events, NO_TIMEOUT);
+            if (ret == 0)
+                ret = ret_events;
+            break;
+        }
+        default:
+            ret = -PAL_ERROR_INVAL;
+            break;
+    }
+
+    if (ret < 0) {
+        req->result = PAL_STREAM_ERROR;
+        req->error  = -ret;
+    } else {
+        req->result = ret;
+        req->error  = 0;
+    }
+}
+
+/* PAL call DkStreamsBatchIo: Perform several independent stream operations at
+ * once. Return TRUE if all of them were performed (results are in the requests)
+ * or FALSE if the arguments are invalid. Error code is notified. */
+PAL_BOL DkStreamsBatchIo(PAL_IO_REQUEST* requests, PAL_NUM count) {
+    ENTER_PAL_CALL(DkStreamsBatchIo);
+
+    if (count && !requests) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    for (PAL_NUM i = 0; i < count; i++) {
+        if (!requests[i].handle || UNKNOWN_HANDLE(requests[i].handle) ||
+                requests[i].op > PAL_IO_POLL ||
+                (requests[i].op <= PAL_IO_WRITE && !requests[i].buffer)) {
+            _DkRaiseFailure(PAL_ERROR_INVAL);
+            LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+        }
+    }
+
+    if (!count)
+        LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+
+    int ret = _DkStreamsBatchIo(requests, count);
+    if (ret == -PAL_ERROR_NOTIMPLEMENTED) {
+        for (PAL_NUM i = 0; i < count; i++)
+            batch_io_one(&requests[i]);
+    } else if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
 /* PAL call DkSendHandle: Write to a process handle.
    Return TRUE on success and FALSE on failure */
 PAL_BOL DkSendHandle(PAL_HANDLE handle, PAL_HANDLE cargo) {
@@ -83,3 +83,52 @@ PAL_BOL DkThreadResume(PAL_HANDLE threadHandle) {
 
     LEAVE_PAL_CALL_RETURN(PAL_TRUE);
 }
+
+/* PAL call DkThreadSetCpuAffinity: restrict the set of host CPUs a thread may run on */
+PAL_BOL DkThreadSetCpuAffinity(PAL_HANDLE thread, PAL_NUM cpumask_size, PAL_PTR cpu_mask) {
+    ENTER_PAL_CALL(DkThreadSetCpuAffinity);
+
+    if ((thread && !IS_HANDLE_TYPE(thread, thread)) || !cpumask_size || !cpu_mask) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkThreadSetCpuAffinity(thread, cpumask_size, cpu_mask);
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* PAL call DkThreadGetCpuAffinity: get the set of host CPUs a thread may run on */
+PAL_BOL DkThreadGetCpuAffinity(PAL_HANDLE thread, PAL_NUM cpumask_size, PAL_PTR cpu_mask) {
+    ENTER_PAL_CALL(DkThreadGetCpuAffinity);
+
+    if ((thread && !IS_HANDLE_TYPE(thread, thread)) || !cpumask_size || !cpu_mask) {
+        _DkRaiseFailure(PAL_ERROR_INVAL);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    int ret = _DkThreadGetCpuAffinity(thread, cpumask_size, cpu_mask);
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
+
+/* PAL call DkThreadGetCurrentCpu: get the host CPU and NUMA node the current thread runs on */
+PAL_BOL DkThreadGetCurrentCpu(PAL_IDX* cpu, PAL_IDX* node) {
+    ENTER_PAL_CALL(DkThreadGetCurrentCpu);
+
+    int ret = _DkThreadGetCurrentCpu(cpu, node);
+    if (ret < 0) {
+        _DkRaiseFailure(-ret);
+        LEAVE_PAL_CALL_RETURN(PAL_FALSE);
+    }
+
+    LEAVE_PAL_CALL_RETURN(PAL_TRUE);
+}
@@ -182,12 +182,9 @@ static int file_map(PAL_HANDLE handle, void** addr, int prot, uint64_t offset, u
     }
 
     if (!(prot & PAL_PROT_WRITECOPY) && (prot & PAL_PROT_WRITE)) {
-        SGX_DBG(DBG_E,
-                "file_map does not currently support writable pass-through mappings on SGX.  You "
-                "may add the PAL_PROT_WRITECOPY (MAP_PRIVATE) flag to your file mapping to keep "
-                "the writes inside the enclave but they won't be reflected outside of the "
-                "enclave.\n");
-        return -PAL_ERROR_DENIED;
+        /* writable pass-through mappings inside the enclave are impossible; the library OS
+         * emulates them with a PAL_PROT_WRITECOPY mapping and explicit write-back */
+        return -PAL_ERROR_NOTIMPLEMENTED;
     }
 
     mem = get_enclave_pages(mem, size, /*is_pal_internal=*/false);
@@ -373,6 +370,24 @@ struct handle_ops file_ops = {
     .rename         = &file_rename,
 };
 
+/* Untrusted host memory cannot back shared state of the enclave, so named shared-memory objects
+ * are not supported; callers fall back to IPC. */
+static int shm_open(PAL_HANDLE* handle, const char* type, const char* uri, int access, int share,
+                    int create, int options) {
+    __UNUSED(handle);
+    __UNUSED(type);
+    __UNUSED(uri);
+    __UNUSED(access);
+    __UNUSED(share);
+    __UNUSED(create);
+    __UNUSED(options);
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+struct handle_ops shm_ops = {
+    .open = &shm_open,
+};
+
 /* 'open' operation for directory stream. Directory stream does not have a
    specific type prefix, its URI looks the same file streams, plus it
    ended with slashes. dir_open will be called by file_open. */
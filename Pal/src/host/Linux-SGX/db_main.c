@@ -255,9 +255,7 @@ void pal_linux_main(char * uptr_args, uint64_t args_size,
 #ifdef DEBUG
     pal_sec.in_gdb = sec_info.in_gdb;
 #endif
-#if PRINT_ENCLAVE_STAT == 1
     pal_sec.start_time = sec_info.start_time;
-#endif
 
     /* For {p,u,g}ids we can at least do some minimal checking. */
 
@@ -322,6 +320,8 @@ void pal_linux_main(char * uptr_args, uint64_t args_size,
     }
 
     pal_state.start_time = start_time;
+    /* account enclave creation (done by the untrusted loader) to the boot profile */
+    __pal_control.boot_profile.start_time = pal_sec.start_time;
 
     linux_state.uid = pal_sec.uid;
     linux_state.gid = pal_sec.gid;
@@ -398,6 +398,11 @@ void pal_linux_main(char * uptr_args, uint64_t args_size,
         ocall_exit(rv, true);
     }
 
+    if ((rv = init_secure_streams()) < 0) {
+        SGX_DBG(DBG_E, "Failed to initialize secure streams: %d\n", rv);
+        ocall_exit(rv, true);
+    }
+
 #if PRINT_ENCLAVE_STAT == 1
     printf("                >>>>>>>> "
            "Enclave loading time =      %10ld milliseconds\n",
@@ -574,5 +579,30 @@ int _DkGetCPUInfo (PAL_CPU_INFO * ci)
         SGX_DBG(DBG_E, "Warning: bogomips could not be retrieved, passing 0.0 to the application\n");
     }
 
+    /* CPU and NUMA topology is provided by the untrusted host and is not needed for correctness, so
+     * the enclave reports CPUs 0..cpu_num-1 as separate cores of a single package on a single
+     * node */
+    ci->cpu_numa_nodes = 1;
+    ci->cpu_id         = malloc(ci->cpu_num * sizeof(*ci->cpu_id));
+    ci->cpu_core_id    = malloc(ci->cpu_num * sizeof(*ci->cpu_core_id));
+    ci->cpu_package_id = malloc(ci->cpu_num * sizeof(*ci->cpu_package_id));
+    ci->cpu_numa_node  = malloc(ci->cpu_num * sizeof(*ci->cpu_numa_node));
+    if (!ci->cpu_id || !ci->cpu_core_id || !ci->cpu_package_id || !ci->cpu_numa_node) {
+        free(ci->cpu_id);
+        free(ci->cpu_core_id);
+        free(ci->cpu_package_id);
+        free(ci->cpu_numa_node);
+        free(vendor_id);
+        free(brand);
+        free(flags);
+        return -PAL_ERROR_NOMEM;
+    }
+    for (PAL_NUM i = 0; i < ci->cpu_num; i++) {
+        ci->cpu_id[i]         = i;
+        ci->cpu_core_id[i]    = i;
+        ci->cpu_package_id[i] = 0;
+        ci->cpu_numa_node[i]  = 0;
+    }
+
     return rv;
 }
@@ -50,6 +50,7 @@ int _DkVirtualMemoryAlloc(void** paddr, uint64_t size, int alloc_type, int prot)
         return -PAL_ERROR_INVAL;
     }
 
+    /* PAL_ALLOC_HUGEPAGE is ignored, the EPC is always managed in 4K pages */
     void* mem = get_enclave_pages(addr, size, alloc_type & PAL_ALLOC_INTERNAL);
     if (!mem)
         return addr ? -PAL_ERROR_DENIED : -PAL_ERROR_NOMEM;
@@ -86,6 +87,42 @@ int _DkVirtualMemoryProtect(void* addr, uint64_t size, int prot) {
     return 0;
 }
 
+int _DkVirtualMemoryMove(void* old_addr, void* new_addr, uint64_t size) {
+    __UNUSED(old_addr);
+    __UNUSED(new_addr);
+    __UNUSED(size);
+
+    /* EPC pages are bound to their enclave addresses, so the caller has to copy */
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkVirtualMemoryAdvise(void* addr, uint64_t size, int advice) {
+    /* EPC pages cannot be given back to the host without SGX2, so DONTNEED only has to provide
+     * the zero-fill semantics; enclave memory is always writable (see _DkVirtualMemoryProtect) */
+    if (advice == PAL_MADVISE_DONTNEED)
+        memset(addr, 0, size);
+    return 0;
+}
+
+int _DkVirtualMemoryPolicy(void* addr, uint64_t size, int mode, uint64_t nodemask, int flags) {
+    __UNUSED(addr);
+    __UNUSED(size);
+    __UNUSED(mode);
+    __UNUSED(nodemask);
+    __UNUSED(flags);
+
+    /* EPC pages are placed by the SGX driver, the enclave has no say in it */
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkVirtualMemoryNodes(uint64_t count, void** pages, const uint32_t* nodes, uint32_t* status) {
+    __UNUSED(count);
+    __UNUSED(pages);
+    __UNUSED(nodes);
+    __UNUSED(status);
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
 uint64_t _DkMemoryQuota(void) {
     return pal_sec.heap_max - pal_sec.heap_min;
 }
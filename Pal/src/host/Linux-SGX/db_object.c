@@ -144,3 +144,26 @@ out:
     free(offsets);
     return ret;
 }
+
+/* Waiting on addresses shared between enclaves would require trusting untrusted memory, so this is
+ * not supported (see also `shm_ops`). */
+/* The enclave cannot share an io_uring with the host safely, so DkStreamsBatchIo() performs the
+ * requests one by one. */
+int _DkStreamsBatchIo(PAL_IO_REQUEST* requests, size_t count) {
+    __UNUSED(requests);
+    __UNUSED(count);
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkWaitOnAddress(uint32_t* addr, uint32_t expected, int64_t timeout_us) {
+    __UNUSED(addr);
+    __UNUSED(expected);
+    __UNUSED(timeout_us);
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkWakeByAddress(uint32_t* addr, uint64_t count) {
+    __UNUSED(addr);
+    __UNUSED(count);
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
@@ -77,7 +77,7 @@ static int thread_handshake_func(void* param) {
     assert(!handle->pipe.handshake_done);
 
     int ret = _DkStreamSecureInit(handle, handle->pipe.is_server, &handle->pipe.session_key,
-                                  (LIB_SSL_CONTEXT**)&handle->pipe.ssl_ctx, NULL, 0);
+                                  (struct secure_stream**)&handle->pipe.ssl_ctx, NULL, 0);
     if (ret < 0) {
         SGX_DBG(DBG_E, "Failed to initialize secure pipe %s: %d\n", handle->pipe.name.str, ret);
         _DkProcessExit(1);
@@ -194,7 +194,7 @@ static int pipe_waitforclient(PAL_HANDLE handle, PAL_HANDLE* client) {
     }
 
     ret = _DkStreamSecureInit(clnt, clnt->pipe.is_server, &clnt->pipe.session_key,
-                              (LIB_SSL_CONTEXT**)&clnt->pipe.ssl_ctx, NULL, 0);
+                              (struct secure_stream**)&clnt->pipe.ssl_ctx, NULL, 0);
     if (ret < 0) {
         ocall_close(clnt->pipe.fd);
         free(clnt);
@@ -462,7 +462,7 @@ static int pipe_close(PAL_HANDLE handle) {
             cpu_pause();
 
         if (handle->pipe.ssl_ctx) {
-            _DkStreamSecureFree((LIB_SSL_CONTEXT*)handle->pipe.ssl_ctx);
+            _DkStreamSecureFree((struct secure_stream*)handle->pipe.ssl_ctx);
             handle->pipe.ssl_ctx = NULL;
         }
         ocall_close(handle->pipe.fd);
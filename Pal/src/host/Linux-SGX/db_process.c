@@ -274,7 +274,7 @@ int _DkProcessCreate (PAL_HANDLE * handle, const char * uri, const char ** args)
         goto failed;
 
     ret = _DkStreamSecureInit(child, /*is_server=*/true, &child->process.session_key,
-                              (LIB_SSL_CONTEXT**)&child->process.ssl_ctx, NULL, 0);
+                              (struct secure_stream**)&child->process.ssl_ctx, NULL, 0);
     if (ret < 0)
         goto failed;
 
@@ -334,7 +334,7 @@ int init_child_process (PAL_HANDLE * parent_handle)
         return ret;
 
     ret = _DkStreamSecureInit(parent, /*is_server=*/false, &parent->process.session_key,
-                              (LIB_SSL_CONTEXT**)&parent->process.ssl_ctx, NULL, 0);
+                              (struct secure_stream**)&parent->process.ssl_ctx, NULL, 0);
     if (ret < 0)
         return ret;
 
@@ -411,7 +411,7 @@ static int proc_close (PAL_HANDLE handle)
     }
 
     if (handle->process.ssl_ctx) {
-        _DkStreamSecureFree((LIB_SSL_CONTEXT*)handle->process.ssl_ctx);
+        _DkStreamSecureFree((struct secure_stream*)handle->process.ssl_ctx);
         handle->process.ssl_ctx = NULL;
     }
 
@@ -486,7 +486,7 @@ static int proc_attrsetbyhdl (PAL_HANDLE handle, PAL_STREAM_ATTR * attr)
 
     if (!attr->secure && handle->process.ssl_ctx) {
         /* remove TLS protection from process.stream */
-        _DkStreamSecureFree((LIB_SSL_CONTEXT*)handle->process.ssl_ctx);
+        _DkStreamSecureFree((struct secure_stream*)handle->process.ssl_ctx);
         handle->process.ssl_ctx = NULL;
     } else if (attr->secure && !handle->process.ssl_ctx) {
         /* adding TLS protection for process.stream is not yet implemented */
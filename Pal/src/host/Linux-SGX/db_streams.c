@@ -77,6 +77,28 @@ void _DkPrintConsole(const void* buf, int size) {
     ocall_write(2 /*stderr*/, buf, size);
 }
 
+/* Data must not bypass the enclave if it needs to be verified (trusted files) or encrypted (pipes),
+ * so only allowed files can be sent directly to host sockets. */
+int64_t _DkStreamCopy(PAL_HANDLE dst, uint64_t dst_offset, PAL_HANDLE src, uint64_t src_offset,
+                      uint64_t count) {
+    __UNUSED(dst_offset);
+
+    if (!IS_HANDLE_TYPE(src, file) || src->file.stubs)
+        return -PAL_ERROR_NOTSUPPORT;
+
+    if (!IS_HANDLE_TYPE(dst, tcp) && !IS_HANDLE_TYPE(dst, udp))
+        return -PAL_ERROR_NOTSUPPORT;
+
+    ssize_t ret = ocall_sendfile(dst->sock.fd, src->file.fd, src_offset, count);
+    if (IS_ERR(ret)) {
+        if (ERRNO(ret) == EINVAL || ERRNO(ret) == ENOSYS)
+            return -PAL_ERROR_NOTSUPPORT;
+        return unix_to_pal_error(ERRNO(ret));
+    }
+
+    return ret;
+}
+
 /* _DkStreamUnmap for internal use. Unmap stream at certain memory address.
    The memory is unmapped as a whole.*/
 int _DkStreamUnmap(void* addr, uint64_t size) {
@@ -188,7 +210,7 @@ static int handle_deserialize(PAL_HANDLE* handle, const void* data, size_t size,
             /* session key is part of handle but need to deserialize SSL context */
             hdl->pipe.fd = fds[0]; /* correct host FD must be passed to SSL context */
             ret = _DkStreamSecureInit(hdl, hdl->pipe.is_server, &hdl->pipe.session_key,
-                                      (LIB_SSL_CONTEXT**)&hdl->pipe.ssl_ctx,
+                                      (struct secure_stream**)&hdl->pipe.ssl_ctx,
                                       (const uint8_t*)hdl + hdlsz, size - hdlsz);
             if (ret < 0) {
                 free(hdl);
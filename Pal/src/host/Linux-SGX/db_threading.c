@@ -153,6 +153,45 @@ int _DkThreadResume (PAL_HANDLE threadHandle)
     return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : ret;
 }
 
+/* the host thread backing another enclave thread is not known inside the enclave, so affinity
+ * can only be forwarded to the host for the current thread */
+static bool is_current_thread(PAL_HANDLE thread) {
+    return !thread || &thread->thread == GET_ENCLAVE_TLS(thread);
+}
+
+int _DkThreadSetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask) {
+    if (!is_current_thread(thread))
+        return -PAL_ERROR_NOTIMPLEMENTED;
+
+    int ret = ocall_sched_setaffinity(cpumask_size, cpu_mask);
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : 0;
+}
+
+int _DkThreadGetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask) {
+    if (!is_current_thread(thread))
+        return -PAL_ERROR_NOTIMPLEMENTED;
+
+    int ret = ocall_sched_getaffinity(cpumask_size, cpu_mask);
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : 0;
+}
+
+int _DkThreadGetCurrentCpu(unsigned int* cpu, unsigned int* node) {
+    unsigned int host_cpu;
+    int ret = ocall_getcpu(&host_cpu, /*node=*/NULL);
+    if (IS_ERR(ret))
+        return unix_to_pal_error(ERRNO(ret));
+
+    /* the host is untrusted: sanitize the CPU ID (the enclave numbers CPUs densely from 0, see
+     * _DkGetCPUInfo); NUMA topology is hidden from the enclave */
+    if (host_cpu >= pal_control.cpu_info.cpu_num)
+        host_cpu = 0;
+    if (cpu)
+        *cpu = host_cpu;
+    if (node)
+        *node = 0;
+    return 0;
+}
+
 struct handle_ops thread_ops = {
     /* nothing */
 };
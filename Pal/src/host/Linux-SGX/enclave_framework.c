@@ -434,6 +434,8 @@ int load_trusted_file (PAL_HANDLE file, sgx_stub_t ** stubptr,
             ret = lib_SHA256Update(&sha, small_chunk, chunk_size);
             if (ret < 0)
                 goto failed;
+            __atomic_add_fetch(&__pal_control.boot_profile.counters.bytes_hashed, chunk_size,
+                               __ATOMIC_RELAXED);
 
             /* Update the checksum for the file chunk */
             ret = lib_AESCMACUpdate(&aes_cmac, small_chunk, chunk_size);
@@ -492,6 +494,9 @@ static void set_file_check_policy (int policy)
     file_check_policy = policy;
 }
 
+/* Number of file chunks checked at once by copy_and_verify_trusted_file() */
+#define CMAC_BATCH_SIZE 8
+
 /*
  * A common helper function for copying and checking the file contents
  * from a buffer mapped outside the enclaves into an in-enclave buffer.
@@ -551,14 +556,42 @@ int copy_and_verify_trusted_file (const char * path, const void * umem,
         if (checking >= offset && checking_end <= offset + size) {
             /* If the checking chunk completely overlaps with the region
              * needed for copying into the buffer, simplying use the buffer
-             * for checking */
+             * for checking. The following chunks which also completely
+             * overlap are copied and hashed together with it (much faster
+             * with AES-NI than hashing them one by one). */
+            const uint8_t* inputs[CMAC_BATCH_SIZE];
+            uint64_t input_lens[CMAC_BATCH_SIZE];
+            sgx_stub_t hashes[CMAC_BATCH_SIZE];
+            size_t count = 0;
+            uint64_t batch_end = checking;
+
+            do {
+                inputs[count]     = buffer + batch_end - offset;
+                input_lens[count] = MIN(total_size - batch_end, TRUSTED_STUB_SIZE);
+                batch_end += input_lens[count++];
+            } while (count < CMAC_BATCH_SIZE && batch_end < MIN(umem_end, total_size) &&
+                     MIN(total_size, batch_end + TRUSTED_STUB_SIZE) <= offset + size);
+
             memcpy(buffer + checking - offset, umem + checking - umem_start,
-                   checking_size);
+                   batch_end - checking);
 
-            /* Storing the checksum (using AES-CMAC) inside hash. */
-            ret = lib_AESCMAC((uint8_t*)&enclave_key, sizeof(enclave_key),
-                              buffer + checking - offset, checking_size,
-                              (uint8_t*)&hash, sizeof(hash));
+            /* Storing the checksums (using AES-CMAC) inside hashes. */
+            ret = lib_AESCMACBatch((uint8_t*)&enclave_key, sizeof(enclave_key), inputs,
+                                   input_lens, (uint8_t*)hashes, count);
+            if (ret < 0)
+                goto failed;
+
+            /* All but the last chunk are checked here, the last one below. */
+            for (size_t i = 0; i < count - 1; i++, checking += TRUSTED_STUB_SIZE, s++) {
+                if (memcmp(s, &hashes[i], sizeof(sgx_stub_t))) {
+                    SGX_DBG(DBG_E, "Accesing file:%s is denied. Does not match with MAC"
+                            " at chunk starting at %lu-%lu.\n",
+                            path, checking, checking + TRUSTED_STUB_SIZE);
+                    return -PAL_ERROR_DENIED;
+                }
+            }
+            checking_end = checking + input_lens[count - 1];
+            memcpy(&hash, &hashes[count - 1], sizeof(sgx_stub_t));
         } else {
             /* If the checking chunk only partially overlaps with the region,
              * read the file content in smaller chunks and only copy the part
@@ -1295,8 +1328,28 @@ out:
     return ret;
 }
 
+/* Protection of a pipe or process stream, chosen for all streams by `sgx.ipc_tls` (both ends of a
+ * stream read the same manifest) */
+struct secure_stream {
+    bool use_tls;
+    union {
+        LIB_SECURE_CHANNEL channel;
+        LIB_SSL_CONTEXT ssl;
+    };
+};
+
+static bool g_secure_stream_use_tls = false;
+
+int init_secure_streams(void) {
+    char cfgbuf[CONFIG_MAX];
+    ssize_t ret = get_config(pal_state.root_config, "sgx.ipc_tls", cfgbuf, sizeof(cfgbuf));
+    if (ret > 0 && cfgbuf[0] == '1')
+        g_secure_stream_use_tls = true;
+    return 0;
+}
+
 int _DkStreamSecureInit(PAL_HANDLE stream, bool is_server, PAL_SESSION_KEY* session_key,
-                        LIB_SSL_CONTEXT** out_ssl_ctx, const uint8_t* buf_load_ssl_ctx,
+                        struct secure_stream** out_ssl_ctx, const uint8_t* buf_load_ssl_ctx,
                         size_t buf_size) {
     int stream_fd;
 
@@ -1308,17 +1361,33 @@ int _DkStreamSecureInit(PAL_HANDLE stream, bool is_server, PAL_SESSION_KEY* sess
         return -PAL_ERROR_BADHANDLE;
 
 
-    LIB_SSL_CONTEXT* ssl_ctx = malloc(sizeof(*ssl_ctx));
+    struct secure_stream* ssl_ctx = malloc(sizeof(*ssl_ctx));
     if (!ssl_ctx)
         return -PAL_ERROR_NOMEM;
 
+    int ret;
+    ssl_ctx->use_tls = g_secure_stream_use_tls;
+    if (!ssl_ctx->use_tls) {
+        /* both ends exchange salts and derive per-stream keys from them and the session key */
+        ret = lib_SecureChannelInit(&ssl_ctx->channel, stream_fd, is_server,
+                                    (const uint8_t*)session_key, sizeof(*session_key),
+                                    ocall_read, ocall_write, buf_load_ssl_ctx, buf_size);
+        if (ret != 0) {
+            free(ssl_ctx);
+            return ret;
+        }
+
+        *out_ssl_ctx = ssl_ctx;
+        return 0;
+    }
+
     /* mbedTLS init routines are not thread safe, so we use a spinlock to protect them */
     static spinlock_t ssl_init_lock = INIT_SPINLOCK_UNLOCKED;
 
     spinlock_lock(&ssl_init_lock);
-    int ret = lib_SSLInit(ssl_ctx, stream_fd, is_server,
-                          (const uint8_t*)session_key, sizeof(*session_key),
-                          ocall_read, ocall_write, buf_load_ssl_ctx, buf_size);
+    ret = lib_SSLInit(&ssl_ctx->ssl, stream_fd, is_server,
+                      (const uint8_t*)session_key, sizeof(*session_key),
+                      ocall_read, ocall_write, buf_load_ssl_ctx, buf_size);
     spinlock_unlock(&ssl_init_lock);
 
     if (ret != 0) {
@@ -1328,7 +1397,7 @@ int _DkStreamSecureInit(PAL_HANDLE stream, bool is_server, PAL_SESSION_KEY* sess
 
     if (!buf_load_ssl_ctx) {
         /* TLS context was not restored from the buffer, need to perform handshake */
-        ret = lib_SSLHandshake(ssl_ctx);
+        ret = lib_SSLHandshake(&ssl_ctx->ssl);
         if (ret != 0) {
             free(ssl_ctx);
             return ret;
@@ -1339,28 +1408,42 @@ int _DkStreamSecureInit(PAL_HANDLE stream, bool is_server, PAL_SESSION_KEY* sess
     return 0;
 }
 
-int _DkStreamSecureFree(LIB_SSL_CONTEXT* ssl_ctx) {
-    lib_SSLFree(ssl_ctx);
+int _DkStreamSecureFree(struct secure_stream* ssl_ctx) {
+    if (ssl_ctx->use_tls)
+        lib_SSLFree(&ssl_ctx->ssl);
+    else
+        lib_SecureChannelFree(&ssl_ctx->channel);
     free(ssl_ctx);
     return 0;
 }
 
-int _DkStreamSecureRead(LIB_SSL_CONTEXT* ssl_ctx, uint8_t* buf, size_t len) {
-    return lib_SSLRead(ssl_ctx, buf, len);
+int _DkStreamSecureRead(struct secure_stream* ssl_ctx, uint8_t* buf, size_t len) {
+    if (ssl_ctx->use_tls)
+        return lib_SSLRead(&ssl_ctx->ssl, buf, len);
+    return lib_SecureChannelRead(&ssl_ctx->channel, buf, len);
+}
+
+int _DkStreamSecureWrite(struct secure_stream* ssl_ctx, const uint8_t* buf, size_t len) {
+    if (ssl_ctx->use_tls)
+        return lib_SSLWrite(&ssl_ctx->ssl, buf, len);
+    return lib_SecureChannelWrite(&ssl_ctx->channel, buf, len);
 }
 
-int _DkStreamSecureWrite(LIB_SSL_CONTEXT* ssl_ctx, const uint8_t* buf, size_t len) {
-    return lib_SSLWrite(ssl_ctx, buf, len);
+static int secure_stream_save(struct secure_stream* ssl_ctx, uint8_t* buf, size_t len,
+                              size_t* olen) {
+    if (ssl_ctx->use_tls)
+        return lib_SSLSave(&ssl_ctx->ssl, buf, len, olen);
+    return lib_SecureChannelSave(&ssl_ctx->channel, buf, len, olen);
 }
 
-int _DkStreamSecureSave(LIB_SSL_CONTEXT* ssl_ctx, const uint8_t** obuf, size_t* olen) {
+int _DkStreamSecureSave(struct secure_stream* ssl_ctx, const uint8_t** obuf, size_t* olen) {
     assert(obuf);
     assert(olen);
 
     int ret;
 
     /* figure out the required buffer size */
-    ret = lib_SSLSave(ssl_ctx, NULL, 0, olen);
+    ret = secure_stream_save(ssl_ctx, NULL, 0, olen);
     if (ret != 0 && ret != -PAL_ERROR_NOMEM)
         return ret;
 
@@ -1371,7 +1454,7 @@ int _DkStreamSecureSave(LIB_SSL_CONTEXT* ssl_ctx, const uint8_t** obuf, size_t*
         return -PAL_ERROR_NOMEM;
 
     /* now have buffer with sufficient size to save serialized context */
-    ret = lib_SSLSave(ssl_ctx, buf, len, olen);
+    ret = secure_stream_save(ssl_ctx, buf, len, olen);
     if (ret != 0 || len != *olen) {
         free(buf);
         return -PAL_ERROR_DENIED;
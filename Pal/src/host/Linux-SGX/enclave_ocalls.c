@@ -1420,6 +1420,122 @@ int ocall_eventfd (unsigned int initval, int flags)
     return retval;
 }
 
+/* NOTE: the affinity and getcpu ocalls must not be exitless: they operate on the host thread that
+ * executes them, which has to be the one backing the calling enclave thread */
+int ocall_sched_setaffinity(size_t cpumask_size, const void* cpu_mask) {
+    int retval = 0;
+    ms_ocall_sched_setaffinity_t* ms;
+
+    void* old_ustack = sgx_prepare_ustack();
+    ms = sgx_alloc_on_ustack_aligned(sizeof(*ms), alignof(*ms));
+    if (!ms) {
+        sgx_reset_ustack(old_ustack);
+        return -EPERM;
+    }
+
+    void* untrusted_mask = sgx_copy_to_ustack(cpu_mask, cpumask_size);
+    if (!untrusted_mask) {
+        sgx_reset_ustack(old_ustack);
+        return -EPERM;
+    }
+
+    WRITE_ONCE(ms->ms_cpumask_size, cpumask_size);
+    WRITE_ONCE(ms->ms_cpu_mask, untrusted_mask);
+
+    retval = sgx_ocall(OCALL_SCHED_SETAFFINITY, ms);
+
+    sgx_reset_ustack(old_ustack);
+    return retval;
+}
+
+int ocall_sched_getaffinity(size_t cpumask_size, void* cpu_mask) {
+    int retval = 0;
+    ms_ocall_sched_getaffinity_t* ms;
+
+    void* old_ustack = sgx_prepare_ustack();
+    ms = sgx_alloc_on_ustack_aligned(sizeof(*ms), alignof(*ms));
+    if (!ms) {
+        sgx_reset_ustack(old_ustack);
+        return -EPERM;
+    }
+
+    void* untrusted_mask = sgx_alloc_on_ustack(cpumask_size);
+    if (!untrusted_mask) {
+        sgx_reset_ustack(old_ustack);
+        return -EPERM;
+    }
+
+    WRITE_ONCE(ms->ms_cpumask_size, cpumask_size);
+    WRITE_ONCE(ms->ms_cpu_mask, untrusted_mask);
+
+    retval = sgx_ocall(OCALL_SCHED_GETAFFINITY, ms);
+
+    if (retval > 0) {
+        if ((size_t)retval > cpumask_size) {
+            retval = -EPERM;
+            goto out;
+        }
+        memset(cpu_mask, 0, cpumask_size);
+        if (!sgx_copy_to_enclave(cpu_mask, cpumask_size, READ_ONCE(ms->ms_cpu_mask), retval)) {
+            retval = -EPERM;
+            goto out;
+        }
+    }
+
+out:
+    sgx_reset_ustack(old_ustack);
+    return retval;
+}
+
+int ocall_getcpu(unsigned int* cpu, unsigned int* node) {
+    int retval = 0;
+    ms_ocall_getcpu_t* ms;
+
+    void* old_ustack = sgx_prepare_ustack();
+    ms = sgx_alloc_on_ustack_aligned(sizeof(*ms), alignof(*ms));
+    if (!ms) {
+        sgx_reset_ustack(old_ustack);
+        return -EPERM;
+    }
+
+    retval = sgx_ocall(OCALL_GETCPU, ms);
+
+    if (!retval) {
+        if (cpu)
+            *cpu = READ_ONCE(ms->ms_cpu);
+        if (node)
+            *node = READ_ONCE(ms->ms_node);
+    }
+
+    sgx_reset_ustack(old_ustack);
+    return retval;
+}
+
+ssize_t ocall_sendfile(int out_fd, int in_fd, off_t offset, size_t count) {
+    ssize_t retval = 0;
+    ms_ocall_sendfile_t* ms;
+
+    void* old_ustack = sgx_prepare_ustack();
+    ms = sgx_alloc_on_ustack_aligned(sizeof(*ms), alignof(*ms));
+    if (!ms) {
+        sgx_reset_ustack(old_ustack);
+        return -EPERM;
+    }
+
+    WRITE_ONCE(ms->ms_out_fd, out_fd);
+    WRITE_ONCE(ms->ms_in_fd, in_fd);
+    WRITE_ONCE(ms->ms_offset, offset);
+    WRITE_ONCE(ms->ms_count, count);
+
+    retval = sgx_exitless_ocall(OCALL_SENDFILE, ms);
+
+    if (retval > 0 && (size_t)retval > count)
+        retval = -EPERM;
+
+    sgx_reset_ustack(old_ustack);
+    return retval;
+}
+
 int ocall_get_quote(const sgx_spid_t* spid, bool linkable, const sgx_report_t* report,
                     const sgx_quote_nonce_t* nonce, char** quote, size_t* quote_len) {
     int retval;
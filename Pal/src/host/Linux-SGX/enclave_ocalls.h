@@ -91,6 +91,15 @@ int ocall_load_debug (const char * command);
 
 int ocall_eventfd (unsigned int initval, int flags);
 
+/* affinity and current CPU can only be queried/changed for the calling thread */
+int ocall_sched_setaffinity(size_t cpumask_size, const void* cpu_mask);
+
+int ocall_sched_getaffinity(size_t cpumask_size, void* cpu_mask);
+
+int ocall_getcpu(unsigned int* cpu, unsigned int* node);
+
+ssize_t ocall_sendfile(int out_fd, int in_fd, off_t offset, size_t count);
+
 /*!
  * \brief Execute untrusted code in PAL to obtain a quote from the Quoting Enclave.
  *
@@ -59,6 +59,10 @@ enum {
     OCALL_LOAD_DEBUG,
     OCALL_EVENTFD,
     OCALL_GET_QUOTE,
+    OCALL_SCHED_SETAFFINITY,
+    OCALL_SCHED_GETAFFINITY,
+    OCALL_GETCPU,
+    OCALL_SENDFILE,
     OCALL_NR,
 };
 
@@ -279,4 +283,26 @@ typedef struct {
     size_t            ms_quote_len;
 } ms_ocall_get_quote_t;
 
+typedef struct {
+    size_t ms_cpumask_size;
+    void*  ms_cpu_mask;
+} ms_ocall_sched_setaffinity_t;
+
+typedef struct {
+    size_t ms_cpumask_size;
+    void*  ms_cpu_mask;
+} ms_ocall_sched_getaffinity_t;
+
+typedef struct {
+    unsigned int ms_cpu;
+    unsigned int ms_node;
+} ms_ocall_getcpu_t;
+
+typedef struct {
+    int ms_out_fd;
+    int ms_in_fd;
+    off_t ms_offset;
+    size_t ms_count;
+} ms_ocall_sendfile_t;
+
 #pragma pack(pop)
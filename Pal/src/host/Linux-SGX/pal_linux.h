@@ -198,13 +198,17 @@ int _DkStreamReportRequest(PAL_HANDLE stream, sgx_sign_data_t* data,
 int _DkStreamReportRespond(PAL_HANDLE stream, sgx_sign_data_t* data,
                            check_mr_enclave_t check_mr_enclave);
 
+/* Secure streams use the lightweight AES-GCM channel (LIB_SECURE_CHANNEL), or TLS if the manifest
+ * sets `sgx.ipc_tls = 1` */
+struct secure_stream;
+int init_secure_streams(void);
 int _DkStreamSecureInit(PAL_HANDLE stream, bool is_server, PAL_SESSION_KEY* session_key,
-                        LIB_SSL_CONTEXT** out_ssl_ctx, const uint8_t* buf_load_ssl_ctx,
+                        struct secure_stream** out_ssl_ctx, const uint8_t* buf_load_ssl_ctx,
                         size_t buf_size);
-int _DkStreamSecureFree(LIB_SSL_CONTEXT* ssl_ctx);
-int _DkStreamSecureRead(LIB_SSL_CONTEXT* ssl_ctx, uint8_t* buf, size_t len);
-int _DkStreamSecureWrite(LIB_SSL_CONTEXT* ssl_ctx, const uint8_t* buf, size_t len);
-int _DkStreamSecureSave(LIB_SSL_CONTEXT* ssl_ctx, const uint8_t** obuf, size_t* olen);
+int _DkStreamSecureFree(struct secure_stream* ssl_ctx);
+int _DkStreamSecureRead(struct secure_stream* ssl_ctx, uint8_t* buf, size_t len);
+int _DkStreamSecureWrite(struct secure_stream* ssl_ctx, const uint8_t* buf, size_t len);
+int _DkStreamSecureSave(struct secure_stream* ssl_ctx, const uint8_t** obuf, size_t* olen);
 
 #include "sgx_arch.h"
 
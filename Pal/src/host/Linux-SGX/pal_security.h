@@ -43,9 +43,8 @@ struct pal_sec {
     PAL_BOL         in_gdb;
 #endif
 
-#if PRINT_ENCLAVE_STAT == 1
+    /* time when the untrusted loader was started, used by the boot profiler */
     PAL_NUM         start_time;
-#endif
 };
 
 #ifdef IN_ENCLAVE
@@ -649,6 +649,30 @@ static long sgx_ocall_eventfd (void * pms)
     return ret;
 }
 
+static long sgx_ocall_sched_setaffinity(void* pms) {
+    ms_ocall_sched_setaffinity_t* ms = (ms_ocall_sched_setaffinity_t*)pms;
+    ODEBUG(OCALL_SCHED_SETAFFINITY, ms);
+    return INLINE_SYSCALL(sched_setaffinity, 3, 0, ms->ms_cpumask_size, ms->ms_cpu_mask);
+}
+
+static long sgx_ocall_sched_getaffinity(void* pms) {
+    ms_ocall_sched_getaffinity_t* ms = (ms_ocall_sched_getaffinity_t*)pms;
+    ODEBUG(OCALL_SCHED_GETAFFINITY, ms);
+    return INLINE_SYSCALL(sched_getaffinity, 3, 0, ms->ms_cpumask_size, ms->ms_cpu_mask);
+}
+
+static long sgx_ocall_getcpu(void* pms) {
+    ms_ocall_getcpu_t* ms = (ms_ocall_getcpu_t*)pms;
+    ODEBUG(OCALL_GETCPU, ms);
+    return INLINE_SYSCALL(getcpu, 3, &ms->ms_cpu, &ms->ms_node, NULL);
+}
+
+static long sgx_ocall_sendfile(void* pms) {
+    ms_ocall_sendfile_t* ms = (ms_ocall_sendfile_t*)pms;
+    ODEBUG(OCALL_SENDFILE, ms);
+    return INLINE_SYSCALL(sendfile, 4, ms->ms_out_fd, ms->ms_in_fd, &ms->ms_offset, ms->ms_count);
+}
+
 static long sgx_ocall_load_debug(void * pms)
 {
     const char * command = (const char *) pms;
@@ -703,6 +727,10 @@ sgx_ocall_fn_t ocall_table[OCALL_NR] = {
         [OCALL_LOAD_DEBUG]       = sgx_ocall_load_debug,
         [OCALL_EVENTFD]          = sgx_ocall_eventfd,
         [OCALL_GET_QUOTE]        = sgx_ocall_get_quote,
+        [OCALL_SCHED_SETAFFINITY] = sgx_ocall_sched_setaffinity,
+        [OCALL_SCHED_GETAFFINITY] = sgx_ocall_sched_getaffinity,
+        [OCALL_GETCPU]           = sgx_ocall_getcpu,
+        [OCALL_SENDFILE]         = sgx_ocall_sendfile,
     };
 
 #define EDEBUG(code, ms) do {} while (0)
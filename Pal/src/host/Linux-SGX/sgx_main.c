@@ -755,11 +755,9 @@ static int load_enclave (struct pal_enclave * enclave,
     struct pal_sec * pal_sec = &enclave->pal_sec;
     int ret;
 
-#if PRINT_ENCLAVE_STAT == 1
     struct timeval tv;
     INLINE_SYSCALL(gettimeofday, 2, &tv, NULL);
     pal_sec->start_time = tv.tv_sec * 1000000UL + tv.tv_usec;
-#endif
 
     ret = open_gsgx();
     if (ret < 0)
@@ -23,7 +23,11 @@
 typedef __kernel_pid_t pid_t;
 #undef __GLIBC__
 #include <linux/stat.h>
+#include <linux/falloc.h>
+#include <linux/fadvise.h>
+#include <linux/fs.h>
 #include <asm/errno.h>
+#include <asm/fcntl.h>
 
 /* 'open' operation for file streams */
 static int file_open(PAL_HANDLE* handle, const char* type, const char* uri, int access, int share,
@@ -173,6 +177,153 @@ static int file_flush (PAL_HANDLE handle)
     return 0;
 }
 
+/* 'allocate' operation for file stream. */
+static int file_allocate(PAL_HANDLE handle, uint64_t offset, uint64_t length, int mode) {
+    int linux_mode = 0;
+    if (mode & PAL_FALLOC_KEEP_SIZE)
+        linux_mode |= FALLOC_FL_KEEP_SIZE;
+    if (mode & PAL_FALLOC_PUNCH_HOLE)
+        linux_mode |= FALLOC_FL_PUNCH_HOLE;
+    if (mode & PAL_FALLOC_ZERO_RANGE)
+        linux_mode |= FALLOC_FL_ZERO_RANGE;
+
+    int ret = INLINE_SYSCALL(fallocate, 4, handle->file.fd, linux_mode, offset, length);
+
+    if (IS_ERR(ret)) {
+        switch (ERRNO(ret)) {
+            case EOPNOTSUPP:
+            case ENODEV:
+            case ESPIPE:
+                /* host file system cannot allocate (or punch holes) */
+                return -PAL_ERROR_NOTSUPPORT;
+            case ENOSPC:
+            case EDQUOT:
+            case EFBIG:
+                return -PAL_ERROR_NOMEM;
+            default:
+                return unix_to_pal_error(ERRNO(ret));
+        }
+    }
+
+    return 0;
+}
+
+static const int g_linux_fadvise[] = {
+    [PAL_FADVISE_NORMAL]     = POSIX_FADV_NORMAL,
+    [PAL_FADVISE_RANDOM]     = POSIX_FADV_RANDOM,
+    [PAL_FADVISE_SEQUENTIAL] = POSIX_FADV_SEQUENTIAL,
+    [PAL_FADVISE_WILLNEED]   = POSIX_FADV_WILLNEED,
+    [PAL_FADVISE_DONTNEED]   = POSIX_FADV_DONTNEED,
+    [PAL_FADVISE_NOREUSE]    = POSIX_FADV_NOREUSE,
+};
+
+/* 'advise' operation for file stream. Advice is only a hint, so only a bad
+   handle is reported. */
+static int file_advise(PAL_HANDLE handle, uint64_t offset, uint64_t length, int advice) {
+    int ret = INLINE_SYSCALL(fadvise64, 4, handle->file.fd, offset, length,
+                             g_linux_fadvise[advice]);
+
+    if (IS_ERR(ret) && ERRNO(ret) == EBADF)
+        return -PAL_ERROR_BADHANDLE;
+
+    return 0;
+}
+
+/* 'flushrange' operation for file stream. */
+static int file_flushrange(PAL_HANDLE handle, uint64_t offset, uint64_t length, int flags) {
+    int linux_flags = 0;
+    if (flags & PAL_FLUSH_RANGE_WAIT_BEFORE)
+        linux_flags |= SYNC_FILE_RANGE_WAIT_BEFORE;
+    if (flags & PAL_FLUSH_RANGE_WRITE)
+        linux_flags |= SYNC_FILE_RANGE_WRITE;
+    if (flags & PAL_FLUSH_RANGE_WAIT_AFTER)
+        linux_flags |= SYNC_FILE_RANGE_WAIT_AFTER;
+
+    int ret = INLINE_SYSCALL(sync_file_range, 4, handle->file.fd, offset, length, linux_flags);
+
+    if (IS_ERR(ret)) {
+        /* sync_file_range() is not supported by every host file system */
+        if ((ERRNO(ret) == ENOSYS || ERRNO(ret) == EOPNOTSUPP) && flags)
+            return file_flush(handle);
+        return (ERRNO(ret) == EBADF || ERRNO(ret) == ESPIPE) ?
+               -PAL_ERROR_BADHANDLE : unix_to_pal_error(ERRNO(ret));
+    }
+
+    return 0;
+}
+
+static const short g_linux_lock_type[] = {
+    [PAL_LOCK_UNLOCK]    = F_UNLCK,
+    [PAL_LOCK_SHARED]    = F_RDLCK,
+    [PAL_LOCK_EXCLUSIVE] = F_WRLCK,
+};
+
+static int file_lock_error(int err) {
+    switch (err) {
+        case EAGAIN:
+        case EACCES:
+            return -PAL_ERROR_TRYAGAIN;
+        case EBADF:
+            /* the file is not open for reading (shared locks) or writing (exclusive locks) */
+            return -PAL_ERROR_DENIED;
+        case EINVAL:
+            /* open file description locks are only supported since Linux 3.15 */
+            return -PAL_ERROR_NOTIMPLEMENTED;
+        case ENOLCK:
+            return -PAL_ERROR_NOMEM;
+        default:
+            return unix_to_pal_error(err);
+    }
+}
+
+/* 'lock' operation for file stream. Range locks are open file description locks, so they belong
+   to this handle and not to the process; whole-stream locks are flock() locks. */
+static int file_lock(PAL_HANDLE handle, int type, uint64_t offset, uint64_t length, int flags) {
+    int ret;
+
+    if (flags & PAL_LOCK_WHOLE) {
+        int op = type == PAL_LOCK_UNLOCK ? LOCK_UN : type == PAL_LOCK_SHARED ? LOCK_SH : LOCK_EX;
+        if (!(flags & PAL_LOCK_WAIT))
+            op |= LOCK_NB;
+        ret = INLINE_SYSCALL(flock, 2, handle->file.fd, op);
+    } else {
+        struct flock fl = {
+            .l_type   = g_linux_lock_type[type],
+            .l_whence = SEEK_SET,
+            .l_start  = offset,
+            .l_len    = length,
+        };
+        ret = INLINE_SYSCALL(fcntl, 3, handle->file.fd,
+                             flags & PAL_LOCK_WAIT ? F_OFD_SETLKW : F_OFD_SETLK, &fl);
+    }
+
+    return IS_ERR(ret) ? file_lock_error(ERRNO(ret)) : 0;
+}
+
+/* 'lockquery' operation for file stream. */
+static int file_lockquery(PAL_HANDLE handle, int* type, uint64_t* offset, uint64_t* length) {
+    struct flock fl = {
+        .l_type   = g_linux_lock_type[*type],
+        .l_whence = SEEK_SET,
+        .l_start  = *offset,
+        .l_len    = *length,
+    };
+
+    int ret = INLINE_SYSCALL(fcntl, 3, handle->file.fd, F_OFD_GETLK, &fl);
+    if (IS_ERR(ret))
+        return file_lock_error(ERRNO(ret));
+
+    if (fl.l_type == F_UNLCK) {
+        *type = PAL_LOCK_UNLOCK;
+        return 0;
+    }
+
+    *type   = fl.l_type == F_RDLCK ? PAL_LOCK_SHARED : PAL_LOCK_EXCLUSIVE;
+    *offset = fl.l_start;
+    *length = fl.l_len;
+    return 0;
+}
+
 static inline int file_stat_type (struct stat * stat)
 {
     if (S_ISREG(stat->st_mode))
@@ -307,12 +458,43 @@ struct handle_ops file_ops = {
         .map                = &file_map,
         .setlength          = &file_setlength,
         .flush              = &file_flush,
+        .allocate           = &file_allocate,
+        .advise             = &file_advise,
+        .flushrange         = &file_flushrange,
+        .lock               = &file_lock,
+        .lockquery          = &file_lockquery,
         .attrquery          = &file_attrquery,
         .attrquerybyhdl     = &file_attrquerybyhdl,
         .attrsetbyhdl       = &file_attrsetbyhdl,
         .rename             = &file_rename,
     };
 
+#define SHM_DIR "/dev/shm/"
+
+/* 'open' operation for named shared-memory objects. The object is backed by a file in the host's
+ * tmpfs, so the returned handle is a regular file handle: mapping it without PAL_PROT_WRITECOPY
+ * yields memory shared with every other process that opened the same name, and
+ * DkStreamSetLength/DkStreamDelete work as for files. */
+static int shm_open(PAL_HANDLE* handle, const char* type, const char* uri, int access, int share,
+                    int create, int options) {
+    if (strcmp_static(type, URI_TYPE_SHM))
+        return -PAL_ERROR_INVAL;
+
+    size_t name_len = strlen(uri);
+    if (!name_len || strchr(uri, '/'))
+        return -PAL_ERROR_INVAL;
+
+    char path[static_strlen(SHM_DIR) + name_len + 1];
+    memcpy(path, SHM_DIR, static_strlen(SHM_DIR));
+    memcpy(path + static_strlen(SHM_DIR), uri, name_len + 1);
+
+    return file_open(handle, URI_TYPE_FILE, path, access, share, create, options);
+}
+
+struct handle_ops shm_ops = {
+        .open               = &shm_open,
+    };
+
 /* 'open' operation for directory stream. Directory stream does not have a
    specific type prefix, its URI looks the same file streams, plus it
    ended with slashes. dir_open will be called by file_open. */
@@ -334,6 +334,41 @@ static char * cpu_flags[]
           "pbe",    // "pending break event"
         };
 
+/*
+ * Parses a CPU list in the sysfs format (e.g. "1,3-5,6") and returns the number of CPUs in it. If
+ * `cpus` is not NULL, stores the first `max_cpus` listed CPU IDs in it (in the listed order).
+ */
+static int parse_cpu_list(const char* buf, PAL_IDX* cpus, size_t max_cpus) {
+    char* end;
+    const char* ptr = buf;
+    int cpu_count = 0;
+    while (*ptr) {
+        while (*ptr == ' ' || *ptr == '\t' || *ptr == ',')
+            ptr++;
+
+        int firstint = (int)strtol(ptr, &end, 10);
+        if (ptr == end)
+            break;
+
+        int secondint = firstint;
+        if (*end == '-') {
+            /* CPU range, e.g. 0-7 or 8-16 (inclusive) */
+            ptr = end + 1;
+            secondint = (int)strtol(ptr, &end, 10);
+        } else if (*end != '\0' && *end != ',' && *end != '\n') {
+            break;
+        }
+
+        for (int cpu = firstint; cpu <= secondint; cpu++) {
+            if (cpus && (size_t)cpu_count < max_cpus)
+                cpus[cpu_count] = cpu;
+            cpu_count++;
+        }
+        ptr = end;
+    }
+    return cpu_count;
+}
+
 /*
  * Returns the number of online CPUs read from /sys/devices/system/cpu/online, -errno on failure.
  * Understands complex formats like "1,3-5,6".
@@ -352,30 +387,7 @@ static int get_cpu_count(void) {
 
     buf[ret] = '\0'; /* ensure null-terminated buf even in partial read */
 
-    char* end;
-    char* ptr = buf;
-    int cpu_count = 0;
-    while (*ptr) {
-        while (*ptr == ' ' || *ptr == '\t' || *ptr == ',')
-            ptr++;
-
-        int firstint = (int)strtol(ptr, &end, 10);
-        if (ptr == end)
-            break;
-
-        if (*end == '\0' || *end == ',' || *end == '\n') {
-            /* single CPU index, count as one more CPU */
-            cpu_count++;
-        } else if (*end == '-') {
-            /* CPU range, count how many CPUs in range */
-            ptr = end + 1;
-            int secondint = (int)strtol(ptr, &end, 10);
-            if (secondint > firstint)
-                cpu_count += secondint - firstint + 1; // inclusive (e.g., 0-7, or 8-16)
-        }
-        ptr = end;
-    }
-
+    int cpu_count = parse_cpu_list(buf, /*cpus=*/NULL, 0);
     if (cpu_count == 0)
         return -PAL_ERROR_STREAMNOTEXIST;
     return cpu_count;
@@ -406,6 +418,127 @@ static double get_bogomips(void) {
     return sanitize_bogomips_value(get_bogomips_from_cpuinfo_buf(buf));
 }
 
+static PAL_IDX read_topology_id(const char* filename, PAL_IDX default_id) {
+    char buf[32];
+    ssize_t len = read_file_buffer(filename, buf, sizeof(buf) - 1);
+    if (len <= 0)
+        return default_id;
+    buf[len] = '\0';
+
+    char* end;
+    long id = strtol(buf, &end, 10);
+    if (end == buf || id < 0)
+        return default_id;
+    return id;
+}
+
+/* Returns the index of host CPU `id` in `ci->cpu_id`, or -1 if it is not online. */
+static int find_cpu_index(const PAL_CPU_INFO* ci, PAL_IDX id) {
+    for (PAL_NUM i = 0; i < ci->cpu_num; i++)
+        if (ci->cpu_id[i] == id)
+            return i;
+    return -1;
+}
+
+#define CPU_LIST_BUF_SIZE 1024
+#define MAX_NUMA_NODES    1024
+
+/*
+ * Fills per-CPU topology in `ci`: host IDs of online CPUs (which may be sparse, e.g. "0-3,8-11"
+ * when some CPUs are offline), their core and package IDs from
+ * /sys/devices/system/cpu/cpu<N>/topology, and their NUMA nodes from
+ * /sys/devices/system/node/node<N>/cpulist. Hosts without NUMA support (or without this sysfs
+ * directory) are reported as a single node with all CPUs on it. Node IDs may be sparse too, so IDs
+ * are probed until all online nodes are found.
+ */
+static int get_cpu_topology(PAL_CPU_INFO* ci) {
+    int ret;
+    char* buf = malloc(CPU_LIST_BUF_SIZE);
+    PAL_IDX* cpu_id = malloc(ci->cpu_num * sizeof(*cpu_id));
+    PAL_IDX* core_id = malloc(ci->cpu_num * sizeof(*core_id));
+    PAL_IDX* package_id = malloc(ci->cpu_num * sizeof(*package_id));
+    PAL_IDX* cpu_node = malloc(ci->cpu_num * sizeof(*cpu_node));
+    PAL_IDX* node_cpus = malloc(ci->cpu_num * sizeof(*node_cpus));
+    if (!buf || !cpu_id || !core_id || !package_id || !cpu_node || !node_cpus) {
+        ret = -PAL_ERROR_NOMEM;
+        goto fail;
+    }
+
+    ssize_t len = read_file_buffer("/sys/devices/system/cpu/online", buf, CPU_LIST_BUF_SIZE - 1);
+    if (len <= 0) {
+        ret = len < 0 ? unix_to_pal_error(ERRNO(len)) : -PAL_ERROR_STREAMNOTEXIST;
+        goto fail;
+    }
+    buf[len] = '\0';
+
+    int online_cpus = parse_cpu_list(buf, cpu_id, ci->cpu_num);
+    if ((PAL_NUM)online_cpus < ci->cpu_num) {
+        /* CPUs went offline since we counted them */
+        ci->cpu_num = online_cpus;
+    }
+    if (!ci->cpu_num) {
+        ret = -PAL_ERROR_STREAMNOTEXIST;
+        goto fail;
+    }
+    ci->cpu_id = cpu_id;
+
+    for (PAL_NUM i = 0; i < ci->cpu_num; i++) {
+        char filename[96];
+        snprintf(filename, sizeof(filename),
+                 "/sys/devices/system/cpu/cpu%u/topology/core_id", cpu_id[i]);
+        core_id[i] = read_topology_id(filename, cpu_id[i]);
+        snprintf(filename, sizeof(filename),
+                 "/sys/devices/system/cpu/cpu%u/topology/physical_package_id", cpu_id[i]);
+        package_id[i] = read_topology_id(filename, 0);
+        cpu_node[i] = 0;
+    }
+
+    int online_nodes = 0;
+    len = read_file_buffer("/sys/devices/system/node/online", buf, CPU_LIST_BUF_SIZE - 1);
+    if (len > 0) {
+        buf[len] = '\0';
+        online_nodes = parse_cpu_list(buf, /*cpus=*/NULL, 0);
+    }
+
+    PAL_NUM nodes = 0;
+    for (int node = 0, found = 0; node < MAX_NUMA_NODES && found < online_nodes; node++) {
+        char filename[64];
+        snprintf(filename, sizeof(filename), "/sys/devices/system/node/node%d/cpulist", node);
+
+        len = read_file_buffer(filename, buf, CPU_LIST_BUF_SIZE - 1);
+        if (len < 0)
+            continue;
+        buf[len] = '\0';
+
+        int count = MIN(parse_cpu_list(buf, node_cpus, ci->cpu_num), (int)ci->cpu_num);
+        for (int i = 0; i < count; i++) {
+            int idx = find_cpu_index(ci, node_cpus[i]);
+            if (idx >= 0)
+                cpu_node[idx] = node;
+        }
+        nodes = node + 1;
+        found++;
+    }
+
+    ci->cpu_core_id    = core_id;
+    ci->cpu_package_id = package_id;
+    ci->cpu_numa_nodes = nodes ?: 1;
+    ci->cpu_numa_node  = cpu_node;
+    free(node_cpus);
+    free(buf);
+    return 0;
+
+fail:
+    ci->cpu_id = NULL;
+    free(cpu_id);
+    free(core_id);
+    free(package_id);
+    free(cpu_node);
+    free(node_cpus);
+    free(buf);
+    return ret;
+}
+
 int _DkGetCPUInfo (PAL_CPU_INFO * ci)
 {
     unsigned int words[PAL_CPUID_WORD_NUM];
@@ -483,5 +616,13 @@ int _DkGetCPUInfo (PAL_CPU_INFO * ci)
         printf("Warning: bogomips could not be retrieved, passing 0.0 to the application\n");
     }
 
+    rv = get_cpu_topology(ci);
+    if (rv < 0) {
+        free(vendor_id);
+        free(brand);
+        free(flags);
+        return rv;
+    }
+
     return rv;
 }
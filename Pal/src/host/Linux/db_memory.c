@@ -19,6 +19,8 @@
 
 #include <asm/fcntl.h>
 #include <asm/mman.h>
+#include <linux/mempolicy.h>
+#include <linux/mman.h>
 
 bool _DkCheckMemoryMappable(const void* addr, size_t size) {
     return (addr < DATA_END && addr + size > TEXT_START);
@@ -40,6 +42,12 @@ int _DkVirtualMemoryAlloc(void** paddr, size_t size, int alloc_type, int prot) {
     if (IS_ERR_P(mem))
         return unix_to_pal_error(ERRNO_P(mem));
 
+    if (alloc_type & PAL_ALLOC_HUGEPAGE) {
+        /* transparent huge pages rather than MAP_HUGETLB: the latter needs a pool reserved on the
+         * host and cannot be freed or protected in 4K parts; failure only means no THP on host */
+        INLINE_SYSCALL(madvise, 3, mem, size, MADV_HUGEPAGE);
+    }
+
     *paddr = mem;
     return 0;
 }
@@ -56,6 +64,103 @@ int _DkVirtualMemoryProtect(void* addr, size_t size, int prot) {
     return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : 0;
 }
 
+int _DkVirtualMemoryMove(void* old_addr, void* new_addr, size_t size) {
+    /* the host moves the page table entries, the contents are not copied */
+    void* ret = (void*)INLINE_SYSCALL(mremap, 5, old_addr, size, size,
+                                      MREMAP_MAYMOVE | MREMAP_FIXED, new_addr);
+    if (IS_ERR_P(ret))
+        return unix_to_pal_error(ERRNO_P(ret));
+
+    assert(ret == new_addr);
+    return 0;
+}
+
+static const int g_linux_madvise[] = {
+    [PAL_MADVISE_NORMAL]     = MADV_NORMAL,
+    [PAL_MADVISE_RANDOM]     = MADV_RANDOM,
+    [PAL_MADVISE_SEQUENTIAL] = MADV_SEQUENTIAL,
+    [PAL_MADVISE_WILLNEED]   = MADV_WILLNEED,
+    [PAL_MADVISE_DONTNEED]   = MADV_DONTNEED,
+    [PAL_MADVISE_FREE]       = MADV_FREE,
+    [PAL_MADVISE_HUGEPAGE]   = MADV_HUGEPAGE,
+    [PAL_MADVISE_NOHUGEPAGE] = MADV_NOHUGEPAGE,
+};
+
+int _DkVirtualMemoryAdvise(void* addr, size_t size, int advice) {
+    int ret = INLINE_SYSCALL(madvise, 3, addr, size, g_linux_madvise[advice]);
+    if (!IS_ERR(ret))
+        return 0;
+
+    /* MADV_FREE is supported since Linux 4.5, THP advice only if the host kernel has THP */
+    if (advice != PAL_MADVISE_DONTNEED && ERRNO(ret) == EINVAL) {
+        if (advice == PAL_MADVISE_FREE)
+            return _DkVirtualMemoryAdvise(addr, size, PAL_MADVISE_DONTNEED);
+        return 0;
+    }
+    return unix_to_pal_error(ERRNO(ret));
+}
+
+static const int g_linux_mpol[] = {
+    [PAL_MPOL_DEFAULT]    = MPOL_DEFAULT,
+    [PAL_MPOL_PREFERRED]  = MPOL_PREFERRED,
+    [PAL_MPOL_BIND]       = MPOL_BIND,
+    [PAL_MPOL_INTERLEAVE] = MPOL_INTERLEAVE,
+    [PAL_MPOL_LOCAL]      = MPOL_LOCAL,
+};
+
+int _DkVirtualMemoryPolicy(void* addr, size_t size, int mode, uint64_t nodemask, int flags) {
+    /* the host reads `maxnode` - 1 bits of the mask */
+    unsigned long mask = nodemask;
+    unsigned long maxnode = nodemask ? sizeof(mask) * 8 + 1 : 0;
+    unsigned long* maskp = nodemask ? &mask : NULL;
+
+    int ret;
+    if (addr) {
+        ret = INLINE_SYSCALL(mbind, 6, addr, size, g_linux_mpol[mode], maskp, maxnode,
+                             (flags & PAL_MPOL_MOVE) ? MPOL_MF_MOVE : 0);
+    } else {
+        ret = INLINE_SYSCALL(set_mempolicy, 3, g_linux_mpol[mode], maskp, maxnode);
+    }
+
+    if (IS_ERR(ret)) {
+        /* hosts without CONFIG_NUMA have all memory on node 0, which the caller already checked */
+        if (ERRNO(ret) == ENOSYS)
+            return 0;
+        /* container seccomp profiles commonly deny the NUMA syscalls */
+        if (ERRNO(ret) == EPERM)
+            return -PAL_ERROR_NOTIMPLEMENTED;
+        return unix_to_pal_error(ERRNO(ret));
+    }
+    return 0;
+}
+
+int _DkVirtualMemoryNodes(size_t count, void** pages, const uint32_t* nodes, uint32_t* status) {
+    /* a move_pages() of the host process itself, with the same int-sized node numbers */
+    int ret = INLINE_SYSCALL(move_pages, 6, 0, count, pages, nodes, status,
+                             nodes ? MPOL_MF_MOVE : 0);
+    if (IS_ERR(ret)) {
+        if (ERRNO(ret) == EPERM)
+            return -PAL_ERROR_NOTIMPLEMENTED;
+        if (ERRNO(ret) != ENOSYS)
+            return unix_to_pal_error(ERRNO(ret));
+
+        /* no CONFIG_NUMA on the host: there is only node 0 */
+        for (size_t i = 0; i < count; i++) {
+            if (nodes && nodes[i])
+                return -PAL_ERROR_INVAL;
+            status[i] = 0;
+        }
+        return 0;
+    }
+
+    /* pages which were never touched (or failed to move) have a negated errno as their status */
+    for (size_t i = 0; i < count; i++) {
+        if ((int)status[i] < 0)
+            status[i] = PAL_IDX_POISON;
+    }
+    return 0;
+}
+
 static int read_proc_meminfo (const char * key, unsigned long * val)
 {
     int fd = INLINE_SYSCALL(open, 3, "/proc/meminfo", O_RDONLY, 0);
@@ -8,6 +8,8 @@
  */
 
 #include <asm/errno.h>
+#include <limits.h>
+#include <linux/futex.h>
 #include <linux/poll.h>
 #include <linux/time.h>
 #include <linux/wait.h>
@@ -153,3 +155,33 @@ out:
     free(offsets);
     return ret;
 }
+
+/* Sleep on the (possibly inter-process) futex at `addr`. Unlike the futexes backing PAL mutexes,
+ * these must not be FUTEX_PRIVATE_FLAG, as `addr` may be in memory shared with other processes.
+ * Returns 0 if woken up or if the value changed before going to sleep. */
+int _DkWaitOnAddress(uint32_t* addr, uint32_t expected, int64_t timeout_us) {
+    struct timespec waittime, *waittimep = NULL;
+    if (timeout_us >= 0) {
+        int64_t sec      = timeout_us / 1000000;
+        int64_t microsec = timeout_us - (sec * 1000000);
+        waittime.tv_sec  = sec;
+        waittime.tv_nsec = microsec * 1000;
+        waittimep        = &waittime;
+    }
+
+    int ret = INLINE_SYSCALL(futex, 6, addr, FUTEX_WAIT, expected, waittimep, NULL, 0);
+    if (IS_ERR(ret)) {
+        if (ERRNO(ret) == EWOULDBLOCK)
+            return 0;
+        if (ERRNO(ret) == ETIMEDOUT)
+            return -PAL_ERROR_TRYAGAIN;
+        return unix_to_pal_error(ERRNO(ret));
+    }
+    return 0;
+}
+
+int _DkWakeByAddress(uint32_t* addr, uint64_t count) {
+    int nwake = count > INT_MAX ? INT_MAX : (int)count;
+    int ret = INLINE_SYSCALL(futex, 6, addr, FUTEX_WAKE, nwake, NULL, NULL, 0);
+    return IS_ERR(ret) ? unix_to_pal_error(ERRNO(ret)) : 0;
+}
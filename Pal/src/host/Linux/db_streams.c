@@ -79,6 +79,54 @@ int handle_set_cloexec(PAL_HANDLE handle, bool enable) {
     return 0;
 }
 
+/* Returns the host fd used for reading (or writing) the stream, -1 if there is none. */
+int stream_host_fd(PAL_HANDLE handle, bool write) {
+    for (int i = 0; i < MAX_FDS; i++)
+        if (HANDLE_HDR(handle)->flags & (write ? WFD(i) : RFD(i)))
+            return handle->generic.fds[i];
+
+    return -1;
+}
+
+int64_t _DkStreamCopy(PAL_HANDLE dst, uint64_t dst_offset, PAL_HANDLE src, uint64_t src_offset,
+                      uint64_t count) {
+    int src_fd = stream_host_fd(src, /*write=*/false);
+    int dst_fd = stream_host_fd(dst, /*write=*/true);
+    if (src_fd < 0 || dst_fd < 0)
+        return -PAL_ERROR_NOTSUPPORT;
+
+    bool src_is_file = IS_HANDLE_TYPE(src, file);
+    bool dst_is_file = IS_HANDLE_TYPE(dst, file);
+    int64_t src_off  = src_offset;
+    int64_t dst_off  = dst_offset;
+    int64_t ret;
+
+    if (src_is_file && dst_is_file) {
+        ret = INLINE_SYSCALL(copy_file_range, 6, src_fd, &src_off, dst_fd, &dst_off, count, 0);
+    } else if (src_is_file) {
+        ret = INLINE_SYSCALL(sendfile, 4, dst_fd, src_fd, &src_off, count);
+    } else {
+        /* splice() works only if one of the ends is a host pipe, otherwise it fails with EINVAL */
+        ret = INLINE_SYSCALL(splice, 6, src_fd, NULL, dst_fd, dst_is_file ? &dst_off : NULL, count,
+                             0);
+    }
+
+    if (IS_ERR(ret)) {
+        switch (ERRNO(ret)) {
+            case ENOSYS:
+            case EINVAL:
+            case EXDEV:
+            case EOPNOTSUPP:
+                /* host cannot copy between these fds directly */
+                return -PAL_ERROR_NOTSUPPORT;
+            default:
+                return unix_to_pal_error(ERRNO(ret));
+        }
+    }
+
+    return ret;
+}
+
 void _DkPrintConsole(const void* buf, int size) {
     INLINE_SYSCALL(write, 3, 2 /*stderr*/, buf, size);
 }
@@ -17,6 +17,7 @@
 #include "pal_linux_defs.h"
 #include "spinlock.h"
 #include <errno.h>
+#include <linux/futex.h>
 #include <linux/mman.h>
 #include <linux/sched.h>
 #include <linux/signal.h>
@@ -28,50 +29,210 @@
  * needs to use raw system calls and inline asm. Thus, we resort to recycling thread stacks
  * allocated by previous threads and not used anymore. This still leaks memory but at least
  * it is bounded by the maximum number of simultaneously executing threads. Note that main
- * thread is not a part of this mechanism (it only allocates a tiny altstack). */
-struct thread_stack_map_t {
-    void* stack;
-    bool  used;
+ * thread is not a part of this mechanism (it only allocates a tiny altstack).
+ *
+ * Unused stacks are kept in a singly-linked free list; the link is stored at the lowest address
+ * of the stack itself (which is never touched by the exiting thread), so that both getting and
+ * recycling a stack takes constant time. */
+struct thread_stack {
+    struct thread_stack* next;
 };
 
-static struct thread_stack_map_t* g_thread_stack_map = NULL;
-static size_t g_thread_stack_num  = 0;
-static size_t g_thread_stack_size = 0;
+static struct thread_stack* g_free_thread_stacks = NULL;
 static spinlock_t g_thread_stack_lock = INIT_SPINLOCK_UNLOCKED;
 
 static void* get_thread_stack(void) {
-    void* ret = NULL;
     spinlock_lock(&g_thread_stack_lock);
-    for (size_t i = 0; i < g_thread_stack_num; i++) {
-        if (!g_thread_stack_map[i].used) {
-            /* found allocated and unused stack -- use it */
-            g_thread_stack_map[i].used = true;
-            ret = g_thread_stack_map[i].stack;
-            goto out;
+    struct thread_stack* stack = g_free_thread_stacks;
+    if (stack)
+        g_free_thread_stacks = stack->next;
+    spinlock_unlock(&g_thread_stack_lock);
+
+    if (stack)
+        return stack;
+
+    return malloc(THREAD_STACK_SIZE + ALT_STACK_SIZE);
+}
+
+/* must be called with g_thread_stack_lock held */
+static void put_thread_stack_locked(void* stack) {
+    struct thread_stack* free_stack = stack;
+    free_stack->next = g_free_thread_stacks;
+    g_free_thread_stacks = free_stack;
+}
+
+/* Exiting threads may be kept parked instead of calling exit(), and then reused by
+ * _DkThreadCreate() to avoid the cost of clone() and of setting up a new thread. The maximum
+ * number of parked threads is set by `loader.thread_pool_size` in the manifest (default is 0,
+ * i.e. no parking); the same number of threads is pre-spawned on the first thread creation.
+ *
+ * A parked thread sleeps on `futex` (0 while parked, 1 when a new callback is assigned) in
+ * thread_pool_park(), which runs on the top of the thread's own PAL stack. */
+struct parked_thread {
+    struct parked_thread* next;
+    int futex;
+    int tid;
+    void* stack;
+    PAL_HANDLE handle;
+    int (*callback)(void*);
+    void* param;
+};
+
+static struct parked_thread* g_parked_threads = NULL;
+/* number of parked threads plus threads that are about to park */
+static size_t g_thread_pool_num = 0;
+static size_t g_thread_pool_size = 0;
+static bool g_thread_pool_inited = false;
+static spinlock_t g_thread_pool_lock = INIT_SPINLOCK_UNLOCKED;
+
+static int create_thread(PAL_HANDLE hdl, int (*callback)(void*), const void* param);
+
+/* reserves a slot in the thread pool for the current (exiting) thread */
+static bool thread_pool_reserve(void) {
+    bool reserved = false;
+    spinlock_lock(&g_thread_pool_lock);
+    if (g_thread_pool_num < g_thread_pool_size) {
+        g_thread_pool_num++;
+        reserved = true;
+    }
+    spinlock_unlock(&g_thread_pool_lock);
+    return reserved;
+}
+
+static noreturn void thread_pool_park(PAL_TCB_LINUX* tcb, int* clear_child_tid) {
+    struct parked_thread self = {
+        .futex = 0,
+        .tid   = INLINE_SYSCALL(gettid, 0),
+        .stack = tcb->alt_stack - THREAD_STACK_SIZE,
+    };
+
+    /* we do not use the previous stack anymore; inform LibOS that it may release the thread */
+    if (clear_child_tid)
+        __atomic_store_n(clear_child_tid, 0, __ATOMIC_RELEASE);
+
+    spinlock_lock(&g_thread_pool_lock);
+    self.next = g_parked_threads;
+    g_parked_threads = &self;
+    spinlock_unlock(&g_thread_pool_lock);
+
+    while (__atomic_load_n(&self.futex, __ATOMIC_ACQUIRE) == 0)
+        INLINE_SYSCALL(futex, 6, &self.futex, FUTEX_WAIT, 0, NULL, NULL, 0);
+
+    /* reinitialize the alternate stack and the TCB as if this was a newly created thread; note
+     * that the TCB is still set in GS and the alternate stack is still registered */
+    void* alt_stack = tcb->alt_stack;
+    struct pal_uring* uring = tcb->uring;
+    memset(alt_stack, 0, ALT_STACK_SIZE);
+    tcb->common.self = &tcb->common;
+    tcb->handle      = self.handle;
+    tcb->alt_stack   = alt_stack;
+    tcb->uring       = uring;
+    tcb->callback    = self.callback;
+    tcb->param       = self.param;
+
+    block_async_signals(false);
+    tcb->callback(tcb->param);
+    _DkThreadExit(/*clear_child_tid=*/NULL);
+}
+
+static int thread_pool_prespawned(void* param) {
+    __UNUSED(param);
+    block_async_signals(true);
+    thread_pool_park(get_tcb_linux(), /*clear_child_tid=*/NULL);
+}
+
+static void thread_pool_init(void) {
+    spinlock_lock(&g_thread_pool_lock);
+    if (g_thread_pool_inited) {
+        spinlock_unlock(&g_thread_pool_lock);
+        return;
+    }
+
+    char cfgbuf[CONFIG_MAX];
+    if (pal_state.root_config &&
+            get_config(pal_state.root_config, "loader.thread_pool_size", cfgbuf,
+                       sizeof(cfgbuf)) > 0) {
+        int size = atoi(cfgbuf);
+        if (size > 0)
+            g_thread_pool_size = size;
+    }
+
+    size_t prespawn = g_thread_pool_size;
+    g_thread_pool_num = prespawn;
+    __atomic_store_n(&g_thread_pool_inited, true, __ATOMIC_RELEASE);
+    spinlock_unlock(&g_thread_pool_lock);
+
+    for (size_t i = 0; i < prespawn; i++) {
+        if (create_thread(/*hdl=*/NULL, thread_pool_prespawned, NULL) < 0) {
+            spinlock_lock(&g_thread_pool_lock);
+            g_thread_pool_num -= prespawn - i;
+            spinlock_unlock(&g_thread_pool_lock);
+            break;
         }
     }
+}
+
+/* hands the callback over to a parked thread, returns false if there is none */
+static bool thread_pool_resume(PAL_HANDLE hdl, int (*callback)(void*), const void* param) {
+    spinlock_lock(&g_thread_pool_lock);
+    struct parked_thread* parked = g_parked_threads;
+    if (parked) {
+        g_parked_threads = parked->next;
+        g_thread_pool_num--;
+    }
+    spinlock_unlock(&g_thread_pool_lock);
+
+    if (!parked)
+        return false;
+
+    hdl->thread.tid   = parked->tid;
+    hdl->thread.stack = parked->stack;
+    parked->handle    = hdl;
+    parked->callback  = callback;
+    parked->param     = (void*)param;
+
+    __atomic_store_n(&parked->futex, 1, __ATOMIC_RELEASE);
+    INLINE_SYSCALL(futex, 6, &parked->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+    return true;
+}
+
+/* Thread handles are closed by LibOS once the thread has exited, which is as frequent as thread
+ * creation for applications with short-lived threads. Up to THREAD_HANDLE_CACHE_SIZE closed
+ * handles are kept (see thread_close()) and reused by _DkThreadCreate() instead of going through
+ * malloc() and free(). */
+#define THREAD_HANDLE_CACHE_SIZE 32
 
-    if (g_thread_stack_num == g_thread_stack_size) {
-        /* realloc g_thread_stack_map to accommodate more objects (includes the very first time) */
-        g_thread_stack_size += 8;
-        struct thread_stack_map_t* tmp = malloc(g_thread_stack_size * sizeof(*tmp));
-        if (!tmp)
-            goto out;
+static PAL_HANDLE g_thread_handle_cache[THREAD_HANDLE_CACHE_SIZE];
+static size_t g_thread_handle_cache_num = 0;
+static spinlock_t g_thread_handle_cache_lock = INIT_SPINLOCK_UNLOCKED;
 
-        memcpy(tmp, g_thread_stack_map, g_thread_stack_num * sizeof(*tmp));
-        free(g_thread_stack_map);
-        g_thread_stack_map = tmp;
+static PAL_HANDLE get_thread_handle(void) {
+    PAL_HANDLE hdl = NULL;
+
+    spinlock_lock(&g_thread_handle_cache_lock);
+    if (g_thread_handle_cache_num)
+        hdl = g_thread_handle_cache[--g_thread_handle_cache_num];
+    spinlock_unlock(&g_thread_handle_cache_lock);
+
+    if (!hdl)
+        hdl = malloc(HANDLE_SIZE(thread));
+    if (hdl) {
+        memset(hdl, 0, HANDLE_SIZE(thread));
+        SET_HANDLE_TYPE(hdl, thread);
     }
+    return hdl;
+}
 
-    ret = malloc(THREAD_STACK_SIZE + ALT_STACK_SIZE);
-    if (!ret)
-        goto out;
+/* returns 1 if the handle was cached, so that _DkObjectClose() does not free it */
+static int thread_close(PAL_HANDLE handle) {
+    int ret = 0;
 
-    g_thread_stack_map[g_thread_stack_num].stack = ret;
-    g_thread_stack_map[g_thread_stack_num].used  = true;
-    g_thread_stack_num++;
-out:
-    spinlock_unlock(&g_thread_stack_lock);
+    spinlock_lock(&g_thread_handle_cache_lock);
+    if (g_thread_handle_cache_num < THREAD_HANDLE_CACHE_SIZE) {
+        g_thread_handle_cache[g_thread_handle_cache_num++] = handle;
+        ret = 1;
+    }
+    spinlock_unlock(&g_thread_handle_cache_lock);
     return ret;
 }
 
@@ -107,19 +268,12 @@ int pal_thread_init(void* tcbptr) {
     return 0;
 }
 
-/* _DkThreadCreate for internal use. Create an internal thread
-   inside the current process. The arguments callback and param
-   specify the starting function and parameters */
-int _DkThreadCreate (PAL_HANDLE * handle, int (*callback) (void *),
-                     const void * param)
-{
-    int ret = 0;
-    PAL_HANDLE hdl = NULL;
+/* Creates a new host thread which runs `callback`. `hdl` may be NULL for threads which are not
+ * visible outside of PAL (i.e. pre-spawned threads of the thread pool). */
+static int create_thread(PAL_HANDLE hdl, int (*callback)(void*), const void* param) {
     void* stack = get_thread_stack();
-    if (!stack) {
-        ret = -ENOMEM;
-        goto err;
-    }
+    if (!stack)
+        return -PAL_ERROR_NOMEM;
 
     /* Stack layout for the new thread looks like this (recall that stacks grow towards lower
      * addresses on Linux on x86-64):
@@ -140,13 +294,6 @@ int _DkThreadCreate (PAL_HANDLE * handle, int (*callback) (void *),
 
     void * child_stack = stack + THREAD_STACK_SIZE;
 
-    hdl = malloc(HANDLE_SIZE(thread));
-    if (!hdl) {
-        ret = -ENOMEM;
-        goto err;
-    }
-    SET_HANDLE_TYPE(hdl, thread);
-
     // Initialize TCB at the top of the alternative stack.
     PAL_TCB_LINUX * tcb  = child_stack + ALT_STACK_SIZE - sizeof(PAL_TCB_LINUX);
     tcb->common.self = &tcb->common;
@@ -158,23 +305,51 @@ int _DkThreadCreate (PAL_HANDLE * handle, int (*callback) (void *),
     /* align child_stack to 16 */
     child_stack = ALIGN_DOWN_PTR(child_stack, 16);
 
-    ret = clone(pal_thread_init, child_stack,
-                CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SYSVSEM | CLONE_THREAD |
-                CLONE_SIGHAND | CLONE_PARENT_SETTID,
-                (void*)tcb, &hdl->thread.tid, NULL);
+    /* the new thread may start using its handle right away, so set it up before clone() */
+    PAL_IDX tid = 0;
+    if (hdl)
+        hdl->thread.stack = stack;
+
+    int ret = clone(pal_thread_init, child_stack,
+                    CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SYSVSEM | CLONE_THREAD |
+                    CLONE_SIGHAND | CLONE_PARENT_SETTID,
+                    (void*)tcb, hdl ? &hdl->thread.tid : &tid, NULL);
 
     if (IS_ERR(ret)) {
-        ret = -PAL_ERROR_DENIED;
-        goto err;
+        /* the stack was never used, return it to the free list */
+        spinlock_lock(&g_thread_stack_lock);
+        put_thread_stack_locked(stack);
+        spinlock_unlock(&g_thread_stack_lock);
+        return -PAL_ERROR_DENIED;
+    }
+
+    return 0;
+}
+
+/* _DkThreadCreate for internal use. Create an internal thread
+   inside the current process. The arguments callback and param
+   specify the starting function and parameters */
+int _DkThreadCreate (PAL_HANDLE * handle, int (*callback) (void *),
+                     const void * param)
+{
+    if (!__atomic_load_n(&g_thread_pool_inited, __ATOMIC_ACQUIRE))
+        thread_pool_init();
+
+    PAL_HANDLE hdl = get_thread_handle();
+    if (!hdl)
+        return -PAL_ERROR_NOMEM;
+
+    if (!thread_pool_resume(hdl, callback, param)) {
+        int ret = create_thread(hdl, callback, param);
+        if (ret < 0) {
+            if (!thread_close(hdl))
+                free(hdl);
+            return ret;
+        }
     }
 
-    hdl->thread.stack = stack;
     *handle = hdl;
     return 0;
-err:
-    free(stack);
-    free(hdl);
-    return ret;
 }
 
 int _DkThreadDelayExecution (unsigned long * duration)
@@ -218,7 +393,27 @@ noreturn void _DkThreadExit(int* clear_child_tid) {
     PAL_HANDLE handle = tcb->handle;
     assert(handle);
 
+    /* the first thread does not have a recyclable stack, see get_thread_stack() */
+    void* stack = handle->thread.stack;
+    bool own_stack = tcb->alt_stack && stack == tcb->alt_stack - THREAD_STACK_SIZE;
+
     block_async_signals(true);
+
+    if (own_stack && thread_pool_reserve()) {
+        /* park this thread instead of exiting; first switch to the top of this thread's own PAL
+         * stack because the current stack may be released by LibOS once clear_child_tid is set */
+        void* stack_top = ALIGN_DOWN_PTR(tcb->alt_stack, 16);
+        __asm__ volatile("movq %0, %%rsp \n\t"
+                         "xorq %%rbp, %%rbp \n\t"
+                         "call *%1 \n\t"
+                         : /* no output regs since we don't return from thread_pool_park */
+                         : "r"(stack_top), "r"(thread_pool_park), "D"(tcb), "S"(clear_child_tid)
+                         : "memory");
+        __builtin_unreachable();
+    }
+
+    destroy_thread_uring(tcb);
+
     if (tcb->alt_stack) {
         stack_t ss;
         ss.ss_sp    = NULL;
@@ -230,15 +425,11 @@ noreturn void _DkThreadExit(int* clear_child_tid) {
         INLINE_SYSCALL(sigaltstack, 2, &ss, NULL);
     }
 
-    /* we do not free thread stack but instead mark it as recycled, see get_thread_stack() */
+    /* we do not free thread stack but instead put it on the free list, see get_thread_stack() */
     spinlock_lock(&g_thread_stack_lock);
-    for (size_t i = 0; i < g_thread_stack_num; i++) {
-        if (g_thread_stack_map[i].stack == handle->thread.stack) {
-            g_thread_stack_map[i].used = false;
-            break;
-        }
-    }
-    /* we might still be using the stack we just marked as unused until we enter the asm mode,
+    if (own_stack)
+        put_thread_stack_locked(stack);
+    /* we might still be using the stack we just recycled until we enter the asm mode,
      * so we do not unlock now but rather in asm below */
 
     /* To make sure the compiler doesn't touch the stack after it was freed, need inline asm:
@@ -280,6 +471,36 @@ int _DkThreadResume (PAL_HANDLE threadHandle)
     return 0;
 }
 
+int _DkThreadSetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask) {
+    int tid = thread ? thread->thread.tid : 0;
+    int ret = INLINE_SYSCALL(sched_setaffinity, 3, tid, cpumask_size, cpu_mask);
+    if (IS_ERR(ret))
+        return unix_to_pal_error(ERRNO(ret));
+
+    return 0;
+}
+
+int _DkThreadGetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask) {
+    int tid = thread ? thread->thread.tid : 0;
+    int ret = INLINE_SYSCALL(sched_getaffinity, 3, tid, cpumask_size, cpu_mask);
+    if (IS_ERR(ret))
+        return unix_to_pal_error(ERRNO(ret));
+
+    /* the kernel fills only the first `ret` bytes of the mask */
+    if ((size_t)ret < cpumask_size)
+        memset((char*)cpu_mask + ret, 0, cpumask_size - ret);
+
+    return 0;
+}
+
+int _DkThreadGetCurrentCpu(unsigned int* cpu, unsigned int* node) {
+    int ret = INLINE_SYSCALL(getcpu, 3, cpu, node, NULL);
+    if (IS_ERR(ret))
+        return unix_to_pal_error(ERRNO(ret));
+
+    return 0;
+}
+
 struct handle_ops thread_ops = {
-    /* nothing */
+    .close = &thread_close,
 };
@@ -0,0 +1,334 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * db_uring.c
+ *
+ * This file contains the io_uring engine behind DkStreamsBatchIo(). Each PAL thread lazily
+ * creates its own ring, so submissions and completions never need a lock. The engine is
+ * enabled with "loader.io_uring = 1" in the manifest; if it is disabled, if the host kernel
+ * does not support io_uring or if a batch contains requests the engine cannot handle,
+ * _DkStreamsBatchIo() returns -PAL_ERROR_NOTIMPLEMENTED and the generic code performs the
+ * requests one by one.
+ */
+
+#include <asm/errno.h>
+#include <asm/mman.h>
+#include <linux/io_uring.h>
+#include <linux/poll.h>
+#include <linux/uio.h>
+
+#include "api.h"
+#include "pal.h"
+#include "pal_debug.h"
+#include "pal_defs.h"
+#include "pal_error.h"
+#include "pal_internal.h"
+#include "pal_linux.h"
+#include "pal_linux_defs.h"
+
+#define URING_ENTRIES 64
+
+struct pal_uring {
+    int fd;
+    uint32_t entries;
+
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t* sq_mask;
+    uint32_t* sq_array;
+    struct io_uring_sqe* sqes;
+
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring; /* equal to sq_ring if the kernel maps both rings at once */
+    size_t cq_ring_size;
+    size_t sqes_size;
+
+    struct iovec iovs[URING_ENTRIES];
+};
+
+enum {
+    URING_UNKNOWN = 0,
+    URING_ENABLED,
+    URING_DISABLED,
+};
+
+static int g_uring_state = URING_UNKNOWN;
+
+static bool uring_enabled(void) {
+    int state = __atomic_load_n(&g_uring_state, __ATOMIC_ACQUIRE);
+    if (state != URING_UNKNOWN)
+        return state == URING_ENABLED;
+
+    state = URING_DISABLED;
+    char cfgbuf[CONFIG_MAX];
+    if (pal_state.root_config &&
+            get_config(pal_state.root_config, "loader.io_uring", cfgbuf, sizeof(cfgbuf)) > 0 &&
+            atoi(cfgbuf) == 1)
+        state = URING_ENABLED;
+
+    /* concurrent callers read the same manifest, so the race is benign */
+    __atomic_store_n(&g_uring_state, state, __ATOMIC_RELEASE);
+    return state == URING_ENABLED;
+}
+
+static void uring_unmap(struct pal_uring* ring) {
+    if (ring->sqes)
+        INLINE_SYSCALL(munmap, 2, ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+        INLINE_SYSCALL(munmap, 2, ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring)
+        INLINE_SYSCALL(munmap, 2, ring->sq_ring, ring->sq_ring_size);
+    if (ring->fd >= 0)
+        INLINE_SYSCALL(close, 1, ring->fd);
+}
+
+static void* uring_mmap(int fd, size_t size, uint64_t offset) {
+    void* mem = (void*)ARCH_MMAP(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 fd, offset);
+    return IS_ERR_P(mem) ? NULL : mem;
+}
+
+static int uring_create(struct pal_uring** out_ring) {
+    struct pal_uring* ring = malloc(sizeof(*ring));
+    if (!ring)
+        return -PAL_ERROR_NOMEM;
+    memset(ring, 0, sizeof(*ring));
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int ret = INLINE_SYSCALL(io_uring_setup, 2, URING_ENTRIES, &params);
+    if (IS_ERR(ret)) {
+        free(ring);
+        /* io_uring may also be compiled out or forbidden by a seccomp policy on the host */
+        if (ERRNO(ret) == ENOSYS || ERRNO(ret) == EPERM)
+            return -PAL_ERROR_NOTSUPPORT;
+        return unix_to_pal_error(ERRNO(ret));
+    }
+    ring->fd      = ret;
+    ring->entries = params.sq_entries;
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size    = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->sq_ring_size = MAX(ring->sq_ring_size, ring->cq_ring_size);
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = uring_mmap(ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+    if (!ring->sq_ring)
+        goto fail;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = uring_mmap(ring->fd, ring->cq_ring_size, IORING_OFF_CQ_RING);
+        if (!ring->cq_ring)
+            goto fail;
+    }
+
+    ring->sqes = uring_mmap(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+    if (!ring->sqes)
+        goto fail;
+
+    ring->sq_head  = ring->sq_ring + params.sq_off.head;
+    ring->sq_tail  = ring->sq_ring + params.sq_off.tail;
+    ring->sq_mask  = ring->sq_ring + params.sq_off.ring_mask;
+    ring->sq_array = ring->sq_ring + params.sq_off.array;
+    ring->cq_head  = ring->cq_ring + params.cq_off.head;
+    ring->cq_tail  = ring->cq_ring + params.cq_off.tail;
+    ring->cq_mask  = ring->cq_ring + params.cq_off.ring_mask;
+    ring->cqes     = ring->cq_ring + params.cq_off.cqes;
+
+    *out_ring = ring;
+    return 0;
+
+fail:
+    uring_unmap(ring);
+    free(ring);
+    return -PAL_ERROR_NOMEM;
+}
+
+void destroy_thread_uring(PAL_TCB_LINUX* tcb) {
+    if (!tcb->uring)
+        return;
+
+    uring_unmap(tcb->uring);
+    free(tcb->uring);
+    tcb->uring = NULL;
+}
+
+/* Returns the host FD the request operates on or -1 if the engine cannot perform it. */
+static int uring_request_fd(PAL_IO_REQUEST* req) {
+    PAL_HANDLE handle = req->handle;
+
+    if (!IS_HANDLE_TYPE(handle, file) && !IS_HANDLE_TYPE(handle, pipe) &&
+            !IS_HANDLE_TYPE(handle, pipeprv) && !IS_HANDLE_TYPE(handle, pipecli) &&
+            !IS_HANDLE_TYPE(handle, tcp))
+        return -1;
+
+    switch (req->op) {
+        case PAL_IO_READ:
+            return stream_host_fd(handle, /*write=*/false);
+        case PAL_IO_WRITE:
+            return stream_host_fd(handle, /*write=*/true);
+        case PAL_IO_FLUSH:
+            return IS_HANDLE_TYPE(handle, file) ? stream_host_fd(handle, /*write=*/true) : -1;
+        case PAL_IO_POLL: {
+            /* one poll request watches a single FD, but private pipes have one per direction */
+            int rfd = (req->count & PAL_WAIT_READ) ? stream_host_fd(handle, /*write=*/false) : -1;
+            int wfd = (req->count & PAL_WAIT_WRITE) ? stream_host_fd(handle, /*write=*/true) : -1;
+            if (rfd >= 0 && wfd >= 0 && rfd != wfd)
+                return -1;
+            return rfd >= 0 ? rfd : wfd;
+        }
+        default:
+            return -1;
+    }
+}
+
+static void uring_prep(struct pal_uring* ring, struct io_uring_sqe* sqe, size_t slot,
+                       PAL_IO_REQUEST* req, int fd, uint64_t user_data) {
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd        = fd;
+    sqe->user_data = user_data;
+
+    switch (req->op) {
+        case PAL_IO_READ:
+        case PAL_IO_WRITE:
+            /* READV/WRITEV instead of READ/WRITE to work on the oldest io_uring kernels */
+            ring->iovs[slot].iov_base = (void*)req->buffer;
+            ring->iovs[slot].iov_len  = req->count;
+            sqe->opcode = req->op == PAL_IO_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->addr   = (uint64_t)&ring->iovs[slot];
+            sqe->len    = 1;
+            sqe->off    = IS_HANDLE_TYPE(req->handle, file) ? req->offset : (uint64_t)-1;
+            break;
+        case PAL_IO_FLUSH:
+            sqe->opcode = IORING_OP_FSYNC;
+            break;
+        case PAL_IO_POLL:
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->poll_events = ((req->count & PAL_WAIT_READ) ? POLLIN : 0) |
+                               ((req->count & PAL_WAIT_WRITE) ? POLLOUT : 0);
+            break;
+    }
+}
+
+static void uring_complete(PAL_IO_REQUEST* req, int res) {
+    if (res < 0) {
+        req->result = PAL_STREAM_ERROR;
+        req->error  = -unix_to_pal_error(-res);
+        return;
+    }
+
+    if (req->op == PAL_IO_POLL) {
+        PAL_FLG events = 0;
+        if (res & POLLIN)
+            events |= PAL_WAIT_READ;
+        if (res & POLLOUT)
+            events |= PAL_WAIT_WRITE;
+        if (res & (POLLHUP | POLLERR | POLLNVAL))
+            events |= PAL_WAIT_ERROR;
+        res = events;
+    }
+
+    req->result = res;
+    req->error  = 0;
+}
+
+static size_t uring_reap(struct pal_uring* ring, PAL_IO_REQUEST* requests) {
+    uint32_t head = *ring->cq_head;
+    uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    size_t reaped = 0;
+
+    for (; head != tail; head++, reaped++) {
+        struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+        uring_complete(&requests[cqe->user_data], cqe->res);
+    }
+
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+/* Submits `count` (at most ring->entries) requests and waits until all of them complete. */
+static void uring_run(struct pal_uring* ring, PAL_IO_REQUEST* requests, int* fds, size_t count) {
+    uint32_t tail = *ring->sq_tail;
+    for (size_t i = 0; i < count; i++, tail++) {
+        uint32_t idx = tail & *ring->sq_mask;
+        uring_prep(ring, &ring->sqes[idx], i, &requests[i], fds[i], i);
+        ring->sq_array[idx] = idx;
+    }
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    size_t queued    = count;
+    size_t submitted = 0;
+    size_t reaped    = 0;
+    while (submitted < queued || reaped < submitted) {
+        size_t to_submit = queued - submitted;
+        size_t in_flight = submitted - reaped;
+        int ret = INLINE_SYSCALL(io_uring_enter, 6, ring->fd, to_submit,
+                                 to_submit ? 1 : in_flight, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (IS_ERR(ret)) {
+            int err = ERRNO(ret);
+            if (err == EINTR || ((err == EAGAIN || err == EBUSY) && in_flight)) {
+                /* requests in flight still reference the buffers, so we cannot bail out here;
+                 * EAGAIN and EBUSY clear up once completions are reaped */
+                reaped += uring_reap(ring, requests);
+                continue;
+            }
+
+            /* withdraw the requests the kernel did not take and fail them */
+            __atomic_store_n(ring->sq_tail, __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE),
+                             __ATOMIC_RELEASE);
+            for (size_t i = submitted; i < queued; i++)
+                uring_complete(&requests[i], -err);
+            queued = submitted;
+            continue;
+        }
+
+        submitted += ret;
+        reaped += uring_reap(ring, requests);
+    }
+}
+
+int _DkStreamsBatchIo(PAL_IO_REQUEST* requests, size_t count) {
+    if (!uring_enabled())
+        return -PAL_ERROR_NOTIMPLEMENTED;
+
+    int fds[URING_ENTRIES];
+    for (size_t i = 0; i < count; i++) {
+        if (uring_request_fd(&requests[i]) < 0)
+            return -PAL_ERROR_NOTIMPLEMENTED;
+    }
+
+    PAL_TCB_LINUX* tcb = get_tcb_linux();
+    if (!tcb->uring) {
+        int ret = uring_create(&tcb->uring);
+        if (ret == -PAL_ERROR_NOTSUPPORT) {
+            /* the host does not offer io_uring at all, never try again */
+            __atomic_store_n(&g_uring_state, URING_DISABLED, __ATOMIC_RELEASE);
+        }
+        if (ret < 0)
+            return -PAL_ERROR_NOTIMPLEMENTED;
+    }
+
+    struct pal_uring* ring = tcb->uring;
+    for (size_t done = 0; done < count;) {
+        size_t chunk = MIN(count - done, MIN((size_t)ring->entries, (size_t)URING_ENTRIES));
+        for (size_t i = 0; i < chunk; i++)
+            fds[i] = uring_request_fd(&requests[done + i]);
+        uring_run(ring, requests + done, fds, chunk);
+        done += chunk;
+    }
+
+    return 0;
+}
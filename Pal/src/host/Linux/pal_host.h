@@ -155,9 +155,15 @@ typedef struct pal_handle
 
 extern void __check_pending_event (void);
 
-#define LEAVE_PAL_CALL() do { __check_pending_event(); } while (0)
+/* see ENTER_PAL_CALL() in pal_internal.h for tracing of PAL calls */
+#define LEAVE_PAL_CALL()                                                      \
+    do {                                                                      \
+        if (_pal_call_start)                                                  \
+            trace_pal_call(_pal_call_name, _pal_call_start);                  \
+        __check_pending_event();                                              \
+    } while (0)
 
 #define LEAVE_PAL_CALL_RETURN(retval) \
-    do { __check_pending_event(); return (retval); } while (0)
+    do { LEAVE_PAL_CALL(); return (retval); } while (0)
 
 #endif /* PAL_HOST_H */
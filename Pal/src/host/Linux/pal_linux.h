@@ -160,9 +160,13 @@ typedef struct pal_tcb_linux {
         void *      alt_stack;
         int         (*callback) (void *);
         void *      param;
+        struct pal_uring* uring; /* lazily created by _DkStreamsBatchIo() */
     };
 } PAL_TCB_LINUX;
 
+int stream_host_fd(PAL_HANDLE handle, bool write);
+void destroy_thread_uring(PAL_TCB_LINUX* tcb);
+
 int pal_thread_init(void* tcbptr);
 
 static inline PAL_TCB_LINUX * get_tcb_linux (void)
@@ -95,6 +95,16 @@ struct handle_ops file_ops = {
     .rename         = &file_rename,
 };
 
+/* 'open' operation for named shared-memory objects */
+static int shm_open(PAL_HANDLE* handle, const char* type, const char* uri, int access, int share,
+                    int create, int options) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+struct handle_ops shm_ops = {
+    .open = &shm_open,
+};
+
 /* 'open' operation for directory stream. Directory stream does not have a specific type prefix, its
  * URI looks the same file streams, plus it ended with slashes. dir_open will be called by
  * file_open. */
@@ -30,6 +30,22 @@ int _DkVirtualMemoryProtect(void* addr, uint64_t size, int prot) {
     return -PAL_ERROR_NOTIMPLEMENTED;
 }
 
+int _DkVirtualMemoryMove(void* old_addr, void* new_addr, uint64_t size) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkVirtualMemoryAdvise(void* addr, uint64_t size, int advice) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkVirtualMemoryPolicy(void* addr, uint64_t size, int mode, uint64_t nodemask, int flags) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkVirtualMemoryNodes(uint64_t count, void** pages, const uint32_t* nodes, uint32_t* status) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
 unsigned long _DkMemoryQuota(void) {
     return 0;
 }
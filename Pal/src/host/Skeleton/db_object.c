@@ -26,3 +26,15 @@ int _DkStreamsWaitEvents(size_t count, PAL_HANDLE* handle_array, PAL_FLG* events
                          int64_t timeout_us) {
     return -PAL_ERROR_NOTIMPLEMENTED;
 }
+
+int _DkStreamsBatchIo(PAL_IO_REQUEST* requests, size_t count) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkWaitOnAddress(uint32_t* addr, uint32_t expected, int64_t timeout_us) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkWakeByAddress(uint32_t* addr, uint64_t count) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
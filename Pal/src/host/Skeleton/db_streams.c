@@ -19,6 +19,11 @@ void _DkPrintConsole(const void* buf, int size) {
     /* needs to be implemented */
 }
 
+int64_t _DkStreamCopy(PAL_HANDLE dst, uint64_t dst_offset, PAL_HANDLE src, uint64_t src_offset,
+                      uint64_t count) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
 /* _DkStreamUnmap for internal use. Unmap stream at certain memory address.
    The memory is unmapped as a whole.*/
 int _DkStreamUnmap(void* addr, uint64_t size) {
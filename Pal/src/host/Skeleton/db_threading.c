@@ -43,6 +43,18 @@ int _DkThreadResume(PAL_HANDLE threadHandle) {
     return -PAL_ERROR_NOTIMPLEMENTED;
 }
 
+int _DkThreadSetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkThreadGetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
+int _DkThreadGetCurrentCpu(unsigned int* cpu, unsigned int* node) {
+    return -PAL_ERROR_NOTIMPLEMENTED;
+}
+
 struct handle_ops thread_ops = {
     /* nothing */
 };
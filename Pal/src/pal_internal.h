@@ -79,6 +79,18 @@ struct handle_ops {
     /* 'flush' is used by DkStreamFlush. It syncs the stream to the device */
     int (*flush) (PAL_HANDLE handle);
 
+    /* 'allocate', 'advise' and 'flushrange' are used by DkStreamAllocate, DkStreamAdvise and
+       DkStreamFlushRange; 'mode', 'advice' and 'flags' are PAL_FALLOC, PAL_FADVISE and
+       PAL_FLUSH_RANGE values. All three are optional. */
+    int (*allocate) (PAL_HANDLE handle, uint64_t offset, uint64_t length, int mode);
+    int (*advise) (PAL_HANDLE handle, uint64_t offset, uint64_t length, int advice);
+    int (*flushrange) (PAL_HANDLE handle, uint64_t offset, uint64_t length, int flags);
+
+    /* 'lock' and 'lockquery' are used by DkStreamLock and DkStreamLockQuery; 'type' is a PAL_LOCK
+       value. Both are optional; streams without them cannot be locked. */
+    int (*lock) (PAL_HANDLE handle, int type, uint64_t offset, uint64_t length, int flags);
+    int (*lockquery) (PAL_HANDLE handle, int* type, uint64_t* offset, uint64_t* length);
+
     /* 'waitforclient' is used by DkStreamWaitforClient. It accepts an
        connection */
     int (*waitforclient) (PAL_HANDLE server, PAL_HANDLE *client);
@@ -129,16 +141,28 @@ static inline int handle_size (PAL_HANDLE handle)
     return sizeof(*handle);
 }
 
+/* PAL calls are reported to the tracer set by DkSetCallTracer() (if any); the start time is
+ * taken only when a tracer is set */
+extern PAL_CALL_TRACER g_pal_call_tracer;
+void trace_pal_call(const char* name, unsigned long start_time);
+
 #ifndef ENTER_PAL_CALL
-# define ENTER_PAL_CALL(name)
+# define ENTER_PAL_CALL(name)                                                  \
+    static const char _pal_call_name[] __attribute__((unused)) = #name;        \
+    unsigned long _pal_call_start __attribute__((unused)) =                    \
+        __atomic_load_n(&g_pal_call_tracer, __ATOMIC_RELAXED) ? _DkSystemTimeQuery() : 0
 #endif
 
 #ifndef LEAVE_PAL_CALL
-# define LEAVE_PAL_CALL()
+# define LEAVE_PAL_CALL()                                                      \
+    do {                                                                       \
+        if (_pal_call_start)                                                   \
+            trace_pal_call(_pal_call_name, _pal_call_start);                   \
+    } while (0)
 #endif
 
 #ifndef LEAVE_PAL_CALL_RETURN
-# define LEAVE_PAL_CALL_RETURN(retval)     do { return (retval); } while (0)
+# define LEAVE_PAL_CALL_RETURN(retval)     do { LEAVE_PAL_CALL(); return (retval); } while (0)
 #endif
 
 /* failure notify. The rountine is called whenever a PAL call return
@@ -220,6 +244,8 @@ int64_t _DkStreamRead (PAL_HANDLE handle, uint64_t offset, uint64_t count,
                        void * buf, char * addr, int addrlen);
 int64_t _DkStreamWrite (PAL_HANDLE handle, uint64_t offset, uint64_t count,
                         const void * buf, const char * addr, int addrlen);
+int64_t _DkStreamCopy(PAL_HANDLE dst, uint64_t dst_offset, PAL_HANDLE src, uint64_t src_offset,
+                      uint64_t count);
 int _DkStreamAttributesQuery (const char * uri, PAL_STREAM_ATTR * attr);
 int _DkStreamAttributesQueryByHandle (PAL_HANDLE hdl, PAL_STREAM_ATTR * attr);
 int _DkStreamMap (PAL_HANDLE handle, void ** addr, int prot, uint64_t offset,
@@ -227,6 +253,11 @@ int _DkStreamMap (PAL_HANDLE handle, void ** addr, int prot, uint64_t offset,
 int _DkStreamUnmap (void * addr, uint64_t size);
 int64_t _DkStreamSetLength (PAL_HANDLE handle, uint64_t length);
 int _DkStreamFlush (PAL_HANDLE handle);
+int _DkStreamAllocate(PAL_HANDLE handle, uint64_t offset, uint64_t length, int mode);
+int _DkStreamAdvise(PAL_HANDLE handle, uint64_t offset, uint64_t length, int advice);
+int _DkStreamFlushRange(PAL_HANDLE handle, uint64_t offset, uint64_t length, int flags);
+int _DkStreamLock(PAL_HANDLE handle, int type, uint64_t offset, uint64_t length, int flags);
+int _DkStreamLockQuery(PAL_HANDLE handle, int* type, uint64_t* offset, uint64_t* length);
 int _DkStreamGetName (PAL_HANDLE handle, char * buf, int size);
 const char * _DkStreamRealpath (PAL_HANDLE hdl);
 int _DkSendHandle(PAL_HANDLE hdl, PAL_HANDLE cargo);
@@ -239,6 +270,9 @@ noreturn void _DkThreadExit(int* clear_child_tid);
 int _DkThreadDelayExecution (unsigned long * duration);
 void _DkThreadYieldExecution (void);
 int _DkThreadResume (PAL_HANDLE threadHandle);
+int _DkThreadSetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask);
+int _DkThreadGetCpuAffinity(PAL_HANDLE thread, size_t cpumask_size, void* cpu_mask);
+int _DkThreadGetCurrentCpu(unsigned int* cpu, unsigned int* node);
 int _DkProcessCreate (PAL_HANDLE * handle, const char * uri,
                       const char ** args);
 noreturn void _DkProcessExit (int exitCode);
@@ -262,6 +296,10 @@ int _DkEventClear (PAL_HANDLE event);
 int _DkVirtualMemoryAlloc (void ** paddr, uint64_t size, int alloc_type, int prot);
 int _DkVirtualMemoryFree (void * addr, uint64_t size);
 int _DkVirtualMemoryProtect (void * addr, uint64_t size, int prot);
+int _DkVirtualMemoryMove(void* old_addr, void* new_addr, uint64_t size);
+int _DkVirtualMemoryAdvise(void* addr, uint64_t size, int advice);
+int _DkVirtualMemoryPolicy(void* addr, uint64_t size, int mode, uint64_t nodemask, int flags);
+int _DkVirtualMemoryNodes(uint64_t count, void** pages, const uint32_t* nodes, uint32_t* status);
 
 /* DkObject calls */
 int _DkObjectReference (PAL_HANDLE objectHandle);
@@ -269,6 +307,11 @@ int _DkObjectClose (PAL_HANDLE objectHandle);
 int _DkSynchronizationObjectWait(PAL_HANDLE handle, int64_t timeout_us);
 int _DkStreamsWaitEvents(size_t count, PAL_HANDLE* handle_array, PAL_FLG* events, PAL_FLG* ret_events,
                          int64_t timeout_us);
+/* Performs all `requests`; returns -PAL_ERROR_NOTIMPLEMENTED if the host cannot perform this
+ * batch at once (DkStreamsBatchIo() then performs the requests one by one). */
+int _DkStreamsBatchIo(PAL_IO_REQUEST* requests, size_t count);
+int _DkWaitOnAddress(uint32_t* addr, uint32_t expected, int64_t timeout_us);
+int _DkWakeByAddress(uint32_t* addr, uint64_t count);
 
 /* DkException calls & structures */
 PAL_EVENT_HANDLER _DkGetExceptionHandler (PAL_NUM event_num);
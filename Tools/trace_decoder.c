@@ -0,0 +1,191 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/* Decoder of binary trace files written by Graphene when `sys.trace.file` is set in the manifest.
+ * Prints records sorted by start time, either as text (default) or as JSON in the Chrome trace
+ * event format (`--json`), which can be loaded into chrome://tracing or Perfetto UI. See Graphene
+ * documentation for usage.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../LibOS/shim/include/shim_trace.h"
+
+#define MAX_IDS  65536
+#define NAME_LEN sizeof(((struct shim_trace_record*)0)->args)
+
+static char g_syscall_names[MAX_IDS][NAME_LEN];
+static char g_pal_names[MAX_IDS][NAME_LEN];
+
+static int compare_records(const void* a, const void* b) {
+    const struct shim_trace_record* ra = a;
+    const struct shim_trace_record* rb = b;
+    if (ra->start_time != rb->start_time)
+        return ra->start_time < rb->start_time ? -1 : 1;
+    return 0;
+}
+
+static const char* record_name(const struct shim_trace_record* record, char* buf, size_t size) {
+    const char* name = NULL;
+    if (record->type == TRACE_RECORD_SYSCALL) {
+        name = g_syscall_names[record->id];
+        if (!name[0]) {
+            snprintf(buf, size, "syscall_%u", record->id);
+            name = buf;
+        }
+    } else {
+        name = g_pal_names[record->id];
+        if (!name[0]) {
+            snprintf(buf, size, "pal_call_%u", record->id);
+            name = buf;
+        }
+    }
+    return name;
+}
+
+static void print_text(const struct shim_trace_record* records, size_t count, uint32_t vmid) {
+    char buf[32];
+
+    for (size_t i = 0; i < count; i++) {
+        const struct shim_trace_record* r = &records[i];
+        if (r->type == TRACE_RECORD_DROPPED) {
+            printf("%" PRIu64 " [P%u:%u] *** %" PRId64 " records dropped ***\n", r->start_time,
+                   vmid, r->tid, r->ret);
+            continue;
+        }
+
+        const char* name = record_name(r, buf, sizeof(buf));
+        if (r->type == TRACE_RECORD_SYSCALL) {
+            printf("%" PRIu64 " [P%u:%u] %s(0x%" PRIx64 ", 0x%" PRIx64 ", 0x%" PRIx64 ", 0x%" PRIx64
+                   ", 0x%" PRIx64 ", 0x%" PRIx64 ") = %" PRId64 " <%uus>\n", r->start_time, vmid,
+                   r->tid, name, r->args[0], r->args[1], r->args[2], r->args[3], r->args[4],
+                   r->args[5], r->ret, r->duration);
+        } else {
+            printf("%" PRIu64 " [P%u:%u]   %s <%uus>\n", r->start_time, vmid, r->tid, name,
+                   r->duration);
+        }
+    }
+}
+
+static void print_json(const struct shim_trace_record* records, size_t count, uint32_t vmid,
+                       bool* first) {
+    char buf[32];
+
+    for (size_t i = 0; i < count; i++) {
+        const struct shim_trace_record* r = &records[i];
+        printf("%s\n", *first ? "" : ",");
+        *first = false;
+
+        if (r->type == TRACE_RECORD_DROPPED) {
+            printf("{\"name\": \"dropped\", \"ph\": \"i\", \"s\": \"t\", \"ts\": %" PRIu64
+                   ", \"pid\": %u, \"tid\": %u, \"args\": {\"records\": %" PRId64 "}}",
+                   r->start_time, vmid, r->tid, r->ret);
+            continue;
+        }
+
+        const char* name = record_name(r, buf, sizeof(buf));
+        printf("{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %" PRIu64
+               ", \"dur\": %u, \"pid\": %u, \"tid\": %u", name,
+               r->type == TRACE_RECORD_SYSCALL ? "syscall" : "pal", r->start_time, r->duration,
+               vmid, r->tid);
+        if (r->type == TRACE_RECORD_SYSCALL) {
+            printf(", \"args\": {\"ret\": %" PRId64 ", \"args\": \"0x%" PRIx64 " 0x%" PRIx64
+                   " 0x%" PRIx64 " 0x%" PRIx64 " 0x%" PRIx64 " 0x%" PRIx64 "\"}", r->ret,
+                   r->args[0], r->args[1], r->args[2], r->args[3], r->args[4], r->args[5]);
+        }
+        printf("}");
+    }
+}
+
+static int decode_file(const char* path, bool json, bool* first) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+
+    struct shim_trace_header header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+            memcmp(header.magic, SHIM_TRACE_MAGIC, sizeof(header.magic)) ||
+            header.version != SHIM_TRACE_VERSION ||
+            header.record_size != sizeof(struct shim_trace_record)) {
+        fprintf(stderr, "%s: not a Graphene trace file (or unsupported version)\n", path);
+        fclose(f);
+        return 1;
+    }
+
+    memset(g_syscall_names, 0, sizeof(g_syscall_names));
+    memset(g_pal_names, 0, sizeof(g_pal_names));
+
+    size_t count = 0, size = 4096;
+    struct shim_trace_record* records = malloc(size * sizeof(*records));
+    if (!records) {
+        fclose(f);
+        return 1;
+    }
+
+    struct shim_trace_record record;
+    while (fread(&record, sizeof(record), 1, f) == 1) {
+        if (record.type == TRACE_RECORD_NAME) {
+            char* name = record.kind == TRACE_RECORD_SYSCALL ? g_syscall_names[record.id]
+                                                             : g_pal_names[record.id];
+            memcpy(name, record.args, NAME_LEN);
+            name[NAME_LEN - 1] = '\0';
+            continue;
+        }
+
+        if (count == size) {
+            size *= 2;
+            struct shim_trace_record* tmp = realloc(records, size * sizeof(*records));
+            if (!tmp) {
+                free(records);
+                fclose(f);
+                return 1;
+            }
+            records = tmp;
+        }
+        records[count++] = record;
+    }
+    fclose(f);
+
+    qsort(records, count, sizeof(*records), compare_records);
+
+    if (json) {
+        print_json(records, count, header.vmid, first);
+    } else {
+        print_text(records, count, header.vmid);
+    }
+
+    free(records);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    bool json = false;
+    int i = 1;
+
+    if (i < argc && !strcmp(argv[i], "--json")) {
+        json = true;
+        i++;
+    }
+
+    if (i == argc) {
+        fprintf(stderr, "Usage: %s [--json] TRACE_FILE...\n", argv[0]);
+        return 1;
+    }
+
+    bool first = true;
+    int ret = 0;
+
+    if (json)
+        printf("{\"traceEvents\": [");
+    for (; i < argc; i++)
+        ret |= decode_file(argv[i], json, &first);
+    if (json)
+        printf("\n]}\n");
+
+    return ret;
+}